@@ -1166,9 +1166,14 @@ data LibDepTree = LibDep String | LibDeps [LibDepTree] deriving (Show,Eq)
 libposixcompat_deps   = LibDeps [ LibDep "posixcompat",
                                   (libvfs_deps_all "vfs"), LibDep "term_server" ]
 liblwip_deps          = LibDeps $ [ LibDep x | x <- deps ]
-    where deps = ["lwip" ,"contmng" ,"net_if_raw" ,"timer" ,"hashtable"]
+    where deps = ["lwip" ,"contmng" ,"net_if_raw" ,"timer" ,"hashtable", "pktcopy"]
 libnetQmng_deps       = LibDeps $ [ LibDep x | x <- deps ]
-    where deps = ["net_queue_manager", "contmng" ,"procon" , "net_if_raw", "bfdmuxvm"]
+    where deps = ["net_queue_manager", "contmng" ,"procon" , "net_if_raw", "bfdmuxvm",
+                  "dma_copy", "pktcopy"]
+libdma_copy_deps      = LibDeps [ LibDep "dma_copy", LibDep "pktcopy" ]
+libbulk_transfer_deps = LibDeps [ LibDep "bulk_transfer", libdma_copy_deps ]
+libdma_deps t         = LibDeps [ LibDep t, libdma_copy_deps ]
+libarranet_deps       = LibDeps [ LibDep "arranet", LibDep "pktcopy" ]
 libnfs_deps           = LibDeps $ [ LibDep "nfs", liblwip_deps]
 libssh_deps           = LibDeps [ libposixcompat_deps, libopenbsdcompat_deps,
                                   LibDep "zlib", LibDep "crypto", LibDep "ssh" ]
@@ -1207,6 +1212,11 @@ str2dep  str
     | str == "vfs_noblockdev"= libvfs_deps_noblockdev str
     | str == "lwip"          = liblwip_deps
     | str == "netQmng"       = libnetQmng_deps
+    | str == "bulk_transfer" = libbulk_transfer_deps
+    | str == "dma"           = libdma_deps str
+    | str == "dma_client"    = libdma_deps str
+    | str == "dma_copy"      = libdma_copy_deps
+    | str == "arranet"       = libarranet_deps
     | str == "ssh"           = libssh_deps
     | str == "openbsdcompat" = libopenbsdcompat_deps
     | otherwise              = LibDep str
@@ -1237,7 +1247,9 @@ libDeps xs = [x | (LibDep x) <- (sortBy xcmp) . nub . flat $ map str2dep xs ]
                   , "net_if_raw"
                   , "vfsfd"
                   , "timer"
-                  , "hashtable"]
+                  , "hashtable"
+                  , "dma_copy"
+                  , "pktcopy"]
           xcmp (LibDep a) (LibDep b) = compare (elemIndex a xord) (elemIndex b xord)
 
 
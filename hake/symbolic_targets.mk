@@ -93,6 +93,7 @@ BIN_RCCE_BT= \
 TESTS_COMMON= \
 	sbin/hellotest \
 	sbin/idctest \
+	sbin/lmp_cap_batch_test \
 	sbin/memtest \
 	sbin/schedtest \
 	sbin/testerror \
@@ -152,9 +153,12 @@ TESTS_k1om= \
 # All benchmark domains
 BENCH_COMMON= \
 	sbin/channel_cost_bench \
+	sbin/flounder_stubs_batch_bench \
 	sbin/flounder_stubs_buffer_bench \
 	sbin/flounder_stubs_empty_bench \
 	sbin/flounder_stubs_payload_bench \
+	sbin/flounder_stubs_pipelined_bench \
+	sbin/slot_alloc_bench \
 	sbin/xcorecapbench
 
 BENCH_x86= \
@@ -189,6 +193,7 @@ BENCH_x86_64= \
 	sbin/bulk_transfer_passthrough \
 	sbin/bulkbench \
 	sbin/bulkbench_micro_echo \
+	sbin/bulkbench_micro_mp \
 	sbin/bulkbench_micro_rtt \
 	sbin/bulkbench_micro_throughput \
 	sbin/elb_app \
@@ -197,11 +202,14 @@ BENCH_x86_64= \
 	sbin/mdb_bench \
 	sbin/mdb_bench_old \
 	sbin/netthroughput \
+	sbin/octopus_bench \
 	sbin/phases_bench \
 	sbin/phases_scale_bench \
 	sbin/placement_bench \
 	sbin/rcce_pingpong \
+	sbin/replay-bench \
 	sbin/shared_mem_clock_bench \
+	sbin/spawn_image_bench \
 	sbin/tsc_bench
 
 BENCH_k1om=\
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2011 ETH Zurich.
+ * Copyright (c) 2011, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -30,6 +30,8 @@ typedef errval_t ahci_change_waitset_fn(struct ahci_binding *_binding,
 typedef errval_t ahci_control_fn(struct ahci_binding *_binding,
 		idc_control_t control);
 typedef void ahci_error_handler_fn(struct ahci_binding *_binding, errval_t err);
+typedef void ahci_request_done_fn(struct ahci_binding *_binding, void *arg,
+		errval_t err);
 
 /*
  * Message type signatures (receive)
@@ -87,6 +89,11 @@ struct ahci_binding {
     uint8_t *identify_data;
     size_t identify_length;
     ata_identify_t identify;
+
+    /* Requests waiting for a command slot, see ahci_queue_rw() */
+    struct ahci_request *queue_head;
+    struct ahci_request *queue_tail;
+    size_t queue_outstanding;
 };
 
 errval_t ahci_issue_command(struct ahci_binding *_binding,
@@ -94,6 +101,14 @@ errval_t ahci_issue_command(struct ahci_binding *_binding,
 		size_t fis_length, bool is_write, struct ahci_dma_region *buf,
 		size_t buflen);
 
+errval_t ahci_queue_rw(struct ahci_binding *_binding, bool is_write,
+		uint64_t lba, struct ahci_dma_region *buf, size_t buflen,
+		ahci_request_done_fn *done, void *arg);
+
+bool ahci_ncq_supported(struct ahci_binding *_binding);
+
+size_t ahci_queue_depth(struct ahci_binding *_binding);
+
 errval_t ahci_close(struct ahci_binding *_binding,
 		struct event_closure _continuation);
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2011 ETH Zurich.
+ * Copyright (c) 2011, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -32,10 +32,14 @@
 #define CEIL_DIV(x, d) (((x) + ((d)-1)) / (d))
 #endif
 
+struct ahci_request;
+
 struct ahci_command_slot {
     struct ahci_dma_region *command_table;
     bool in_use;
+    bool ncq;                       ///< Issued as a FPDMA QUEUED command
     void *tag;
+    struct ahci_request *request;   ///< Set for commands from ahci_queue_rw()
 };
 
 struct ahci_port_info {
@@ -19,6 +19,11 @@
 #define SATA_FIS_TYPE_PIO	0x5F // PIO Setup FIS - Device to Host
 #define SATA_FIS_TYPE_SDB	0xA1 // Set Device Bits FIS - Device to Host
 
+#define ATA_CMD_READ_DMA_EXT		0x25
+#define ATA_CMD_WRITE_DMA_EXT		0x35
+#define ATA_CMD_READ_FPDMA_QUEUED	0x60
+#define ATA_CMD_WRITE_FPDMA_QUEUED	0x61
+
 struct sata_fis_reg_h2d {
 	unsigned char type;
 	unsigned char specialstuff;
@@ -73,5 +78,7 @@ errval_t sata_set_feature(void *fis, uint8_t feature);
 errval_t sata_set_lba28(void *fis, uint32_t lba);
 errval_t sata_set_lba48(void *fis, uint64_t lba);
 errval_t sata_set_count(void *fis, uint16_t count);
+errval_t sata_set_ncq_count(void *fis, uint16_t count);
+errval_t sata_set_ncq_tag(void *fis, uint8_t tag);
 
 #endif // _AHCI_SATA_FIS_H
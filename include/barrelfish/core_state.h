@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2008, 2009, 2010, 2011, 2012, ETH Zurich.
+ * Copyright (c) 2008, 2009, 2010, 2011, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -95,6 +95,8 @@ struct slot_alloc_state {
     char    root_buf[SINGLE_SLOT_ALLOC_BUFLEN(DEFAULT_CNODE_SLOTS   )];
 
     struct single_slot_allocator rootca;
+
+    struct slot_cache cache;    ///< Free slots of #defca, see slot_alloc()
 };
 
 struct terminal_state;
@@ -22,6 +22,10 @@
 __BEGIN_DECLS
 
 typedef void (*domain_spanned_callback_t)(void *arg, errval_t err);
+typedef void (*domain_spanned_core_callback_t)(void *arg, coreid_t core_id,
+                                               errval_t err);
+
+struct coreset;
 
 struct mem_rpc_client;
 struct octopus_rpc_client;
@@ -69,6 +73,9 @@ errval_t domain_init(void);
 errval_t domain_new_dispatcher(coreid_t core_id,
                                domain_spanned_callback_t callback,
                                void *callback_arg);
+errval_t domain_new_dispatchers(struct coreset *cores,
+                                domain_spanned_core_callback_t callback,
+                                void *callback_arg);
 errval_t domain_thread_create_on(coreid_t core_id, thread_func_t start_func,
                                  void *arg, struct thread **newthread);
 errval_t domain_thread_create_on_varstack(coreid_t core_id,
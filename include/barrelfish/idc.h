@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2010, ETH Zurich.
+ * Copyright (c) 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -24,6 +24,9 @@ typedef enum idc_control {
     IDC_CONTROL_TEARDOWN,   ///< Initiate connection teardown
     IDC_CONTROL_SET_SYNC,   ///< Enable synchronous optimisations
     IDC_CONTROL_CLEAR_SYNC, ///< Disable synchronous optimisations
+    IDC_CONTROL_SET_BATCH,  ///< Coalesce notifications of consecutive sends
+    IDC_CONTROL_CLEAR_BATCH,///< Notify every send (default)
+    IDC_CONTROL_FLUSH,      ///< Send notifications held back by batching now
 } idc_control_t;
 
 /// Flags on an IDC export/service
@@ -0,0 +1,66 @@
+/**
+ * \file
+ * \brief Transfer of many capabilities in a single LMP message
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef BARRELFISH_LMP_CAP_BATCH_H
+#define BARRELFISH_LMP_CAP_BATCH_H
+
+#include <sys/cdefs.h>
+
+#include <barrelfish/lmp_chan.h>
+
+__BEGIN_DECLS
+
+/**
+ * \brief A batch of capabilities held in a CNode
+ *
+ * The sender collects the capabilities in a fresh CNode and transfers the
+ * CNode capability in one message. The kernel moves only the CNode cap, so
+ * the capabilities in the batch are neither copied nor do they need
+ * receive slots of their own: the receiver addresses them in the received
+ * CNode, and copies out the ones it wants to keep.
+ */
+struct lmp_cap_batch {
+    struct capref   cnode_cap;  ///< CNode holding the batch
+    struct cnoderef cnode;      ///< The CNode, to address its slots
+    cslot_t         slots;      ///< Number of slots in the CNode
+    cslot_t         count;      ///< Number of caps in the batch (slots 0..count-1)
+};
+
+errval_t lmp_cap_batch_create(struct lmp_cap_batch *b, cslot_t slots);
+errval_t lmp_cap_batch_add(struct lmp_cap_batch *b, struct capref cap,
+                           bool move);
+errval_t lmp_cap_batch_from_cnode(struct lmp_cap_batch *b,
+                                  struct capref cnode_cap, cslot_t count,
+                                  uint8_t size_bits);
+errval_t lmp_cap_batch_destroy(struct lmp_cap_batch *b);
+errval_t lmp_chan_send_cap_batch(struct lmp_chan *lc, lmp_send_flags_t flags,
+                                 struct lmp_cap_batch *b);
+errval_t lmp_chan_recv_cap_batch(struct lmp_chan *lc, struct lmp_cap_batch *b);
+
+/**
+ * \brief Returns the location of the i-th capability in a batch
+ */
+static inline struct capref lmp_cap_batch_get(struct lmp_cap_batch *b,
+                                              cslot_t i)
+{
+    assert(i < b->count);
+    return (struct capref) {
+        .cnode = b->cnode,
+        .slot  = i
+    };
+}
+
+__END_DECLS
+
+#endif // BARRELFISH_LMP_CAP_BATCH_H
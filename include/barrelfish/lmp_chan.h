@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2009, 2010, 2011, ETH Zurich.
+ * Copyright (c) 2009, 2010, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -27,6 +27,9 @@ __BEGIN_DECLS
 struct lmp_chan;
 struct event_queue_node;
 
+/// Maximum number of receive slots an LMP channel keeps in reserve
+#define LMP_RECV_SLOT_RESERVE   16
+
 struct lmp_bind_continuation {
     /**
      * \brief Handler which runs when a binding succeeds or fails
@@ -57,6 +60,10 @@ struct lmp_chan {
     struct lmp_bind_continuation bind_continuation; ///< Continuation for bind
     iref_t iref;            ///< IREF
     size_t buflen_words;    ///< requested LMP buffer length, in words
+
+    /// Pre-allocated receive slots, see lmp_chan_reserve_recv_slots()
+    struct capref recv_reserve[LMP_RECV_SLOT_RESERVE];
+    size_t recv_reserve_count; ///< Number of valid slots in #recv_reserve
 };
 
 void lmp_chan_init(struct lmp_chan *lc);
@@ -71,6 +78,7 @@ errval_t lmp_chan_register_send(struct lmp_chan *lc, struct waitset *ws,
 errval_t lmp_chan_deregister_send(struct lmp_chan *lc);
 void lmp_chan_migrate_send(struct lmp_chan *lc, struct waitset *ws);
 errval_t lmp_chan_alloc_recv_slot(struct lmp_chan *lc);
+errval_t lmp_chan_reserve_recv_slots(struct lmp_chan *lc, size_t count);
 void lmp_channels_retry_send_disabled(dispatcher_handle_t handle);
 void lmp_init(void);
 
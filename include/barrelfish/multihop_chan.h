@@ -36,10 +36,10 @@ __BEGIN_DECLS
 // sending a dummy message
 #define MULTIHOP_WINDOW_RATIO_DUMMY_MESSAGE 0.5
 
-// number of buckets in the forwarding (hash) table at monitors
+// initial capacity of the forwarding (hash) table at monitors
 #define MULTIHOP_FORWARDING_TABLE_BUCKETS 10
 
-// number of buckets in the mapping table (at dispatchers)
+// initial capacity of the mapping table (at dispatchers), it grows as needed
 #define MULTIHOP_MAPPING_TABLE_BACKETS 10
 
 ///////////////////////////////////////////////////////
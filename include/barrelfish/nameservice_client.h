@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2010, 2011, ETH Zurich.
+ * Copyright (c) 2010, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -19,6 +19,11 @@ errval_t nameservice_blocking_lookup(const char *iface, iref_t *retiref);
 errval_t nameservice_register(const char *iface, iref_t iref);
 errval_t nameservice_client_blocking_bind(void);
 
+/// Returns the name service record for iface, used to plug in a cache
+typedef errval_t (*nameservice_lookup_cache_fn)(char **record,
+                                                const char *iface);
+void nameservice_set_lookup_cache(nameservice_lookup_cache_fn fn);
+
 errval_t nameservice_get_capability(const char *key, struct capref *retcap);
 errval_t nameservice_put_capability(const char *key, struct capref cap);
 errval_t nameservice_remove_capability(const char *key);
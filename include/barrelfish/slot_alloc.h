@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2010, ETH Zurich.
+ * Copyright (c) 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -73,6 +73,22 @@ struct range_slot_allocator {
     bool is_head; ///< Is this instance head of a chain
 };
 
+/// Number of free slots each dispatcher keeps in its slot cache
+#define SLOT_CACHE_SLOTS        32
+/// Number of slots moved between a slot cache and the default allocator
+#define SLOT_CACHE_BATCH        (SLOT_CACHE_SLOTS / 2)
+
+/**
+ * \brief Per-dispatcher cache of free slots of the default allocator
+ *
+ * Only ever accessed by the owning dispatcher with the dispatcher disabled,
+ * so allocating and freeing a cached slot takes no lock.
+ */
+struct slot_cache {
+    struct capref slots[SLOT_CACHE_SLOTS];
+    size_t count;                  ///< Number of valid entries in #slots
+};
+
 // single_slot_alloc_init_raw() requires a specific buflen
 #define SINGLE_SLOT_ALLOC_BUFLEN(nslots) \
     (SLAB_STATIC_SIZE(nslots / 2, sizeof(struct cnode_meta)))
@@ -96,6 +112,7 @@ struct slot_allocator *get_default_slot_allocator(void);
 errval_t slot_alloc(struct capref *ret);
 errval_t slot_alloc_root(struct capref *ret);
 errval_t slot_free(struct capref ret);
+errval_t slot_alloc_prefill(cslot_t slots);
 
 errval_t range_slot_alloc(struct range_slot_allocator *alloc, cslot_t nslots,
                           struct capref *ret);
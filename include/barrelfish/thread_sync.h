@@ -62,6 +62,35 @@ struct thread_sem {
     { 0, (struct thread *)NULL, 0 }
 #endif
 
+/// Number of reader counters of a reader-writer lock, indexed by core
+#define THREAD_RWLOCK_READER_SLOTS      8
+
+/// Alignment of a reader counter, a heap-allocated lock must honour it too
+#define THREAD_RWLOCK_ALIGN             64
+
+struct thread_rwlock_readers {
+    volatile int        count;
+} __attribute__((aligned(THREAD_RWLOCK_ALIGN)));
+
+struct thread_rwlock {
+    spinlock_t          lock;
+    volatile int        writers;        ///< Writers waiting or holding the lock
+    struct thread       *writer;        ///< Thread holding the write lock
+    struct thread       *read_queue;    ///< Readers waiting for the writers
+    struct thread       *write_queue;   ///< Writers waiting for the writer
+    struct thread       *drain_queue;   ///< Writer waiting for the readers
+    struct thread_rwlock_readers readers[THREAD_RWLOCK_READER_SLOTS];
+};
+#ifndef __cplusplus
+#       define THREAD_RWLOCK_INITIALIZER \
+    { .lock = 0, .writers = 0, .writer = NULL, .read_queue = NULL, \
+      .write_queue = NULL, .drain_queue = NULL }
+#else
+#       define THREAD_RWLOCK_INITIALIZER \
+    { 0, 0, (struct thread *)NULL, (struct thread *)NULL, \
+      (struct thread *)NULL, (struct thread *)NULL }
+#endif
+
 typedef int thread_once_t;
 #define THREAD_ONCE_INIT INT_MAX
 
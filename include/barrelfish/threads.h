@@ -60,6 +60,13 @@ void thread_cond_signal(struct thread_cond *cond);
 void thread_cond_broadcast(struct thread_cond *cond);
 void thread_cond_wait(struct thread_cond *cond, struct thread_mutex *mutex);
 
+void thread_rwlock_init(struct thread_rwlock *rwlock);
+void thread_rwlock_rdlock(struct thread_rwlock *rwlock);
+bool thread_rwlock_tryrdlock(struct thread_rwlock *rwlock);
+void thread_rwlock_wrlock(struct thread_rwlock *rwlock);
+bool thread_rwlock_trywrlock(struct thread_rwlock *rwlock);
+void thread_rwlock_unlock(struct thread_rwlock *rwlock);
+
 void thread_sem_init(struct thread_sem *sem, unsigned int value);
 void thread_sem_wait(struct thread_sem *sem);
 bool thread_sem_trywait(struct thread_sem *sem);
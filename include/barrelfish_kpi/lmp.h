@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2009, 2010, ETH Zurich.
+ * Copyright (c) 2009, 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -37,6 +37,8 @@ typedef enum lmp_send_flag {
     LMP_FLAG_SYNC       = 1 << 0,
     LMP_FLAG_YIELD      = 1 << 1,
     LMP_FLAG_GIVEAWAY   = 1 << 2,
+    /// Like SYNC, and the receiver's next send back to us switches back
+    LMP_FLAG_CALL       = 1 << 3,
 } lmp_send_flags_t;
 
 #define LMP_SEND_FLAGS_DEFAULT (LMP_FLAG_SYNC | LMP_FLAG_YIELD)
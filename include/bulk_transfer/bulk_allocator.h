@@ -7,7 +7,7 @@
  */
 
 /*
- * Copyright (c) 2013, ETH Zurich.
+ * Copyright (c) 2013, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -29,13 +29,16 @@ struct bulk_buffer_mng {
 };
 
 /**
- *
+ * Buffer allocator for a pool. Buffers may be allocated and returned by
+ * several threads concurrently.
  */
 struct bulk_allocator {
     struct bulk_pool       *pool;
     struct bulk_buffer_mng *mngs;
     size_t                  num_free;
-    struct bulk_buffer_mng *free_buffers;
+    /// free list: index of the first free entry + 1, tagged with a generation
+    /// count in the upper 32 bits so that it can be updated lock-free
+    uint64_t                free_head;
 };
 
 
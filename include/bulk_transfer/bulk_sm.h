@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2009, 2010, ETH Zurich.
+ * Copyright (c) 2009, 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -52,6 +52,9 @@ struct bulk_sm_impl_data {
     // resending of flounder messages
     struct thread_mutex         resend_lock;
     struct bulk_sm_resend_item  *resend_closure;
+
+    // descriptor rings, NULL if buffers are transferred by messages
+    struct bulk_sm_ring_channel *ring;
 };
 
 // Shared memory implementation callbacks ---------------------------------
@@ -114,6 +117,53 @@ errval_t bulk_sm_ep_create(struct bulk_sm_endpoint_descriptor *ep_desc);
 errval_t bulk_sm_ep_create_remote(struct bulk_sm_endpoint_descriptor *ep_desc,
                                   iref_t remote_iref);
 
+// Descriptor ring variant -----------------------------------------------
+
+/**
+ * Creates a new bulk endpoint which uses the shared memory backend with
+ * descriptor rings.
+ *
+ * Channels of such endpoints are set up like shared memory channels. If they
+ * are fully trusted, moves, copies, passes and releases are then written
+ * as cacheline-sized descriptors into lock-free rings shared by the two
+ * endpoints, and any number of threads may transfer buffers concurrently.
+ * The continuation of such an operation is called as soon as its
+ * descriptor has been queued.
+ *
+ * @param ep_desc   memory location to create the endpoint in
+ */
+errval_t bulk_sm_ring_ep_create(struct bulk_sm_endpoint_descriptor *ep_desc);
+
+/**
+ * Creates a new descriptor ring endpoint for the binding side.
+ *
+ * @param ep_desc       memory location to create the endpoint in
+ * @param remote_iref   the iref of the exported service on the other side
+ */
+errval_t bulk_sm_ring_ep_create_remote(struct bulk_sm_endpoint_descriptor *ep_desc,
+                                       iref_t remote_iref);
+
+struct bulk_implementation *bulk_sm_ring_get_implementation(void);
+
+/**
+ * Descriptor ring statistics of one channel endpoint.
+ */
+struct bulk_sm_ring_stats {
+    uint64_t    enqueued;       ///< descriptors written into the tx ring
+    uint64_t    fallbacks;      ///< operations sent as messages instead
+    uint64_t    notifies;       ///< doorbell messages sent to the peer
+    uint64_t    dequeued;       ///< descriptors read from the rx ring
+    uint64_t    drains;         ///< times the rx ring was drained
+};
+
+/**
+ * Returns the descriptor ring statistics of a channel.
+ *
+ * @return BULK_TRANSFER_CHAN_STATE if the channel does not use rings
+ */
+errval_t bulk_sm_ring_get_stats(struct bulk_channel       *channel,
+                                struct bulk_sm_ring_stats *stats);
+
 // Helpers to deal with multiple waitsets (each channel requires one) -----
 
 /**
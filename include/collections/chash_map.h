@@ -0,0 +1,102 @@
+/**
+ * \file
+ * \brief Barrelfish collections library read-mostly concurrent hash map
+ */
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef _CHASH_MAP_H_
+#define _CHASH_MAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/*
+ * A hash map with 64-bit keys for data that is looked up much more often
+ * than it is changed.
+ *
+ * Lookups take no locks and never write to shared cache lines other than a
+ * reader counter: they run inside a read-side critical section, in the
+ * style of RCU. Inserts and removes are serialised by a spinlock. Removed
+ * entries are only marked as such and their data is freed once all readers
+ * that could have seen it have left their critical section. When the table
+ * gets too full, the writer copies the live entries to a new table,
+ * publishes it, and frees the old table after the readers have drained.
+ */
+
+#define COLLECTIONS_CHASH_MAP_READERS   16
+
+typedef void (*collections_chash_map_free)(void *);
+
+struct _collections_chash_map_table;
+
+struct _collections_chash_map_readers {
+    // readers in the even and odd epoch
+    size_t  count[2];
+} __attribute__((aligned(64)));
+
+typedef struct _collections_chash_map {
+    // read by lookups, only changed on resize and synchronize
+    struct _collections_chash_map_table *table;
+
+    // current grace period, only the lowest bit is used to pick a counter
+    size_t  epoch;
+
+    collections_chash_map_free data_free;
+
+    // writer lock, kept off the cache line read by lookups
+    uint32_t lock __attribute__((aligned(64)));
+
+    // total number of elements, protected by the writer lock
+    size_t  num_elems;
+
+    struct _collections_chash_map_readers readers[COLLECTIONS_CHASH_MAP_READERS];
+} collections_chash_map;
+
+/*
+ * Token identifying a read-side critical section.
+ */
+typedef size_t collections_chash_map_reader;
+
+void    collections_chash_map_create(collections_chash_map **m,
+                                     size_t capacity,
+                                     collections_chash_map_free data_free);
+void    collections_chash_map_release(collections_chash_map *m);
+size_t  collections_chash_map_size(collections_chash_map *m);
+
+/*
+ * Readers. Data returned by find stays valid until the critical section it
+ * was found in is left. Critical sections may nest but must not block.
+ */
+collections_chash_map_reader collections_chash_map_read_lock(collections_chash_map *m);
+void    collections_chash_map_read_unlock(collections_chash_map *m,
+                                          collections_chash_map_reader r);
+void*   collections_chash_map_find(collections_chash_map *m, uint64_t key);
+
+/*
+ * Writers, may be called concurrently with readers but not from within a
+ * read-side critical section. Insert returns 0 on success and non-zero if
+ * the key is already in the map.
+ */
+int     collections_chash_map_insert(collections_chash_map *m, uint64_t key,
+                                     void *data);
+void    collections_chash_map_delete(collections_chash_map *m, uint64_t key);
+
+/*
+ * Wait until all read-side critical sections that were active when this
+ * was called have finished.
+ */
+void    collections_chash_map_synchronize(collections_chash_map *m);
+
+__END_DECLS
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * \file
+ * \brief Barrelfish collections library open-addressing hash map
+ */
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef _HASH_MAP_H_
+#define _HASH_MAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/*
+ * A hash map using open addressing with linear probing.
+ *
+ * Entries are stored inline in a power-of-two sized array, so a lookup
+ * usually touches a single cache line and inserts do not allocate. When the
+ * table gets too full it is resized incrementally: the old table is kept
+ * around and a few of its slots are moved to the new table on every insert
+ * and remove, so no single operation pays for rehashing the whole map.
+ *
+ * Keys are either 64-bit words or byte strings, chosen when the map is
+ * created. Byte keys are not copied, the memory they point to must stay
+ * valid while the entry is in the map.
+ */
+
+typedef enum {
+    COLLECTIONS_HASH_MAP_KEY_WORD,  ///< keys are uint64_t values
+    COLLECTIONS_HASH_MAP_KEY_BYTES, ///< keys are (pointer, length) pairs
+} collections_hash_map_key_type;
+
+typedef void (*collections_hash_map_free)(void *);
+
+typedef struct _collections_hash_map_entry {
+    // 0 for an empty slot, 1 for a removed one, the key's hash otherwise
+    uint64_t hash;
+
+    union {
+        uint64_t    word;
+        const void  *bytes;
+    } key;
+
+    // length of a byte key
+    size_t  key_len;
+
+    void    *data;
+} collections_hash_map_entry;
+
+struct _collections_hash_map_table {
+    // number of slots, a power of two
+    size_t  size;
+
+    // number of slots that are not empty, including removed ones
+    size_t  used;
+
+    collections_hash_map_entry *entries;
+};
+
+typedef struct _collections_hash_map {
+    collections_hash_map_key_type key_type;
+
+    // table receiving all inserts
+    struct _collections_hash_map_table cur;
+
+    // table being migrated to cur, entries == NULL if not resizing
+    struct _collections_hash_map_table old;
+
+    // next slot of old to migrate
+    size_t  migrate_pos;
+
+    // total number of elements in the map
+    size_t  num_elems;
+
+    // functions that know how to free inserted keys and data
+    collections_hash_map_free key_free;
+    collections_hash_map_free data_free;
+} collections_hash_map;
+
+/*
+ * Visitor function: returns 0 when visit should be considered finished.
+ */
+typedef int (*collections_hash_map_visitor_func)(collections_hash_map_entry *e,
+                                                 void *arg);
+
+void    collections_hash_map_create(collections_hash_map **m,
+                                    collections_hash_map_key_type key_type,
+                                    size_t capacity,
+                                    collections_hash_map_free key_free,
+                                    collections_hash_map_free data_free);
+void    collections_hash_map_release(collections_hash_map *m);
+size_t  collections_hash_map_size(collections_hash_map *m);
+
+/*
+ * Word keys. Insert returns 0 on success and non-zero if the key is already
+ * in the map, in which case the map is not modified.
+ */
+int     collections_hash_map_insert(collections_hash_map *m, uint64_t key,
+                                    void *data);
+void*   collections_hash_map_find(collections_hash_map *m, uint64_t key);
+void    collections_hash_map_delete(collections_hash_map *m, uint64_t key);
+
+/*
+ * Byte keys, same semantics as above. Lookup returns whether the key was
+ * found, which find cannot tell apart from NULL data.
+ */
+int     collections_hash_map_insert_bytes(collections_hash_map *m,
+                                          const void *key, size_t key_len,
+                                          void *data);
+void*   collections_hash_map_find_bytes(collections_hash_map *m,
+                                        const void *key, size_t key_len);
+bool    collections_hash_map_lookup_bytes(collections_hash_map *m,
+                                          const void *key, size_t key_len,
+                                          void **data);
+void    collections_hash_map_delete_bytes(collections_hash_map *m,
+                                          const void *key, size_t key_len);
+
+/*
+ * Apply function to all elements in the map or until function indicates
+ * function application should stop. The map must not be modified by the
+ * visitor.
+ *
+ * Returns non-zero if all elements in map visited, 0 otherwise.
+ */
+int     collections_hash_map_visit(collections_hash_map *m,
+                                   collections_hash_map_visitor_func visitor,
+                                   void *arg);
+
+__END_DECLS
+
+#endif
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -37,6 +37,11 @@
 
 #define DMA_BENCH_XPHI_BASE_OFFSET (4UL * 1024 * 1024 * 1024)
 
+/* largest copy and bytes copied per size in the copy engine benchmark */
+#define DMA_BENCH_COPY_MAX_BITS 22
+#define DMA_BENCH_COPY_BYTES (256UL * 1024 * 1024)
+
+struct dma_copy_engine;
 
 
 errval_t dma_bench_run_default(struct dma_device *dev);
@@ -47,4 +52,8 @@ errval_t dma_bench_run(struct dma_device *dev, lpaddr_t src, lpaddr_t dst);
 
 errval_t dma_bench_run_memcpy(void *dst, void *src);
 
+errval_t dma_bench_run_copy_engine(struct dma_copy_engine *engine,
+                                   void *dst, lpaddr_t dst_phys,
+                                   void *src, lpaddr_t src_phys);
+
 #endif /* DMA_BENCH_INTERNAL_H */
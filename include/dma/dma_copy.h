@@ -0,0 +1,131 @@
+/**
+ * \file
+ * \brief Asynchronous memory copies, offloaded to a DMA engine where it pays
+ *
+ * A copy engine decides per request whether to copy with the CPU, using the
+ * vectorised pktcopy kernels, or to hand the copy to an offload backend:
+ *
+ *   - copies smaller than the offload threshold are done by the CPU, the
+ *     cost of setting up a descriptor and polling for it dominates there
+ *   - copies without physical addresses for both buffers are done by the CPU
+ *   - if the backend already has the maximum number of copies outstanding,
+ *     the copy is done by the CPU instead of waiting for a free slot
+ *
+ * Completion callbacks are called in submission order, from
+ * dma_copy_poll(), dma_copy_wait() or dma_copy_async() itself. Without a
+ * backend every copy is done by the CPU and completes immediately.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef LIB_DMA_COPY_H
+#define LIB_DMA_COPY_H
+
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+struct dma_device;
+struct dma_copy_request;
+
+/// default minimum size of an offloaded copy
+#define DMA_COPY_OFFLOAD_THRESHOLD  (16 * 1024)
+
+/// default maximum number of offloaded copies outstanding
+#define DMA_COPY_MAX_OUTSTANDING    32
+
+/// callback for a finished copy
+typedef void (dma_copy_done_fn)(errval_t err, void *arg);
+
+/**
+ * Offload backend interface.
+ *
+ * submit() starts a copy and returns without waiting for it. The backend
+ * calls dma_copy_request_done() once the copy finished, from within poll().
+ * destroy() is optional and frees the backend state when the backend is
+ * replaced or the engine is destroyed.
+ */
+struct dma_copy_backend_ops {
+    errval_t (*submit)(void *st, struct dma_copy_request *req,
+                       void *dst, lpaddr_t dst_phys,
+                       const void *src, lpaddr_t src_phys, size_t bytes);
+    errval_t (*poll)(void *st);
+    void (*destroy)(void *st);
+};
+
+/// copy engine statistics
+struct dma_copy_stats {
+    uint64_t cpu_copies;        ///< copies done by the CPU
+    uint64_t cpu_bytes;         ///< bytes copied by the CPU
+    uint64_t cpu_cycles;        ///< cycles spent copying with the CPU
+    uint64_t offload_copies;    ///< copies offloaded to the backend
+    uint64_t offload_bytes;     ///< bytes offloaded to the backend
+    uint64_t offload_busy;      ///< offload candidates done by the CPU
+                                ///< because the backend queue was full
+};
+
+struct dma_copy_engine {
+    const struct dma_copy_backend_ops *ops;  ///< offload backend or NULL
+    void *backend_st;                        ///< backend state
+    const char *backend_name;
+
+    size_t offload_threshold;   ///< minimum size of an offloaded copy
+    size_t max_outstanding;     ///< maximum offloaded copies in flight
+    size_t outstanding;         ///< offloaded copies in flight
+
+    /// requests in submission order, for in-order completion
+    struct dma_copy_request *head, *tail;
+    struct dma_copy_request *free_list;
+
+    struct dma_copy_stats stats;
+};
+
+void dma_copy_engine_init(struct dma_copy_engine *engine);
+
+void dma_copy_engine_destroy(struct dma_copy_engine *engine);
+
+struct dma_copy_engine *dma_copy_default_engine(void);
+
+void dma_copy_engine_set_backend(struct dma_copy_engine *engine,
+                                 const struct dma_copy_backend_ops *ops,
+                                 void *st, const char *name);
+
+void dma_copy_engine_set_policy(struct dma_copy_engine *engine,
+                                size_t offload_threshold,
+                                size_t max_outstanding);
+
+errval_t dma_copy_async(struct dma_copy_engine *engine,
+                        void *dst, lpaddr_t dst_phys,
+                        const void *src, lpaddr_t src_phys, size_t bytes,
+                        dma_copy_done_fn *done, void *arg);
+
+errval_t dma_copy(struct dma_copy_engine *engine,
+                  void *dst, lpaddr_t dst_phys,
+                  const void *src, lpaddr_t src_phys, size_t bytes);
+
+errval_t dma_copy_poll(struct dma_copy_engine *engine);
+
+errval_t dma_copy_wait(struct dma_copy_engine *engine);
+
+void dma_copy_request_done(struct dma_copy_request *req, errval_t err);
+
+/*
+ * Backends
+ */
+
+errval_t dma_copy_sw_backend_init(struct dma_copy_engine *engine,
+                                  size_t bytes_per_poll);
+
+errval_t dma_copy_device_backend_init(struct dma_copy_engine *engine,
+                                      struct dma_device *dev);
+
+__END_DECLS
+
+#endif /* LIB_DMA_COPY_H */
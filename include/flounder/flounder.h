@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2010, ETH Zurich.
+ * Copyright (c) 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -27,4 +27,7 @@
 /// Utility macro to construct a continuation structure (handler & arg)
 #define MKCONT(h,a) MKCLOSURE(h,a)
 
+/// Message statistics of a binding (see flounder/flounder_stats.h)
+struct flounder_binding_stats;
+
 #endif // __FLOUNDER_H
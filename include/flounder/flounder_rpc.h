@@ -0,0 +1,84 @@
+/**
+ * \file
+ * \brief Support for pipelined RPC clients generated by flounder
+ *
+ * RPCs that carry a tag as their first arguments ("in uint64 seq_in, out
+ * uint64 seq_out", the convention used by the THC out-of-order stubs) can be
+ * issued without waiting for the reply of the previous call. The RPC client
+ * keeps a window of outstanding calls and matches replies by their tag.
+ *
+ * Blocking calls dispatch the private waitset of the RPC client. The
+ * continuation of an asynchronous call runs on the waitset the caller passed
+ * to the async stub: while asynchronous calls are outstanding, the binding is
+ * moved to that waitset, so the caller's event loop receives the replies and
+ * runs the continuations. The next blocking call moves the binding back,
+ * blocking and asynchronous calls may not be outstanding at the same time.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef __FLOUNDER_RPC_H
+#define __FLOUNDER_RPC_H
+
+#include <barrelfish/waitset.h>
+#include <barrelfish/thread_sync.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/// Maximum number of outstanding calls on one RPC client, a power of two
+#ifndef FLOUNDER_RPC_WINDOW
+#define FLOUNDER_RPC_WINDOW 16
+#endif
+
+/// Maximum number of result pointers of a pipelined call (see RPCClient.hs)
+#define FLOUNDER_RPC_MAX_OUT 8
+
+/// State of one outstanding call
+struct flounder_rpc_slot {
+    bool in_use;
+    bool async;                     ///< Issued by the async stub
+    uint64_t tag;                   ///< Slot index plus generation
+    volatile bool *done;            ///< Set on completion (blocking calls)
+    errval_t *err;                  ///< Result of the call
+    struct event_closure cont;      ///< Run on completion (async calls)
+    void *out[FLOUNDER_RPC_MAX_OUT]; ///< Where to store the reply arguments
+};
+
+struct flounder_rpc_window {
+    struct flounder_rpc_slot slots[FLOUNDER_RPC_WINDOW];
+    size_t outstanding;
+    size_t async_outstanding;       ///< Binding is on the caller's waitset
+    uint64_t generation;
+    bool dispatching;               ///< A thread is dispatching the waitset
+    struct thread_mutex mutex;
+    struct thread_cond progress;    ///< Signalled after every dispatch
+};
+
+void flounder_rpc_window_init(struct flounder_rpc_window *w);
+errval_t flounder_rpc_window_wait(struct flounder_rpc_window *w,
+                                  struct waitset *ws,
+                                  bool (*cond)(void *arg), void *arg);
+struct flounder_rpc_slot *flounder_rpc_window_alloc(struct flounder_rpc_window *w);
+void flounder_rpc_window_free(struct flounder_rpc_window *w,
+                              struct flounder_rpc_slot *s);
+struct flounder_rpc_slot *flounder_rpc_window_lookup(struct flounder_rpc_window *w,
+                                                     uint64_t tag);
+struct event_closure flounder_rpc_window_complete(struct flounder_rpc_window *w,
+                                                  struct flounder_rpc_slot *s,
+                                                  errval_t err);
+void flounder_rpc_window_fail(struct flounder_rpc_window *w, errval_t err);
+errval_t flounder_rpc_window_drain(struct flounder_rpc_window *w,
+                                   struct waitset *ws);
+bool flounder_rpc_is_done(void *done);
+
+__END_DECLS
+
+#endif // __FLOUNDER_RPC_H
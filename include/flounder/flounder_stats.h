@@ -0,0 +1,212 @@
+/**
+ * \file
+ * \brief Per-binding message statistics of flounder bindings
+ *
+ * If the tree is configured with flounder_stats (FLOUNDER_STATS), the
+ * flounder stubs count the messages sent and received per message type and
+ * measure how long sends take, how long receive handlers run and how long
+ * senders wait in register_send. Every binding registers its statistics
+ * block in a per-domain registry that can be printed or written to the
+ * trace buffer, where bfscope picks it up.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef __FLOUNDER_STATS_H
+#define __FLOUNDER_STATS_H
+
+#include <barrelfish/types.h>
+#include <sys/cdefs.h>
+
+#if defined(__k1om__)
+#include <barrelfish_kpi/asm_inlines_arch.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <arch/x86/barrelfish_kpi/asm_inlines_arch.h>
+#elif defined(__arm__) || defined(__aarch64__)
+#include <barrelfish/sys_debug.h>
+#endif
+
+__BEGIN_DECLS
+
+/// Statistics of one message type
+struct flounder_msg_stats {
+    uint64_t tx;                    ///< Messages sent
+    uint64_t rx;                    ///< Messages received
+    uint64_t tx_busy;               ///< Sends refused with FLOUNDER_ERR_TX_BUSY
+    cycles_t tx_cycles;             ///< Time from send call to last fragment
+    cycles_t tx_cycles_max;
+    cycles_t rx_cycles;             ///< Time spent in the receive handler
+    cycles_t rx_cycles_max;
+};
+
+/// Statistics of one binding
+struct flounder_binding_stats {
+    struct flounder_binding_stats *next;    ///< Registry list
+    uint32_t id;                            ///< Unique within the domain
+    const char *ifname;
+    const char *backend;
+    const char *(*msg_name)(unsigned msgnum);
+
+    cycles_t tx_start;              ///< Start of the current send
+    cycles_t rx_start;              ///< Start of the current receive handler
+
+    /// register_send calls while the binding was busy, and their wait time
+    uint64_t register_waits;
+    cycles_t register_start;
+    cycles_t register_cycles;
+    cycles_t register_cycles_max;
+
+    /// Transmit queue (flounder_txqueue) attached to the binding
+    uint64_t txq_backlogged;        ///< Messages queued behind another one
+    uint32_t txq_depth;             ///< Currently queued messages
+    uint32_t txq_depth_max;
+
+    size_t nmsgs;                   ///< Number of message numbers
+    struct flounder_msg_stats msgs[];
+};
+
+struct flounder_binding_stats *flounder_stats_alloc(const char *ifname,
+                                                    const char *backend,
+                                                    size_t nmsgs,
+                                                    const char *(*msg_name)(unsigned));
+void flounder_stats_free(struct flounder_binding_stats *s);
+void flounder_stats_dump(void);
+void flounder_stats_trace(void);
+void flounder_stats_reset(void);
+
+/*
+ * Hooks used by the generated stubs
+ */
+
+/**
+ * \brief Take a timestamp, the same clock as bench_tsc()
+ *
+ * ARM has no user-readable cycle counter, the hardware timer is read with a
+ * syscall there, which adds to the measured times.
+ */
+static inline cycles_t flounder_stats_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(__k1om__)
+    return rdtsc();
+#elif defined(__arm__) || defined(__aarch64__)
+    uintptr_t tsc = 0;
+    sys_debug_hardware_timer_read(&tsc);
+    return tsc;
+#else
+#error "flounder_stats_now() not implemented for this architecture"
+#endif
+}
+
+static inline void flounder_stats_tx_start(struct flounder_binding_stats *s)
+{
+    if (s != NULL) {
+        s->tx_start = flounder_stats_now();
+    }
+}
+
+static inline void flounder_stats_tx_done(struct flounder_binding_stats *s,
+                                          unsigned msgnum)
+{
+    if (s == NULL || msgnum >= s->nmsgs) {
+        return;
+    }
+
+    cycles_t now = flounder_stats_now();
+    struct flounder_msg_stats *m = &s->msgs[msgnum];
+    cycles_t t;
+
+    m->tx++;
+    // Bind messages are not started with flounder_stats_tx_start()
+    if (s->tx_start != 0) {
+        t = now - s->tx_start;
+        m->tx_cycles += t;
+        if (t > m->tx_cycles_max) {
+            m->tx_cycles_max = t;
+        }
+        s->tx_start = 0;
+    }
+
+    // A waiting register_send continuation is triggered now
+    if (s->register_start != 0) {
+        t = now - s->register_start;
+        s->register_cycles += t;
+        if (t > s->register_cycles_max) {
+            s->register_cycles_max = t;
+        }
+        s->register_start = 0;
+    }
+}
+
+static inline void flounder_stats_tx_busy(struct flounder_binding_stats *s,
+                                          unsigned msgnum)
+{
+    if (s != NULL && msgnum < s->nmsgs) {
+        s->msgs[msgnum].tx_busy++;
+    }
+}
+
+static inline void flounder_stats_rx_start(struct flounder_binding_stats *s)
+{
+    if (s != NULL) {
+        s->rx_start = flounder_stats_now();
+    }
+}
+
+static inline void flounder_stats_rx_done(struct flounder_binding_stats *s,
+                                          unsigned msgnum)
+{
+    if (s == NULL || msgnum >= s->nmsgs) {
+        return;
+    }
+
+    struct flounder_msg_stats *m = &s->msgs[msgnum];
+    cycles_t t = flounder_stats_now() - s->rx_start;
+
+    m->rx++;
+    m->rx_cycles += t;
+    if (t > m->rx_cycles_max) {
+        m->rx_cycles_max = t;
+    }
+}
+
+static inline void flounder_stats_register_send(struct flounder_binding_stats *s,
+                                                bool can_send)
+{
+    if (s != NULL && !can_send && s->register_start == 0) {
+        s->register_waits++;
+        s->register_start = flounder_stats_now();
+    }
+}
+
+static inline void flounder_stats_txq_enqueue(struct flounder_binding_stats *s,
+                                              bool backlogged)
+{
+    if (s == NULL) {
+        return;
+    }
+
+    if (backlogged) {
+        s->txq_backlogged++;
+    }
+    if (++s->txq_depth > s->txq_depth_max) {
+        s->txq_depth_max = s->txq_depth;
+    }
+}
+
+static inline void flounder_stats_txq_dequeue(struct flounder_binding_stats *s)
+{
+    if (s != NULL && s->txq_depth > 0) {
+        s->txq_depth--;
+    }
+}
+
+__END_DECLS
+
+#endif // __FLOUNDER_STATS_H
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2010, 2011, ETH Zurich.
+ * Copyright (c) 2010, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -16,6 +16,7 @@
 #define __FLOUNDER_SUPPORT_H
 
 #include <flounder/flounder.h>
+#include <flounder/flounder_stats.h>
 #include <sys/cdefs.h>
 
 __BEGIN_DECLS
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2010, ETH Zurich.
+ * Copyright (c) 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -17,7 +17,9 @@
 
 #include <sys/cdefs.h>
 
+#include <barrelfish/idc.h>
 #include <barrelfish/ump_chan.h>
+#include <barrelfish/deferred.h>
 #include <flounder/flounder_support_caps.h>
 #include <trace/trace.h>
 
@@ -34,6 +36,31 @@ enum flounder_ump_msgtype {
     FL_UMP_CAP_ACK = (1 << FL_UMP_MSGTYPE_BITS) - 1,
 };
 
+/// Notify at least once every this many messages when batching
+#ifndef FLOUNDER_UMP_BATCH_MAX
+#define FLOUNDER_UMP_BATCH_MAX      16
+#endif
+
+/// Deadline (us) after which a partial batch is notified
+#ifndef FLOUNDER_UMP_BATCH_DELAY
+#define FLOUNDER_UMP_BATCH_DELAY    50
+#endif
+
+/**
+ * Notification batching (IDC_CONTROL_SET_BATCH). The notification of a
+ * message is held back until FLOUNDER_UMP_BATCH_MAX messages are pending,
+ * the channel runs full, the binding is flushed with IDC_CONTROL_FLUSH or
+ * the deadline passes. The deadline is an event on the binding's waitset.
+ */
+struct flounder_ump_batch {
+    bool enabled;
+    bool armed;                 ///< Deadline event is registered
+    uint32_t pending;           ///< Messages sent since the last notification
+    uint32_t max;               ///< Notify at least every max messages
+    delayus_t delay;            ///< Deadline of a partial batch
+    struct deferred_event deadline;
+};
+
 struct flounder_ump_state {
     struct ump_chan chan;
 
@@ -43,6 +70,7 @@ struct flounder_ump_state {
     ump_index_t last_ack;  ///< Last acknowledgement we sent to remote
 
     struct flounder_cap_state capst; ///< State for indirect cap tx/rx machinery
+    struct flounder_ump_batch batch; ///< Notification batching
 };
 
 void flounder_stub_ump_state_init(struct flounder_ump_state *s, void *binding);
@@ -61,6 +89,17 @@ errval_t flounder_stub_ump_send_buf(struct flounder_ump_state *s,
 errval_t flounder_stub_ump_recv_buf(volatile struct ump_message *msg,
                                     void **buf, size_t *len, size_t *pos);
 
+bool flounder_stub_ump_batch_control(struct flounder_ump_batch *b,
+                                     idc_control_t control);
+bool flounder_stub_ump_batch_defer(struct flounder_ump_batch *b,
+                                   struct waitset *ws,
+                                   struct event_closure flush);
+void flounder_stub_ump_batch_flushed(struct flounder_ump_batch *b);
+bool flounder_stub_ump_batch_change_waitset(struct flounder_ump_batch *b,
+                                            struct waitset *ws,
+                                            struct event_closure flush);
+void flounder_stub_ump_batch_destroy(struct flounder_ump_batch *b);
+
 /// Computes (from seq/ack numbers) whether we can currently send on the channel
 static inline bool flounder_stub_ump_can_send(struct flounder_ump_state *s) {
     return (ump_index_t)(s->next_id - s->ack_id) <= s->chan.max_send_msgs;
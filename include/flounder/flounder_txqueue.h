@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014, ETH Zurich.
+ * Copyright (c) 2014, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -26,6 +26,7 @@
 
 struct tx_queue;
 struct txq_msg_st;
+struct flounder_binding_stats;
 
 /// Utility macro to construct a continuation structure (handler & arg)
 #define TXQCONT(a) MKCLOSURE(txq_sent_cb,a)
@@ -49,6 +50,7 @@ struct tx_queue
     struct txq_msg_st *tail;         ///< tail of the queue
     struct txq_msg_st *free;         ///< free list of message states
     uint32_t msg_st_size;            ///< size of the message state
+    struct flounder_binding_stats *stats; ///< statistics of the binding
 #ifdef FLOUNDER_TXQUEUE_DEBUG
     uint32_t free_count;
     uint32_t alloc_count;
@@ -83,6 +85,17 @@ void txq_init(struct tx_queue *queue,
               txq_register_fn_t register_send,
               uint32_t msg_st_size);
 
+/**
+ * \brief accounts the queue in the statistics of the binding
+ *
+ * Only has an effect if built with FLOUNDER_STATS.
+ *
+ * \param queue         TX queue
+ * \param stats         statistics of the binding (binding->stats)
+ */
+void txq_set_stats(struct tx_queue *queue,
+                   struct flounder_binding_stats *stats);
+
 /**
  * \brief allocates new message state for an outgoing flounder message
  *
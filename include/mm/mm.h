@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2008, 2011, ETH Zurich.
+ * Copyright (c) 2008, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -38,6 +38,29 @@ struct mmnode {
     struct mmnode *children[0];///< Child node pointers
 };
 
+/// Placement policy for allocations, see mm_set_placement()
+enum mm_placement {
+    MM_PLACEMENT_FIRST_FIT, ///< Lowest-addressed free node that fits (default)
+    MM_PLACEMENT_BEST_FIT,  ///< Smallest free node that fits
+};
+
+/// Number of size classes tracked in #mm_stats, indexed by size in bits
+#define MM_STATS_BITS   64
+
+/**
+ * \brief Free space of a memory manager, broken down by block size
+ *
+ * Kept up to date by the allocator on every operation, so it is cheap to
+ * query. A free block is a free leaf node of the tree; free neighbours are
+ * never merged, so the free memory available for a request of a given size
+ * is the memory in free blocks of at least that size.
+ */
+struct mm_stats {
+    genpaddr_t free_bytes;                  ///< Total free memory
+    size_t free_blocks[MM_STATS_BITS];      ///< Free blocks per size (bits)
+    uint64_t splits;                        ///< Free blocks split up so far
+};
+
 /// Macro to statically determine size of a node, given the maxchildbits
 #define MM_NODE_SIZE(maxchildbits) \
     (sizeof(struct mmnode) + sizeof(struct mmnode *) * (1UL << (maxchildbits)))
@@ -58,6 +81,8 @@ struct mm {
     uint8_t sizebits;       ///< Size of root node (in bits)
     uint8_t maxchildbits;   ///< Maximum number of children of every node (in bits)
     bool delete_chunked;    ///< Delete chunked capabilities if true
+    enum mm_placement placement; ///< Placement policy for allocations
+    struct mm_stats stats;  ///< Free space statistics
 };
 
 void mm_debug_print(struct mmnode *mmnode, int space);
@@ -67,6 +92,9 @@ errval_t mm_init(struct mm *mm, enum objtype objtype, genpaddr_t base,
                  slot_alloc_t slot_alloc_func, void *slot_alloc_inst,
                  bool delete_chunked);
 void mm_destroy(struct mm *mm);
+void mm_set_placement(struct mm *mm, enum mm_placement placement);
+genpaddr_t mm_free_bytes_at_least(struct mm *mm, uint8_t sizebits);
+void mm_print_stats(struct mm *mm);
 errval_t mm_add(struct mm *mm, struct capref cap, uint8_t sizebits,
                 genpaddr_t base);
 errval_t mm_add_multi(struct mm *mm, struct capref cap, gensize_t size,
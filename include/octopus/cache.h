@@ -0,0 +1,33 @@
+/**
+ * \file
+ * \brief Header file for the client-side record cache.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef OCTOPUS_CACHE_H_
+#define OCTOPUS_CACHE_H_
+
+#include <barrelfish/barrelfish.h>
+
+struct oct_cache_stats {
+    uint64_t hits;          ///< Served from the cache
+    uint64_t misses;        ///< Not in the cache, fetched from the server
+    uint64_t expired;       ///< In the cache but older than the bound
+    uint64_t invalidations; ///< Entries dropped because a trigger fired
+    uint64_t evictions;     ///< Entries replaced by another query
+};
+
+errval_t oct_cache_enable(delayus_t max_staleness);
+void oct_cache_disable(void);
+void oct_cache_flush(void);
+void oct_cache_get_stats(struct oct_cache_stats* stats);
+
+#endif /* OCTOPUS_CACHE_H_ */
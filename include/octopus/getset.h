@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2011, ETH Zurich.
+ * Copyright (c) 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -33,6 +33,7 @@ errval_t oct_parse_names(char* input, char*** names, size_t*);
 void oct_free_names(char**, size_t);
 
 errval_t oct_get(char**, const char*, ...);
+errval_t oct_get_uncached(char**, const char*, ...);
 errval_t oct_set(const char*, ...);
 errval_t oct_get_with_idcap(char**, struct capref);
 errval_t oct_set_with_idcap(struct capref, const char*, ...);
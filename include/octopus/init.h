@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2011, ETH Zurich.
+ * Copyright (c) 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -32,5 +32,6 @@ struct octopus_binding;
 
 struct octopus_thc_client_binding_t* oct_get_thc_client(void);
 struct octopus_binding* oct_get_event_binding(void);
+struct octopus_thc_client_binding_t* oct_get_thc_client_for(const char* key);
 
 #endif /* OCTOPUS_INIT_H_ */
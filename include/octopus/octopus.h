@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2011, ETH Zurich.
+ * Copyright (c) 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -22,5 +22,7 @@
 #include <octopus/barrier.h>
 #include <octopus/semaphores.h>
 #include <octopus/trigger.h>
+#include <octopus/cache.h>
+#include <octopus/shards.h>
 
 #endif /* OCTOPUS_H_ */
@@ -0,0 +1,32 @@
+/**
+ * \file
+ * \brief Header file for the partitioned octopus deployment.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef OCTOPUS_SHARDS_H_
+#define OCTOPUS_SHARDS_H_
+
+#include <barrelfish/barrelfish.h>
+#include <octopus/trigger.h>
+
+#define OCT_MAX_SHARDS 16
+
+/// Written by the primary server: number of shards including itself
+#define OCT_SHARDS_RECORD "octopus.shards"
+/// Written by every other shard once it accepts connections
+#define OCT_SHARD_RECORD_FMT "octopus.shard.%zu"
+
+size_t oct_shard_count(void);
+bool oct_is_replicated(const char* name);
+errval_t oct_shard_mirror(trigger_handler_fn fn, void* state);
+
+#endif /* OCTOPUS_SHARDS_H_ */
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2011, ETH Zurich.
+ * Copyright (c) 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -20,5 +20,10 @@
 errval_t init_capstorage(void);
 errval_t rpc_server_init(void);
 errval_t oct_server_init(void);
+errval_t rpc_shard_server_init(iref_t* iref);
+
+// Partitioned deployment (shards.c)
+errval_t oct_server_set_shard_count(size_t count);
+errval_t oct_shard_server_init(size_t shard);
 
 #endif /* OCTOPUS_INIT_H_ */
@@ -0,0 +1,61 @@
+/**
+ * \file
+ * \brief Vectorised copy and Internet checksum kernels for packet data
+ */
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef _PKTCOPY_H_
+#define _PKTCOPY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/*
+ * The implementation is picked on first use: AVX2 if the CPU has it and the
+ * OS saves the YMM state, otherwise SSE2 on x86_64, and portable C on all
+ * other architectures.
+ *
+ * Checksums are the 16-bit one's complement sum of the buffer in host byte
+ * order, not inverted, like the lwIP LWIP_CHKSUM routines. The buffer may
+ * start at any address. Sums over consecutive pieces of a packet can be
+ * combined with pktcopy_chksum_add(), provided every piece but the last has
+ * an even length.
+ */
+
+typedef enum {
+    PKTCOPY_IMPL_GENERIC,
+    PKTCOPY_IMPL_SSE2,
+    PKTCOPY_IMPL_AVX2,
+} pktcopy_impl_t;
+
+void     *pktcopy_memcpy(void *dst, const void *src, size_t len);
+uint16_t  pktcopy_chksum(const void *data, size_t len);
+uint16_t  pktcopy_memcpy_chksum(void *dst, const void *src, size_t len);
+
+/*
+ * Select an implementation, for benchmarks and tests. Fails with -1 if the
+ * CPU does not support it.
+ */
+int             pktcopy_set_impl(pktcopy_impl_t impl);
+pktcopy_impl_t  pktcopy_get_impl(void);
+const char     *pktcopy_impl_name(pktcopy_impl_t impl);
+
+static inline uint16_t pktcopy_chksum_add(uint16_t a, uint16_t b)
+{
+    uint32_t sum = (uint32_t)a + b;
+    return (uint16_t)((sum & 0xffff) + (sum >> 16));
+}
+
+__END_DECLS
+
+#endif
@@ -17,6 +17,19 @@
 
 #include <sys/cdefs.h>
 
+/// Phases of domain construction, timed in spawninfo.phase_cycles
+enum spawn_phase {
+    SPAWN_PHASE_RAM,            ///< Batched allocation of kernel objects
+    SPAWN_PHASE_CSPACE,         ///< CNodes, dispatcher and base pages
+    SPAWN_PHASE_VSPACE,         ///< Page table root and vspace
+    SPAWN_PHASE_LOAD,           ///< ELF loading or image instantiation
+    SPAWN_PHASE_DISPATCHER,     ///< Dispatcher frame and inherited caps
+    SPAWN_PHASE_ENV,            ///< Arguments, environment and pmap
+    SPAWN_PHASE_COUNT
+};
+
+struct spawn_ram_batch;
+
 //XXX: added alignment to workaround an arm-gcc bug
 //which generated (potentially) unaligned access code to those fields
 /**
@@ -68,11 +81,65 @@ struct spawninfo {
 
     // spawn flags
     uint8_t flags;
+
+    // RAM for the kernel objects of the domain, NULL once they are created
+    struct spawn_ram_batch *ram;
+
+    // cycles spent in each phase of construction (x86_64 only, else 0)
+    uint64_t phase_cycles[SPAWN_PHASE_COUNT];
+};
+
+#define SPAWN_IMAGE_MAX_SEGMENTS 16
+
+/**
+ * \brief A loadable segment of a pre-loaded image.
+ *
+ * The segment is backed by frames in the image's CNode, starting at
+ * first_slot and split into naturally-aligned power-of-two pieces.
+ */
+struct spawn_image_segment {
+    genvaddr_t base;            ///< Page-aligned base address in new domains
+    size_t size;                ///< Page-aligned size
+    vregion_flags_t flags;      ///< Mapping flags from the program header
+    cslot_t first_slot;         ///< First frame slot in the image CNode
+    cslot_t nslots;             ///< Number of frames backing the segment
+    struct vregion *vregion;    ///< Mapping in the loading domain
+    void *buf;                  ///< Address of the mapping in the loading domain
+};
+
+/**
+ * \brief An ELF image loaded once and instantiated into many domains.
+ *
+ * Read-only segments are shared by all domains spawned from the image,
+ * writable segments are copied from the pristine pre-loaded version.
+ */
+struct spawn_image {
+    enum cpu_type cpu_type;
+    struct capref cnode_cap;
+    struct cnoderef cnode;
+    cslot_t next_slot;
+
+    genvaddr_t entry;
+    void *arch_info;
+
+    // TLS data
+    genvaddr_t tls_init_base;
+    size_t tls_init_len, tls_total_len;
+
+    // Error handling data
+    genvaddr_t eh_frame;
+    size_t eh_frame_size;
+    genvaddr_t eh_frame_hdr;
+    size_t eh_frame_hdr_size;
+
+    struct spawn_image_segment segment[SPAWN_IMAGE_MAX_SEGMENTS];
+    unsigned int segments;
 };
 
 #define SPAWN_FLAGS_DEFAULT (0)
 #define SPAWN_FLAGS_NEW_DOMAIN    (1 << 0) ///< allocate a new domain ID
 #define SPAWN_FLAGS_OMP           (1 << 1) ///< do the OpenMP parsing
+#define SPAWN_FLAGS_NO_IMAGE_CACHE (1 << 2) ///< load the binary, bypassing spawnd's image cache
 
 typedef uint8_t spawn_flags_t;
 
@@ -91,8 +158,20 @@ errval_t spawn_load_image(struct spawninfo *si, lvaddr_t binary,
                           char *const argv[], char *const envp[],
                           struct capref inheritcn_cap, struct capref argcn_cap);
 errval_t spawn_run(struct spawninfo *si);
+const char *spawn_phase_name(enum spawn_phase phase);
 errval_t spawn_free(struct spawninfo *si);
 
+/* spawn_image.c */
+errval_t spawn_image_create(struct spawn_image **retimg, lvaddr_t binary,
+                            size_t binary_size, enum cpu_type type);
+errval_t spawn_image_destroy(struct spawn_image *img);
+size_t spawn_image_shared_bytes(struct spawn_image *img);
+errval_t spawn_load_shared_image(struct spawninfo *si, struct spawn_image *img,
+                                 const char *name, coreid_t coreid,
+                                 char *const argv[], char *const envp[],
+                                 struct capref inheritcn_cap,
+                                 struct capref argcn_cap);
+
 errval_t multiboot_cleanup_mapping(void);
 
 /* spawn_vspace.c */
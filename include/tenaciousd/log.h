@@ -1,5 +1,6 @@
 /*
  * Copyright (c) 2014, University of Washington.
+ * Copyright (c) 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -16,12 +17,19 @@ struct storage_vsic;
 #define TENACIOUSD_LOG_MIN_ENTRY_SIZE(log)      \
     (STORAGE_VSIC_ROUND(log->vsic, sizeof(struct tenaciousd_log_entry)) - sizeof(struct tenaciousd_log_entry))
 
-// sizeof(struct tenaciousd_log_entry) = on-disk size of header + footer
+// Default maximum number of appends per group commit. Every append is
+// durable on return, group commit is enabled with tenaciousd_log_set_batch().
+#define TENACIOUSD_LOG_DEFAULT_BATCH    1
+
+// Commit early once this many bytes are staged
+#define TENACIOUSD_LOG_MAX_BATCH_BYTES  (256 * 1024)
+
+// sizeof(struct tenaciousd_log_entry) = on-disk size of header
 struct tenaciousd_log_entry {
   uint64_t	size;
   uint64_t	next;		// Only valid on disk
+  uint32_t	checksum;	// Only valid on disk
   uint8_t	data[0];
-  uint8_t	marker;		// Never valid
 } __attribute__ ((packed));
 
 struct tenaciousd_log_iter {
@@ -34,7 +42,17 @@ struct tenaciousd_log {
     struct storage_vsa *vsa;
     struct storage_vsic *vsic;
     uint64_t entries;
+    uint64_t start;             ///< Offset of the first entry not trimmed
     uint64_t end;
+    uint32_t generation;        ///< Bumped by every compaction
+
+    // Group commit: appends are staged here and written out together
+    uint8_t *batch;
+    size_t batch_size;          ///< Allocated size of batch
+    size_t batch_fill;          ///< Bytes staged
+    size_t batch_entries;       ///< Entries staged
+    size_t batch_limit;         ///< Commit once this many entries are staged
+    uint64_t batch_offset;      ///< On-disk offset of the staged entries
 };
 
 struct tenaciousd_log *tenaciousd_log_new(struct storage_vsa *vsa,
@@ -45,6 +63,10 @@ errval_t tenaciousd_log_delete(struct tenaciousd_log *log);
 errval_t tenaciousd_log_append(struct tenaciousd_log *log,
                                struct tenaciousd_log_entry *entry);
 
+errval_t tenaciousd_log_commit(struct tenaciousd_log *log);
+
+void tenaciousd_log_set_batch(struct tenaciousd_log *log, size_t nentries);
+
 errval_t tenaciousd_log_trim(struct tenaciousd_log *log, int nentries);
 
 struct tenaciousd_log_iter tenaciousd_log_begin(struct tenaciousd_log *log);
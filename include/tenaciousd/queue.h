@@ -1,5 +1,6 @@
 /*
  * Copyright (c) 2014, University of Washington.
+ * Copyright (c) 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -13,13 +14,20 @@
 struct storage_vsa;
 struct storage_vsic;
 
+// Default maximum number of adds per group commit. Every add is durable on
+// return, group commit is enabled with tenaciousd_queue_set_batch().
+#define TENACIOUSD_QUEUE_DEFAULT_BATCH  1
+
+// Commit early once this many bytes are staged
+#define TENACIOUSD_QUEUE_MAX_BATCH_BYTES (256 * 1024)
+
 struct tenaciousd_queue_element {
   uint8_t 	valid;
   uint64_t	size;
   uint64_t	prev;
   uint64_t	next;		// Only valid on disk
+  uint32_t	checksum;	// Only valid on disk
   uint8_t	data[0];
-  uint8_t	marker;		// Never valid
 } __attribute__ ((packed));
 
 struct tenaciousd_queue_iter {
@@ -33,6 +41,14 @@ struct tenaciousd_queue {
   uint64_t elements;
   uint64_t last;
   uint64_t end;
+
+  // Group commit: adds are staged here and written out together
+  uint8_t *batch;
+  size_t batch_size;            ///< Allocated size of batch
+  size_t batch_fill;            ///< Bytes staged
+  size_t batch_elements;        ///< Elements staged
+  size_t batch_limit;           ///< Commit once this many elements are staged
+  uint64_t batch_offset;        ///< On-disk offset of the staged elements
 };
 
 void tenaciousd_queue_delete_element(struct tenaciousd_queue *queue,
@@ -50,6 +66,10 @@ tenaciousd_queue_element_new(struct tenaciousd_queue *queue,
 errval_t tenaciousd_queue_add(struct tenaciousd_queue *log,
                                struct tenaciousd_queue_element *element);
 
+errval_t tenaciousd_queue_commit(struct tenaciousd_queue *queue);
+
+void tenaciousd_queue_set_batch(struct tenaciousd_queue *queue, size_t nelements);
+
 struct tenaciousd_queue_element * 
 tenaciousd_queue_remove(struct tenaciousd_queue *queue);
 
@@ -33,10 +33,14 @@ enum fdtab_type {
 };
 
 #include <signal.h>
+#include <stdbool.h>
 #include <sys/epoll.h>
 
 struct _epoll_events_list {
     struct _epoll_events_list *prev, *next;
+    struct _epoll_events_list *ready_prev, *ready_next; ///< Ready list links
+    bool ready;                 ///< Entry is on the ready list
+    void *epoll;                ///< Epoll instance the entry belongs to
     struct epoll_event event;
     int fd;
 };
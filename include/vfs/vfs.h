@@ -12,6 +12,7 @@
 
 #include <errors/errno.h> // for errval_t
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/cdefs.h>
 #include <sys/types.h>
 
@@ -50,6 +51,7 @@ enum vfs_filetype {
 struct vfs_fileinfo {
     enum vfs_filetype type; ///< Type of the object
     size_t size;            ///< Size of the object (in bytes, for a regular file)
+    uint64_t mtime;         ///< Last modification time (backend-specific, 0 if unknown)
 };
 
 __BEGIN_DECLS
@@ -15,9 +15,13 @@
 
 __BEGIN_DECLS
 
+struct iovec;
+
 int   vfsfd_open(const char *pathname, int flags);
 int   vfsfd_read(int fd, void *buf, size_t len);
 int   vfsfd_write(int fd, const void *buf, size_t len);
+ssize_t vfsfd_readv(int fd, const struct iovec *iov, int iovcnt);
+ssize_t vfsfd_writev(int fd, const struct iovec *iov, int iovcnt);
 int   vfsfd_close(int fd);
 off_t vfsfd_lseek(int fd, off_t off, int whence);
 
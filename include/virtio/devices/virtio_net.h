@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -10,5 +10,202 @@
 #ifndef VIRTIO_DEVICES_VIRTIO_NET_H
 #define VIRTIO_DEVICES_VIRTIO_NET_H
 
+/*
+ * 5.1 Network Device
+ * The virtio network device is a virtual ethernet card. Packets are sent and
+ * received over pairs of a receive and a transmit virtqueue. With
+ * VIRTIO_NET_F_MQ the device has up to max_virtqueue_pairs of them and
+ * steers the received flows onto the pairs in use.
+ *
+ * Device ID = 1
+ *
+ * Virtqueues: receiveq1 (0), transmitq1 (1), ..., receiveqN (2N-2),
+ *             transmitqN (2N-1), controlq (2N)
+ */
+
+#define VIRTIO_NET_FLOUNDER_IFACE "vnet_host"
+
+/// the maximum number of queue pairs this library handles
+#define VIRTIO_NET_MAX_QUEUE_PAIRS 16
+
+/*
+ * --------------------------------------------------------------------------
+ * 5.1.3 Feature Bits
+ * --------------------------------------------------------------------------
+ */
+
+/// Device handles packets with partial checksum
+#define VIRTIO_NET_F_CSUM           0
+
+/// Driver handles packets with partial checksum
+#define VIRTIO_NET_F_GUEST_CSUM     1
+
+/// Device has given MAC address
+#define VIRTIO_NET_F_MAC            5
+
+/// Driver can merge receive buffers
+#define VIRTIO_NET_F_MRG_RXBUF      15
+
+/// Configuration status field is available
+#define VIRTIO_NET_F_STATUS         16
+
+/// Control channel is available
+#define VIRTIO_NET_F_CTRL_VQ        17
+
+/// Device supports multiqueue with automatic receive steering
+#define VIRTIO_NET_F_MQ             22
+
+/*
+ * --------------------------------------------------------------------------
+ * Device Configuration Layout
+ * --------------------------------------------------------------------------
+ */
+
+/// the link is up
+#define VIRTIO_NET_S_LINK_UP  1
+
+/// the driver has to send a gratuitous packet
+#define VIRTIO_NET_S_ANNOUNCE 2
+
+/**
+ * The device configuration layout as specified by 5.1.4
+ */
+struct virtio_net_config
+{
+    uint8_t mac[6];                 ///< only valid with VIRTIO_NET_F_MAC
+    uint16_t status;                ///< only valid with VIRTIO_NET_F_STATUS
+    uint16_t max_virtqueue_pairs;   ///< only valid with VIRTIO_NET_F_MQ
+}__attribute__((packed));
+
+/*
+ * --------------------------------------------------------------------------
+ * Device Operations
+ * --------------------------------------------------------------------------
+ */
+
+/// no gso is done on this packet
+#define VIRTIO_NET_HDR_GSO_NONE 0
+
+/**
+ * Every packet is preceded by this header (5.1.6). The num_buffers field is
+ * always present on VirtIO 1.0 devices.
+ */
+struct virtio_net_hdr
+{
+    uint8_t flags;
+    uint8_t gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;
+    uint16_t csum_offset;
+    uint16_t num_buffers;
+}__attribute__((packed));
+
+/**
+ * header of a request on the control virtqueue (5.1.6.5)
+ */
+struct virtio_net_ctrl_hdr
+{
+    uint8_t class;
+    uint8_t cmd;
+}__attribute__((packed));
+
+/// the command was executed
+#define VIRTIO_NET_OK     0
+
+/// the command failed
+#define VIRTIO_NET_ERR    1
+
+/// Multiqueue control class
+#define VIRTIO_NET_CTRL_MQ                 4
+
+/// set the number of queue pairs in use
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET    0
+
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MIN    1
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MAX    0x8000
+
+/**
+ * stores additional information for the VirtIO network device
+ */
+struct virtio_device_net
+{
+    struct virtio_device *vdev;
+    struct virtio_net_config config;
+    uint16_t max_pairs;             ///< number of queue pairs of the device
+    uint16_t num_pairs;             ///< number of allocated queue pairs
+    struct virtqueue *ctrl_vq;      ///< control virtqueue, may be NULL
+    struct virtqueue *rx_vq[VIRTIO_NET_MAX_QUEUE_PAIRS];
+    struct virtqueue *tx_vq[VIRTIO_NET_MAX_QUEUE_PAIRS];
+};
+
+/**
+ * \brief returns the index of the receive virtqueue of a queue pair
+ */
+static inline uint16_t virtio_net_rx_queue_index(uint16_t pair)
+{
+    return 2 * pair;
+}
+
+/**
+ * \brief returns the index of the transmit virtqueue of a queue pair
+ */
+static inline uint16_t virtio_net_tx_queue_index(uint16_t pair)
+{
+    return 2 * pair + 1;
+}
+
+/**
+ * \brief reads the device configuration and copies it into the local memory
+ *
+ * \param dev the network device to read the configuration space.
+ *
+ * \returns SYS_ERR_OK on success
+ */
+errval_t virtio_net_config_read(struct virtio_device_net *dev);
+
+/**
+ * \brief returns the MAC address of the device as a 48 bit integer
+ *
+ * \param dev the network device
+ */
+static inline uint64_t virtio_net_get_mac(struct virtio_device_net *dev)
+{
+    uint64_t mac = 0;
+    for (int i = 0; i < 6; ++i) {
+        mac |= ((uint64_t) dev->config.mac[i]) << (8 * i);
+    }
+    return mac;
+}
+
+/**
+ * \brief   handles the VirtIO network device common initialization.
+ *
+ * \param   dev     the VirtIO network device
+ * \param   setup   the setup information
+ *
+ * setup->vq_setup holds the receive and transmit virtqueue of every queue
+ * pair (setup->vq_num = 2 * pairs). Fewer pairs are allocated if the device
+ * has less. The control virtqueue is allocated by the library.
+ *
+ * \returns SYS_ERR_OK on success
+ */
+errval_t virtio_net_init_device(struct virtio_device_net *dev,
+                                struct virtio_device_setup *setup);
+
+/**
+ * \brief tells the device how many queue pairs the driver uses
+ *
+ * \param dev   the VirtIO network device
+ * \param pairs number of queue pairs, at most dev->num_pairs
+ *
+ * This has to be done after the device is live. Until then, the device only
+ * delivers packets to the first queue pair.
+ *
+ * \returns SYS_ERR_OK on success
+ *          VIRTIO_ERR_NET_CTRL if the device rejected the command
+ */
+errval_t virtio_net_set_queue_pairs(struct virtio_device_net *dev,
+                                    uint16_t pairs);
 
 #endif // VIRTIO_DEVICES_VIRTIO_NET_H
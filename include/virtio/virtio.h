@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -28,6 +28,9 @@
 /// guest should never set this feature. This indicates faulty drivers
 #define VIRTIO_F_BAD_FEATURE (1 << 30)
 
+/// feature bit number: the device complies with VirtIO 1.0 or later
+#define VIRTIO_F_VERSION_1 32
+
 /// range of the transport related feature bits
 #define VIRTIO_TRANSPORT_F_START    28
 #define VIRTIO_TRANSPORT_F_END      32
@@ -211,6 +211,21 @@ errval_t virtio_device_open_with_cap(struct virtio_device **dev,
                                      struct virtio_device_setup *init,
                                      struct capref dev_cap);
 
+/**
+ * \brief attaches to a VirtIO device which has been initialized by another
+ *        domain. The device registers have already to be mapped.
+ *
+ * \param dev       returns the device structure
+ * \param init      information about the device and its backend
+ * \param features  the features negotiated by the owner of the device
+ *
+ * The device status is not changed. This is used by drivers which serve some
+ * of the virtqueues of a device in their own domain.
+ */
+errval_t virtio_device_attach(struct virtio_device **dev,
+                              struct virtio_device_setup *init,
+                              uint64_t features);
+
 /**
  * \brief   closes a virtio device.
  *
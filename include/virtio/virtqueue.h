@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -78,6 +78,16 @@ struct virtqueue_setup {
 #endif
 };
 
+/**
+ * a descriptor chain returned by the device, see
+ * virtio_virtqueue_desc_dequeue_batch()
+ */
+struct virtqueue_used {
+    struct virtio_buffer_list *bl;      ///< buffer list of the chain
+    void *st;                           ///< state passed when enqueuing
+    uint32_t length;                    ///< number of bytes the device wrote
+};
+
 /**
  *
  */
@@ -208,6 +218,15 @@ bool virtio_virtqueue_is_full(struct virtqueue *vq);
  */
 uint16_t virtio_virtqueue_get_num_used(struct virtqueue *vq);
 
+/**
+ * \brief Returns the number of free descriptors of this virtqueue
+ *
+ * \param vq pointer to the virtqueue structure
+ *
+ * \returns number of free descriptors
+ */
+uint16_t virtio_virtqueue_get_num_free(struct virtqueue *vq);
+
 /**
  * \brief returns the number of bits if there are alrady allocated buffers
  *        for this queue
@@ -229,6 +248,20 @@ uint8_t virtio_virtqueue_has_buffers(struct virtqueue *vq);
  */
 lvaddr_t virtio_virtqueue_buffer_vbase(struct virtqueue *vq);
 
+/**
+ * \brief returns the header area allocated with the vring (setup.header_bits)
+ *
+ * \param vq        the virtqueue
+ * \param ret_vbase returns the virtual base of the header area
+ * \param ret_pbase returns the physical base of the header area
+ *
+ * \returns SYS_ERR_OK on success
+ *          VIRTIO_ERR_NO_BUFFER if no headers were allocated
+ */
+errval_t virtio_virtqueue_get_headers(struct virtqueue *vq,
+                                      lvaddr_t *ret_vbase,
+                                      lpaddr_t *ret_pbase);
+
 /*
  * ===========================================================================
  * Interrupt handling
@@ -287,6 +320,9 @@ void virtio_virtqueue_intr_disable(struct virtqueue *vq);
  * \brief notifies the host about the new queued descriptors
  *
  * \param vq virtqueue to notify the host
+ *
+ * Enqueued descriptor chains become visible to the host only with this call.
+ * With VIRTIO_RING_F_EVENT_IDX the host is only kicked if it asked for it.
  */
 void virtio_virtqueue_notify_host(struct virtqueue *vq);
 
@@ -348,6 +384,19 @@ errval_t virtio_virtqueue_desc_dequeue(struct virtqueue *vq,
                                        void **ret_st);
 
 
+/**
+ * \brief dequeues up to max descriptor chains from the virtqueue
+ *
+ * \param vq     the virtqueue to dequeue descriptors from
+ * \param used   array of at least max elements to store the chains in
+ * \param max    maximum number of chains to dequeue
+ *
+ * \returns number of dequeued descriptor chains
+ */
+uint16_t virtio_virtqueue_desc_dequeue_batch(struct virtqueue *vq,
+                                             struct virtqueue_used *used,
+                                             uint16_t max);
+
 /**
  * \brief polls the virtqueue
  *
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009,2011,2015, ETH Zurich.
+ * Copyright (c) 2009,2011,2015,2016, ETH Zurich.
  * Copyright (c) 2015, Hewlett Packard Enterprise Development LP.
  * All rights reserved.
  *
@@ -968,11 +968,6 @@ handle_invoke(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3,
                 /* limit length of message from buggy/malicious sender */
                 length_words = min(length_words, LMP_MSG_LENGTH);
 
-                // does the sender want to yield their timeslice on success?
-                bool sync = flags & LMP_FLAG_SYNC;
-                // does the sender want to yield to the target
-                // if undeliverable?
-                bool yield = flags & LMP_FLAG_YIELD;
                 // is the cap (if present) to be deleted on send?
                 bool give_away = flags & LMP_FLAG_GIVEAWAY;
 
@@ -993,16 +988,12 @@ handle_invoke(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3,
                                       give_away);
 
                 /* Switch to reciever upon successful delivery
-                 * with sync flag, or (some cases of)
-                 * unsuccessful delivery with yield flag */
+                 * with sync or call flag, when replying to a call,
+                 * or (some cases of) unsuccessful delivery with
+                 * yield flag */
                 enum err_code err_code = err_no(r.error);
-                if ((sync && err_is_ok(r.error)) ||
-                    (yield &&
-                        (err_code == SYS_ERR_LMP_BUF_OVERFLOW
-                         || err_code == SYS_ERR_LMP_CAPTRANSFER_DST_CNODE_LOOKUP
-                         || err_code == SYS_ERR_LMP_CAPTRANSFER_DST_CNODE_INVALID
-                         || err_code == SYS_ERR_LMP_CAPTRANSFER_DST_SLOT_OCCUPIED))
-                   ) {
+                if (lmp_switch_to_receiver(dcb_current, listener, flags,
+                                           r.error)) {
                     if (err_is_fail(r.error)) {
                         struct dispatcher_shared_generic *current_disp =
                             get_dispatcher_shared_generic(dcb_current->disp);
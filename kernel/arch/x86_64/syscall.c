@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, 2012, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -1303,10 +1303,6 @@ struct sysret sys_syscall(uint64_t syscall, uint64_t arg0, uint64_t arg1,
             /* limit length of message from buggy/malicious sender */
             length_words = MIN(length_words, LMP_MSG_LENGTH);
 
-            // does the sender want to yield their timeslice on success?
-            bool sync = flags & LMP_FLAG_SYNC;
-            // does the sender want to yield to the target if undeliverable?
-            bool yield = flags & LMP_FLAG_YIELD;
             // is the cap (if present) to be deleted on send?
             bool give_away = flags & LMP_FLAG_GIVEAWAY;
 
@@ -1314,15 +1310,11 @@ struct sysret sys_syscall(uint64_t syscall, uint64_t arg0, uint64_t arg1,
             retval.error = lmp_deliver(to, dcb_current, args, length_words,
                                        arg1, send_bits, give_away);
 
-            /* Switch to reciever upon successful delivery with sync flag,
-             * or (some cases of) unsuccessful delivery with yield flag */
+            /* Switch to reciever upon successful delivery with sync or call flag,
+             * when replying to a call, or (some cases of) unsuccessful delivery
+             * with yield flag */
             enum err_code err_code = err_no(retval.error);
-            if ((sync && err_is_ok(retval.error)) ||
-                (yield && (err_code == SYS_ERR_LMP_BUF_OVERFLOW
-                           || err_code == SYS_ERR_LMP_CAPTRANSFER_DST_CNODE_LOOKUP
-                           || err_code == SYS_ERR_LMP_CAPTRANSFER_DST_CNODE_INVALID
-                           || err_code == SYS_ERR_LMP_CAPTRANSFER_DST_SLOT_OCCUPIED))
-                    ) {
+            if (lmp_switch_to_receiver(dcb_current, listener, flags, retval.error)) {
                 if (err_is_fail(retval.error)) {
                     struct dispatcher_shared_generic *current_disp =
                         get_dispatcher_shared_generic(dcb_current->disp);
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, 2011, 2012, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2011, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -126,6 +126,9 @@ errval_t caps_delete_last(struct cte *cte, struct cte *ret_ram_cap)
         // Remove from wakeup queue
         wakeup_remove(dcb);
 
+        // Drop LMP call links, so no other dcb points to this one
+        lmp_call_unlink(dcb);
+
         // Notify monitor
         if (monitor_ep.u.endpoint.listener == dcb) {
             printk(LOG_ERR, "monitor terminated; expect badness!\n");
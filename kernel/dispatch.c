@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, 2011, 2013, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2011, 2013, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -470,3 +470,76 @@ errval_t lmp_deliver(struct capability *ep, struct dcb *send,
     assert(!(captransfer && err_is_fail(err)));
     return err;
 }
+
+/**
+ * \brief Forget the call \p dcb is the callee of, and the call it made.
+ *
+ * Called when \p dcb is deleted, so that no other dcb keeps a pointer to it.
+ */
+void lmp_call_unlink(struct dcb *dcb)
+{
+    if (dcb->lmp_caller != NULL) {
+        assert(dcb->lmp_caller->lmp_callee == dcb);
+        dcb->lmp_caller->lmp_callee = NULL;
+        dcb->lmp_caller = NULL;
+    }
+    if (dcb->lmp_callee != NULL) {
+        assert(dcb->lmp_callee->lmp_caller == dcb);
+        dcb->lmp_callee->lmp_caller = NULL;
+        dcb->lmp_callee = NULL;
+    }
+}
+
+/**
+ * \brief Decide whether an LMP send switches directly to the receiver
+ *
+ * The sender switches to the receiver upon successful delivery with the
+ * SYNC or CALL flag, or (some cases of) unsuccessful delivery with the YIELD
+ * flag. A successful CALL records the sender as the caller of the receiver,
+ * and the receiver's next successful send back to the caller switches
+ * straight back to it, whatever the flags of that send. Together with the
+ * scheduler charging the time the receiver runs to the caller, this gives a
+ * same-core RPC that runs on the caller's time slice and involves no
+ * scheduling decision on either side.
+ *
+ * \param send   Sending dispatcher
+ * \param recv   Receiving dispatcher
+ * \param flags  LMP send flags of the send
+ * \param err    Result of lmp_deliver()
+ *
+ * \returns true if the caller should dispatch \p recv right away.
+ */
+bool lmp_switch_to_receiver(struct dcb *send, struct dcb *recv,
+                            uint8_t flags, errval_t err)
+{
+    if (err_is_ok(err)) {
+        if (send->lmp_caller == recv) {
+            // reply to a call: return to the caller
+            assert(recv->lmp_callee == send);
+            recv->lmp_callee = NULL;
+            send->lmp_caller = NULL;
+            return true;
+        }
+        if (flags & LMP_FLAG_CALL) {
+            // a dispatcher is the caller and the callee of one call at most,
+            // the new call replaces older ones
+            if (recv->lmp_caller != NULL) {
+                recv->lmp_caller->lmp_callee = NULL;
+            }
+            if (send->lmp_callee != NULL) {
+                send->lmp_callee->lmp_caller = NULL;
+            }
+            recv->lmp_caller = send;
+            send->lmp_callee = recv;
+            return true;
+        }
+        return flags & LMP_FLAG_SYNC;
+    }
+
+    enum err_code err_code = err_no(err);
+    return (flags & LMP_FLAG_YIELD) &&
+        (err_code == SYS_ERR_LMP_BUF_OVERFLOW
+         || err_code == SYS_ERR_LMP_CAPTRANSFER_DST_CNODE_LOOKUP
+         || err_code == SYS_ERR_LMP_CAPTRANSFER_DST_CNODE_INVALID
+         || err_code == SYS_ERR_LMP_CAPTRANSFER_DST_SLOT_OCCUPIED);
+}
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -49,6 +49,10 @@ struct dcb {
     uint64_t            domain_id;      ///< ID of dispatcher's domain
     systime_t           wakeup_time;    ///< Time to wakeup this dispatcher
     struct dcb          *wakeup_prev, *wakeup_next; ///< Next/prev in timeout queue
+    /// Dispatcher that switched to us with LMP_FLAG_CALL and waits for a reply
+    struct dcb          *lmp_caller;
+    /// Dispatcher we switched to with LMP_FLAG_CALL, its lmp_caller is us
+    struct dcb          *lmp_callee;
 
     struct dcb          *next;          ///< Next DCB in schedule
     struct dcb          *prev;          ///< Previous DCB in schedule
@@ -87,6 +91,9 @@ errval_t lmp_deliver_payload(struct capability *ep, struct dcb *send,
 errval_t lmp_deliver(struct capability *ep, struct dcb *send,
                      uintptr_t *payload, size_t payload_len,
                      capaddr_t send_cptr, uint8_t send_bits, bool give_away);
+bool lmp_switch_to_receiver(struct dcb *send, struct dcb *recv,
+                            uint8_t flags, errval_t err);
+void lmp_call_unlink(struct dcb *dcb);
 
 /// Deliver an empty LMP as a notification
 static inline errval_t lmp_deliver_notification(struct capability *ep)
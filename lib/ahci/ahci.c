@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2011, 2012, ETH Zurich.
+ * Copyright (c) 2011, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -224,13 +224,18 @@ static void ahci_mgmt_command_completed_cb(struct ahci_mgmt_binding *b,
         assert(!"non-fatal error");
     }
 
+    struct ahci_binding *ahci_binding = bst->ahci_binding[port_id];
     uint32_t ci = ahci_port_ci_rd(&port_info->port);
+    uint32_t sact = ahci_port_sact_rd(&port_info->port);
 
     // which commands have been completed?
     for (int i = 0; i < 32; i++) {
         if (!port_info->command_slots[i].in_use || (ci & (1<<i))) {
             continue; // skip slots we didn't use or that have not been processed yet
         }
+        if (port_info->command_slots[i].ncq && (sact & (1<<i))) {
+            continue; // queued command accepted but not yet finished by device
+        }
 
         // free command table
         AHCI_DEBUG("freeing command table for slot %d (in_use=%d): %p\n",
@@ -244,11 +249,18 @@ static void ahci_mgmt_command_completed_cb(struct ahci_mgmt_binding *b,
         port_info->command_slots[i].in_use = false;
 
         AHCI_DEBUG("dispatching to user level\n");
-        // FIXME: does this make sense? will we even return to here in the near future?
-        bst->ahci_binding[port_id]->rx_vtbl.command_completed(bst->ahci_binding[port_id], tag);
+        if (port_info->command_slots[i].request != NULL) {
+            ahci_queue_complete(ahci_binding, i);
+        } else {
+            // FIXME: does this make sense? will we even return to here in the near future?
+            ahci_binding->rx_vtbl.command_completed(ahci_binding, tag);
+        }
         AHCI_DEBUG("return from user level\n");
     }
 
+    // issue requests that were waiting for a free slot
+    ahci_queue_kick(ahci_binding);
+
     AHCI_DEBUG("cc_cb exiting\n");
 }
 
@@ -415,6 +427,15 @@ errval_t ahci_issue_command(struct ahci_binding *_binding,
     struct ahci_port_info *port = &_binding->port_info;
     int command;
     AHCI_DEBUG("ahci_issue_command: fis_length = %zd\n", fis_length);
+
+    // a non-queued command would abort queued commands in the device
+    if (_binding->queue_outstanding > 0 && ahci_ncq_supported(_binding)) {
+        return AHCI_ERR_NCQ_ACTIVE;
+    }
+    if (ahci_find_free_command_slot(port) == -1) {
+        return AHCI_ERR_NO_FREE_SLOT;
+    }
+
     size_t num_prds = 0;
     if (buf) {
         assert((buflen & 1) == 0); // force even byte count
@@ -432,6 +453,8 @@ errval_t ahci_issue_command(struct ahci_binding *_binding,
 
     // save tag
     port->command_slots[command].tag = tag;
+    port->command_slots[command].ncq = false;
+    port->command_slots[command].request = NULL;
 
     if (buf) {
         err = ahci_add_physical_regions(port, command, buf, buflen);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2011 ETH Zurich.
+ * Copyright (c) 2011, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -10,6 +10,20 @@
 #ifndef _AHCI_INTERNAL_H
 #define _AHCI_INTERNAL_H
 
+struct ahci_request {
+    struct ahci_request *next;
+    bool is_write;
+    uint64_t lba;
+    struct ahci_dma_region *buf;
+    size_t buflen;
+    ahci_request_done_fn *done;
+    void *arg;
+};
+
+void ahci_queue_kick(struct ahci_binding *binding);
+
+void ahci_queue_complete(struct ahci_binding *binding, int command);
+
 void ahci_dump_command(int command, struct ahci_port_info *port);
 
 void ahci_dump_rfis(struct ahci_port_info *port);
@@ -0,0 +1,236 @@
+/**
+ * \file
+ * \brief Asynchronous request queue for AHCI ports
+ *
+ * Requests are queued in software and issued as soon as a command slot is
+ * free. On devices and HBAs that support Native Command Queuing they are
+ * issued as READ/WRITE FPDMA QUEUED commands, so that up to 32 of them are
+ * outstanding in the device at once and it can reorder them. Otherwise they
+ * are issued as READ/WRITE DMA EXT commands, which the HBA runs one after
+ * the other.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <barrelfish/barrelfish.h>
+#include <dev/ahci_hba_dev.h>
+#include <dev/ahci_port_dev.h>
+#include <ahci/ahci.h>
+#include <ahci/ahci_dma_pool.h>
+#include <ahci/ahci_util.h>
+#include <ahci/sata_fis.h>
+#include <string.h>
+#include "ahci_debug.h"
+#include "ahci_internal.h"
+
+// the sector count of FPDMA QUEUED and DMA EXT commands is 16 bits wide
+#define AHCI_QUEUE_MAX_SECTORS 0xFFFF
+
+bool ahci_ncq_supported(struct ahci_binding *_binding)
+{
+    struct ahci_port_info *port = &_binding->port_info;
+
+    return ahci_hba_cap_sncq_extract(port->hba_capabilities) &&
+           ata_identify_sataca_ncq_rdf(&_binding->identify);
+}
+
+size_t ahci_queue_depth(struct ahci_binding *_binding)
+{
+    struct ahci_port_info *port = &_binding->port_info;
+    size_t depth = ahci_hba_cap_ncs_extract(port->hba_capabilities) + 1;
+
+    if (ahci_ncq_supported(_binding)) {
+        size_t device_depth =
+            ata_identify_qdepth_maxqd_rdf(&_binding->identify) + 1;
+        if (device_depth < depth) {
+            depth = device_depth;
+        }
+    }
+
+    return depth;
+}
+
+/// Is a non-queued command from ahci_issue_command() outstanding?
+static bool ahci_port_has_unqueued(struct ahci_port_info *port)
+{
+    for (int i = 0; i < 32; i++) {
+        if (port->command_slots[i].in_use && !port->command_slots[i].ncq) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static errval_t ahci_queue_issue(struct ahci_binding *binding,
+        struct ahci_request *req, bool ncq)
+{
+    errval_t err;
+    struct ahci_port_info *port = &binding->port_info;
+    uint16_t sectors = req->buflen / BLOCK_SIZE;
+
+    struct sata_fis_reg_h2d fis;
+    memset(&fis, 0, sizeof(fis));
+    fis.type = SATA_FIS_TYPE_H2D;
+    fis.device = 1 << 6; // LBA mode
+    if (ncq) {
+        sata_set_command(&fis, req->is_write ? ATA_CMD_WRITE_FPDMA_QUEUED
+                                             : ATA_CMD_READ_FPDMA_QUEUED);
+        sata_set_ncq_count(&fis, sectors);
+    } else {
+        sata_set_command(&fis, req->is_write ? ATA_CMD_WRITE_DMA_EXT
+                                             : ATA_CMD_READ_DMA_EXT);
+        sata_set_count(&fis, sectors);
+    }
+    sata_set_lba48(&fis, req->lba);
+
+#ifdef AHCI_FIXED_PR_SIZE
+    size_t num_prds = CEIL_DIV(req->buflen, PR_SIZE);
+#else
+    size_t num_prds = CEIL_DIV(req->buflen, MAX_PR_SIZE);
+#endif
+
+    int command;
+    err = ahci_setup_command(&command, port, (uint8_t *)&fis, sizeof(fis),
+            num_prds, req->is_write);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct ahci_command_slot *slot = &port->command_slots[command];
+    if (ncq) {
+        // the tag is the command slot, patch it into the copied FIS
+        sata_set_ncq_tag(slot->command_table->vaddr, command);
+    }
+
+    err = ahci_add_physical_regions(port, command, req->buf, req->buflen);
+    if (err_is_fail(err)) {
+        ahci_dma_region_free(slot->command_table);
+        slot->command_table = NULL;
+        slot->in_use = false;
+        return AHCI_ERR_NO_FREE_PRD;
+    }
+
+    slot->tag = NULL;
+    slot->ncq = ncq;
+    slot->request = req;
+    binding->queue_outstanding++;
+
+    AHCI_DEBUG("ahci_queue_issue: slot %d, lba %"PRIu64", %"PRIu16
+            " sectors, ncq=%d\n", command, req->lba, sectors, ncq);
+
+    // PxSACT must be set before PxCI for queued commands (AHCI 1.3, 5.6.4.1)
+    if (ncq) {
+        ahci_port_sact_wr(&port->port, 1 << command);
+    }
+    ahci_port_ci_wr(&port->port, 1 << command);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Issue queued requests while command slots are available.
+ */
+void ahci_queue_kick(struct ahci_binding *binding)
+{
+    struct ahci_port_info *port = &binding->port_info;
+    bool ncq = ahci_ncq_supported(binding);
+    size_t depth = ahci_queue_depth(binding);
+
+    // queued and non-queued commands must not be outstanding together
+    if (ncq && ahci_port_has_unqueued(port)) {
+        return;
+    }
+
+    while (binding->queue_head != NULL
+           && binding->queue_outstanding < depth
+           && ahci_find_free_command_slot(port) != -1) {
+        struct ahci_request *req = binding->queue_head;
+        binding->queue_head = req->next;
+        if (binding->queue_head == NULL) {
+            binding->queue_tail = NULL;
+        }
+
+        errval_t err = ahci_queue_issue(binding, req, ncq);
+        if (err_is_fail(err)) {
+            req->done(binding, req->arg, err);
+            free(req);
+        }
+    }
+}
+
+/**
+ * \brief Finish the request in a completed command slot.
+ *
+ * The slot has already been released by the caller.
+ */
+void ahci_queue_complete(struct ahci_binding *binding, int command)
+{
+    struct ahci_command_slot *slot = &binding->port_info.command_slots[command];
+    struct ahci_request *req = slot->request;
+
+    assert(req != NULL);
+    slot->request = NULL;
+    slot->ncq = false;
+
+    assert(binding->queue_outstanding > 0);
+    binding->queue_outstanding--;
+
+    req->done(binding, req->arg, SYS_ERR_OK);
+    free(req);
+}
+
+/**
+ * \brief Queue a read or write of whole sectors.
+ *
+ * \param is_write  Write to the device instead of reading from it
+ * \param lba       First sector to transfer
+ * \param buf       DMA region to transfer from or to, owned by the caller
+ *                  until \p done is called
+ * \param buflen    Number of bytes to transfer, a multiple of the sector size
+ * \param done      Called on the binding's waitset once the request completed
+ * \param arg       Argument for \p done
+ *
+ * Requests are issued in order, but may complete in any order. If a request
+ * cannot be issued, \p done is called with the error, possibly before this
+ * function returns.
+ */
+errval_t ahci_queue_rw(struct ahci_binding *_binding, bool is_write,
+        uint64_t lba, struct ahci_dma_region *buf, size_t buflen,
+        ahci_request_done_fn *done, void *arg)
+{
+    if (buf == NULL || done == NULL || buflen == 0 || buflen > buf->size
+        || buflen % BLOCK_SIZE != 0
+        || buflen / BLOCK_SIZE > AHCI_QUEUE_MAX_SECTORS) {
+        return AHCI_ERR_ILLEGAL_ARGUMENT;
+    }
+
+    struct ahci_request *req = malloc(sizeof(struct ahci_request));
+    if (req == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    req->next = NULL;
+    req->is_write = is_write;
+    req->lba = lba;
+    req->buf = buf;
+    req->buflen = buflen;
+    req->done = done;
+    req->arg = arg;
+
+    if (_binding->queue_tail != NULL) {
+        _binding->queue_tail->next = req;
+    } else {
+        _binding->queue_head = req;
+    }
+    _binding->queue_tail = req;
+
+    ahci_queue_kick(_binding);
+
+    return SYS_ERR_OK;
+}
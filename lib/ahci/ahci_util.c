@@ -93,6 +93,7 @@ errval_t ahci_setup_command(int *command, struct ahci_port_info *port,
     r = ahci_dma_region_alloc(cmd_table_size, &ct);
     if (err_is_fail(r)) {
         DEBUG_ERR(r, "failed to allocate memory for command table");
+        port->command_slots[command_slot].in_use = false;
         return r;
     }
     port->command_slots[command_slot].command_table = ct;
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2011 ETH Zurich.
+ * Copyright (c) 2011, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -133,3 +133,40 @@ errval_t sata_set_count(void *fis, uint16_t count)
         return SATA_ERR_INVALID_TYPE;
     }
 }
+
+/* FPDMA QUEUED commands carry the sector count in the feature registers and
+ * the queue tag in bits 7:3 of the count register (see [1]).
+ *
+ * [1]: ATA8-ACS Rev. 3f (December 11, 2006), section 7.26
+ */
+errval_t sata_set_ncq_count(void *fis, uint16_t count)
+{
+    uint8_t fis_type = *(uint8_t*)fis;
+
+    if (fis_type == SATA_FIS_TYPE_H2D) {
+        struct sata_fis_reg_h2d *fis_reg_h2d = fis;
+        fis_reg_h2d->feature = count & 0xFF;
+        fis_reg_h2d->featureh = (count >> 8) & 0xFF;
+
+        return SYS_ERR_OK;
+    }
+    else {
+        return SATA_ERR_INVALID_TYPE;
+    }
+}
+
+errval_t sata_set_ncq_tag(void *fis, uint8_t tag)
+{
+    uint8_t fis_type = *(uint8_t*)fis;
+
+    if (fis_type == SATA_FIS_TYPE_H2D) {
+        struct sata_fis_reg_h2d *fis_reg_h2d = fis;
+        fis_reg_h2d->countl = (tag & 0x1F) << 3;
+        fis_reg_h2d->counth = 0;
+
+        return SYS_ERR_OK;
+    }
+    else {
+        return SATA_ERR_INVALID_TYPE;
+    }
+}
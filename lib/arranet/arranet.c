@@ -29,6 +29,7 @@
 #include <arranet.h>
 #include <arranet_impl.h>
 #include <acpi_client/acpi_client.h>
+#include <pktcopy/pktcopy.h>
 
 #include "inet_chksum.h"
 
@@ -110,6 +111,10 @@ struct socket {
     struct sockaddr_in bound_addr;
     struct sockaddr_in peer_addr;
     uint32_t my_seq, peer_seq, next_ack;
+    // Persistent readiness handler, see lwip_sock_waitset_register_events()
+    lwip_sock_event_fn event_fn;
+    void *event_arg;
+    struct socket *event_prev, *event_next;
 };
 
 struct pkt_ip_headers {
@@ -139,6 +144,9 @@ static struct packet rx_packets[MAX_PACKETS];
 static struct waitset_chanstate recv_chanstate;
 static struct waitset_chanstate send_chanstate;
 
+// Sockets with a readiness handler
+static struct socket *event_sockets = NULL;
+
 static struct packet *inpkt = NULL;
 
 #ifdef DEBUG_LATENCIES
@@ -244,11 +252,52 @@ static struct socket *alloc_socket(void)
     return new_socket;
 }
 
+static void sock_event_unlink(struct socket *sock)
+{
+    if(sock->event_prev != NULL) {
+        sock->event_prev->event_next = sock->event_next;
+    }
+    if(sock->event_next != NULL) {
+        sock->event_next->event_prev = sock->event_prev;
+    }
+    if(event_sockets == sock) {
+        event_sockets = sock->event_next;
+    }
+    sock->event_next = sock->event_prev = NULL;
+    sock->event_fn = NULL;
+    sock->event_arg = NULL;
+}
+
+/**
+ * \brief Tell the readiness handlers about an incoming packet
+ *
+ * Packets for a known connection go to that socket only. Anything else may
+ * be for a listening or datagram socket, so all of those are told.
+ */
+static void sock_event_signal(struct socket *sock, uint32_t events)
+{
+    if(sock != NULL) {
+        if(sock->event_fn != NULL) {
+            sock->event_fn(sock->event_arg, sock->fd, events);
+        }
+        return;
+    }
+
+    for(struct socket *s = event_sockets; s != NULL; s = s->event_next) {
+        if(s->passive || s->type != SOCK_STREAM) {
+            s->event_fn(s->event_arg, s->fd, events);
+        }
+    }
+}
+
 static void free_socket(struct socket *sock)
 {
     /* printf("free_socket: %p\n", sock); */
     assert(sock != NULL);
     assert(free_sockets < MAX_FD);
+    if(sock->event_fn != NULL) {
+        sock_event_unlink(sock);
+    }
     free_sockets++;
     free_sockets_tail = (free_sockets_tail + 1) % MAX_FD;
     free_sockets_queue[free_sockets_tail] = sock;
@@ -1508,22 +1557,31 @@ int lwip_close(int s)
     return 0;
 }
 
-int lwip_send(int s, const void *data, size_t size, int flags)
+#ifdef SENDMSG_WITH_COPY
+/**
+ * \brief Send a TCP segment gathered from an I/O vector.
+ *
+ * The buffers are copied once, straight into the payload of a TX packet,
+ * so a header and a body written together leave in one segment.
+ */
+static ssize_t tcp_sendv(struct socket *sock, const struct iovec *iov,
+                         int iovcnt)
 {
-    assert(arranet_tcp_accepted);
-    struct socket *sock = &sockets[s];
-    assert(sock->nonblocking);
+    size_t size = 0;
+    for(int i = 0; i < iovcnt; i++) {
+        size += iov[i].iov_len;
+    }
     assert(size + sizeof(struct pkt_tcp_headers) <= 1500);
 
-    /* printf("lwip_send(%d, , %zu)\n", s, size); */
-
-#ifdef SENDMSG_WITH_COPY
     // Get new TX packet and copy data into it
     struct packet *newp = get_tx_packet();
     newp->len = sizeof(struct pkt_tcp_headers) + size;
     newp->next = NULL;
     uint8_t *buf = newp->payload + sizeof(struct pkt_tcp_headers);
-    memcpy(buf, data, size);
+    for(int i = 0; i < iovcnt; i++) {
+        pktcopy_memcpy(buf, iov[i].iov_base, iov[i].iov_len);
+        buf += iov[i].iov_len;
+    }
 
     // Slap TCP/IP/Ethernet headers in front
     memcpy(newp->payload, &packet_tcp_header, sizeof(struct pkt_tcp_headers));
@@ -1569,6 +1627,24 @@ int lwip_send(int s, const void *data, size_t size, int flags)
     packet_output(newp);
 
     return size;
+}
+#endif
+
+int lwip_send(int s, const void *data, size_t size, int flags)
+{
+    assert(arranet_tcp_accepted);
+    struct socket *sock = &sockets[s];
+    assert(sock->nonblocking);
+
+    /* printf("lwip_send(%d, , %zu)\n", s, size); */
+
+#ifdef SENDMSG_WITH_COPY
+    struct iovec io = {
+        .iov_base = (void *)data,
+        .iov_len = size,
+    };
+
+    return tcp_sendv(sock, &io, 1);
 #else
     assert(!"NYI");
 #endif
@@ -1659,9 +1735,15 @@ int lwip_connect(int s, const struct sockaddr *name, socklen_t namelen)
 
 int lwip_sendmsg(int sockfd, const struct msghdr *msg, int flags)
 {
-    assert(arranet_udp_accepted || arranet_raw_accepted);
     struct socket *sock = &sockets[sockfd];
 
+    if(sock->type == SOCK_STREAM) {
+        assert(arranet_tcp_accepted);
+        assert(sock->nonblocking);
+        return tcp_sendv(sock, msg->msg_iov, msg->msg_iovlen);
+    }
+    assert(arranet_udp_accepted || arranet_raw_accepted);
+
 #ifdef DEBUG_LATENCIES
     if(posix_send_transactions < POSIX_TRANSA) {
         if(msg->msg_iovlen > 1 && msg->msg_iov[1].iov_len == sizeof(protocol_binary_response_no_extras)) {
@@ -1730,7 +1812,8 @@ int lwip_sendmsg(int sockfd, const struct msghdr *msg, int flags)
     for(int i = 0; i < msg->msg_iovlen; i++) {
         /* assert((uintptr_t)(&buf[pos]) % 8 == 0); */
         //        assert((uintptr_t)msg->msg_iov[i].iov_base % 8 == 0);
-        memcpy(&buf[pos], msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+        pktcopy_memcpy(&buf[pos], msg->msg_iov[i].iov_base,
+                       msg->msg_iov[i].iov_len);
         pos += msg->msg_iov[i].iov_len;
     }
 
@@ -1782,7 +1865,7 @@ int lwip_sendmsg(int sockfd, const struct msghdr *msg, int flags)
 /*     } */
 /* #endif */
 
-    if (sock->type = SOCK_DGRAM) {
+    if (sock->type == SOCK_DGRAM) {
         // Fine-tune headers
         struct pkt_udp_headers *p = (struct pkt_udp_headers *)buf;
         assert(msg->msg_name != NULL);
@@ -2298,6 +2381,7 @@ void process_received_packet(struct driver_rx_buffer *buffer, size_t count,
                     if(TCPH_FLAGS(tcphdr) & TCP_SYN) {
                         assert(sock != NULL);
                         sock->connected = true;
+                        sock_event_signal(sock, LWIP_SOCK_EVENT_WRITE);
                     }
                     if((TCPH_FLAGS(tcphdr) & TCP_FIN) && sock != NULL) {
                         // It said FIN, so we're not expecting any more from that side
@@ -2308,6 +2392,7 @@ void process_received_packet(struct driver_rx_buffer *buffer, size_t count,
                             errval_t err = waitset_chan_trigger(&recv_chanstate);
                             assert(err_is_ok(err));
                         }
+                        sock_event_signal(sock, LWIP_SOCK_EVENT_READ);
 
                         if(sock->prev != NULL) {
                             sock->prev->next = sock->next;
@@ -2440,6 +2525,8 @@ void process_received_packet(struct driver_rx_buffer *buffer, size_t count,
                 errval_t err = waitset_chan_trigger(&recv_chanstate);
                 assert(err_is_ok(err));
             }
+            sock_event_signal(arranet_tcp_accepted ? p->sock : NULL,
+                              LWIP_SOCK_EVENT_READ);
 
             // Return here, packet is in flight to user-space
             return;
@@ -2732,6 +2819,71 @@ errval_t lwip_sock_waitset_register_write(int sock, struct waitset *ws)
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Register a handler that is called whenever the socket may have
+ *        become ready for reading or writing.
+ *
+ * The handler stays registered until it is deregistered or the socket is
+ * closed. Packets are only received while the stack is polled, see
+ * lwip_sock_waitset_register_stack().
+ */
+errval_t lwip_sock_waitset_register_events(int s, struct waitset *ws,
+                                           lwip_sock_event_fn fn, void *arg)
+{
+    struct socket *sock = &sockets[s];
+
+    assert(fn != NULL);
+
+    if(sock->event_fn == NULL) {
+        sock->event_prev = NULL;
+        sock->event_next = event_sockets;
+        if(event_sockets != NULL) {
+            event_sockets->event_prev = sock;
+        }
+        event_sockets = sock;
+    }
+    sock->event_fn = fn;
+    sock->event_arg = arg;
+
+    return SYS_ERR_OK;
+}
+
+errval_t lwip_sock_waitset_deregister_events(int s)
+{
+    struct socket *sock = &sockets[s];
+
+    if(sock->event_fn != NULL) {
+        sock_event_unlink(sock);
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Poll the network queue from the given waitset.
+ *
+ * The receive channel is shared by all sockets, so this is a single
+ * registration no matter how many sockets the caller waits for.
+ */
+errval_t lwip_sock_waitset_register_stack(struct waitset *ws)
+{
+    assert(ws != NULL);
+
+    if(waitset_chan_is_registered(&recv_chanstate) || recv_chanstate.state == CHAN_PENDING) {
+        assert(recv_chanstate.waitset == ws);
+        return SYS_ERR_OK;
+    }
+
+    waitset_chanstate_init(&recv_chanstate, CHANTYPE_LWIP_SOCKET);
+    return waitset_chan_register_polled(ws, &recv_chanstate,
+                                        MKCLOSURE(do_nothing, NULL));
+}
+
+errval_t lwip_sock_waitset_deregister_stack(void)
+{
+    return waitset_chan_deregister(&recv_chanstate);
+}
+
 void arranet_polling_loop_proxy(void);
 void arranet_polling_loop_proxy(void)
 {
@@ -24,6 +24,7 @@
 #include <barrelfish/curdispatcher_arch.h>
 #include <barrelfish/dispatcher_arch.h>
 #include <barrelfish/waitset_chan.h>
+#include <barrelfish/coreset.h>
 #include <barrelfish_kpi/domain_params.h>
 #include <arch/registers.h>
 #include <barrelfish/dispatch.h>
@@ -61,6 +62,7 @@ struct span_domain_state {
     uint8_t core_id;                    ///< Id of the remote core
     errval_t err;                       ///< To propagate error value
     domain_spanned_callback_t callback; ///< Callback for when domain has spanned
+    domain_spanned_core_callback_t core_callback; ///< Callback for bulk spans
     void *callback_arg;                 ///< Optional argument to pass with callback
     struct capref frame;                ///< Dispatcher frame
     struct capref vroot;                ///< VRoot cap
@@ -93,6 +95,11 @@ static void dispatcher_initialized_handler(void *arg)
     if (span_domain_state->callback) {
         span_domain_state->callback(span_domain_state->callback_arg, SYS_ERR_OK);
     }
+    if (span_domain_state->core_callback) {
+        span_domain_state->core_callback(span_domain_state->callback_arg,
+                                         span_domain_state->core_id,
+                                         SYS_ERR_OK);
+    }
     span_domain_state->initialized = 1;
     //free(span_domain_state);
 }
@@ -586,10 +593,16 @@ static void span_domain_reply(struct monitor_binding *mb,
 
     if (span_domain_state->callback) { /* Use the callback to return error */
         span_domain_state->callback(span_domain_state->callback_arg, msgerr);
+    } else if (span_domain_state->core_callback) {
+        span_domain_state->core_callback(span_domain_state->callback_arg,
+                                         span_domain_state->core_id, msgerr);
     } else { /* Use debug_err if no callback registered */
         DEBUG_ERR(msgerr, "Failure in span_domain_reply");
     }
-    free(span_domain_state);
+
+    /* The thread waiting for the span frees the state */
+    span_domain_state->err = msgerr;
+    span_domain_state->initialized = true;
 }
 
 static void span_domain_request_sender(void *arg)
@@ -624,14 +637,18 @@ static void span_domain_request_sender_wrapper(void *st)
 }
 
 /**
- * \brief Since we cannot dynamically grow our stack yet, we need a
- * verion that will create threads on remote core with variable stack size
+ * \brief Prepare a dispatcher for a remote core and ask the monitor to start it
  *
- * \bug this is a hack
+ * Does not wait for the new dispatcher, \p span_domain_state is marked as
+ * initialized once it has connected back or the span failed.
+ *
+ * \param core_id           Id of the core to create the dispatcher on
+ * \param stack_size        Stack size of the initial thread of the dispatcher
+ * \param span_domain_state State of the spanning state machine with the
+ *                          callback set, freed by the caller once initialized
  */
-static errval_t domain_new_dispatcher_varstack(coreid_t core_id,
-                                               domain_spanned_callback_t callback,
-                                               void *callback_arg, size_t stack_size)
+static errval_t span_domain_start(coreid_t core_id, size_t stack_size,
+                                  struct span_domain_state *span_domain_state)
 {
     assert(core_id != disp_get_core_id());
 
@@ -669,15 +686,10 @@ static errval_t domain_new_dispatcher_varstack(coreid_t core_id,
     }
 
     /* Save the state for later steps of the spanning state machine */
-    struct span_domain_state *span_domain_state =
-        malloc(sizeof(struct span_domain_state));
-    if (!span_domain_state) {
-        return LIB_ERR_MALLOC_FAIL;
-    }
     span_domain_state->thread       = newthread;
     span_domain_state->core_id      = core_id;
-    span_domain_state->callback     = callback;
-    span_domain_state->callback_arg = callback_arg;
+    span_domain_state->err          = SYS_ERR_OK;
+    span_domain_state->initialized  = false;
 
     /* Give remote_core_state pointer to span_domain_state */
     remote_core_state->span_domain_state = span_domain_state;
@@ -780,16 +792,42 @@ static errval_t domain_new_dispatcher_varstack(coreid_t core_id,
                                  .handler = span_domain_request_sender_wrapper,
                                      .arg = span_domain_state });
 
-#if 1
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Since we cannot dynamically grow our stack yet, we need a
+ * verion that will create threads on remote core with variable stack size
+ *
+ * \bug this is a hack
+ */
+static errval_t domain_new_dispatcher_varstack(coreid_t core_id,
+                                               domain_spanned_callback_t callback,
+                                               void *callback_arg, size_t stack_size)
+{
+    struct span_domain_state *span_domain_state =
+        calloc(1, sizeof(struct span_domain_state));
+    if (!span_domain_state) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    span_domain_state->callback     = callback;
+    span_domain_state->callback_arg = callback_arg;
+
+    errval_t err = span_domain_start(core_id, stack_size, span_domain_state);
+    if (err_is_fail(err)) {
+        free(span_domain_state);
+        return err;
+    }
+
     while(!span_domain_state->initialized) {
         event_dispatch(get_default_waitset());
     }
 
     /* Free state */
+    err = span_domain_state->err;
     free(span_domain_state);
-#endif
 
-    return SYS_ERR_OK;
+    return err;
 }
 
 /**
@@ -809,6 +847,80 @@ errval_t domain_new_dispatcher(coreid_t core_id,
                                           THREADS_DEFAULT_STACK_BYTES);
 }
 
+struct span_bulk_state {
+    domain_spanned_core_callback_t callback;
+    void *callback_arg;
+    struct span_domain_state *span[MAX_COREID];
+    size_t count;
+};
+
+static errval_t span_bulk_start(void *st, coreid_t core_id)
+{
+    struct span_bulk_state *bulk = st;
+
+    if (core_id == disp_get_core_id()) {
+        return SYS_ERR_OK;
+    }
+
+    struct span_domain_state *span_domain_state =
+        calloc(1, sizeof(struct span_domain_state));
+    if (!span_domain_state) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    span_domain_state->core_callback = bulk->callback;
+    span_domain_state->callback_arg  = bulk->callback_arg;
+
+    errval_t err = span_domain_start(core_id, THREADS_DEFAULT_STACK_BYTES,
+                                     span_domain_state);
+    if (err_is_fail(err)) {
+        free(span_domain_state);
+        return err;
+    }
+
+    bulk->span[bulk->count++] = span_domain_state;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Creates dispatchers on a set of remote cores
+ *
+ * \param cores     Cores to create dispatchers on, the current core is skipped
+ * \param callback  Called with the core id as each new dispatcher is created
+ *
+ * Like #domain_new_dispatcher, but all dispatcher frames are set up and all
+ * span requests are sent to the monitor before waiting for any of the new
+ * dispatchers, so the remote cores initialize in parallel. Returns once all
+ * of them are up, or with the first error if any span failed.
+ */
+errval_t domain_new_dispatchers(struct coreset *cores,
+                                domain_spanned_core_callback_t callback,
+                                void *callback_arg)
+{
+    struct span_bulk_state *bulk = calloc(1, sizeof(struct span_bulk_state));
+    if (!bulk) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    bulk->callback     = callback;
+    bulk->callback_arg = callback_arg;
+
+    errval_t err = coreset_iterate(cores, bulk, span_bulk_start);
+
+    /* Wait for the spans that were started, even if a later one failed */
+    for (size_t i = 0; i < bulk->count; i++) {
+        struct span_domain_state *span_domain_state = bulk->span[i];
+        while (!span_domain_state->initialized) {
+            event_dispatch(get_default_waitset());
+        }
+        if (err_is_ok(err)) {
+            err = span_domain_state->err;
+        }
+        free(span_domain_state);
+    }
+
+    free(bulk);
+    return err;
+}
+
 errval_t domain_send_cap(coreid_t core_id, struct capref cap)
 {
     errval_t err;
@@ -0,0 +1,203 @@
+/**
+ * \file
+ * \brief Support code for pipelined flounder RPC clients
+ *
+ * Several threads may have calls outstanding on the same RPC client. Only
+ * one of them dispatches the RPC waitset at a time, the others wait on a
+ * condition variable that is signalled whenever the dispatching thread made
+ * progress. A thread stops dispatching as soon as its own condition holds,
+ * and another waiting thread takes over.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <flounder/flounder_rpc.h>
+
+STATIC_ASSERT((FLOUNDER_RPC_WINDOW & (FLOUNDER_RPC_WINDOW - 1)) == 0,
+              "FLOUNDER_RPC_WINDOW must be a power of two");
+
+void flounder_rpc_window_init(struct flounder_rpc_window *w)
+{
+    memset(w->slots, 0, sizeof(w->slots));
+    w->outstanding = 0;
+    w->async_outstanding = 0;
+    // Tags of pipelined calls are never below the window size, callers of
+    // the non-pipelined RPCs usually pass 0
+    w->generation = 1;
+    w->dispatching = false;
+    thread_mutex_init(&w->mutex);
+    thread_cond_init(&w->progress);
+}
+
+/**
+ * \brief Waits until cond(arg) holds, dispatching ws if nobody else does.
+ *
+ * Must be called with the window mutex held, returns with the mutex held.
+ */
+errval_t flounder_rpc_window_wait(struct flounder_rpc_window *w,
+                                  struct waitset *ws,
+                                  bool (*cond)(void *arg), void *arg)
+{
+    errval_t err = SYS_ERR_OK;
+
+    while (!cond(arg)) {
+        if (w->dispatching) {
+            thread_cond_wait(&w->progress, &w->mutex);
+            continue;
+        }
+
+        w->dispatching = true;
+        thread_mutex_unlock(&w->mutex);
+        err = event_dispatch(ws);
+        thread_mutex_lock(&w->mutex);
+        w->dispatching = false;
+        thread_cond_broadcast(&w->progress);
+
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_EVENT_DISPATCH);
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Allocates a slot for a new call, NULL if the window is full.
+ *
+ * Must be called with the window mutex held.
+ */
+struct flounder_rpc_slot *flounder_rpc_window_alloc(struct flounder_rpc_window *w)
+{
+    if (w->outstanding == FLOUNDER_RPC_WINDOW) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < FLOUNDER_RPC_WINDOW; i++) {
+        struct flounder_rpc_slot *s = &w->slots[i];
+        if (!s->in_use) {
+            s->in_use = true;
+            s->async = false;
+            s->tag = (w->generation++ * FLOUNDER_RPC_WINDOW) + i;
+            s->done = NULL;
+            s->err = NULL;
+            s->cont = NOP_CLOSURE;
+            w->outstanding++;
+            return s;
+        }
+    }
+
+    assert(!"outstanding count out of sync with the slots");
+    return NULL;
+}
+
+/**
+ * \brief Releases a slot. Must be called with the window mutex held.
+ */
+void flounder_rpc_window_free(struct flounder_rpc_window *w,
+                              struct flounder_rpc_slot *s)
+{
+    assert(s->in_use);
+    s->in_use = false;
+    w->outstanding--;
+    if (s->async) {
+        w->async_outstanding--;
+    }
+    thread_cond_broadcast(&w->progress);
+}
+
+/**
+ * \brief Finds the outstanding call with the given tag.
+ *
+ * Must be called with the window mutex held.
+ *
+ * \returns NULL if no pipelined call with this tag is outstanding.
+ */
+struct flounder_rpc_slot *flounder_rpc_window_lookup(struct flounder_rpc_window *w,
+                                                     uint64_t tag)
+{
+    struct flounder_rpc_slot *s = &w->slots[tag & (FLOUNDER_RPC_WINDOW - 1)];
+
+    return (s->in_use && s->tag == tag) ? s : NULL;
+}
+
+/**
+ * \brief Completes a call and releases its slot.
+ *
+ * Must be called with the window mutex held, after the reply arguments were
+ * stored.
+ *
+ * \returns The continuation of an asynchronous call. The caller runs it
+ * once the mutex is released.
+ */
+struct event_closure flounder_rpc_window_complete(struct flounder_rpc_window *w,
+                                                  struct flounder_rpc_slot *s,
+                                                  errval_t err)
+{
+    struct event_closure cont = s->cont;
+
+    if (s->err != NULL) {
+        *s->err = err;
+    }
+    if (s->done != NULL) {
+        *s->done = true;
+    }
+    flounder_rpc_window_free(w, s);
+
+    return cont;
+}
+
+/**
+ * \brief Fails all outstanding calls, used when the binding reports an error.
+ */
+void flounder_rpc_window_fail(struct flounder_rpc_window *w, errval_t err)
+{
+    struct event_closure conts[FLOUNDER_RPC_WINDOW];
+    size_t n = 0;
+
+    thread_mutex_lock(&w->mutex);
+    for (size_t i = 0; i < FLOUNDER_RPC_WINDOW; i++) {
+        if (w->slots[i].in_use) {
+            conts[n++] = flounder_rpc_window_complete(w, &w->slots[i], err);
+        }
+    }
+    thread_mutex_unlock(&w->mutex);
+
+    for (size_t i = 0; i < n; i++) {
+        if (conts[i].handler != NULL) {
+            conts[i].handler(conts[i].arg);
+        }
+    }
+}
+
+static bool window_empty(void *arg)
+{
+    struct flounder_rpc_window *w = arg;
+    return w->outstanding == 0;
+}
+
+/**
+ * \brief Dispatches ws until all outstanding calls completed.
+ */
+errval_t flounder_rpc_window_drain(struct flounder_rpc_window *w,
+                                   struct waitset *ws)
+{
+    thread_mutex_lock(&w->mutex);
+    errval_t err = flounder_rpc_window_wait(w, ws, window_empty, w);
+    thread_mutex_unlock(&w->mutex);
+
+    return err;
+}
+
+bool flounder_rpc_is_done(void *done)
+{
+    return *(volatile bool *)done;
+}
@@ -0,0 +1,186 @@
+/**
+ * \file
+ * \brief Registry of per-binding flounder message statistics
+ *
+ * The generated stubs allocate one statistics block per binding when built
+ * with FLOUNDER_STATS and update it from the inline hooks in
+ * flounder/flounder_stats.h. This file keeps the list of all blocks of the
+ * domain and prints them or writes them to the trace buffer.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <flounder/flounder_stats.h>
+#include <trace/trace.h>
+#include <trace_definitions/trace_defs.h>
+
+static struct flounder_binding_stats *registry;
+static uint32_t next_id;
+static struct thread_mutex registry_lock = THREAD_MUTEX_INITIALIZER;
+
+/**
+ * \brief Allocate and register the statistics of a new binding
+ *
+ * \param ifname   Name of the interface
+ * \param backend  Name of the flounder backend
+ * \param nmsgs    Number of message numbers of the interface
+ * \param msg_name Returns the name of a message number, may be NULL
+ *
+ * \returns The statistics block, or NULL if out of memory. The stubs accept
+ *          a NULL block and simply do not count.
+ */
+struct flounder_binding_stats *flounder_stats_alloc(const char *ifname,
+                                                    const char *backend,
+                                                    size_t nmsgs,
+                                                    const char *(*msg_name)(unsigned))
+{
+    struct flounder_binding_stats *s;
+
+    s = calloc(1, sizeof(*s) + nmsgs * sizeof(struct flounder_msg_stats));
+    if (s == NULL) {
+        return NULL;
+    }
+
+    s->ifname = ifname;
+    s->backend = backend;
+    s->msg_name = msg_name;
+    s->nmsgs = nmsgs;
+
+    thread_mutex_lock(&registry_lock);
+    s->id = next_id++;
+    s->next = registry;
+    registry = s;
+    thread_mutex_unlock(&registry_lock);
+
+    return s;
+}
+
+/// Unregister and free the statistics of a destroyed binding
+void flounder_stats_free(struct flounder_binding_stats *s)
+{
+    if (s == NULL) {
+        return;
+    }
+
+    thread_mutex_lock(&registry_lock);
+    for (struct flounder_binding_stats **p = &registry; *p != NULL;
+         p = &(*p)->next) {
+        if (*p == s) {
+            *p = s->next;
+            break;
+        }
+    }
+    thread_mutex_unlock(&registry_lock);
+
+    free(s);
+}
+
+static bool msg_is_used(struct flounder_msg_stats *m)
+{
+    return m->tx != 0 || m->rx != 0 || m->tx_busy != 0;
+}
+
+static cycles_t average(cycles_t sum, uint64_t count)
+{
+    return count == 0 ? 0 : sum / count;
+}
+
+/// Print the statistics of all bindings of the domain
+void flounder_stats_dump(void)
+{
+    thread_mutex_lock(&registry_lock);
+    for (struct flounder_binding_stats *s = registry; s != NULL; s = s->next) {
+        printf("flounder binding %"PRIu32": %s (%s), register_send waits "
+               "%"PRIu64" avg %"PRIuCYCLES" max %"PRIuCYCLES", txq "
+               "backlogged %"PRIu64" max depth %"PRIu32"\n",
+               s->id, s->ifname, s->backend, s->register_waits,
+               average(s->register_cycles, s->register_waits),
+               s->register_cycles_max, s->txq_backlogged, s->txq_depth_max);
+
+        for (size_t i = 0; i < s->nmsgs; i++) {
+            struct flounder_msg_stats *m = &s->msgs[i];
+            if (!msg_is_used(m)) {
+                continue;
+            }
+
+            const char *name = s->msg_name ? s->msg_name(i) : NULL;
+            printf("  %-24s tx %8"PRIu64" busy %6"PRIu64" avg %8"PRIuCYCLES
+                   " max %8"PRIuCYCLES" | rx %8"PRIu64" avg %8"PRIuCYCLES
+                   " max %8"PRIuCYCLES"\n", name ? name : "?", m->tx,
+                   m->tx_busy, average(m->tx_cycles, m->tx),
+                   m->tx_cycles_max, m->rx, average(m->rx_cycles, m->rx),
+                   m->rx_cycles_max);
+        }
+    }
+    thread_mutex_unlock(&registry_lock);
+}
+
+/**
+ * \brief Write the statistics of all bindings to the trace buffer
+ *
+ * Each binding is written as a STATS_BINDING event with its id, the binding
+ * counters, and a STATS_MSGNUM event followed by the counters of every
+ * message type that was used. Counters are truncated to 32 bits.
+ */
+void flounder_stats_trace(void)
+{
+    thread_mutex_lock(&registry_lock);
+    for (struct flounder_binding_stats *s = registry; s != NULL; s = s->next) {
+        trace_event(TRACE_SUBSYS_FLOUNDER, TRACE_EVENT_FLOUNDER_STATS_BINDING,
+                    s->id);
+        trace_event(TRACE_SUBSYS_FLOUNDER, TRACE_EVENT_FLOUNDER_STATS_REGISTER,
+                    s->register_waits);
+        trace_event(TRACE_SUBSYS_FLOUNDER, TRACE_EVENT_FLOUNDER_STATS_TXQ_MAX,
+                    s->txq_depth_max);
+
+        for (size_t i = 0; i < s->nmsgs; i++) {
+            struct flounder_msg_stats *m = &s->msgs[i];
+            if (!msg_is_used(m)) {
+                continue;
+            }
+
+            trace_event(TRACE_SUBSYS_FLOUNDER,
+                        TRACE_EVENT_FLOUNDER_STATS_MSGNUM, i);
+            trace_event(TRACE_SUBSYS_FLOUNDER, TRACE_EVENT_FLOUNDER_STATS_TX,
+                        m->tx);
+            trace_event(TRACE_SUBSYS_FLOUNDER, TRACE_EVENT_FLOUNDER_STATS_RX,
+                        m->rx);
+            trace_event(TRACE_SUBSYS_FLOUNDER,
+                        TRACE_EVENT_FLOUNDER_STATS_TX_BUSY, m->tx_busy);
+            trace_event(TRACE_SUBSYS_FLOUNDER,
+                        TRACE_EVENT_FLOUNDER_STATS_TX_CYCLES,
+                        average(m->tx_cycles, m->tx));
+            trace_event(TRACE_SUBSYS_FLOUNDER,
+                        TRACE_EVENT_FLOUNDER_STATS_RX_CYCLES,
+                        average(m->rx_cycles, m->rx));
+        }
+    }
+    thread_mutex_unlock(&registry_lock);
+}
+
+/// Reset the counters of all bindings, e.g. after a warm-up phase
+void flounder_stats_reset(void)
+{
+    thread_mutex_lock(&registry_lock);
+    for (struct flounder_binding_stats *s = registry; s != NULL; s = s->next) {
+        memset(s->msgs, 0, s->nmsgs * sizeof(struct flounder_msg_stats));
+        s->register_waits = 0;
+        s->register_start = 0;
+        s->register_cycles = 0;
+        s->register_cycles_max = 0;
+        s->txq_backlogged = 0;
+        s->txq_depth_max = s->txq_depth;
+    }
+    thread_mutex_unlock(&registry_lock);
+}
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2010, 2011, 2012, ETH Zurich.
+ * Copyright (c) 2010, 2011, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -369,6 +369,112 @@ void flounder_stub_ump_state_init(struct flounder_ump_state *s, void *binding)
     s->ack_id = 0;
     s->last_ack = 0;
     flounder_stub_cap_state_init(&s->capst, binding);
+
+    s->batch.enabled = false;
+    s->batch.armed = false;
+    s->batch.pending = 0;
+    s->batch.max = FLOUNDER_UMP_BATCH_MAX;
+    s->batch.delay = FLOUNDER_UMP_BATCH_DELAY;
+    deferred_event_init(&s->batch.deadline);
+}
+
+/**
+ * \brief Apply a control operation to the notification batching state
+ *
+ * \returns true iff held back notifications must be sent now
+ */
+bool flounder_stub_ump_batch_control(struct flounder_ump_batch *b,
+                                     idc_control_t control)
+{
+    switch (control) {
+    case IDC_CONTROL_SET_BATCH:
+        b->enabled = true;
+        return false;
+
+    case IDC_CONTROL_CLEAR_BATCH:
+        b->enabled = false;
+        return b->pending > 0;
+
+    case IDC_CONTROL_FLUSH:
+        return b->pending > 0;
+
+    default: // no-op for other control ops
+        return false;
+    }
+}
+
+/**
+ * \brief Decide whether to hold back the notification of a sent message
+ *
+ * \param b     Batching state
+ * \param ws    Waitset on which the deadline fires
+ * \param flush Sends the held back notification, run at the deadline
+ *
+ * \returns true iff the notification was held back, false if the caller
+ *          must notify now (and call flounder_stub_ump_batch_flushed())
+ */
+bool flounder_stub_ump_batch_defer(struct flounder_ump_batch *b,
+                                   struct waitset *ws,
+                                   struct event_closure flush)
+{
+    if (!b->enabled || ++b->pending >= b->max) {
+        return false;
+    }
+
+    if (!b->armed) {
+        errval_t err = deferred_event_register(&b->deadline, ws, b->delay,
+                                               flush);
+        if (err_is_fail(err)) {
+            // without a deadline the message could be held back forever
+            return false;
+        }
+        b->armed = true;
+    }
+
+    return true;
+}
+
+/// Notification was sent, covering all held back messages
+void flounder_stub_ump_batch_flushed(struct flounder_ump_batch *b)
+{
+    b->pending = 0;
+    if (b->armed) {
+        deferred_event_cancel(&b->deadline);
+        b->armed = false;
+    }
+}
+
+/**
+ * \brief Move an armed deadline to the new waitset of the binding
+ *
+ * The deadline starts again with the full delay on the new waitset.
+ *
+ * \returns true iff the deadline could not be moved and held back
+ *          notifications must be sent now
+ */
+bool flounder_stub_ump_batch_change_waitset(struct flounder_ump_batch *b,
+                                            struct waitset *ws,
+                                            struct event_closure flush)
+{
+    if (!b->armed) {
+        return false;
+    }
+
+    deferred_event_cancel(&b->deadline);
+    b->armed = false;
+
+    errval_t err = deferred_event_register(&b->deadline, ws, b->delay, flush);
+    if (err_is_fail(err)) {
+        return true;
+    }
+    b->armed = true;
+
+    return false;
+}
+
+void flounder_stub_ump_batch_destroy(struct flounder_ump_batch *b)
+{
+    flounder_stub_ump_batch_flushed(b);
 }
 
 errval_t flounder_stub_ump_send_buf(struct flounder_ump_state *s,
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -10,6 +10,13 @@
 #include <barrelfish/barrelfish.h>
 #include <flounder/flounder.h>
 #include <flounder/flounder_txqueue.h>
+#include <flounder/flounder_stats.h>
+
+#ifdef FLOUNDER_STATS
+#define TXQ_STATS(x) x
+#else
+#define TXQ_STATS(x)
+#endif
 
 static void send_cont(void *arg)
 {
@@ -84,6 +91,7 @@ void txq_init(struct tx_queue *queue,
     queue->head = NULL;
     queue->tail = NULL;
     queue->free = NULL;
+    queue->stats = NULL;
 #ifdef FLOUNDER_TXQUEUE_DEBUG
     queue->alloc_count = 0;
     queue->free_count = 0;
@@ -91,6 +99,18 @@ void txq_init(struct tx_queue *queue,
 #endif
 }
 
+/**
+ * \brief accounts the queue in the statistics of the binding
+ *
+ * \param queue         TX queue
+ * \param stats         statistics of the binding (binding->stats)
+ */
+void txq_set_stats(struct tx_queue *queue,
+                   struct flounder_binding_stats *stats)
+{
+    queue->stats = stats;
+}
+
 /**
  * \brief allocates new message state for an outgoing flounder message
  *
@@ -163,6 +183,7 @@ void txq_sent_cb(void *arg)
     struct tx_queue *q = st->queue;
     assert(q->head == st);
     TXQ_OP(q->queue_count--);
+    TXQ_STATS(flounder_stats_txq_dequeue(q->stats));
 
     if (st->cleanup) {
         st->cleanup(st);
@@ -202,6 +223,7 @@ void txq_send(struct txq_msg_st *st)
     struct tx_queue *q = st->queue;
 
     st->next = NULL;
+    TXQ_STATS(flounder_stats_txq_enqueue(q->stats, q->tail != NULL));
     if (q->tail == NULL) {
         q->head = st;
         TXQ_ASSERT(q->queue_count == 0);
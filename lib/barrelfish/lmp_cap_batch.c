@@ -0,0 +1,194 @@
+/**
+ * \file
+ * \brief Transfer of many capabilities in a single LMP message
+ *
+ * Every LMP message can carry at most one capability, and the receiver
+ * needs a fresh receive slot for each. A batch instead collects the
+ * capabilities in a CNode and sends only the CNode capability, so handing
+ * out many capabilities (RAM, device frames, inherited caps) costs one
+ * message, one kernel cap transfer and one receive slot.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/lmp_chan.h>
+#include <barrelfish/lmp_cap_batch.h>
+
+/**
+ * \brief Create an empty batch
+ *
+ * \param b     Storage for the batch
+ * \param slots Minimum number of capabilities the batch can hold
+ */
+errval_t lmp_cap_batch_create(struct lmp_cap_batch *b, cslot_t slots)
+{
+    errval_t err;
+
+    err = cnode_create(&b->cnode_cap, &b->cnode, slots, &b->slots);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_CNODE_CREATE);
+    }
+
+    b->count = 0;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Add a capability to a batch
+ *
+ * \param b    Batch
+ * \param cap  Capability to add
+ * \param move If true, the capability is deleted and its slot freed once it
+ *             has been copied into the batch
+ */
+errval_t lmp_cap_batch_add(struct lmp_cap_batch *b, struct capref cap,
+                           bool move)
+{
+    errval_t err;
+
+    if (b->count >= b->slots) {
+        return LIB_ERR_LMP_CAP_BATCH_FULL;
+    }
+
+    struct capref dest = {
+        .cnode = b->cnode,
+        .slot  = b->count
+    };
+
+    err = cap_copy(dest, cap);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_CAP_COPY);
+    }
+    b->count++;
+
+    if (move) {
+        err = cap_destroy(cap);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_CAP_DESTROY);
+        }
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Set up a batch from a received CNode capability
+ *
+ * The size of the CNode is taken from the sender rather than looked up with
+ * cnode_build_cnoderef(), which would cost an RPC to the monitor.
+ *
+ * \param b         Storage for the batch
+ * \param cnode_cap Received CNode capability, owned by the batch afterwards
+ * \param count     Number of capabilities in the batch, as told by the sender
+ * \param size_bits Size of the CNode in slots (bits), as told by the sender
+ */
+errval_t lmp_cap_batch_from_cnode(struct lmp_cap_batch *b,
+                                  struct capref cnode_cap, cslot_t count,
+                                  uint8_t size_bits)
+{
+    if (size_bits >= sizeof(cslot_t) * NBBY || count > (1UL << size_bits)) {
+        return LIB_ERR_LMP_CAP_BATCH_FULL;
+    }
+
+    b->cnode_cap = cnode_cap;
+    b->cnode = build_cnoderef(cnode_cap, size_bits);
+    b->slots = 1UL << size_bits;
+    b->count = count;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Destroy a batch
+ *
+ * Deletes the CNode capability of the batch. Capabilities still in the
+ * batch are deleted with the CNode if this was its last copy.
+ */
+errval_t lmp_cap_batch_destroy(struct lmp_cap_batch *b)
+{
+    errval_t err = cap_destroy(b->cnode_cap);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_CAP_DESTROY);
+    }
+
+    b->cnode_cap = NULL_CAP;
+    b->count = 0;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Send a batch on an LMP channel
+ *
+ * Sends the CNode of the batch, given away, with the number of capabilities
+ * and the size of the CNode as payload. On success the batch is consumed:
+ * its CNode now belongs to the receiver and the sender's slot is freed.
+ *
+ * \param lc    LMP channel
+ * \param flags LMP send flags, #LMP_FLAG_GIVEAWAY is added
+ * \param b     Batch to send
+ */
+errval_t lmp_chan_send_cap_batch(struct lmp_chan *lc, lmp_send_flags_t flags,
+                                 struct lmp_cap_batch *b)
+{
+    errval_t err;
+
+    err = lmp_chan_send2(lc, flags | LMP_FLAG_GIVEAWAY, b->cnode_cap,
+                         b->count, b->cnode.size_bits);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = slot_free(b->cnode_cap);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_WHILE_FREEING_SLOT);
+    }
+
+    b->cnode_cap = NULL_CAP;
+    b->count = 0;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Receive a batch sent with lmp_chan_send_cap_batch()
+ *
+ * Non-blocking. On success a new receive slot is set on the channel, taken
+ * from the channel's reserve if there is one.
+ *
+ * \param lc LMP channel
+ * \param b  Storage for the received batch
+ */
+errval_t lmp_chan_recv_cap_batch(struct lmp_chan *lc, struct lmp_cap_batch *b)
+{
+    struct lmp_recv_msg msg = LMP_RECV_MSG_INIT;
+    struct capref cnode_cap;
+    errval_t err;
+
+    err = lmp_chan_recv(lc, &msg, &cnode_cap);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (capref_is_null(cnode_cap)) {
+        return LIB_ERR_NOT_CNODE;
+    }
+
+    err = lmp_chan_alloc_recv_slot(lc);
+    if (err_is_fail(err)) {
+        cap_destroy(cnode_cap);
+        return err_push(err, LIB_ERR_LMP_ALLOC_RECV_SLOT);
+    }
+
+    err = lmp_cap_batch_from_cnode(b, cnode_cap, msg.words[0], msg.words[1]);
+    if (err_is_fail(err)) {
+        cap_destroy(cnode_cap);
+    }
+    return err;
+}
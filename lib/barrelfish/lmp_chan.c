@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2009, 2010, 2011, ETH Zurich.
+ * Copyright (c) 2009, 2010, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -32,6 +32,7 @@ void lmp_chan_init(struct lmp_chan *lc)
     lc->connstate = LMP_DISCONNECTED;
     waitset_chanstate_init(&lc->send_waitset, CHANTYPE_LMP_OUT);
     lc->endpoint = NULL;
+    lc->recv_reserve_count = 0;
 #ifndef NDEBUG
     lc->prev = lc->next = NULL;
 #endif
@@ -187,6 +188,10 @@ void lmp_chan_destroy(struct lmp_chan *lc)
         lmp_endpoint_free(lc->endpoint);
     }
 
+    while (lc->recv_reserve_count > 0) {
+        slot_free(lc->recv_reserve[--lc->recv_reserve_count]);
+    }
+
     // remove from send retry queue on dispatcher
     if (waitset_chan_is_registered(&lc->send_waitset)) {
         assert(lc->prev != NULL && lc->next != NULL);
@@ -420,15 +425,49 @@ errval_t lmp_chan_alloc_recv_slot(struct lmp_chan *lc)
 {
     struct capref slot;
 
-    errval_t err = slot_alloc(&slot);
-    if (err_is_fail(err)) {
-        return err_push(err, LIB_ERR_SLOT_ALLOC);
+    if (lc->recv_reserve_count > 0) {
+        slot = lc->recv_reserve[--lc->recv_reserve_count];
+    } else {
+        errval_t err = slot_alloc(&slot);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_SLOT_ALLOC);
+        }
     }
 
     lmp_chan_set_recv_slot(lc, slot);
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Pre-allocate receive slots for an LMP channel
+ *
+ * Fills the channel's reserve of receive slots up to the given count (at
+ * most #LMP_RECV_SLOT_RESERVE). lmp_chan_alloc_recv_slot() takes slots from
+ * the reserve before it falls back to the slot allocator, so a receiver that
+ * expects a series of capabilities can pay for the allocations, and any
+ * slot allocator refills they trigger, up front rather than in its message
+ * handlers.
+ *
+ * \param lc    LMP channel
+ * \param count Number of slots to keep in reserve
+ */
+errval_t lmp_chan_reserve_recv_slots(struct lmp_chan *lc, size_t count)
+{
+    if (count > LMP_RECV_SLOT_RESERVE) {
+        count = LMP_RECV_SLOT_RESERVE;
+    }
+
+    while (lc->recv_reserve_count < count) {
+        errval_t err = slot_alloc(&lc->recv_reserve[lc->recv_reserve_count]);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_SLOT_ALLOC);
+        }
+        lc->recv_reserve_count++;
+    }
+
+    return SYS_ERR_OK;
+}
+
 /**
  * \brief Trigger send events for all LMP channels that are registered
  *
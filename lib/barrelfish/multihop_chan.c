@@ -17,7 +17,7 @@
 #include <barrelfish/idc_export.h>
 #include <flounder/flounder_support.h>
 #include <if/monitor_defs.h>
-#include <collections/hash_table.h>
+#include <collections/chash_map.h>
 #include <bench/bench.h>
 
 // TODO remove this
@@ -34,9 +34,11 @@
 ///////////////////////////////////////////////////////
 
 /**
- * We use a hash table to map VCIs to bindings.
+ * We use a hash table to map VCIs to bindings. It is looked up for every
+ * incoming message, but only changed when channels are created or
+ * destroyed, so lookups go through the lock-free read path.
  */
-static collections_hash_table *mappings;
+static collections_chash_map *mappings;
 
 // is the mapping table initialized?
 static bool is_mapping_table_initialized = false;
@@ -47,7 +49,7 @@ static inline void multihop_chan_init_mapping_table(void)
 
     if (!is_mapping_table_initialized) {
         is_mapping_table_initialized = true;
-        collections_hash_create_with_buckets(&mappings, MULTIHOP_MAPPING_TABLE_BACKETS,
+        collections_chash_map_create(&mappings, MULTIHOP_MAPPING_TABLE_BACKETS,
                 free);
         /*
          *  We use a constant as seed for the random function.
@@ -76,10 +78,8 @@ static inline multihop_vci_t multihop_chan_mapping_insert(
         // we assign VCIs randomly, but need
         // to make sure that it is not yet taken
         vci = (multihop_vci_t) rand();
-    } while (collections_hash_find(mappings, vci) != NULL);
+    } while (collections_chash_map_insert(mappings, vci, chan_state) != 0);
 
-    // insert into forwarding table
-    collections_hash_insert(mappings, vci, chan_state);
     return vci;
 }
 
@@ -87,7 +87,7 @@ static inline multihop_vci_t multihop_chan_mapping_insert(
 static inline void multihop_chan_mapping_delete(multihop_vci_t vci)
 {
     assert(is_mapping_table_initialized);
-    collections_hash_delete(mappings, vci);
+    collections_chash_map_delete(mappings, vci);
 }
 
 // get entry from the mapping table
@@ -95,7 +95,9 @@ static inline struct multihop_chan* multihop_chan_mappings_lookup(multihop_vci_t
 {
 
     assert(is_mapping_table_initialized);
-    struct multihop_chan *chan_state = collections_hash_find(mappings, vci);
+    collections_chash_map_reader r = collections_chash_map_read_lock(mappings);
+    struct multihop_chan *chan_state = collections_chash_map_find(mappings, vci);
+    collections_chash_map_read_unlock(mappings, r);
 
     if (chan_state == NULL) {
         USER_PANIC("invalid virtual circuit identifier in multi-hop channel");
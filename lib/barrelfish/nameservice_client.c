@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2010, 2011, 2012, ETH Zurich.
+ * Copyright (c) 2010, 2011, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -23,6 +23,33 @@
 #include <octopus/getset.h> // for oct_read TODO
 #include <octopus/trigger.h> // for NOP_TRIGGER
 
+static nameservice_lookup_cache_fn lookup_cache = NULL;
+
+/**
+ * \brief Sets a cache consulted by the name service lookups
+ *
+ * The octopus client library installs its record cache here (see
+ * oct_cache_enable). Pass NULL to go to the name server directly again.
+ */
+void nameservice_set_lookup_cache(nameservice_lookup_cache_fn fn)
+{
+    lookup_cache = fn;
+}
+
+static errval_t record_to_iref(const char *record, iref_t *retiref)
+{
+    uint64_t iref_number = 0;
+    errval_t err = oct_read(record, "_ { iref: %d }", &iref_number);
+    if (err_is_fail(err) || iref_number == 0) {
+        return err_push(err, LIB_ERR_NAMESERVICE_INVALID_NAME);
+    }
+    if (retiref != NULL) {
+        *retiref = iref_number;
+    }
+
+    return SYS_ERR_OK;
+}
+
 /**
  * \brief Non-blocking name service lookup
  *
@@ -39,13 +66,16 @@ errval_t nameservice_lookup(const char *iface, iref_t *retiref)
     }
 
     char* record = NULL;
-    octopus_trigger_id_t tid;
-    errval_t error_code;
-    err = r->vtbl.get(r, iface, NOP_TRIGGER, &record, &tid, &error_code);
-    if (err_is_fail(err)) {
-        goto out;
+    if (lookup_cache != NULL) {
+        err = lookup_cache(&record, iface);
+    } else {
+        octopus_trigger_id_t tid;
+        errval_t error_code;
+        err = r->vtbl.get(r, iface, NOP_TRIGGER, &record, &tid, &error_code);
+        if (err_is_ok(err)) {
+            err = error_code;
+        }
     }
-    err = error_code;
     if (err_is_fail(err)) {
         if (err_no(err) == OCT_ERR_NO_RECORD) {
             err = err_push(err, LIB_ERR_NAMESERVICE_UNKNOWN_NAME);
@@ -53,15 +83,7 @@ errval_t nameservice_lookup(const char *iface, iref_t *retiref)
         goto out;
     }
 
-    uint64_t iref_number = 0;
-    err = oct_read(record, "_ { iref: %d }", &iref_number);
-    if (err_is_fail(err) || iref_number == 0) {
-        err = err_push(err, LIB_ERR_NAMESERVICE_INVALID_NAME);
-        goto out;
-    }
-    if (retiref != NULL) {
-        *retiref = iref_number;
-    }
+    err = record_to_iref(record, retiref);
 
 out:
     free(record);
@@ -84,6 +106,18 @@ errval_t nameservice_blocking_lookup(const char *iface, iref_t *retiref)
     }
 
     char* record = NULL;
+    if (lookup_cache != NULL) {
+        // Only wait on the server if the name is not registered yet
+        err = lookup_cache(&record, iface);
+        if (err_is_ok(err)) {
+            err = record_to_iref(record, retiref);
+            free(record);
+            return err;
+        }
+        free(record);
+        record = NULL;
+    }
+
     errval_t error_code;
     err = r->vtbl.wait_for(r, iface, &record, &error_code);
     if (err_is_fail(err)) {
@@ -97,15 +131,7 @@ errval_t nameservice_blocking_lookup(const char *iface, iref_t *retiref)
         goto out;
     }
 
-    uint64_t iref_number = 0;
-    err = oct_read(record, "_ { iref: %d }", &iref_number);
-    if (err_is_fail(err)) {
-        err = err_push(err, LIB_ERR_NAMESERVICE_INVALID_NAME);
-        goto out;
-    }
-    if (retiref != NULL) {
-        *retiref = iref_number;
-    }
+    err = record_to_iref(record, retiref);
 
 out:
     free(record);
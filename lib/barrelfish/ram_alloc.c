@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, 2011, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -32,6 +32,8 @@ static errval_t ram_alloc_remote(struct capref *ret, uint8_t size_bits,
     // Therefore, we detect the situation when the slot_allocator
     // may grow itself and grow it before acquiring the lock.
     // Once this code become reentrant, this hack can be removed. -Akhi
+    // The allocator is used directly, as slot_alloc() may be served from
+    // the slot cache without ever reaching the allocator.
     struct slot_alloc_state *sas = get_slot_alloc_state();
     struct slot_allocator *ca = (struct slot_allocator*)(&sas->defca);
     if (ca->space == 1) {
@@ -40,12 +42,12 @@ static errval_t ram_alloc_remote(struct capref *ret, uint8_t size_bits,
         ram_set_affinity(0, 0);
         do {
                 struct capref cap;
-                err = slot_alloc(&cap);
+                err = ca->alloc(ca, &cap);
                 if (err_is_fail(err)) {
                     err = err_push(err, LIB_ERR_SLOT_ALLOC);
                     break;
                 }
-                err = slot_free(cap);
+                err = ca->free(ca, cap);
                 if (err_is_fail(err)) {
                     err = err_push(err, LIB_ERR_SLOT_FREE);
                     break;
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2010, ETH Zurich.
+ * Copyright (c) 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -17,5 +17,6 @@
 
 errval_t multi_alloc(struct slot_allocator *ca, struct capref *ret);
 errval_t multi_free(struct slot_allocator *ca, struct capref cap);
+bool multi_owns_slot(struct multi_slot_allocator *mca, struct capref cap);
 
 #endif //SLOT_ALLOC_INTERNAL_H_
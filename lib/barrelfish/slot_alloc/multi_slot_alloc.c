@@ -22,7 +22,7 @@
  */
 
 /*
- * Copyright (c) 2010, ETH Zurich.
+ * Copyright (c) 2010, 2016, ETH Zurich.
  * Copyright (c) 2014, HP Labs.
  * All rights reserved.
  *
@@ -168,6 +168,25 @@ errval_t multi_free(struct slot_allocator *ca, struct capref cap)
     return LIB_ERR_SLOT_ALLOC_WRONG_CNODE;
 }
 
+/**
+ * \brief Check whether a slot belongs to one of the CNodes of the allocator
+ *
+ * Does not take the allocator's mutex. The list of single slot allocators
+ * only ever grows at its head and its entries are never freed, so the
+ * caller only needs to make sure it is not preempted by a thread of the
+ * same dispatcher, e.g. by running disabled.
+ */
+bool multi_owns_slot(struct multi_slot_allocator *mca, struct capref cap)
+{
+    for (struct slot_allocator_list *walk = mca->head; walk != NULL;
+         walk = walk->next) {
+        if (cnodecmp(cap.cnode, walk->a.cnode)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
  * \brief Initializer that does not allocate any space
  *
@@ -6,10 +6,18 @@
  * vspace_add_vregion uses malloc to increase it's slab.
  * Since malloc depends upon slot_alloc_init being called successfully,
  * vspace_add_vregion should have enough initial slab space to not use malloc.
+ *
+ * slot_alloc() and slot_free() go through a per-dispatcher cache of free
+ * slots of the default allocator, accessed with the dispatcher disabled
+ * rather than under the allocator's mutex. The cache is refilled and
+ * drained in batches of #SLOT_CACHE_BATCH slots. A refill never takes the
+ * last free slot of the default allocator, so only an allocation that
+ * misses the cache can make the allocator grow, exactly as without the
+ * cache (see the comment in ram_alloc_remote()).
  */
 
 /*
- * Copyright (c) 2010, ETH Zurich.
+ * Copyright (c) 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -19,6 +27,7 @@
 
 #include <barrelfish/barrelfish.h>
 #include <barrelfish/core_state.h>
+#include <barrelfish/dispatch.h>
 #include <barrelfish/caddr.h>
 #include "internal.h"
 
@@ -32,17 +41,135 @@ struct slot_allocator *get_default_slot_allocator(void)
     return (struct slot_allocator*)(&state->defca);
 }
 
+/**
+ * \brief Move up to count slots from the default allocator into the cache
+ *
+ * \param grow If false, stop before the default allocator runs out of space
+ *             and would have to grow
+ */
+static errval_t slot_cache_refill(struct slot_alloc_state *state,
+                                  size_t count, bool grow)
+{
+    struct slot_allocator *ca = (struct slot_allocator*)(&state->defca);
+    struct slot_cache *cache = &state->cache;
+    errval_t err;
+
+    for (size_t i = 0; i < count; i++) {
+        if (!grow && ca->space <= 1) {
+            break;
+        }
+
+        struct capref slot;
+        err = ca->alloc(ca, &slot);
+        if (err_is_fail(err)) {
+            return err;
+        }
+
+        dispatcher_handle_t handle = disp_disable();
+        if (cache->count == SLOT_CACHE_SLOTS) {
+            disp_enable(handle);
+            return ca->free(ca, slot);
+        }
+        cache->slots[cache->count++] = slot;
+        disp_enable(handle);
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Return a batch of cached slots to the default allocator
+ */
+static errval_t slot_cache_drain(struct slot_alloc_state *state)
+{
+    struct slot_allocator *ca = (struct slot_allocator*)(&state->defca);
+    struct slot_cache *cache = &state->cache;
+    struct capref slots[SLOT_CACHE_BATCH];
+    size_t count = 0;
+    errval_t err = SYS_ERR_OK;
+
+    dispatcher_handle_t handle = disp_disable();
+    while (count < SLOT_CACHE_BATCH && cache->count > SLOT_CACHE_BATCH) {
+        slots[count++] = cache->slots[--cache->count];
+    }
+    disp_enable(handle);
+
+    for (size_t i = 0; i < count; i++) {
+        errval_t err2 = ca->free(ca, slots[i]);
+        if (err_is_fail(err2)) {
+            err = err2;
+        }
+    }
+
+    return err;
+}
+
 /**
  * \brief Default slot allocator
  *
  * \param ret Pointer to the cap to return the allocated slot in
  *
- * Allocates one slot from the default allocator
+ * Allocates one slot from the default allocator, through the dispatcher's
+ * slot cache
  */
 errval_t slot_alloc(struct capref *ret)
 {
+    struct slot_alloc_state *state = get_slot_alloc_state();
+    struct slot_cache *cache = &state->cache;
+
+    dispatcher_handle_t handle = disp_disable();
+    if (cache->count > 0) {
+        *ret = cache->slots[--cache->count];
+        disp_enable(handle);
+        return SYS_ERR_OK;
+    }
+    disp_enable(handle);
+
     struct slot_allocator *ca = get_default_slot_allocator();
-    return ca->alloc(ca, ret);
+    errval_t err = ca->alloc(ca, ret);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    // refill the cache for the next allocations, if that is possible
+    // without growing the allocator
+    err = slot_cache_refill(state, SLOT_CACHE_BATCH, false);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "refilling slot cache");
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Fill the calling dispatcher's slot cache ahead of time
+ *
+ * Moves slots from the default allocator into the slot cache until it
+ * holds at least the given number of slots (at most #SLOT_CACHE_SLOTS),
+ * growing the allocator if needed. The next slot_alloc() calls on this
+ * dispatcher then neither take a lock nor wait for a CNode to be created.
+ * Call this before a phase that allocates many slots, or that must not
+ * stall, e.g. before mapping a large region or before a burst of
+ * capability receives.
+ *
+ * \param slots Number of slots to have in the cache
+ */
+errval_t slot_alloc_prefill(cslot_t slots)
+{
+    struct slot_alloc_state *state = get_slot_alloc_state();
+
+    if (slots > SLOT_CACHE_SLOTS) {
+        slots = SLOT_CACHE_SLOTS;
+    }
+    if (state->cache.count >= slots) {
+        return SYS_ERR_OK;
+    }
+
+    errval_t err = slot_cache_refill(state, slots - state->cache.count, true);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_SLOT_ALLOC);
+    }
+    return SYS_ERR_OK;
 }
 
 /**
@@ -85,6 +212,18 @@ errval_t slot_free(struct capref ret)
         return ca->free(ca, ret);
     }
 
+    // put slots of the default allocator into the cache
+    struct slot_cache *cache = &state->cache;
+    dispatcher_handle_t handle = disp_disable();
+    if (cache->count < SLOT_CACHE_SLOTS
+        && multi_owns_slot(&state->defca, ret)) {
+        cache->slots[cache->count++] = ret;
+        bool full = cache->count == SLOT_CACHE_SLOTS;
+        disp_enable(handle);
+        return full ? slot_cache_drain(state) : SYS_ERR_OK;
+    }
+    disp_enable(handle);
+
     struct slot_allocator *ca = (struct slot_allocator*)(&state->defca);
     errval_t err = ca->free(ca, ret);
     // XXX: Detect frees in special case of init and mem_serv
@@ -125,6 +264,8 @@ errval_t slot_alloc_init(void)
     def->reserve = &state->reserve;
     def->reserve->next = NULL;
 
+    state->cache.count = 0;
+
     // Top
     cap.cnode = cnode_root;
     cap.slot  = ROOTCN_SLOT_SLOT_ALLOC0;
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, 2012, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -15,6 +15,7 @@
 #include <barrelfish/barrelfish.h>
 #include <barrelfish/dispatch.h>
 #include <barrelfish/dispatcher_arch.h>
+#include <barrelfish/curdispatcher_arch.h>
 #include <trace/trace.h>
 #include <trace_definitions/trace_defs.h>
 #include "threads_priv.h"
@@ -168,6 +169,48 @@ void thread_mutex_init(struct thread_mutex *mutex)
     mutex->lock = 0;
 }
 
+/// Number of times to poll a mutex held by a running thread before blocking
+#define THREAD_MUTEX_SPIN_LIMIT 512
+
+static inline void spin_pause(void)
+{
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__k1om__)
+    __asm__ __volatile__("pause" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+/**
+ * \brief Wait briefly for a mutex whose holder runs on another dispatcher
+ *
+ * A blocked thread has to be woken by the holder's dispatcher, which costs
+ * far more than a short critical section. So while the holder is the
+ * running thread of another dispatcher, poll the mutex for a bounded time
+ * before falling back to blocking.
+ *
+ * \param mutex Mutex pointer
+ */
+static void thread_mutex_spin(struct thread_mutex *mutex)
+{
+    dispatcher_handle_t handle = curdispatcher();
+
+    for (int i = 0; i < THREAD_MUTEX_SPIN_LIMIT && mutex->locked > 0; i++) {
+        // The holder may exit meanwhile, but its TCB is never unmapped
+        struct thread *holder = __atomic_load_n(&mutex->holder,
+                                                __ATOMIC_RELAXED);
+        if (holder == NULL || holder->disp == handle) {
+            return;
+        }
+        struct dispatcher_generic *holder_disp =
+            get_dispatcher_generic(holder->disp);
+        if (__atomic_load_n(&holder_disp->current, __ATOMIC_RELAXED) != holder) {
+            return;
+        }
+        spin_pause();
+    }
+}
+
 /**
  * \brief Lock a mutex
  *
@@ -177,6 +220,10 @@ void thread_mutex_init(struct thread_mutex *mutex)
  */
 void thread_mutex_lock(struct thread_mutex *mutex)
 {
+    if (mutex->locked > 0) {
+        thread_mutex_spin(mutex);
+    }
+
     dispatcher_handle_t handle = disp_disable();
     struct dispatcher_generic *disp_gen = get_dispatcher_generic(handle);
 
@@ -207,6 +254,10 @@ void thread_mutex_lock(struct thread_mutex *mutex)
  */
 void thread_mutex_lock_nested(struct thread_mutex *mutex)
 {
+    if (mutex->locked > 0) {
+        thread_mutex_spin(mutex);
+    }
+
     dispatcher_handle_t handle = disp_disable();
     struct dispatcher_generic *disp_gen = get_dispatcher_generic(handle);
 
@@ -334,6 +385,256 @@ void thread_mutex_unlock(struct thread_mutex *mutex)
     }
 }
 
+/**
+ * \brief Initialise a reader-writer lock
+ *
+ * \param rwlock Reader-writer lock pointer
+ */
+void thread_rwlock_init(struct thread_rwlock *rwlock)
+{
+    rwlock->lock = 0;
+    rwlock->writers = 0;
+    rwlock->writer = NULL;
+    rwlock->read_queue = NULL;
+    rwlock->write_queue = NULL;
+    rwlock->drain_queue = NULL;
+    for (int i = 0; i < THREAD_RWLOCK_READER_SLOTS; i++) {
+        rwlock->readers[i].count = 0;
+    }
+}
+
+/// Reader counter of the calling core
+static inline volatile int *rwlock_slot(struct thread_rwlock *rwlock)
+{
+    return &rwlock->readers[disp_get_core_id()
+                            % THREAD_RWLOCK_READER_SLOTS].count;
+}
+
+/// Number of readers holding the lock, summed over all cores
+static int rwlock_readers(struct thread_rwlock *rwlock)
+{
+    int sum = 0;
+    for (int i = 0; i < THREAD_RWLOCK_READER_SLOTS; i++) {
+        sum += __atomic_load_n(&rwlock->readers[i].count, __ATOMIC_SEQ_CST);
+    }
+    return sum;
+}
+
+/**
+ * \brief Drop a reader, waking a writer waiting for the readers to drain
+ *
+ * A reader may drop its count on a different core than it took it on, only
+ * the sum over all counters is meaningful.
+ */
+static void rwlock_reader_exit(struct thread_rwlock *rwlock)
+{
+    __atomic_fetch_sub(rwlock_slot(rwlock), 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&rwlock->writers, __ATOMIC_SEQ_CST) == 0) {
+        return;
+    }
+
+    dispatcher_handle_t disp = disp_disable();
+    struct thread *wakeup = NULL;
+    errval_t err = SYS_ERR_OK;
+    acquire_spinlock(&rwlock->lock);
+
+    if (rwlock->drain_queue != NULL && rwlock_readers(rwlock) == 0) {
+        wakeup = thread_unblock_one_disabled(disp, &rwlock->drain_queue, NULL);
+    }
+
+    if (wakeup != NULL) {
+        err = domain_wakeup_on_disabled(wakeup->disp, wakeup, disp);
+        assert_disabled(err_is_ok(err));
+    }
+
+    release_spinlock(&rwlock->lock);
+    disp_enable(disp);
+
+    if(err_is_fail(err)) {
+        USER_PANIC_ERR(err, "remote wakeup from rwlock unlock");
+    }
+}
+
+/**
+ * \brief Try to lock a reader-writer lock for reading
+ *
+ * Readers only touch the counter of their own core, unless a writer holds
+ * or waits for the lock.
+ *
+ * \param rwlock Reader-writer lock pointer
+ *
+ * \returns true if lock acquired, false otherwise
+ */
+bool thread_rwlock_tryrdlock(struct thread_rwlock *rwlock)
+{
+    if (__atomic_load_n(&rwlock->writers, __ATOMIC_SEQ_CST) > 0) {
+        return false;
+    }
+
+    __atomic_fetch_add(rwlock_slot(rwlock), 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&rwlock->writers, __ATOMIC_SEQ_CST) == 0) {
+        return true;
+    }
+
+    // Lost against a writer, back off
+    rwlock_reader_exit(rwlock);
+    return false;
+}
+
+/**
+ * \brief Lock a reader-writer lock for reading
+ *
+ * This blocks while a writer holds or waits for the lock. Readers may not
+ * take the lock recursively, as a waiting writer would block the inner call.
+ *
+ * \param rwlock Reader-writer lock pointer
+ */
+void thread_rwlock_rdlock(struct thread_rwlock *rwlock)
+{
+    while (!thread_rwlock_tryrdlock(rwlock)) {
+        dispatcher_handle_t disp = disp_disable();
+        acquire_spinlock(&rwlock->lock);
+        if (rwlock->writers > 0) {
+            thread_block_and_release_spinlock_disabled(disp, &rwlock->read_queue,
+                                                       &rwlock->lock);
+        } else {
+            release_spinlock(&rwlock->lock);
+            disp_enable(disp);
+        }
+    }
+}
+
+/**
+ * \brief Lock a reader-writer lock for writing
+ *
+ * This blocks until the current writer, if any, hands over the lock and all
+ * readers have left. Waiting writers keep new readers out.
+ *
+ * \param rwlock Reader-writer lock pointer
+ */
+void thread_rwlock_wrlock(struct thread_rwlock *rwlock)
+{
+    dispatcher_handle_t disp = disp_disable();
+    struct dispatcher_generic *disp_gen = get_dispatcher_generic(disp);
+
+    acquire_spinlock(&rwlock->lock);
+    __atomic_fetch_add(&rwlock->writers, 1, __ATOMIC_SEQ_CST);
+
+    if (rwlock->writer != NULL) {
+        // The current writer hands the lock over on unlock
+        thread_block_and_release_spinlock_disabled(disp, &rwlock->write_queue,
+                                                   &rwlock->lock);
+        disp = disp_disable();
+        acquire_spinlock(&rwlock->lock);
+    } else {
+        rwlock->writer = disp_gen->current;
+    }
+
+    while (rwlock_readers(rwlock) != 0) {
+        thread_block_and_release_spinlock_disabled(disp, &rwlock->drain_queue,
+                                                   &rwlock->lock);
+        disp = disp_disable();
+        acquire_spinlock(&rwlock->lock);
+    }
+
+    release_spinlock(&rwlock->lock);
+    disp_enable(disp);
+}
+
+/**
+ * \brief Release the write lock, handing it to the next writer if any
+ */
+static void rwlock_writer_exit(struct thread_rwlock *rwlock)
+{
+    dispatcher_handle_t disp = disp_disable();
+    struct thread *wakeup = NULL, *wakeupq = NULL;
+    errval_t err = SYS_ERR_OK;
+
+    acquire_spinlock(&rwlock->lock);
+    __atomic_fetch_sub(&rwlock->writers, 1, __ATOMIC_SEQ_CST);
+
+    if (rwlock->write_queue != NULL) {
+        // XXX: This assumes dequeueing is off the top of the queue
+        rwlock->writer = rwlock->write_queue;
+        wakeup = thread_unblock_one_disabled(disp, &rwlock->write_queue, NULL);
+        if (wakeup != NULL) {
+            err = domain_wakeup_on_disabled(wakeup->disp, wakeup, disp);
+            assert_disabled(err_is_ok(err));
+        }
+    } else {
+        rwlock->writer = NULL;
+        wakeupq = thread_unblock_all_disabled(disp, &rwlock->read_queue, NULL);
+    }
+
+    release_spinlock(&rwlock->lock);
+    disp_enable(disp);
+
+    if(err_is_fail(err)) {
+        USER_PANIC_ERR(err, "remote wakeup from rwlock unlock");
+    }
+
+    // Now, wakeup all readers on foreign dispatchers
+    while (wakeupq != NULL) {
+        wakeup = wakeupq;
+        wakeupq = wakeupq->next;
+        err = domain_wakeup_on(wakeup->disp, wakeup);
+        if(err_is_fail(err)) {
+            USER_PANIC_ERR(err, "remote wakeup from rwlock unlock");
+        }
+    }
+}
+
+/**
+ * \brief Try to lock a reader-writer lock for writing
+ *
+ * \param rwlock Reader-writer lock pointer
+ *
+ * \returns true if lock acquired, false otherwise
+ */
+bool thread_rwlock_trywrlock(struct thread_rwlock *rwlock)
+{
+    // Try first to avoid contention
+    if (rwlock->writers > 0 || rwlock_readers(rwlock) != 0) {
+        return false;
+    }
+
+    dispatcher_handle_t disp = disp_disable();
+    struct dispatcher_generic *disp_gen = get_dispatcher_generic(disp);
+    bool ret = false;
+
+    acquire_spinlock(&rwlock->lock);
+    if (rwlock->writer == NULL) {
+        __atomic_fetch_add(&rwlock->writers, 1, __ATOMIC_SEQ_CST);
+        rwlock->writer = disp_gen->current;
+        ret = rwlock_readers(rwlock) == 0;
+    }
+    release_spinlock(&rwlock->lock);
+    disp_enable(disp);
+
+    if (!ret && rwlock->writer == disp_gen->current) {
+        // A reader got in first, readers we kept out have to be woken
+        rwlock_writer_exit(rwlock);
+    }
+    return ret;
+}
+
+/**
+ * \brief Unlock a reader-writer lock
+ *
+ * This releases the write lock if the calling thread holds it, and a read
+ * lock otherwise.
+ *
+ * \param rwlock Reader-writer lock pointer
+ */
+void thread_rwlock_unlock(struct thread_rwlock *rwlock)
+{
+    if (rwlock->writer == thread_self()) {
+        rwlock_writer_exit(rwlock);
+    } else {
+        rwlock_reader_exit(rwlock);
+    }
+}
+
 void thread_sem_init(struct thread_sem *sem, unsigned int value)
 {
     assert(sem != NULL);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -14,6 +14,7 @@
 #include <bulk_transfer/bulk_transfer.h>
 #include <bulk_transfer/bulk_net.h>
 #include <bulk_transfer/bulk_allocator.h>
+#include <dma/dma_copy.h>
 #include <ipv4/lwip/inet.h>
 
 #include "../../bulk_pool.h"
@@ -602,7 +603,9 @@ static void handle_buffer_move(struct bulk_net_transp *p,
     assert(!err_is_fail(err));
 
     rb = msg->parts[1].opaque;
-    memcpy(buf->address, rb->virt, buf->pool->buffer_size);
+    err = dma_copy(dma_copy_default_engine(), buf->address, buf->phys,
+                   rb->virt, rb->phys, buf->pool->buffer_size);
+    assert(err_is_ok(err));
     bulk_net_transfer_free_rb(&p->net_ctrl, rb);
 
     rb = msg->parts[2].opaque;
@@ -685,7 +688,9 @@ static void handle_buffer_copy(struct bulk_net_transp *p,
     assert(!err_is_fail(err));
 
     rb = msg->parts[1].opaque;
-    memcpy(buf->address, rb->virt, buf->pool->buffer_size);
+    err = dma_copy(dma_copy_default_engine(), buf->address, buf->phys,
+                   rb->virt, rb->phys, buf->pool->buffer_size);
+    assert(err_is_ok(err));
     bulk_net_transfer_free_rb(&p->net_ctrl, rb);
 
     rb = msg->parts[2].opaque;
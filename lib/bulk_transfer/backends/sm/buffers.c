@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009, 2010, 2011, 2012, ETH Zurich.
+ * Copyright (c) 2009, 2010, 2011, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -688,10 +688,10 @@ void bulk_sm_release_rx_call(
         err = BULK_TRANSFER_BUFFER_INVALID;
     } else {
         buffer = pool->buffers[bufferid];
-        buffer->local_ref_count--;
-        //TODO: make the decrease atomic? (so only the last decrease reclaims it)
+        uint32_t refs = __atomic_sub_fetch(&buffer->local_ref_count, 1,
+                                           __ATOMIC_ACQ_REL);
         //TODO: find out what the refcount should be to take action (0 or 1?)
-        if (buffer->local_ref_count == 0 && buffer->state == BULK_BUFFER_RO_OWNED){
+        if (refs == 0 && buffer->state == BULK_BUFFER_RO_OWNED){
             //retake ownership
             if (channel->trust == BULK_TRUST_NONE){
                 err = cap_revoke(buffer->cap);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009, 2010, 2011, 2012, ETH Zurich.
+ * Copyright (c) 2009, 2010, 2011, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -122,6 +122,18 @@ void bulk_sm_release_rx_response(
         bulk_ctrl_error_t        error,
         uint32_t                 tid);
 
+void bulk_sm_ring_setup_rx_call(
+        struct bulk_ctrl_binding *b,
+        struct capref            frame,
+        uint32_t                 slots);
+
+void bulk_sm_ring_setup_rx_response(
+        struct bulk_ctrl_binding *b,
+        bulk_ctrl_error_t        error);
+
+void bulk_sm_ring_notify_rx(
+        struct bulk_ctrl_binding *b);
+
 // Flounder generic callbacks ---------------------------------------------
 
 //printing handler for asynchronous errors
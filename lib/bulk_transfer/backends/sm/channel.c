@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2009, 2010, 2011, 2012, ETH Zurich.
+ * Copyright (c) 2009, 2010, 2011, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -55,6 +55,9 @@ struct bulk_ctrl_rx_vtbl bulk_ctrl_rx_vtbl = {
     .pass_response        = bulk_sm_pass_rx_response,
     .release_call         = bulk_sm_release_rx_call,
     .release_response     = bulk_sm_release_rx_response,
+    .ring_setup_call      = bulk_sm_ring_setup_rx_call,
+    .ring_setup_response  = bulk_sm_ring_setup_rx_response,
+    .ring_notify          = bulk_sm_ring_notify_rx,
 };
 
 // Channel Management -----------------------------------------------------
@@ -318,6 +321,7 @@ errval_t bulk_sm_channel_bind(struct bulk_channel      *channel,
 
     thread_mutex_init(&data->resend_lock);
     data->resend_closure = NULL;
+    data->ring = NULL;
 
     // Bind to iref
     errval_t err = bulk_ctrl_bind(ep->iref,
@@ -419,6 +423,7 @@ errval_t bulk_sm_channel_create(struct bulk_channel *channel)
 
     thread_mutex_init(&data->resend_lock);
     data->resend_closure = NULL;
+    data->ring = NULL;
 
     // channel initialized
     channel->state = BULK_STATE_INITIALIZED;
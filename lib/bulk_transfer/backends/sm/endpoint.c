@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2009, 2010, 2011, 2012, ETH Zurich.
+ * Copyright (c) 2009, 2010, 2011, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -50,3 +50,35 @@ errval_t bulk_sm_ep_create_remote(struct bulk_sm_endpoint_descriptor *ep_desc,
     ep_desc->iref = remote_iref;
     return SYS_ERR_OK;
 }
+
+/**
+ * Creates a new bulk endpoint which uses the shared memory backend with
+ * descriptor rings (exporting side).
+ *
+ * @param ep_desc   memory location to create the endpoint in
+ */
+errval_t bulk_sm_ring_ep_create(struct bulk_sm_endpoint_descriptor *ep_desc)
+{
+    errval_t err = bulk_sm_ep_create(ep_desc);
+    if (err_is_ok(err)) {
+        ep_desc->ep_generic.f = bulk_sm_ring_get_implementation();
+    }
+    return err;
+}
+
+/**
+ * Creates a new bulk endpoint which uses the shared memory backend with
+ * descriptor rings (binding side).
+ *
+ * @param ep_desc       memory location to create the endpoint in
+ * @param remote_iref   the iref of the exported service on the other side
+ */
+errval_t bulk_sm_ring_ep_create_remote(struct bulk_sm_endpoint_descriptor *ep_desc,
+                                       iref_t remote_iref)
+{
+    errval_t err = bulk_sm_ep_create_remote(ep_desc, remote_iref);
+    if (err_is_ok(err)) {
+        ep_desc->ep_generic.f = bulk_sm_ring_get_implementation();
+    }
+    return err;
+}
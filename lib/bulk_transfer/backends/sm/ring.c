@@ -0,0 +1,697 @@
+/**
+ * \file
+ * \brief Lock-free descriptor rings for the shared memory bulk backend
+ *
+ * A fully trusted channel between two ring endpoints shares one frame with
+ * two rings of cacheline-sized descriptors, one per direction. Moves, copies,
+ * passes and releases are written into the ring as descriptors instead of
+ * being sent as individual bulk_ctrl messages.
+ *
+ * Every slot of a ring carries a sequence number. A producer reserves a slot
+ * by advancing the ring's tail with a compare-and-swap and publishes it by
+ * setting the slot's sequence number, so any number of threads may produce
+ * into a ring without taking a lock. The consumer is the thread dispatching
+ * the channel's waitset. It drains the ring in batches and marks it idle once
+ * it is empty; the first producer to find the ring idle sends a ring_notify
+ * message to wake it up again.
+ *
+ * Channel setup and pool assignment are done by the shared memory backend.
+ * Operations whose meta data does not fit into a descriptor, or that find the
+ * ring full, are sent as messages as well.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/static_assert.h>
+
+#include <bulk_transfer/bulk_transfer.h>
+#include <bulk_transfer/bulk_sm.h>
+
+#include "../../bulk_pool.h"
+#include "../../bulk_buffer.h"
+#include "bulk_sm_impl.h"
+
+#if 0
+#define BULK_RING_DEBUG(fmt, msg...) debug_printf("bulk_sm_ring: "fmt"\n", msg)
+#else
+#define BULK_RING_DEBUG(fmt, msg...)
+#endif
+
+/// number of descriptors per ring, a power of two
+#define BULK_SM_RING_SLOTS      256
+
+/// meta data that fits into a descriptor
+#define BULK_SM_RING_META_SIZE  36
+
+#define BULK_SM_RING_LINE       64
+
+enum bulk_sm_ring_op {
+    BULK_SM_RING_MOVE = 1,
+    BULK_SM_RING_COPY,
+    BULK_SM_RING_PASS,
+    BULK_SM_RING_RELEASE,
+};
+
+/// a buffer transfer, exactly one cacheline
+struct bulk_sm_ring_desc {
+    uint64_t    seq;            ///< slot sequence number
+    uint32_t    pool_machine;
+    uint32_t    pool_dom;
+    uint32_t    pool_local;
+    uint32_t    bufferid;
+    uint8_t     op;             ///< enum bulk_sm_ring_op
+    uint8_t     metasize;
+    uint8_t     reserved[2];
+    uint8_t     meta[BULK_SM_RING_META_SIZE];
+} __attribute__((aligned(BULK_SM_RING_LINE)));
+
+STATIC_ASSERT_SIZEOF(struct bulk_sm_ring_desc, BULK_SM_RING_LINE);
+
+/// a ring in the shared frame, the fields written by different sides are
+/// kept on separate cachelines
+struct bulk_sm_ring {
+    uint64_t    tail __attribute__((aligned(BULK_SM_RING_LINE)));  ///< producers
+    uint64_t    head __attribute__((aligned(BULK_SM_RING_LINE)));  ///< consumer
+    uint32_t    idle __attribute__((aligned(BULK_SM_RING_LINE)));  ///< doorbell
+    struct bulk_sm_ring_desc slots[];
+};
+
+/// local state of a channel endpoint using rings
+struct bulk_sm_ring_channel {
+    struct bulk_sm_ring      *tx;       ///< ring this side produces into
+    struct bulk_sm_ring      *rx;       ///< ring this side consumes, or NULL
+    uint32_t                  mask;     ///< number of slots - 1
+    bool                      tx_ready; ///< the peer consumes the tx ring
+    struct capref             frame;
+    void                     *base;
+    struct bulk_continuation  bind_cont; ///< binding side: user continuation
+    struct bulk_sm_ring_stats stats;
+};
+
+/// reply to a ring setup request
+struct ring_setup_reply {
+    struct bulk_channel *channel;
+    errval_t             err;
+};
+
+static inline size_t ring_bytes(uint32_t slots)
+{
+    return sizeof(struct bulk_sm_ring)
+           + slots * sizeof(struct bulk_sm_ring_desc);
+}
+
+static inline size_t ring_frame_bytes(uint32_t slots)
+{
+    return ROUND_UP(2 * ring_bytes(slots), BASE_PAGE_SIZE);
+}
+
+static inline struct bulk_sm_ring_channel *channel_ring(struct bulk_channel *c)
+{
+    return CHANNEL_DATA(c)->ring;
+}
+
+static inline void stats_inc(uint64_t *counter)
+{
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+// Ring operations --------------------------------------------------------
+
+static void ring_init(struct bulk_sm_ring *ring, uint32_t slots)
+{
+    ring->tail = 0;
+    ring->head = 0;
+    ring->idle = 1;
+    for (uint32_t i = 0; i < slots; i++) {
+        ring->slots[i].seq = i;
+    }
+}
+
+/**
+ * reserves a slot, fills it and publishes it. Safe to call from any number
+ * of threads.
+ *
+ * @return false if the ring is full
+ */
+static bool ring_enqueue(struct bulk_sm_ring *ring, uint32_t mask,
+                         const struct bulk_sm_ring_desc *d)
+{
+    uint64_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    struct bulk_sm_ring_desc *slot;
+
+    for (;;) {
+        slot = &ring->slots[pos & mask];
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+
+        if (diff == 0) {
+            // slot is free, try to reserve it
+            if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // the consumer has not yet freed the slot of the previous round
+            return false;
+        } else {
+            // another producer took this slot
+            pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy((uint8_t *)slot + sizeof(slot->seq), (uint8_t *)d + sizeof(d->seq),
+           sizeof(*d) - sizeof(d->seq));
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/**
+ * takes the next published descriptor out of the ring. Only called by the
+ * consumer.
+ *
+ * @return false if the next slot has not been published yet
+ */
+static bool ring_dequeue(struct bulk_sm_ring *ring, uint32_t mask,
+                         struct bulk_sm_ring_desc *d)
+{
+    uint64_t pos = ring->head;
+    struct bulk_sm_ring_desc *slot = &ring->slots[pos & mask];
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+        return false;
+    }
+
+    memcpy(d, slot, sizeof(*d));
+    // hand the slot to the producers of the next round
+    __atomic_store_n(&slot->seq, pos + mask + 1, __ATOMIC_RELEASE);
+    ring->head = pos + 1;
+
+    return true;
+}
+
+static bool ring_pending(struct bulk_sm_ring *ring, uint32_t mask)
+{
+    uint64_t pos = ring->head;
+    return __atomic_load_n(&ring->slots[pos & mask].seq, __ATOMIC_ACQUIRE)
+           == pos + 1;
+}
+
+// Doorbell ---------------------------------------------------------------
+
+static errval_t ring_send_notify(void *a)
+{
+    struct bulk_channel      *channel = VOID2CHANNEL(a);
+    struct bulk_ctrl_binding *b       = CHANNEL_BINDING(channel);
+
+    struct event_closure txcont = MKCONT(bulk_sm_flounder_msg_sent_debug_cb,
+            "bulk_sm_ring_notify sent");
+
+    return bulk_ctrl_ring_notify__tx(b, txcont);
+}
+
+/**
+ * wakes up the consumer of the tx ring if it went idle. Only the producer
+ * that clears the idle flag sends a message.
+ */
+static void ring_kick(struct bulk_channel *channel,
+                      struct bulk_sm_ring_channel *r)
+{
+    // order the publication of the slot before reading the idle flag, pairs
+    // with the barrier in ring_drain()
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&r->tx->idle, __ATOMIC_RELAXED)
+        && __atomic_exchange_n(&r->tx->idle, 0, __ATOMIC_SEQ_CST)) {
+        stats_inc(&r->stats.notifies);
+        bulk_sm_flounder_send_fifo_msg(channel, ring_send_notify);
+    }
+}
+
+// Consumer ---------------------------------------------------------------
+
+static void ring_deliver(struct bulk_channel *channel,
+                         struct bulk_sm_ring_desc *d)
+{
+    errval_t err;
+    struct bulk_pool_id poolid = {
+        .machine = d->pool_machine,
+        .dom     = d->pool_dom,
+        .local   = d->pool_local,
+    };
+
+    struct bulk_pool *pool = bulk_pool_get(&poolid, channel);
+    if (pool == NULL) {
+        DEBUG_ERR(BULK_TRANSFER_POOL_INVALD, "bulk_sm_ring: dropping descriptor");
+        return;
+    }
+    if (d->bufferid >= pool->num_buffers) {
+        DEBUG_ERR(BULK_TRANSFER_BUFFER_INVALID,
+                  "bulk_sm_ring: dropping descriptor");
+        return;
+    }
+
+    struct bulk_buffer *buffer = pool->buffers[d->bufferid];
+    void *meta = (d->metasize) ? d->meta : NULL;
+
+    BULK_RING_DEBUG("op %u, buffer %p", d->op, buffer);
+
+    switch (d->op) {
+    case BULK_SM_RING_MOVE:
+        err = bulk_buffer_change_state(buffer, BULK_BUFFER_READ_WRITE);
+        if (err_is_ok(err) && channel->callbacks->move_received) {
+            channel->callbacks->move_received(channel, buffer, meta);
+        }
+        break;
+
+    case BULK_SM_RING_COPY:
+        err = bulk_buffer_change_state(buffer, BULK_BUFFER_READ_ONLY);
+        if (err_is_ok(err) && channel->callbacks->copy_received) {
+            channel->callbacks->copy_received(channel, buffer, meta);
+        }
+        break;
+
+    case BULK_SM_RING_PASS:
+        err = bulk_buffer_change_state(buffer, BULK_BUFFER_READ_WRITE);
+        if (err_is_ok(err) && channel->callbacks->buffer_received) {
+            channel->callbacks->buffer_received(channel, buffer, meta);
+        }
+        break;
+
+    case BULK_SM_RING_RELEASE:
+        err = SYS_ERR_OK;
+        if (__atomic_sub_fetch(&buffer->local_ref_count, 1, __ATOMIC_ACQ_REL) == 0
+            && buffer->state == BULK_BUFFER_RO_OWNED) {
+            // the last copy came back, retake ownership
+            err = bulk_buffer_change_state(buffer, BULK_BUFFER_READ_WRITE);
+        }
+        if (err_is_ok(err) && channel->callbacks->copy_released) {
+            channel->callbacks->copy_released(channel, buffer);
+        }
+        break;
+
+    default:
+        err = BULK_TRANSFER_INVALID_ARGUMENT;
+        break;
+    }
+
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "bulk_sm_ring: failed to deliver descriptor");
+    }
+}
+
+/**
+ * delivers all published descriptors of the rx ring, then marks it idle
+ */
+static void ring_drain(struct bulk_channel *channel,
+                       struct bulk_sm_ring_channel *r)
+{
+    struct bulk_sm_ring *ring = r->rx;
+    struct bulk_sm_ring_desc d;
+
+    r->stats.drains++;
+
+    for (;;) {
+        while (ring_dequeue(ring, r->mask, &d)) {
+            r->stats.dequeued++;
+            ring_deliver(channel, &d);
+        }
+
+        __atomic_store_n(&ring->idle, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        if (!ring_pending(ring, r->mask)) {
+            return;
+        }
+
+        // a descriptor was published while we were going idle. If its
+        // producer already took the doorbell, a notify is on its way.
+        if (__atomic_exchange_n(&ring->idle, 0, __ATOMIC_SEQ_CST) == 0) {
+            return;
+        }
+    }
+}
+
+void bulk_sm_ring_notify_rx(struct bulk_ctrl_binding *b)
+{
+    struct bulk_channel         *channel = VOID2CHANNEL(b->st);
+    struct bulk_sm_ring_channel *r       = channel_ring(channel);
+
+    if (r == NULL || r->rx == NULL) {
+        DEBUG_ERR(BULK_TRANSFER_CHAN_STATE, "bulk_sm_ring: spurious notify");
+        return;
+    }
+
+    ring_drain(channel, r);
+}
+
+// Producer ---------------------------------------------------------------
+
+static errval_t ring_transfer(struct bulk_channel *channel,
+                              enum bulk_sm_ring_op op,
+                              struct bulk_buffer *buffer,
+                              void *meta)
+{
+    struct bulk_sm_ring_channel *r = channel_ring(channel);
+    size_t metasize = (meta) ? channel->meta_size : 0;
+
+    if (r == NULL || !__atomic_load_n(&r->tx_ready, __ATOMIC_ACQUIRE)) {
+        return BULK_TRANSFER_CHAN_STATE;
+    }
+
+    if (metasize > BULK_SM_RING_META_SIZE) {
+        stats_inc(&r->stats.fallbacks);
+        return BULK_TRANSFER_INVALID_ARGUMENT;
+    }
+
+    struct bulk_sm_ring_desc d = {
+        .pool_machine = buffer->pool->id.machine,
+        .pool_dom     = buffer->pool->id.dom,
+        .pool_local   = buffer->pool->id.local,
+        .bufferid     = buffer->bufferid,
+        .op           = op,
+        .metasize     = metasize,
+    };
+    if (metasize) {
+        memcpy(d.meta, meta, metasize);
+    }
+
+    if (!ring_enqueue(r->tx, r->mask, &d)) {
+        stats_inc(&r->stats.fallbacks);
+        return BULK_TRANSFER_SM_RING_FULL;
+    }
+
+    stats_inc(&r->stats.enqueued);
+    ring_kick(channel, r);
+
+    return SYS_ERR_OK;
+}
+
+static errval_t bulk_sm_ring_move(struct bulk_channel      *channel,
+                                  struct bulk_buffer       *buffer,
+                                  void                     *meta,
+                                  struct bulk_continuation cont)
+{
+    if (err_is_fail(ring_transfer(channel, BULK_SM_RING_MOVE, buffer, meta))) {
+        return bulk_sm_move(channel, buffer, meta, cont);
+    }
+    bulk_continuation_call(cont, SYS_ERR_OK, channel);
+    return SYS_ERR_OK;
+}
+
+static errval_t bulk_sm_ring_copy(struct bulk_channel      *channel,
+                                  struct bulk_buffer       *buffer,
+                                  void                     *meta,
+                                  struct bulk_continuation cont)
+{
+    if (err_is_fail(ring_transfer(channel, BULK_SM_RING_COPY, buffer, meta))) {
+        return bulk_sm_copy(channel, buffer, meta, cont);
+    }
+    bulk_continuation_call(cont, SYS_ERR_OK, channel);
+    return SYS_ERR_OK;
+}
+
+static errval_t bulk_sm_ring_pass(struct bulk_channel      *channel,
+                                  struct bulk_buffer       *buffer,
+                                  void                     *meta,
+                                  struct bulk_continuation cont)
+{
+    if (err_is_fail(ring_transfer(channel, BULK_SM_RING_PASS, buffer, meta))) {
+        return bulk_sm_pass(channel, buffer, meta, cont);
+    }
+    bulk_continuation_call(cont, SYS_ERR_OK, channel);
+    return SYS_ERR_OK;
+}
+
+static errval_t bulk_sm_ring_release(struct bulk_channel      *channel,
+                                     struct bulk_buffer       *buffer,
+                                     struct bulk_continuation cont)
+{
+    if (err_is_fail(ring_transfer(channel, BULK_SM_RING_RELEASE, buffer, NULL))) {
+        return bulk_sm_release(channel, buffer, cont);
+    }
+    bulk_continuation_call(cont, SYS_ERR_OK, channel);
+    return SYS_ERR_OK;
+}
+
+// Ring setup -------------------------------------------------------------
+
+// The binding side allocates the frame once the channel properties have been
+// negotiated and offers it with ring_setup_call. Ring 0 carries descriptors
+// from the binding to the exporting side, ring 1 the other way. The binding
+// side consumes ring 1 right away, but only produces into ring 0 once the
+// exporting side accepted.
+
+static void ring_map_rings(struct bulk_sm_ring_channel *r, uint32_t slots,
+                           bool binding_side)
+{
+    struct bulk_sm_ring *ring0 = r->base;
+    struct bulk_sm_ring *ring1 = (void *)((uint8_t *)r->base + ring_bytes(slots));
+
+    r->mask = slots - 1;
+    if (binding_side) {
+        r->tx = ring0;
+        r->rx = ring1;
+    } else {
+        r->tx = ring1;
+        r->rx = ring0;
+    }
+}
+
+static errval_t ring_send_setup(void *a)
+{
+    struct bulk_channel         *channel = VOID2CHANNEL(a);
+    struct bulk_ctrl_binding    *b       = CHANNEL_BINDING(channel);
+    struct bulk_sm_ring_channel *r       = channel_ring(channel);
+
+    struct event_closure txcont = MKCONT(bulk_sm_flounder_msg_sent_debug_cb,
+            "bulk_sm_ring_setup sent");
+
+    return bulk_ctrl_ring_setup_call__tx(b, txcont, r->frame, r->mask + 1);
+}
+
+static errval_t ring_alloc(struct bulk_sm_ring_channel *r, uint32_t slots)
+{
+    errval_t err;
+    size_t bytes = ring_frame_bytes(slots);
+    size_t ret_bytes;
+
+    err = frame_alloc(&r->frame, bytes, &ret_bytes);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_FRAME_ALLOC);
+    }
+
+    err = vspace_map_one_frame(&r->base, ret_bytes, r->frame, NULL, NULL);
+    if (err_is_fail(err)) {
+        cap_destroy(r->frame);
+        return err_push(err, LIB_ERR_VSPACE_MAP);
+    }
+
+    ring_map_rings(r, slots, true);
+    ring_init(r->tx, slots);
+    ring_init(r->rx, slots);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * Continuation of bulk_sm_channel_bind(), the channel is bound and its
+ * properties negotiated.
+ *
+ * Side: Binding Side
+ */
+static void ring_bind_done(void *arg, errval_t err, struct bulk_channel *channel)
+{
+    struct bulk_sm_ring_channel *r = arg;
+
+    if (err_is_fail(err) || channel->trust != BULK_TRUST_FULL) {
+        // untrusted channels transfer caps with every buffer, keep messages
+        bulk_continuation_call(r->bind_cont, err, channel);
+        return;
+    }
+
+    err = ring_alloc(r, BULK_SM_RING_SLOTS);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "bulk_sm_ring: falling back to messages");
+        bulk_continuation_call(r->bind_cont, SYS_ERR_OK, channel);
+        return;
+    }
+
+    bulk_sm_flounder_send_fifo_msg(channel, ring_send_setup);
+}
+
+/**
+ * Side: Binding Side
+ */
+void bulk_sm_ring_setup_rx_response(struct bulk_ctrl_binding *b,
+                                    bulk_ctrl_error_t        error)
+{
+    struct bulk_channel         *channel = VOID2CHANNEL(b->st);
+    struct bulk_sm_ring_channel *r       = channel_ring(channel);
+    errval_t err = (errval_t) error;
+
+    assert(r != NULL);
+
+    if (err_is_ok(err)) {
+        __atomic_store_n(&r->tx_ready, true, __ATOMIC_RELEASE);
+    } else {
+        // the peer does not use rings, it never produces into ours either
+        DEBUG_ERR(err, "bulk_sm_ring: falling back to messages");
+    }
+
+    // the channel works either way
+    bulk_continuation_call(r->bind_cont, SYS_ERR_OK, channel);
+}
+
+static errval_t ring_send_setup_reply(void *a)
+{
+    struct ring_setup_reply  *reply = a;
+    struct bulk_ctrl_binding *b     = CHANNEL_BINDING(reply->channel);
+
+    struct event_closure txcont = MKCONT(bulk_sm_flounder_msg_sent_debug_cb,
+            "bulk_sm_ring_setup reply sent");
+
+    errval_t err = bulk_ctrl_ring_setup_response__tx(b, txcont, reply->err);
+    if (err_is_ok(err)) {
+        free(reply);
+    }
+    return err;
+}
+
+/**
+ * Side: Exporting Side
+ */
+void bulk_sm_ring_setup_rx_call(struct bulk_ctrl_binding *b,
+                                struct capref            frame,
+                                uint32_t                 slots)
+{
+    struct bulk_channel         *channel = VOID2CHANNEL(b->st);
+    struct bulk_sm_impl_data    *data    = CHANNEL_DATA(channel);
+    struct bulk_sm_ring_channel *r       = NULL;
+    struct frame_identity        id;
+    errval_t err = SYS_ERR_OK;
+
+    if (channel->ep->f != bulk_sm_ring_get_implementation()
+        || channel->trust != BULK_TRUST_FULL || data->ring != NULL) {
+        err = BULK_TRANSFER_SM_RING_SETUP;
+        goto reply;
+    }
+
+    if (slots == 0 || (slots & (slots - 1))) {
+        err = BULK_TRANSFER_INVALID_ARGUMENT;
+        goto reply;
+    }
+
+    err = invoke_frame_identify(frame, &id);
+    if (err_is_fail(err)) {
+        goto reply;
+    }
+    if (id.bytes < ring_frame_bytes(slots)) {
+        err = BULK_TRANSFER_INVALID_ARGUMENT;
+        goto reply;
+    }
+
+    r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        err = BULK_TRANSFER_MEM;
+        goto reply;
+    }
+
+    err = vspace_map_one_frame(&r->base, ring_frame_bytes(slots), frame,
+                               NULL, NULL);
+    if (err_is_fail(err)) {
+        free(r);
+        err = err_push(err, LIB_ERR_VSPACE_MAP);
+        goto reply;
+    }
+
+    r->frame = frame;
+    ring_map_rings(r, slots, false);
+    r->tx_ready = true;
+    data->ring = r;
+
+ reply:
+    if (err_is_fail(err) && !capref_is_null(frame)) {
+        cap_destroy(frame);
+    }
+
+    struct ring_setup_reply *reply = malloc(sizeof(*reply));
+    assert(reply);
+    reply->channel = channel;
+    reply->err     = err;
+
+    bulk_sm_flounder_send_fifo_msg_with_arg(channel, ring_send_setup_reply,
+                                            reply);
+}
+
+static errval_t bulk_sm_ring_channel_bind(struct bulk_channel      *channel,
+                                          struct bulk_continuation cont)
+{
+    struct bulk_sm_ring_channel *r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        return BULK_TRANSFER_MEM;
+    }
+    r->bind_cont = cont;
+
+    errval_t err = bulk_sm_channel_bind(channel,
+                                        MK_BULK_CONT(ring_bind_done, r));
+    if (err_is_fail(err)) {
+        free(r);
+        return err;
+    }
+
+    CHANNEL_DATA(channel)->ring = r;
+    return SYS_ERR_OK;
+}
+
+// Interface --------------------------------------------------------------
+
+static struct bulk_implementation bulk_sm_ring_implementation = {
+    .channel_create  = bulk_sm_channel_create,
+    .channel_bind    = bulk_sm_ring_channel_bind,
+    .channel_destroy = bulk_sm_channel_destroy,
+    .assign_pool     = bulk_sm_assign_pool,
+    .remove_pool     = bulk_sm_remove_pool,
+    .move            = bulk_sm_ring_move,
+    .copy            = bulk_sm_ring_copy,
+    .release         = bulk_sm_ring_release,
+    .pass            = bulk_sm_ring_pass,
+    .request         = NULL,
+};
+
+struct bulk_implementation *bulk_sm_ring_get_implementation(void)
+{
+    return &bulk_sm_ring_implementation;
+}
+
+/**
+ * Returns the descriptor ring statistics of a channel.
+ */
+errval_t bulk_sm_ring_get_stats(struct bulk_channel       *channel,
+                                struct bulk_sm_ring_stats *stats)
+{
+    if (channel->ep == NULL
+        || channel->ep->f != bulk_sm_ring_get_implementation()
+        || channel->impl_data == NULL || channel_ring(channel) == NULL) {
+        return BULK_TRANSFER_CHAN_STATE;
+    }
+
+    struct bulk_sm_ring_channel *r = channel_ring(channel);
+    stats->enqueued  = __atomic_load_n(&r->stats.enqueued, __ATOMIC_RELAXED);
+    stats->fallbacks = __atomic_load_n(&r->stats.fallbacks, __ATOMIC_RELAXED);
+    stats->notifies  = __atomic_load_n(&r->stats.notifies, __ATOMIC_RELAXED);
+    stats->dequeued  = r->stats.dequeued;
+    stats->drains    = r->stats.drains;
+
+    return SYS_ERR_OK;
+}
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2009, 2010, 2011, 2012, ETH Zurich.
+ * Copyright (c) 2009, 2010, 2011, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -21,6 +21,65 @@
 #include "bulk_pool.h"
 #include "bulk_buffer.h"
 
+/*
+ * The free list is a lock-free stack. Its head holds the index of the first
+ * free entry + 1 (0 if empty) in the lower 32 bits and a generation count in
+ * the upper 32 bits, which is incremented on every update. A thread that read
+ * the head and the next pointer of the first entry before another thread
+ * popped and pushed it back fails its compare-and-swap instead of corrupting
+ * the list.
+ */
+
+static inline uint64_t free_head_make(struct bulk_allocator *alloc,
+                                      struct bulk_buffer_mng *bm,
+                                      uint64_t old_head)
+{
+    uint64_t idx = (bm == NULL) ? 0 : (uint64_t)(bm - alloc->mngs) + 1;
+    return (((old_head >> 32) + 1) << 32) | idx;
+}
+
+static inline struct bulk_buffer_mng *free_head_entry(struct bulk_allocator *alloc,
+                                                      uint64_t head)
+{
+    uint32_t idx = (uint32_t) head;
+    return (idx == 0) ? NULL : alloc->mngs + idx - 1;
+}
+
+static void free_list_push(struct bulk_allocator *alloc,
+                           struct bulk_buffer_mng *bm)
+{
+    uint64_t head = __atomic_load_n(&alloc->free_head, __ATOMIC_RELAXED);
+    uint64_t new_head;
+    do {
+        __atomic_store_n(&bm->next, free_head_entry(alloc, head),
+                         __ATOMIC_RELAXED);
+        new_head = free_head_make(alloc, bm, head);
+    } while (!__atomic_compare_exchange_n(&alloc->free_head, &head, new_head,
+                                          true, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+    __atomic_fetch_add(&alloc->num_free, 1, __ATOMIC_RELAXED);
+}
+
+static struct bulk_buffer_mng *free_list_pop(struct bulk_allocator *alloc)
+{
+    uint64_t head = __atomic_load_n(&alloc->free_head, __ATOMIC_ACQUIRE);
+    struct bulk_buffer_mng *bm;
+    uint64_t new_head;
+    do {
+        bm = free_head_entry(alloc, head);
+        if (bm == NULL) {
+            return NULL;
+        }
+        new_head = free_head_make(alloc,
+                                  __atomic_load_n(&bm->next, __ATOMIC_RELAXED),
+                                  head);
+    } while (!__atomic_compare_exchange_n(&alloc->free_head, &head, new_head,
+                                          true, __ATOMIC_ACQUIRE,
+                                          __ATOMIC_ACQUIRE));
+    __atomic_fetch_sub(&alloc->num_free, 1, __ATOMIC_RELAXED);
+    return bm;
+}
+
 
 /**
  * initializes a new bulk allocator with a pool and allocates memory for it.
@@ -93,15 +152,18 @@ errval_t bulk_alloc_init(struct bulk_allocator *alloc,
     }
 
     alloc->mngs = calloc(buffer_count, sizeof(*alloc->mngs));
+    if (alloc->mngs == NULL) {
+        return BULK_TRANSFER_MEM;
+    }
+    alloc->free_head = 0;
+    alloc->num_free = 0;
     for (int i = 0; i < buffer_count; ++i) {
         struct bulk_buffer *buf = alloc->pool->buffers[i];
         /* setup the management structure for the free list */
         struct bulk_buffer_mng *le = alloc->mngs + i;
         le->buffer = buf;
-        le->next = alloc->free_buffers;
-        alloc->free_buffers = le;
+        free_list_push(alloc, le);
     }
-    alloc->num_free = buffer_count;
 
     return SYS_ERR_OK;
 }
@@ -228,13 +290,12 @@ struct bulk_buffer *bulk_alloc_new_buffer(struct bulk_allocator *alloc)
 {
     assert(alloc);
 
-    if (alloc->num_free == 0) {
+    struct bulk_buffer_mng *bm = free_list_pop(alloc);
+    if (bm == NULL) {
         return NULL;
     }
 
-    struct bulk_buffer *buf = alloc->free_buffers->buffer;
-    alloc->free_buffers = alloc->free_buffers->next;
-    alloc->num_free--;
+    struct bulk_buffer *buf = bm->buffer;
 
     /*
      * XXX: do we want to have a special state for being "not allocated"
@@ -268,9 +329,7 @@ errval_t bulk_alloc_return_buffer(struct bulk_allocator *alloc,
 
     struct bulk_buffer_mng *bm = alloc->mngs + buffer->bufferid;
     bm->buffer = buffer;
-    bm->next = alloc->free_buffers;
-    alloc->free_buffers = bm;
-    alloc->num_free++;
+    free_list_push(alloc, bm);
 
     return SYS_ERR_OK;
 
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -268,6 +268,29 @@ errval_t bulk_buffer_change_state(struct bulk_buffer *buffer,
     return SYS_ERR_OK;
 }
 
+/**
+ * gives up the ownership of the buffer before it is moved or passed.
+ *
+ * @param buffer    the buffer to give up
+ */
+errval_t bulk_buffer_disown(struct bulk_buffer *buffer)
+{
+    assert(buffer);
+
+    enum bulk_buffer_state st = __atomic_load_n(&buffer->state,
+                                                __ATOMIC_ACQUIRE);
+    do {
+        if (st != BULK_BUFFER_READ_WRITE && st != BULK_BUFFER_RO_OWNED) {
+            return BULK_TRANSFER_BUFFER_NOT_OWNED;
+        }
+    } while (!__atomic_compare_exchange_n(&buffer->state, &st,
+                                          BULK_BUFFER_INVALID, false,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    /* we won the buffer, the mapping is ours to remove */
+    return bulk_buffer_unmap(buffer);
+}
+
 /**
  * Sets a cap + offset pair for a buffer.
  *
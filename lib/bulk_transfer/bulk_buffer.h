@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2013, ETH Zurich.
+ * Copyright (c) 2013, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -77,6 +77,18 @@ errval_t bulk_buffer_unmap(struct bulk_buffer *buf);
 errval_t bulk_buffer_change_state(struct bulk_buffer       *buffer,
                                   enum bulk_buffer_state    state);
 
+/**
+ * gives up the ownership of the buffer before it is moved or passed. The
+ * check and the state change are done atomically, so that if several threads
+ * race to hand off the same buffer, only one of them succeeds.
+ *
+ * @param buffer    the buffer to give up
+ *
+ * @return BULK_TRANSFER_BUFFER_NOT_OWNED if the buffer is not (or no longer)
+ *         owned by this domain
+ */
+errval_t bulk_buffer_disown(struct bulk_buffer *buffer);
+
 /**
  * checks if the buffer is owned by the calling domain
  *
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2013, ETH Zurich.
+ * Copyright (c) 2013, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -243,12 +243,10 @@ errval_t bulk_channel_move(struct bulk_channel *channel,
         return BULK_TRANSFER_POOL_NOT_ASSIGNED;
     }
 
-    if (!bulk_buffer_is_owner(buffer)) {
-        return BULK_TRANSFER_BUFFER_NOT_OWNED;
-    }
-
-    err = bulk_buffer_change_state(buffer, BULK_BUFFER_INVALID);
-    if (err_is_fail(err)) {
+    err = bulk_buffer_disown(buffer);
+    if (err_no(err) == BULK_TRANSFER_BUFFER_NOT_OWNED) {
+        return err;
+    } else if (err_is_fail(err)) {
         /*
          * XXX: what do we do if the unmap fails?
          */
@@ -279,12 +277,10 @@ errval_t bulk_channel_pass(struct bulk_channel *channel,
         return BULK_TRANSFER_POOL_NOT_ASSIGNED;
     }
 
-    if (!bulk_buffer_is_owner(buffer)) {
-        return BULK_TRANSFER_BUFFER_NOT_OWNED;
-    }
-
-    err = bulk_buffer_change_state(buffer, BULK_BUFFER_INVALID);
-    if (err_is_fail(err)) {
+    err = bulk_buffer_disown(buffer);
+    if (err_no(err) == BULK_TRANSFER_BUFFER_NOT_OWNED) {
+        return err;
+    } else if (err_is_fail(err)) {
         /*
          * XXX: what do we do if the unmap fails?
          */
@@ -328,7 +324,7 @@ errval_t bulk_channel_copy(struct bulk_channel *channel,
         new_state = BULK_BUFFER_RO_OWNED;
     }
 
-    buffer->local_ref_count++;
+    __atomic_fetch_add(&buffer->local_ref_count, 1, __ATOMIC_RELAXED);
 
     err = bulk_buffer_change_state(buffer, new_state);
     if (err_is_fail(err)) {
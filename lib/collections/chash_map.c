@@ -0,0 +1,284 @@
+/**
+ * \file
+ * \brief Barrelfish collections library read-mostly concurrent hash map
+ */
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "collections/chash_map.h"
+
+#ifdef BARRELFISH
+#include <barrelfish/threads.h>
+#define chash_yield()   thread_yield()
+#else
+#include <sched.h>
+#define chash_yield()   sched_yield()
+#endif
+
+#define SLOT_EMPTY      0
+#define SLOT_REMOVED    1
+
+#define MIN_SIZE        16
+
+// resize when more than 3/4 of the slots are used
+#define OVERLOADED(size, n) ((n) * 4 > (size) * 3)
+
+struct chash_entry {
+    // written last when an entry is inserted, slots are never reused
+    uint64_t hash;
+    uint64_t key;
+    void    *data;
+};
+
+struct _collections_chash_map_table {
+    size_t  size;
+
+    // number of slots that are not empty, including removed ones
+    size_t  used;
+
+    struct chash_entry entries[];
+};
+
+static inline uint64_t hash_word(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key < 2 ? key + 2 : key;
+}
+
+static struct _collections_chash_map_table *table_alloc(size_t size)
+{
+    struct _collections_chash_map_table *t;
+
+    t = calloc(1, sizeof(*t) + size * sizeof(struct chash_entry));
+    assert(t != NULL);
+    t->size = size;
+    return t;
+}
+
+static struct chash_entry *table_find(struct _collections_chash_map_table *t,
+                                      uint64_t hash, uint64_t key)
+{
+    size_t mask = t->size - 1;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        struct chash_entry *e = &t->entries[i];
+        uint64_t h = __atomic_load_n(&e->hash, __ATOMIC_ACQUIRE);
+        if (h == SLOT_EMPTY) {
+            return NULL;
+        }
+        if (h == hash && e->key == key) {
+            return e;
+        }
+    }
+}
+
+/*
+ * Fill an empty slot. Readers see the entry once the hash is stored.
+ */
+static void table_put(struct _collections_chash_map_table *t, uint64_t hash,
+                      uint64_t key, void *data)
+{
+    size_t mask = t->size - 1;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        struct chash_entry *e = &t->entries[i];
+        if (e->hash == SLOT_EMPTY) {
+            e->key = key;
+            e->data = data;
+            __atomic_store_n(&e->hash, hash, __ATOMIC_RELEASE);
+            t->used++;
+            return;
+        }
+    }
+}
+
+static void writer_lock(collections_chash_map *m)
+{
+    while (__atomic_exchange_n(&m->lock, 1, __ATOMIC_ACQUIRE) != 0) {
+        chash_yield();
+    }
+}
+
+static void writer_unlock(collections_chash_map *m)
+{
+    __atomic_store_n(&m->lock, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Start a new grace period and wait for the readers of the previous one.
+ * Called with the writer lock held.
+ */
+static void synchronize(collections_chash_map *m)
+{
+    size_t old = __atomic_fetch_add(&m->epoch, 1, __ATOMIC_SEQ_CST) & 1;
+
+    for (int i = 0; i < COLLECTIONS_CHASH_MAP_READERS; i++) {
+        while (__atomic_load_n(&m->readers[i].count[old], __ATOMIC_SEQ_CST)) {
+            chash_yield();
+        }
+    }
+}
+
+/*
+ * Copy the live entries to a new table sized for twice as many elements.
+ * Called with the writer lock held.
+ */
+static void resize(collections_chash_map *m)
+{
+    struct _collections_chash_map_table *old = m->table;
+
+    size_t size = old->size;
+    while ((m->num_elems + 1) * 2 > size) {
+        size *= 2;
+    }
+
+    struct _collections_chash_map_table *t = table_alloc(size);
+    for (size_t i = 0; i < old->size; i++) {
+        struct chash_entry *e = &old->entries[i];
+        if (e->hash > SLOT_REMOVED) {
+            table_put(t, e->hash, e->key, e->data);
+        }
+    }
+
+    __atomic_store_n(&m->table, t, __ATOMIC_RELEASE);
+    synchronize(m);
+    free(old);
+}
+
+void collections_chash_map_create(collections_chash_map **m, size_t capacity,
+                                  collections_chash_map_free data_free)
+{
+    *m = calloc(1, sizeof(collections_chash_map));
+    assert(*m != NULL);
+
+    size_t size = MIN_SIZE;
+    while (OVERLOADED(size, capacity)) {
+        size *= 2;
+    }
+
+    (*m)->table = table_alloc(size);
+    (*m)->data_free = data_free;
+}
+
+/*
+ * Free the map. There must not be any readers left.
+ */
+void collections_chash_map_release(collections_chash_map *m)
+{
+    struct _collections_chash_map_table *t = m->table;
+
+    for (size_t i = 0; i < t->size; i++) {
+        if (t->entries[i].hash > SLOT_REMOVED && m->data_free) {
+            m->data_free(t->entries[i].data);
+        }
+    }
+    free(t);
+    free(m);
+}
+
+size_t collections_chash_map_size(collections_chash_map *m)
+{
+    return __atomic_load_n(&m->num_elems, __ATOMIC_RELAXED);
+}
+
+collections_chash_map_reader collections_chash_map_read_lock(collections_chash_map *m)
+{
+    // threads have distinct stacks, use them to spread the reader counters
+    uint64_t sp = (uintptr_t)__builtin_frame_address(0) >> 12;
+    size_t slot = ((sp * 0x9e3779b97f4a7c15ULL) >> 32)
+                  % COLLECTIONS_CHASH_MAP_READERS;
+
+    for (;;) {
+        size_t epoch = __atomic_load_n(&m->epoch, __ATOMIC_SEQ_CST) & 1;
+        __atomic_fetch_add(&m->readers[slot].count[epoch], 1, __ATOMIC_SEQ_CST);
+        // a writer that flipped the epoch before our increment may already
+        // have waited for this counter, so we must not use it
+        if ((__atomic_load_n(&m->epoch, __ATOMIC_SEQ_CST) & 1) == epoch) {
+            return slot * 2 + epoch;
+        }
+        __atomic_fetch_sub(&m->readers[slot].count[epoch], 1, __ATOMIC_RELEASE);
+    }
+}
+
+void collections_chash_map_read_unlock(collections_chash_map *m,
+                                       collections_chash_map_reader r)
+{
+    __atomic_fetch_sub(&m->readers[r / 2].count[r % 2], 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Look up a key. Must be called within a read-side critical section.
+ */
+void *collections_chash_map_find(collections_chash_map *m, uint64_t key)
+{
+    struct _collections_chash_map_table *t;
+    t = __atomic_load_n(&m->table, __ATOMIC_ACQUIRE);
+
+    struct chash_entry *e = table_find(t, hash_word(key), key);
+    return e ? e->data : NULL;
+}
+
+int collections_chash_map_insert(collections_chash_map *m, uint64_t key,
+                                 void *data)
+{
+    uint64_t hash = hash_word(key);
+
+    writer_lock(m);
+
+    if (table_find(m->table, hash, key) != NULL) {
+        writer_unlock(m);
+        return 1;
+    }
+
+    if (OVERLOADED(m->table->size, m->table->used + 1)) {
+        resize(m);
+    }
+    table_put(m->table, hash, key, data);
+    __atomic_store_n(&m->num_elems, m->num_elems + 1, __ATOMIC_RELAXED);
+
+    writer_unlock(m);
+    return 0;
+}
+
+void collections_chash_map_delete(collections_chash_map *m, uint64_t key)
+{
+    writer_lock(m);
+
+    struct chash_entry *e = table_find(m->table, hash_word(key), key);
+    if (e == NULL) {
+        writer_unlock(m);
+        return;
+    }
+
+    void *data = e->data;
+    __atomic_store_n(&e->hash, SLOT_REMOVED, __ATOMIC_RELEASE);
+    __atomic_store_n(&m->num_elems, m->num_elems - 1, __ATOMIC_RELAXED);
+
+    if (m->data_free) {
+        synchronize(m);
+        m->data_free(data);
+    }
+
+    writer_unlock(m);
+}
+
+void collections_chash_map_synchronize(collections_chash_map *m)
+{
+    writer_lock(m);
+    synchronize(m);
+    writer_unlock(m);
+}
@@ -0,0 +1,365 @@
+/**
+ * \file
+ * \brief Barrelfish collections library open-addressing hash map
+ */
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "collections/hash_map.h"
+
+#define SLOT_EMPTY      0
+#define SLOT_REMOVED    1
+
+// smallest table we allocate
+#define MIN_SIZE        16
+
+// number of old slots migrated per insert or remove while resizing
+#define MIGRATE_STEP    8
+
+// resize when more than 3/4 of the slots are used
+#define OVERLOADED(t, n)    ((n) * 4 > (t)->size * 3)
+
+/*
+ * 64-bit finaliser of MurmurHash3, spreads sequential keys over the table.
+ */
+static inline uint64_t hash_word(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+/*
+ * FNV-1a
+ */
+static inline uint64_t hash_bytes(const void *key, size_t len)
+{
+    const uint8_t *p = key;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static inline uint64_t fix_hash(uint64_t hash)
+{
+    // keep clear of the empty and removed markers
+    return hash < 2 ? hash + 2 : hash;
+}
+
+static inline bool key_equals(collections_hash_map *m,
+                              collections_hash_map_entry *e, uint64_t hash,
+                              uint64_t word, const void *bytes, size_t len)
+{
+    if (e->hash != hash) {
+        return false;
+    }
+    if (m->key_type == COLLECTIONS_HASH_MAP_KEY_WORD) {
+        return e->key.word == word;
+    }
+    return e->key_len == len && memcmp(e->key.bytes, bytes, len) == 0;
+}
+
+/*
+ * Find the entry for a key in one table.
+ */
+static collections_hash_map_entry *
+table_find(collections_hash_map *m, struct _collections_hash_map_table *t,
+           uint64_t hash, uint64_t word, const void *bytes, size_t len)
+{
+    size_t mask = t->size - 1;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        collections_hash_map_entry *e = &t->entries[i];
+        if (e->hash == SLOT_EMPTY) {
+            return NULL;
+        }
+        if (key_equals(m, e, hash, word, bytes, len)) {
+            return e;
+        }
+    }
+}
+
+static collections_hash_map_entry *
+map_find(collections_hash_map *m, uint64_t hash, uint64_t word,
+         const void *bytes, size_t len)
+{
+    collections_hash_map_entry *e;
+
+    e = table_find(m, &m->cur, hash, word, bytes, len);
+    if (e == NULL && m->old.entries != NULL) {
+        e = table_find(m, &m->old, hash, word, bytes, len);
+    }
+    return e;
+}
+
+/*
+ * Return a free slot for hash in a table that does not contain the key.
+ */
+static collections_hash_map_entry *
+table_free_slot(struct _collections_hash_map_table *t, uint64_t hash)
+{
+    size_t mask = t->size - 1;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        collections_hash_map_entry *e = &t->entries[i];
+        if (e->hash == SLOT_REMOVED) {
+            return e;
+        }
+        if (e->hash == SLOT_EMPTY) {
+            t->used++;
+            return e;
+        }
+    }
+}
+
+static void table_alloc(struct _collections_hash_map_table *t, size_t size)
+{
+    t->size = size;
+    t->used = 0;
+    t->entries = calloc(size, sizeof(collections_hash_map_entry));
+    assert(t->entries != NULL);
+}
+
+static void migrate(collections_hash_map *m, size_t slots)
+{
+    struct _collections_hash_map_table *old = &m->old;
+
+    if (old->entries == NULL) {
+        return;
+    }
+
+    for (; slots > 0 && m->migrate_pos < old->size; slots--) {
+        collections_hash_map_entry *e = &old->entries[m->migrate_pos++];
+        if (e->hash > SLOT_REMOVED) {
+            *table_free_slot(&m->cur, e->hash) = *e;
+            // keep probe chains of the old table intact
+            e->hash = SLOT_REMOVED;
+        }
+    }
+
+    if (m->migrate_pos == old->size) {
+        free(old->entries);
+        memset(old, 0, sizeof(*old));
+    }
+}
+
+/*
+ * Start moving the map to a new table if the current one is too full.
+ *
+ * The new table is sized for twice the live elements, so a table that is
+ * mostly full of removed entries is just rehashed at the same size.
+ */
+static void maybe_resize(collections_hash_map *m)
+{
+    if (!OVERLOADED(&m->cur, m->cur.used + 1)) {
+        return;
+    }
+
+    // a resize is still in progress, finish it first
+    migrate(m, SIZE_MAX);
+
+    size_t size = m->cur.size;
+    while ((m->num_elems + 1) * 2 > size) {
+        size *= 2;
+    }
+
+    m->old = m->cur;
+    m->migrate_pos = 0;
+    table_alloc(&m->cur, size);
+}
+
+static int map_insert(collections_hash_map *m, uint64_t hash, uint64_t word,
+                      const void *bytes, size_t len, void *data)
+{
+    if (map_find(m, hash, word, bytes, len) != NULL) {
+        return 1;
+    }
+
+    maybe_resize(m);
+    migrate(m, MIGRATE_STEP);
+
+    collections_hash_map_entry *e = table_free_slot(&m->cur, hash);
+    e->hash = hash;
+    if (m->key_type == COLLECTIONS_HASH_MAP_KEY_WORD) {
+        e->key.word = word;
+    } else {
+        e->key.bytes = bytes;
+    }
+    e->key_len = len;
+    e->data = data;
+    m->num_elems++;
+
+    return 0;
+}
+
+static void map_delete(collections_hash_map *m, uint64_t hash, uint64_t word,
+                       const void *bytes, size_t len)
+{
+    collections_hash_map_entry *e = map_find(m, hash, word, bytes, len);
+    if (e == NULL) {
+        return;
+    }
+
+    if (m->key_free && m->key_type == COLLECTIONS_HASH_MAP_KEY_BYTES) {
+        m->key_free((void *)e->key.bytes);
+    }
+    if (m->data_free) {
+        m->data_free(e->data);
+    }
+    e->hash = SLOT_REMOVED;
+    m->num_elems--;
+
+    migrate(m, MIGRATE_STEP);
+}
+
+/*
+ * Create a hash map that can hold capacity elements without resizing.
+ */
+void collections_hash_map_create(collections_hash_map **m,
+                                 collections_hash_map_key_type key_type,
+                                 size_t capacity,
+                                 collections_hash_map_free key_free,
+                                 collections_hash_map_free data_free)
+{
+    *m = calloc(1, sizeof(collections_hash_map));
+    assert(*m != NULL);
+
+    size_t size = MIN_SIZE;
+    while (OVERLOADED(&(struct _collections_hash_map_table){ .size = size },
+                      capacity)) {
+        size *= 2;
+    }
+
+    (*m)->key_type = key_type;
+    (*m)->key_free = key_free;
+    (*m)->data_free = data_free;
+    table_alloc(&(*m)->cur, size);
+}
+
+static int release_entry(collections_hash_map_entry *e, void *arg)
+{
+    collections_hash_map *m = arg;
+
+    if (m->key_free && m->key_type == COLLECTIONS_HASH_MAP_KEY_BYTES) {
+        m->key_free((void *)e->key.bytes);
+    }
+    if (m->data_free) {
+        m->data_free(e->data);
+    }
+    return 1;
+}
+
+void collections_hash_map_release(collections_hash_map *m)
+{
+    collections_hash_map_visit(m, release_entry, m);
+    free(m->cur.entries);
+    free(m->old.entries);
+    free(m);
+}
+
+size_t collections_hash_map_size(collections_hash_map *m)
+{
+    return m->num_elems;
+}
+
+int collections_hash_map_insert(collections_hash_map *m, uint64_t key,
+                                void *data)
+{
+    assert(m->key_type == COLLECTIONS_HASH_MAP_KEY_WORD);
+    return map_insert(m, fix_hash(hash_word(key)), key, NULL, 0, data);
+}
+
+void *collections_hash_map_find(collections_hash_map *m, uint64_t key)
+{
+    assert(m->key_type == COLLECTIONS_HASH_MAP_KEY_WORD);
+    collections_hash_map_entry *e;
+    e = map_find(m, fix_hash(hash_word(key)), key, NULL, 0);
+    return e ? e->data : NULL;
+}
+
+void collections_hash_map_delete(collections_hash_map *m, uint64_t key)
+{
+    assert(m->key_type == COLLECTIONS_HASH_MAP_KEY_WORD);
+    map_delete(m, fix_hash(hash_word(key)), key, NULL, 0);
+}
+
+int collections_hash_map_insert_bytes(collections_hash_map *m,
+                                      const void *key, size_t key_len,
+                                      void *data)
+{
+    assert(m->key_type == COLLECTIONS_HASH_MAP_KEY_BYTES);
+    return map_insert(m, fix_hash(hash_bytes(key, key_len)), 0, key, key_len,
+                      data);
+}
+
+bool collections_hash_map_lookup_bytes(collections_hash_map *m,
+                                       const void *key, size_t key_len,
+                                       void **data)
+{
+    assert(m->key_type == COLLECTIONS_HASH_MAP_KEY_BYTES);
+    collections_hash_map_entry *e;
+    e = map_find(m, fix_hash(hash_bytes(key, key_len)), 0, key, key_len);
+    if (e == NULL) {
+        return false;
+    }
+    if (data != NULL) {
+        *data = e->data;
+    }
+    return true;
+}
+
+void *collections_hash_map_find_bytes(collections_hash_map *m,
+                                      const void *key, size_t key_len)
+{
+    void *data = NULL;
+    collections_hash_map_lookup_bytes(m, key, key_len, &data);
+    return data;
+}
+
+void collections_hash_map_delete_bytes(collections_hash_map *m,
+                                       const void *key, size_t key_len)
+{
+    assert(m->key_type == COLLECTIONS_HASH_MAP_KEY_BYTES);
+    map_delete(m, fix_hash(hash_bytes(key, key_len)), 0, key, key_len);
+}
+
+static int visit_table(struct _collections_hash_map_table *t,
+                       collections_hash_map_visitor_func visitor, void *arg)
+{
+    for (size_t i = 0; i < t->size; i++) {
+        collections_hash_map_entry *e = &t->entries[i];
+        if (e->hash > SLOT_REMOVED && !visitor(e, arg)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int collections_hash_map_visit(collections_hash_map *m,
+                               collections_hash_map_visitor_func visitor,
+                               void *arg)
+{
+    if (!visit_table(&m->cur, visitor, arg)) {
+        return 0;
+    }
+    if (m->old.entries != NULL) {
+        return visit_table(&m->old, visitor, arg);
+    }
+    return 1;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014, ETH Zurich. All rights reserved.
+ * Copyright (c) 2014, 2016, ETH Zurich. All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
  * If you do not find this file, copies can be found by writing to:
@@ -252,6 +252,7 @@ static void chan_init_bind_cb(void *st,
 
     txq_init(&chan->txq, b, b->waitset, (txq_register_fn_t) b->register_send,
              sizeof(struct svc_msg_st));
+    txq_set_stats(&chan->txq, b->stats);
 
     chan->binding = b;
     chan->client_st = DMA_CLIENT_STATE_BIND_OK;
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -15,9 +15,11 @@
 #include <barrelfish/sys_debug.h>
 #include <bench/bench.h>
 #include <xeon_phi/xeon_phi.h>
+#include <pktcopy/pktcopy.h>
 
 #include <dma_internal.h>
 #include <dma/dma_bench.h>
+#include <dma/dma_copy.h>
 #include <dma_device_internal.h>
 #include <dma_channel_internal.h>
 #include <dma_request_internal.h>
@@ -303,3 +305,95 @@ errval_t dma_bench_run_memcpy(void *dst, void *src)
 
     return SYS_ERR_OK;
 }
+
+static void copy_engine_done_cb(errval_t err,
+                                void *arg)
+{
+    assert(err_is_ok(err));
+    (*(size_t *)arg)++;
+}
+
+/**
+ * \brief compares CPU copies against copies through a copy engine
+ *
+ * \param engine    copy engine with the backend to measure
+ * \param dst       destination buffer of 2^DMA_BENCH_COPY_MAX_BITS bytes
+ * \param src       source buffer of 2^DMA_BENCH_COPY_MAX_BITS bytes
+ *
+ * For every size, DMA_BENCH_COPY_BYTES are copied, first with the CPU, then
+ * through the engine with as many copies in flight as it allows. Reports
+ * the throughput of both and the share of the engine run the CPU was busy:
+ * issuing copies (including those the engine did with the CPU) and polls
+ * that completed a copy. Polls that found nothing stand for time an
+ * application could spend on other work.
+ */
+errval_t dma_bench_run_copy_engine(struct dma_copy_engine *engine,
+                                   void *dst, lpaddr_t dst_phys,
+                                   void *src, lpaddr_t src_phys)
+{
+    errval_t err;
+    uint64_t tscperus;
+
+    bench_init();
+
+    err = sys_debug_get_tsc_per_ms(&tscperus);
+    assert(err_is_ok(err));
+    tscperus /= 1000;
+
+    debug_printf("copy engine benchmark: backend %s\n", engine->backend_name);
+    debug_printf("%6s %10s %10s %8s %8s\n", "bytes", "cpu_MB/s", "eng_MB/s",
+                 "busy_%", "offload");
+
+    for (uint8_t i = DMA_BENCH_MIN_BITS; i <= DMA_BENCH_COPY_MAX_BITS; ++i) {
+        size_t size = (1UL << i);
+        size_t reps = DMA_BENCH_COPY_BYTES / size;
+        if (reps > (1UL << 20)) {
+            reps = (1UL << 20);
+        }
+
+        cycles_t tsc_start = bench_tsc();
+        for (size_t r = 0; r < reps; r++) {
+            pktcopy_memcpy(dst, src, size);
+        }
+        cycles_t cpu = calculate_time(tsc_start, bench_tsc());
+
+        uint64_t offloaded = engine->stats.offload_copies;
+        size_t issued = 0, done = 0;
+        cycles_t busy = 0;
+
+        tsc_start = bench_tsc();
+        while (done < reps) {
+            cycles_t t = bench_tsc();
+            if (issued < reps) {
+                err = dma_copy_async(engine, dst, dst_phys, src, src_phys,
+                                     size, copy_engine_done_cb, &done);
+                if (err_is_fail(err)) {
+                    return err;
+                }
+                issued++;
+                busy += bench_tsc() - t;
+                t = bench_tsc();
+            }
+
+            size_t before = done;
+            err = dma_copy_poll(engine);
+            if (err_is_fail(err)) {
+                return err;
+            }
+            if (done != before) {
+                busy += bench_tsc() - t;
+            }
+        }
+        cycles_t total = calculate_time(tsc_start, bench_tsc());
+
+        uint64_t bytes = (uint64_t)reps * size;
+        debug_printf("%6u %10" PRIu64 " %10" PRIu64 " %8" PRIu64 " %8" PRIu64
+                     "\n", i,
+                     cpu ? bytes * tscperus / cpu : 0,
+                     total ? bytes * tscperus / total : 0,
+                     total ? (uint64_t)busy * 100 / total : 0,
+                     engine->stats.offload_copies - offloaded);
+    }
+
+    return SYS_ERR_OK;
+}
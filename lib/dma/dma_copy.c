@@ -0,0 +1,438 @@
+/**
+ * \file
+ * \brief Asynchronous copy engine with CPU and offload paths
+ *
+ * The engine does not depend on the DMA device drivers, so that the bulk
+ * transfer and network queue management libraries can copy through it and
+ * only domains that own a DMA device need to link libdma.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <pktcopy/pktcopy.h>
+#include <dma/dma_copy.h>
+
+/// a copy in submission order
+struct dma_copy_request {
+    struct dma_copy_engine *engine;
+    struct dma_copy_request *next;
+    dma_copy_done_fn *done;
+    void *arg;
+    errval_t err;
+    bool finished;
+    bool offloaded;
+};
+
+static struct dma_copy_engine default_engine;
+static bool default_engine_initialized = false;
+
+static inline uint64_t copy_tsc(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * \brief Initialize a copy engine without offload backend.
+ */
+void dma_copy_engine_init(struct dma_copy_engine *engine)
+{
+    memset(engine, 0, sizeof(*engine));
+    engine->backend_name = "cpu";
+    engine->offload_threshold = DMA_COPY_OFFLOAD_THRESHOLD;
+    engine->max_outstanding = DMA_COPY_MAX_OUTSTANDING;
+}
+
+/**
+ * \brief Free the backend state and the cached requests of an engine.
+ *
+ * The engine must be idle. It can be initialized again afterwards.
+ */
+void dma_copy_engine_destroy(struct dma_copy_engine *engine)
+{
+    assert(engine->head == NULL);
+
+    dma_copy_engine_set_backend(engine, NULL, NULL, NULL);
+
+    while (engine->free_list != NULL) {
+        struct dma_copy_request *req = engine->free_list;
+        engine->free_list = req->next;
+        free(req);
+    }
+}
+
+/**
+ * \brief Returns the engine shared by the libraries of this domain.
+ *
+ * It copies with the CPU until a domain that has a DMA device attaches it
+ * with dma_copy_device_backend_init().
+ */
+struct dma_copy_engine *dma_copy_default_engine(void)
+{
+    if (!default_engine_initialized) {
+        dma_copy_engine_init(&default_engine);
+        default_engine_initialized = true;
+    }
+    return &default_engine;
+}
+
+/**
+ * \brief Set the offload backend. Must not be called while copies are
+ *        outstanding.
+ *
+ * The state of the previous backend is destroyed, unless it is reused.
+ */
+void dma_copy_engine_set_backend(struct dma_copy_engine *engine,
+                                 const struct dma_copy_backend_ops *ops,
+                                 void *st, const char *name)
+{
+    assert(engine->outstanding == 0);
+    if (engine->ops != NULL && engine->ops->destroy != NULL
+            && engine->backend_st != st) {
+        engine->ops->destroy(engine->backend_st);
+    }
+    engine->ops = ops;
+    engine->backend_st = st;
+    engine->backend_name = ops != NULL ? name : "cpu";
+}
+
+/**
+ * \brief Set the minimum size of offloaded copies and the maximum number of
+ *        offloaded copies in flight.
+ */
+void dma_copy_engine_set_policy(struct dma_copy_engine *engine,
+                                size_t offload_threshold,
+                                size_t max_outstanding)
+{
+    engine->offload_threshold = offload_threshold;
+    engine->max_outstanding = max_outstanding;
+}
+
+static struct dma_copy_request *request_alloc(struct dma_copy_engine *engine)
+{
+    struct dma_copy_request *req = engine->free_list;
+    if (req != NULL) {
+        engine->free_list = req->next;
+    } else {
+        req = malloc(sizeof(*req));
+        if (req == NULL) {
+            return NULL;
+        }
+    }
+    memset(req, 0, sizeof(*req));
+    req->engine = engine;
+    return req;
+}
+
+/// Call the callbacks of finished requests at the head of the queue
+static void complete_in_order(struct dma_copy_engine *engine)
+{
+    while (engine->head != NULL && engine->head->finished) {
+        struct dma_copy_request *req = engine->head;
+        engine->head = req->next;
+        if (engine->head == NULL) {
+            engine->tail = NULL;
+        }
+
+        dma_copy_done_fn *done = req->done;
+        void *arg = req->arg;
+        errval_t err = req->err;
+
+        req->next = engine->free_list;
+        engine->free_list = req;
+
+        if (done != NULL) {
+            done(err, arg);
+        }
+    }
+}
+
+/**
+ * \brief Called by a backend once an offloaded copy finished.
+ */
+void dma_copy_request_done(struct dma_copy_request *req, errval_t err)
+{
+    struct dma_copy_engine *engine = req->engine;
+
+    assert(req->offloaded && !req->finished);
+    assert(engine->outstanding > 0);
+
+    req->err = err;
+    req->finished = true;
+    engine->outstanding--;
+}
+
+static bool should_offload(struct dma_copy_engine *engine, lpaddr_t dst_phys,
+                           lpaddr_t src_phys, size_t bytes)
+{
+    if (engine->ops == NULL || bytes < engine->offload_threshold
+        || dst_phys == 0 || src_phys == 0) {
+        return false;
+    }
+    if (engine->outstanding >= engine->max_outstanding) {
+        engine->stats.offload_busy++;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Copy \p bytes from \p src to \p dst.
+ *
+ * \param dst_phys  Physical address of \p dst, or 0 if unknown
+ * \param src_phys  Physical address of \p src, or 0 if unknown
+ * \param done      Called once the copy finished, may be NULL
+ *
+ * The buffers must stay valid until \p done is called. If the copy is done
+ * by the CPU and no earlier copy is outstanding, \p done is called before
+ * this function returns.
+ */
+errval_t dma_copy_async(struct dma_copy_engine *engine,
+                        void *dst, lpaddr_t dst_phys,
+                        const void *src, lpaddr_t src_phys, size_t bytes,
+                        dma_copy_done_fn *done, void *arg)
+{
+    errval_t err;
+
+    if (dst == NULL || src == NULL) {
+        return DMA_ERR_ARG_INVALID;
+    }
+
+    struct dma_copy_request *req = request_alloc(engine);
+    if (req == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    req->done = done;
+    req->arg = arg;
+
+    if (engine->tail != NULL) {
+        engine->tail->next = req;
+    } else {
+        engine->head = req;
+    }
+    engine->tail = req;
+
+    if (should_offload(engine, dst_phys, src_phys, bytes)) {
+        req->offloaded = true;
+        engine->outstanding++;
+        err = engine->ops->submit(engine->backend_st, req, dst, dst_phys,
+                                  src, src_phys, bytes);
+        if (err_is_ok(err)) {
+            engine->stats.offload_copies++;
+            engine->stats.offload_bytes += bytes;
+            return SYS_ERR_OK;
+        }
+
+        // the backend refused, copy it ourselves
+        req->offloaded = false;
+        engine->outstanding--;
+        engine->stats.offload_busy++;
+    }
+
+    uint64_t start = copy_tsc();
+    pktcopy_memcpy(dst, src, bytes);
+    engine->stats.cpu_cycles += copy_tsc() - start;
+    engine->stats.cpu_copies++;
+    engine->stats.cpu_bytes += bytes;
+
+    req->err = SYS_ERR_OK;
+    req->finished = true;
+    complete_in_order(engine);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Poll the backend and call the callbacks of finished copies.
+ */
+errval_t dma_copy_poll(struct dma_copy_engine *engine)
+{
+    errval_t err = SYS_ERR_OK;
+
+    if (engine->ops != NULL && engine->outstanding > 0) {
+        err = engine->ops->poll(engine->backend_st);
+    }
+    complete_in_order(engine);
+
+    return err;
+}
+
+/**
+ * \brief Wait until all copies finished.
+ */
+errval_t dma_copy_wait(struct dma_copy_engine *engine)
+{
+    while (engine->head != NULL) {
+        errval_t err = dma_copy_poll(engine);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+    return SYS_ERR_OK;
+}
+
+struct copy_sync_state {
+    volatile bool done;
+    errval_t err;
+};
+
+static void copy_sync_done(errval_t err, void *arg)
+{
+    struct copy_sync_state *st = arg;
+    st->err = err;
+    st->done = true;
+}
+
+/**
+ * \brief Copy and wait until the copy (and every copy before it) finished.
+ *
+ * Large copies still go to the offload backend, which keeps the source
+ * out of the CPU caches, but the CPU spins while they run.
+ */
+errval_t dma_copy(struct dma_copy_engine *engine,
+                  void *dst, lpaddr_t dst_phys,
+                  const void *src, lpaddr_t src_phys, size_t bytes)
+{
+    struct copy_sync_state st = { .done = false, .err = SYS_ERR_OK };
+
+    errval_t err = dma_copy_async(engine, dst, dst_phys, src, src_phys,
+                                  bytes, copy_sync_done, &st);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    while (!st.done) {
+        err = dma_copy_poll(engine);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+    return st.err;
+}
+
+/*
+ * Software backend
+ */
+
+struct sw_copy {
+    struct dma_copy_request *req;
+    uint8_t *dst;
+    const uint8_t *src;
+    size_t bytes;
+    struct sw_copy *next;
+};
+
+struct sw_backend {
+    size_t bytes_per_poll;
+    struct sw_copy *head, *tail;
+};
+
+static errval_t sw_submit(void *st, struct dma_copy_request *req,
+                          void *dst, lpaddr_t dst_phys,
+                          const void *src, lpaddr_t src_phys, size_t bytes)
+{
+    struct sw_backend *sw = st;
+
+    struct sw_copy *c = malloc(sizeof(*c));
+    if (c == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    c->req = req;
+    c->dst = dst;
+    c->src = src;
+    c->bytes = bytes;
+    c->next = NULL;
+
+    if (sw->tail != NULL) {
+        sw->tail->next = c;
+    } else {
+        sw->head = c;
+    }
+    sw->tail = c;
+
+    return SYS_ERR_OK;
+}
+
+/// Make progress on the queued copies, like a DMA engine working in chunks
+static errval_t sw_poll(void *st)
+{
+    struct sw_backend *sw = st;
+    size_t budget = sw->bytes_per_poll;
+
+    while (sw->head != NULL && budget > 0) {
+        struct sw_copy *c = sw->head;
+        size_t n = c->bytes < budget ? c->bytes : budget;
+
+        pktcopy_memcpy(c->dst, c->src, n);
+        c->dst += n;
+        c->src += n;
+        c->bytes -= n;
+        budget -= n;
+
+        if (c->bytes == 0) {
+            sw->head = c->next;
+            if (sw->head == NULL) {
+                sw->tail = NULL;
+            }
+            dma_copy_request_done(c->req, SYS_ERR_OK);
+            free(c);
+        }
+    }
+
+    return SYS_ERR_OK;
+}
+
+static void sw_destroy(void *st)
+{
+    struct sw_backend *sw = st;
+    assert(sw->head == NULL);
+    free(sw);
+}
+
+static const struct dma_copy_backend_ops sw_backend_ops = {
+    .submit = sw_submit,
+    .poll = sw_poll,
+    .destroy = sw_destroy,
+};
+
+/**
+ * \brief Attach a software offload backend.
+ *
+ * It copies with the CPU, \p bytes_per_poll at a time from dma_copy_poll(),
+ * and runs anywhere. It exercises the asynchronous path without DMA
+ * hardware and serves as the baseline for the offload benchmark. If the
+ * engine already has a software backend, only \p bytes_per_poll changes.
+ */
+errval_t dma_copy_sw_backend_init(struct dma_copy_engine *engine,
+                                  size_t bytes_per_poll)
+{
+    if (bytes_per_poll == 0) {
+        return DMA_ERR_ARG_INVALID;
+    }
+
+    if (engine->ops == &sw_backend_ops) {
+        struct sw_backend *sw = engine->backend_st;
+        sw->bytes_per_poll = bytes_per_poll;
+        return SYS_ERR_OK;
+    }
+
+    struct sw_backend *sw = calloc(1, sizeof(*sw));
+    if (sw == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    sw->bytes_per_poll = bytes_per_poll;
+
+    dma_copy_engine_set_backend(engine, &sw_backend_ops, sw, "software");
+    return SYS_ERR_OK;
+}
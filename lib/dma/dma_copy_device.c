@@ -0,0 +1,89 @@
+/**
+ * \file
+ * \brief Copy engine backend for DMA devices (IOAT, Xeon Phi, DMA client)
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <barrelfish/barrelfish.h>
+
+#include <dma/dma.h>
+#include <dma/dma_device.h>
+#include <dma/dma_request.h>
+#include <dma/dma_copy.h>
+
+static void device_copy_done(errval_t err, dma_req_id_t id, void *arg)
+{
+    dma_copy_request_done(arg, err);
+}
+
+static errval_t device_submit(void *st, struct dma_copy_request *req,
+                              void *dst, lpaddr_t dst_phys,
+                              const void *src, lpaddr_t src_phys, size_t bytes)
+{
+    struct dma_device *dev = st;
+    dma_req_id_t id;
+
+    struct dma_req_setup setup = {
+        .type = DMA_REQ_TYPE_MEMCPY,
+        .done_cb = device_copy_done,
+        .cb_arg = req,
+        .args = {
+            .memcpy = {
+                .src = src_phys,
+                .dst = dst_phys,
+                .bytes = bytes
+            }
+        }
+    };
+
+    // errors (ring full, memory not registered, ...) make the engine
+    // fall back to a CPU copy
+    return dma_request_memcpy(dev, &setup, &id);
+}
+
+static errval_t device_poll(void *st)
+{
+    errval_t err = dma_device_poll_channels(st);
+
+    switch (err_no(err)) {
+    case DMA_ERR_DEVICE_IDLE:
+    case DMA_ERR_CHAN_IDLE:
+        return SYS_ERR_OK;
+    default:
+        return err;
+    }
+}
+
+static const struct dma_copy_backend_ops device_backend_ops = {
+    .submit = device_submit,
+    .poll = device_poll,
+};
+
+/**
+ * \brief Offload copies of the engine to a DMA device.
+ *
+ * \param engine    Copy engine, e.g. dma_copy_default_engine()
+ * \param dev       DMA device, as returned by the device or client library
+ *
+ * Copies are done on the device's channels. Completion is detected by
+ * polling the device from dma_copy_poll().
+ */
+errval_t dma_copy_device_backend_init(struct dma_copy_engine *engine,
+                                      struct dma_device *dev)
+{
+    if (dev == NULL) {
+        return DMA_ERR_ARG_INVALID;
+    }
+
+    dma_copy_engine_set_backend(engine, &device_backend_ops, dev,
+                                "dma device");
+    return SYS_ERR_OK;
+}
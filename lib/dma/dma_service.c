@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -240,6 +240,7 @@ static errval_t svc_connect_cb(void *st,
     txq_init(&state->queue, binding, binding->waitset,
              (txq_register_fn_t) binding->register_send,
              sizeof(struct dma_svc_reply_st));
+    txq_set_stats(&state->queue, binding->stats);
 
     err = event_handlers->connect(st, &state->usr_st);
     if (err_is_fail(err)) {
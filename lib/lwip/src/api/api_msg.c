@@ -1053,6 +1053,8 @@ static err_t do_writemore(struct netconn *conn)
     LWIP_ASSERT("do_writemore: invalid length!",
                 ((conn->write_offset + len) <= conn->write_msg->msg.w.len));
     if (err == ERR_OK) {
+        u8_t more = conn->write_msg->msg.w.apiflags & NETCONN_MORE;
+
         conn->write_offset += len;
         if (conn->write_offset == conn->write_msg->msg.w.len) {
             /* everything was written */
@@ -1062,7 +1064,11 @@ static err_t do_writemore(struct netconn *conn)
             /* API_EVENT might call tcp_tmr, so reset conn->state now */
             conn->state = NETCONN_NONE;
         }
-        err = tcp_output_nagle(conn->pcb.tcp);
+        /* if the caller has more data to follow, keep the segment open so
+           the next write is appended to it instead of sent on its own */
+        if (!(write_finished && more)) {
+            err = tcp_output_nagle(conn->pcb.tcp);
+        }
         conn->err = err;
         if ((err == ERR_OK) && (tcp_sndbuf(conn->pcb.tcp) <= TCP_SNDLOWAT)) {
             API_EVENT(conn, NETCONN_EVT_SENDMINUS, len);
@@ -62,6 +62,7 @@
 #endif /* BF_LWIP_CHAN_SUPPORT */
 
 #include <string.h>
+#include <sys/socket.h>
 
 #define NUM_SOCKETS MEMP_NUM_NETCONN
 
@@ -88,6 +89,9 @@ struct lwip_socket {
     struct waitset_chanstate recv_chanstate;
     /** Channel used to signal, when data is ready for writing. */
     struct waitset_chanstate send_chanstate;
+    /** Persistent handler for readiness events, used by epoll */
+    lwip_sock_event_fn event_fn;
+    void *event_arg;
 #endif /* BF_LWIP_CHAN_SUPPORT */
 };
 
@@ -250,6 +254,8 @@ static int alloc_socket(struct netconn *newconn)
                                    CHANTYPE_LWIP_SOCKET);
             waitset_chanstate_init(&sockets[i].send_chanstate,
                                    CHANTYPE_LWIP_SOCKET);
+            sockets[i].event_fn = NULL;
+            sockets[i].event_arg = NULL;
 #endif /* BF_LWIP_CHAN_SUPPORT */
             return i;
         }
@@ -831,9 +837,121 @@ lwip_sendto(int s, const void *data, size_t size, int flags,
     return (err == ERR_OK ? short_size : -1);
 }
 
+/**
+ * \brief Send a message gathered from several buffers.
+ *
+ * For TCP, every buffer but the last is queued with NETCONN_MORE, so that
+ * a header and a body written together leave in one segment. Datagrams
+ * are copied once into a single transmit buffer.
+ */
 int lwip_sendmsg(int sockfd, const struct msghdr *msg, int flags)
 {
-    assert(!"NYI");
+    struct lwip_socket *sock;
+    err_t err = ERR_OK;
+    size_t total = 0;
+    int i;
+
+    sock = get_socket(sockfd);
+    if (!sock)
+        return -1;
+
+    if (msg->msg_iovlen < 0) {
+        sock_set_errno(sock, err_to_errno(ERR_ARG));
+        return -1;
+    }
+
+    if (sock->conn->type == NETCONN_TCP) {
+#if LWIP_TCP
+        int last = msg->msg_iovlen - 1;
+
+        /* skip trailing empty buffers, they must not hold back the rest */
+        while (last >= 0 && msg->msg_iov[last].iov_len == 0) {
+            last--;
+        }
+        for (i = 0; i <= last && err == ERR_OK; i++) {
+            const struct iovec *iov = &msg->msg_iov[i];
+            u8_t apiflags = NETCONN_COPY;
+
+            if (iov->iov_len == 0) {
+                continue;
+            }
+            if (i < last || (flags & MSG_MORE)) {
+                apiflags |= NETCONN_MORE;
+            }
+            err = netconn_write(sock->conn, iov->iov_base, iov->iov_len,
+                                apiflags);
+            if (err == ERR_OK) {
+                total += iov->iov_len;
+            }
+        }
+
+        LWIP_DEBUGF(SOCKETS_DEBUG,
+                    ("lwip_sendmsg(%d) err=%d size=%" SZT_F "\n", sockfd, err,
+                     total));
+        if (total > 0) {
+            sock_set_errno(sock, 0);
+            return (int) total;
+        }
+        sock_set_errno(sock, err_to_errno(err));
+        return (err == ERR_OK ? 0 : -1);
+#else
+        sock_set_errno(sock, err_to_errno(ERR_ARG));
+        return -1;
+#endif                          /* LWIP_TCP */
+    }
+
+#if (LWIP_UDP || LWIP_RAW)
+    {
+        const struct sockaddr_in *to = msg->msg_name;
+        struct ip_addr remote_addr;
+        struct netbuf buf;
+        u8_t *payload;
+
+        for (i = 0; i < msg->msg_iovlen; i++) {
+            total += msg->msg_iov[i].iov_len;
+        }
+        LWIP_ERROR("lwip_sendmsg: invalid address",
+                   (((to == NULL) && (msg->msg_namelen == 0))
+                    || ((msg->msg_namelen == sizeof(struct sockaddr_in))
+                        && (to->sin_family == AF_INET))),
+                   sock_set_errno(sock, err_to_errno(ERR_ARG));
+                   return -1;
+          );
+        if (total > 0xffff) {
+            sock_set_errno(sock, EMSGSIZE);
+            return -1;
+        }
+
+        buf.p = buf.ptr = NULL;
+        if (to) {
+            remote_addr.addr = to->sin_addr.s_addr;
+            buf.addr = &remote_addr;
+            buf.port = ntohs(to->sin_port);
+        } else {
+            buf.addr = NULL;
+            buf.port = 0;
+        }
+
+        payload = netbuf_alloc(&buf, (u16_t) total);
+        if (payload == NULL) {
+            err = ERR_MEM;
+        } else {
+            for (i = 0; i < msg->msg_iovlen; i++) {
+                MEMCPY(payload, msg->msg_iov[i].iov_base,
+                       msg->msg_iov[i].iov_len);
+                payload += msg->msg_iov[i].iov_len;
+            }
+            err = netconn_send(sock->conn, &buf);
+        }
+        netbuf_free(&buf);
+
+        sock_set_errno(sock, err_to_errno(err));
+        return (err == ERR_OK ? (int) total : -1);
+    }
+#else
+    sock_set_errno(sock, err_to_errno(ERR_ARG));
+    return -1;
+#endif                          /* (LWIP_UDP || LWIP_RAW) */
 }
 
 int lwip_socket(int domain, int type, int protocol)
@@ -1127,6 +1245,9 @@ event_callback(struct netconn *conn, enum netconn_evt evt, u16_t len)
 
 #ifdef BF_LWIP_CHAN_SUPPORT
     errval_t err;
+    uint32_t events = 0;
+    lwip_sock_event_fn event_fn;
+    void *event_arg;
 #endif /* BF_LWIP_CHAN_SUPPORT */
 
     LWIP_UNUSED_ARG(len);
@@ -1171,6 +1292,7 @@ event_callback(struct netconn *conn, enum netconn_evt evt, u16_t len)
                 err = waitset_chan_trigger(&sock->recv_chanstate);
                 assert(err_is_ok(err));
             }
+            events = LWIP_SOCK_EVENT_READ;
 #endif /* BF_LWIP_CHAN_SUPPORT */
             break;
         case NETCONN_EVT_RCVMINUS:
@@ -1178,24 +1300,36 @@ event_callback(struct netconn *conn, enum netconn_evt evt, u16_t len)
             break;
         case NETCONN_EVT_SENDPLUS:
             sock->sendevent = 1;
-            break;
-        case NETCONN_EVT_SENDMINUS:
-            sock->sendevent = 0;
 #ifdef BF_LWIP_CHAN_SUPPORT
-            /* If the send channel is associated with a waitset, trigger an
-             * event. */
+            /* The socket became writable again. Trigger an event if the send
+             * channel is associated with a waitset. */
             if (waitset_chan_is_registered(&sock->send_chanstate)) {
                 err = waitset_chan_trigger(&sock->send_chanstate);
                 assert(err_is_ok(err));
             }
+            events = LWIP_SOCK_EVENT_WRITE;
 #endif /* BF_LWIP_CHAN_SUPPORT */
             break;
+        case NETCONN_EVT_SENDMINUS:
+            sock->sendevent = 0;
+            break;
         default:
             LWIP_ASSERT("unknown event", 0);
             break;
     }
+#ifdef BF_LWIP_CHAN_SUPPORT
+    event_fn = sock->event_fn;
+    event_arg = sock->event_arg;
+#endif /* BF_LWIP_CHAN_SUPPORT */
     sys_sem_signal(selectsem);
 
+#ifdef BF_LWIP_CHAN_SUPPORT
+    /* Call the persistent handler outside the lock, it may take its own */
+    if (events != 0 && event_fn != NULL) {
+        event_fn(event_arg, s, events);
+    }
+#endif /* BF_LWIP_CHAN_SUPPORT */
+
     /* Now decide if anyone is waiting for this socket */
     /* NOTE: This code is written this way to protect the select link list
        but to avoid a deadlock situation by releasing socksem before
@@ -2293,9 +2427,14 @@ bool lwip_sock_ready_write(int socket)
     return is_ready;
 }
 
-bool lwip_sock_is_open(int s)
+bool lwip_sock_is_open(int socket)
 {
-    assert(!"NYI");
+    struct lwip_socket *p_sock;
+
+    p_sock = get_socket(socket);
+    assert(p_sock != NULL);
+
+    return p_sock->conn != NULL && !ERR_IS_FATAL(p_sock->conn->err);
 }
 
 static void do_nothing(void *arg)
@@ -2424,6 +2563,71 @@ errval_t lwip_sock_waitset_register_write(int socket, struct waitset *ws)
 
     return SYS_ERR_OK;
 }
+
+/**
+ * \brief Register a handler that is called whenever the socket may have
+ *        become ready for reading or writing.
+ *
+ * Unlike the waitset registrations above, the handler stays registered until
+ * it is deregistered or the socket is closed. The stack processes its events
+ * independently of \p ws, so it is unused here.
+ *
+ * \param socket    Socket
+ * \param ws        Waitset the caller blocks on
+ * \param fn        Handler
+ * \param arg       Argument passed to the handler
+ */
+errval_t lwip_sock_waitset_register_events(int socket, struct waitset *ws,
+                                           lwip_sock_event_fn fn, void *arg)
+{
+    struct lwip_socket *p_sock;
+
+    assert(fn != NULL);
+
+    p_sock = get_socket(socket);
+    assert(p_sock != NULL);
+
+    sys_sem_wait(selectsem);
+    p_sock->event_fn = fn;
+    p_sock->event_arg = arg;
+    sys_sem_signal(selectsem);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Deregister the handler registered with
+ *        lwip_sock_waitset_register_events().
+ */
+errval_t lwip_sock_waitset_deregister_events(int socket)
+{
+    struct lwip_socket *p_sock;
+
+    p_sock = get_socket(socket);
+    assert(p_sock != NULL);
+
+    sys_sem_wait(selectsem);
+    p_sock->event_fn = NULL;
+    p_sock->event_arg = NULL;
+    sys_sem_signal(selectsem);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Register the channels the stack needs to make progress on \p ws.
+ *
+ * The stack handles its events on lwip_waitset, so there is nothing to do.
+ */
+errval_t lwip_sock_waitset_register_stack(struct waitset *ws)
+{
+    return SYS_ERR_OK;
+}
+
+errval_t lwip_sock_waitset_deregister_stack(void)
+{
+    return SYS_ERR_OK;
+}
 #endif /* BF_LWIP_CHAN_SUPPORT */
 
 #endif                          /* LWIP_SOCKET */
@@ -20,6 +20,7 @@
 #include <errors/errno.h>
 
 #include <stdbool.h>
+#include <stdint.h>
 
 bool lwip_sock_is_open(int socket);
 bool lwip_sock_ready_read(int socket);
@@ -30,4 +31,28 @@ errval_t lwip_sock_waitset_register_read(int socket, struct waitset *ws);
 errval_t lwip_sock_waitset_deregister_write(int socket);
 errval_t lwip_sock_waitset_register_write(int socket, struct waitset *ws);
 
+/// Readiness events passed to a socket's event handler
+#define LWIP_SOCK_EVENT_READ    0x1
+#define LWIP_SOCK_EVENT_WRITE   0x2
+
+/**
+ * \brief Handler called when a socket may have become ready
+ *
+ * It is called from within the network stack, possibly on another thread
+ * than the one that registered it, and must not call back into the stack.
+ */
+typedef void (*lwip_sock_event_fn)(void *arg, int socket, uint32_t events);
+
+errval_t lwip_sock_waitset_register_events(int socket, struct waitset *ws,
+                                           lwip_sock_event_fn fn, void *arg);
+errval_t lwip_sock_waitset_deregister_events(int socket);
+
+/*
+ * Register whatever the stack needs to make progress while the caller blocks
+ * on \p ws. Without this, the handlers above are only called when the stack
+ * is driven from elsewhere.
+ */
+errval_t lwip_sock_waitset_register_stack(struct waitset *ws);
+errval_t lwip_sock_waitset_deregister_stack(void);
+
 #endif /* __LWIP_CHAN_SUPPORT_H__ */
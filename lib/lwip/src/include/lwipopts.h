@@ -16,6 +16,12 @@
 #define LWIPOPTS_H
 
 #include <barrelfish/net_constants.h>
+#include <pktcopy/pktcopy.h>
+
+/// Use the vectorised packet copy and checksum routines
+#define MEMCPY(dst,src,len)     pktcopy_memcpy(dst,src,len)
+#define LWIP_CHKSUM             pktcopy_chksum
+
 /// Build DHCP client
 #define LWIP_DHCP               1
 
@@ -21,10 +21,17 @@
  *      split up into child nodes for smaller allocations.
  *   2. A free node, which is a regular free child node in the tree.
  *   3. An allocated node.
+ *
+ * Allocations search the tree either first-fit or best-fit (see
+ * #mm_placement). Best-fit takes the smallest free node that fits, so small
+ * requests are served from regions that have already been split up and
+ * large, naturally aligned free nodes stay intact for large requests such as
+ * large and huge pages. The allocator keeps per-size counts of free nodes
+ * (#mm_stats) to measure fragmentation.
  */
 
 /*
- * Copyright (c) 2008, 2009, 2010, 2011, ETH Zurich.
+ * Copyright (c) 2008, 2009, 2010, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -35,6 +42,7 @@
 #include <barrelfish/barrelfish.h>
 #include <mm/mm.h>
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 
 #if 1
@@ -82,6 +90,40 @@ static struct mmnode *new_node(struct mm *mm, enum nodetype type,
     return node;
 }
 
+/// Account for a new free node of the given size
+static inline void stats_add_free(struct mm *mm, uint8_t sizebits)
+{
+    assert(sizebits < MM_STATS_BITS);
+    mm->stats.free_blocks[sizebits]++;
+    mm->stats.free_bytes += UNBITS_GENPA(sizebits);
+}
+
+/// Account for a free node of the given size that is no longer free
+static inline void stats_remove_free(struct mm *mm, uint8_t sizebits)
+{
+    assert(sizebits < MM_STATS_BITS);
+    assert(mm->stats.free_blocks[sizebits] > 0);
+    mm->stats.free_blocks[sizebits]--;
+    mm->stats.free_bytes -= UNBITS_GENPA(sizebits);
+}
+
+/// Account for all free nodes below a node that becomes unreachable
+static void stats_remove_subtree(struct mm *mm, struct mmnode *node,
+                                 uint8_t nodesizebits)
+{
+    if (node->type == NodeType_Free) {
+        stats_remove_free(mm, nodesizebits);
+    } else if (node->type == NodeType_Chunked
+               || (node->type == NodeType_Dummy && node->childbits != FLAGBITS)) {
+        for (cslot_t i = 0; i < UNBITS_CA(node->childbits); i++) {
+            if (node->children[i] != NULL) {
+                stats_remove_subtree(mm, node->children[i],
+                                     nodesizebits - node->childbits);
+            }
+        }
+    }
+}
+
 /// Reduce the number of children of a node by pushing existing children down.
 static errval_t resize_node(struct mm *mm, struct mmnode *node,
                             uint8_t newchildbits)
@@ -330,6 +372,73 @@ static errval_t find_node(struct mm *mm, bool do_realloc, uint8_t sizebits,
     return MM_ERR_NOT_FOUND;
 }
 
+/// Best candidate found so far by find_best_node()
+struct best_fit {
+    struct mmnode *node;
+    genpaddr_t nodebase;
+    uint8_t nodesizebits;
+    uint8_t fitbits;    ///< Smallest free block size that is big enough
+};
+
+/**
+ * \brief Finds the smallest free node at least as big as the given size
+ * within a region
+ *
+ * Walks the tree below \p node, skipping subtrees whose children are too
+ * small, and stops early once a node of size \p best->fitbits has been
+ * found. The caller sets \p best->fitbits from the free block counts, so
+ * sizes without free blocks are never searched for. On return
+ * \p best->node is NULL if there is no such node.
+ */
+static void find_best_node(struct mm *mm, uint8_t sizebits,
+                           genpaddr_t minbase, genpaddr_t maxlimit,
+                           struct mmnode *node,
+                           genpaddr_t nodebase, uint8_t nodesizebits,
+                           struct best_fit *best)
+{
+    assert(nodesizebits >= sizebits);
+
+    if (node->type == NodeType_Allocated) {
+        return;
+    } else if (node->type == NodeType_Free) {
+        /* could we allocate within this node, and is it better? */
+        if (minbase + UNBITS_GENPA(sizebits) <= nodebase + UNBITS_GENPA(nodesizebits)
+            && maxlimit - UNBITS_GENPA(sizebits) >= nodebase
+            && (best->node == NULL || nodesizebits < best->nodesizebits)) {
+            best->node = node;
+            best->nodebase = nodebase;
+            best->nodesizebits = nodesizebits;
+        }
+        return;
+    }
+
+    assert(node->childbits != FLAGBITS);
+    uint8_t childsizebits = nodesizebits - node->childbits;
+
+    /* don't try the children if they will be too small */
+    if (childsizebits < sizebits) {
+        return;
+    }
+
+    cslot_t start = 0, stop = UNBITS_CA(node->childbits);
+    if (minbase > nodebase) {
+        start = (minbase - nodebase) / UNBITS_GENPA(childsizebits);
+    }
+    if (maxlimit < nodebase + UNBITS_GENPA(nodesizebits)) {
+        stop = DIVIDE_ROUND_UP(maxlimit - nodebase, UNBITS_GENPA(childsizebits));
+    }
+    for (cslot_t i = start; i < stop; i++) {
+        if (node->children[i] != NULL) {
+            find_best_node(mm, sizebits, minbase, maxlimit, node->children[i],
+                           nodebase + i * UNBITS_GENPA(childsizebits),
+                           childsizebits, best);
+            if (best->node != NULL && best->nodesizebits == best->fitbits) {
+                return; // no smaller free block exists, can't do better
+            }
+        }
+    }
+}
+
 /**
  * \brief Chunk up a node, returning the chunk including the desired region and size
  *
@@ -414,6 +523,14 @@ static errval_t chunk_node(struct mm *mm, uint8_t sizebits,
         }
     }
 
+    /* a free node turns into as many free children */
+    if (node->type == NodeType_Free) {
+        stats_remove_free(mm, *nodesizebits);
+        mm->stats.free_blocks[*nodesizebits - childbits] += UNBITS_CA(childbits);
+        mm->stats.free_bytes += UNBITS_GENPA(*nodesizebits);
+        mm->stats.splits++;
+    }
+
     node->type = NodeType_Chunked;
     node->childbits = childbits;
     *nodesizebits -= node->childbits;
@@ -497,6 +614,8 @@ errval_t mm_init(struct mm *mm, enum objtype objtype, genpaddr_t base,
     mm->slot_alloc = slot_alloc_func;
     mm->slot_alloc_inst = slot_alloc_inst;
     mm->delete_chunked = delete_chunked;
+    mm->placement = MM_PLACEMENT_FIRST_FIT;
+    memset(&mm->stats, 0, sizeof(mm->stats));
 
     /* init slab allocator */
     slab_init(&mm->slabs, MM_NODE_SIZE(maxchildbits), slab_refill_func);
@@ -514,6 +633,59 @@ void mm_destroy(struct mm *mm)
     USER_PANIC("NYI");
 }
 
+/**
+ * \brief Set the placement policy for subsequent allocations
+ *
+ * \param mm Memory manager instance
+ * \param placement Placement policy
+ *
+ * First-fit (the default) takes the lowest-addressed free node that fits,
+ * and may split a large free region for a small request even though a
+ * smaller free node exists elsewhere. Best-fit searches the whole tree for
+ * the smallest free node that fits, which costs more per allocation but
+ * keeps large aligned regions available for large requests.
+ */
+void mm_set_placement(struct mm *mm, enum mm_placement placement)
+{
+    mm->placement = placement;
+}
+
+/**
+ * \brief Returns the free memory in free nodes of at least the given size
+ *
+ * This is the memory available to requests of that size. Compared to
+ * mm->stats.free_bytes, it tells how fragmented the free memory is, e.g.
+ * for the size of a large page.
+ */
+genpaddr_t mm_free_bytes_at_least(struct mm *mm, uint8_t sizebits)
+{
+    genpaddr_t bytes = 0;
+
+    for (uint8_t bits = sizebits; bits < MM_STATS_BITS; bits++) {
+        bytes += mm->stats.free_blocks[bits] * UNBITS_GENPA(bits);
+    }
+
+    return bytes;
+}
+
+/**
+ * \brief Print the free space statistics of a memory manager
+ */
+void mm_print_stats(struct mm *mm)
+{
+    printf("mm: %" PRIuGENPADDR " kB free, %" PRIu64 " splits\n",
+           mm->stats.free_bytes >> 10, mm->stats.splits);
+    for (uint8_t bits = 0; bits < MM_STATS_BITS; bits++) {
+        if (mm->stats.free_blocks[bits] == 0) {
+            continue;
+        }
+        printf("mm: %2u bits: %8zu free blocks, %" PRIuGENPADDR " kB free "
+               "in blocks of at least this size\n", bits,
+               mm->stats.free_blocks[bits],
+               mm_free_bytes_at_least(mm, bits) >> 10);
+    }
+}
+
 /**
  * \brief Add a new region to the memory manager
  *
@@ -546,6 +718,7 @@ errval_t mm_add(struct mm *mm, struct capref cap, uint8_t sizebits, genpaddr_t b
                 return MM_ERR_NEW_NODE;
             }
             mm->root->cap = cap;
+            stats_add_free(mm, sizebits);
             return SYS_ERR_OK;
         } else {
             mm->root = new_node(mm, NodeType_Dummy, FLAGBITS);
@@ -561,6 +734,7 @@ errval_t mm_add(struct mm *mm, struct capref cap, uint8_t sizebits, genpaddr_t b
     if (err_is_ok(err)) {
         assert(node != NULL);
         node->cap = cap;
+        stats_add_free(mm, sizebits);
     }
     return err;
 }
@@ -687,10 +861,30 @@ errval_t mm_alloc_range(struct mm *mm, uint8_t sizebits, genpaddr_t minbase,
     errval_t err;
 
     /* search for closest matching node in the tree */
-    err = find_node(mm, false, sizebits, minbase, maxlimit, mm->root, mm->base,
-                    mm->sizebits, &nodebase, &nodesizebits, &node);
-    if (err_is_fail(err)) {
-        return err;
+    if (mm->placement == MM_PLACEMENT_BEST_FIT) {
+        struct best_fit best = { .node = NULL, .fitbits = sizebits };
+        while (best.fitbits < MM_STATS_BITS
+               && mm->stats.free_blocks[best.fitbits] == 0) {
+            best.fitbits++;
+        }
+        if (best.fitbits == MM_STATS_BITS) {
+            return MM_ERR_NOT_FOUND;
+        }
+        find_best_node(mm, sizebits, minbase, maxlimit, mm->root, mm->base,
+                       mm->sizebits, &best);
+        if (best.node == NULL) {
+            return MM_ERR_NOT_FOUND;
+        }
+        node = best.node;
+        nodebase = best.nodebase;
+        nodesizebits = best.nodesizebits;
+    } else {
+        err = find_node(mm, false, sizebits, minbase, maxlimit, mm->root,
+                        mm->base, mm->sizebits, &nodebase, &nodesizebits,
+                        &node);
+        if (err_is_fail(err)) {
+            return err;
+        }
     }
 
     assert(node != NULL);
@@ -708,6 +902,7 @@ errval_t mm_alloc_range(struct mm *mm, uint8_t sizebits, genpaddr_t minbase,
 
     assert(nodebase >= minbase && nodebase + UNBITS_GENPA(sizebits) <= maxlimit);
     node->type = NodeType_Allocated;
+    stats_remove_free(mm, sizebits);
 
     assert(retcap != NULL);
     *retcap = node->cap;
@@ -765,6 +960,7 @@ errval_t mm_realloc_range(struct mm *mm, uint8_t sizebits, genpaddr_t base,
     assert(node != NULL);
     if (node->type == NodeType_Chunked) {
         assert(nodesizebits == sizebits);
+        stats_remove_subtree(mm, node, nodesizebits);
         node->type = NodeType_Allocated;
         /* FIXME: walk child nodes and mark them allocated? or destroy? */
         *retcap = node->cap;
@@ -784,6 +980,9 @@ errval_t mm_realloc_range(struct mm *mm, uint8_t sizebits, genpaddr_t base,
     }
 
     assert(nodebase == base && nodesizebits == sizebits);
+    if (node->type == NodeType_Free) {
+        stats_remove_free(mm, sizebits);
+    }
     node->type = NodeType_Allocated;
 
     assert(retcap != NULL);
@@ -840,6 +1039,7 @@ errval_t mm_free(struct mm *mm, struct capref cap, genpaddr_t base,
 
     node->type = NodeType_Free;
     node->cap = cap;
+    stats_add_free(mm, sizebits);
 
     return SYS_ERR_OK;
 }
@@ -8,7 +8,7 @@
  */
 
 /*
- * Copyright (c) 2007-12 ETH Zurich.
+ * Copyright (c) 2007-12, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -24,6 +24,8 @@
 #include <trace/trace.h>
 #include <trace_definitions/trace_defs.h>
 #include <net_queue_manager/net_queue_manager.h>
+#include <pktcopy/pktcopy.h>
+#include <dma/dma_copy.h>
 #include <if/net_queue_manager_defs.h>
 
 #include "QM_benchmark.h"
@@ -787,7 +789,11 @@ bool copy_packet_to_user(struct buffer_descriptor *buffer,
 
     uint64_t ts = rdtsc();
 
-    memcpy_fast((void *) (uintptr_t)dst, data, len);
+    // The driver recycles the packet buffer once we return, so wait for the
+    // copy. Its physical address is not known here, so this is a CPU copy.
+    errval_t err = dma_copy(dma_copy_default_engine(), dst, buffer->pa + offset,
+                            data, 0, len);
+    assert(err_is_ok(err));
     if (cl->debug_state == 4) {
         netbench_record_event_simple(bm, RE_COPY, ts);
     }
@@ -801,7 +807,7 @@ bool copy_packet_to_user(struct buffer_descriptor *buffer,
 #endif // TRACE_ETHERSRV_MODE
 
     // Handle raw interface
-    errval_t err = send_raw_xmit_done(b, offset, len, 0, flags);
+    err = send_raw_xmit_done(b, offset, len, 0, flags);
     if (err_is_ok(err)) {
         return true;
     } else {
@@ -1092,6 +1098,6 @@ bool waiting_for_netd(void)
 void *
 memcpy_fast(void *dst0, const void *src0, size_t length)
 {
-    return memcpy(dst0, src0, length);
+    return pktcopy_memcpy(dst0, src0, length);
 }
 
@@ -6,7 +6,7 @@
  */
 
 /*
- * Copyright (c) 2011, ETH Zurich.
+ * Copyright (c) 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -25,6 +25,54 @@
 
 #include "common.h"
 
+static errval_t barrier_query(char** query, const char* name)
+{
+    *query = malloc(strlen(name) + sizeof("_ { barrier: '' }"));
+    if (*query == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    sprintf(*query, "_ { barrier: '%s' }", name);
+
+    return SYS_ERR_OK;
+}
+
+/*
+ * The special record wakes up the clients waiting in the barrier. It lives
+ * on the shard of the barrier, independent of its own name.
+ */
+static errval_t barrier_set_special(struct octopus_thc_client_binding_t* cl,
+        const char* name)
+{
+    errval_t err, error_code;
+    char* record = NULL;
+    octopus_trigger_id_t tid;
+
+    err = cl->call_seq.set(cl, name, SET_DEFAULT, NOP_TRIGGER, false,
+            &record, &tid, &error_code);
+    assert(record == NULL);
+    if (err_is_ok(err)) {
+        err = error_code;
+    }
+    oct_cache_invalidate(name);
+
+    return err;
+}
+
+static errval_t barrier_del_special(struct octopus_thc_client_binding_t* cl,
+        const char* name)
+{
+    errval_t err, error_code;
+    octopus_trigger_id_t tid;
+
+    err = cl->call_seq.del(cl, name, NOP_TRIGGER, &tid, &error_code);
+    if (err_is_ok(err)) {
+        err = error_code;
+    }
+    oct_cache_invalidate(name);
+
+    return err;
+}
+
 /**
  * \brief Client enters a barrier. Blocks until all clients have entered the
  * barrier.
@@ -48,14 +96,21 @@ errval_t oct_barrier_enter(const char* name, char** barrier_record, size_t wait_
     uint64_t fn = 0;
     octopus_trigger_id_t tid;
     size_t current_barriers = 0;
+    char* query = NULL;
     octopus_trigger_t t = oct_mktrigger(OCT_ERR_NO_RECORD, octopus_BINDING_RPC,
             OCT_ON_SET, NULL, NULL);
+    struct octopus_thc_client_binding_t* cl = oct_get_thc_client_for(name);
+
+    err = barrier_query(&query, name);
+    if (err_is_fail(err)) {
+        return err;
+    }
 
     err = oct_set_get(SET_SEQUENTIAL, barrier_record,
             "%s_ { barrier: '%s' }", name, name);
-    err = oct_get_names(&names, &current_barriers, "_ { barrier: '%s' }",
-            name);
+    err = oct_get_names_on(cl, &names, &current_barriers, query);
     oct_free_names(names, current_barriers);
+    free(query);
     if (err_is_fail(err)) {
         return err;
     }
@@ -63,7 +118,6 @@ errval_t oct_barrier_enter(const char* name, char** barrier_record, size_t wait_
     //        wait_for);
 
     if (current_barriers != wait_for) {
-        struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
         err = cl->call_seq.exists(cl, name, t, &tid, &exist_err);
         if (err_is_fail(err)) {
             return err;
@@ -88,7 +142,7 @@ errval_t oct_barrier_enter(const char* name, char** barrier_record, size_t wait_
     else {
         // We are the last to enter the barrier,
         // wake up the others
-        err = oct_set(name);
+        err = barrier_set_special(cl, name);
     }
 
     return err;
@@ -114,6 +168,8 @@ errval_t oct_barrier_leave(const char* barrier_record)
     char* record = NULL;
     char** names = NULL;
     size_t remaining_barriers = 0;
+    char* query = NULL;
+    struct octopus_thc_client_binding_t* cl;
     uint64_t mode = 0;
     uint64_t state = 0;
     uint64_t fn = 0;
@@ -130,14 +186,18 @@ errval_t oct_barrier_leave(const char* barrier_record)
             goto out;
         }
 
-        err = oct_get_names(&names, &remaining_barriers, "_ { barrier: '%s' }",
-                barrier_name);
+        err = barrier_query(&query, barrier_name);
+        if (err_is_fail(err)) {
+            goto out;
+        }
+
+        cl = oct_get_thc_client_for(barrier_name);
+        err = oct_get_names_on(cl, &names, &remaining_barriers, query);
         oct_free_names(names, remaining_barriers);
 
         //debug_printf("remaining barriers is: %lu\n", remaining_barriers);
 
         if (err_is_ok(err)) {
-            struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
             err = cl->call_seq.exists(cl, barrier_name, t, &tid, &exist_err);
             if (err_is_fail(err)) {
                 goto out;
@@ -157,7 +217,7 @@ errval_t oct_barrier_leave(const char* barrier_record)
         else if (err_no(err) == OCT_ERR_NO_RECORD) {
             // We are the last one to leave the barrier,
             // wake-up all others
-            err = oct_del("%s", barrier_name);
+            err = barrier_del_special(cl, barrier_name);
         }
         else {
             // Just return the error
@@ -165,6 +225,7 @@ errval_t oct_barrier_leave(const char* barrier_record)
     }
 
 out:
+    free(query);
     free(record);
     free(rec_name);
     free(barrier_name);
@@ -0,0 +1,402 @@
+/**
+ * \file
+ * \brief Client-side record cache.
+ *
+ * Caches the results of oct_get (and of nameservice_lookup) keyed by the
+ * query string. With every record fetched into the cache we install a
+ * non-persistent trigger for the query; when the record is changed or
+ * deleted the trigger drops the entry. Trigger events arrive over the event
+ * binding and are only handled while the domain dispatches events, so an
+ * entry is also refetched once it is older than the staleness bound given to
+ * oct_cache_enable. Writes and deletes of the domain itself drop the
+ * matching entries right away, so the domain always reads its own writes.
+ *
+ * The cache is direct-mapped, a query evicts whatever other query hashes to
+ * the same slot. Failed lookups are not cached.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <string.h>
+#include <ctype.h>
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/deferred.h>
+#include <barrelfish/threads.h>
+#include <barrelfish/nameservice_client.h>
+
+#include <octopus/init.h>
+#include <octopus/cache.h>
+#include <octopus/trigger.h>
+#include <if/octopus_defs.h>
+#include <if/octopus_thc.h>
+
+#include "common.h"
+
+#ifndef OCT_CACHE_BITS
+#define OCT_CACHE_BITS 6
+#endif
+#define OCT_CACHE_SIZE (1UL << OCT_CACHE_BITS)
+
+struct cache_entry {
+    char* query;                ///< Key, NULL if the slot is unused
+    struct octopus_thc_client_binding_t* cl; ///< Server the record is from
+    char* record;               ///< Cached record, NULL if not valid
+    systime_t fetched;          ///< When record was fetched
+    uintptr_t gen;              ///< Incremented whenever the slot is reused
+    bool watched;               ///< Trigger installed and not yet fired
+    bool written;               ///< Written locally while being fetched
+    octopus_trigger_id_t tid;   ///< Id of the installed trigger
+};
+
+static struct cache_entry cache[OCT_CACHE_SIZE];
+static struct thread_mutex cache_lock = THREAD_MUTEX_INITIALIZER;
+static struct oct_cache_stats stats;
+static delayus_t staleness_bound;
+static bool enabled = false;
+
+static size_t cache_index(const char* query)
+{
+    // djb2
+    uint32_t hash = 5381;
+    for (const char* c = query; *c != '\0'; c++) {
+        hash = hash * 33 + *c;
+    }
+
+    return hash & (OCT_CACHE_SIZE - 1);
+}
+
+/*
+ * The trigger state identifies the slot and its generation, so triggers of
+ * evicted entries are ignored.
+ */
+static inline uintptr_t cache_token(size_t idx, uintptr_t gen)
+{
+    return (gen << OCT_CACHE_BITS) | idx;
+}
+
+static void cache_trigger_handler(octopus_mode_t mode, char* record,
+        void* state)
+{
+    uintptr_t token = (uintptr_t) state;
+    struct cache_entry* e = &cache[token & (OCT_CACHE_SIZE - 1)];
+
+    thread_mutex_lock(&cache_lock);
+    if (cache_token(token & (OCT_CACHE_SIZE - 1), e->gen) == token) {
+        if (e->record != NULL) {
+            stats.invalidations++;
+        }
+        free(e->record);
+        e->record = NULL;
+        e->watched = false;
+        e->tid = 0;
+    }
+    thread_mutex_unlock(&cache_lock);
+
+    free(record);
+}
+
+struct pending_trigger {
+    struct octopus_thc_client_binding_t* cl;
+    octopus_trigger_id_t tid;
+};
+
+/*
+ * Frees the entry. Returns the trigger that has to be removed by the caller
+ * once the lock is dropped, tid 0 if there is none.
+ */
+static struct pending_trigger cache_entry_clear(struct cache_entry* e)
+{
+    struct pending_trigger t = { e->cl, e->watched ? e->tid : 0 };
+
+    free(e->query);
+    free(e->record);
+    e->query = NULL;
+    e->record = NULL;
+    e->watched = false;
+    e->written = false;
+    e->tid = 0;
+    e->cl = NULL;
+    e->gen++;
+
+    return t;
+}
+
+static void remove_trigger(struct pending_trigger t)
+{
+    if (t.tid != 0) {
+        // The trigger may have fired in the meantime
+        errval_t error_code;
+        errval_t err = t.cl->call_seq.remove_trigger(t.cl, t.tid, &error_code);
+        if (err_is_ok(err)) {
+            err = error_code;
+        }
+        if (err_is_fail(err) && err_no(err) != OCT_ERR_INVALID_ID) {
+            DEBUG_ERR(err, "removing cache trigger");
+        }
+    }
+}
+
+bool oct_cache_enabled(void)
+{
+    return enabled;
+}
+
+/**
+ * \brief Gets the record matching a query, from the cache if possible.
+ *
+ * \param[in] cl Server owning the record.
+ * \param[out] data Record, needs to be freed by the caller.
+ * \param[in] query Query, used as key for the cache.
+ *
+ * \retval SYS_ERR_OK
+ * \retval OCT_ERR_NO_RECORD
+ * \retval OCT_ERR_PARSER_FAIL
+ * \retval OCT_ERR_ENGINE_FAIL
+ * \retval LIB_ERR_MALLOC_FAIL
+ */
+errval_t oct_cache_get(struct octopus_thc_client_binding_t* cl, char** data,
+        const char* query)
+{
+    assert(query != NULL);
+    errval_t err, error_code;
+    octopus_trigger_id_t tid = 0;
+    struct pending_trigger evicted = { NULL, 0 };
+
+    size_t idx = cache_index(query);
+    struct cache_entry* e = &cache[idx];
+    systime_t now = get_system_time();
+
+    thread_mutex_lock(&cache_lock);
+    if (e->query != NULL && e->cl == cl && strcmp(e->query, query) == 0) {
+        if (e->record != NULL && now - e->fetched <= staleness_bound) {
+            *data = strdup(e->record);
+            stats.hits++;
+            thread_mutex_unlock(&cache_lock);
+            return (*data != NULL) ? SYS_ERR_OK : LIB_ERR_MALLOC_FAIL;
+        }
+        if (e->record != NULL) {
+            stats.expired++;
+        } else {
+            stats.misses++;
+        }
+    } else {
+        if (e->query != NULL) {
+            evicted = cache_entry_clear(e);
+            stats.evictions++;
+        }
+        stats.misses++;
+        e->query = strdup(query);
+        e->cl = cl;
+    }
+
+    if (e->query == NULL) {
+        thread_mutex_unlock(&cache_lock);
+        remove_trigger(evicted);
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    // A pending trigger still covers the entry, we only refresh the record
+    bool install = !e->watched;
+    e->watched = true;
+    e->written = false;
+    uintptr_t gen = e->gen;
+    thread_mutex_unlock(&cache_lock);
+
+    remove_trigger(evicted);
+
+    octopus_trigger_t t = NOP_TRIGGER;
+    if (install) {
+        t = oct_mktrigger(SYS_ERR_OK, octopus_BINDING_EVENT,
+                OCT_ON_SET | OCT_ON_DEL, cache_trigger_handler,
+                (void*) cache_token(idx, gen));
+    }
+
+    *data = NULL;
+    err = cl->call_seq.get(cl, query, t, data, &tid, &error_code);
+    if (err_is_ok(err)) {
+        err = error_code;
+    }
+
+    thread_mutex_lock(&cache_lock);
+    if (e->gen != gen) {
+        // Evicted or flushed while we were waiting for the reply
+        thread_mutex_unlock(&cache_lock);
+        remove_trigger((struct pending_trigger) { cl, tid });
+        return err;
+    }
+
+    if (install) {
+        e->tid = tid;
+        if (tid == 0) {
+            e->watched = false;
+        }
+    }
+
+    free(e->record);
+    e->record = NULL;
+    // If the trigger fired or the domain wrote the record in the meantime the
+    // reply may be outdated already
+    if (err_is_ok(err) && e->watched && !e->written) {
+        e->record = strdup(*data);
+        e->fetched = now;
+    }
+    thread_mutex_unlock(&cache_lock);
+
+    return err;
+}
+
+/*
+ * Finds the record name of a query, as scanned by the octopus parser.
+ * Returns false if the query does not name a single record (regular
+ * expressions, variables).
+ */
+static bool query_name(const char* query, const char** name, size_t* len)
+{
+    const char* p = query;
+    while (isspace((unsigned char) *p)) {
+        p++;
+    }
+
+    if (!islower((unsigned char) *p) || (p[0] == 'r' && p[1] == '\'')) {
+        return false;
+    }
+
+    const char* end = p + 1;
+    while (isalnum((unsigned char) *end) || *end == '.' || *end == '_'
+            || *end == '-') {
+        end++;
+    }
+
+    *name = p;
+    *len = end - p;
+    return true;
+}
+
+/**
+ * \brief Drops the cached records a local write or delete may change.
+ *
+ * Called after every set and del of the domain. If the written record is
+ * named, only the queries for that name and the queries not naming a record
+ * are dropped, otherwise all of them. The installed triggers stay, they are
+ * still needed to hear about writes of other domains.
+ *
+ * \param query Record or query sent to the server, NULL if unknown.
+ */
+void oct_cache_invalidate(const char* query)
+{
+    if (!enabled) {
+        return;
+    }
+
+    const char* name = NULL;
+    size_t len = 0;
+    bool named = query != NULL && query_name(query, &name, &len);
+
+    thread_mutex_lock(&cache_lock);
+    for (size_t i = 0; i < OCT_CACHE_SIZE; i++) {
+        struct cache_entry* e = &cache[i];
+        if (e->query == NULL) {
+            continue;
+        }
+
+        const char* ename;
+        size_t elen;
+        if (named && query_name(e->query, &ename, &elen)
+                && (elen != len || strncmp(ename, name, len) != 0)) {
+            continue;
+        }
+
+        if (e->record != NULL) {
+            stats.invalidations++;
+        }
+        free(e->record);
+        e->record = NULL;
+        e->written = true;
+    }
+    thread_mutex_unlock(&cache_lock);
+}
+
+/*
+ * Name service records are stored on the primary server.
+ */
+static errval_t nameservice_cache_get(char** data, const char* query)
+{
+    return oct_cache_get(oct_get_thc_client(), data, query);
+}
+
+static void cache_clear(void)
+{
+    struct pending_trigger tids[OCT_CACHE_SIZE];
+
+    thread_mutex_lock(&cache_lock);
+    for (size_t i = 0; i < OCT_CACHE_SIZE; i++) {
+        tids[i] = cache_entry_clear(&cache[i]);
+    }
+    thread_mutex_unlock(&cache_lock);
+
+    for (size_t i = 0; i < OCT_CACHE_SIZE; i++) {
+        remove_trigger(tids[i]);
+    }
+}
+
+/**
+ * \brief Enables the client-side cache for oct_get and nameservice_lookup.
+ *
+ * Records that are changed or deleted are dropped from the cache once the
+ * domain handles the trigger event. Independent of that, cached records are
+ * never served if they are older than max_staleness.
+ *
+ * \param max_staleness Maximum age of a cached record in microseconds.
+ *
+ * \retval SYS_ERR_OK
+ */
+errval_t oct_cache_enable(delayus_t max_staleness)
+{
+    // Invalidations arrive over the event binding
+    errval_t err = oct_init();
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    staleness_bound = max_staleness;
+    enabled = true;
+    nameservice_set_lookup_cache(nameservice_cache_get);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Disables the cache and drops all cached records.
+ */
+void oct_cache_disable(void)
+{
+    nameservice_set_lookup_cache(NULL);
+    enabled = false;
+    cache_clear();
+}
+
+/**
+ * \brief Drops all cached records.
+ */
+void oct_cache_flush(void)
+{
+    cache_clear();
+}
+
+/**
+ * \brief Returns the cache statistics since the domain started.
+ */
+void oct_cache_get_stats(struct oct_cache_stats* st)
+{
+    thread_mutex_lock(&cache_lock);
+    *st = stats;
+    thread_mutex_unlock(&cache_lock);
+}
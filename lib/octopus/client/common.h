@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (c) 2011, ETH Zurich.
+ * Copyright (c) 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -24,6 +24,7 @@
 #include <barrelfish/event_mutex.h>
 
 #include <octopus/definitions.h>
+#include <octopus/trigger.h>
 
 // TODO saw some TODOs in event_mutex_* so this will probably not work
 // as expected right now
@@ -65,4 +66,30 @@ static inline errval_t allocate_string(const char *fmt, va_list args,
     return SYS_ERR_OK;
 }
 
+struct octopus_thc_client_binding_t;
+
+// Client-side cache (cache.c)
+bool oct_cache_enabled(void);
+errval_t oct_cache_get(struct octopus_thc_client_binding_t* cl, char** data,
+        const char* query);
+void oct_cache_invalidate(const char* query);
+
+// Routing to the octopus shards (shards.c)
+errval_t oct_shards_init(void);
+struct octopus_thc_client_binding_t* oct_shard_client(size_t i);
+struct octopus_thc_client_binding_t* oct_shard_route(const char* query);
+struct octopus_thc_client_binding_t* oct_shard_route_index(const char* query,
+        size_t* shard);
+struct octopus_thc_client_binding_t* oct_shard_route_read(const char* query);
+void oct_shard_write_begin(const char* query);
+errval_t oct_get_names_on(struct octopus_thc_client_binding_t* cl,
+        char*** names, size_t* len, const char* query);
+
+// Watches spanning the shards (trigger.c)
+void oct_watches_attach(size_t shard);
+errval_t oct_trigger_existing_and_watch_on(
+        struct octopus_thc_client_binding_t* cl, const char* query,
+        trigger_handler_fn event_handler, void* state,
+        octopus_trigger_id_t* tid);
+
 #endif /* OCTOPUS_COMMON_H_ */
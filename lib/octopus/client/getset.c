@@ -7,7 +7,7 @@
  */
 
 /*
- * Copyright (c) 2011, 2012, ETH Zurich.
+ * Copyright (c) 2011, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include <barrelfish/barrelfish.h>
 
@@ -25,6 +26,7 @@
 #include <octopus/getset.h>
 #include <octopus/parser/ast.h>
 #include <octopus/trigger.h>
+#include <octopus/shards.h>
 #include <if/octopus_defs.h>
 #include <if/octopus_thc.h>
 
@@ -54,17 +56,79 @@ errval_t oct_get_names(char*** names, size_t* len, const char* query, ...)
     errval_t err = SYS_ERR_OK;
     va_list args;
 
-    char* data = NULL;
     char* buf = NULL;
     *len = 0;
 
     FORMAT_QUERY(query, args, buf); // buf
 
-    struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
+    struct octopus_thc_client_binding_t* cl = oct_shard_route(buf);
+    if (cl != NULL) {
+        err = oct_get_names_on(cl, names, len, buf);
+        free(buf);
+        return err;
+    }
 
-    errval_t error_code;
+    // Query does not name a record, collect the names from all shards
+    err = OCT_ERR_NO_RECORD;
+    *names = NULL;
+    for (size_t i = 0; i < oct_shard_count(); i++) {
+        char** part = NULL;
+        size_t part_len = 0;
+
+        cl = oct_shard_client(i);
+        if (cl == NULL) {
+            continue;
+        }
+
+        errval_t shard_err = oct_get_names_on(cl, &part, &part_len, buf);
+        if (err_no(shard_err) == OCT_ERR_NO_RECORD) {
+            continue;
+        }
+        if (err_is_fail(shard_err)) {
+            oct_free_names(*names, *len);
+            *names = NULL;
+            *len = 0;
+            err = shard_err;
+            break;
+        }
+        if (part_len == 0) {
+            free(part);
+            continue;
+        }
+
+        char** merged = realloc(*names, (*len + part_len) * sizeof(char*));
+        if (merged == NULL) {
+            oct_free_names(part, part_len);
+            oct_free_names(*names, *len);
+            *names = NULL;
+            *len = 0;
+            err = LIB_ERR_MALLOC_FAIL;
+            break;
+        }
+        memcpy(merged + *len, part, part_len * sizeof(char*));
+        free(part);
+
+        *names = merged;
+        *len += part_len;
+        err = SYS_ERR_OK;
+    }
+
+    free(buf);
+    return err;
+}
+
+/**
+ * \brief Like oct_get_names, but the query is sent to the given server.
+ */
+errval_t oct_get_names_on(struct octopus_thc_client_binding_t* cl,
+        char*** names, size_t* len, const char* query)
+{
+    errval_t err, error_code;
     octopus_trigger_id_t tid;
-    err = cl->call_seq.get_names(cl, buf, NOP_TRIGGER, &data,
+    char* data = NULL;
+    *len = 0;
+
+    err = cl->call_seq.get_names(cl, query, NOP_TRIGGER, &data,
             &tid, &error_code);
     if (err_is_ok(err)) {
         err = error_code;
@@ -75,14 +139,65 @@ errval_t oct_get_names(char*** names, size_t* len, const char* query, ...)
         //qsort(*names, *len, sizeof(char*), cmpstringp);
     }
 
-    free(buf);
     free(data);
     return err;
 }
 
+static errval_t get_record_on(struct octopus_thc_client_binding_t* cl,
+        char** data, const char* query)
+{
+    errval_t error_code;
+    errval_t err = SYS_ERR_OK;
+    octopus_trigger_id_t tid;
+
+    assert(cl != NULL);
+    err = cl->call_seq.get(cl, query, NOP_TRIGGER, data,
+            &tid, &error_code);
+
+    if (err_is_ok(err)) {
+        err = error_code;
+    }
+
+    return err;
+}
+
+static errval_t get_record(char** data, const char* query)
+{
+    errval_t err;
+
+    struct octopus_thc_client_binding_t* cl = oct_shard_route_read(query);
+    if (cl != NULL) {
+        err = get_record_on(cl, data, query);
+        if (err_no(err) == OCT_ERR_NO_RECORD && cl != oct_shard_route(query)) {
+            // Not mirrored yet
+            err = get_record_on(oct_shard_route(query), data, query);
+        }
+        return err;
+    }
+
+    // Any record matching the query will do
+    err = OCT_ERR_NO_RECORD;
+    for (size_t i = 0; i < oct_shard_count(); i++) {
+        cl = oct_shard_client(i);
+        if (cl == NULL) {
+            continue;
+        }
+
+        err = get_record_on(cl, data, query);
+        if (err_no(err) != OCT_ERR_NO_RECORD) {
+            break;
+        }
+    }
+
+    return err;
+}
+
 /**
  * \brief Gets one record matching the given query.
  *
+ * The record is served from the client-side cache if the cache
+ * is enabled (see oct_cache_enable).
+ *
  * \param[out] data Record returned by the server.
  * \param[in] query The query sent to the server.
  * \param ... Additional arguments to format the query using vsprintf.
@@ -96,24 +211,87 @@ errval_t oct_get_names(char*** names, size_t* len, const char* query, ...)
 errval_t oct_get(char** data, const char* query, ...)
 {
     assert(query != NULL);
-    errval_t error_code;
     errval_t err = SYS_ERR_OK;
-    octopus_trigger_id_t tid;
     va_list args;
 
     char* buf = NULL;
     FORMAT_QUERY(query, args, buf);
 
-    struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
-    assert(cl != NULL);
-    err = cl->call_seq.get(cl, buf, NOP_TRIGGER, data,
-            &tid, &error_code);
+    struct octopus_thc_client_binding_t* cl = oct_shard_route(buf);
+    if (oct_cache_enabled() && cl != NULL) {
+        err = oct_cache_get(cl, data, buf);
+    } else {
+        err = get_record(data, buf);
+    }
+
+    free(buf);
+    return err;
+}
+
+/**
+ * \brief Gets one record matching the given query, bypassing the cache.
+ *
+ * \param[out] data Record returned by the server.
+ * \param[in] query The query sent to the server.
+ * \param ... Additional arguments to format the query using vsprintf.
+ *
+ * \retval SYS_ERR_OK
+ * \retval OCT_ERR_NO_RECORD
+ * \retval OCT_ERR_PARSER_FAIL
+ * \retval OCT_ERR_ENGINE_FAIL
+ */
+errval_t oct_get_uncached(char** data, const char* query, ...)
+{
+    assert(query != NULL);
+    errval_t err = SYS_ERR_OK;
+    va_list args;
+
+    char* buf = NULL;
+    FORMAT_QUERY(query, args, buf);
+
+    err = get_record(data, buf);
+
+    free(buf);
+    return err;
+}
+
+/*
+ * Records are created on the shard owning their name. Queries without a
+ * name are rejected by the server, we leave that to the primary.
+ */
+static struct octopus_thc_client_binding_t* home_client(const char* query)
+{
+    struct octopus_thc_client_binding_t* cl = oct_shard_route(query);
+    return (cl != NULL) ? cl : oct_get_thc_client();
+}
 
+static errval_t del_record_on(struct octopus_thc_client_binding_t* cl,
+        const char* query)
+{
+    errval_t err, error_code;
+    octopus_trigger_id_t tid;
+
+    oct_shard_write_begin(query);
+    err = cl->call_seq.del(cl, query, NOP_TRIGGER, &tid, &error_code);
+    if (err_is_ok(err)) {
+        err = error_code;
+    }
+    oct_cache_invalidate(query);
+
+    return err;
+}
+
+static errval_t exists_on(struct octopus_thc_client_binding_t* cl,
+        const char* query)
+{
+    errval_t err, error_code;
+    octopus_trigger_id_t tid;
+
+    err = cl->call_seq.exists(cl, query, NOP_TRIGGER, &tid, &error_code);
     if (err_is_ok(err)) {
         err = error_code;
     }
 
-    free(buf);
     return err;
 }
 
@@ -138,11 +316,12 @@ errval_t oct_set(const char* query, ...)
     FORMAT_QUERY(query, args, buf);
 
     // Send to Server
-    struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
+    struct octopus_thc_client_binding_t* cl = home_client(buf);
 
     char* record = NULL;
     errval_t error_code;
     octopus_trigger_id_t tid;
+    oct_shard_write_begin(buf);
     err = cl->call_seq.set(cl, buf, SET_DEFAULT, NOP_TRIGGER, false,
             &record, &tid, &error_code);
     assert(record == NULL);
@@ -150,6 +329,7 @@ errval_t oct_set(const char* query, ...)
     if (err_is_ok(err)) {
         err = error_code;
     }
+    oct_cache_invalidate(buf);
 
     free(buf);
     return err;
@@ -177,11 +357,12 @@ errval_t oct_mset(oct_mode_t mode, const char* query, ...)
     FORMAT_QUERY(query, args, buf);
 
     // Send to Server
-    struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
+    struct octopus_thc_client_binding_t* cl = home_client(buf);
 
     char* record = NULL;
     errval_t error_code;
     octopus_trigger_id_t tid;
+    oct_shard_write_begin(buf);
     err = cl->call_seq.set(cl, buf, mode, NOP_TRIGGER, false,
             &record, &tid, &error_code);
     assert(record == NULL);
@@ -189,6 +370,7 @@ errval_t oct_mset(oct_mode_t mode, const char* query, ...)
     if (err_is_ok(err)) {
         err = error_code;
     }
+    oct_cache_invalidate(buf);
 
     free(buf);
     return err;
@@ -223,14 +405,16 @@ errval_t oct_set_get(oct_mode_t mode, char** record, const char* query, ...)
     FORMAT_QUERY(query, args, buf);
 
     // Send to Server
-    struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
+    struct octopus_thc_client_binding_t* cl = home_client(buf);
     errval_t error_code;
     octopus_trigger_id_t tid;
+    oct_shard_write_begin(buf);
     err = cl->call_seq.set(cl, buf, mode, NOP_TRIGGER, true, record,
             &tid, &error_code);
     if (err_is_ok(err)) {
         err = error_code;
     }
+    oct_cache_invalidate(buf);
 
     free(buf);
     return err;
@@ -302,6 +486,8 @@ errval_t oct_set_with_idcap(struct capref idcap, const char *attributes, ...)
     if (err_is_ok(err)) {
         err = error_code;
     }
+    // the record name is derived from the capability
+    oct_cache_invalidate(NULL);
 
     free(buf);
     return err;
@@ -330,12 +516,28 @@ errval_t oct_del(const char* query, ...)
     char* buf = NULL;
     FORMAT_QUERY(query, args, buf);
 
-    struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
-    errval_t error_code;
-    octopus_trigger_id_t tid;
-    err = cl->call_seq.del(cl, buf, NOP_TRIGGER, &tid, &error_code);
-    if (err_is_ok(err)) {
-        err = error_code;
+    struct octopus_thc_client_binding_t* cl = oct_shard_route(buf);
+    if (cl != NULL) {
+        err = del_record_on(cl, buf);
+        free(buf);
+        return err;
+    }
+
+    // Delete the matching records on all shards
+    err = OCT_ERR_NO_RECORD;
+    for (size_t i = 0; i < oct_shard_count(); i++) {
+        cl = oct_shard_client(i);
+        if (cl == NULL) {
+            continue;
+        }
+
+        errval_t shard_err = del_record_on(cl, buf);
+        if (err_no(shard_err) != OCT_ERR_NO_RECORD) {
+            err = shard_err;
+            if (err_is_fail(err)) {
+                break;
+            }
+        }
     }
 
     free(buf);
@@ -362,12 +564,27 @@ errval_t oct_exists(const char* query, ...)
     char* buf = NULL;
     FORMAT_QUERY(query, args, buf);
 
-    struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
-    errval_t error_code;
-    octopus_trigger_id_t tid;
-    err = cl->call_seq.exists(cl, buf, NOP_TRIGGER, &tid, &error_code);
-    if (err_is_ok(err)) {
-        err = error_code;
+    struct octopus_thc_client_binding_t* cl = oct_shard_route_read(buf);
+    if (cl != NULL) {
+        err = exists_on(cl, buf);
+        if (err_no(err) == OCT_ERR_NO_RECORD && cl != oct_shard_route(buf)) {
+            err = exists_on(oct_shard_route(buf), buf);
+        }
+        free(buf);
+        return err;
+    }
+
+    err = OCT_ERR_NO_RECORD;
+    for (size_t i = 0; i < oct_shard_count(); i++) {
+        cl = oct_shard_client(i);
+        if (cl == NULL) {
+            continue;
+        }
+
+        err = exists_on(cl, buf);
+        if (err_no(err) != OCT_ERR_NO_RECORD) {
+            break;
+        }
     }
 
     free(buf);
@@ -394,7 +611,7 @@ errval_t oct_wait_for(char** record, const char *query, ...)
     char* buf = NULL;
     FORMAT_QUERY(query, args, buf);
 
-    struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
+    struct octopus_thc_client_binding_t* cl = home_client(buf);
 
     errval_t error_code;
     err = cl->call_seq.wait_for(cl, buf, record, &error_code);
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2011, ETH Zurich.
+ * Copyright (c) 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -35,6 +35,7 @@
  * the queue is notified through triggers.
  *
  * \note Once a client holds the lock it can be released using oct_unlock.
+ * \note All records of a lock are stored on the same octopus shard.
  *
  * \param[in] lock_name Name to identify the lock.
  * \param[out] lock_record Your current lock record in the queue.
@@ -52,12 +53,20 @@ errval_t oct_lock(const char* lock_name, char** lock_record)
     size_t len = 0;
     size_t i = 0;
     bool found = false;
+    char* query = NULL;
     uint64_t mode = 0;
     uint64_t state = 0;
     uint64_t fn = 0;
     octopus_trigger_id_t tid;
     octopus_trigger_t t = oct_mktrigger(SYS_ERR_OK, octopus_BINDING_RPC,
             OCT_ON_DEL, NULL, NULL);
+    struct octopus_thc_client_binding_t* cl = oct_get_thc_client_for(lock_name);
+
+    query = malloc(strlen(lock_name) + sizeof("_ { lock: '' }"));
+    if (query == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    sprintf(query, "_ { lock: '%s' }", lock_name);
 
     err = oct_set_get(SET_SEQUENTIAL, lock_record, "%s_ { lock: '%s' }",
             lock_name, lock_name);
@@ -70,7 +79,7 @@ errval_t oct_lock(const char* lock_name, char** lock_record)
     }
 
     while (true) {
-        err = oct_get_names(&names, &len, "_ { lock: '%s' }", lock_name);
+        err = oct_get_names_on(cl, &names, &len, query);
         if (err_is_fail(err)) {
             goto out;
         }
@@ -92,7 +101,6 @@ errval_t oct_lock(const char* lock_name, char** lock_record)
         }
         else {
             // Someone else holds the lock
-            struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
             //printf("%s:%s:%d: does names[i-1] = %s exists\n",
             //       __FILE__, __FUNCTION__, __LINE__, names[i-1]);
             err = cl->call_seq.exists(cl, names[i-1], t, &tid, &exist_err);
@@ -123,6 +131,7 @@ errval_t oct_lock(const char* lock_name, char** lock_record)
 
 out:
     oct_free_names(names, len);
+    free(query);
     free(name);
     return err;
 }
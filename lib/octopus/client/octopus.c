@@ -7,7 +7,7 @@
  */
 
 /*
- * Copyright (c) 2011, ETH Zurich.
+ * Copyright (c) 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -234,5 +234,5 @@ errval_t oct_init(void)
         messages_wait_and_handle_next();
     }
 
-    return err;
+    return oct_shards_init();
 }
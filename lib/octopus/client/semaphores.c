@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2011, ETH Zurich.
+ * Copyright (c) 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -24,6 +24,18 @@
 
 #include "common.h"
 
+/*
+ * The records of semaphore id ("sem.<id>.<seq>") are stored on the shard
+ * of "sem.<id>".
+ */
+static struct octopus_thc_client_binding_t* sem_client(uint32_t id)
+{
+    char key[32];
+    snprintf(key, sizeof(key), "sem.%"PRIu32"", id);
+
+    return oct_get_thc_client_for(key);
+}
+
 static uint32_t get_next_id(void)
 {
     uint64_t id = 0;
@@ -37,7 +49,7 @@ static uint32_t get_next_id(void)
     errval_t err = oct_lock("sem.lock", &lock_record);
     assert(err_is_ok(err));
 
-    err = oct_get(&record, "sem.ids { current_id: _ }");
+    err = oct_get_uncached(&record, "sem.ids { current_id: _ }");
     if (err_is_ok(err)) {
         err = oct_read(record, "_ { current_id: %d }", &id);
         assert(err_is_ok(err));
@@ -92,7 +104,7 @@ errval_t oct_sem_wait(uint32_t id)
     octopus_trigger_id_t tid;
     octopus_trigger_t t = oct_mktrigger(OCT_ERR_NO_RECORD,
             octopus_BINDING_RPC, OCT_ON_SET, NULL, NULL);
-    struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
+    struct octopus_thc_client_binding_t* cl = sem_client(id);
 
     char query[100];
     snprintf(query, 99, "r'sem\\.%"PRIu32"\\.[0-9]+' { sem: %"PRIu32" }", id, id);
@@ -140,10 +152,19 @@ errval_t oct_sem_wait(uint32_t id)
 errval_t oct_sem_trywait(uint32_t id)
 {
     errval_t err = SYS_ERR_OK;
+    errval_t error_code;
+    octopus_trigger_id_t tid;
+    struct octopus_thc_client_binding_t* cl = sem_client(id);
 
     char* result = NULL;
 
-    err = oct_get(&result, "r'sem\\.%d\\.[0-9]+' { sem: %d }", id, id);
+    char query[100];
+    snprintf(query, 99, "r'sem\\.%"PRIu32"\\.[0-9]+' { sem: %"PRIu32" }", id, id);
+
+    err = cl->call_seq.get(cl, query, NOP_TRIGGER, &result, &tid, &error_code);
+    if (err_is_ok(err)) {
+        err = error_code;
+    }
     if (err_is_ok(err)) {
         err = oct_del(result);
     }
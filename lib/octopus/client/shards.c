@@ -0,0 +1,711 @@
+/**
+ * \file
+ * \brief Routing of requests to octopus shards.
+ *
+ * In a partitioned deployment the primary octopus server (the SKB on core
+ * 0, shard 0) is started with octopus_shards=N and additional servers with
+ * octopus_shard=1..N-1, one on the first core of every socket. Records are
+ * assigned to shards by hashing a key derived from their name:
+ *
+ *  - The key is the name without a trailing sequence number and its
+ *    separator. The sequential records "mylock_0", "mylock_1" created from
+ *    the base name "mylock_" all have the key "mylock", and
+ *    oct_get_thc_client_for("mylock") returns the shard of that key. This
+ *    is where locks, barriers and semaphores keep their records. Note that
+ *    the key of a record named "lock_3" is "lock", whereas the records of a
+ *    lock named "lock_3" ("lock_3_0", ...) have the key "lock_3".
+ *  - Names are scanned like the octopus parser does, including '-'.
+ *  - Records used while the cores running the shards are brought up, and
+ *    read-mostly records, are owned by the primary. The shards mirror the
+ *    read-mostly records and answer reads for them locally. After a domain
+ *    wrote such a record it reads it from the primary until the shard of
+ *    its socket applied the write.
+ *  - Queries that do not name a record (attribute queries, regular
+ *    expressions) go to all shards and the results are merged.
+ *  - Watches follow the same rules: a watch on a named record is installed
+ *    on the shard owning it, other watches on every shard (see
+ *    oct_trigger_existing_and_watch).
+ *
+ * Connections to the shards are set up when they are first needed. The
+ * name service records and the capability storage stay on the primary.
+ * Published messages are not records, publish and subscribe both go to the
+ * primary.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <string.h>
+#include <ctype.h>
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/threads.h>
+
+#include <octopus/init.h>
+#include <octopus/getset.h>
+#include <octopus/trigger.h>
+#include <octopus/shards.h>
+#include <if/octopus_defs.h>
+#include <if/octopus_thc.h>
+
+#include "handler.h"
+#include "common.h"
+
+/*
+ * Owned by the primary. The first two are read-mostly and mirrored by the
+ * shards, the others are used during boot.
+ */
+static const char* primary_prefixes[] = {
+    "hw.", "kcb.",
+    "octopus.", "acpi", "all_spawnds_up", "barrier.acpi", "corectrl.",
+    NULL
+};
+#define REPLICATED_PREFIXES 2
+
+struct oct_shard {
+    bool registered;            ///< Shard record seen on the primary
+    bool connected;
+    iref_t iref;
+    coreid_t core;
+    struct octopus_binding* rpc;
+    struct octopus_thc_client_binding_t thc_client;
+    struct octopus_binding* event;
+    bool is_done;
+    errval_t err;
+};
+
+static struct oct_shard shards[OCT_MAX_SHARDS];
+static size_t num_shards = 1;
+static size_t local_shard = 0;
+static struct thread_mutex shards_lock = THREAD_MUTEX_INITIALIZER;
+
+static bool has_prefix(const char* name, size_t len, const char* prefix)
+{
+    size_t plen = strlen(prefix);
+    return len >= plen && strncmp(name, prefix, plen) == 0;
+}
+
+static bool is_primary_key(const char* key, size_t len)
+{
+    for (size_t i = 0; primary_prefixes[i] != NULL; i++) {
+        if (has_prefix(key, len, primary_prefixes[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool is_replicated_name(const char* name, size_t len)
+{
+    for (size_t i = 0; i < REPLICATED_PREFIXES; i++) {
+        if (has_prefix(name, len, primary_prefixes[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * \brief Returns true if records with this name are mirrored by the shards.
+ */
+bool oct_is_replicated(const char* name)
+{
+    return is_replicated_name(name, strlen(name));
+}
+
+static inline bool is_separator(char c)
+{
+    return c == '_' || c == '.';
+}
+
+// IDENT in the octopus scanner
+static inline bool is_name_char(char c)
+{
+    return isalnum((unsigned char) c) || is_separator(c) || c == '-';
+}
+
+/*
+ * Finds the record name of a query. Returns false if the query does not name
+ * a single record (regular expressions, variables, attribute queries).
+ */
+static bool query_name(const char* query, const char** name, size_t* len)
+{
+    const char* p = query;
+    while (isspace((unsigned char) *p)) {
+        p++;
+    }
+
+    if (!isalpha((unsigned char) *p) || (p[0] == 'r' && p[1] == '\'')) {
+        return false;
+    }
+
+    const char* end = p;
+    while (is_name_char(*end)) {
+        end++;
+    }
+
+    *name = p;
+    *len = end - p;
+    return true;
+}
+
+/*
+ * Strips a trailing sequence number ("name_12") or the separator of a
+ * sequential base name ("name_"), giving the key of the record.
+ */
+static size_t key_length(const char* name, size_t len)
+{
+    size_t i = len;
+    while (i > 0 && isdigit((unsigned char) name[i-1])) {
+        i--;
+    }
+
+    if (i < len && i > 0 && is_separator(name[i-1])) {
+        return i - 1;
+    }
+    if (i == len && len > 0 && is_separator(name[len-1])) {
+        return len - 1;
+    }
+
+    return len;
+}
+
+// FNV-1a
+static uint32_t name_hash(const char* name, size_t len)
+{
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t) name[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+/*
+ * Only the first key_len characters of the name are hashed, records owned
+ * by the primary are recognized by the full name.
+ */
+static size_t shard_for_name(const char* name, size_t len, size_t key_len)
+{
+    if (num_shards == 1 || is_primary_key(name, len)) {
+        return 0;
+    }
+
+    return name_hash(name, key_len) % num_shards;
+}
+
+static void update_local_shard(void)
+{
+    coreid_t my_core = disp_get_core_id();
+    coreid_t best = 0;
+
+    local_shard = 0;
+    for (size_t i = 1; i < num_shards; i++) {
+        if (shards[i].registered && shards[i].core <= my_core &&
+                shards[i].core >= best) {
+            best = shards[i].core;
+            local_shard = i;
+        }
+    }
+}
+
+/*
+ * Reads the record the shard writes to the primary once it is up. If wait
+ * is set we block until it is there.
+ */
+static errval_t shard_lookup(size_t i, bool wait)
+{
+    errval_t err, error_code;
+    char* record = NULL;
+    char name[32];
+    octopus_trigger_id_t tid;
+
+    if (shards[i].registered) {
+        return SYS_ERR_OK;
+    }
+
+    snprintf(name, sizeof(name), OCT_SHARD_RECORD_FMT, i);
+
+    struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
+    if (wait) {
+        err = cl->call_seq.wait_for(cl, name, &record, &error_code);
+    } else {
+        err = cl->call_seq.get(cl, name, NOP_TRIGGER, &record, &tid,
+                &error_code);
+    }
+    if (err_is_ok(err)) {
+        err = error_code;
+    }
+    if (err_is_fail(err)) {
+        goto out;
+    }
+
+    uint64_t iref = 0, core = 0;
+    err = oct_read(record, "_ { iref: %d, core: %d }", &iref, &core);
+    if (err_is_fail(err)) {
+        goto out;
+    }
+
+    shards[i].iref = iref;
+    shards[i].core = core;
+    shards[i].registered = true;
+    update_local_shard();
+
+out:
+    free(record);
+    return err;
+}
+
+static void identify_response_handler(struct octopus_binding* b)
+{
+    struct oct_shard* shard = b->st;
+    shard->is_done = true;
+}
+
+static struct octopus_rx_vtbl event_rx_vtbl = {
+        .identify_response = identify_response_handler,
+        .subscription = subscription_handler,
+        .trigger = trigger_handler
+};
+
+static void event_bind_cb(void* st, errval_t err, struct octopus_binding* b)
+{
+    struct oct_shard* shard = st;
+
+    if (err_is_ok(err)) {
+        shard->event = b;
+        b->rx_vtbl = event_rx_vtbl;
+        b->st = shard;
+    }
+
+    shard->err = err;
+    shard->is_done = true;
+}
+
+/*
+ * Sets up the RPC and the event binding to a shard like oct_init does for
+ * the primary.
+ */
+static errval_t shard_connect(struct oct_shard* shard)
+{
+    errval_t err;
+    uint64_t id;
+
+    err = octopus_thc_connect(shard->iref, get_default_waitset(),
+            IDC_BIND_FLAGS_DEFAULT, &shard->rpc);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = octopus_thc_init_client(&shard->thc_client, shard->rpc, shard->rpc);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct octopus_thc_client_binding_t* cl = &shard->thc_client;
+    err = cl->call_seq.get_identifier(cl, &id);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    err = cl->call_seq.identify(cl, id, octopus_BINDING_RPC);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    shard->is_done = false;
+    err = octopus_bind(shard->iref, event_bind_cb, shard, get_default_waitset(),
+            IDC_BIND_FLAGS_DEFAULT);
+    if (err_is_fail(err)) {
+        return err_push(err, FLOUNDER_ERR_BIND);
+    }
+    while (!shard->is_done) {
+        messages_wait_and_handle_next();
+    }
+    if (err_is_fail(shard->err)) {
+        return shard->err;
+    }
+
+    shard->is_done = false;
+    err = shard->event->tx_vtbl.identify_call(shard->event, NOP_CONT, id,
+            octopus_BINDING_EVENT);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    while (!shard->is_done) {
+        messages_wait_and_handle_next();
+    }
+
+    shard->connected = true;
+    return SYS_ERR_OK;
+}
+
+/*
+ * Returns the client of shard i. If wait is not set and the shard has not
+ * registered yet NULL is returned, no records can be stored there yet.
+ */
+static struct octopus_thc_client_binding_t* get_shard_client(size_t i,
+        bool wait)
+{
+    errval_t err;
+    bool connected = false;
+
+    if (i == 0) {
+        return oct_get_thc_client();
+    }
+    if (shards[i].connected) {
+        return &shards[i].thc_client;
+    }
+
+    thread_mutex_lock(&shards_lock);
+    err = shard_lookup(i, wait);
+    if (err_is_ok(err) && !shards[i].connected) {
+        err = shard_connect(&shards[i]);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "connecting to octopus shard %zu", i);
+        }
+        connected = true;
+    }
+    thread_mutex_unlock(&shards_lock);
+
+    if (err_is_fail(err)) {
+        if (wait || err_no(err) != OCT_ERR_NO_RECORD) {
+            USER_PANIC_ERR(err, "looking up octopus shard %zu", i);
+        }
+        return NULL;
+    }
+
+    // The shard may hold records matching the watches installed so far
+    if (connected) {
+        oct_watches_attach(i);
+    }
+
+    return &shards[i].thc_client;
+}
+
+/**
+ * \brief Reads the number of shards from the primary.
+ *
+ * Called by oct_init. Without the shards record all requests go to the
+ * primary server.
+ */
+errval_t oct_shards_init(void)
+{
+    errval_t err, error_code;
+    char* record = NULL;
+    octopus_trigger_id_t tid;
+
+    struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
+    err = cl->call_seq.get(cl, OCT_SHARDS_RECORD, NOP_TRIGGER, &record, &tid,
+            &error_code);
+    if (err_is_ok(err)) {
+        err = error_code;
+    }
+    if (err_no(err) == OCT_ERR_NO_RECORD) {
+        return SYS_ERR_OK;
+    }
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    uint64_t count = 1;
+    err = oct_read(record, "_ { count: %d }", &count);
+    free(record);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    if (count == 0 || count > OCT_MAX_SHARDS) {
+        return OCT_ERR_ENGINE_FAIL;
+    }
+
+    num_shards = count;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Number of octopus shards, 1 if the deployment is not partitioned.
+ */
+size_t oct_shard_count(void)
+{
+    return num_shards;
+}
+
+/**
+ * \brief Returns the client of a shard for broadcast requests.
+ *
+ * \return NULL if the shard is not up yet and therefore has no records.
+ */
+struct octopus_thc_client_binding_t* oct_shard_client(size_t i)
+{
+    assert(i < num_shards);
+    return get_shard_client(i, false);
+}
+
+/**
+ * \brief Returns the client of the shard owning all records of the query.
+ *
+ * \return NULL if the query does not name a record and needs to be sent to
+ * all shards.
+ */
+struct octopus_thc_client_binding_t* oct_shard_route(const char* query)
+{
+    size_t shard;
+    return oct_shard_route_index(query, &shard);
+}
+
+/**
+ * \brief Like oct_shard_route, also returns the number of the shard.
+ */
+struct octopus_thc_client_binding_t* oct_shard_route_index(const char* query,
+        size_t* shard)
+{
+    const char* name;
+    size_t len;
+
+    *shard = 0;
+    if (num_shards == 1) {
+        return oct_get_thc_client();
+    }
+    if (!query_name(query, &name, &len)) {
+        return NULL;
+    }
+
+    *shard = shard_for_name(name, len, key_length(name, len));
+    return get_shard_client(*shard, true);
+}
+
+/*
+ * Replicated records written by this domain, read from the primary until
+ * the local shard applied the write. A one-shot trigger on the local shard,
+ * armed before the write is sent, tells us when that happened. If the name
+ * is written again while the trigger is armed it is re-armed when it fires;
+ * should the mirror have applied the second write in between, the name
+ * stays pending and is read from the primary, which is always up to date.
+ * Writes that find no free slot send all replicated reads to the primary
+ * until their triggers fired. Hashes may collide, which only costs locality.
+ */
+#define PENDING_WRITES      16
+#define PENDING_UNTRACKED   PENDING_WRITES
+#define PENDING_BITS        5
+
+struct pending_write {
+    uint32_t hash;              ///< Hash of the record name
+    uintptr_t gen;
+    bool used;
+    bool rewritten;             ///< Written again while the trigger is armed
+};
+
+static struct pending_write pending[PENDING_WRITES];
+static size_t pending_untracked;
+static struct thread_mutex pending_lock = THREAD_MUTEX_INITIALIZER;
+
+static inline uintptr_t pending_token(size_t idx, uintptr_t gen)
+{
+    return (gen << PENDING_BITS) | idx;
+}
+
+static void arm_replication_trigger(const char* name, uintptr_t token);
+
+static void replication_handler(octopus_mode_t mode, char* record,
+        void* state)
+{
+    uintptr_t token = (uintptr_t) state;
+    size_t idx = token & ((1 << PENDING_BITS) - 1);
+    char* name = NULL;
+
+    thread_mutex_lock(&pending_lock);
+    if (idx == PENDING_UNTRACKED) {
+        assert(pending_untracked > 0);
+        pending_untracked--;
+    } else if (pending[idx].used &&
+            pending_token(idx, pending[idx].gen) == token) {
+        struct pending_write* p = &pending[idx];
+        if (!p->rewritten) {
+            p->used = false;
+        } else {
+            // Without the name the write stays pending
+            const char* n;
+            size_t len;
+            if (record != NULL && query_name(record, &n, &len)) {
+                name = strndup(n, len);
+            }
+            if (name != NULL) {
+                p->rewritten = false;
+                p->gen++;
+                token = pending_token(idx, p->gen);
+            }
+        }
+    }
+    thread_mutex_unlock(&pending_lock);
+
+    if (name != NULL) {
+        arm_replication_trigger(name, token);
+        free(name);
+    }
+    free(record);
+}
+
+/*
+ * If the trigger can not be installed the write stays pending, reads go to
+ * the primary.
+ */
+static void arm_replication_trigger(const char* name, uintptr_t token)
+{
+    errval_t err, error_code;
+    octopus_trigger_id_t tid;
+
+    struct octopus_thc_client_binding_t* cl =
+            get_shard_client(local_shard, false);
+    if (cl == NULL) {
+        return;
+    }
+
+    octopus_trigger_t t = oct_mktrigger(SYS_ERR_OK, octopus_BINDING_EVENT,
+            OCT_ON_SET | OCT_ON_DEL | OCT_ALWAYS_SET, replication_handler,
+            (void*) token);
+    err = cl->call_seq.exists(cl, name, t, &tid, &error_code);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "watching the replication of %s", name);
+    }
+}
+
+static bool write_pending(const char* name, size_t len)
+{
+    uint32_t hash = name_hash(name, len);
+    bool found = false;
+
+    thread_mutex_lock(&pending_lock);
+    found = pending_untracked > 0;
+    for (size_t i = 0; i < PENDING_WRITES && !found; i++) {
+        found = pending[i].used && pending[i].hash == hash;
+    }
+    thread_mutex_unlock(&pending_lock);
+
+    return found;
+}
+
+/**
+ * \brief Called before a record is written, sends subsequent reads of a
+ * replicated record to the primary until the local shard has the write.
+ */
+void oct_shard_write_begin(const char* query)
+{
+    const char* name;
+    size_t len;
+
+    if (num_shards == 1 || local_shard == 0 ||
+            !query_name(query, &name, &len) ||
+            !is_replicated_name(name, len)) {
+        return;
+    }
+
+    uint32_t hash = name_hash(name, len);
+    struct pending_write* p = NULL;
+    uintptr_t token;
+
+    thread_mutex_lock(&pending_lock);
+    for (size_t i = 0; i < PENDING_WRITES; i++) {
+        if (pending[i].used && pending[i].hash == hash) {
+            // The armed trigger is re-armed when it fires
+            pending[i].rewritten = true;
+            thread_mutex_unlock(&pending_lock);
+            return;
+        }
+        if (!pending[i].used && p == NULL) {
+            p = &pending[i];
+        }
+    }
+    if (p != NULL) {
+        p->used = true;
+        p->hash = hash;
+        p->rewritten = false;
+        p->gen++;
+        token = pending_token(p - pending, p->gen);
+    } else {
+        pending_untracked++;
+        token = PENDING_UNTRACKED;
+    }
+    thread_mutex_unlock(&pending_lock);
+
+    char* n = strndup(name, len);
+    if (n == NULL) {
+        return;
+    }
+    arm_replication_trigger(n, token);
+    free(n);
+}
+
+/**
+ * \brief Like oct_shard_route, but replicated records are read from the
+ * shard of the local socket unless this domain wrote them recently.
+ */
+struct octopus_thc_client_binding_t* oct_shard_route_read(const char* query)
+{
+    const char* name;
+    size_t len;
+
+    if (num_shards > 1 && query_name(query, &name, &len) &&
+            is_primary_key(name, len) && is_replicated_name(name, len) &&
+            local_shard != 0 && !write_pending(name, len)) {
+        return get_shard_client(local_shard, false);
+    }
+
+    return oct_shard_route(query);
+}
+
+/**
+ * \brief Returns the client of the shard that stores the records of a lock,
+ * barrier or semaphore.
+ *
+ * The records are created from the base name "<key>_", so oct_shard_route
+ * sends them to the shard returned here.
+ *
+ * \param key Name of the lock, barrier or semaphore. In contrast to the
+ * record names, the key is used as it is.
+ */
+struct octopus_thc_client_binding_t* oct_get_thc_client_for(const char* key)
+{
+    size_t len = strlen(key);
+    return get_shard_client(shard_for_name(key, len, len), true);
+}
+
+/**
+ * \brief Calls fn for all replicated records on the primary and for every
+ * change to them.
+ *
+ * Used by the shards to keep their copy of the read-mostly records.
+ */
+errval_t oct_shard_mirror(trigger_handler_fn fn, void* state)
+{
+    errval_t err = SYS_ERR_OK;
+
+    for (size_t i = 0; i < REPLICATED_PREFIXES; i++) {
+        // Match the names starting with the prefix, dots are escaped
+        char query[64] = "r'^";
+        size_t pos = strlen(query);
+        for (const char* c = primary_prefixes[i]; *c != '\0'; c++) {
+            if (*c == '.') {
+                query[pos++] = '\\';
+            }
+            query[pos++] = *c;
+        }
+        strcpy(query + pos, ".*'");
+
+        octopus_trigger_id_t tid;
+        err = oct_trigger_existing_and_watch_on(oct_get_thc_client(), query,
+                fn, state, &tid);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    return err;
+}
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2011, ETH Zurich.
+ * Copyright (c) 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -20,6 +20,7 @@
 #include <octopus/init.h>
 #include <octopus/getset.h>
 #include <octopus/trigger.h>
+#include <octopus/shards.h>
 #include <if/octopus_defs.h>
 #include <if/octopus_thc.h>
 
@@ -58,26 +59,50 @@ octopus_trigger_t oct_mktrigger(errval_t in_case, octopus_binding_type_t send_to
             };
 }
 
-/**
- * \brief Removes a trigger in the octopus server.
- *
- * In any case a valid watch id is specified this
- * causes a trigger event to be sent with the
- * OCT_REMOVED flag set. After this event it's safe
- * to clean up any memory associated with the event handler.
- *
- * \param trigger_id ID of trigger we want to remove
- *
- * \retval SYS_ERR_OK
- * \retval OCT_INVALID_ID
+/*
+ * Trigger ids of watches on shard i > 0 carry the shard in the top bits, the
+ * servers hand out small ids.
  */
-errval_t oct_remove_trigger(octopus_trigger_id_t trigger_id)
+#define TID_SHARD_SHIFT 56
+#define TID_MASK        ((1ULL << TID_SHARD_SHIFT) - 1)
+
+static inline octopus_trigger_id_t tid_encode(size_t shard,
+        octopus_trigger_id_t tid)
 {
-    errval_t err = SYS_ERR_OK;
-    struct octopus_thc_client_binding_t* cl = oct_get_thc_client();
-    assert(cl != NULL);
+    assert(tid <= TID_MASK);
+    return ((octopus_trigger_id_t) shard << TID_SHARD_SHIFT) | tid;
+}
 
-    errval_t error_code;
+#define WATCH_NONE          0
+#define WATCH_INSTALLING    1
+#define WATCH_INSTALLED     2
+
+/*
+ * A watch whose query does not name a record is installed on every shard,
+ * including the shards that come up later. It is identified by its trigger
+ * id on the primary.
+ */
+struct wildcard_watch {
+    struct wildcard_watch* next;
+    char* query;
+    octopus_trigger_t trigger;
+    trigger_handler_fn handler;
+    void* st;
+    uint8_t shard_state[OCT_MAX_SHARDS];
+    octopus_trigger_id_t tids[OCT_MAX_SHARDS];
+    size_t busy;                ///< Installs in flight
+    bool removed;
+};
+
+static struct wildcard_watch* wildcard_watches = NULL;
+static struct thread_mutex watches_lock = THREAD_MUTEX_INITIALIZER;
+
+static errval_t remove_trigger_on(struct octopus_thc_client_binding_t* cl,
+        octopus_trigger_id_t trigger_id)
+{
+    errval_t err, error_code;
+
+    assert(cl != NULL);
     err = cl->call_seq.remove_trigger(cl, trigger_id, &error_code);
     if (err_is_ok(err)) {
         err = error_code;
@@ -86,36 +111,27 @@ errval_t oct_remove_trigger(octopus_trigger_id_t trigger_id)
     return err;
 }
 
-/**
- * Watches for a query of records and calls the trigger function for
- * all records found and subsequent records registered.
- *
- * \param[in]  query         Records to watch for.
- * \param[in]  event_handler Handler function to call.
- * \param[in]  state         Additional state for handler function
- * \param[out] tid           Trigger id.
- * \retval SYS_ERR_OK        Trigger registered, handler fn called for all
- *                           current records.
+/*
+ * Installs the trigger on one server and calls the handler for the records
+ * stored there that match the query. installed is set if the server got the
+ * trigger, TRIGGER_ALWAYS is installed whatever the query returns.
  */
-errval_t oct_trigger_existing_and_watch(const char* query,
-        trigger_handler_fn event_handler, void* state,
-        octopus_trigger_id_t* tid)
+static errval_t watch_on(struct octopus_thc_client_binding_t* cl,
+        const char* query, octopus_trigger_t t, trigger_handler_fn handler,
+        void* state, octopus_trigger_id_t* tid, bool* installed)
 {
     errval_t error_code;
     char** names = NULL;
     char* output = NULL;
-    char* record = NULL; // freed by cpu_change_event
     size_t len = 0;
-    octopus_trigger_t t = oct_mktrigger(0, octopus_BINDING_EVENT,
-            TRIGGER_ALWAYS, event_handler, state);
 
-    // Get current cores registered in system
-    struct octopus_thc_client_binding_t* rpc = oct_get_thc_client();
-    errval_t err = rpc->call_seq.get_names(rpc, query,
-            t, &output, tid, &error_code);
+    *installed = false;
+    errval_t err = cl->call_seq.get_names(cl, query, t, &output, tid,
+            &error_code);
     if (err_is_fail(err)) {
         goto out;
     }
+    *installed = true;
     err = error_code;
 
     switch(err_no(err)) {
@@ -126,20 +142,26 @@ errval_t oct_trigger_existing_and_watch(const char* query,
         }
 
         for (size_t i=0; i < len; i++) {
-            err = oct_get(&record, names[i]);
+            char* record = NULL; // freed by the handler
+            octopus_trigger_id_t get_tid;
+            err = cl->call_seq.get(cl, names[i], NOP_TRIGGER, &record,
+                    &get_tid, &error_code);
+            if (err_is_ok(err)) {
+                err = error_code;
+            }
 
             switch (err_no(err)) {
             case SYS_ERR_OK:
-                event_handler(OCT_ON_SET, record, state);
+                handler(OCT_ON_SET, record, state);
                 break;
 
             case OCT_ERR_NO_RECORD:
-                assert(record == NULL);
+                free(record);
                 break;
 
             default:
-                DEBUG_ERR(err, "Unable to retrieve core record for %s", names[i]);
-                assert(record == NULL);
+                DEBUG_ERR(err, "Unable to retrieve record for %s", names[i]);
+                free(record);
                 break;
             }
         }
@@ -159,3 +181,263 @@ out:
 
     return err;
 }
+
+static void wildcard_free(struct wildcard_watch* w)
+{
+    free(w->query);
+    free(w);
+}
+
+/*
+ * Marks the watch as being installed on the shard. Called with watches_lock
+ * held, returns false if there is nothing to do.
+ */
+static bool wildcard_claim(struct wildcard_watch* w, size_t shard)
+{
+    if (w->removed || w->shard_state[shard] != WATCH_NONE) {
+        return false;
+    }
+
+    w->shard_state[shard] = WATCH_INSTALLING;
+    w->busy++;
+    return true;
+}
+
+/*
+ * Installs a claimed watch on the shard. The watch may be removed while the
+ * request is in flight, the last one to let go of it frees it.
+ */
+static errval_t wildcard_install(struct wildcard_watch* w, size_t shard,
+        struct octopus_thc_client_binding_t* cl)
+{
+    octopus_trigger_id_t tid = 0;
+    bool installed;
+
+    errval_t err = watch_on(cl, w->query, w->trigger, w->handler, w->st, &tid,
+            &installed);
+
+    thread_mutex_lock(&watches_lock);
+    w->tids[shard] = tid;
+    w->shard_state[shard] = installed ? WATCH_INSTALLED : WATCH_NONE;
+    w->busy--;
+    bool removed = w->removed;
+    bool last = removed && w->busy == 0;
+    thread_mutex_unlock(&watches_lock);
+
+    if (removed && installed) {
+        remove_trigger_on(cl, tid);
+    }
+    if (last) {
+        wildcard_free(w);
+    }
+
+    return err;
+}
+
+static errval_t watch_wildcard(const char* query, octopus_trigger_t t,
+        trigger_handler_fn handler, void* state, octopus_trigger_id_t* tid)
+{
+    errval_t err;
+    bool installed;
+
+    struct wildcard_watch* w = calloc(1, sizeof(struct wildcard_watch));
+    if (w == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    w->query = strdup(query);
+    if (w->query == NULL) {
+        free(w);
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    w->trigger = t;
+    w->handler = handler;
+    w->st = state;
+
+    // The primary is always up, its trigger id identifies the watch
+    err = watch_on(oct_get_thc_client(), query, t, handler, state,
+            &w->tids[0], &installed);
+    if (!installed) {
+        wildcard_free(w);
+        return err;
+    }
+    w->shard_state[0] = WATCH_INSTALLED;
+    *tid = w->tids[0];
+
+    thread_mutex_lock(&watches_lock);
+    w->next = wildcard_watches;
+    wildcard_watches = w;
+    thread_mutex_unlock(&watches_lock);
+
+    // Shards that come up later get the watch in oct_watches_attach
+    for (size_t i = 1; i < oct_shard_count(); i++) {
+        struct octopus_thc_client_binding_t* cl = oct_shard_client(i);
+        if (cl == NULL) {
+            continue;
+        }
+
+        thread_mutex_lock(&watches_lock);
+        bool claimed = wildcard_claim(w, i);
+        thread_mutex_unlock(&watches_lock);
+
+        if (claimed) {
+            errval_t shard_err = wildcard_install(w, i, cl);
+            if (err_is_ok(err)) {
+                err = shard_err;
+            }
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Installs the watches that do not name a record on a shard that
+ * just came up.
+ *
+ * Called once per shard when the connection to it is set up.
+ */
+void oct_watches_attach(size_t shard)
+{
+    struct octopus_thc_client_binding_t* cl = oct_shard_client(shard);
+    assert(cl != NULL);
+
+    for (;;) {
+        struct wildcard_watch* w;
+
+        thread_mutex_lock(&watches_lock);
+        for (w = wildcard_watches; w != NULL; w = w->next) {
+            if (wildcard_claim(w, shard)) {
+                break;
+            }
+        }
+        thread_mutex_unlock(&watches_lock);
+
+        if (w == NULL) {
+            break;
+        }
+
+        errval_t err = wildcard_install(w, shard, cl);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "installing watch %s on octopus shard %zu",
+                    w->query, shard);
+        }
+    }
+}
+
+/**
+ * \brief Removes a trigger in the octopus server.
+ *
+ * In any case a valid watch id is specified this
+ * causes a trigger event to be sent with the
+ * OCT_REMOVED flag set. After this event it's safe
+ * to clean up any memory associated with the event handler.
+ *
+ * A watch installed on several shards by oct_trigger_existing_and_watch is
+ * removed from all of them, each sends its OCT_REMOVED event.
+ *
+ * \param trigger_id ID of trigger we want to remove
+ *
+ * \retval SYS_ERR_OK
+ * \retval OCT_INVALID_ID
+ */
+errval_t oct_remove_trigger(octopus_trigger_id_t trigger_id)
+{
+    errval_t err = SYS_ERR_OK;
+    size_t shard = trigger_id >> TID_SHARD_SHIFT;
+
+    if (shard != 0) {
+        return remove_trigger_on(oct_shard_client(shard),
+                trigger_id & TID_MASK);
+    }
+
+    octopus_trigger_id_t tids[OCT_MAX_SHARDS];
+    bool installed[OCT_MAX_SHARDS] = { false };
+    bool last = false;
+
+    thread_mutex_lock(&watches_lock);
+    struct wildcard_watch** pw = &wildcard_watches;
+    while (*pw != NULL && (*pw)->tids[0] != trigger_id) {
+        pw = &(*pw)->next;
+    }
+    struct wildcard_watch* w = *pw;
+    if (w != NULL) {
+        *pw = w->next;
+        w->removed = true;
+        for (size_t i = 1; i < OCT_MAX_SHARDS; i++) {
+            // Installs in flight remove their trigger when they are done
+            installed[i] = (w->shard_state[i] == WATCH_INSTALLED);
+            tids[i] = w->tids[i];
+        }
+        last = (w->busy == 0);
+    }
+    thread_mutex_unlock(&watches_lock);
+
+    err = remove_trigger_on(oct_get_thc_client(), trigger_id);
+
+    for (size_t i = 1; i < OCT_MAX_SHARDS; i++) {
+        if (installed[i]) {
+            errval_t shard_err = remove_trigger_on(oct_shard_client(i),
+                    tids[i]);
+            if (err_is_ok(err)) {
+                err = shard_err;
+            }
+        }
+    }
+    if (last) {
+        wildcard_free(w);
+    }
+
+    return err;
+}
+
+/**
+ * Watches for a query of records and calls the trigger function for
+ * all records found and subsequent records registered.
+ *
+ * A query naming a record is watched on the shard owning the record, other
+ * queries on every shard, including shards that come up later.
+ *
+ * \param[in]  query         Records to watch for.
+ * \param[in]  event_handler Handler function to call.
+ * \param[in]  state         Additional state for handler function
+ * \param[out] tid           Trigger id.
+ * \retval SYS_ERR_OK        Trigger registered, handler fn called for all
+ *                           current records.
+ */
+errval_t oct_trigger_existing_and_watch(const char* query,
+        trigger_handler_fn event_handler, void* state,
+        octopus_trigger_id_t* tid)
+{
+    octopus_trigger_t t = oct_mktrigger(0, octopus_BINDING_EVENT,
+            TRIGGER_ALWAYS, event_handler, state);
+
+    size_t shard;
+    struct octopus_thc_client_binding_t* cl = oct_shard_route_index(query,
+            &shard);
+    if (cl == NULL) {
+        return watch_wildcard(query, t, event_handler, state, tid);
+    }
+
+    bool installed;
+    errval_t err = watch_on(cl, query, t, event_handler, state, tid,
+            &installed);
+    *tid = tid_encode(shard, *tid);
+
+    return err;
+}
+
+/**
+ * \brief Like oct_trigger_existing_and_watch, but the watch is installed on
+ * the given server only.
+ */
+errval_t oct_trigger_existing_and_watch_on(
+        struct octopus_thc_client_binding_t* cl, const char* query,
+        trigger_handler_fn event_handler, void* state,
+        octopus_trigger_id_t* tid)
+{
+    octopus_trigger_t t = oct_mktrigger(0, octopus_BINDING_EVENT,
+            TRIGGER_ALWAYS, event_handler, state);
+
+    bool installed;
+    return watch_on(cl, query, t, event_handler, state, tid, &installed);
+}
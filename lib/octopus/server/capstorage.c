@@ -32,11 +32,16 @@
 #include <octopus_server/service.h>
 #include <octopus_server/debug.h>
 
-#include <hashtable/hashtable.h>
+#include <collections/hash_map.h>
 
 #include "queue.h"
 
-static struct hashtable *capdb = NULL;
+static collections_hash_map *capdb = NULL;
+
+static struct capref *capdb_get(const char *key)
+{
+    return collections_hash_map_find_bytes(capdb, key, strlen(key));
+}
 
 static void get_cap_reply(struct octopus_binding *b,
         struct oct_reply_state* ns)
@@ -56,12 +61,13 @@ static void get_cap_reply(struct octopus_binding *b,
 void get_cap_handler(struct octopus_binding *b, char *key)
 {
     errval_t err, reterr = SYS_ERR_OK;
-    struct capref cap;
+    struct capref cap = NULL_CAP;
 
-    capdb->d.get_capability(&capdb->d, key, &cap);
-
-    if(capcmp(cap, NULL_CAP)) {
+    struct capref *dbcap = capdb_get(key);
+    if (dbcap == NULL) {
         reterr = OCT_ERR_CAP_NAME_UNKNOWN;
+    } else {
+        cap = *dbcap;
     }
 
     struct oct_reply_state* ns = NULL;
@@ -93,16 +99,19 @@ void put_cap_handler(struct octopus_binding *b, char *key,
                             struct capref cap)
 {
     errval_t err, reterr = SYS_ERR_OK;
-    struct capref dbcap;
 
-    capdb->d.get_capability(&capdb->d, key, &dbcap);
-    if(!capcmp(dbcap, NULL_CAP)) {
+    if (capdb_get(key) != NULL) {
         reterr = OCT_ERR_CAP_OVERWRITE;
         err = cap_delete(cap);
         assert(err_is_ok(err));
         free(key);
     } else {
-        int r = capdb->d.put_capability(&capdb->d, key, cap);
+        struct capref *dbcap = malloc(sizeof(struct capref));
+        assert(dbcap != NULL);
+        *dbcap = cap;
+        // the map takes ownership of key
+        int r = collections_hash_map_insert_bytes(capdb, key, strlen(key),
+                                                  dbcap);
         assert(r == 0);
     }
 
@@ -132,14 +141,13 @@ void remove_cap_handler(struct octopus_binding *b, char *key)
 {
     errval_t err, reterr = SYS_ERR_OK;
 
-    struct capref cap;
-    capdb->d.get_capability(&capdb->d, key, &cap);
-    if(capcmp(cap, NULL_CAP)) {
+    struct capref *dbcap = capdb_get(key);
+    if (dbcap == NULL) {
         reterr = OCT_ERR_CAP_NAME_UNKNOWN;
     }
     else {
-        cap_delete(cap);
-        capdb->d.remove(&capdb->d, key, strlen(key));
+        cap_delete(*dbcap);
+        collections_hash_map_delete_bytes(capdb, key, strlen(key));
     }
 
     struct oct_reply_state* ns = NULL;
@@ -153,7 +161,8 @@ void remove_cap_handler(struct octopus_binding *b, char *key)
 
 errval_t init_capstorage(void)
 {
-    capdb = create_hashtable();
+    collections_hash_map_create(&capdb, COLLECTIONS_HASH_MAP_KEY_BYTES, 0,
+                                free, free);
     assert(capdb != NULL);
 
     return SYS_ERR_OK;
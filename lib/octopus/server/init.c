@@ -6,7 +6,7 @@
  */
 
 /*
- * Copyright (c) 2011, 2012, ETH Zurich.
+ * Copyright (c) 2011, 2012, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -29,6 +29,8 @@
 static struct export_state {
     bool is_done;
     errval_t err;
+    bool is_primary;    ///< Register the iref with the monitor
+    iref_t iref;
 } rpc_export;
 
 static const struct octopus_rx_vtbl rpc_rx_vtbl = {
@@ -59,8 +61,9 @@ static void rpc_export_cb(void *st, errval_t err, iref_t iref)
 {
     rpc_export.is_done = true;
     rpc_export.err = err;
+    rpc_export.iref = iref;
 
-    if (err_is_ok(err)) {
+    if (err_is_ok(err) && rpc_export.is_primary) {
         struct monitor_binding *mb = get_monitor_binding();
         OCT_DEBUG("octopus rpc iref is: %"PRIu32"\n", iref);
         err = mb->tx_vtbl.set_name_iref_request(mb, NOP_CONT, iref);
@@ -82,10 +85,11 @@ static errval_t rpc_connect_cb(void *st, struct octopus_binding *b)
     return SYS_ERR_OK;
 }
 
-errval_t rpc_server_init(void)
+static errval_t rpc_export_service(bool is_primary)
 {
     rpc_export.err = SYS_ERR_OK;
     rpc_export.is_done = false;
+    rpc_export.is_primary = is_primary;
 
     errval_t err = octopus_export(&rpc_export, rpc_export_cb, rpc_connect_cb,
             get_default_waitset(), IDC_EXPORT_FLAGS_DEFAULT);
@@ -102,6 +106,28 @@ errval_t rpc_server_init(void)
     return rpc_export.err;
 }
 
+errval_t rpc_server_init(void)
+{
+    return rpc_export_service(true);
+}
+
+/**
+ * \brief Exports the octopus interface of a shard.
+ *
+ * Unlike the primary server, the shard is not registered with the monitor.
+ *
+ * \param[out] iref Iref of the exported service.
+ */
+errval_t rpc_shard_server_init(iref_t* iref)
+{
+    errval_t err = rpc_export_service(false);
+    if (err_is_ok(err)) {
+        *iref = rpc_export.iref;
+    }
+
+    return err;
+}
+
 /**
  * \brief Sets up bindings for the octopus server and registers them in the
  * nameserver.
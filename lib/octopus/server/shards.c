@@ -0,0 +1,131 @@
+/**
+ * \file
+ * \brief Setup of the octopus shards.
+ *
+ * A shard is an additional octopus server holding the records hashed to it
+ * (see lib/octopus/client/shards.c). The read-mostly records owned by the
+ * primary server are mirrored to every shard using a watch on the primary.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+
+#include <barrelfish/barrelfish.h>
+
+#include <if/octopus_defs.h>
+
+#include <octopus/init.h>
+#include <octopus/getset.h>
+#include <octopus/trigger.h>
+#include <octopus/shards.h>
+#include <octopus_server/init.h>
+#include <octopus_server/query.h>
+#include <octopus_server/debug.h>
+
+/*
+ * Stores or deletes a record in the local database, triggers installed by
+ * clients of this shard fire as usual.
+ */
+static errval_t store_record(const char* record, bool delete)
+{
+    errval_t err;
+    struct ast_object* ast = NULL;
+
+    // Large buffers, keep them off the stack
+    struct oct_query_state* qs = calloc(1, sizeof(struct oct_query_state));
+    if (qs == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    err = generate_ast(record, &ast);
+    if (err_is_ok(err)) {
+        if (delete) {
+            err = del_record(ast, qs);
+        } else {
+            err = set_record(ast, SET_DEFAULT, qs);
+        }
+    }
+
+    free_ast(ast);
+    free(qs);
+    return err;
+}
+
+static void mirror_handler(octopus_mode_t mode, char* record, void* state)
+{
+    errval_t err = SYS_ERR_OK;
+
+    if (record != NULL) {
+        OCT_DEBUG("mirror %s: %s\n", (mode & OCT_ON_DEL) ? "del" : "set",
+                record);
+        err = store_record(record, mode & OCT_ON_DEL);
+        if (err_is_fail(err) && err_no(err) != OCT_ERR_NO_RECORD) {
+            DEBUG_ERR(err, "mirroring record %s", record);
+        }
+    }
+
+    free(record);
+}
+
+/**
+ * \brief Publishes the number of shards including the primary.
+ *
+ * Called by the primary server before it accepts connections, clients read
+ * the count in oct_init.
+ */
+errval_t oct_server_set_shard_count(size_t count)
+{
+    char record[64];
+
+    if (count == 0 || count > OCT_MAX_SHARDS) {
+        return OCT_ERR_ENGINE_FAIL;
+    }
+
+    snprintf(record, sizeof(record), OCT_SHARDS_RECORD " { count: %zu }",
+            count);
+    return store_record(record, false);
+}
+
+/**
+ * \brief Starts octopus shard number shard.
+ *
+ * Connects to the primary server, mirrors the replicated records, exports
+ * the octopus interface and registers the shard with the primary.
+ *
+ * \retval SYS_ERR_OK
+ */
+errval_t oct_shard_server_init(size_t shard)
+{
+    errval_t err;
+    iref_t iref;
+
+    assert(shard > 0 && shard < OCT_MAX_SHARDS);
+
+    err = oct_init();
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = oct_shard_mirror(mirror_handler, NULL);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = rpc_shard_server_init(&iref);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    // Clients look for this record to find the shard, the octopus.*
+    // records are always stored on the primary
+    return oct_set(OCT_SHARD_RECORD_FMT " { iref: %"PRIuIREF", core: %"
+            PRIuCOREID" }", shard, iref, disp_get_core_id());
+}
@@ -0,0 +1,365 @@
+/**
+ * \file
+ * \brief Vectorised copy and Internet checksum kernels for packet data
+ *
+ * The vector kernels use GCC vector extensions rather than intrinsics, as
+ * our compiler flags do not give us the intrinsics headers. The AVX2
+ * variants are compiled with a function-level target attribute, so the rest
+ * of the library stays baseline x86_64 and they are only ever called after
+ * CPUID said it is safe to do so.
+ */
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include <pktcopy/pktcopy.h>
+
+#if defined(__x86_64__) && !defined(__k1om__)
+#include <barrelfish/barrelfish.h>
+#include <cpuid/cpuid.h>
+#define PKTCOPY_X86
+#endif
+
+// unaligned, aliasing scalar accesses
+typedef uint64_t u64_una __attribute__((aligned(1), may_alias));
+typedef uint16_t u16_una __attribute__((aligned(1), may_alias));
+
+/*
+ * 64-bit one's complement partial sums. Adding 16-bit words modulo 0xffff
+ * is the same as adding any wider multiple of them with end-around carry,
+ * so the final fold gives the same result as the 16-bit reference loop.
+ */
+static inline uint64_t csum_add(uint64_t sum, uint64_t v)
+{
+    sum += v;
+    return sum + (sum < v);
+}
+
+static inline uint16_t csum_fold(uint64_t sum)
+{
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+// a dangling last byte is the first byte of a 16-bit word
+static inline uint64_t csum_last_byte(uint8_t b)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return b;
+#else
+    return (uint64_t)b << 8;
+#endif
+}
+
+/*
+ * Partial sum of a buffer whose offset from the start of the checksummed
+ * data is even.
+ */
+static uint64_t csum_partial(const uint8_t *p, size_t len, uint64_t sum)
+{
+    for (; len >= 32; p += 32, len -= 32) {
+        sum = csum_add(sum, *(const u64_una *)p);
+        sum = csum_add(sum, *(const u64_una *)(p + 8));
+        sum = csum_add(sum, *(const u64_una *)(p + 16));
+        sum = csum_add(sum, *(const u64_una *)(p + 24));
+    }
+    for (; len >= 8; p += 8, len -= 8) {
+        sum = csum_add(sum, *(const u64_una *)p);
+    }
+    for (; len >= 2; p += 2, len -= 2) {
+        sum = csum_add(sum, *(const u16_una *)p);
+    }
+    if (len > 0) {
+        sum = csum_add(sum, csum_last_byte(*p));
+    }
+    return sum;
+}
+
+static uint64_t copy_csum_partial(uint8_t *d, const uint8_t *s, size_t len,
+                                  uint64_t sum)
+{
+    for (; len >= 8; d += 8, s += 8, len -= 8) {
+        uint64_t v = *(const u64_una *)s;
+        *(u64_una *)d = v;
+        sum = csum_add(sum, v);
+    }
+    for (; len >= 2; d += 2, s += 2, len -= 2) {
+        uint16_t v = *(const u16_una *)s;
+        *(u16_una *)d = v;
+        sum = csum_add(sum, v);
+    }
+    if (len > 0) {
+        *d = *s;
+        sum = csum_add(sum, csum_last_byte(*s));
+    }
+    return sum;
+}
+
+/*
+ * Portable implementation
+ */
+
+static void *generic_memcpy(void *dst, const void *src, size_t len)
+{
+    return memcpy(dst, src, len);
+}
+
+static uint16_t generic_chksum(const void *data, size_t len)
+{
+    return csum_fold(csum_partial(data, len, 0));
+}
+
+static uint16_t generic_memcpy_chksum(void *dst, const void *src, size_t len)
+{
+    return csum_fold(copy_csum_partial(dst, src, len, 0));
+}
+
+#ifdef PKTCOPY_X86
+
+/*
+ * Vector kernels, instantiated for SSE2 (16 byte vectors) and AVX2 (32 byte
+ * vectors). The sums are kept in 32-bit lanes, each of which gets the two
+ * 16-bit words of its part of the vector added. A lane grows by less than
+ * 2^19 per unrolled iteration, so it is drained into the scalar sum every
+ * VEC_DRAIN iterations, long before it could overflow.
+ */
+#define VEC_UNROLL  4
+#define VEC_DRAIN   4096
+
+#define DEFINE_VEC_KERNELS(NAME, VBYTES, ATTR)                                \
+typedef uint32_t NAME##_v __attribute__((vector_size(VBYTES)));              \
+typedef uint32_t NAME##_vu __attribute__((vector_size(VBYTES), aligned(1),   \
+                                          may_alias));                       \
+                                                                              \
+ATTR static uint64_t NAME##_drain(NAME##_v acc)                               \
+{                                                                             \
+    uint64_t sum = 0;                                                         \
+    for (int i = 0; i < (VBYTES) / 4; i++) {                                  \
+        sum += acc[i];                                                        \
+    }                                                                         \
+    return sum;                                                               \
+}                                                                             \
+                                                                              \
+ATTR static void *NAME##_memcpy(void *dst, const void *src, size_t len)       \
+{                                                                             \
+    if (len < (VBYTES)) {                                                     \
+        return memcpy(dst, src, len);                                         \
+    }                                                                         \
+                                                                              \
+    uint8_t *d = dst;                                                         \
+    const uint8_t *s = src;                                                   \
+    /* load the last vector now, storing it at the end covers the tail */    \
+    NAME##_v last = *(const NAME##_vu *)(s + len - (VBYTES));                 \
+    uint8_t *dlast = d + len - (VBYTES);                                      \
+                                                                              \
+    for (; len >= VEC_UNROLL * (VBYTES);                                      \
+         d += VEC_UNROLL * (VBYTES), s += VEC_UNROLL * (VBYTES),              \
+         len -= VEC_UNROLL * (VBYTES)) {                                      \
+        NAME##_v v0 = *(const NAME##_vu *)s;                                  \
+        NAME##_v v1 = *(const NAME##_vu *)(s + (VBYTES));                     \
+        NAME##_v v2 = *(const NAME##_vu *)(s + 2 * (VBYTES));                 \
+        NAME##_v v3 = *(const NAME##_vu *)(s + 3 * (VBYTES));                 \
+        *(NAME##_vu *)d = v0;                                                 \
+        *(NAME##_vu *)(d + (VBYTES)) = v1;                                    \
+        *(NAME##_vu *)(d + 2 * (VBYTES)) = v2;                                \
+        *(NAME##_vu *)(d + 3 * (VBYTES)) = v3;                                \
+    }                                                                         \
+    for (; len >= (VBYTES); d += (VBYTES), s += (VBYTES), len -= (VBYTES)) {  \
+        *(NAME##_vu *)d = *(const NAME##_vu *)s;                              \
+    }                                                                         \
+    *(NAME##_vu *)dlast = last;                                               \
+                                                                              \
+    return dst;                                                               \
+}                                                                             \
+                                                                              \
+ATTR static uint16_t NAME##_chksum(const void *data, size_t len)              \
+{                                                                             \
+    const uint8_t *p = data;                                                  \
+    uint64_t sum = 0;                                                         \
+                                                                              \
+    while (len >= VEC_UNROLL * (VBYTES)) {                                    \
+        NAME##_v acc = { 0 };                                                 \
+        for (int n = 0; n < VEC_DRAIN && len >= VEC_UNROLL * (VBYTES);        \
+             n++, p += VEC_UNROLL * (VBYTES), len -= VEC_UNROLL * (VBYTES)) { \
+            NAME##_v v0 = *(const NAME##_vu *)p;                              \
+            NAME##_v v1 = *(const NAME##_vu *)(p + (VBYTES));                 \
+            NAME##_v v2 = *(const NAME##_vu *)(p + 2 * (VBYTES));             \
+            NAME##_v v3 = *(const NAME##_vu *)(p + 3 * (VBYTES));             \
+            acc += (v0 & 0xffff) + (v0 >> 16);                                \
+            acc += (v1 & 0xffff) + (v1 >> 16);                                \
+            acc += (v2 & 0xffff) + (v2 >> 16);                                \
+            acc += (v3 & 0xffff) + (v3 >> 16);                                \
+        }                                                                     \
+        sum = csum_add(sum, NAME##_drain(acc));                               \
+    }                                                                         \
+                                                                              \
+    return csum_fold(csum_partial(p, len, sum));                              \
+}                                                                             \
+                                                                              \
+ATTR static uint16_t NAME##_memcpy_chksum(void *dst, const void *src,         \
+                                          size_t len)                         \
+{                                                                             \
+    uint8_t *d = dst;                                                         \
+    const uint8_t *s = src;                                                   \
+    uint64_t sum = 0;                                                         \
+                                                                              \
+    while (len >= VEC_UNROLL * (VBYTES)) {                                    \
+        NAME##_v acc = { 0 };                                                 \
+        for (int n = 0; n < VEC_DRAIN && len >= VEC_UNROLL * (VBYTES);        \
+             n++, d += VEC_UNROLL * (VBYTES), s += VEC_UNROLL * (VBYTES),     \
+             len -= VEC_UNROLL * (VBYTES)) {                                  \
+            NAME##_v v0 = *(const NAME##_vu *)s;                              \
+            NAME##_v v1 = *(const NAME##_vu *)(s + (VBYTES));                 \
+            NAME##_v v2 = *(const NAME##_vu *)(s + 2 * (VBYTES));             \
+            NAME##_v v3 = *(const NAME##_vu *)(s + 3 * (VBYTES));             \
+            *(NAME##_vu *)d = v0;                                             \
+            *(NAME##_vu *)(d + (VBYTES)) = v1;                                \
+            *(NAME##_vu *)(d + 2 * (VBYTES)) = v2;                            \
+            *(NAME##_vu *)(d + 3 * (VBYTES)) = v3;                            \
+            acc += (v0 & 0xffff) + (v0 >> 16);                                \
+            acc += (v1 & 0xffff) + (v1 >> 16);                                \
+            acc += (v2 & 0xffff) + (v2 >> 16);                                \
+            acc += (v3 & 0xffff) + (v3 >> 16);                                \
+        }                                                                     \
+        sum = csum_add(sum, NAME##_drain(acc));                               \
+    }                                                                         \
+                                                                              \
+    return csum_fold(copy_csum_partial(d, s, len, sum));                      \
+}
+
+DEFINE_VEC_KERNELS(sse2, 16, )
+DEFINE_VEC_KERNELS(avx2, 32, __attribute__((target("avx2"))))
+
+static inline uint64_t xgetbv(uint32_t index)
+{
+    uint32_t eax, edx;
+    // xgetbv, spelled out for older assemblers
+    __asm volatile(".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx)
+                   : "c" (index));
+    return ((uint64_t)edx << 32) | eax;
+}
+
+/*
+ * AVX2 needs the CPU feature and an OS that saves the YMM registers on
+ * context switches, as announced by OSXSAVE and the XCR0 state bits.
+ */
+static bool cpu_has_avx2(void)
+{
+    struct cpuid_regs reg = CPUID_REGS_INITIAL(0, 0);
+    cpuid_exec(&reg);
+    uint32_t max_basic = reg.eax;
+    if (max_basic < 7) {
+        return false;
+    }
+
+    reg = (struct cpuid_regs)CPUID_REGS_INITIAL(1, 0);
+    cpuid_exec(&reg);
+    bool osxsave = reg.ecx & (1u << 27);
+    bool avx = reg.ecx & (1u << 28);
+    if (!osxsave || !avx || (xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+
+    reg = (struct cpuid_regs)CPUID_REGS_INITIAL(7, 0);
+    cpuid_exec(&reg);
+    return reg.ebx & (1u << 5);
+}
+
+#endif // PKTCOPY_X86
+
+struct pktcopy_ops {
+    void *(*memcpy)(void *dst, const void *src, size_t len);
+    uint16_t (*chksum)(const void *data, size_t len);
+    uint16_t (*memcpy_chksum)(void *dst, const void *src, size_t len);
+};
+
+static const struct pktcopy_ops impls[] = {
+    [PKTCOPY_IMPL_GENERIC] = {
+        generic_memcpy, generic_chksum, generic_memcpy_chksum
+    },
+#ifdef PKTCOPY_X86
+    [PKTCOPY_IMPL_SSE2] = {
+        sse2_memcpy, sse2_chksum, sse2_memcpy_chksum
+    },
+    [PKTCOPY_IMPL_AVX2] = {
+        avx2_memcpy, avx2_chksum, avx2_memcpy_chksum
+    },
+#endif
+};
+
+static const char *impl_names[] = {
+    [PKTCOPY_IMPL_GENERIC] = "generic",
+    [PKTCOPY_IMPL_SSE2]    = "sse2",
+    [PKTCOPY_IMPL_AVX2]    = "avx2",
+};
+
+static pktcopy_impl_t best_impl = PKTCOPY_IMPL_GENERIC;
+static pktcopy_impl_t cur_impl;
+static const struct pktcopy_ops *ops;
+
+static const struct pktcopy_ops *get_ops(void)
+{
+    if (__builtin_expect(ops != NULL, 1)) {
+        return ops;
+    }
+
+#ifdef PKTCOPY_X86
+    // SSE2 is part of the x86_64 baseline
+    best_impl = cpu_has_avx2() ? PKTCOPY_IMPL_AVX2 : PKTCOPY_IMPL_SSE2;
+#endif
+
+    // threads racing here all pick the same implementation
+    cur_impl = best_impl;
+    ops = &impls[cur_impl];
+    return ops;
+}
+
+void *pktcopy_memcpy(void *dst, const void *src, size_t len)
+{
+    return get_ops()->memcpy(dst, src, len);
+}
+
+uint16_t pktcopy_chksum(const void *data, size_t len)
+{
+    return get_ops()->chksum(data, len);
+}
+
+uint16_t pktcopy_memcpy_chksum(void *dst, const void *src, size_t len)
+{
+    return get_ops()->memcpy_chksum(dst, src, len);
+}
+
+int pktcopy_set_impl(pktcopy_impl_t impl)
+{
+    get_ops();
+    if (impl > best_impl) {
+        return -1;
+    }
+    cur_impl = impl;
+    ops = &impls[impl];
+    return 0;
+}
+
+pktcopy_impl_t pktcopy_get_impl(void)
+{
+    get_ops();
+    return cur_impl;
+}
+
+const char *pktcopy_impl_name(pktcopy_impl_t impl)
+{
+    if (impl > PKTCOPY_IMPL_AVX2) {
+        return "unknown";
+    }
+    return impl_names[impl];
+}
@@ -10,6 +10,7 @@
 
 #include <barrelfish/barrelfish.h>
 #include <barrelfish/waitset.h>
+#include <barrelfish/waitset_chan.h>
 #include <barrelfish/deferred.h>
 #include <if/monitor_defs.h>
 #include <lwip/sys.h>
@@ -25,11 +26,92 @@
 
 #define MAX_EPOLL_EVENTS    16
 
+/*
+ * Registrations are kept for the lifetime of an epoll_ctl() entry. Sockets
+ * tell us when they may have become ready through a handler registered with
+ * the network stack, which puts the entry on the ready list and wakes up a
+ * waiting epoll_wait(). epoll_wait() only looks at the entries on the ready
+ * list, so its cost does not depend on the number of idle file descriptors.
+ *
+ * Entries on the ready list are only candidates: their state is checked
+ * again before they are returned. Level-triggered entries that are still
+ * ready stay on the list, edge-triggered ones are removed until the next
+ * event. Unix domain sockets have no such handler and stay on the list
+ * for as long as they are registered.
+ */
 struct _epoll_fd {
     struct waitset ws;
     struct _epoll_events_list *events;
+    struct _epoll_events_list *ready_head, *ready_tail;
+    struct thread_mutex ready_lock;     ///< Protects the ready list
+    bool ready_changed;         ///< Entries were queued since the last scan
+    struct waitset_chanstate wakeup;    ///< Triggered when entries are queued
+    size_t lwip_sockets;        ///< Number of registered lwIP sockets
 };
 
+/// Append an entry to the ready list. Must be called with the lock held.
+static void ready_enqueue(struct _epoll_fd *efd, struct _epoll_events_list *li)
+{
+    if (li->ready) {
+        return;
+    }
+    li->ready = true;
+    li->ready_next = NULL;
+    li->ready_prev = efd->ready_tail;
+    if (efd->ready_tail != NULL) {
+        efd->ready_tail->ready_next = li;
+    } else {
+        efd->ready_head = li;
+    }
+    efd->ready_tail = li;
+}
+
+/// Remove an entry from the ready list. Must be called with the lock held.
+static void ready_dequeue(struct _epoll_fd *efd, struct _epoll_events_list *li)
+{
+    if (!li->ready) {
+        return;
+    }
+    if (li->ready_prev != NULL) {
+        li->ready_prev->ready_next = li->ready_next;
+    } else {
+        efd->ready_head = li->ready_next;
+    }
+    if (li->ready_next != NULL) {
+        li->ready_next->ready_prev = li->ready_prev;
+    } else {
+        efd->ready_tail = li->ready_prev;
+    }
+    li->ready = false;
+    li->ready_prev = li->ready_next = NULL;
+}
+
+static void do_nothing(void *arg)
+{
+}
+
+/**
+ * \brief Queue an entry and wake up a waiting epoll_wait().
+ */
+static void epoll_queue(struct _epoll_fd *efd, struct _epoll_events_list *li)
+{
+    thread_mutex_lock(&efd->ready_lock);
+    ready_enqueue(efd, li);
+    efd->ready_changed = true;
+    if (waitset_chan_is_registered(&efd->wakeup)) {
+        errval_t err = waitset_chan_trigger(&efd->wakeup);
+        assert(err_is_ok(err));
+    }
+    thread_mutex_unlock(&efd->ready_lock);
+}
+
+/// Readiness handler registered with the network stack
+static void epoll_sock_event(void *arg, int socket, uint32_t events)
+{
+    struct _epoll_events_list *li = arg;
+    epoll_queue(li->epoll, li);
+}
+
 int epoll_create(int size)
 {
     // size is ignored these days, even on Linux
@@ -44,6 +126,8 @@ int epoll_create1(int flags)
 
     memset(efd, 0, sizeof(struct _epoll_fd));
     waitset_init(&efd->ws);
+    thread_mutex_init(&efd->ready_lock);
+    waitset_chanstate_init(&efd->wakeup, CHANTYPE_OTHER);
 
     e.type = FDTAB_TYPE_EPOLL_INSTANCE;
     e.handle = efd;
@@ -64,32 +148,31 @@ int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
     struct fdtab_entry *mye = fdtab_get(epfd);
     assert(mye->type == FDTAB_TYPE_EPOLL_INSTANCE);
     struct _epoll_fd *efd = mye->handle;
+    errval_t err;
     int ret = 0;
 
     if(op != EPOLL_CTL_DEL) {
         assert(!(event->events & EPOLLRDHUP));
         assert(!(event->events & EPOLLPRI));
-        assert(!(event->events & EPOLLERR));
-        assert(!(event->events & EPOLLHUP));
-        assert(!(event->events & EPOLLET));
-        assert(!(event->events & EPOLLONESHOT));
     }
 
     switch(op) {
     case EPOLL_CTL_ADD:
         // Add event/FD to events/FDs list
         {
-            // Check that it's not already in the list
-            /* for(struct _epoll_events_list *i = efd->events; i != NULL; i = i->next) { */
-            /*     assert(i->fd != fd); */
-            /* } */
-
             struct fdtab_entry *e = fdtab_get(fd);
             if(e->epoll_fd == epfd) {
                 errno = EEXIST;
                 ret = -1;
                 break;
             }
+            if(e->type != FDTAB_TYPE_LWIP_SOCKET
+               && e->type != FDTAB_TYPE_UNIX_SOCKET) {
+                fprintf(stderr, "epoll_ctl() on FD type %d NYI.\n", e->type);
+                errno = EPERM;
+                ret = -1;
+                break;
+            }
             assert(e->epoll_fd == -1);
             e->epoll_fd = epfd;
             struct _epoll_events_list *li = &e->epoll_events;
@@ -98,44 +181,49 @@ int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
             if(li->next != NULL) {
                 li->next->prev = li;
             }
+            li->ready = false;
+            li->ready_prev = li->ready_next = NULL;
+            li->epoll = efd;
             li->event = *event;
             li->fd = fd;
             efd->events = li;
+
+            if (e->type == FDTAB_TYPE_LWIP_SOCKET) {
+                lwip_mutex_lock();
+                err = lwip_sock_waitset_register_events(e->fd, &efd->ws,
+                                                        epoll_sock_event, li);
+                lwip_mutex_unlock();
+                if (err_is_fail(err)) {
+                    USER_PANIC_ERR(err, "registering lwip socket events");
+                }
+                efd->lwip_sockets++;
+            }
+
+            // Check the current state on the next wait
+            epoll_queue(efd, li);
         }
         break;
 
     case EPOLL_CTL_DEL:
         {
-#if 0
-            struct _epoll_events_list *lasti = NULL, *i;
-            for(i = efd->events; i != NULL; i = i->next) {
-                if(i->fd == fd) {
-                    if(lasti == NULL) {
-                        // First entry in list
-                        efd->events = i->next;
-                    } else {
-                        // Anywhere else
-                        lasti->next = i->next;
-                    }
-
-                    free(i);
+            struct fdtab_entry *e = fdtab_get(fd);
+            assert(e->epoll_fd != -1);
 
-                    struct fdtab_entry *e = fdtab_get(fd);
-                    assert(e->epoll_fd != -1);
-                    e->epoll_fd = -1;
-                    break;
+            if (e->type == FDTAB_TYPE_LWIP_SOCKET) {
+                lwip_mutex_lock();
+                err = lwip_sock_waitset_deregister_events(e->fd);
+                lwip_mutex_unlock();
+                if (err_is_fail(err)) {
+                    USER_PANIC_ERR(err, "deregistering lwip socket events");
                 }
-
-                lasti = i;
+                assert(efd->lwip_sockets > 0);
+                efd->lwip_sockets--;
             }
 
-            if(i == NULL) {
-                errno = ENOENT;
-                ret = -1;
-            }
-#else
-            struct fdtab_entry *e = fdtab_get(fd);
-            assert(e->epoll_fd != -1);
+            thread_mutex_lock(&efd->ready_lock);
+            ready_dequeue(efd, &e->epoll_events);
+            thread_mutex_unlock(&efd->ready_lock);
+
             e->epoll_fd = -1;
             if(&e->epoll_events == efd->events) {
                 // First entry in list -- update head
@@ -147,25 +235,20 @@ int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
             if(e->epoll_events.prev != NULL) {
                 e->epoll_events.prev->next = e->epoll_events.next;
             }
-#endif
         }
         break;
 
     case EPOLL_CTL_MOD:
         {
-            struct _epoll_events_list *i;
-            for(i = efd->events; i != NULL; i = i->next) {
-                if(i->fd == fd) {
-                    // Found
-                    i->event = *event;
-                    break;
-                }
-            }
-
-            if(i == NULL) {
+            struct fdtab_entry *e = fdtab_get(fd);
+            if(e->epoll_fd != epfd) {
                 errno = ENOENT;
                 ret = -1;
+                break;
             }
+
+            e->epoll_events.event = *event;
+            epoll_queue(efd, &e->epoll_events);
         }
         break;
 
@@ -177,113 +260,264 @@ int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
     return ret;
 }
 
-struct timeout_event {
-  bool fired;
-};
-
-static void timeout_fired(void *arg)
-{
-  struct timeout_event *toe = arg;
-  assert(toe != NULL);
-  toe->fired = true;
-}
-
-int epoll_wait(int epfd, struct epoll_event *events,
-               int maxevents, int timeout)
+/**
+ * \brief Move the channels of a unix domain socket to the epoll waitset.
+ *
+ * Unix domain sockets are woken up by messages on their bindings, which are
+ * dispatched while we wait on the epoll waitset.
+ */
+static void unix_sock_prepare(struct _epoll_fd *efd, struct _unix_socket *us,
+                              struct epoll_event *event)
 {
-    struct fdtab_entry *mye = fdtab_get(epfd);
-    assert(mye->type == FDTAB_TYPE_EPOLL_INSTANCE);
-    struct _epoll_fd *efd = mye->handle;
     struct monitor_binding *mb = get_monitor_binding();
     errval_t err;
 
-    /* waitset_init(&efd->ws); */
-    assert(maxevents >= 1);
-
-    for(struct _epoll_events_list *i = efd->events; i != NULL; i = i->next) {
-        struct fdtab_entry *e = fdtab_get(i->fd);
-        struct epoll_event *event = &i->event;
+    if(event->events & EPOLLIN) {
+        if (us->passive) { /* passive side */
+            int j;
 
-        switch (e->type) {
-        case FDTAB_TYPE_LWIP_SOCKET:
-            {
-                int retval;
-
-                lwip_mutex_lock();
-                if(event->events & EPOLLIN) {
-                    retval = lwip_sock_waitset_register_read(e->fd, &efd->ws);
-                    assert(retval == 0);
+            /* Check for pending connection requests. */
+            for (j = 0; j < us->u.passive.max_backlog; j++)
+                {
+                    if (us->u.passive.backlog[j] != NULL) {
+                        break;
+                    }
                 }
-                if(event->events & EPOLLOUT) {
-                    retval = lwip_sock_waitset_register_write(e->fd, &efd->ws);
-                    assert(retval == 0);
+
+            /*
+             * If there are not pending connection request
+             * wait on monitor binding.
+             */
+            if (j == us->u.passive.max_backlog) {
+                /* wait on monitor */
+                err = mb->change_waitset(mb, &efd->ws);
+                if (err_is_fail(err)) {
+                    USER_PANIC_ERR(err, "change_waitset");
                 }
-                lwip_mutex_unlock();
             }
-            break;
+        }
+    }
+
+    if(event->events & EPOLLOUT) {
+        assert(!us->passive);
+
+        if(us->u.active.mode == _UNIX_SOCKET_MODE_CONNECTING) {
+            /* wait on monitor */
+            err = mb->change_waitset(mb, &efd->ws);
+            if (err_is_fail(err)) {
+                USER_PANIC_ERR(err, "change_waitset");
+            }
+        }
+    }
+
+    assert(event->events & (EPOLLIN | EPOLLOUT));
+
+    // Change waitset
+    err = us->u.active.binding->change_waitset
+        (us->u.active.binding, &efd->ws);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "change waitset");
+    }
+}
+
+/**
+ * \brief Return the events that are currently pending on a file descriptor.
+ */
+static uint32_t epoll_poll_entry(struct fdtab_entry *e, uint32_t interest)
+{
+    uint32_t revents = 0;
 
-        case FDTAB_TYPE_UNIX_SOCKET:
-            {
-                struct _unix_socket *us = e->handle;
-
-                if(event->events & EPOLLIN) {
-                    if (us->passive) { /* passive side */
-                        int j;
-
-                        /* Check for pending connection requests. */
-                        for (j = 0; j < us->u.passive.max_backlog; j++)
-                            {
-                                if (us->u.passive.backlog[j] != NULL) {
-                                    break;
-                                }
-                            }
-
-                        /*
-                         * If there are not pending connection request
-                         * wait on monitor binding.
-                         */
-                        if (j == us->u.passive.max_backlog) {
-                            /* wait on monitor */
-                            err = mb->change_waitset(mb, &efd->ws);
-                            if (err_is_fail(err)) {
-                                USER_PANIC_ERR(err, "change_waitset");
-                            }
+    switch (e->type) {
+    case FDTAB_TYPE_LWIP_SOCKET:
+        lwip_mutex_lock();
+        if (!lwip_sock_is_open(e->fd)) {
+            revents |= EPOLLHUP;
+        }
+        if ((interest & EPOLLIN) && lwip_sock_ready_read(e->fd)) {
+            revents |= EPOLLIN;
+        }
+        if ((interest & EPOLLOUT) && lwip_sock_ready_write(e->fd)) {
+            revents |= EPOLLOUT;
+        }
+        lwip_mutex_unlock();
+        break;
+
+    case FDTAB_TYPE_UNIX_SOCKET:
+        {
+            struct _unix_socket *us = e->handle;
+
+            if (interest & EPOLLIN) {
+                if (us->passive) { /* passive side */
+                    /* Check for pending connection requests. */
+                    for (int j = 0; j < us->u.passive.max_backlog; j++) {
+                        if (us->u.passive.backlog[j] != NULL) {
+                            revents |= EPOLLIN;
+                            break;
                         }
                     }
+                } else { /* active side */
+                    /* Check for incoming data. */
+                    if (us->recv_buf_valid > 0) {
+                        revents |= EPOLLIN;
+                    }
                 }
+            }
 
-                if(event->events & EPOLLOUT) {
-                    assert(!us->passive);
+            if (interest & EPOLLOUT) {
+                assert(!us->passive);
 
-                    if(us->u.active.mode == _UNIX_SOCKET_MODE_CONNECTING) {
-                        /* wait on monitor */
-                        err = mb->change_waitset(mb, &efd->ws);
-                        if (err_is_fail(err)) {
-                            USER_PANIC_ERR(err, "change_waitset");
-                        }
+                switch (us->u.active.mode) {
+                case _UNIX_SOCKET_MODE_CONNECTING:
+                    break;
+
+                case _UNIX_SOCKET_MODE_CONNECTED:
+                    if (us->send_buf == NULL) {
+                        revents |= EPOLLOUT;
                     }
+                    break;
                 }
+            }
+        }
+        break;
+
+    default:
+        fprintf(stderr, "epoll_wait() on FD type %d NYI.\n", e->type);
+        assert(!"NYI");
+        break;
+    }
 
-                assert(event->events & (EPOLLIN | EPOLLOUT));
+    return revents;
+}
 
-                // Change waitset
-                err = us->u.active.binding->change_waitset
-                    (us->u.active.binding, &efd->ws);
-                if (err_is_fail(err)) {
-                    USER_PANIC_ERR(err, "change waitset");
+/**
+ * \brief Check the entries on the ready list and return those that are ready.
+ *
+ * Entries that will need to be checked again are put back on the list.
+ */
+static int epoll_scan(struct _epoll_fd *efd, struct epoll_event *events,
+                      int maxevents)
+{
+    struct _epoll_events_list *li, *next;
+    struct _epoll_events_list *keep_head = NULL, *keep_tail = NULL;
+    int retevents = 0;
+
+    /*
+     * Take the whole list. The entries stay marked as ready while we look at
+     * them, so handlers running meanwhile leave their links alone and only
+     * note that something changed.
+     */
+    thread_mutex_lock(&efd->ready_lock);
+    li = efd->ready_head;
+    efd->ready_head = efd->ready_tail = NULL;
+    efd->ready_changed = false;
+    thread_mutex_unlock(&efd->ready_lock);
+
+    for (; li != NULL; li = next) {
+        next = li->ready_next;
+        struct fdtab_entry *e = fdtab_get(li->fd);
+        uint32_t interest = li->event.events;
+        bool requeue;
+
+        if ((interest & EPOLLONESHOT)
+            && (interest & ~(EPOLLET | EPOLLONESHOT)) == 0) {
+            // Disarmed, not even EPOLLERR and EPOLLHUP are reported until
+            // EPOLL_CTL_MOD re-arms it and queues it again
+            requeue = false;
+        } else if (retevents == maxevents) {
+            // Out of space, leave it for the next call
+            requeue = true;
+        } else {
+            uint32_t revents = epoll_poll_entry(e, interest)
+                & (interest | EPOLLERR | EPOLLHUP);
+
+            if (revents != 0) {
+                events[retevents] = li->event;
+                events[retevents].events = revents;
+                retevents++;
+
+                if (interest & EPOLLONESHOT) {
+                    // Disabled until re-armed with EPOLL_CTL_MOD
+                    li->event.events &= EPOLLET | EPOLLONESHOT;
                 }
+            }
 
+            // Unix domain sockets are not told about events, so keep them
+            if (e->type == FDTAB_TYPE_UNIX_SOCKET) {
+                if (revents == 0 && (li->event.events & (EPOLLIN | EPOLLOUT))) {
+                    unix_sock_prepare(efd, e->handle, &li->event);
+                }
+                requeue = true;
+            } else {
+                requeue = revents != 0 && !(interest & EPOLLET);
             }
-            break;
+        }
 
-        default:
-            {
-                fprintf(stderr, "change waitset on FD type %d NYI.\n",
-                        e->type);
-                assert(!"NYI");
-                errno = EBADF;
-                return -1;
+        if (!requeue) {
+            // Keep it if an event may have arrived after we checked
+            thread_mutex_lock(&efd->ready_lock);
+            requeue = efd->ready_changed;
+            if (!requeue) {
+                li->ready = false;
             }
+            thread_mutex_unlock(&efd->ready_lock);
+        }
+
+        if (requeue) {
+            li->ready_prev = keep_tail;
+            li->ready_next = NULL;
+            if (keep_tail != NULL) {
+                keep_tail->ready_next = li;
+            } else {
+                keep_head = li;
+            }
+            keep_tail = li;
+        }
+    }
+
+    // Put the entries we kept back, behind those queued meanwhile
+    if (keep_head != NULL) {
+        thread_mutex_lock(&efd->ready_lock);
+        keep_head->ready_prev = efd->ready_tail;
+        if (efd->ready_tail != NULL) {
+            efd->ready_tail->ready_next = keep_head;
+        } else {
+            efd->ready_head = keep_head;
+        }
+        efd->ready_tail = keep_tail;
+        thread_mutex_unlock(&efd->ready_lock);
+    }
+
+    return retevents;
+}
+
+struct timeout_event {
+  bool fired;
+};
+
+static void timeout_fired(void *arg)
+{
+  struct timeout_event *toe = arg;
+  assert(toe != NULL);
+  toe->fired = true;
+}
+
+int epoll_wait(int epfd, struct epoll_event *events,
+               int maxevents, int timeout)
+{
+    struct fdtab_entry *mye = fdtab_get(epfd);
+    assert(mye->type == FDTAB_TYPE_EPOLL_INSTANCE);
+    struct _epoll_fd *efd = mye->handle;
+    errval_t err;
+
+    assert(maxevents >= 1);
+
+    // Let the network stack make progress while we wait
+    if (efd->lwip_sockets > 0) {
+        lwip_mutex_lock();
+        err = lwip_sock_waitset_register_stack(&efd->ws);
+        lwip_mutex_unlock();
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "registering network stack on waitset");
         }
     }
 
@@ -303,138 +537,34 @@ int epoll_wait(int epfd, struct epoll_event *events,
     }
 
     int retevents = 0;
-    while(!toe.fired && retevents == 0) {
+    for (;;) {
+        retevents = epoll_scan(efd, events, maxevents);
+        if (retevents > 0 || toe.fired) {
+            break;
+        }
+
         if(timeout == 0) {
             // Just poll once, don't block
             err = event_dispatch_non_block(&efd->ws);
             assert(err_is_ok(err) || err_no(err) == LIB_ERR_NO_EVENT);
             toe.fired = true;
-        } else {
-            err = event_dispatch(&efd->ws);
-            if (err_is_fail(err)) {
-                USER_PANIC_ERR(err, "Error in event_dispatch.");
-            }
+            continue;
         }
 
-        // Return ready file descriptors
-        for(struct _epoll_events_list *i = efd->events; i != NULL; i = i->next) {
-            struct epoll_event *event = &i->event;
-            struct fdtab_entry *e = fdtab_get(i->fd);
-
-            assert(retevents < maxevents);
-            events[retevents] = *event;
-            events[retevents].events = 0;
-
-            // Check errors (hangup)
-            {
-                switch (e->type) {
-                case FDTAB_TYPE_LWIP_SOCKET:
-                    {
-                        lwip_mutex_lock();
-                        if (!lwip_sock_is_open(e->fd)) {
-                            events[retevents].events |= EPOLLHUP;
-                        }
-                        lwip_mutex_unlock();
-                    }
-                    break;
-
-                default:
-                    // No-Op
-                    break;
-                }
-            }
-
-            // Check readable FDs
-            if(event->events & EPOLLIN) {
-                switch (e->type) {
-                case FDTAB_TYPE_LWIP_SOCKET:
-                    {
-                        lwip_mutex_lock();
-                        if (lwip_sock_ready_read(e->fd)) {
-                            events[retevents].events |= EPOLLIN;
-                        }
-                        lwip_mutex_unlock();
-                    }
-                    break;
-
-                case FDTAB_TYPE_UNIX_SOCKET:
-                    {
-                        struct _unix_socket *us = e->handle;
-
-                        if (us->passive) { /* passive side */
-                            /* Check for pending connection requests. */
-                            for (int j = 0; j < us->u.passive.max_backlog; j++)
-                                {
-                                    if (us->u.passive.backlog[j] != NULL) {
-                                        events[retevents].events |= EPOLLIN;
-                                        break;
-                                    }
-                                }
-                        } else { /* active side */
-                            /* Check for incoming data. */
-                            if (us->recv_buf_valid > 0) {
-                                events[retevents].events |= EPOLLIN;
-                            }
-                        }
-                    }
-                    break;
-
-                default:
-                    {
-                        fprintf(stderr, "epoll_wait() on FD type %d NYI.\n",
-                                e->type);
-                        assert(!"NYI");
-                        errno = EBADF;
-                        return -1;
-                    }
-                }
-            }
-
-            // Check writeable FDs
-            if(event->events & EPOLLOUT) {
-                switch (e->type) {
-                case FDTAB_TYPE_LWIP_SOCKET:
-                    {
-                        lwip_mutex_lock();
-                        if (lwip_sock_ready_write(e->fd)) {
-                            events[retevents].events |= EPOLLOUT;
-                        }
-                        lwip_mutex_unlock();
-                    }
-                    break;
-
-                case FDTAB_TYPE_UNIX_SOCKET:
-                    {
-                        struct _unix_socket *us = e->handle;
-                        assert(!us->passive);
-
-                        switch (us->u.active.mode) {
-                        case _UNIX_SOCKET_MODE_CONNECTING:
-                            break;
-
-                        case _UNIX_SOCKET_MODE_CONNECTED:
-                            if (us->send_buf == NULL) {
-                                events[retevents].events |= EPOLLOUT;
-                            }
-                            break;
-                        }
-                    }
-                    break;
-
-                default:
-                    {
-                        fprintf(stderr, "epoll_wait() on FD type %d NYI.\n",
-                                e->type);
-                        assert(!"NYI");
-                        errno = EBADF;
-                        return -1;
-                    }
-                }
-            }
+        // Block unless entries were queued since the scan
+        thread_mutex_lock(&efd->ready_lock);
+        bool changed = efd->ready_changed;
+        if (!changed && efd->wakeup.state == CHAN_UNREGISTERED) {
+            err = waitset_chan_register(&efd->ws, &efd->wakeup,
+                                        MKCLOSURE(do_nothing, NULL));
+            assert(err_is_ok(err));
+        }
+        thread_mutex_unlock(&efd->ready_lock);
 
-            // If any events were returned, go to next entry in array
-            if(events[retevents].events != 0) {
-                retevents++;
+        if (!changed) {
+            err = event_dispatch(&efd->ws);
+            if (err_is_fail(err)) {
+                USER_PANIC_ERR(err, "Error in event_dispatch.");
             }
         }
     }
@@ -444,49 +574,12 @@ int epoll_wait(int epfd, struct epoll_event *events,
         deferred_event_cancel(&timeout_event);
     }
 
-    // Restore old waitsets
-    for(struct _epoll_events_list *i = efd->events; i != NULL; i = i->next) {
-        struct fdtab_entry *e = fdtab_get(i->fd);
-        struct epoll_event *event = &i->event;
-
-        switch (e->type) {
-        case FDTAB_TYPE_LWIP_SOCKET:
-            {
-                lwip_mutex_lock();
-                if(event->events & EPOLLIN) {
-                    err = lwip_sock_waitset_deregister_read(e->fd);
-                    if (err_is_fail(err) &&
-                        err_no(err) != LIB_ERR_CHAN_NOT_REGISTERED) {
-                        USER_PANIC_ERR(err, "error deregister read channel for "
-                                       "lwip socket");
-                    }
-                }
-                if(event->events & EPOLLOUT) {
-                    err = lwip_sock_waitset_deregister_write(e->fd);
-                    if (err_is_fail(err) &&
-                        err_no(err) != LIB_ERR_CHAN_NOT_REGISTERED) {
-                        USER_PANIC_ERR(err, "error deregister write channel for "
-                                       "lwip socket");
-                    }
-                }
-                lwip_mutex_unlock();
-            }
-            break;
-
-        case FDTAB_TYPE_UNIX_SOCKET:
-            {
-                // NYI
-            }
-            break;
-
-        default:
-            {
-                fprintf(stderr, "change waitset on FD type %d NYI.\n",
-                        e->type);
-                assert(!"NYI");
-                errno = EBADF;
-                return -1;
-            }
+    if (efd->lwip_sockets > 0) {
+        lwip_mutex_lock();
+        err = lwip_sock_waitset_deregister_stack();
+        lwip_mutex_unlock();
+        if (err_is_fail(err) && err_no(err) != LIB_ERR_CHAN_NOT_REGISTERED) {
+            USER_PANIC_ERR(err, "error deregistering network stack");
         }
     }
 
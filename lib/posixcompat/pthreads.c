@@ -31,7 +31,6 @@ struct   pthread_mutex_attr
 
 struct pthread_mutex {
     struct thread_mutex mutex;
-    int locked;
     struct pthread_mutex_attr attrs;
 };
 
@@ -46,13 +45,9 @@ struct pthread_cond {
 
 struct pthread_rwlock
 {
-  pthread_mutex_t mtxExclusiveAccess;
-  pthread_mutex_t mtxSharedAccessCompleted;
-  pthread_cond_t cndSharedAccessCompleted;
-  int nSharedAccessCount;
-  int nExclusiveAccessCount;
-  int nCompletedSharedAccessCount;
+  struct thread_rwlock rwlock;
   int nMagic;
+  void *mem;        ///< Start of the allocation, rwlock is aligned within it
 };
 
 
@@ -217,24 +212,44 @@ int pthread_mutex_init(pthread_mutex_t *mutex,
                        const pthread_mutexattr_t *attr)
 {
     // XXX: Attributes ignored.
-    *mutex = malloc(sizeof(struct pthread_mutex));
-    if(*mutex == NULL) {
+    struct pthread_mutex *m = malloc(sizeof(struct pthread_mutex));
+    if(m == NULL) {
         return -1;
     }
 
-    thread_mutex_init(&(*mutex)->mutex);
-    (*mutex)->locked = 0;
+    thread_mutex_init(&m->mutex);
     if (attr && *attr) {
         POSIXCOMPAT_DEBUG("kind = %u\n", (*attr)->kind);
-        memcpy(&(*mutex)->attrs, *attr, sizeof(struct pthread_mutex_attr));
+        memcpy(&m->attrs, *attr, sizeof(struct pthread_mutex_attr));
     } else {
-        (*mutex)->attrs.kind = PTHREAD_MUTEX_NORMAL;
-        (*mutex)->attrs.robustness = 0;
-        (*mutex)->attrs.pshared = PTHREAD_PROCESS_PRIVATE;
+        m->attrs.kind = PTHREAD_MUTEX_NORMAL;
+        m->attrs.robustness = 0;
+        m->attrs.pshared = PTHREAD_PROCESS_PRIVATE;
     }
+    *mutex = m;
     return  0;
 }
 
+/**
+ * \brief Return the mutex, initialising a statically initialised one
+ *
+ * Only the first use of a static mutex takes the global mutex_mutex, so
+ * that unrelated mutexes don't serialise on it.
+ */
+static struct pthread_mutex *mutex_get(pthread_mutex_t *mutex)
+{
+    if(__atomic_load_n(mutex, __ATOMIC_ACQUIRE) == PTHREAD_MUTEX_INITIALIZER) {
+        thread_mutex_lock(&mutex_mutex);
+        if(*mutex == PTHREAD_MUTEX_INITIALIZER) {
+            pthread_mutex_t m;
+            pthread_mutex_init(&m, NULL);
+            __atomic_store_n(mutex, m, __ATOMIC_RELEASE);
+        }
+        thread_mutex_unlock(&mutex_mutex);
+    }
+    return *mutex;
+}
+
 int pthread_mutex_destroy(pthread_mutex_t *mutex)
 {
     if(*mutex != PTHREAD_MUTEX_INITIALIZER) {
@@ -246,60 +261,33 @@ int pthread_mutex_destroy(pthread_mutex_t *mutex)
 
 int pthread_mutex_lock(pthread_mutex_t *mutex)
 {
-    thread_mutex_lock(&mutex_mutex);
-
-    if(*mutex == PTHREAD_MUTEX_INITIALIZER) {
-        pthread_mutex_init(mutex, NULL);
-    }
+    struct pthread_mutex *m = mutex_get(mutex);
 
-    (*mutex)->locked++;
-    thread_mutex_unlock(&mutex_mutex);
-    if ((*mutex)->attrs.kind == PTHREAD_MUTEX_RECURSIVE) {
-        thread_mutex_lock_nested(&(*mutex)->mutex);
+    if (m->attrs.kind == PTHREAD_MUTEX_RECURSIVE) {
+        thread_mutex_lock_nested(&m->mutex);
     } else {
-        thread_mutex_lock(&(*mutex)->mutex);
+        thread_mutex_lock(&m->mutex);
     }
     return 0;
 }
 
 int pthread_mutex_unlock(pthread_mutex_t *mutex)
 {
-    thread_mutex_lock(&mutex_mutex);
-
-    if(*mutex == PTHREAD_MUTEX_INITIALIZER) {
-        pthread_mutex_init(mutex, NULL);
-    }
+    struct pthread_mutex *m = mutex_get(mutex);
 
-    if((*mutex)->locked == 0) {
-        thread_mutex_unlock(&mutex_mutex);
+    if(m->mutex.locked == 0) {
         return 0;
     }
 
-    (*mutex)->locked--;
-    thread_mutex_unlock(&mutex_mutex);
-    thread_mutex_unlock(&(*mutex)->mutex);
+    thread_mutex_unlock(&m->mutex);
     return 0;
 }
 
 int pthread_mutex_trylock(pthread_mutex_t *mutex)
 {
-    thread_mutex_lock(&mutex_mutex);
-
-    if(*mutex == PTHREAD_MUTEX_INITIALIZER) {
-        pthread_mutex_init(mutex, NULL);
-    }
+    struct pthread_mutex *m = mutex_get(mutex);
 
-    thread_mutex_unlock(&mutex_mutex);
-
-    int retval = (thread_mutex_trylock(&(*mutex)->mutex) ? 0 : EBUSY);
-
-    if(retval != EBUSY) {
-        thread_mutex_lock(&mutex_mutex);
-        (*mutex)->locked++;
-        thread_mutex_unlock(&mutex_mutex);
-    }
-
-    return retval;
+    return (thread_mutex_trylock(&m->mutex) ? 0 : EBUSY);
 }
 
 int pthread_cond_init(pthread_cond_t *cond,
@@ -608,176 +596,121 @@ int pthread_rwlock_init(pthread_rwlock_t *rwlock,
 {
     pthread_rwlock_t rwl;
 
-    rwl = calloc(1, sizeof(struct pthread_rwlock));
-    if (rwl == NULL) {
+    // malloc() does not honour the alignment of the reader counters
+    void *mem = malloc(sizeof(struct pthread_rwlock) + THREAD_RWLOCK_ALIGN - 1);
+    if (mem == NULL) {
         return ENOMEM;
     }
 
+    rwl = (pthread_rwlock_t)ROUND_UP((uintptr_t)mem, THREAD_RWLOCK_ALIGN);
+    rwl->mem = mem;
     rwl->nMagic = PTHREADS_RWLOCK_MAGIC;
-    rwl->mtxExclusiveAccess = PTHREAD_MUTEX_INITIALIZER;
-    rwl->mtxSharedAccessCompleted = PTHREAD_MUTEX_INITIALIZER;
-
-    pthread_cond_init (&rwl->cndSharedAccessCompleted, NULL);
+    thread_rwlock_init(&rwl->rwlock);
     *rwlock = rwl;
 
     return 0;
 }
 
-int pthread_rwlock_unlock(pthread_rwlock_t *rwlock)
+/**
+ * \brief Return the rwlock, initialising a statically initialised one
+ */
+static int rwlock_get(pthread_rwlock_t *rwlock, struct pthread_rwlock **ret)
 {
-    int result, result1;
-    pthread_rwlock_t rwl;
+    int result = 0;
 
-    if (rwlock == NULL || *rwlock == NULL) {
-        return (EINVAL);
+    if (rwlock == NULL) {
+        return EINVAL;
     }
 
-    if (*rwlock == PTHREAD_RWLOCK_INITIALIZER) {
-        result = pthread_rwlock_init(rwlock, NULL);
+    if (__atomic_load_n(rwlock, __ATOMIC_ACQUIRE) == PTHREAD_RWLOCK_INITIALIZER) {
+        thread_mutex_lock(&mutex_mutex);
+        if (*rwlock == PTHREAD_RWLOCK_INITIALIZER) {
+            pthread_rwlock_t rwl;
+            result = pthread_rwlock_init(&rwl, NULL);
+            if (result == 0) {
+                __atomic_store_n(rwlock, rwl, __ATOMIC_RELEASE);
+            }
+        }
+        thread_mutex_unlock(&mutex_mutex);
         if (result) {
             return result;
         }
     }
 
-    rwl = *rwlock;
-
-    if (rwl->nMagic != PTHREADS_RWLOCK_MAGIC) {
+    if ((*rwlock)->nMagic != PTHREADS_RWLOCK_MAGIC) {
         return EINVAL;
     }
 
-    if (rwl->nExclusiveAccessCount == 0) {
-        if ((result = pthread_mutex_lock (&(rwl->mtxSharedAccessCompleted))) != 0) {
-            return result;
-        }
-
-        if (++rwl->nCompletedSharedAccessCount == 0) {
-            result = pthread_cond_signal (&(rwl->cndSharedAccessCompleted));
-        }
-
-        result1 = pthread_mutex_unlock (&(rwl->mtxSharedAccessCompleted));
-    } else {
-        rwl->nExclusiveAccessCount--;
-        result = pthread_mutex_unlock (&(rwl->mtxSharedAccessCompleted));
-        result1 = pthread_mutex_unlock (&(rwl->mtxExclusiveAccess));
-    }
-
-    return ((result != 0) ? result : result1);
+    *ret = *rwlock;
+    return 0;
 }
 
-int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock)
+int pthread_rwlock_destroy(pthread_rwlock_t *rwlock)
 {
-    int result;
-    pthread_rwlock_t rwl;
-
-    if (rwlock == NULL || *rwlock == NULL) {
-        return (EINVAL);
+    if (rwlock == NULL) {
+        return EINVAL;
     }
-
-    if (*rwlock == PTHREAD_RWLOCK_INITIALIZER) {
-        result = pthread_rwlock_init(rwlock, NULL);
-        if (result) {
-            return result;
-        }
+    if (*rwlock != PTHREAD_RWLOCK_INITIALIZER) {
+        (*rwlock)->nMagic = 0;
+        free((*rwlock)->mem);
+        *rwlock = PTHREAD_RWLOCK_INITIALIZER;
     }
+    return 0;
+}
 
-    rwl = *rwlock;
+int pthread_rwlock_unlock(pthread_rwlock_t *rwlock)
+{
+    struct pthread_rwlock *rwl;
+    int result = rwlock_get(rwlock, &rwl);
 
-    if (rwl->nMagic != PTHREADS_RWLOCK_MAGIC) {
-        return EINVAL;
+    if (result == 0) {
+        thread_rwlock_unlock(&rwl->rwlock);
     }
+    return result;
+}
 
-    if ((result = pthread_mutex_lock (&(rwl->mtxExclusiveAccess))) != 0) {
-        return result;
-    }
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock)
+{
+    struct pthread_rwlock *rwl;
+    int result = rwlock_get(rwlock, &rwl);
 
-    if ((result = pthread_mutex_lock (&(rwl->mtxSharedAccessCompleted))) != 0) {
-        (void) pthread_mutex_unlock (&(rwl->mtxExclusiveAccess));
-        return result;
+    if (result == 0) {
+        thread_rwlock_wrlock(&rwl->rwlock);
     }
+    return result;
+}
 
-    if (rwl->nExclusiveAccessCount == 0) {
-        if (rwl->nCompletedSharedAccessCount > 0) {
-            rwl->nSharedAccessCount -= rwl->nCompletedSharedAccessCount;
-            rwl->nCompletedSharedAccessCount = 0;
-        }
-
-        if (rwl->nSharedAccessCount > 0) {
-            rwl->nCompletedSharedAccessCount = -rwl->nSharedAccessCount;
-
-            /*
-             * This routine may be a cancelation point
-             * according to POSIX 1003.1j section 18.1.2.
-             */
-           // pthread_cleanup_push (ptw32_rwlock_cancelwrwait, (void *) rwl);
-
-            do {
-                result = pthread_cond_wait (&(rwl->cndSharedAccessCompleted),
-                                            &(rwl->mtxSharedAccessCompleted));
-            } while (result == 0 && rwl->nCompletedSharedAccessCount < 0);
-
-            //pthread_cleanup_pop ((result != 0) ? 1 : 0);
-
-            if (result == 0) {
-                rwl->nSharedAccessCount = 0;
-            }
-        }
-    }
+int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock)
+{
+    struct pthread_rwlock *rwl;
+    int result = rwlock_get(rwlock, &rwl);
 
-    if (result == 0) {
-        rwl->nExclusiveAccessCount++;
+    if (result == 0 && !thread_rwlock_trywrlock(&rwl->rwlock)) {
+        result = EBUSY;
     }
-
     return result;
 }
 
 int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock)
 {
-  int result;
-  pthread_rwlock_t rwl;
-
-  if (rwlock == NULL || *rwlock == NULL) {
-      return EINVAL;
-  }
-
-  /*
-   * We do a quick check to see if we need to do more work
-   * to initialise a static rwlock. We check
-   * again inside the guarded section of ptw32_rwlock_check_need_init()
-   * to avoid race conditions.
-   */
-   if (*rwlock == PTHREAD_RWLOCK_INITIALIZER) {
-        result = pthread_rwlock_init(rwlock, NULL);
-        if (result) {
-            return result;
-        }
-    }
-
-  rwl = *rwlock;
-
-  if (rwl->nMagic != PTHREADS_RWLOCK_MAGIC) {
-      return EINVAL;
-  }
+    struct pthread_rwlock *rwl;
+    int result = rwlock_get(rwlock, &rwl);
 
-  if ((result = pthread_mutex_lock (&(rwl->mtxExclusiveAccess))) != 0) {
-      return result;
-  }
-
-  if (++rwl->nSharedAccessCount == 0xFFFFFFFF) {
-      if ((result = pthread_mutex_lock (&(rwl->mtxSharedAccessCompleted))) != 0) {
-          (void) pthread_mutex_unlock (&(rwl->mtxExclusiveAccess));
-          return result;
-      }
-
-      rwl->nSharedAccessCount -= rwl->nCompletedSharedAccessCount;
-      rwl->nCompletedSharedAccessCount = 0;
+    if (result == 0) {
+        thread_rwlock_rdlock(&rwl->rwlock);
+    }
+    return result;
+}
 
-      if ((result = pthread_mutex_unlock (&(rwl->mtxSharedAccessCompleted))) != 0) {
-          (void) pthread_mutex_unlock (&(rwl->mtxExclusiveAccess));
-          return result;
-      }
-  }
+int pthread_rwlock_tryrdlock(pthread_rwlock_t *rwlock)
+{
+    struct pthread_rwlock *rwl;
+    int result = rwlock_get(rwlock, &rwl);
 
-  return (pthread_mutex_unlock (&(rwl->mtxExclusiveAccess)));
+    if (result == 0 && !thread_rwlock_tryrdlock(&rwl->rwlock)) {
+        result = EBUSY;
+    }
+    return result;
 }
 
 
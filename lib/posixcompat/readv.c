@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012, 2013, ETH Zurich.
+ * Copyright (c) 2012, 2013, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -7,20 +7,167 @@
  * ETH Zurich D-INFK, Haldeneggsteig 4, CH-8092 Zurich. Attn: Systems Group.
  */
 
-#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
 #include <sys/uio.h>
+#include <lwip/sys.h>
+#include <lwip/sockets.h>
+#include <vfs/vfs_fd.h>
+#include <vfs/fdtab.h>
+#include "posixcompat.h"
+
+static bool iov_valid(const struct iovec *iov, int iovcnt)
+{
+    size_t total = 0;
+
+    if (iovcnt < 0 || iovcnt > UIO_MAXIOV) {
+        return false;
+    }
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len > SSIZE_MAX - total) {
+            return false;
+        }
+        total += iov[i].iov_len;
+    }
+    return true;
+}
+
+/**
+ * \brief Read into each iovec in turn with \p readfn, until a short read.
+ *
+ * Only the first read may block, the others are only done if data is
+ * available.
+ */
+static ssize_t readv_each(int fd, const struct iovec *iov, int iovcnt,
+                          int (*readfn)(int fd, void *buf, size_t len,
+                                        int flags))
+{
+    ssize_t total = 0;
+
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+        int ret = readfn(fd, iov[i].iov_base, iov[i].iov_len,
+                         total > 0 ? MSG_DONTWAIT : 0);
+        if (ret < 0) {
+            return total > 0 ? total : -1;
+        }
+        total += ret;
+        if ((size_t)ret < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+static int lwip_read_fn(int fd, void *buf, size_t len, int flags)
+{
+    lwip_mutex_lock();
+    int ret = lwip_recv(fd, buf, len, flags);
+    lwip_mutex_unlock();
+    return ret;
+}
+
+static int unix_read_fn(int fd, void *buf, size_t len, int flags)
+{
+    // Unix domain sockets have no per-call non-blocking flag
+    return flags & MSG_DONTWAIT ? 0 : recv(fd, buf, len, 0);
+}
+
+static int plain_read_fn(int fd, void *buf, size_t len, int flags)
+{
+    return flags & MSG_DONTWAIT ? 0 : read(fd, buf, len);
+}
 
 /**
  * \brief Read a vector.
  */
 ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
 {
-    assert(!"NYI");
-    return -1;
+    struct fdtab_entry *e = fdtab_get(fd);
+
+    if (!iov_valid(iov, iovcnt)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    switch(e->type) {
+    case FDTAB_TYPE_LWIP_SOCKET:
+        return readv_each(e->fd, iov, iovcnt, lwip_read_fn);
+
+    case FDTAB_TYPE_UNIX_SOCKET:
+        return readv_each(fd, iov, iovcnt, unix_read_fn);
+
+    case FDTAB_TYPE_PTM:
+    case FDTAB_TYPE_PTS:
+        return readv_each(fd, iov, iovcnt, plain_read_fn);
+
+    case FDTAB_TYPE_AVAILABLE:
+        errno = EBADF;
+        return -1;
+
+    default:
+        return vfsfd_readv(fd, iov, iovcnt);
+    }
 }
 
+/**
+ * \brief Write a vector.
+ *
+ * Sockets hand the whole vector to the network stack, which builds one
+ * packet out of it where it can. Files gather short iovecs into fewer
+ * calls to the file system.
+ */
 ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
 {
-    assert(!"NYI");
-    return -1;
+    struct fdtab_entry *e = fdtab_get(fd);
+    ssize_t total = 0;
+    int ret;
+
+    if (!iov_valid(iov, iovcnt)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    switch(e->type) {
+    case FDTAB_TYPE_LWIP_SOCKET:
+        {
+            struct msghdr msg = {
+                .msg_iov = (struct iovec *)iov,
+                .msg_iovlen = iovcnt,
+            };
+            lwip_mutex_lock();
+            ret = lwip_sendmsg(e->fd, &msg, 0);
+            lwip_mutex_unlock();
+            return ret;
+        }
+
+    case FDTAB_TYPE_UNIX_SOCKET:
+    case FDTAB_TYPE_PTM:
+    case FDTAB_TYPE_PTS:
+        for (int i = 0; i < iovcnt; i++) {
+            if (iov[i].iov_len == 0) {
+                continue;
+            }
+            ret = write(fd, iov[i].iov_base, iov[i].iov_len);
+            if (ret < 0) {
+                return total > 0 ? total : -1;
+            }
+            total += ret;
+            if ((size_t)ret < iov[i].iov_len) {
+                break;
+            }
+        }
+        return total;
+
+    case FDTAB_TYPE_AVAILABLE:
+        errno = EBADF;
+        return -1;
+
+    default:
+        return vfsfd_writev(fd, iov, iovcnt);
+    }
 }
@@ -19,6 +19,9 @@ errval_t spawn_arch_load(struct spawninfo *si,
                          lvaddr_t binary, size_t binary_size,
                          genvaddr_t *entry, void** arch_load_info);
 
+errval_t spawn_arch_image_load(struct spawn_image *img,
+                               lvaddr_t binary, size_t binary_size);
+
 void spawn_arch_set_registers(void *arch_load_info,
                               dispatcher_handle_t handle,
                               arch_registers_state_t *enabled_area,
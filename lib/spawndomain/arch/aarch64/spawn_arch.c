@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007-2010, ETH Zurich.
+ * Copyright (c) 2007-2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -28,26 +28,6 @@
 #error "Unexpected architecture."
 #endif
 
-/**
- * \brief Convert elf flags to vregion flags
- */
-static vregion_flags_t elf_to_vregion_flags(uint32_t flags)
-{
-    vregion_flags_t vregion_flags = 0;
-
-    if (flags & PF_R) {
-        vregion_flags |= VREGION_FLAGS_READ;
-    }
-    if (flags & PF_W) {
-        vregion_flags |= VREGION_FLAGS_WRITE;
-    }
-    if (flags & PF_X) {
-        vregion_flags |= VREGION_FLAGS_EXECUTE;
-    }
-
-    return vregion_flags;
-}
-
 static errval_t elf_allocate(void *state, genvaddr_t base, size_t size,
                              uint32_t flags, void **retbase)
 {
@@ -191,6 +171,34 @@ errval_t spawn_arch_load(struct spawninfo *si,
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Load the elf image into a shareable image
+ */
+errval_t spawn_arch_image_load(struct spawn_image *img,
+                               lvaddr_t binary, size_t binary_size)
+{
+    errval_t err;
+
+    // TLS is NYI
+    img->tls_init_base = 0;
+    img->tls_init_len = img->tls_total_len = 0;
+
+    err = elf_load(EM_HOST, spawn_image_allocate, img, binary, binary_size,
+                   &img->entry);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct Elf64_Shdr* got_shdr =
+        elf64_find_section_header_name(binary, binary_size, ".got");
+    if (got_shdr == NULL) {
+        return SPAWN_ERR_LOAD;
+    }
+    img->arch_info = (void*)got_shdr->sh_addr;
+
+    return SYS_ERR_OK;
+}
+
 void spawn_arch_set_registers(void *arch_load_info,
                               dispatcher_handle_t handle,
                               arch_registers_state_t *enabled_area,
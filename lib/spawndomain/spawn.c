@@ -39,13 +39,23 @@ static errval_t spawn_setup_cspace(struct spawninfo *si)
     struct capref t1;
 
     /* Create root CNode */
-    err = cnode_create(&si->rootcn_cap, &si->rootcn, DEFAULT_CNODE_SLOTS, NULL);
+    err = slot_alloc(&si->rootcn_cap);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_SLOT_ALLOC);
+    }
+    err = spawn_ram_cnode_create(si, SPAWN_OBJ_ROOTCN, si->rootcn_cap,
+                                 &si->rootcn, DEFAULT_CNODE_SLOTS, 1);
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_CREATE_ROOTCN);
     }
 
     /* Create taskcn */
-    err = cnode_create(&si->taskcn_cap, &si->taskcn, DEFAULT_CNODE_SLOTS, NULL);
+    err = slot_alloc(&si->taskcn_cap);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_SLOT_ALLOC);
+    }
+    err = spawn_ram_cnode_create(si, SPAWN_OBJ_TASKCN, si->taskcn_cap,
+                                 &si->taskcn, DEFAULT_CNODE_SLOTS, 1);
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_CREATE_TASKCN);
     }
@@ -59,22 +69,14 @@ static errval_t spawn_setup_cspace(struct spawninfo *si)
         return err_push(err, SPAWN_ERR_MINT_TASKCN);
     }
 
-    /* Create slot_alloc_cnode */
+    /* Create slot_alloc_cnodes, which live in consecutive slots */
+    STATIC_ASSERT(ROOTCN_SLOT_SLOT_ALLOC1 == ROOTCN_SLOT_SLOT_ALLOC0 + 1 &&
+                  ROOTCN_SLOT_SLOT_ALLOC2 == ROOTCN_SLOT_SLOT_ALLOC0 + 2,
+                  "slot allocator cnodes must be adjacent");
     t1.cnode = si->rootcn;
     t1.slot  = ROOTCN_SLOT_SLOT_ALLOC0;
-    err = cnode_create_raw(t1, NULL, (1<<SLOT_ALLOC_CNODE_BITS), NULL);
-    if (err_is_fail(err)) {
-        return err_push(err, SPAWN_ERR_CREATE_SLOTALLOC_CNODE);
-    }
-    t1.cnode = si->rootcn;
-    t1.slot  = ROOTCN_SLOT_SLOT_ALLOC1;
-    err = cnode_create_raw(t1, NULL, (1<<SLOT_ALLOC_CNODE_BITS), NULL);
-    if (err_is_fail(err)) {
-        return err_push(err, SPAWN_ERR_CREATE_SLOTALLOC_CNODE);
-    }
-    t1.cnode = si->rootcn;
-    t1.slot  = ROOTCN_SLOT_SLOT_ALLOC2;
-    err = cnode_create_raw(t1, NULL, (1<<SLOT_ALLOC_CNODE_BITS), NULL);
+    err = spawn_ram_cnode_create(si, SPAWN_OBJ_SLOT_ALLOC_CN, t1, NULL,
+                                 (1<<SLOT_ALLOC_CNODE_BITS), 3);
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_CREATE_SLOTALLOC_CNODE);
     }
@@ -125,34 +127,19 @@ static errval_t spawn_setup_cspace(struct spawninfo *si)
     // Create basecn in rootcn
     basecn_cap.cnode = si->rootcn;
     basecn_cap.slot  = ROOTCN_SLOT_BASE_PAGE_CN;
-    err = cnode_create_raw(basecn_cap, &basecn, DEFAULT_CNODE_SLOTS, NULL);
+    err = spawn_ram_cnode_create(si, SPAWN_OBJ_BASECN, basecn_cap, &basecn,
+                                 DEFAULT_CNODE_SLOTS, 1);
     if (err_is_fail(err)) {
         return err_push(err, LIB_ERR_CNODE_CREATE);
     }
 
     // Place the ram caps
-    for (uint8_t i = 0; i < DEFAULT_CNODE_SLOTS; i++) {
-        struct capref base = {
-            .cnode = basecn,
-            .slot  = i
-        };
-        struct capref ram;
-        err = ram_alloc(&ram, BASE_PAGE_BITS);
-        if (err_is_fail(err)) {
-            return err_push(err, LIB_ERR_RAM_ALLOC);
-        }
-        err = cap_copy(base, ram);
-
-        if (err_is_fail(err)) {
-            return err_push(err, LIB_ERR_CAP_COPY);
-        }
-        err = cap_destroy(ram);
-        if (err_is_fail(err)) {
-            return err_push(err, LIB_ERR_CAP_DESTROY);
-        }
-    }
-
-    return SYS_ERR_OK;
+    struct capref base = {
+        .cnode = basecn,
+        .slot  = 0
+    };
+    return spawn_ram_pages_create(si, SPAWN_OBJ_BASE_PAGES, base,
+                                  DEFAULT_CNODE_SLOTS);
 }
 
 static errval_t spawn_setup_vspace(struct spawninfo *si)
@@ -161,7 +148,8 @@ static errval_t spawn_setup_vspace(struct spawninfo *si)
 
     /* Create pagecn */
     si->pagecn_cap = (struct capref){.cnode = si->rootcn, .slot = ROOTCN_SLOT_PAGECN};
-    err = cnode_create_raw(si->pagecn_cap, &si->pagecn, PAGE_CNODE_SLOTS, NULL);
+    err = spawn_ram_cnode_create(si, SPAWN_OBJ_PAGECN, si->pagecn_cap,
+                                 &si->pagecn, PAGE_CNODE_SLOTS, 1);
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_CREATE_PAGECN);
     }
@@ -192,23 +180,28 @@ static errval_t spawn_setup_vspace(struct spawninfo *si)
     switch(si->cpu_type) {
     case CPU_X86_64:
     case CPU_K1OM:
-        err = vnode_create(si->vtree, ObjType_VNode_x86_64_pml4);
+        err = spawn_ram_vnode_create(si, SPAWN_OBJ_VROOT, si->vtree,
+                                     ObjType_VNode_x86_64_pml4);
         break;
 
     case CPU_X86_32:
 #ifdef CONFIG_PAE
-        err = vnode_create(si->vtree, ObjType_VNode_x86_32_pdpt);
+        err = spawn_ram_vnode_create(si, SPAWN_OBJ_VROOT, si->vtree,
+                                     ObjType_VNode_x86_32_pdpt);
 #else
-        err = vnode_create(si->vtree, ObjType_VNode_x86_32_pdir);
+        err = spawn_ram_vnode_create(si, SPAWN_OBJ_VROOT, si->vtree,
+                                     ObjType_VNode_x86_32_pdir);
 #endif
         break;
 
     case CPU_ARM7:
-        err = vnode_create(si->vtree, ObjType_VNode_ARM_l1);
+        err = spawn_ram_vnode_create(si, SPAWN_OBJ_VROOT, si->vtree,
+                                     ObjType_VNode_ARM_l1);
         break;
 
     case CPU_ARM8:
-        err = vnode_create(si->vtree, ObjType_VNode_AARCH64_l1);
+        err = spawn_ram_vnode_create(si, SPAWN_OBJ_VROOT, si->vtree,
+                                     ObjType_VNode_AARCH64_l1);
         break;
 
     default:
@@ -303,7 +296,8 @@ static errval_t spawn_setup_dispatcher(struct spawninfo *si,
     /* Create dispatcher frame (in taskcn) */
     si->dispframe.cnode = si->taskcn;
     si->dispframe.slot  = TASKCN_SLOT_DISPFRAME;
-    err = frame_create(si->dispframe, (1 << DISPATCHER_FRAME_BITS), NULL);
+    err = spawn_ram_frame_create(si, SPAWN_OBJ_DISPFRAME, si->dispframe,
+                                 (1 << DISPATCHER_FRAME_BITS));
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_CREATE_DISPATCHER_FRAME);
     }
@@ -474,11 +468,14 @@ static errval_t spawn_setup_env(struct spawninfo *si,
     // Create frame (actually multiple pages) for arguments
     si->argspg.cnode = si->taskcn;
     si->argspg.slot  = TASKCN_SLOT_ARGSPAGE;
-    err = frame_create(si->argspg, ARGS_SIZE, NULL);
+    err = spawn_ram_frame_create(si, SPAWN_OBJ_ARGSPG, si->argspg, ARGS_SIZE);
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_CREATE_ARGSPG);
     }
 
+    // This was the last of the batch-allocated objects
+    spawn_ram_free(si);
+
     /* Map in args frame */
     genvaddr_t spawn_args_base;
     err = spawn_vspace_map_one_frame(si, &spawn_args_base, si->argspg, ARGS_SIZE);
@@ -672,52 +669,92 @@ static errval_t spawn_setup_argcn(struct spawninfo *si,
 }
 
 
+static const char *spawn_phase_names[SPAWN_PHASE_COUNT] = {
+    [SPAWN_PHASE_RAM]        = "ram",
+    [SPAWN_PHASE_CSPACE]     = "cspace",
+    [SPAWN_PHASE_VSPACE]     = "vspace",
+    [SPAWN_PHASE_LOAD]       = "load",
+    [SPAWN_PHASE_DISPATCHER] = "dispatcher",
+    [SPAWN_PHASE_ENV]        = "env",
+};
+
 /**
- * \brief Load an image
+ * \brief Return a printable name for a construction phase
+ */
+const char *spawn_phase_name(enum spawn_phase phase)
+{
+    if (phase >= SPAWN_PHASE_COUNT) {
+        return "unknown";
+    }
+    return spawn_phase_names[phase];
+}
+
+/**
+ * \brief Charge the cycles since \p start to \p phase
  *
- * \param si            Struct used by the library
- * \param binary        The image to load
- * \param type          The type of arch to load for
- * \param name          Name of the image required only to place it in disp
- *                      struct
- * \param coreid        Coreid to load for, required only to place it in disp
- *                      struct
- * \param argv          Command-line arguments, NULL-terminated
- * \param envp          Environment, NULL-terminated
- * \param inheritcn_cap Cap to a CNode containing capabilities to be inherited
- * \param argcn_cap     Cap to a CNode containing capabilities passed as
- *                      arguments
+ * \return the current timestamp, to be used as start of the next phase
  */
-errval_t spawn_load_image(struct spawninfo *si, lvaddr_t binary,
-                          size_t binary_size, enum cpu_type type,
-                          const char *name, coreid_t coreid,
-                          char *const argv[], char *const envp[],
-                          struct capref inheritcn_cap, struct capref argcn_cap)
+static inline uint64_t spawn_phase_end(struct spawninfo *si,
+                                       enum spawn_phase phase, uint64_t start)
+{
+    uint64_t now = TRACE_TIMESTAMP();
+    si->phase_cycles[phase] += now - start;
+    return now;
+}
+
+/**
+ * \brief Allocate the kernel objects of a new domain and set up its cspace
+ * and vspace
+ *
+ * si->cpu_type must be set.
+ *
+ * \param si    Struct used by the library
+ * \param start Returns the timestamp at the end of the vspace setup
+ */
+static errval_t spawn_setup_domain(struct spawninfo *si, uint64_t *start)
 {
     errval_t err;
 
-    si->cpu_type = type;
+    memset(si->phase_cycles, 0, sizeof(si->phase_cycles));
+    uint64_t t = TRACE_TIMESTAMP();
+
+    /* Get the memory for all objects at once */
+    err = spawn_ram_alloc(si, true);
+    if (err_is_fail(err)) {
+        return err_push(err, SPAWN_ERR_SETUP_CSPACE);
+    }
+    t = spawn_phase_end(si, SPAWN_PHASE_RAM, t);
 
     /* Initialize cspace */
     err = spawn_setup_cspace(si);
     if (err_is_fail(err)) {
+        spawn_ram_free(si);
         return err_push(err, SPAWN_ERR_SETUP_CSPACE);
     }
+    t = spawn_phase_end(si, SPAWN_PHASE_CSPACE, t);
 
     /* Initialize vspace */
     err = spawn_setup_vspace(si);
     if (err_is_fail(err)) {
+        spawn_ram_free(si);
         return err_push(err, SPAWN_ERR_VSPACE_INIT);
     }
+    *start = spawn_phase_end(si, SPAWN_PHASE_VSPACE, t);
 
-    si->name = name;
-    genvaddr_t entry;
-    void* arch_info;
-    /* Load the image */
-    err = spawn_arch_load(si, binary, binary_size, &entry, &arch_info);
-    if (err_is_fail(err)) {
-        return err_push(err, SPAWN_ERR_LOAD);
-    }
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Common part of loading an image once its segments are in place
+ */
+static errval_t spawn_load_finish(struct spawninfo *si, coreid_t coreid,
+                                  const char *name, genvaddr_t entry,
+                                  void *arch_info,
+                                  char *const argv[], char *const envp[],
+                                  struct capref inheritcn_cap,
+                                  struct capref argcn_cap, uint64_t t)
+{
+    errval_t err;
 
     /* Setup dispatcher frame */
     err = spawn_setup_dispatcher(si, coreid, name, entry, arch_info);
@@ -736,6 +773,7 @@ errval_t spawn_load_image(struct spawninfo *si, lvaddr_t binary,
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_SETUP_ARGCN);
     }
+    t = spawn_phase_end(si, SPAWN_PHASE_DISPATCHER, t);
 
     // Add vspace-pspace mapping to environment
     char envstr[2048];
@@ -775,10 +813,106 @@ errval_t spawn_load_image(struct spawninfo *si, lvaddr_t binary,
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_SETUP_ENV);
     }
+    spawn_phase_end(si, SPAWN_PHASE_ENV, t);
 
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Load an image
+ *
+ * \param si            Struct used by the library
+ * \param binary        The image to load
+ * \param type          The type of arch to load for
+ * \param name          Name of the image required only to place it in disp
+ *                      struct
+ * \param coreid        Coreid to load for, required only to place it in disp
+ *                      struct
+ * \param argv          Command-line arguments, NULL-terminated
+ * \param envp          Environment, NULL-terminated
+ * \param inheritcn_cap Cap to a CNode containing capabilities to be inherited
+ * \param argcn_cap     Cap to a CNode containing capabilities passed as
+ *                      arguments
+ */
+errval_t spawn_load_image(struct spawninfo *si, lvaddr_t binary,
+                          size_t binary_size, enum cpu_type type,
+                          const char *name, coreid_t coreid,
+                          char *const argv[], char *const envp[],
+                          struct capref inheritcn_cap, struct capref argcn_cap)
+{
+    errval_t err;
+
+    si->cpu_type = type;
+
+    /* Initialize cspace and vspace */
+    uint64_t t;
+    err = spawn_setup_domain(si, &t);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    si->name = name;
+    genvaddr_t entry;
+    void* arch_info;
+    /* Load the image */
+    err = spawn_arch_load(si, binary, binary_size, &entry, &arch_info);
+    if (err_is_fail(err)) {
+        return err_push(err, SPAWN_ERR_LOAD);
+    }
+    t = spawn_phase_end(si, SPAWN_PHASE_LOAD, t);
+
+    return spawn_load_finish(si, coreid, name, entry, arch_info, argv, envp,
+                             inheritcn_cap, argcn_cap, t);
+}
+
+/**
+ * \brief Load a domain from a shared, pre-loaded image
+ *
+ * Like #spawn_load_image, but read-only segments are mapped from \p img
+ * instead of being loaded from the ELF binary again, and writable segments
+ * are copied from the pre-loaded version.
+ *
+ * \param si            Struct used by the library
+ * \param img           Image created by #spawn_image_create
+ * \param name          Name of the image required only to place it in disp
+ *                      struct
+ * \param coreid        Coreid to load for, required only to place it in disp
+ *                      struct
+ * \param argv          Command-line arguments, NULL-terminated
+ * \param envp          Environment, NULL-terminated
+ * \param inheritcn_cap Cap to a CNode containing capabilities to be inherited
+ * \param argcn_cap     Cap to a CNode containing capabilities passed as
+ *                      arguments
+ */
+errval_t spawn_load_shared_image(struct spawninfo *si, struct spawn_image *img,
+                                 const char *name, coreid_t coreid,
+                                 char *const argv[], char *const envp[],
+                                 struct capref inheritcn_cap,
+                                 struct capref argcn_cap)
+{
+    errval_t err;
+
+    si->cpu_type = img->cpu_type;
+
+    /* Initialize cspace and vspace */
+    uint64_t t;
+    err = spawn_setup_domain(si, &t);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    /* Map the segments of the image */
+    si->name = name;
+    err = spawn_image_instantiate(si, img);
+    if (err_is_fail(err)) {
+        return err_push(err, SPAWN_ERR_LOAD);
+    }
+    t = spawn_phase_end(si, SPAWN_PHASE_LOAD, t);
+
+    return spawn_load_finish(si, coreid, name, img->entry, img->arch_info,
+                             argv, envp, inheritcn_cap, argcn_cap, t);
+}
+
 /**
  * \brief Spawn a domain with the given args
  */
@@ -803,16 +937,11 @@ errval_t spawn_load_with_args(struct spawninfo *si, struct mem_region *module,
         return err_push(err, SPAWN_ERR_DETERMINE_CPUTYPE);
     }
 
-    /* Initialize cspace */
-    err = spawn_setup_cspace(si);
-    if (err_is_fail(err)) {
-        return err_push(err, SPAWN_ERR_SETUP_CSPACE);
-    }
-
-    /* Initialize vspace */
-    err = spawn_setup_vspace(si);
+    /* Initialize cspace and vspace */
+    uint64_t t;
+    err = spawn_setup_domain(si, &t);
     if (err_is_fail(err)) {
-        return err_push(err, SPAWN_ERR_VSPACE_INIT);
+        return err;
     }
 
     /* Load the image */
@@ -823,18 +952,21 @@ errval_t spawn_load_with_args(struct spawninfo *si, struct mem_region *module,
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_LOAD);
     }
+    t = spawn_phase_end(si, SPAWN_PHASE_LOAD, t);
 
     /* Setup dispatcher frame */
     err = spawn_setup_dispatcher(si, coreid, name, entry, arch_info);
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_SETUP_DISPATCHER);
     }
+    t = spawn_phase_end(si, SPAWN_PHASE_DISPATCHER, t);
 
     /* Setup cmdline args */
     err = spawn_setup_env(si, argv, envp);
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_SETUP_ENV);
     }
+    spawn_phase_end(si, SPAWN_PHASE_ENV, t);
 
     return SYS_ERR_OK;
 }
@@ -869,16 +1001,11 @@ errval_t spawn_load_with_bootinfo(struct spawninfo *si, struct bootinfo *bi,
         return err_push(err, SPAWN_ERR_DETERMINE_CPUTYPE);
     }
 
-    /* Initialize cspace */
-    err = spawn_setup_cspace(si);
+    /* Initialize cspace and vspace */
+    uint64_t t;
+    err = spawn_setup_domain(si, &t);
     if (err_is_fail(err)) {
-        return err_push(err, SPAWN_ERR_SETUP_CSPACE);
-    }
-
-    /* Initialize vspace */
-    err = spawn_setup_vspace(si);
-    if (err_is_fail(err)) {
-        return err_push(err, SPAWN_ERR_VSPACE_INIT);
+        return err;
     }
 
     /* Load the image */
@@ -889,12 +1016,14 @@ errval_t spawn_load_with_bootinfo(struct spawninfo *si, struct bootinfo *bi,
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_LOAD);
     }
+    t = spawn_phase_end(si, SPAWN_PHASE_LOAD, t);
 
     /* Setup dispatcher frame */
     err = spawn_setup_dispatcher(si, coreid, name, entry, arch_info);
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_SETUP_DISPATCHER);
     }
+    t = spawn_phase_end(si, SPAWN_PHASE_DISPATCHER, t);
 
     /* Map bootinfo */
     // XXX: Confusion address translation about l/gen/addr in entry
@@ -945,6 +1074,7 @@ errval_t spawn_load_with_bootinfo(struct spawninfo *si, struct bootinfo *bi,
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_SETUP_ENV);
     }
+    spawn_phase_end(si, SPAWN_PHASE_ENV, t);
     free(multiboot_args);
 
     // unmap bootinfo module pages
@@ -964,6 +1094,7 @@ errval_t spawn_run(struct spawninfo *si)
 
 errval_t spawn_free(struct spawninfo *si)
 {
+    spawn_ram_free(si);
     cap_destroy(si->rootcn_cap);
     cap_destroy(si->taskcn_cap);
     cap_destroy(si->pagecn_cap);
@@ -988,16 +1119,23 @@ errval_t spawn_span_domain(struct spawninfo *si, struct capref vroot,
     struct capref t1;
     struct cnoderef cnode;
 
-    /* Spawn cspace */
+    /* Spawn cspace, vroot and dispatcher frame are provided */
+    err = spawn_ram_alloc(si, false);
+    if (err_is_fail(err)) {
+        return err;
+    }
     err = spawn_setup_cspace(si);
     if (err_is_fail(err)) {
+        spawn_ram_free(si);
         return err;
     }
 
     /* Create pagecn */
     t1.cnode = si->rootcn;
     t1.slot  = ROOTCN_SLOT_PAGECN;
-    err = cnode_create_raw(t1, &cnode, PAGE_CNODE_SLOTS, NULL);
+    err = spawn_ram_cnode_create(si, SPAWN_OBJ_PAGECN, t1, &cnode,
+                                 PAGE_CNODE_SLOTS, 1);
+    spawn_ram_free(si);
     if (err_is_fail(err)) {
         return err_push(err, SPAWN_ERR_CREATE_PAGECN);
     }
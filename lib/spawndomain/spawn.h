@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -23,4 +23,38 @@ errval_t spawn_symval_register(const char *binary, uint32_t idx,
                                const char *symname, genvaddr_t addres);
 errval_t spawn_symval_lookup(const char *binary, uint32_t idx, char **ret_name,
                              genvaddr_t *ret_addr);
+
+/* spawn_image.c */
+vregion_flags_t elf_to_vregion_flags(uint32_t flags);
+errval_t spawn_image_allocate(void *state, genvaddr_t base, size_t size,
+                              uint32_t flags, void **retbase);
+errval_t spawn_image_instantiate(struct spawninfo *si, struct spawn_image *img);
+
+/* spawn_ram.c */
+
+/// Kernel objects of a new domain that are allocated in one batch
+enum spawn_obj {
+    SPAWN_OBJ_ROOTCN,
+    SPAWN_OBJ_TASKCN,
+    SPAWN_OBJ_SLOT_ALLOC_CN,    ///< All three slot allocator CNodes
+    SPAWN_OBJ_BASECN,
+    SPAWN_OBJ_BASE_PAGES,       ///< RAM caps placed in basecn
+    SPAWN_OBJ_PAGECN,
+    SPAWN_OBJ_VROOT,
+    SPAWN_OBJ_DISPFRAME,
+    SPAWN_OBJ_ARGSPG,
+    SPAWN_OBJ_COUNT
+};
+
+errval_t spawn_ram_alloc(struct spawninfo *si, bool domain);
+void spawn_ram_free(struct spawninfo *si);
+errval_t spawn_ram_cnode_create(struct spawninfo *si, enum spawn_obj obj,
+                                struct capref dest, struct cnoderef *cnoderef,
+                                cslot_t slots, size_t count);
+errval_t spawn_ram_frame_create(struct spawninfo *si, enum spawn_obj obj,
+                                struct capref dest, size_t bytes);
+errval_t spawn_ram_vnode_create(struct spawninfo *si, enum spawn_obj obj,
+                                struct capref dest, enum objtype type);
+errval_t spawn_ram_pages_create(struct spawninfo *si, enum spawn_obj obj,
+                                struct capref dest, size_t count);
 #endif
@@ -0,0 +1,340 @@
+/**
+ * \file
+ * \brief Pre-loaded images that can be instantiated into many domains
+ *
+ * An image is loaded from the ELF binary once. Its read-only segments are
+ * shared between all domains spawned from it, while writable segments are
+ * copied from the pristine pre-loaded version into fresh frames.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <spawndomain/spawndomain.h>
+#include <elf/elf.h>
+#include "spawn.h"
+#include "arch.h"
+
+/**
+ * \brief Convert elf flags to vregion flags
+ */
+vregion_flags_t elf_to_vregion_flags(uint32_t flags)
+{
+    vregion_flags_t vregion_flags = 0;
+
+    if (flags & PF_R) {
+        vregion_flags |= VREGION_FLAGS_READ;
+    }
+    if (flags & PF_W) {
+        vregion_flags |= VREGION_FLAGS_WRITE;
+    }
+    if (flags & PF_X) {
+        vregion_flags |= VREGION_FLAGS_EXECUTE;
+    }
+
+    return vregion_flags;
+}
+
+/**
+ * \brief Back a mapped anonymous memobj with the frames of a segment
+ *
+ * The frames start at \p slot in \p cnode and are split into power-of-two
+ * pieces the same way #segment_alloc_local creates them.
+ */
+static errval_t segment_fill(struct memobj *memobj, struct vregion *vregion,
+                             struct cnoderef cnode, cslot_t slot, size_t size)
+{
+    errval_t err;
+
+    size_t sz = 0;
+    for (lvaddr_t offset = 0; offset < size; offset += sz) {
+        sz = 1UL << log2floor(size - offset);
+        struct capref frame = {
+            .cnode = cnode,
+            .slot  = slot++,
+        };
+        genvaddr_t genvaddr = vspace_lvaddr_to_genvaddr(offset);
+        err = memobj->f.fill(memobj, genvaddr, frame, sz);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_MEMOBJ_FILL);
+        }
+        err = memobj->f.pagefault(memobj, vregion, offset, 0);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_MEMOBJ_PAGEFAULT_HANDLER);
+        }
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Create the frames for a segment and map them into our vspace
+ *
+ * \param cnode       CNode to create the frames in, of DEFAULT_CNODE_SLOTS
+ * \param slot        Next free slot in \p cnode, updated on return
+ * \param size        Page-aligned size of the segment
+ * \param retvregion  Returns the local mapping
+ * \param retbuf      Returns the address of the local mapping
+ */
+static errval_t segment_alloc_local(struct cnoderef cnode, cslot_t *slot,
+                                    size_t size, struct vregion **retvregion,
+                                    void **retbuf)
+{
+    errval_t err;
+    cslot_t first_slot = *slot;
+
+    size_t sz = 0;
+    for (lpaddr_t offset = 0; offset < size; offset += sz) {
+        sz = 1UL << log2floor(size - offset);
+        if (*slot >= DEFAULT_CNODE_SLOTS) {
+            return SPAWN_ERR_SEGCN_FULL;
+        }
+        struct capref frame = {
+            .cnode = cnode,
+            .slot  = (*slot)++,
+        };
+        err = frame_create(frame, sz, NULL);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_FRAME_CREATE);
+        }
+    }
+
+    struct memobj *memobj = malloc(sizeof(struct memobj_anon));
+    if (memobj == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    struct vregion *vregion = malloc(sizeof(struct vregion));
+    if (vregion == NULL) {
+        free(memobj);
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    err = memobj_create_anon((struct memobj_anon*)memobj, size, 0);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_MEMOBJ_CREATE_ANON);
+    }
+    err = vregion_map(vregion, get_current_vspace(), memobj, 0, size,
+                      VREGION_FLAGS_READ_WRITE);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_VSPACE_MAP);
+    }
+    err = segment_fill(memobj, vregion, cnode, first_slot, size);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    *retvregion = vregion;
+    *retbuf = (void *)vspace_genvaddr_to_lvaddr(vregion_get_base_addr(vregion));
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief ELF allocator recording the segments of an image
+ */
+errval_t spawn_image_allocate(void *state, genvaddr_t base, size_t size,
+                              uint32_t flags, void **retbase)
+{
+    errval_t err;
+    struct spawn_image *img = state;
+
+    if (img->segments >= SPAWN_IMAGE_MAX_SEGMENTS) {
+        return SPAWN_ERR_IMAGE_SEGMENTS;
+    }
+
+    // Increase size by space wasted on first page due to page-alignment
+    size_t base_offset = BASE_PAGE_OFFSET(base);
+    size += base_offset;
+    base -= base_offset;
+    // Page-align
+    size = ROUND_UP(size, BASE_PAGE_SIZE);
+
+    struct spawn_image_segment *seg = &img->segment[img->segments];
+    seg->base = base;
+    seg->size = size;
+    seg->flags = elf_to_vregion_flags(flags);
+    seg->first_slot = img->next_slot;
+
+    err = segment_alloc_local(img->cnode, &img->next_slot, size, &seg->vregion,
+                              &seg->buf);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    seg->nslots = img->next_slot - seg->first_slot;
+    img->segments++;
+
+    *retbase = (char *)seg->buf + base_offset;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Pre-load an ELF binary so that it can be spawned repeatedly
+ *
+ * \param retimg      Returns the image, to be freed with #spawn_image_destroy
+ * \param binary      The ELF binary, which can be freed after this returns
+ * \param binary_size Size of the ELF binary
+ * \param type        The type of arch to load for
+ */
+errval_t spawn_image_create(struct spawn_image **retimg, lvaddr_t binary,
+                            size_t binary_size, enum cpu_type type)
+{
+    errval_t err;
+
+    struct spawn_image *img = calloc(1, sizeof(struct spawn_image));
+    if (img == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    img->cpu_type = type;
+
+    err = cnode_create(&img->cnode_cap, &img->cnode, DEFAULT_CNODE_SLOTS, NULL);
+    if (err_is_fail(err)) {
+        free(img);
+        return err_push(err, SPAWN_ERR_CREATE_SEGCN);
+    }
+
+    err = spawn_arch_image_load(img, binary, binary_size);
+    if (err_is_fail(err)) {
+        spawn_image_destroy(img);
+        return err_push(err, SPAWN_ERR_CREATE_IMAGE);
+    }
+
+    *retimg = img;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Free an image
+ *
+ * Domains spawned from the image hold their own copies of the frame
+ * capabilities and are not affected.
+ */
+errval_t spawn_image_destroy(struct spawn_image *img)
+{
+    errval_t err;
+
+    for (unsigned int i = 0; i < img->segments; i++) {
+        struct spawn_image_segment *seg = &img->segment[i];
+        struct memobj *memobj = vregion_get_memobj(seg->vregion);
+        err = memobj_destroy_anon(memobj);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "memobj_destroy_anon");
+        }
+        free(memobj);
+        free(seg->vregion);
+    }
+
+    err = cap_destroy(img->cnode_cap);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_CAP_DESTROY);
+    }
+
+    free(img);
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Return the number of bytes shared by all domains spawned from \p img
+ */
+size_t spawn_image_shared_bytes(struct spawn_image *img)
+{
+    size_t bytes = 0;
+
+    for (unsigned int i = 0; i < img->segments; i++) {
+        if (!(img->segment[i].flags & VREGION_FLAGS_WRITE)) {
+            bytes += img->segment[i].size;
+        }
+    }
+
+    return bytes;
+}
+
+/**
+ * \brief Map the segments of an image into the domain being spawned
+ *
+ * Read-only segments reference the frames of the image, writable segments
+ * are backed by new frames initialised from the image.
+ */
+errval_t spawn_image_instantiate(struct spawninfo *si, struct spawn_image *img)
+{
+    errval_t err;
+
+    // Reset the elfloader_slot
+    si->elfload_slot = 0;
+    si->vregions = 0;
+
+    struct capref cnode_cap = {
+        .cnode = si->rootcn,
+        .slot  = ROOTCN_SLOT_SEGCN,
+    };
+    err = cnode_create_raw(cnode_cap, &si->segcn, DEFAULT_CNODE_SLOTS, NULL);
+    if (err_is_fail(err)) {
+        return err_push(err, SPAWN_ERR_CREATE_SEGCN);
+    }
+
+    si->tls_init_base = img->tls_init_base;
+    si->tls_init_len = img->tls_init_len;
+    si->tls_total_len = img->tls_total_len;
+    si->eh_frame = img->eh_frame;
+    si->eh_frame_size = img->eh_frame_size;
+    si->eh_frame_hdr = img->eh_frame_hdr;
+    si->eh_frame_hdr_size = img->eh_frame_hdr_size;
+
+    for (unsigned int i = 0; i < img->segments; i++) {
+        struct spawn_image_segment *seg = &img->segment[i];
+        cslot_t first_slot = si->elfload_slot;
+        struct vregion *vregion;
+
+        if (seg->flags & VREGION_FLAGS_WRITE) {
+            void *buf;
+            err = segment_alloc_local(si->segcn, &si->elfload_slot, seg->size,
+                                      &vregion, &buf);
+            if (err_is_fail(err)) {
+                return err_push(err, SPAWN_ERR_MAP_IMAGE_SEGMENT);
+            }
+            memcpy(buf, seg->buf, seg->size);
+        } else {
+            for (cslot_t s = 0; s < seg->nslots; s++) {
+                struct capref src = {
+                    .cnode = img->cnode,
+                    .slot  = seg->first_slot + s,
+                };
+                struct capref dest = {
+                    .cnode = si->segcn,
+                    .slot  = si->elfload_slot++,
+                };
+                err = cap_copy(dest, src);
+                if (err_is_fail(err)) {
+                    return err_push(err, LIB_ERR_CAP_COPY);
+                }
+            }
+            vregion = seg->vregion;
+        }
+
+        /* Map into spawn vspace */
+        struct memobj *spawn_memobj = NULL;
+        struct vregion *spawn_vregion = NULL;
+        err = spawn_vspace_map_anon_fixed_attr(si, seg->base, seg->size,
+                                               &spawn_vregion, &spawn_memobj,
+                                               seg->flags);
+        if (err_is_fail(err)) {
+            return err_push(err, SPAWN_ERR_VSPACE_MAP);
+        }
+        err = segment_fill(spawn_memobj, spawn_vregion, si->segcn, first_slot,
+                           seg->size);
+        if (err_is_fail(err)) {
+            return err_push(err, SPAWN_ERR_MAP_IMAGE_SEGMENT);
+        }
+
+        si->vregion[si->vregions] = vregion;
+        si->base[si->vregions++] = seg->base;
+    }
+
+    return SYS_ERR_OK;
+}
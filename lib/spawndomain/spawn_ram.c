@@ -0,0 +1,310 @@
+/**
+ * \file
+ * \brief Batched allocation of the kernel objects of a new domain
+ *
+ * Every new domain needs the same set of CNodes, frames and RAM caps. Each
+ * of them used to be allocated with its own request to the memory server.
+ * Their sizes are all known before construction starts, so we lay them out
+ * in a few naturally-aligned chunks of RAM, allocate those up front, and
+ * retype the objects out of the chunks as construction reaches them.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <barrelfish/barrelfish.h>
+#include <spawndomain/spawndomain.h>
+#include "spawn.h"
+
+/// Upper bound on the number of chunks, one per bit of the total size
+#define SPAWN_RAM_CHUNKS    (sizeof(gensize_t) * 8)
+
+/// A run of objects retyped from one chunk with a single invocation
+struct spawn_ram_extent {
+    size_t chunk;
+    gensize_t offset;
+    size_t count;
+};
+
+struct spawn_ram_batch {
+    struct capref chunk[SPAWN_RAM_CHUNKS];
+    uint8_t chunk_bits[SPAWN_RAM_CHUNKS];
+    size_t nchunks;
+
+    struct {
+        bool wanted;        ///< Objects are allocated from this batch
+        uint8_t bits;       ///< log2 of the size of one object in bytes
+        size_t count;       ///< Number of objects
+        struct spawn_ram_extent extent[SPAWN_RAM_CHUNKS];
+        size_t extents;
+    } obj[SPAWN_OBJ_COUNT];
+};
+
+static enum objtype vroot_type(enum cpu_type cpu_type)
+{
+    switch (cpu_type) {
+    case CPU_X86_64:
+    case CPU_K1OM:
+        return ObjType_VNode_x86_64_pml4;
+    case CPU_X86_32:
+#ifdef CONFIG_PAE
+        return ObjType_VNode_x86_32_pdpt;
+#else
+        return ObjType_VNode_x86_32_pdir;
+#endif
+    case CPU_ARM7:
+        return ObjType_VNode_ARM_l1;
+    case CPU_ARM8:
+        return ObjType_VNode_AARCH64_l1;
+    default:
+        return ObjType_Null;
+    }
+}
+
+static void want(struct spawn_ram_batch *b, enum spawn_obj obj, uint8_t bits,
+                 size_t count)
+{
+    b->obj[obj].wanted = true;
+    b->obj[obj].bits = bits;
+    b->obj[obj].count = count;
+}
+
+static void batch_free(struct spawn_ram_batch *b)
+{
+    for (size_t i = 0; i < b->nchunks; i++) {
+        errval_t err = cap_destroy(b->chunk[i]);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "cap_destroy");
+        }
+    }
+    free(b);
+}
+
+/**
+ * \brief Allocate the RAM for the kernel objects of a domain in one batch
+ *
+ * The objects are sorted by size and packed into chunks whose sizes are the
+ * bits set in the total size, so no memory is wasted and every object ends
+ * up naturally aligned. If the memory server cannot provide the chunks, the
+ * objects are allocated one by one as before.
+ *
+ * \param si     Spawninfo, with cpu_type set if \p domain is true
+ * \param domain Also allocate the objects for the vspace, dispatcher and
+ *               arguments, rather than just the cspace
+ */
+errval_t spawn_ram_alloc(struct spawninfo *si, bool domain)
+{
+    errval_t err;
+
+    si->ram = NULL;
+
+    struct spawn_ram_batch *b = calloc(1, sizeof(*b));
+    if (b == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    want(b, SPAWN_OBJ_ROOTCN, DEFAULT_CNODE_BITS + OBJBITS_CTE, 1);
+    want(b, SPAWN_OBJ_TASKCN, DEFAULT_CNODE_BITS + OBJBITS_CTE, 1);
+    want(b, SPAWN_OBJ_SLOT_ALLOC_CN, SLOT_ALLOC_CNODE_BITS + OBJBITS_CTE, 3);
+    want(b, SPAWN_OBJ_BASECN, DEFAULT_CNODE_BITS + OBJBITS_CTE, 1);
+    want(b, SPAWN_OBJ_BASE_PAGES, BASE_PAGE_BITS, DEFAULT_CNODE_SLOTS);
+    want(b, SPAWN_OBJ_PAGECN, PAGE_CNODE_BITS + OBJBITS_CTE, 1);
+    if (domain) {
+        enum objtype type = vroot_type(si->cpu_type);
+        if (type != ObjType_Null) {
+            want(b, SPAWN_OBJ_VROOT, vnode_objbits(type), 1);
+        }
+        want(b, SPAWN_OBJ_DISPFRAME, DISPATCHER_FRAME_BITS, 1);
+        want(b, SPAWN_OBJ_ARGSPG, ARGS_FRAME_BITS, 1);
+    }
+
+    gensize_t total = 0;
+    for (int i = 0; i < SPAWN_OBJ_COUNT; i++) {
+        if (b->obj[i].wanted) {
+            total += (gensize_t)b->obj[i].count << b->obj[i].bits;
+        }
+    }
+
+    /* Allocate one chunk for every bit set in the total, largest first */
+    for (int bit = SPAWN_RAM_CHUNKS - 1; bit >= 0; bit--) {
+        if (!(total & ((gensize_t)1 << bit))) {
+            continue;
+        }
+        err = ram_alloc(&b->chunk[b->nchunks], bit);
+        if (err_is_fail(err)) {
+            batch_free(b);
+            return SYS_ERR_OK;
+        }
+        b->chunk_bits[b->nchunks++] = bit;
+    }
+
+    /*
+     * Place objects largest first. As all sizes are powers of two, the space
+     * left in a chunk is always a multiple of the next object's size, so
+     * every chunk is filled exactly. Objects of one kind are placed next to
+     * each other where possible so they can be retyped together.
+     */
+    size_t chunk = 0;
+    gensize_t offset = 0;
+    for (int bits = SPAWN_RAM_CHUNKS - 1; bits >= 0; bits--) {
+        for (int i = 0; i < SPAWN_OBJ_COUNT; i++) {
+            if (!b->obj[i].wanted || b->obj[i].bits != bits) {
+                continue;
+            }
+            size_t left = b->obj[i].count;
+            while (left > 0) {
+                assert(chunk < b->nchunks);
+                gensize_t space = ((gensize_t)1 << b->chunk_bits[chunk]) - offset;
+                size_t n = (space >> bits) < left ? space >> bits : left;
+                if (n == 0) {
+                    chunk++;
+                    offset = 0;
+                    continue;
+                }
+                b->obj[i].extent[b->obj[i].extents++] = (struct spawn_ram_extent) {
+                    .chunk = chunk, .offset = offset, .count = n,
+                };
+                offset += (gensize_t)n << bits;
+                left -= n;
+            }
+        }
+    }
+
+    si->ram = b;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Release the chunks once all objects have been created
+ *
+ * The objects keep their memory, only the chunk capabilities are deleted.
+ */
+void spawn_ram_free(struct spawninfo *si)
+{
+    if (si->ram != NULL) {
+        batch_free(si->ram);
+        si->ram = NULL;
+    }
+}
+
+/**
+ * \brief Retype all objects of one kind from the batch into consecutive slots
+ *
+ * \return true if the objects were created from the batch, false if they are
+ *         not part of it and have to be allocated individually
+ */
+static bool batch_retype(struct spawninfo *si, enum spawn_obj obj,
+                         struct capref dest, enum objtype type,
+                         size_t objsize, errval_t *reterr)
+{
+    struct spawn_ram_batch *b = si->ram;
+
+    if (b == NULL || !b->obj[obj].wanted) {
+        return false;
+    }
+
+    *reterr = SYS_ERR_OK;
+    for (size_t i = 0; i < b->obj[obj].extents; i++) {
+        struct spawn_ram_extent *e = &b->obj[obj].extent[i];
+        errval_t err = cap_retype(dest, b->chunk[e->chunk], e->offset, type,
+                                  objsize, e->count);
+        if (err_is_fail(err)) {
+            *reterr = err_push(err, LIB_ERR_CAP_RETYPE);
+            break;
+        }
+        dest.slot += e->count;
+    }
+
+    // the objects cannot be created a second time from the batch
+    b->obj[obj].wanted = false;
+    return true;
+}
+
+/**
+ * \brief Create \p count CNodes of \p slots slots in consecutive slots
+ */
+errval_t spawn_ram_cnode_create(struct spawninfo *si, enum spawn_obj obj,
+                                struct capref dest, struct cnoderef *cnoderef,
+                                cslot_t slots, size_t count)
+{
+    errval_t err;
+
+    if (batch_retype(si, obj, dest, ObjType_CNode, slots, &err)) {
+        if (err_is_ok(err) && cnoderef != NULL) {
+            *cnoderef = build_cnoderef(dest, log2ceil(slots));
+        }
+        return err;
+    }
+
+    for (size_t i = 0; i < count; i++, dest.slot++) {
+        err = cnode_create_raw(dest, i == 0 ? cnoderef : NULL, slots, NULL);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Create a frame of \p bytes bytes
+ */
+errval_t spawn_ram_frame_create(struct spawninfo *si, enum spawn_obj obj,
+                                struct capref dest, size_t bytes)
+{
+    errval_t err;
+
+    if (batch_retype(si, obj, dest, ObjType_Frame, bytes, &err)) {
+        return err;
+    }
+    return frame_create(dest, bytes, NULL);
+}
+
+/**
+ * \brief Create a VNode of the given type
+ */
+errval_t spawn_ram_vnode_create(struct spawninfo *si, enum spawn_obj obj,
+                                struct capref dest, enum objtype type)
+{
+    errval_t err;
+
+    if (batch_retype(si, obj, dest, type, 0, &err)) {
+        return err;
+    }
+    return vnode_create(dest, type);
+}
+
+/**
+ * \brief Fill \p count slots starting at \p dest with base-page-sized RAM caps
+ */
+errval_t spawn_ram_pages_create(struct spawninfo *si, enum spawn_obj obj,
+                                struct capref dest, size_t count)
+{
+    errval_t err;
+
+    if (batch_retype(si, obj, dest, ObjType_RAM, BASE_PAGE_SIZE, &err)) {
+        return err;
+    }
+
+    for (size_t i = 0; i < count; i++, dest.slot++) {
+        struct capref ram;
+        err = ram_alloc(&ram, BASE_PAGE_BITS);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_RAM_ALLOC);
+        }
+        err = cap_copy(dest, ram);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_CAP_COPY);
+        }
+        err = cap_destroy(ram);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_CAP_DESTROY);
+        }
+    }
+    return SYS_ERR_OK;
+}
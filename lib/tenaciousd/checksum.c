@@ -0,0 +1,58 @@
+/**
+ * \file
+ * \brief CRC32C (Castagnoli) checksum of on-disk records
+ *
+ * Table-driven, the table is built on first use.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "checksum.h"
+
+#define CRC32C_POLY     0x82f63b78      // reversed
+
+static uint32_t crc_table[256];
+static bool crc_table_valid = false;
+
+static void crc_table_init(void)
+{
+    for(uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+
+        for(int k = 0; k < 8; k++) {
+            c = c & 1 ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+    crc_table_valid = true;
+}
+
+/**
+ * \brief Continue the checksum \p crc over \p len bytes at \p buf.
+ *
+ * Start with a crc of 0.
+ */
+uint32_t tenaciousd_crc32c(uint32_t crc, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+
+    if(!crc_table_valid) {
+        crc_table_init();
+    }
+
+    crc = ~crc;
+    for(size_t i = 0; i < len; i++) {
+        crc = crc_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
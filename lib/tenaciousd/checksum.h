@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef TENACIOUSD_CHECKSUM_H
+#define TENACIOUSD_CHECKSUM_H
+
+uint32_t tenaciousd_crc32c(uint32_t crc, const void *buf, size_t len);
+
+#endif
@@ -1,5 +1,6 @@
 /*
  * Copyright (c) 2014, University of Washington.
+ * Copyright (c) 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -9,6 +10,7 @@
 
 #include <stdlib.h>
 #include <alloca.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -17,8 +19,9 @@
 #include <errors/errno.h>
 #include <tenaciousd/log.h>
 #include <storage/storage.h>
+#include "checksum.h"
 
-#define LOG_IDENTIFIER	"TenaciousD_Log_structure_rev01"
+#define LOG_IDENTIFIER	"TenaciousD_Log_structure_rev02"
 
 #define LOG_FIRST_ENTRY_OFFSET(log) \
   STORAGE_VSIC_ROUND(log->vsic, sizeof(struct log_header))
@@ -26,16 +29,35 @@
 #define LOG_MIN_ENTRY_SIZE(log) \
   STORAGE_VSIC_ROUND(log->vsic, sizeof(struct tenaciousd_log_entry))
 
-#define LOG_ENTRY_END_MARKER	0xff
+// On-disk size of an entry, including header and padding
+#define LOG_ENTRY_DISK_SIZE(log, entry) \
+  STORAGE_VSIC_ROUND(log->vsic, (entry)->size + sizeof(struct tenaciousd_log_entry))
 
 struct log_header {
   char		identifier[32];
   uint8_t	version;
   uint64_t	entries;
   uint32_t	blocksize;
+  uint64_t	start;
   uint64_t	end;
+  uint32_t	generation;
 } __attribute__ ((packed));
 
+/**
+ * \brief Checksum of an entry, covering its header and data.
+ *
+ * The generation is part of the checksum, so that stale entries left
+ * behind by a compaction are not mistaken for valid ones.
+ */
+static uint32_t entry_checksum(uint32_t generation,
+                               struct tenaciousd_log_entry *entry)
+{
+    uint32_t crc = tenaciousd_crc32c(0, &generation, sizeof(generation));
+    crc = tenaciousd_crc32c(crc, entry,
+                            offsetof(struct tenaciousd_log_entry, checksum));
+    return tenaciousd_crc32c(crc, entry->data, entry->size);
+}
+
 static struct tenaciousd_log_entry *read_entry(struct tenaciousd_log *log,
 					       off_t offset)
 {
@@ -49,42 +71,72 @@ static struct tenaciousd_log_entry *read_entry(struct tenaciousd_log *log,
 				       LOG_MIN_ENTRY_SIZE(log), entry);
     assert(err_is_ok(err));
     err = log->vsic->ops.wait(log->vsic);
-    assert(err_is_ok(err));
 
     if(err_no(err) == VFS_ERR_EOF) {
         // Invalid read
-        storage_free(log, entry);
+        storage_free(log->vsic, entry);
         return NULL;
     }
+    assert(err_is_ok(err));
 
-    // If this was less or equal to the min size, we're done
-    if(entry->size + sizeof(struct tenaciousd_log_entry)
-       <= LOG_MIN_ENTRY_SIZE(log)) {
-      return entry;
+    // Reject empty entries and garbage before trusting the size
+    if(entry->size == 0 ||
+       entry->next != offset + LOG_ENTRY_DISK_SIZE(log, entry)) {
+        storage_free(log->vsic, entry);
+        return NULL;
     }
 
-    // Otherwise, we have to read the rest
-    entry = storage_realloc(log->vsic, entry,
-                            entry->size + sizeof(struct tenaciousd_log_entry));
-    assert(entry != NULL);
-    err = log->vsic->ops.read(log->vsic, log->vsa,
-                              offset + LOG_MIN_ENTRY_SIZE(log),
-                              entry->size - LOG_MIN_ENTRY_SIZE(log) + sizeof(struct tenaciousd_log_entry),
-       ((uint8_t *)entry) + LOG_MIN_ENTRY_SIZE(log));
-    assert(err_is_ok(err));
-    err = log->vsic->ops.wait(log->vsic);
-    assert(err_is_ok(err));
+    // Read the rest, if the entry is larger than the minimum size
+    size_t disksize = LOG_ENTRY_DISK_SIZE(log, entry);
+    if(disksize > LOG_MIN_ENTRY_SIZE(log)) {
+        entry = storage_realloc(log->vsic, entry, disksize);
+        assert(entry != NULL);
+        err = log->vsic->ops.read(log->vsic, log->vsa,
+                                  offset + LOG_MIN_ENTRY_SIZE(log),
+                                  disksize - LOG_MIN_ENTRY_SIZE(log),
+                                  ((uint8_t *)entry) + LOG_MIN_ENTRY_SIZE(log));
+        assert(err_is_ok(err));
+        err = log->vsic->ops.wait(log->vsic);
+        assert(err_is_ok(err));
+    }
 
-    // Is the end marker there?
-    if(entry->data[entry->size] != LOG_ENTRY_END_MARKER) {
-        // This entry is invalid
-        storage_free(log, entry);
+    // A torn or stale write shows up as a checksum mismatch
+    if(entry->checksum != entry_checksum(log->generation, entry)) {
+        storage_free(log->vsic, entry);
         return NULL;
     }
 
     return entry;
 }
 
+/// Write the in-memory log state to the header and wait until it is durable
+static errval_t write_header(struct tenaciousd_log *log)
+{
+  struct storage_vsic *vsic = log->vsic;
+  struct log_header *header = storage_alloca(vsic, sizeof(struct log_header));
+  assert(header != NULL);
+
+  memset(header, 0, STORAGE_VSIC_ROUND(vsic, sizeof(struct log_header)));
+  memcpy(header->identifier, LOG_IDENTIFIER, sizeof(LOG_IDENTIFIER));
+  header->version = 0;
+  header->entries = log->entries;
+  header->blocksize = vsic->blocksize;
+  header->start = log->start;
+  header->end = log->end;
+  header->generation = log->generation;
+
+  errval_t err = vsic->ops.write(vsic, log->vsa, 0,
+                                 sizeof(struct log_header), header);
+  if(err_is_fail(err)) {
+      return err;
+  }
+  err = vsic->ops.flush(vsic, log->vsa);
+  if(err_is_fail(err)) {
+      return err;
+  }
+  return vsic->ops.wait(vsic);
+}
+
 struct tenaciousd_log *tenaciousd_log_new(struct storage_vsa *vsa,
 					  struct storage_vsic *vsic)
 {
@@ -93,10 +145,11 @@ struct tenaciousd_log *tenaciousd_log_new(struct storage_vsa *vsa,
 
   struct tenaciousd_log *log = malloc(sizeof(struct tenaciousd_log));
   assert(log != NULL);
-  memset(log, 0, sizeof(log));
+  memset(log, 0, sizeof(struct tenaciousd_log));
 
   log->vsa = vsa;
   log->vsic = vsic;
+  log->batch_limit = TENACIOUSD_LOG_DEFAULT_BATCH;
 
   // Check if VSA already has a log
   struct log_header *header = storage_alloca(vsic, sizeof(struct log_header));
@@ -105,107 +158,275 @@ struct tenaciousd_log *tenaciousd_log_new(struct storage_vsa *vsa,
 				sizeof(struct log_header), header);
   assert(err_is_ok(err));
   err = vsic->ops.wait(vsic);
-  assert(err_is_ok(err));
+  assert(err_is_ok(err) || err_no(err) == VFS_ERR_EOF);
 
-  if(!strncmp(header->identifier, LOG_IDENTIFIER, sizeof(header->identifier))) {
+  if(err_is_ok(err) &&
+     !strncmp(header->identifier, LOG_IDENTIFIER, sizeof(header->identifier))) {
     // Log already exists -- initialize from storage
     assert(header->blocksize == vsic->blocksize);
     log->entries = header->entries;
+    log->start = header->start;
     log->end = header->end;
+    log->generation = header->generation;
 
     // Check whether header is up-to-date
     for(;;) {
         struct tenaciousd_log_entry *logentry = read_entry(log, log->end);
 
-        // Either we couldn't read (cause EOF) or there's no entry
-        if(logentry == NULL || logentry->size == 0) {
+        // Either we couldn't read (cause EOF) or there's no valid entry
+        if(logentry == NULL) {
             // Header up-to-date -- we're done
             return log;
         }
 
         // More entries -- log header not up-to-date
         log->entries++;
-        log->end += STORAGE_VSIC_ROUND(log->vsic, logentry->size);
+        log->end = logentry->next;
         tenaciousd_log_entry_delete(log, logentry);
     }
-  } else {
-    // Reset header
-    memset(header, 0, sizeof(struct log_header));
-    memcpy(header->identifier, LOG_IDENTIFIER, 32);
-    header->version = 0;
-    header->blocksize = vsic->blocksize;
-    header->end = STORAGE_VSIC_ROUND(vsic, sizeof(struct log_header));
   }
 
+  // Reset header
+  log->entries = 0;
+  log->start = log->end = LOG_FIRST_ENTRY_OFFSET(log);
+  log->generation = 0;
+
   // Write new header
-  err = vsic->ops.write(vsic, vsa, 0, sizeof(struct log_header), header);
-  assert(err_is_ok(err));
-  err = vsic->ops.flush(vsic, vsa);
-  assert(err_is_ok(err));
-  err = vsic->ops.wait(vsic);
+  err = write_header(log);
   assert(err_is_ok(err));
 
-  log->entries = header->entries;
-  log->end = header->end;
-
   return log;
 }
 
 errval_t tenaciousd_log_delete(struct tenaciousd_log *log)
 {
-  // Flush out log
-  errval_t err = log->vsic->ops.flush(log->vsic, log->vsa);
+  // Write out staged entries
+  errval_t err = tenaciousd_log_commit(log);
   assert(err_is_ok(err));
 
-  // Update header and flush again and wait for it to finish
-  struct log_header *header =
-      storage_alloca(log->vsic, sizeof(struct log_header));
-  assert(header != NULL);
-
-  memset(header, 0, sizeof(struct log_header));
-  memcpy(header->identifier, LOG_IDENTIFIER, 32);
-  header->version = 0;
-  header->entries = log->entries;
-  header->blocksize = log->vsic->blocksize;
-  header->end = log->end;
-
-  err = log->vsic->ops.write(log->vsic, log->vsa, 0, sizeof(struct log_header), header);
-  assert(err_is_ok(err));
-  err = log->vsic->ops.flush(log->vsic, log->vsa);
-  assert(err_is_ok(err));
-  err = log->vsic->ops.wait(log->vsic);
+  // Update header and wait for it to finish
+  err = write_header(log);
   assert(err_is_ok(err));
 
   // Free memory and return
+  storage_free(log->vsic, log->batch);
   free(log);
   return SYS_ERR_OK;
 }
 
+/**
+ * \brief Set the maximum number of appends that are committed together.
+ *
+ * With a batch size of 1, every append is durable when it returns. With a
+ * larger batch size, appends are staged in memory until the batch is full,
+ * tenaciousd_log_commit() is called or TENACIOUSD_LOG_MAX_BATCH_BYTES are
+ * staged, and are then written with a single write and a single flush.
+ * Nothing commits a partial batch on a timer: a staged append returns
+ * success before it is durable and is lost on a crash until the caller
+ * commits it.
+ */
+void tenaciousd_log_set_batch(struct tenaciousd_log *log, size_t nentries)
+{
+  assert(nentries > 0);
+  log->batch_limit = nentries;
+}
+
+/**
+ * \brief Write all staged appends and wait until they are durable.
+ *
+ * Staged entries are contiguous and block-aligned on disk, so they go out
+ * as one write followed by one flush.
+ */
+errval_t tenaciousd_log_commit(struct tenaciousd_log *log)
+{
+  struct storage_vsic *vsic = log->vsic;
+
+  if(log->batch_entries == 0) {
+      return SYS_ERR_OK;
+  }
+
+  errval_t err = vsic->ops.write(vsic, log->vsa, log->batch_offset,
+                                 log->batch_fill, log->batch);
+  if(err_is_fail(err)) {
+      return err;
+  }
+  err = vsic->ops.flush(vsic, log->vsa);
+  if(err_is_fail(err)) {
+      return err;
+  }
+
+  // The VSIC reads from the batch buffer until the write completed
+  err = vsic->ops.wait(vsic);
+  if(err_is_fail(err)) {
+      return err;
+  }
+
+  log->batch_fill = 0;
+  log->batch_entries = 0;
+  return SYS_ERR_OK;
+}
+
+/**
+ * \brief Append an entry to the log.
+ *
+ * The entry is copied, so the caller may reuse it right away. It is durable
+ * once the group commit that includes it finished, see
+ * tenaciousd_log_set_batch().
+ */
 errval_t tenaciousd_log_append(struct tenaciousd_log *log,
                                struct tenaciousd_log_entry *entry)
 {
   struct storage_vsic *vsic = log->vsic;
-  off_t end = log->end;
+  size_t len = LOG_ENTRY_DISK_SIZE(log, entry);
+
+  assert(entry->size > 0);
+
+  if(log->batch_entries == 0) {
+      log->batch_offset = log->end;
+  }
+
+  // Grow the staging buffer if needed
+  if(log->batch_fill + len > log->batch_size) {
+      size_t size = log->batch_size * 2;
+      if(size < log->batch_fill + len) {
+          size = log->batch_fill + len;
+      }
+      uint8_t *batch = storage_realloc(vsic, log->batch, size);
+      if(batch == NULL) {
+          return LIB_ERR_MALLOC_FAIL;
+      }
+      log->batch = batch;
+      log->batch_size = STORAGE_VSIC_ROUND(vsic, size);
+  }
+
+  entry->next = log->end + len;
+  entry->checksum = entry_checksum(log->generation, entry);
 
-  log->end = entry->next = end +
-    STORAGE_VSIC_ROUND(vsic, entry->size + sizeof(struct tenaciousd_log_entry));
+  uint8_t *dst = log->batch + log->batch_fill;
+  size_t copy = entry->size + sizeof(struct tenaciousd_log_entry);
+  memcpy(dst, entry, copy);
+  memset(dst + copy, 0, len - copy);
+
+  log->batch_fill += len;
+  log->batch_entries++;
+  log->end = entry->next;
   log->entries++;
-  entry->data[entry->size] = LOG_ENTRY_END_MARKER;
 
-  return log->vsic->ops.
-    write(vsic, log->vsa, end,
-	  entry->size + sizeof(struct tenaciousd_log_entry), entry);
+  if(log->batch_entries >= log->batch_limit ||
+     log->batch_fill >= TENACIOUSD_LOG_MAX_BATCH_BYTES) {
+      return tenaciousd_log_commit(log);
+  }
+
+  return SYS_ERR_OK;
+}
+
+/**
+ * \brief Move the live entries to the front of the log.
+ *
+ * Only called when at least as much space was trimmed as is live, so the
+ * copy does not overlap the original. Until the new header is written,
+ * the old header still describes the original entries. Once it is, the
+ * entries left behind carry the old generation and fail their checksum.
+ */
+static errval_t compact(struct tenaciousd_log *log)
+{
+  struct storage_vsic *vsic = log->vsic;
+  uint64_t first = LOG_FIRST_ENTRY_OFFSET(log);
+  uint64_t live = log->end - log->start;
+  uint64_t delta = log->start - first;
+  uint32_t generation = log->generation + 1;
+  errval_t err;
+
+  assert(delta >= live);
+
+  if(live > 0) {
+      uint8_t *buf = storage_malloc(vsic, live);
+      if(buf == NULL) {
+          return LIB_ERR_MALLOC_FAIL;
+      }
+
+      err = vsic->ops.read(vsic, log->vsa, log->start, live, buf);
+      assert(err_is_ok(err));
+      err = vsic->ops.wait(vsic);
+      if(err_is_fail(err)) {
+          storage_free(vsic, buf);
+          return err;
+      }
+
+      // Relocate each entry and reseal it with the new generation
+      for(uint64_t off = 0; off < live;) {
+          struct tenaciousd_log_entry *entry =
+              (struct tenaciousd_log_entry *)(buf + off);
+          uint64_t len = LOG_ENTRY_DISK_SIZE(log, entry);
+
+          assert(entry->next == log->start + off + len);
+          entry->next -= delta;
+          entry->checksum = entry_checksum(generation, entry);
+          off += len;
+      }
+
+      err = vsic->ops.write(vsic, log->vsa, first, live, buf);
+      if(err_is_ok(err)) {
+          err = vsic->ops.flush(vsic, log->vsa);
+      }
+      if(err_is_ok(err)) {
+          err = vsic->ops.wait(vsic);
+      }
+      storage_free(vsic, buf);
+      if(err_is_fail(err)) {
+          return err;
+      }
+  }
+
+  log->generation = generation;
+  log->start = first;
+  log->end -= delta;
+  return write_header(log);
 }
 
+/**
+ * \brief Drop the oldest \p nentries entries of the log.
+ *
+ * The space is reclaimed by compacting the log once at least half of it
+ * is trimmed.
+ */
 errval_t tenaciousd_log_trim(struct tenaciousd_log *log, int nentries)
 {
-    assert(!"NYI");
+  assert(nentries >= 0);
+
+  errval_t err = tenaciousd_log_commit(log);
+  if(err_is_fail(err)) {
+      return err;
+  }
+
+  uint64_t offset = log->start;
+  for(int i = 0; i < nentries && log->entries > 0; i++) {
+      struct tenaciousd_log_entry *entry = read_entry(log, offset);
+      if(entry == NULL) {
+          break;
+      }
+      offset = entry->next;
+      log->entries--;
+      tenaciousd_log_entry_delete(log, entry);
+  }
+  log->start = offset;
+
+  if(log->start - LOG_FIRST_ENTRY_OFFSET(log) >= log->end - log->start &&
+     log->start > LOG_FIRST_ENTRY_OFFSET(log)) {
+      return compact(log);
+  }
+
+  return write_header(log);
 }
 
 struct tenaciousd_log_iter tenaciousd_log_begin(struct tenaciousd_log *log)
 {
+  // Staged entries have to be on disk to be found
+  errval_t err = tenaciousd_log_commit(log);
+  assert(err_is_ok(err));
+
   struct tenaciousd_log_entry *entry =
-      read_entry(log, LOG_FIRST_ENTRY_OFFSET(log));
+      log->start < log->end ? read_entry(log, log->start) : NULL;
 
   if(entry == NULL) {
       log->entries = 0;
@@ -216,7 +437,7 @@ struct tenaciousd_log_iter tenaciousd_log_begin(struct tenaciousd_log *log)
   return (struct tenaciousd_log_iter) {
       .entry = entry,
       .next = NULL,
-      .offset = LOG_FIRST_ENTRY_OFFSET(log),
+      .offset = log->start,
   };
 }
 
@@ -228,8 +449,8 @@ struct tenaciousd_log_iter tenaciousd_log_next(struct tenaciousd_log *log,
       iter = *iter.next;
   } else {
       // Not cached
-      iter.offset += STORAGE_VSIC_ROUND(log->vsic, iter.entry->size);
-      iter.entry = read_entry(log, iter.offset);
+      iter.offset = iter.entry->next;
+      iter.entry = iter.offset < log->end ? read_entry(log, iter.offset) : NULL;
   }
 
   // TODO: Prefetch another one
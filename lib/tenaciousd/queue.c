@@ -1,5 +1,6 @@
 /*
  * Copyright (c) 2014, University of Washington.
+ * Copyright (c) 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -9,6 +10,7 @@
 
 #include <stdlib.h>
 #include <alloca.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -17,8 +19,9 @@
 #include <errors/errno.h>
 #include <tenaciousd/queue.h>
 #include <storage/storage.h>
+#include "checksum.h"
 
-#define QUEUE_IDENTIFIER	"TenaciousD_Queue_structure_rev01"
+#define QUEUE_IDENTIFIER	"TenaciousD_Queue_structure_rev02"
 
 #define QUEUE_FIRST_ELEMENT_OFFSET(queue) \
   STORAGE_VSIC_ROUND(queue->vsic, sizeof(struct queue_header))
@@ -26,9 +29,12 @@
 #define QUEUE_MIN_ELEMENT_SIZE(queue) \
   STORAGE_VSIC_ROUND(queue->vsic, sizeof(struct tenaciousd_queue_element))
 
+// On-disk size of an element, including header and padding
+#define QUEUE_ELEMENT_DISK_SIZE(queue, element) \
+  STORAGE_VSIC_ROUND(queue->vsic, (element)->size + sizeof(struct tenaciousd_queue_element))
+
 #define QUEUE_ELEMENT_VALID		0x01
 #define QUEUE_ELEMENT_INVALID		0x00
-#define QUEUE_ELEMENT_END_MARKER	0xff
 
 struct queue_header {
   char		identifier[32];
@@ -39,6 +45,19 @@ struct queue_header {
   uint64_t	end;
 } __attribute__ ((packed));
 
+/**
+ * \brief Checksum of an element, covering its header and data.
+ *
+ * The valid flag is left out, as removing an element clears it in place.
+ */
+static uint32_t element_checksum(struct tenaciousd_queue_element *element)
+{
+    uint32_t crc = tenaciousd_crc32c(0, &element->size,
+                                     offsetof(struct tenaciousd_queue_element, checksum)
+                                     - offsetof(struct tenaciousd_queue_element, size));
+    return tenaciousd_crc32c(crc, element->data, element->size);
+}
+
 static struct tenaciousd_queue_element *tenaciousd_queue_read_element(struct tenaciousd_queue *queue,
 								      off_t offset)
 {
@@ -52,13 +71,13 @@ static struct tenaciousd_queue_element *tenaciousd_queue_read_element(struct ten
 				       QUEUE_MIN_ELEMENT_SIZE(queue), element);
     assert(err_is_ok(err));
     err = queue->vsic->ops.wait(queue->vsic);
-    assert(err_is_ok(err));
 
     if(err_no(err) == VFS_ERR_EOF) {
         // Invalid read
         storage_free(queue, element);
         return NULL;
     }
+    assert(err_is_ok(err));
 
     if (element->valid != QUEUE_ELEMENT_VALID) {
       // Invalid element
@@ -84,8 +103,8 @@ static struct tenaciousd_queue_element *tenaciousd_queue_read_element(struct ten
     err = queue->vsic->ops.wait(queue->vsic);
     assert(err_is_ok(err));
 
-    // Is the end marker there?
-    if(element->data[element->size] != QUEUE_ELEMENT_END_MARKER) {
+    // A torn write shows up as a checksum mismatch
+    if(element->checksum != element_checksum(element)) {
         // This entry is invalid
         storage_free(queue, element);
         return NULL;
@@ -95,7 +114,7 @@ static struct tenaciousd_queue_element *tenaciousd_queue_read_element(struct ten
 }
 
 
-void tenaciousd_queue_delete_entry(struct tenaciousd_queue *queue,
+void tenaciousd_queue_delete_element(struct tenaciousd_queue *queue,
 				 struct tenaciousd_queue_element *element)
 {
   storage_free(queue->vsic, element);
@@ -110,10 +129,11 @@ struct tenaciousd_queue *tenaciousd_queue_new(struct storage_vsa *vsa,
 
   struct tenaciousd_queue *queue = malloc(sizeof(struct tenaciousd_queue));
   assert(queue != NULL);
-  memset(queue, 0, sizeof(queue));
+  memset(queue, 0, sizeof(struct tenaciousd_queue));
 
   queue->vsa = vsa;
   queue->vsic = vsic;
+  queue->batch_limit = TENACIOUSD_QUEUE_DEFAULT_BATCH;
 
   // Check if VSA already has a queue
   struct queue_header *header = storage_alloca(vsic, sizeof(struct queue_header));
@@ -176,8 +196,8 @@ struct tenaciousd_queue *tenaciousd_queue_new(struct storage_vsa *vsa,
 
 errval_t tenaciousd_queue_delete(struct tenaciousd_queue *queue)
 {
-  // Flush out log
-  errval_t err = queue->vsic->ops.flush(queue->vsic, queue->vsa);
+  // Write out staged elements
+  errval_t err = tenaciousd_queue_commit(queue);
   assert(err_is_ok(err));
 
   // Update header and flush again and wait for it to finish
@@ -201,6 +221,7 @@ errval_t tenaciousd_queue_delete(struct tenaciousd_queue *queue)
   assert(err_is_ok(err));
 
   // Free memory and return
+  storage_free(queue->vsic, queue->batch);
   free(queue);
   return SYS_ERR_OK;
 }
@@ -221,23 +242,93 @@ tenaciousd_queue_element_new(struct tenaciousd_queue *queue, size_t *size)
 }
 
 
+/**
+ * \brief Set the maximum number of adds that are committed together.
+ *
+ * Works like tenaciousd_log_set_batch().
+ */
+void tenaciousd_queue_set_batch(struct tenaciousd_queue *queue, size_t nelements)
+{
+  assert(nelements > 0);
+  queue->batch_limit = nelements;
+}
+
+/**
+ * \brief Write all staged adds with one write and one flush, and wait until
+ * they are durable.
+ */
+errval_t tenaciousd_queue_commit(struct tenaciousd_queue *queue)
+{
+  struct storage_vsic *vsic = queue->vsic;
+
+  if(queue->batch_elements == 0) {
+      return SYS_ERR_OK;
+  }
+
+  errval_t err = vsic->ops.write(vsic, queue->vsa, queue->batch_offset,
+                                 queue->batch_fill, queue->batch);
+  if(err_is_fail(err)) {
+      return err;
+  }
+  err = vsic->ops.flush(vsic, queue->vsa);
+  if(err_is_fail(err)) {
+      return err;
+  }
+  err = vsic->ops.wait(vsic);
+  if(err_is_fail(err)) {
+      return err;
+  }
+
+  queue->batch_fill = 0;
+  queue->batch_elements = 0;
+  return SYS_ERR_OK;
+}
+
 errval_t tenaciousd_queue_add(struct tenaciousd_queue *queue,
                                struct tenaciousd_queue_element *element)
 {
   struct storage_vsic *vsic = queue->vsic;
   off_t end = queue->end;
+  size_t len = QUEUE_ELEMENT_DISK_SIZE(queue, element);
+
+  if(queue->batch_elements == 0) {
+      queue->batch_offset = end;
+  }
+
+  // Grow the staging buffer if needed
+  if(queue->batch_fill + len > queue->batch_size) {
+      size_t size = queue->batch_size * 2;
+      if(size < queue->batch_fill + len) {
+          size = queue->batch_fill + len;
+      }
+      uint8_t *batch = storage_realloc(vsic, queue->batch, size);
+      if(batch == NULL) {
+          return LIB_ERR_MALLOC_FAIL;
+      }
+      queue->batch = batch;
+      queue->batch_size = STORAGE_VSIC_ROUND(vsic, size);
+  }
 
   element->prev = queue->last;
   queue->last = end;
-  queue->end = element->next = end +
-    STORAGE_VSIC_ROUND(vsic, element->size + sizeof(struct tenaciousd_queue_element));
+  queue->end = element->next = end + len;
   queue->elements++;
   element->valid = QUEUE_ELEMENT_VALID;
-  element->data[element->size] = QUEUE_ELEMENT_END_MARKER;
+  element->checksum = element_checksum(element);
+
+  uint8_t *dst = queue->batch + queue->batch_fill;
+  size_t copy = element->size + sizeof(struct tenaciousd_queue_element);
+  memcpy(dst, element, copy);
+  memset(dst + copy, 0, len - copy);
+  queue->batch_fill += len;
+  queue->batch_elements++;
+
+  if(queue->batch_elements >= queue->batch_limit ||
+     queue->batch_fill >= TENACIOUSD_QUEUE_MAX_BATCH_BYTES) {
+      return tenaciousd_queue_commit(queue);
+  }
 
-  return queue->vsic->ops.
-    write(vsic, queue->vsa, end,
-	  element->size + sizeof(struct tenaciousd_queue_element), element);
+  return SYS_ERR_OK;
 }
 
 struct tenaciousd_queue_element * tenaciousd_queue_remove(struct tenaciousd_queue *queue) {
@@ -245,6 +336,10 @@ struct tenaciousd_queue_element * tenaciousd_queue_remove(struct tenaciousd_queu
     return NULL;
   }
 
+  // The last element may still be staged
+  errval_t err = tenaciousd_queue_commit(queue);
+  assert(err_is_ok(err));
+
   uint64_t last = queue->last;
 
   struct tenaciousd_queue_element * element = tenaciousd_queue_read_element(queue, queue->last);
@@ -263,6 +358,10 @@ struct tenaciousd_queue_element * tenaciousd_queue_remove(struct tenaciousd_queu
 
 struct tenaciousd_queue_iter tenaciousd_queue_begin(struct tenaciousd_queue *queue)
 {
+  // Staged elements have to be on disk to be found
+  errval_t err = tenaciousd_queue_commit(queue);
+  assert(err_is_ok(err));
+
   struct tenaciousd_queue_element *element =
       tenaciousd_queue_read_element(queue, QUEUE_FIRST_ELEMENT_OFFSET(queue));
 
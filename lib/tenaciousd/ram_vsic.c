@@ -1,5 +1,6 @@
 /*
  * Copyright (c) 2014, University of Washington.
+ * Copyright (c) 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -20,7 +21,10 @@
 #include <storage/vsic.h>
 #include <storage/vsa.h>
 
-//#define DO_ACTUAL_IO
+// Copy the data, not only model the latencies. Without this, reads return
+// whatever is in the buffer and recovery, compaction and benchmarks that read
+// the log back see garbage.
+#define DO_ACTUAL_IO
 
 #define MAX_CBS         1000
 
@@ -157,7 +161,7 @@ static errval_t vsic_poll(struct storage_vsic *vsic, void **handle)
 	if(rdtsc() >= cb->execute_time) {
 #ifdef DO_ACTUAL_IO
 	  if(cb->cmd == CMD_READ) {
-	    memcpy(cb->buf, mydata->vsa_area + cb->offset, cb->size);
+	    memcpy(cb->buf, mydata->vsa_area + cb->offset, cb->nbytes);
 	  }
 #endif
 
@@ -190,7 +194,7 @@ static errval_t vsic_wait(struct storage_vsic *vsic)
                 } else {
 #ifdef DO_ACTUAL_IO
                     if(cb->cmd == CMD_READ) {
-                        memcpy(cb->buf, mydata->vsa_area + cb->offset, cb->size);
+                        memcpy(cb->buf, mydata->vsa_area + cb->offset, cb->nbytes);
                     }
 #endif
 
@@ -127,7 +127,7 @@ end_stats(enum cacheOps op, int hit)
 
 #ifdef CACHE_META_DATA
 
-#include <hashtable/hashtable.h>
+#include <collections/hash_map.h>
 
 #define MAX_DIR         5000
 
@@ -138,27 +138,23 @@ struct dir_entry {
 };
 
 static struct dir_entry directory[MAX_DIR];
-static struct hashtable *dir_hash;
+static collections_hash_map *dir_hash;
 static int alloc_ptr = 0;
 static size_t meta_hits = 0, meta_misses = 0, meta_overwrites = 0;
 
 static void meta_data_init(void)
 {
-    /*    dir_hash = create_hashtable2(MAX_DIR, 75);
+    collections_hash_map_create(&dir_hash, COLLECTIONS_HASH_MAP_KEY_BYTES,
+                                MAX_DIR, free, NULL);
     assert(dir_hash != NULL);
-    */
 }
 
 static void meta_data_lookup(const char *fname,
                              bool *haveit, bool *deleted, vfs_handle_t *fh)
 {
-    ENTRY_TYPE et;
     void *val;
 
-    et = dir_hash->d.get(&dir_hash->d, fname, strlen(fname), &val);
-    assert(et == TYPE_WORD || et == 0);
-
-    if(et == TYPE_WORD) {
+    if(collections_hash_map_lookup_bytes(dir_hash, fname, strlen(fname), &val)) {
         /* printf("'%s' is in cache\n", fname); */
         uintptr_t index = (uintptr_t)val;
         struct dir_entry *e = &directory[index];
@@ -189,14 +185,10 @@ static void meta_data_lookup(const char *fname,
 
 static void meta_data_create(vfs_handle_t fh, const char *fname)
 {
-    ENTRY_TYPE et;
     void *val;
     struct dir_entry *e;
 
-    et = dir_hash->d.get(&dir_hash->d, fname, strlen(fname), &val);
-    assert(et == TYPE_WORD || et == 0);
-
-    if(et == TYPE_WORD) {
+    if(collections_hash_map_lookup_bytes(dir_hash, fname, strlen(fname), &val)) {
         uintptr_t index = (uintptr_t)val;
         e = &directory[index];
         /* printf("overwriting '%s'\n", fname); */
@@ -206,7 +198,9 @@ static void meta_data_create(vfs_handle_t fh, const char *fname)
         assert(alloc_ptr < MAX_DIR);
         e = &directory[alloc_ptr];
         char *newfname = strdup(fname);
-        int r = dir_hash->d.put_word(&dir_hash->d, newfname, strlen(newfname), alloc_ptr);
+        int r = collections_hash_map_insert_bytes(dir_hash, newfname,
+                                                  strlen(newfname),
+                                                  (void *)(uintptr_t)alloc_ptr);
         assert(r == 0);
         alloc_ptr++;
     }
@@ -221,14 +215,10 @@ static void meta_data_create(vfs_handle_t fh, const char *fname)
 
 static void meta_data_delete(const char *fname, bool *success)
 {
-    ENTRY_TYPE et;
     void *val;
     struct dir_entry *e;
 
-    et = dir_hash->d.get(&dir_hash->d, fname, strlen(fname), &val);
-    assert(et == TYPE_WORD || et == 0);
-
-    if(et == TYPE_WORD) {
+    if(collections_hash_map_lookup_bytes(dir_hash, fname, strlen(fname), &val)) {
         uintptr_t index = (uintptr_t)val;
         e = &directory[index];
         /* printf("deleting '%s' in cache\n", fname); */
@@ -236,7 +226,11 @@ static void meta_data_delete(const char *fname, bool *success)
         /* printf("deleting '%s' not in cache\n", fname); */
         assert(alloc_ptr < MAX_DIR);
         e = &directory[alloc_ptr];
-        int r = dir_hash->d.put_word(&dir_hash->d, fname, strlen(fname), alloc_ptr);
+        // the map keeps the key, so it must not be the caller's buffer
+        char *newfname = strdup(fname);
+        int r = collections_hash_map_insert_bytes(dir_hash, newfname,
+                                                  strlen(newfname),
+                                                  (void *)(uintptr_t)alloc_ptr);
         assert(r == 0);
         alloc_ptr++;
     }
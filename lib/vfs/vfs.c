@@ -373,6 +373,8 @@ errval_t vfs_stat(vfs_handle_t handle, struct vfs_fileinfo *info)
     struct vfs_mount *m = h->mount;
 
     assert(m->ops->stat != NULL);
+    // backends only fill in what they know about
+    memset(info, 0, sizeof(*info));
     return m->ops->stat(m->st, handle, info);
 }
 
@@ -458,6 +460,9 @@ errval_t vfs_dir_read_next(vfs_handle_t dhandle, char **name,
     struct vfs_mount *m = handle->mount;
 
     assert(m->ops->dir_read_next != NULL);
+    if (info != NULL) {
+        memset(info, 0, sizeof(*info));
+    }
     return m->ops->dir_read_next(m->st, dhandle, name, info);
 }
 
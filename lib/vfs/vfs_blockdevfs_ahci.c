@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009, 2011, ETH Zurich.
+ * Copyright (c) 2009, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -32,12 +32,15 @@ static bool ahci_mgmt_bound = false;
 #define RFIS_OFFSET_SET_DEVICE_BITS_FIS 0x58
 #define RFIS_OFFSET_UNKNOWN_FIS 0x60
 
+// reads and writes are split into requests of this size, which are all
+// issued at once and kept in flight together
+#define BDFS_AHCI_CHUNK_SIZE (64 * 1024)
+
 struct ahci_handle {
     struct ahci_binding *binding;
     uint8_t port_num;
-    bool waiting;
     errval_t wait_status;
-    size_t bytes_transferred;
+    size_t pending;         ///< Outstanding commands
 };
 
 static void ahci_init_cb(void *st, errval_t err, struct ahci_binding *binding)
@@ -47,13 +50,13 @@ static void ahci_init_cb(void *st, errval_t err, struct ahci_binding *binding)
     if (err_is_fail(err)) {
         printf("ahci_init_cb returned '%s'\n", err_getstring(err));
         h->wait_status = err;
-        h->waiting = false;
+        h->pending = 0;
         return;
     }
 
     h->binding = binding;
     binding->st = h;
-    h->waiting = false;
+    h->pending = 0;
 }
 
 errval_t blockdevfs_ahci_open(void *handle)
@@ -63,17 +66,17 @@ errval_t blockdevfs_ahci_open(void *handle)
     struct ahci_handle *h = handle;
 
     h->wait_status = SYS_ERR_OK;
-    h->waiting = true;
+    h->pending = 1;
 
     err = ahci_init(h->port_num, ahci_init_cb, h, get_default_waitset());
     if (err_is_fail(err)) {
         printf("ahci_init failed: '%s'\n", err_getstring(err));
-        h->waiting = false;
+        h->pending = 0;
         return err;
     }
 
     // XXX: block for command completion (broken API!)
-    while (h->waiting) {
+    while (h->pending > 0) {
         messages_wait_and_handle_next();
     }
 
@@ -84,20 +87,20 @@ errval_t blockdevfs_ahci_open(void *handle)
 static void ahci_close_cb(void *arg)
 {
     struct ahci_handle *h = arg;
-    h->waiting = false;
+    h->pending = 0;
 }
 
 errval_t blockdevfs_ahci_close(void *handle)
 {
     struct ahci_handle *h = handle;
-    h->waiting = true;
+    h->pending = 1;
     errval_t err = ahci_close(h->binding, MKCLOSURE(ahci_close_cb, h));
     if (err_is_fail(err)) {
         printf("ahci_init failed: '%s'\n", err_getstring(err));
-        h->waiting = false;
+        h->pending = 0;
         return err;
     }
-    while (h->waiting) {
+    while (h->pending > 0) {
         messages_wait_and_handle_next();
     }
     return SYS_ERR_OK;
@@ -108,14 +111,13 @@ static void rx_flush_command_completed_cb(struct ahci_binding *binding, void *ta
     struct ahci_handle *h = binding->st;
     VFS_BLK_DEBUG("rx_flush_command_completed_cb(%p, tag: %p): entering\n",
             binding, tag);
-    h->waiting = false;
+    h->pending = 0;
 }
 
 errval_t blockdevfs_ahci_flush(void *handle)
 {
     errval_t err = SYS_ERR_OK;
     struct ahci_handle *h = handle;
-    h->waiting = true;
     // setup FIS
     struct sata_fis_reg_h2d fis;
     memset(&fis, 0, sizeof(struct sata_fis_reg_h2d));
@@ -125,10 +127,9 @@ errval_t blockdevfs_ahci_flush(void *handle)
     sata_set_count(&fis, 0); /* nr. of sectors/blocks */
     sata_set_lba28(&fis, 0);
 
-    // set handle to waiting
-    h->waiting = true;
+    // one command outstanding
+    h->pending = 1;
     h->wait_status = SYS_ERR_OK;
-    h->bytes_transferred = 0;
     h->binding->rx_vtbl.command_completed = rx_flush_command_completed_cb;
 
     // load fis and fire commands
@@ -136,11 +137,11 @@ errval_t blockdevfs_ahci_flush(void *handle)
             (uint8_t*)&fis, sizeof(fis), false, NULL, 0);
     if (err_is_fail(err)) {
         printf("bdfs_ahci: read load_fis failed: 0x%" PRIxPTR "\n", err);
-        h->waiting = false;
+        h->pending = 0;
         goto cleanup;
     }
 
-    while (h->waiting) {
+    while (h->pending > 0) {
         messages_wait_and_handle_next();
     }
 
@@ -151,13 +152,70 @@ cleanup:
     return err;
 }
 
-static void rx_read_command_completed_cb(struct ahci_binding *binding, void *tag)
+static void rw_request_done_cb(struct ahci_binding *binding, void *arg,
+        errval_t err)
 {
-    struct ahci_handle *h = binding->st;
-    VFS_BLK_DEBUG("rx_read_command_completed_cb(%p, tag: %p): entering\n",
-            binding, tag);
+    struct ahci_handle *h = arg;
+    VFS_BLK_DEBUG("rw_request_done_cb(%p, pending: %zu): entering\n",
+            binding, h->pending);
 
-    h->waiting = false;
+    if (err_is_fail(err) && err_is_ok(h->wait_status)) {
+        h->wait_status = err;
+    }
+    assert(h->pending > 0);
+    h->pending--;
+}
+
+/**
+ * \brief Transfer a DMA region in chunks that are all in flight at once.
+ */
+static errval_t rw_queued(struct ahci_handle *h, bool is_write, size_t pos,
+        struct ahci_dma_region *bufregion, size_t bytes)
+{
+    errval_t err = SYS_ERR_OK;
+    size_t nchunks = CEIL_DIV(bytes, BDFS_AHCI_CHUNK_SIZE);
+
+    // the chunks are views on the caller's region, one per request
+    struct ahci_dma_region *chunks = malloc(nchunks * sizeof(*chunks));
+    if (chunks == NULL && nchunks > 0) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    h->wait_status = SYS_ERR_OK;
+    h->pending = 0;
+
+    for (size_t i = 0; i < nchunks; i++) {
+        size_t offset = i * BDFS_AHCI_CHUNK_SIZE;
+        size_t len = bytes - offset;
+        if (len > BDFS_AHCI_CHUNK_SIZE) {
+            len = BDFS_AHCI_CHUNK_SIZE;
+        }
+        chunks[i].vaddr = (char *)bufregion->vaddr + offset;
+        chunks[i].paddr = bufregion->paddr + offset;
+        chunks[i].size = len;
+        chunks[i].backing_region = bufregion->backing_region;
+
+        // count first, the request may complete before ahci_queue_rw returns
+        h->pending++;
+        err = ahci_queue_rw(h->binding, is_write, (pos + offset) / PR_SIZE,
+                &chunks[i], len, rw_request_done_cb, h);
+        if (err_is_fail(err)) {
+            h->pending--;
+            break;
+        }
+    }
+
+    // wait for everything issued so far, even if issuing the rest failed
+    while (h->pending > 0) {
+        messages_wait_and_handle_next();
+    }
+
+    free(chunks);
+
+    VFS_BLK_DEBUG("bdfs_ahci: %s wait status: %lu\n",
+            is_write ? "write" : "read", h->wait_status);
+
+    return err_is_fail(err) ? err : h->wait_status;
 }
 
 errval_t blockdevfs_ahci_read(void *handle, size_t pos, void *buffer, size_t
@@ -179,38 +237,7 @@ errval_t blockdevfs_ahci_read(void *handle, size_t pos, void *buffer, size_t
     VFS_BLK_DEBUG("bdfs_ahci_read: bufregion = %p\n", bufregion);
     VFS_BLK_DEBUG("bdfs_ahci_read: bufregion->vaddr = %p\n", bufregion->vaddr);
 
-    // setup FIS
-    struct sata_fis_reg_h2d read_fis;
-    memset(&read_fis, 0, sizeof(struct sata_fis_reg_h2d));
-    read_fis.type = SATA_FIS_TYPE_H2D;
-    read_fis.device = 1 << 6; // LBA mode, not CHS; ???
-    sata_set_command(&read_fis, 0xC8); // read dma; ATA Command Set, 7.24
-    sata_set_count(&read_fis, aligned_bytes / PR_SIZE); // nr. of sectors/blocks
-    sata_set_lba28(&read_fis, pos / PR_SIZE);
-
-    // set handle to waiting
-    h->waiting = true;
-    h->wait_status = SYS_ERR_OK;
-    h->bytes_transferred = 0;
-    h->binding->rx_vtbl.command_completed = rx_read_command_completed_cb;
-
-    // load fis and fire commands
-    err = ahci_issue_command(h->binding, NOP_CONT, 0,
-            (uint8_t*)&read_fis, sizeof(read_fis), false, bufregion, aligned_bytes);
-    if (err_is_fail(err)) {
-        printf("bdfs_ahci: read load_fis failed: 0x%" PRIxPTR  "\n", err);
-        h->waiting = false;
-        goto cleanup;
-    }
-
-    // XXX: block for command completion (broken API!)
-    while (h->waiting) {
-        messages_wait_and_handle_next();
-    }
-
-    VFS_BLK_DEBUG("bdfs_ahci: read wait status: %lu\n", h->wait_status);
-
-    err = h->wait_status;
+    err = rw_queued(h, false, pos, bufregion, aligned_bytes);
 
     // cleanup and output
     if (err_is_ok(err)) {
@@ -218,23 +245,10 @@ errval_t blockdevfs_ahci_read(void *handle, size_t pos, void *buffer, size_t
         *bytes_read = aligned_bytes;
     }
 
-cleanup:
-
-    h->binding->rx_vtbl.command_completed = NULL;
-
     VFS_BLK_DEBUG("read: freeing bufregion (%p)\n", bufregion);
     ahci_dma_region_free(bufregion);
 
     return err;
-
-}
-
-static void rx_write_command_completed_cb(struct ahci_binding *binding, void *tag)
-{
-    struct ahci_handle *h = binding->st;
-    VFS_BLK_DEBUG("rx_write_command_completed_cb(%p, tag: %p): entering\n",
-            binding, tag);
-    h->waiting = false;
 }
 
 errval_t blockdevfs_ahci_write(void *handle, size_t pos, const void *buffer,
@@ -253,41 +267,14 @@ errval_t blockdevfs_ahci_write(void *handle, size_t pos, const void *buffer,
     }
     ahci_dma_region_copy_in(bufregion, buffer, 0, aligned_bytes);
 
-    // setup FIS
-    struct sata_fis_reg_h2d write_fis;
-    memset(&write_fis, 0, sizeof(struct sata_fis_reg_h2d));
-    write_fis.type = SATA_FIS_TYPE_H2D;
-    write_fis.device = 1 << 6; // LBA mode, not CHS; ???
-    sata_set_command(&write_fis, 0xCA); // write dma; ATA Command Set, 7.60
-    sata_set_count(&write_fis, aligned_bytes / PR_SIZE); // nr. of sectors/blocks
-    sata_set_lba28(&write_fis, pos / PR_SIZE);
-
-    // set handle to waiting
-    h->waiting = true;
-    h->wait_status = SYS_ERR_OK;
-    h->binding->rx_vtbl.command_completed = rx_write_command_completed_cb;
-
-    // load fis and fire commands
-    err = ahci_issue_command(h->binding, NOP_CONT, 0,
-            (uint8_t*)&write_fis, sizeof(write_fis), true, bufregion, aligned_bytes);
-    if (err_is_fail(err)) {
-        h->waiting = false;
-        ahci_dma_region_free(bufregion);
-        return err;
-    }
-
-    // XXX: block for command completion (broken API!)
-    while (h->waiting) {
-        messages_wait_and_handle_next();
-    }
+    err = rw_queued(h, true, pos, bufregion, aligned_bytes);
 
     // cleanup and output
-    h->binding->rx_vtbl.command_completed = NULL;
     ahci_dma_region_free(bufregion);
-    if (err_is_ok(h->wait_status)) {
+    if (err_is_ok(err)) {
         *bytes_written = aligned_bytes;
     }
-    return h->wait_status;
+    return err;
 }
 
 static void ahci_mgmt_bind_cb(void *st, errval_t err, struct ahci_mgmt_binding *b)
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009, 2011, ETH Zurich.
+ * Copyright (c) 2009, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -71,6 +71,11 @@
 
 #define fat_direntry_size 32
 
+// maximum number of clusters read in parallel, and their maximum total size
+// (the AHCI DMA pool is 1M and shared with the command tables)
+#define FAT_PREFETCH_CLUSTERS 16
+#define FAT_PREFETCH_BYTES (256 * 1024)
+
 #define cluster_for_offset(offset, mount) \
     ((offset) / ((mount)->block_size * (mount)->cluster_size))
 
@@ -280,6 +285,120 @@ next_cluster(struct fat_mount *mount, uint32_t cluster, uint32_t *rescluster)
     return SYS_ERR_OK;
 }
 
+#if defined(__x86_64__) || defined(__i386__)
+struct prefetch_req {
+    uint32_t cluster;
+    struct ahci_dma_region *region;
+    errval_t err;
+    size_t *pending;
+};
+
+static void
+prefetch_done_cb(struct ahci_binding *b, void *arg, errval_t err)
+{
+    struct prefetch_req *req = arg;
+    req->err = err;
+    (*req->pending)--;
+}
+
+/**
+ * \brief Read up to \p count clusters of a chain into the cluster cache.
+ *
+ * All clusters in the chain starting at \p cluster that are not yet cached
+ * are read with requests that are in flight together. This is best effort,
+ * clusters that could not be read are left to acquire_cluster().
+ */
+static void
+prefetch_clusters(struct fat_mount *mount, uint32_t cluster, size_t count)
+{
+    TRACE_ENTER_F("cluster=%"PRIu32", count=%zu", cluster, count);
+    errval_t err;
+    uint8_t *data;
+    size_t cluster_bytes = mount->block_size * mount->cluster_size;
+    struct prefetch_req reqs[FAT_PREFETCH_CLUSTERS];
+    size_t nreqs = 0, pending = 0;
+
+    // nothing to do if the first cluster is cached already
+    err = fs_cache_acquire(mount->cluster_cache, cluster, (void**)&data);
+    if (err_is_ok(err)) {
+        release_cluster(mount, cluster);
+        return;
+    }
+
+    if (count > FAT_PREFETCH_CLUSTERS) {
+        count = FAT_PREFETCH_CLUSTERS;
+    }
+    if (count > FAT_PREFETCH_BYTES / cluster_bytes) {
+        count = FAT_PREFETCH_BYTES / cluster_bytes;
+    }
+
+    // issue a read for every cluster of the window that is not cached
+    for (size_t i = 0; i < count; i++) {
+        if (cluster < 2 || cluster >= mount->last_cluster_start) {
+            break; // end of chain
+        }
+
+        err = fs_cache_acquire(mount->cluster_cache, cluster, (void**)&data);
+        if (err_is_ok(err)) {
+            release_cluster(mount, cluster);
+        }
+        else {
+            struct prefetch_req *req = &reqs[nreqs];
+            req->cluster = cluster;
+            req->err = SYS_ERR_OK;
+            req->pending = &pending;
+            err = ahci_dma_region_alloc(cluster_bytes, &req->region);
+            if (err_is_fail(err)) {
+                break;
+            }
+            pending++;
+            err = ahci_queue_rw(mount->ahci_binding, false,
+                    cluster_to_block(cluster, mount), req->region,
+                    cluster_bytes, prefetch_done_cb, req);
+            if (err_is_fail(err)) {
+                pending--;
+                ahci_dma_region_free(req->region);
+                break;
+            }
+            nreqs++;
+        }
+
+        if (i + 1 < count) {
+            err = next_cluster(mount, cluster, &cluster);
+            if (err_is_fail(err)) {
+                break;
+            }
+        }
+    }
+
+    while (pending > 0) {
+        messages_wait_and_handle_next();
+    }
+
+    // move the data into the cache
+    for (size_t i = 0; i < nreqs; i++) {
+        struct prefetch_req *req = &reqs[i];
+        if (err_is_ok(req->err)) {
+            data = malloc(cluster_bytes);
+            if (data != NULL) {
+                ahci_dma_region_copy_out(req->region, data, 0, cluster_bytes);
+                err = fs_cache_put(mount->cluster_cache, req->cluster, data);
+                if (err_is_ok(err)) {
+                    release_cluster(mount, req->cluster);
+                }
+                else {
+                    free(data);
+                }
+            }
+        }
+        else {
+            FAT_DEBUG_F("prefetch of cluster %"PRIu32" failed", req->cluster);
+        }
+        ahci_dma_region_free(req->region);
+    }
+}
+#endif
+
 static void
 update_lfn(const uint8_t *entry_data, fat_direntry_t *entry,
         uint16_t lfn_data[LFN_CHAR_COUNT])
@@ -770,6 +889,15 @@ read(void *st, vfs_handle_t fhandle, void *buffer, size_t bytes, size_t *bytes_r
         FAT_DEBUG_F("file cluster %zu is cluster %"PRIu32, cluster_index, cluster);
         assert(cluster < mount->last_cluster_start);
 
+#if defined(__x86_64__) || defined(__i386__)
+        // read the rest of the requested range with several reads in flight
+        if (mount->ahci_binding) {
+            size_t cluster_bytes = mount->cluster_size * mount->block_size;
+            prefetch_clusters(mount, cluster,
+                    CEIL_DIV(cluster_offset + remaining, cluster_bytes));
+        }
+#endif
+
         // fetch data and copy into buffer
         uint8_t *data;
         err = acquire_cluster(mount, cluster, &data);
@@ -868,6 +996,8 @@ stat(void *st, vfs_handle_t handle, struct vfs_fileinfo *info)
         info->type = VFS_FILE;
         info->size = fat_direntry_size_rd(&fhc->dirent);
     }
+    info->mtime = ((uint64_t)fat_direntry_wdate_rd(&fhc->dirent) << 16)
+                  | fat_direntry_wtime_rd(&fhc->dirent);
 
     return SYS_ERR_OK;;
 }
@@ -1007,6 +1137,8 @@ dir_read_next(void *st, vfs_handle_t dhandle, char **name, struct vfs_fileinfo *
     bool isdir = fat_direntry_attr_dir_rdf(&dirent);
     info->type = isdir ? VFS_DIRECTORY : VFS_FILE;
     info->size = fat_direntry_size_rd(&dirent);
+    info->mtime = ((uint64_t)fat_direntry_wdate_rd(&dirent) << 16)
+                  | fat_direntry_wtime_rd(&dirent);
     return SYS_ERR_OK;
 }
 
@@ -16,6 +16,7 @@
 #include <vfs/vfs_fd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/uio.h>
 #include <vfs/fdtab.h>
 
 #if 0
@@ -157,6 +158,124 @@ int vfsfd_write(int fd, const void *buf, size_t len)
     return retlen;
 }
 
+/**
+ * \brief iovecs shorter than this are gathered into a single call to the
+ *        backend, which for most file systems is a round trip to a server.
+ */
+#define VFSFD_IOV_BATCH     4096
+
+/**
+ * \brief Write a vector, see writev().
+ *
+ * Runs of short iovecs are copied together and written with one vfs_write(),
+ * longer ones are written directly. Stops at the first short write.
+ */
+ssize_t vfsfd_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    char batch[VFSFD_IOV_BATCH];
+    size_t batched = 0;
+    ssize_t total = 0;
+    int ret;
+
+    for (int i = 0; i <= iovcnt; i++) {
+        const char *base = i < iovcnt ? iov[i].iov_base : NULL;
+        size_t len = i < iovcnt ? iov[i].iov_len : 0;
+
+        if (i < iovcnt && batched + len <= sizeof(batch)) {
+            memcpy(batch + batched, base, len);
+            batched += len;
+            continue;
+        }
+
+        if (batched > 0) {
+            ret = vfsfd_write(fd, batch, batched);
+            if (ret < 0) {
+                return total > 0 ? total : -1;
+            }
+            total += ret;
+            if ((size_t)ret < batched) {
+                return total;
+            }
+            batched = 0;
+        }
+
+        if (len == 0) {
+            continue;
+        } else if (len < sizeof(batch)) {
+            memcpy(batch, base, len);
+            batched = len;
+            continue;
+        }
+
+        ret = vfsfd_write(fd, base, len);
+        if (ret < 0) {
+            return total > 0 ? total : -1;
+        }
+        total += ret;
+        if ((size_t)ret < len) {
+            return total;
+        }
+    }
+
+    return total;
+}
+
+/**
+ * \brief Read a vector, see readv().
+ *
+ * Runs of short iovecs are filled from one vfs_read() into a bounce buffer,
+ * longer ones are read directly. Stops at the first short read.
+ */
+ssize_t vfsfd_readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    char batch[VFSFD_IOV_BATCH];
+    ssize_t total = 0;
+    int ret;
+
+    for (int i = 0; i < iovcnt; ) {
+        // Find the run of short iovecs that fits into the bounce buffer
+        size_t want = 0;
+        int end = i;
+        while (end < iovcnt && want + iov[end].iov_len <= sizeof(batch)) {
+            want += iov[end++].iov_len;
+        }
+
+        if (end == i) {
+            // A long iovec, read it directly
+            ret = vfsfd_read(fd, iov[i].iov_base, iov[i].iov_len);
+            if (ret < 0) {
+                return total > 0 ? total : -1;
+            }
+            total += ret;
+            if ((size_t)ret < iov[i].iov_len) {
+                return total;
+            }
+            i++;
+            continue;
+        }
+
+        ret = vfsfd_read(fd, batch, want);
+        if (ret < 0) {
+            return total > 0 ? total : -1;
+        }
+
+        // Scatter what we got
+        size_t got = ret, off = 0;
+        for (; i < end && off < got; i++) {
+            size_t n = iov[i].iov_len < got - off ? iov[i].iov_len : got - off;
+            memcpy(iov[i].iov_base, batch + off, n);
+            off += n;
+        }
+        total += got;
+        if (got < want) {
+            return total;
+        }
+        i = end;
+    }
+
+    return total;
+}
+
 int vfsfd_close(int fd)
 {
     errval_t err;
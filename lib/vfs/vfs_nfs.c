@@ -829,6 +829,7 @@ static void getattr_callback(void *arg, struct nfs_client *client,
 
         info->type = nfs_type_to_vfs_type(res->type);
         info->size = res->size;
+        info->mtime = ((uint64_t)res->mtime.seconds << 32) | res->mtime.nseconds;
     } else {
         // XXX: no error reporting!
         printf("GETATTR Error: %d\n", result->status);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -13,8 +13,8 @@
 /// Global VirtIO debug switch
 #define VIRTIO_DEBUG_ENABLED 1
 
-/// Enables the virtqueue debugging
-#define VIRTIO_DEBUG_VQ_ENABLED 1
+/// Enables the virtqueue debugging (prints on every enqueue / dequeue)
+//#define VIRTIO_DEBUG_VQ_ENABLED 1
 
 /// Enables the VirtIO general device debugging messages
 #define VIRTIO_DEBUG_DEV_ENABLED 1
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -204,6 +204,54 @@ errval_t virtio_device_open_with_cap(struct virtio_device **dev,
     return err;
 }
 
+/**
+ * \brief attaches to a VirtIO device which has been initialized by another
+ *        domain. The device registers have already to be mapped.
+ *
+ * \param dev       returns the device structure
+ * \param init      information about the device and its backend
+ * \param features  the features negotiated by the owner of the device
+ */
+errval_t virtio_device_attach(struct virtio_device **dev,
+                              struct virtio_device_setup *setup,
+                              uint64_t features)
+{
+    errval_t err;
+
+    VIRTIO_DEBUG_DEV("virtio_device_attach: [%s]\n", setup->dev_name);
+
+    switch (setup->backend.type) {
+        case VIRTIO_DEVICE_BACKEND_MMIO:
+            if (setup->backend.args.mmio.dev_base == NULL
+                            || setup->backend.args.mmio.dev_size == 0) {
+                return VIRTIO_ERR_DEVICE_REGISTER;
+            }
+            err = virtio_device_mmio_init(dev, setup);
+            break;
+        case VIRTIO_DEVICE_BACKEND_PCI:
+        case VIRTIO_DEVICE_BACKEND_IO:
+            err = LIB_ERR_NOT_IMPLEMENTED;
+            break;
+        default:
+            err = VIRTIO_ERR_BACKEND;
+            break;
+    }
+
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct virtio_device *vdev = *dev;
+
+    strncpy(vdev->dev_name, setup->dev_name, sizeof(vdev->dev_name));
+    vdev->dev_t_st = setup->dev_t_st;
+    vdev->dev_cap = setup->dev_cap;
+    vdev->features = features;
+    vdev->state = VIRTIO_DEVICE_S_READY;
+
+    return SYS_ERR_OK;
+}
+
 /**
  * \brief checks if the device supports a certain feature
  *
@@ -307,7 +355,7 @@ errval_t virtio_device_notify_host(struct virtio_device *vdev,
                                    uint16_t virtq_id)
 {
     if (vdev->f->notify) {
-        vdev->f->notify(vdev, virtq_id);
+        return vdev->f->notify(vdev, virtq_id);
     }
     return VIRTIO_ERR_BACKEND;
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -7,7 +7,268 @@
  * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
  */
 
+#include <string.h>
+
 #include <barrelfish/barrelfish.h>
 
 #include <virtio/virtio.h>
+#include <virtio/virtqueue.h>
 #include <virtio/virtio_device.h>
+#include <virtio/virtio_guest.h>
+#include <virtio/devices/virtio_net.h>
+
+#include "device.h"
+#include "debug.h"
+
+/// number of descriptors of the control virtqueue
+#define VIRTIO_NET_CTRL_NDESC 4
+
+/// size of the control request slots in the header area of the control queue
+#define VIRTIO_NET_CTRL_SLOT_BITS 4
+#define VIRTIO_NET_CTRL_SLOT (1UL << VIRTIO_NET_CTRL_SLOT_BITS)
+
+/**
+ * \brief reads the device configuration and copies it into the local memory
+ *
+ * \param dev the network device to read the configuration space.
+ *
+ * \returns SYS_ERR_OK on success
+ */
+errval_t virtio_net_config_read(struct virtio_device_net *dev)
+{
+    VIRTIO_DEBUG_DT("reading device configuration\n");
+
+    return virtio_device_config_read(dev->vdev, &dev->config,
+                                     sizeof(dev->config));
+}
+
+/**
+ * \brief allocates the control virtqueue, which comes after the data queues
+ *        of all max_pairs queue pairs
+ */
+static errval_t virtio_net_ctrl_vq_alloc(struct virtio_device_net *dev,
+                                         uint8_t auto_add)
+{
+    errval_t err;
+
+    struct virtqueue_setup setup = {
+        .name = "Control Virtqueue",
+        .device = dev->vdev,
+        .queue_id = 2 * dev->max_pairs,
+        .vring_ndesc = VIRTIO_NET_CTRL_NDESC,
+        .vring_align = VIRTQUEUE_ALIGNMENT,
+        .max_indirect = 0,
+        .buffer_bits = 0,
+        .header_bits = VIRTIO_NET_CTRL_SLOT_BITS,
+        .auto_add = auto_add
+    };
+
+    err = virtio_virtqueue_alloc(&setup, &dev->ctrl_vq);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (auto_add) {
+        err = virtio_guest_add_virtq(dev->ctrl_vq);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        err = virtio_device_set_virtq(dev->vdev, dev->ctrl_vq);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief   handles the VirtIO network device common initialization.
+ *
+ * \param   vdev    the VirtIO device
+ * \param   arg     the setup information
+ *
+ * \returns SYS_ERR_OK on success
+ */
+static errval_t virtio_net_init_common(struct virtio_device *vdev,
+                                       void *arg)
+{
+    errval_t err;
+
+    VIRTIO_DEBUG_DT("Doing device specific setup: Network Device\n");
+
+    struct virtio_device_setup *setup = arg;
+    struct virtio_device_net *dev = virtio_device_get_type_state(vdev);
+
+    dev->vdev = vdev;
+
+    err = virtio_net_config_read(dev);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    bool has_ctrl = virtio_device_has_feature(vdev, VIRTIO_NET_F_CTRL_VQ);
+
+    dev->max_pairs = 1;
+    if (has_ctrl && virtio_device_has_feature(vdev, VIRTIO_NET_F_MQ)) {
+        dev->max_pairs = dev->config.max_virtqueue_pairs;
+    }
+
+    uint16_t pairs = setup->vq_num / 2;
+    if (pairs > dev->max_pairs) {
+        pairs = dev->max_pairs;
+    }
+    if (pairs > VIRTIO_NET_MAX_QUEUE_PAIRS) {
+        pairs = VIRTIO_NET_MAX_QUEUE_PAIRS;
+    }
+    if (pairs == 0) {
+        return VIRTIO_ERR_ARG_INVALID;
+    }
+
+    VIRTIO_DEBUG_DT("Using %u of %u queue pairs\n", pairs, dev->max_pairs);
+
+    /* receiveq1, transmitq1, ..., receiveqN, transmitqN */
+    err = virtio_device_virtqueue_alloc(vdev, setup->vq_setup, 2 * pairs);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    for (uint16_t i = 0; i < pairs; ++i) {
+        dev->rx_vq[i] = virtio_device_get_virtq(vdev,
+                                                virtio_net_rx_queue_index(i));
+        dev->tx_vq[i] = virtio_device_get_virtq(vdev,
+                                                virtio_net_tx_queue_index(i));
+        assert(dev->rx_vq[i] && dev->tx_vq[i]);
+    }
+    dev->num_pairs = pairs;
+
+    if (has_ctrl) {
+        err = virtio_net_ctrl_vq_alloc(dev, setup->vq_setup[0].auto_add);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    vdev->state = VIRTIO_DEVICE_S_READY;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief   handles the VirtIO network device common initialization.
+ *
+ * \param   dev     the VirtIO network device
+ * \param   setup   the setup information
+ *
+ * \returns SYS_ERR_OK on success
+ */
+errval_t virtio_net_init_device(struct virtio_device_net *dev,
+                                struct virtio_device_setup *setup)
+{
+    if (setup->dev_type != VIRTIO_DEVICE_TYPE_NET) {
+        VIRTIO_DEBUG_DT("ERROR: Device type was not VIRTIO_DEVICE_TYPE_NET\n");
+        return VIRTIO_ERR_DEVICE_TYPE;
+    }
+
+    if (setup->vq_num < 2 || setup->vq_setup == NULL) {
+        return VIRTIO_ERR_ARG_INVALID;
+    }
+
+    memset(dev, 0, sizeof(*dev));
+
+    setup->setup_fn = virtio_net_init_common;
+    setup->setup_arg = setup;
+    setup->dev_t_st = dev;
+
+    /* initialize the VirtIO device */
+    return virtio_device_open(&dev->vdev, setup);
+}
+
+/**
+ * \brief tells the device how many queue pairs the driver uses
+ *
+ * \param dev   the VirtIO network device
+ * \param pairs number of queue pairs, at most dev->num_pairs
+ *
+ * \returns SYS_ERR_OK on success
+ *          VIRTIO_ERR_NET_CTRL if the device rejected the command
+ */
+errval_t virtio_net_set_queue_pairs(struct virtio_device_net *dev,
+                                    uint16_t pairs)
+{
+    errval_t err;
+
+    if (pairs < VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MIN || pairs > dev->num_pairs) {
+        return VIRTIO_ERR_ARG_INVALID;
+    }
+
+    if (dev->ctrl_vq == NULL || dev->max_pairs == 1) {
+        /* the device only has the first queue pair */
+        return SYS_ERR_OK;
+    }
+
+    /*
+     * the request lives in the header area of the control virtqueue:
+     * [ctrl header] [number of pairs] [ack written by the device]
+     */
+    lvaddr_t vbase;
+    lpaddr_t pbase;
+    err = virtio_virtqueue_get_headers(dev->ctrl_vq, &vbase, &pbase);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct virtio_net_ctrl_hdr *hdr = (struct virtio_net_ctrl_hdr *) vbase;
+    uint16_t *num_pairs = (uint16_t *) (vbase + VIRTIO_NET_CTRL_SLOT);
+    uint8_t *ack = (uint8_t *) (vbase + 2 * VIRTIO_NET_CTRL_SLOT);
+
+    hdr->class = VIRTIO_NET_CTRL_MQ;
+    hdr->cmd = VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET;
+    *num_pairs = pairs;
+    *ack = VIRTIO_NET_ERR;
+
+    struct virtio_buffer bufs[3];
+    memset(bufs, 0, sizeof(bufs));
+    size_t lengths[3] = {
+        sizeof(*hdr),
+        sizeof(*num_pairs),
+        sizeof(*ack)
+    };
+
+    struct virtio_buffer_list bl;
+    virtio_blist_init(&bl);
+
+    for (uint8_t i = 0; i < 3; ++i) {
+        bufs[i].state = VIRTIO_BUFFER_S_ALLOCED;
+        bufs[i].paddr = pbase + i * VIRTIO_NET_CTRL_SLOT;
+        bufs[i].buf = (void *) (vbase + i * VIRTIO_NET_CTRL_SLOT);
+        bufs[i].length = lengths[i];
+        err = virtio_blist_append(&bl, &bufs[i]);
+        assert(err_is_ok(err));
+    }
+
+    /* two readable descriptors followed by the writable ack */
+    err = virtio_virtqueue_desc_enqueue(dev->ctrl_vq, &bl, NULL, 1, 2);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    virtio_virtqueue_notify_host(dev->ctrl_vq);
+
+    err = virtio_virtqueue_poll(dev->ctrl_vq, NULL, NULL, 1);
+
+    while (virtio_blist_head(&bl) != NULL) {
+        /* release the buffers on the stack */
+    }
+
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (*ack != VIRTIO_NET_OK) {
+        VIRTIO_DEBUG_DT("Device rejected %u queue pairs\n", pairs);
+        return VIRTIO_ERR_NET_CTRL;
+    }
+
+    return SYS_ERR_OK;
+}
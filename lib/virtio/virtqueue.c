@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -27,6 +27,19 @@
 #define VIRTQUEUE_FLAG_HAS_BUFFERS 14
 #define VIRTQUEUE_FLAG_FREE_CAP    15
 
+/*
+ * memory barriers ordering our accesses to the vring with the ones of the host.
+ * x86 does not reorder stores with stores or loads with loads.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define virtqueue_wmb() __asm volatile("" ::: "memory")
+#define virtqueue_rmb() __asm volatile("" ::: "memory")
+#else
+#define virtqueue_wmb() __sync_synchronize()
+#define virtqueue_rmb() __sync_synchronize()
+#endif
+#define virtqueue_mb()  __sync_synchronize()
+
 /**
  * this data structure stores additional information to the descriptors
  */
@@ -111,7 +124,8 @@ static bool virtqueue_interrupt_enable(struct virtqueue *vq,
         vq->vring.avail->flags &= ~VIRTIO_RING_AVAIL_F_NO_INTERRUPT;
     }
 
-    assert(!"NYI: memory barrier mb()");
+    /* the host must see the new threshold before we check the used index */
+    virtqueue_mb();
 
     if (virtio_virtqueue_get_num_used(vq) > num_desc) {
         return 1;
@@ -376,7 +390,7 @@ errval_t virtio_virtqueue_alloc_with_caps(struct virtqueue_setup *setup,
         assert(vq->buffer_alloc);
     }
 
-    if (vq->header_bits) {
+    if (setup->header_bits) {
         vq->flags |= (1 << VIRTQUEUE_FLAG_HAS_BUFFERS);
         vq->header_bits = setup->header_bits;
     }
@@ -497,6 +511,52 @@ uint16_t virtio_virtqueue_get_num_desc(struct virtqueue *vq)
     return vq->desc_num;
 }
 
+/**
+ * \brief Returns the number of free descriptors of this virtqueue
+ *
+ * \param vq pointer to the virtqueue structure
+ *
+ * \returns number of free descriptors
+ */
+uint16_t virtio_virtqueue_get_num_free(struct virtqueue *vq)
+{
+    return vq->free_count;
+}
+
+/**
+ * \brief returns the header area allocated with the vring (setup.header_bits)
+ *
+ * \param vq        the virtqueue
+ * \param ret_vbase returns the virtual base of the header area
+ * \param ret_pbase returns the physical base of the header area
+ *
+ * \returns SYS_ERR_OK on success
+ *          VIRTIO_ERR_NO_BUFFER if no headers were allocated
+ */
+errval_t virtio_virtqueue_get_headers(struct virtqueue *vq,
+                                      lvaddr_t *ret_vbase,
+                                      lpaddr_t *ret_pbase)
+{
+    if (vq->header_bits == 0) {
+        return VIRTIO_ERR_NO_BUFFER;
+    }
+
+    size_t offset = vring_size(vq->desc_num, vq->vring_align);
+    offset = ROUND_UP(offset, BASE_PAGE_SIZE);
+    if (vq->buffer_bits) {
+        offset += vq->desc_num * (1UL << vq->buffer_bits);
+    }
+
+    if (ret_vbase) {
+        *ret_vbase = vq->vring_vaddr + offset;
+    }
+    if (ret_pbase) {
+        *ret_pbase = vq->vring_paddr + offset;
+    }
+
+    return SYS_ERR_OK;
+}
+
 /**
  * \brief Returns the queue index of the virtqueue of the device
  *
@@ -656,12 +716,21 @@ void virtio_virtqueue_intr_disable(struct virtqueue *vq)
  */
 void virtio_virtqueue_notify_host(struct virtqueue *vq)
 {
-    /* TODO: memory barrier */
+    if (vq->desc_num_queued == 0) {
+        return;
+    }
+
+    /* the ring entries must be visible before the new available index */
+    virtqueue_wmb();
+    vq->vring.avail->idx += vq->desc_num_queued;
+
+    /* publish the index before reading the host's event index / flags */
+    virtqueue_mb();
+
     if (virtqueue_should_notify_host(vq)) {
         virtio_device_notify_host(vq->device, vq->queue_index);
     }
     vq->desc_num_queued = 0;
-
 }
 
 /*
@@ -807,21 +876,20 @@ errval_t vring_free(struct vring *vr)
  *
  * \param vq    the virtqueue to update
  * \param idx   index of the new descriptor chain head
+ *
+ * The available index is not updated here. virtio_virtqueue_notify_host()
+ * publishes all chains queued since the last notification at once.
  */
 static void virtqueue_update_available(struct virtqueue *vq,
                                        uint16_t idx)
 {
-    uint16_t avail_idx = vq->vring.avail->idx & (vq->desc_num - 1);
+    uint16_t avail_idx = (vq->vring.avail->idx + vq->desc_num_queued)
+                    & (vq->desc_num - 1);
     vq->vring.avail->ring[avail_idx] = idx;
 
-    /*
-     * wmb();
-     */
-
-    VIRTIO_DEBUG_VQ("VQ(%u) avail index = %u, num_queued = %u\n",
-                    vq->queue_index, vq->vring.avail->idx + 1, vq->desc_num_queued + 1);
+    VIRTIO_DEBUG_VQ("VQ(%u) avail slot = %u, num_queued = %u\n",
+                    vq->queue_index, avail_idx, vq->desc_num_queued + 1);
 
-    vq->vring.avail->idx++;
     vq->desc_num_queued++;
 }
 
@@ -954,7 +1022,6 @@ errval_t virtio_virtqueue_desc_enqueue(struct virtqueue *vq,
      */
 
     uint16_t free_head = vq->free_head;
-    debug_printf("enq using info [%u]\n", free_head);
     struct vring_desc_info *info = &vq->vring_di[free_head];
 
     info->is_head = 0x1;
@@ -1009,6 +1076,49 @@ static errval_t virtqueue_free_desc_chain(struct virtqueue *vq,
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief returns the descriptor chain of a used ring element to the free list
+ *
+ * \param vq     the virtqueue the element belongs to
+ * \param elem   the used ring element
+ * \param ret    returns the buffer list, state and written length of the chain
+ *
+ * \returns SYS_ERR_OK on success
+ *          VIRTIO_ERR_DEQ_CHAIN if the chain was corrupted
+ */
+static errval_t virtqueue_dequeue_elem(struct virtqueue *vq,
+                                       struct vring_used_elem *elem,
+                                       struct virtqueue_used *ret)
+{
+    errval_t err;
+
+    uint16_t desc_idx = (uint16_t) elem->id;
+
+    VIRTIO_DEBUG_VQ("Dequeuing element on the used ring: [%u, %u]\n",
+                    elem->id, elem->length);
+
+    /* get the descritpor information */
+    struct vring_desc_info *info = &vq->vring_di[desc_idx];
+
+    assert(info->is_head);
+    assert(info->bl);
+
+    struct virtio_buffer_list *bl = info->bl;
+
+    err = virtqueue_free_desc_chain(vq, desc_idx);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    bl->state = VIRTIO_BUFFER_LIST_S_FILLED;
+
+    ret->bl = bl;
+    ret->st = info->st;
+    ret->length = elem->length;
+
+    return SYS_ERR_OK;
+}
+
 /**
  * \brief dequeues a descriptor chain form the virtqueue
  *
@@ -1026,10 +1136,6 @@ errval_t virtio_virtqueue_desc_dequeue(struct virtqueue *vq,
 {
     errval_t err;
 
-    struct vring_used_elem *elem;
-
-    uint16_t used_idx, desc_idx;
-
     /*
      * check if there is a descriptor available
      */
@@ -1037,46 +1143,74 @@ errval_t virtio_virtqueue_desc_dequeue(struct virtqueue *vq,
         return VIRTIO_ERR_NO_DESC_AVAIL;
     }
 
-    used_idx = vq->used_tail++ & (vq->desc_num - 1);
-    elem = &vq->vring.used->ring[used_idx];
+    /* read the element only after we have seen the used index */
+    virtqueue_rmb();
 
-    VIRTIO_DEBUG_VQ("Dequeuing element [%u] on the used ring: [%u, %u]\n",
-                        used_idx, elem->id, elem->length);
+    uint16_t used_idx = vq->used_tail & (vq->desc_num - 1);
 
-    /*
-     * TODO: read memory barrier
-     * rmb();
-     * */
-    desc_idx = (uint16_t) elem->id;
-
-    /* get the descritpor information */
-    struct vring_desc_info *info = &vq->vring_di[desc_idx];
-    debug_printf("deq using info [%u]\n", desc_idx);
-
-    assert(info->is_head);
-    assert(info->bl);
-
-    struct virtio_buffer_list *bl = info->bl;
-
-    err = virtqueue_free_desc_chain(vq, desc_idx);
+    struct virtqueue_used used;
+    err = virtqueue_dequeue_elem(vq, &vq->vring.used->ring[used_idx], &used);
     if (err_is_fail(err)) {
-        used_idx = vq->used_tail-- & (vq->desc_num - 1);
         return err;
     }
-
-    bl->state = VIRTIO_BUFFER_LIST_S_FILLED;
+    vq->used_tail++;
 
     if (ret_bl) {
-        *ret_bl = bl;
+        *ret_bl = used.bl;
     }
 
     if (ret_st) {
-        *ret_st = info->st;
+        *ret_st = used.st;
     }
 
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief dequeues up to max descriptor chains from the virtqueue
+ *
+ * \param vq     the virtqueue to dequeue descriptors from
+ * \param used   array of at least max elements to store the chains in
+ * \param max    maximum number of chains to dequeue
+ *
+ * \returns number of dequeued descriptor chains
+ *
+ * The used index is read once for the whole batch.
+ */
+uint16_t virtio_virtqueue_desc_dequeue_batch(struct virtqueue *vq,
+                                             struct virtqueue_used *used,
+                                             uint16_t max)
+{
+    errval_t err;
+
+    uint16_t num = virtio_virtqueue_get_num_used(vq);
+    if (num > max) {
+        num = max;
+    }
+
+    if (num == 0) {
+        return 0;
+    }
+
+    /* read the elements only after we have seen the used index */
+    virtqueue_rmb();
+
+    uint16_t i;
+    for (i = 0; i < num; ++i) {
+        uint16_t used_idx = vq->used_tail & (vq->desc_num - 1);
+        err = virtqueue_dequeue_elem(vq, &vq->vring.used->ring[used_idx],
+                                     &used[i]);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "dequeuing VQ(%u) element %u", vq->queue_index,
+                      used_idx);
+            break;
+        }
+        vq->used_tail++;
+    }
+
+    return i;
+}
+
 /**
  * \brief polls the virtqueue
  *
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -505,6 +505,7 @@ static void xphi_bind_cb(void *st,
 
     txq_init(&cl->txq, b, get_default_waitset(),
              (txq_register_fn_t) b->register_send, sizeof(struct xphi_msg_st));
+    txq_set_stats(&cl->txq, b->stats);
 
     b->rx_vtbl = xphi_svc_rx_vtbl;
     b->st = cl;
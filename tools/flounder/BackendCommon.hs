@@ -3,7 +3,7 @@
 
   Part of Flounder: a message passing IDL for Barrelfish
 
-  Copyright (c) 2007-2010, ETH Zurich.
+  Copyright (c) 2007-2010, 2016, ETH Zurich.
   All rights reserved.
 
   This file is distributed under the terms in the attached LICENSE file.
@@ -68,6 +68,14 @@ msg_enum_name ifn = ifscope ifn "msg_enum"
 msg_enum_elem_name :: String -> String -> String
 msg_enum_elem_name ifn mn = idscope ifn mn "msgnum"
 
+-- Name of the number of message numbers (macro)
+msg_count_name :: String -> String
+msg_count_name ifn = ifscope ifn "msgnum_count"
+
+-- Name of the function returning the name of a message number
+msg_name_fn_name :: String -> String
+msg_name_fn_name ifn = ifscope ifn "msg_name"
+
 -- Name of the type of a message function
 msg_sig_type :: String -> MessageDef -> Direction -> String
 msg_sig_type ifn m@(RPC _ _ _) _ = idscope ifn (msg_name m) "rpc_method_fn"
@@ -263,14 +271,24 @@ binding_struct_init drv ifn binding_var waitset_ex tx_vtbl_ex = [
         [C.Ex $ C.Assignment (C.FieldOf binding_var f) (C.NumConstant 0)
          | f <- ["tx_msgnum", "rx_msgnum", "tx_msg_fragment", "rx_msg_fragment",
                  "tx_str_pos", "rx_str_pos", "tx_str_len", "rx_str_len"]],
-    C.Ex $ C.Assignment (C.FieldOf binding_var "bind_cont") (C.Variable "NULL")]
+    C.Ex $ C.Assignment (C.FieldOf binding_var "bind_cont") (C.Variable "NULL"),
+    C.SIfDef "FLOUNDER_STATS"
+        [C.Ex $ C.Assignment (C.FieldOf binding_var "stats")
+            (C.Call "flounder_stats_alloc"
+                [C.StringConstant ifn, C.StringConstant drv,
+                 C.Variable $ msg_count_name ifn,
+                 C.Variable $ msg_name_fn_name ifn])]
+        [C.Ex $ C.Assignment (C.FieldOf binding_var "stats") (C.Variable "NULL")]]
 
 binding_struct_destroy :: String -> C.Expr -> [C.Stmt]
 binding_struct_destroy ifn binding_var
     = [C.Ex $ C.Call "flounder_support_waitset_chanstate_destroy"
             [C.AddressOf $ C.FieldOf binding_var "register_chanstate"],
        C.Ex $ C.Call "flounder_support_waitset_chanstate_destroy"
-            [C.AddressOf $ C.FieldOf binding_var "tx_cont_chanstate"]]
+            [C.AddressOf $ C.FieldOf binding_var "tx_cont_chanstate"],
+       C.SIfDef "FLOUNDER_STATS"
+            [C.Ex $ C.Call "flounder_stats_free" [C.FieldOf binding_var "stats"]]
+            []]
 
 --
 -- Generate a generic can_send function
@@ -290,6 +308,11 @@ can_send_fn_def drv ifn =
 register_send_fn_def :: String -> String -> C.Unit
 register_send_fn_def drv ifn =
     C.FunctionDef C.Static (C.TypeName "errval_t") (register_send_fn_name drv ifn) params [
+        C.SIfDef "FLOUNDER_STATS"
+            [C.Ex $ C.Call "flounder_stats_register_send"
+                [bindvar `C.DerefField` "stats",
+                 C.Call (can_send_fn_name drv ifn) [bindvar]]]
+            [],
         C.Return $ C.Call "flounder_support_register"
             [C.Variable "ws",
              C.AddressOf $ bindvar `C.DerefField` "register_chanstate",
@@ -352,15 +375,30 @@ register_txcont cont_ex = [
     ] where
         errvar = C.Variable "_err"
 
--- starting a send: just a debug hook
+-- call a statistics hook of flounder/flounder_stats.h, if enabled
+stats_hook :: String -> [C.Expr] -> C.Stmt
+stats_hook fn args
+    = C.SIfDef "FLOUNDER_STATS"
+        [C.Ex $ C.Call fn ((bindvar `C.DerefField` "stats") : args)] []
+
+-- refuse a send while another message is in progress
+tx_busy_check :: String -> String -> C.Stmt
+tx_busy_check ifn mn
+    = C.If (C.Binary C.NotEquals (bindvar `C.DerefField` "tx_msgnum") (C.NumConstant 0))
+        [stats_hook "flounder_stats_tx_busy" [C.Variable $ msg_enum_elem_name ifn mn],
+         C.Return $ C.Variable "FLOUNDER_ERR_TX_BUSY"] []
+
+-- starting a send: debug and statistics hooks
 start_send :: String -> String -> String -> [MessageArgument] -> [C.Stmt]
 start_send drvn ifn mn msgargs
     = [C.Ex $ C.Call "FL_DEBUG" [C.StringConstant $
-                                 drvn ++ " TX " ++ ifn ++ "." ++ mn ++ "\n"]]
+                                 drvn ++ " TX " ++ ifn ++ "." ++ mn ++ "\n"],
+       stats_hook "flounder_stats_tx_start" []]
 
 -- finished a send: clear msgnum, trigger pending waitsets/events
 finished_send :: [C.Stmt]
 finished_send = [
+    stats_hook "flounder_stats_tx_done" [tx_msgnum_field],
     C.Ex $ C.Assignment tx_msgnum_field (C.NumConstant 0)] ++
     [C.Ex $ C.Call "flounder_support_trigger_chan" [wsaddr ws]
     | ws <- ["tx_cont_chanstate", "register_chanstate"]]
@@ -389,7 +427,9 @@ finished_recv drvn ifn typedefs mn msgargs
     = [C.Ex $ C.Call "FL_DEBUG" [C.StringConstant $
                                  drvn ++ " RX " ++ ifn ++ "." ++ mn ++ "\n"],
        C.Ex $ C.Call "assert" [C.Binary C.NotEquals handler (C.Variable "NULL")],
+       stats_hook "flounder_stats_rx_start" [],
        C.Ex $ C.CallInd handler (bindvar:args),
+       stats_hook "flounder_stats_rx_done" [C.Variable $ msg_enum_elem_name ifn mn],
        C.Ex $ C.Assignment rx_msgnum_field (C.NumConstant 0)]
     where
         rx_msgnum_field = C.DerefField bindvar "rx_msgnum"
@@ -3,7 +3,7 @@
 
   Part of Flounder: a message passing IDL for Barrelfish
 
-  Copyright (c) 2007-2010, ETH Zurich.
+  Copyright (c) 2007-2010, 2016, ETH Zurich.
   All rights reserved.
 
   This file is distributed under the terms in the attached LICENSE file.
@@ -76,6 +76,11 @@ intf_header_body infile interface@(Interface name descr decls) =
 
         C.MultiComment [ "Enumeration for message numbers" ],
         msg_enums name messages,
+        msg_count name messages,
+        C.Blank,
+
+        C.MultiComment [ "Message names, for statistics and debugging" ],
+        msg_name_fn name messages,
         C.Blank,
 
         C.MultiComment [ "Message type signatures (transmit)" ],
@@ -156,6 +161,24 @@ msg_enums ifname msgs
          [C.EnumItem (msg_enum_elem_name ifname (msg_name m)) (Just $ C.NumConstant i)
             | (m, i) <- zip msgs [3..]])
 
+-- Number of message numbers, including the reserved ones
+msg_count :: String -> [MessageDef] -> C.Unit
+msg_count ifname msgs
+    = C.Define (msg_count_name ifname) [] (show $ 3 + length msgs)
+
+--
+-- Generate a function returning the name of a message number
+--
+msg_name_fn :: String -> [MessageDef] -> C.Unit
+msg_name_fn ifname msgs
+    = C.StaticInline (C.Ptr $ C.ConstT $ C.TypeName "char")
+        (msg_name_fn_name ifname) [C.Param (C.TypeName "unsigned") "msgnum"]
+        [C.Switch (C.Variable "msgnum")
+            [C.Case (C.Variable $ msg_enum_elem_name ifname mn)
+                [C.Return $ C.StringConstant mn]
+             | mn <- ["__bind", "__bind_reply"] ++ map msg_name msgs]
+            [C.Return $ C.Variable "NULL"]]
+
 --
 -- Generate type definitions for each message signature
 --
@@ -283,7 +306,11 @@ binding_struct n ml = C.StructDecl (intf_bind_type n) fields
         C.Param (C.TypeName "size_t") "tx_str_len",
         C.Param (C.TypeName "size_t") "rx_str_len",
         C.Param (C.Struct "event_queue_node") "event_qnode",
-        C.Param (C.Ptr $ C.TypeName $ intf_bind_cont_type n) "bind_cont"]
+        C.Param (C.Ptr $ C.TypeName $ intf_bind_cont_type n) "bind_cont",
+        C.ParamBlank,
+
+        C.ParamComment "Message statistics, NULL unless built with FLOUNDER_STATS",
+        C.Param (C.Ptr $ C.Struct "flounder_binding_stats") "stats"]
 
 --
 -- Generate the binding structure
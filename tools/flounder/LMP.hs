@@ -3,7 +3,7 @@
 
   Part of Flounder: a message passing IDL for Barrelfish
 
-  Copyright (c) 2007-2011, ETH Zurich.
+  Copyright (c) 2007-2011, 2016, ETH Zurich.
   All rights reserved.
 
   This file is distributed under the terms in the attached LICENSE file.
@@ -543,8 +543,7 @@ tx_fn ifn typedefs msg@(Message _ n args _) =
         cont_param = C.Param (C.Struct "event_closure") intf_cont_var
         body = [
             C.SComment "check that we can accept an outgoing message",
-            C.If (C.Binary C.NotEquals tx_msgnum_field (C.NumConstant 0))
-                [C.Return $ C.Variable "FLOUNDER_ERR_TX_BUSY"] [],
+            tx_busy_check ifn n,
             C.SBlank,
             C.SComment "register send continuation",
             C.StmtList $ register_txcont (C.Variable intf_cont_var),
@@ -3,7 +3,7 @@
 
   Part of Flounder: a message passing IDL for Barrelfish
 
-  Copyright (c) 2007-2010, ETH Zurich.
+  Copyright (c) 2007-2010, 2016, ETH Zurich.
   All rights reserved.
 
   This file is distributed under the terms in the attached LICENSE file.
@@ -17,6 +17,7 @@ import qualified CAbsSyntax as C
 import qualified Backend
 import BackendCommon hiding (errvar)
 import GHBackend (msg_signature_generic, intf_vtbl_param)
+import THCBackend (isOOORPC)
 import Syntax
 
 ------------------------------------------------------------------------
@@ -51,6 +52,53 @@ rpc_error_fn_name ifn = ifscope ifn "rpc_client_error"
 rpc_vtbl_type :: String -> String
 rpc_vtbl_type ifn = ifscope ifn "rpc_vtbl"
 
+-- Name of the blocking pipelined RPC function
+rpc_pipelined_fn_name ifn mn = idscope ifn mn "rpc_pipelined"
+
+-- Name of the asynchronous pipelined RPC function
+rpc_async_fn_name ifn mn = idscope ifn mn "rpc_async"
+
+-- Name of the predicate for issuing a pipelined call
+rpc_can_issue_fn_name :: String -> String
+rpc_can_issue_fn_name ifn = ifscope ifn "rpc_can_issue"
+
+-- Name of the function moving the binding back to the RPC waitset
+rpc_restore_waitset_fn_name :: String -> String
+rpc_restore_waitset_fn_name ifn = ifscope ifn "rpc_restore_waitset"
+
+------------------------------------------------------------------------
+-- Pipelined RPCs
+------------------------------------------------------------------------
+
+-- Tagged RPCs (in uint64 seq_in, out uint64 seq_out, ..., the convention of
+-- the THC out-of-order stubs) can have several calls outstanding. The tag is
+-- chosen by the stubs, the remaining arguments are those of the RPC.
+-- Fixed-size array results are excluded, they live in the binding and are
+-- overwritten by the next reply.
+pipelined_rpcs :: [TypeDef] -> [MessageDef] -> [MessageDef]
+pipelined_rpcs typedefs rpcs = [m | m <- rpcs, is_pipelined m]
+    where
+        is_pipelined m =
+            isOOORPC m && all plain_result (tail_args m)
+                && length (out_ptr_names m) <= max_out_ptrs
+        plain_result (RPCArgOut tr (Name _)) =
+            case lookup_typeref typedefs tr of
+                TArray _ _ _ -> False
+                _ -> True
+        plain_result _ = True
+
+-- Must match FLOUNDER_RPC_MAX_OUT in flounder/flounder_rpc.h
+max_out_ptrs :: Int
+max_out_ptrs = 8
+
+-- Arguments of a pipelined RPC without the tags
+tail_args :: MessageDef -> [RPCArgument]
+tail_args (RPC _ args _) = drop 2 args
+
+-- Names of the result pointers, in the order they are stored in the slot
+out_ptr_names :: MessageDef -> [String]
+out_ptr_names m = concat [arg_names a | a <- snd $ partition_rpc_args $ tail_args m]
+
 ------------------------------------------------------------------------
 -- Language mapping: Create the header file for this interconnect driver
 ------------------------------------------------------------------------
@@ -71,6 +119,7 @@ rpc_header_body infile interface@(Interface name descr decls) = [
     C.MultiComment [ "RPC client" ],
     C.Blank,
     C.Include C.Standard ("if/" ++ name ++ "_defs.h"),
+    C.Include C.Standard "flounder/flounder_rpc.h",
     C.Blank,
     C.MultiComment [ "Forward declaration of binding type" ],
     C.StructForwardDecl (rpc_bind_type name),
@@ -83,14 +132,20 @@ rpc_header_body infile interface@(Interface name descr decls) = [
     rpc_vtbl_decl name rpcs,
     C.Blank,
     C.MultiComment [ "The Binding structure" ],
-    rpc_binding_struct name,
+    rpc_binding_struct name (not $ null pipelined),
     C.Blank,
     C.MultiComment [ "Function to initialise an RPC client" ],
     rpc_init_fn_proto name,
-    C.Blank]
+    C.Blank,
+    if null pipelined then C.NoOp else C.UnitList [
+        C.MultiComment [ "Pipelined RPC functions" ],
+        C.UnitList [ rpc_pipelined_fn_proto name types m | m <- pipelined ],
+        C.UnitList [ rpc_async_fn_proto name types m | m <- pipelined ],
+        C.Blank]]
     where
         (types, messagedecls) = Backend.partitionTypesMessages decls
         rpcs = [m | m@(RPC _ _ _) <- messagedecls]
+        pipelined = pipelined_rpcs types rpcs
 
 rpc_vtbl_decl :: String -> [MessageDef] -> C.Unit
 rpc_vtbl_decl n ml =
@@ -99,8 +154,8 @@ rpc_vtbl_decl n ml =
 rpc_binding_param :: String -> C.Param
 rpc_binding_param ifname = C.Param (C.Ptr $ C.Struct $ rpc_bind_type ifname) rpc_bind_var
 
-rpc_binding_struct :: String -> C.Unit
-rpc_binding_struct name = C.StructDecl (rpc_bind_type name) fields
+rpc_binding_struct :: String -> Bool -> C.Unit
+rpc_binding_struct name has_pipelined = C.StructDecl (rpc_bind_type name) fields
   where
     fields = [
         C.Param (C.Ptr $ C.Struct $ intf_bind_type name) "b",
@@ -110,6 +165,10 @@ rpc_binding_struct name = C.StructDecl (rpc_bind_type name) fields
         C.Param (C.TypeName "errval_t") "async_error",
         C.Param (C.Struct "waitset") "rpc_waitset",
         C.Param (C.Struct "waitset_chanstate") "dummy_chanstate"]
+        ++ (if has_pipelined
+            then [C.ParamComment "Outstanding pipelined calls",
+                  C.Param (C.Struct "flounder_rpc_window") "window"]
+            else [])
 
 rpc_init_fn_proto :: String -> C.Unit
 rpc_init_fn_proto n =
@@ -118,6 +177,32 @@ rpc_init_fn_proto n =
     where
       name = rpc_init_fn_name n
 
+rpc_pipelined_fn_params :: String -> [TypeDef] -> MessageDef -> [C.Param]
+rpc_pipelined_fn_params ifn typedefs m =
+    [rpc_binding_param ifn] ++ concat [rpc_argdecl2 ifn typedefs a | a <- tail_args m]
+
+rpc_async_fn_params :: String -> [TypeDef] -> MessageDef -> [C.Param]
+rpc_async_fn_params ifn typedefs m =
+    [rpc_binding_param ifn,
+     C.Param (C.Ptr $ C.Struct "waitset") "_ws",
+     C.Param (C.Struct "event_closure") "_continuation",
+     C.Param (C.Ptr $ C.TypeName "errval_t") "_result"]
+    ++ concat [rpc_argdecl2 ifn typedefs a | a <- tail_args m]
+
+rpc_pipelined_fn_proto :: String -> [TypeDef] -> MessageDef -> C.Unit
+rpc_pipelined_fn_proto ifn typedefs m =
+    C.GVarDecl C.Extern C.NonConst
+         (C.Function C.NoScope (C.TypeName "errval_t")
+                     (rpc_pipelined_fn_params ifn typedefs m))
+         (rpc_pipelined_fn_name ifn (msg_name m)) Nothing
+
+rpc_async_fn_proto :: String -> [TypeDef] -> MessageDef -> C.Unit
+rpc_async_fn_proto ifn typedefs m =
+    C.GVarDecl C.Extern C.NonConst
+         (C.Function C.NoScope (C.TypeName "errval_t")
+                     (rpc_async_fn_params ifn typedefs m))
+         (rpc_async_fn_name ifn (msg_name m)) Nothing
+
 ------------------------------------------------------------------------
 -- Language mapping: Create the stub (implementation) for this interconnect driver
 ------------------------------------------------------------------------
@@ -138,11 +223,19 @@ rpc_stub_body infile intf@(Interface ifn descr decls) = C.UnitList [
     C.Blank,
 
     C.MultiComment [ "RPC wrapper functions" ],
-    C.UnitList [ rpc_fn ifn types m | m <- rpcs ],
+    C.UnitList [ rpc_fn ifn types (m `elem` pipelined) m | m <- rpcs ],
     C.Blank,
 
+    if null pipelined then C.NoOp else C.UnitList [
+        C.MultiComment [ "Pipelined RPC functions" ],
+        rpc_can_issue_fn ifn,
+        rpc_restore_waitset_fn ifn,
+        C.UnitList [ rpc_pipelined_fn ifn types m | m <- pipelined ],
+        C.UnitList [ rpc_async_fn ifn types m | m <- pipelined ],
+        C.Blank],
+
     C.MultiComment [ "Receive handlers" ],
-    C.UnitList [ rpc_rx_handler_fn ifn types m | m <- rpcs ],
+    C.UnitList [ rpc_rx_handler_fn ifn types (m `elem` pipelined) m | m <- rpcs ],
     C.Blank,
 
     C.MultiComment [ "RPC Vtable" ],
@@ -150,20 +243,35 @@ rpc_stub_body infile intf@(Interface ifn descr decls) = C.UnitList [
     C.Blank,
 
     C.MultiComment [ "Error handler" ],
-    rpc_error_fn ifn,
+    rpc_error_fn ifn (not $ null pipelined),
     C.Blank,
 
     C.MultiComment [ "Init function" ],
-    rpc_init_fn ifn rpcs]
+    rpc_init_fn ifn rpcs (not $ null pipelined)]
     where
         (types, messagedecls) = Backend.partitionTypesMessages decls
         rpcs = [m | m@(RPC _ _ _) <- messagedecls]
+        pipelined = pipelined_rpcs types rpcs
 
-rpc_fn :: String -> [TypeDef] -> MessageDef -> C.Unit
-rpc_fn ifn typedefs msg@(RPC n args _) =
+rpc_fn :: String -> [TypeDef] -> Bool -> MessageDef -> C.Unit
+rpc_fn ifn typedefs pipelined msg@(RPC n args _) =
     C.FunctionDef C.Static (C.TypeName "errval_t") (rpc_fn_name ifn n) params [
         localvar (C.TypeName "errval_t") errvar_name (Just $ C.Variable "SYS_ERR_OK"),
         C.Ex $ C.Call "assert" [C.Unary C.Not rpc_progress_var],
+        if pipelined
+            then C.SComment "replies are matched by tag, don't mix with pipelined calls"
+            else C.StmtList [],
+        if pipelined
+            then C.Ex $ C.Call "assert" [C.Binary C.Equals
+                    (rpcvar `C.DerefField` "window" `C.FieldOf` "outstanding")
+                    (C.NumConstant 0)]
+            else C.StmtList [],
+        if pipelined
+            then C.StmtList [
+                C.Ex $ C.Assignment errvar $
+                    C.Call (rpc_restore_waitset_fn_name ifn) [rpcvar],
+                C.If (C.Call "err_is_fail" [errvar]) [C.Goto "out"] []]
+            else C.StmtList [],
         C.Ex $ C.Call "assert" [C.Binary C.Equals async_err_var (C.Variable "SYS_ERR_OK")],
         C.Ex $ C.Assignment rpc_progress_var (C.Variable "true"),
         C.Ex $ C.Assignment reply_present_var (C.Variable "false"),
@@ -217,19 +325,196 @@ rpc_fn ifn typedefs msg@(RPC n args _) =
         mkargs (Arg _ (DynamicArray an al)) = [an, al]
         (txargs, rxargs) = partition_rpc_args args
 
+rpc_can_issue_fn :: String -> C.Unit
+rpc_can_issue_fn ifn =
+    C.FunctionDef C.Static (C.TypeName "bool") (rpc_can_issue_fn_name ifn)
+        [C.Param (C.Ptr C.Void) "arg"] [
+        localvar (C.Ptr $ C.Struct $ rpc_bind_type ifn) rpc_bind_var $
+            Just $ C.Variable "arg",
+        C.Return $ C.Binary C.And
+            (C.Binary C.LessThan (windowvar `C.FieldOf` "outstanding")
+                                 (C.Variable "FLOUNDER_RPC_WINDOW"))
+            (C.CallInd (bindvar `C.DerefField` "can_send") [bindvar])
+    ]
+    where
+        windowvar = C.Variable rpc_bind_var `C.DerefField` "window"
+        bindvar = C.DerefField (C.Variable rpc_bind_var) "b"
+
+-- Moves the binding back to the RPC waitset after asynchronous calls
+rpc_restore_waitset_fn :: String -> C.Unit
+rpc_restore_waitset_fn ifn =
+    C.FunctionDef C.Static (C.TypeName "errval_t") (rpc_restore_waitset_fn_name ifn)
+        [C.Param (C.Ptr $ C.Struct $ rpc_bind_type ifn) rpc_bind_var] [
+        C.If (C.Binary C.Equals (bindvar `C.DerefField` "waitset") waitset_addr)
+            [C.Return $ C.Variable "SYS_ERR_OK"] [],
+        C.SBlank,
+        localvar (C.TypeName "errval_t") errvar_name $ Just $
+            C.CallInd (bindvar `C.DerefField` "change_waitset") [bindvar, waitset_addr],
+        C.If (C.Call "err_is_fail" [errvar])
+            [C.Return $ C.Call "err_push" [errvar, C.Variable "FLOUNDER_ERR_CHANGE_WAITSET"]]
+            [],
+        C.Return $ C.Variable "SYS_ERR_OK"
+    ]
+    where
+        bindvar = C.DerefField (C.Variable rpc_bind_var) "b"
+        waitset_addr = C.AddressOf $ C.DerefField (C.Variable rpc_bind_var) "rpc_waitset"
+
+-- Blocking call, several threads may have calls outstanding. Whoever waits
+-- dispatches the RPC waitset, see flounder_rpc_window_wait.
+rpc_pipelined_fn :: String -> [TypeDef] -> MessageDef -> C.Unit
+rpc_pipelined_fn ifn typedefs msg@(RPC n _ _) =
+    C.FunctionDef C.NoScope (C.TypeName "errval_t") (rpc_pipelined_fn_name ifn n)
+        (rpc_pipelined_fn_params ifn typedefs msg) [
+        localvar (C.TypeName "errval_t") errvar_name Nothing,
+        localvar (C.TypeName "errval_t") "_reply_err" (Just $ C.Variable "SYS_ERR_OK"),
+        localvar (C.Volatile $ C.TypeName "bool") "_done" (Just $ C.Variable "false"),
+        localvar (C.Ptr $ C.Struct "flounder_rpc_slot") slot_var_name Nothing,
+        C.SBlank,
+        C.Ex $ C.Call "assert" [C.Unary C.Not rpc_progress_var],
+        C.Ex $ C.Call "thread_mutex_lock" [mutex],
+        C.SComment "the replies of asynchronous calls arrive on the caller's waitset",
+        C.Ex $ C.Call "assert" [C.Binary C.Equals
+                (C.DerefField rpcvar "window" `C.FieldOf` "async_outstanding")
+                (C.NumConstant 0)],
+        C.Ex $ C.Assignment errvar $ C.Call (rpc_restore_waitset_fn_name ifn) [rpcvar],
+        C.If (C.Call "err_is_fail" [errvar]) [C.Goto "out"] [],
+        C.SBlank,
+        C.SComment "wait for a free slot and the binding to accept a message",
+        C.Ex $ C.Assignment errvar $ C.Call "flounder_rpc_window_wait"
+            [window, waitset_var, C.Variable $ rpc_can_issue_fn_name ifn, rpcvar],
+        C.If (C.Call "err_is_fail" [errvar]) [C.Goto "out"] [],
+        C.SBlank,
+        C.Ex $ C.Assignment slotvar $ C.Call "flounder_rpc_window_alloc" [window],
+        C.Ex $ C.Assignment (C.DerefField slotvar "done") (C.AddressOf $ C.Variable "_done"),
+        C.Ex $ C.Assignment (C.DerefField slotvar "err") (C.AddressOf $ C.Variable "_reply_err"),
+        store_outs msg,
+        C.SBlank,
+        C.SComment "call send function",
+        C.Ex $ C.Assignment errvar $ C.CallInd tx_func (pipelined_tx_args msg),
+        C.If (C.Call "err_is_fail" [errvar])
+            [C.Ex $ C.Call "flounder_rpc_window_free" [window, slotvar],
+             C.Goto "out"] [],
+        C.SBlank,
+        C.SComment "wait for the reply, or for the binding to fail",
+        C.Ex $ C.Assignment errvar $ C.Call "flounder_rpc_window_wait"
+            [window, waitset_var, C.Variable "flounder_rpc_is_done",
+             C.Cast (C.Ptr C.Void) $ C.AddressOf $ C.Variable "_done"],
+        C.If (C.Call "err_is_fail" [errvar])
+            [C.If (C.Unary C.Not $ C.Variable "_done")
+                [C.Ex $ C.Call "flounder_rpc_window_free" [window, slotvar]] [],
+             C.Goto "out"] [],
+        C.Ex $ C.Assignment errvar $ C.Variable "_reply_err",
+        C.SBlank,
+        C.Label "out",
+        C.Ex $ C.Call "thread_mutex_unlock" [mutex],
+        C.Return errvar
+    ]
+    where
+        rpcvar = C.Variable rpc_bind_var
+        rpc_progress_var = C.DerefField rpcvar "rpc_in_progress"
+        waitset_var = C.AddressOf $ C.DerefField rpcvar "rpc_waitset"
+        window = C.AddressOf $ C.DerefField rpcvar "window"
+        mutex = C.AddressOf $ C.DerefField rpcvar "window" `C.FieldOf` "mutex"
+        slotvar = C.Variable slot_var_name
+        tx_func = C.DerefField (C.DerefField rpcvar "b") "tx_vtbl" `C.FieldOf` (rpc_call_name n)
+
+-- Non-blocking call for event-driven callers. The binding is moved to the
+-- caller's waitset _ws, the reply is received and the continuation runs when
+-- the caller dispatches _ws, after the results and *_result were stored.
+-- Returns FLOUNDER_ERR_TX_BUSY if the binding cannot send, the caller can
+-- retry from a send continuation registered on the binding.
+rpc_async_fn :: String -> [TypeDef] -> MessageDef -> C.Unit
+rpc_async_fn ifn typedefs msg@(RPC n _ _) =
+    C.FunctionDef C.NoScope (C.TypeName "errval_t") (rpc_async_fn_name ifn n)
+        (rpc_async_fn_params ifn typedefs msg) [
+        localvar (C.TypeName "errval_t") errvar_name Nothing,
+        localvar (C.Ptr $ C.Struct "flounder_rpc_slot") slot_var_name Nothing,
+        C.SBlank,
+        C.Ex $ C.Call "assert" [C.Unary C.Not rpc_progress_var],
+        C.Ex $ C.Call "thread_mutex_lock" [mutex],
+        C.SComment "no blocking calls, and all asynchronous calls on one waitset",
+        C.Ex $ C.Call "assert" [C.Binary C.Equals
+                (C.DerefField rpcvar "window" `C.FieldOf` "outstanding")
+                (C.DerefField rpcvar "window" `C.FieldOf` "async_outstanding")],
+        C.Ex $ C.Call "assert" [C.Binary C.Or
+                (C.Binary C.Equals
+                    (C.DerefField rpcvar "window" `C.FieldOf` "async_outstanding")
+                    (C.NumConstant 0))
+                (C.Binary C.Equals (bindvar `C.DerefField` "waitset") wsvar)],
+        C.SBlank,
+        C.SComment "receive the reply on the caller's waitset",
+        C.If (C.Binary C.NotEquals (bindvar `C.DerefField` "waitset") wsvar)
+            [C.Ex $ C.Assignment errvar $
+                C.CallInd (bindvar `C.DerefField` "change_waitset") [bindvar, wsvar],
+             C.If (C.Call "err_is_fail" [errvar])
+                [C.Ex $ C.Assignment errvar $
+                    C.Call "err_push" [errvar, C.Variable "FLOUNDER_ERR_CHANGE_WAITSET"],
+                 C.Goto "out"] []] [],
+        C.If (C.Unary C.Not $ C.CallInd (bindvar `C.DerefField` "can_send") [bindvar])
+            [C.Ex $ C.Assignment errvar $ C.Variable "FLOUNDER_ERR_TX_BUSY",
+             C.Goto "out"] [],
+        C.SBlank,
+        C.Ex $ C.Assignment slotvar $ C.Call "flounder_rpc_window_alloc" [window],
+        C.If (C.Binary C.Equals slotvar (C.Variable "NULL"))
+            [C.Ex $ C.Assignment errvar $ C.Variable "FLOUNDER_ERR_RPC_WINDOW_FULL",
+             C.Goto "out"] [],
+        C.Ex $ C.Assignment (C.DerefField slotvar "async") (C.Variable "true"),
+        C.Ex $ C.PostInc (C.DerefField rpcvar "window" `C.FieldOf` "async_outstanding"),
+        C.Ex $ C.Assignment (C.DerefField slotvar "err") (C.Variable "_result"),
+        C.Ex $ C.Assignment (C.DerefField slotvar "cont") (C.Variable "_continuation"),
+        store_outs msg,
+        C.SBlank,
+        C.SComment "call send function",
+        C.Ex $ C.Assignment errvar $ C.CallInd tx_func (pipelined_tx_args msg),
+        C.If (C.Call "err_is_fail" [errvar])
+            [C.Ex $ C.Call "flounder_rpc_window_free" [window, slotvar]] [],
+        C.SBlank,
+        C.Label "out",
+        C.Ex $ C.Call "thread_mutex_unlock" [mutex],
+        C.Return errvar
+    ]
+    where
+        rpcvar = C.Variable rpc_bind_var
+        rpc_progress_var = C.DerefField rpcvar "rpc_in_progress"
+        window = C.AddressOf $ C.DerefField rpcvar "window"
+        mutex = C.AddressOf $ C.DerefField rpcvar "window" `C.FieldOf` "mutex"
+        slotvar = C.Variable slot_var_name
+        bindvar = C.DerefField rpcvar "b"
+        wsvar = C.Variable "_ws"
+        tx_func = C.DerefField (C.DerefField rpcvar "b") "tx_vtbl" `C.FieldOf` (rpc_call_name n)
+
+-- Remember where the results of a pipelined call go
+store_outs :: MessageDef -> C.Stmt
+store_outs msg = C.StmtList
+    [C.Ex $ C.Assignment (slot_out (C.Variable slot_var_name) i) (C.Variable an)
+     | (i, an) <- zip [0..] (out_ptr_names msg)]
+
+-- Arguments of the send function of a pipelined call, the slot tag is the
+-- seq_in argument
+pipelined_tx_args :: MessageDef -> [C.Expr]
+pipelined_tx_args msg =
+    [C.DerefField (C.Variable rpc_bind_var) "b", C.Variable "NOP_CONT",
+     C.DerefField (C.Variable slot_var_name) "tag"]
+    ++ (map C.Variable $ concat $ map mkargs txargs)
+    where
+        mkargs (Arg _ (Name an)) = [an]
+        mkargs (Arg _ (DynamicArray an al)) = [an, al]
+        (txargs, _) = partition_rpc_args $ tail_args msg
+
 rpc_vtbl :: String -> [MessageDef] -> C.Unit
 rpc_vtbl ifn ml =
     C.StructDef C.Static (rpc_vtbl_type ifn) (rpc_vtbl_name ifn) fields
     where
         fields = [let mn = msg_name m in (mn, rpc_fn_name ifn mn) | m <- ml]
 
-rpc_rx_handler_fn :: String -> [TypeDef] -> MessageDef -> C.Unit
-rpc_rx_handler_fn ifn typedefs msg@(RPC mn args _) =
+rpc_rx_handler_fn :: String -> [TypeDef] -> Bool -> MessageDef -> C.Unit
+rpc_rx_handler_fn ifn typedefs pipelined msg@(RPC mn args _) =
     C.FunctionDef C.Static C.Void (rpc_rx_handler_fn_name ifn mn) params [
         C.SComment "get RPC client state pointer",
         localvar (C.Ptr $ C.Struct $ rpc_bind_type ifn) rpc_bind_var $
             Just $ C.DerefField bindvar "st",
         C.SBlank,
+        if pipelined then rpc_rx_pipelined ifn msg else C.StmtList [],
         C.SComment "XXX: stash reply parameters in binding object",
         C.SComment "depending on the interconnect driver, they're probably already there",
         C.StmtList [rx_arg_assignment ifn typedefs mn a | a <- rxargs ],
@@ -244,6 +529,46 @@ rpc_rx_handler_fn ifn typedefs msg@(RPC mn args _) =
         bindvar = C.Variable intf_bind_var
         (_, rxargs) = partition_rpc_args args
 
+-- Completes the pipelined call with the tag of the reply, if there is one
+rpc_rx_pipelined :: String -> MessageDef -> C.Stmt
+rpc_rx_pipelined ifn msg = C.StmtList [
+    C.SComment "reply to a pipelined call?",
+    C.Ex $ C.Call "thread_mutex_lock" [C.AddressOf $ C.FieldOf windowvar "mutex"],
+    localvar (C.Ptr $ C.Struct "flounder_rpc_slot") slot_var_name $
+        Just $ C.Call "flounder_rpc_window_lookup"
+                    [C.AddressOf windowvar, C.Variable "seq_out"],
+    C.If (C.Binary C.NotEquals slotvar (C.Variable "NULL"))
+        [C.StmtList $ concat $ zipWith store [0..] outargs,
+         localvar (C.Struct "event_closure") "_cont" $
+            Just $ C.Call "flounder_rpc_window_complete"
+                    [C.AddressOf windowvar, slotvar, C.Variable "SYS_ERR_OK"],
+         C.Ex $ C.Call "thread_mutex_unlock" [C.AddressOf $ C.FieldOf windowvar "mutex"],
+         C.If (C.Binary C.NotEquals (C.FieldOf (C.Variable "_cont") "handler")
+                                    (C.Variable "NULL"))
+            [C.Ex $ C.CallInd (C.FieldOf (C.Variable "_cont") "handler")
+                        [C.FieldOf (C.Variable "_cont") "arg"]] [],
+         C.ReturnVoid]
+        [],
+    C.Ex $ C.Call "thread_mutex_unlock" [C.AddressOf $ C.FieldOf windowvar "mutex"],
+    C.SBlank]
+    where
+        windowvar = C.Variable rpc_bind_var `C.DerefField` "window"
+        slotvar = C.Variable slot_var_name
+        -- one result pointer per name, see out_ptr_names
+        outargs = expand $ snd $ partition_rpc_args $ tail_args msg
+        expand [] = []
+        expand ((Arg tr (Name an)):rest) = (type_c_type ifn tr, an) : expand rest
+        expand ((Arg tr (DynamicArray an len)):rest) =
+            (C.Ptr $ type_c_type ifn tr, an) : (type_c_type ifn size, len) : expand rest
+        store i (t, an) =
+            [C.Ex $ C.Assignment
+                (C.DerefPtr $ C.Cast (C.Ptr t) $ slot_out slotvar i) (C.Variable an)]
+
+slot_var_name = "_slot" :: String
+
+slot_out :: C.Expr -> Integer -> C.Expr
+slot_out slotvar i = C.SubscriptOf (C.DerefField slotvar "out") (C.NumConstant i)
+
 -- XXX: this mirrors BackendCommon.tx_arg_assignment
 rx_arg_assignment :: String -> [TypeDef] -> String -> MessageArgument -> C.Stmt
 rx_arg_assignment ifn typedefs mn (Arg tr v) = case v of
@@ -265,8 +590,8 @@ arg_names (Arg _ v) = var_names v
         var_names (Name n) = [n]
         var_names (DynamicArray n1 n2) = [n1, n2]
 
-rpc_error_fn :: String -> C.Unit
-rpc_error_fn ifn = C.FunctionDef C.Static C.Void (rpc_error_fn_name ifn)
+rpc_error_fn :: String -> Bool -> C.Unit
+rpc_error_fn ifn has_pipelined = C.FunctionDef C.Static C.Void (rpc_error_fn_name ifn)
     [binding_param ifn, C.Param (C.TypeName "errval_t") errvar_name]
     [C.SComment "get RPC client state pointer",
      localvar (C.Ptr $ C.Struct $ rpc_bind_type ifn) rpc_bind_var $
@@ -279,15 +604,24 @@ rpc_error_fn ifn = C.FunctionDef C.Static C.Void (rpc_error_fn_name ifn)
          C.Ex $ C.Call "flounder_support_register"
                     [waitset_addr, chanstate_addr,
                      C.Variable "dummy_event_closure", C.Variable "true"]]
-        [C.Ex $ C.Call "USER_PANIC_ERR" [errvar, C.StringConstant "async error in RPC"]]
+        (if has_pipelined
+         then [C.If (C.Binary C.GreaterThan
+                        (rpcvar `C.DerefField` "window" `C.FieldOf` "outstanding")
+                        (C.NumConstant 0))
+                [C.SComment "fail the pipelined calls",
+                 C.Ex $ C.Call "flounder_rpc_window_fail"
+                            [C.AddressOf $ rpcvar `C.DerefField` "window", errvar]]
+                [panic]]
+         else [panic])
     ]
     where
         rpcvar = C.Variable rpc_bind_var
         waitset_addr = C.AddressOf $ C.DerefField rpcvar "rpc_waitset"
         chanstate_addr = C.AddressOf $ C.DerefField rpcvar "dummy_chanstate"
+        panic = C.Ex $ C.Call "USER_PANIC_ERR" [errvar, C.StringConstant "async error in RPC"]
 
-rpc_init_fn :: String -> [MessageDef] -> C.Unit
-rpc_init_fn ifn ml = C.FunctionDef C.NoScope (C.TypeName "errval_t")
+rpc_init_fn :: String -> [MessageDef] -> Bool -> C.Unit
+rpc_init_fn ifn ml has_pipelined = C.FunctionDef C.NoScope (C.TypeName "errval_t")
                             (rpc_init_fn_name ifn) (rpc_init_fn_params ifn) $
     [localvar (C.TypeName "errval_t") errvar_name Nothing,
      C.SBlank,
@@ -299,6 +633,10 @@ rpc_init_fn ifn ml = C.FunctionDef C.NoScope (C.TypeName "errval_t")
      C.Ex $ C.Call "waitset_init" [waitset_addr],
      C.Ex $ C.Call "flounder_support_waitset_chanstate_init"
                         [C.AddressOf $ C.DerefField rpcvar "dummy_chanstate"],
+     if has_pipelined
+        then C.Ex $ C.Call "flounder_rpc_window_init"
+                        [C.AddressOf $ C.DerefField rpcvar "window"]
+        else C.StmtList [],
      C.Ex $ C.Assignment (C.DerefField rpcvar "vtbl") (C.Variable $ rpc_vtbl_name ifn),
      C.Ex $ C.Assignment (C.DerefField bindvar "st") rpcvar,
      C.SBlank,
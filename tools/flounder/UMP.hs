@@ -3,7 +3,7 @@
 
   Part of Flounder: a message passing IDL for Barrelfish
 
-  Copyright (c) 2007-2010, ETH Zurich.
+  Copyright (c) 2007-2010, 2016, ETH Zurich.
   All rights reserved.
 
   This file is distributed under the terms in the attached LICENSE file.
@@ -90,7 +90,7 @@ init_fn p ifn =
         C.SBlank,
 
         C.Ex $ C.Assignment (common_field "change_waitset") (C.Variable $ change_waitset_fn_name p ifn),
-        C.Ex $ C.Assignment (common_field "control") (C.Variable $ generic_control_fn_name (ump_drv p) ifn),
+        C.Ex $ C.Assignment (common_field "control") (C.Variable $ control_fn_name p ifn),
 
         C.StmtList $ register_recv p ifn,
         C.SBlank,
@@ -3,7 +3,7 @@
 
   Part of Flounder: a message passing IDL for Barrelfish
 
-  Copyright (c) 2007-2010, ETH Zurich.
+  Copyright (c) 2007-2010, 2016, ETH Zurich.
   All rights reserved.
 
   This file is distributed under the terms in the attached LICENSE file.
@@ -126,6 +126,14 @@ cap_rx_handler_name p ifn = ump_ifscope p ifn "cap_rx_handler"
 -- Names of the control functions
 change_waitset_fn_name p ifn = ump_ifscope p ifn "change_waitset"
 
+-- Name of the control function, the generic one if there are no notifications
+control_fn_name p ifn
+    | null (ump_notify p) = generic_control_fn_name (ump_drv p) ifn
+    | otherwise = ump_ifscope p ifn "control"
+
+-- Name of the function sending notifications held back by batching
+batch_flush_fn_name p ifn = ump_ifscope p ifn "batch_flush"
+
 -- Name of the continuation that runs when we get the monitor mutex
 monitor_mutex_cont_name p ifn = ump_ifscope p ifn "monitor_mutex_cont"
 
@@ -280,6 +288,9 @@ stub_body p infile intf@(Interface ifn descr decls) = C.UnitList [
       C.Include C.Standard ("if/" ++ ifn ++ "_defs.h"),
       C.Blank,
 
+      C.UnitList $ if null (ump_notify p) then []
+                   else [batch_flush_fn_proto p ifn, C.Blank],
+
       C.MultiComment [ "Send handler function" ],
       tx_handler p ifn msg_specs,
       C.UnitList $ if (drvname == "ump") then [ tx_bind_msg p ifn ] else [],
@@ -318,7 +329,9 @@ stub_body p infile intf@(Interface ifn descr decls) = C.UnitList [
       register_send_fn_def drvname ifn,
       default_error_handler_fn_def drvname ifn,
       change_waitset_fn_def p ifn,
-      generic_control_fn_def drvname ifn,
+      C.UnitList $ if null (ump_notify p)
+                   then [generic_control_fn_def drvname ifn]
+                   else [batch_flush_fn_def p ifn, control_fn_def p ifn],
       C.Blank,
 
       C.MultiComment [ "Function to destroy the binding state" ],
@@ -361,6 +374,8 @@ destroy_fn :: UMPParams -> String -> C.Unit
 destroy_fn p ifn =
     C.FunctionDef C.NoScope C.Void (destroy_fn_name p ifn) params
         [C.StmtList common_destroy,
+         C.Ex $ C.Call "flounder_stub_ump_batch_destroy"
+            [C.AddressOf $ statevar `C.FieldOf` "batch"],
          C.Ex $ C.Call "ump_chan_destroy"
             [C.AddressOf $ statevar `C.FieldOf` "chan"]]
     where
@@ -387,7 +402,7 @@ connect_fn p ifn =
       C.StmtList common_init,
       C.Ex $ C.Call "flounder_stub_ump_state_init" [C.AddressOf statevar, my_bindvar],
       C.Ex $ C.Assignment (common_field "change_waitset") (C.Variable $ change_waitset_fn_name p ifn),
-      C.Ex $ C.Assignment (common_field "control") (C.Variable $ generic_control_fn_name (ump_drv p) ifn),
+      C.Ex $ C.Assignment (common_field "control") (C.Variable $ control_fn_name p ifn),
       C.Ex $ C.Assignment (common_field "st") (C.Variable "st"),
       C.Ex $ C.Assignment (intf_bind_v `C.FieldOf` "bind_cont") (C.Variable intf_cont_var),
 
@@ -465,7 +480,7 @@ accept_fn p ifn =
 
       C.Ex $ C.Assignment (sendvar) (C.DerefField (C.Variable "_frameinfo") "sendbase"),
       C.Ex $ C.Assignment (common_field "change_waitset") (C.Variable $ change_waitset_fn_name p ifn),
-      C.Ex $ C.Assignment (common_field "control") (C.Variable $ generic_control_fn_name (ump_drv p) ifn),
+      C.Ex $ C.Assignment (common_field "control") (C.Variable $ control_fn_name p ifn),
       C.Ex $ C.Assignment (common_field "st") (C.Variable "st"),
       C.Ex $ C.Assignment (common_field "bind_cont") (C.Variable intf_cont_var),
       C.Ex $ C.Assignment (my_bindvar `C.DerefField` "inchanlen") (C.DerefField (C.Variable intf_frameinfo_var) "inbufsize"),
@@ -500,7 +515,7 @@ bind_fn p ifn =
         C.StmtList common_init,
         C.Ex $ C.Call "flounder_stub_ump_state_init" [C.AddressOf statevar, my_bindvar],
         C.Ex $ C.Assignment (common_field "change_waitset") (C.Variable $ change_waitset_fn_name p ifn),
-        C.Ex $ C.Assignment (common_field "control") (C.Variable $ generic_control_fn_name (ump_drv p) ifn),
+        C.Ex $ C.Assignment (common_field "control") (C.Variable $ control_fn_name p ifn),
         C.Ex $ C.Assignment (common_field "st") (C.Variable "st"),
         C.Ex $ C.Assignment (intf_bind_var `C.FieldOf` "bind_cont") (C.Variable intf_cont_var),
         C.Ex $ C.Assignment (my_bindvar `C.DerefField` "iref") (C.Variable "iref"),
@@ -648,7 +663,7 @@ connect_handler_fn p ifn = C.FunctionDef C.NoScope (C.TypeName "errval_t")
     C.StmtList common_init,
     C.Ex $ C.Call "flounder_stub_ump_state_init" [C.AddressOf statevar, my_bindvar],
     C.Ex $ C.Assignment (common_field "change_waitset") (C.Variable $ change_waitset_fn_name p ifn),
-    C.Ex $ C.Assignment (common_field "control") (C.Variable $ generic_control_fn_name (ump_drv p) ifn),
+    C.Ex $ C.Assignment (common_field "control") (C.Variable $ control_fn_name p ifn),
       C.Ex $ C.Assignment (my_bindvar `C.DerefField` "no_cap_transfer") (C.Variable "0"),
     C.StmtList $ (ump_connect_extra_fields_init p),
     C.SBlank,
@@ -731,6 +746,7 @@ change_waitset_fn_def p ifn =
             (bindvar `C.DerefField` "waitset")
             (C.Variable "ws"),
         C.SBlank,
+        C.StmtList $ ump_batch_change_waitset p ifn,
 
         C.SComment "re-register for receive (if previously registered)",
         C.StmtList $ ump_deregister_recv p ifn,
@@ -756,6 +772,77 @@ change_waitset_fn_def p ifn =
         params = [C.Param (C.Ptr $ C.Struct $ intf_bind_type ifn) intf_bind_var,
                   C.Param (C.Ptr $ C.Struct "waitset") "ws"]
 
+-- move the deadline of held back notifications to the new waitset, or send
+-- them now if that fails
+ump_batch_change_waitset :: UMPParams -> String -> [C.Stmt]
+ump_batch_change_waitset p ifn
+    | null (ump_notify p) = []
+    | otherwise =
+        [C.SComment "move the batch deadline to the new waitset",
+         C.If (C.Call "flounder_stub_ump_batch_change_waitset"
+                [batchaddr,
+                 C.Variable "ws",
+                 C.StructConstant "event_closure"
+                    [("handler", C.Variable $ batch_flush_fn_name p ifn),
+                     ("arg", bindvar)]])
+            [C.Ex $ C.Call (batch_flush_fn_name p ifn) [bindvar]] [],
+         C.SBlank]
+    where
+        batchaddr = C.AddressOf $ my_bindvar `C.DerefField` "ump_state" `C.FieldOf` "batch"
+
+-- send a notification now, this covers all messages held back by batching
+ump_notify_now :: UMPParams -> [C.Stmt]
+ump_notify_now p
+    | null (ump_notify p) = []
+    | otherwise = (C.Ex $ C.Call "flounder_stub_ump_batch_flushed" [batchaddr])
+                  : ump_notify p
+    where
+        batchaddr = C.AddressOf $ my_bindvar `C.DerefField` "ump_state" `C.FieldOf` "batch"
+
+-- notify a complete message, unless batching holds the notification back
+ump_notify_msg :: UMPParams -> String -> [C.Stmt]
+ump_notify_msg p ifn
+    | null (ump_notify p) = []
+    | otherwise =
+        [C.If (C.Unary C.Not $ C.Call "flounder_stub_ump_batch_defer"
+                [batchaddr,
+                 bindvar `C.DerefField` "waitset",
+                 C.StructConstant "event_closure"
+                    [("handler", C.Variable $ batch_flush_fn_name p ifn),
+                     ("arg", bindvar)]])
+            (ump_notify_now p) []]
+    where
+        batchaddr = C.AddressOf $ my_bindvar `C.DerefField` "ump_state" `C.FieldOf` "batch"
+
+batch_flush_fn_proto :: UMPParams -> String -> C.Unit
+batch_flush_fn_proto p ifn = C.GVarDecl C.Static C.NonConst
+    (C.Function C.NoScope C.Void [C.Param (C.Ptr C.Void) "arg"])
+    (batch_flush_fn_name p ifn) Nothing
+
+batch_flush_fn_def :: UMPParams -> String -> C.Unit
+batch_flush_fn_def p ifn =
+    C.FunctionDef C.Static C.Void (batch_flush_fn_name p ifn) [C.Param (C.Ptr C.Void) "arg"] [
+        handler_preamble p ifn,
+        C.StmtList $ ump_notify_now p
+    ]
+
+control_fn_def :: UMPParams -> String -> C.Unit
+control_fn_def p ifn =
+    C.FunctionDef C.Static (C.TypeName "errval_t") (control_fn_name p ifn) params [
+        localvar (C.Ptr $ C.Struct $ my_bind_type p ifn)
+            my_bind_var_name (Just $ C.Cast (C.Ptr C.Void) bindvar),
+        C.SBlank,
+
+        C.If (C.Call "flounder_stub_ump_batch_control"
+                [C.AddressOf $ my_bindvar `C.DerefField` "ump_state" `C.FieldOf` "batch",
+                 C.Variable "control"])
+            [C.Ex $ C.Call (batch_flush_fn_name p ifn) [bindvar]] [],
+        C.Return $ C.Variable "SYS_ERR_OK"
+    ]
+    where
+        params = [C.Param (C.Ptr $ C.Struct $ intf_bind_type ifn) intf_bind_var,
+                  C.Param (C.TypeName "idc_control_t") "control"]
+
 handler_preamble :: UMPParams -> String -> C.Stmt
 handler_preamble p ifn = C.StmtList
     [C.SComment "Get the binding state from our argument pointer",
@@ -938,7 +1025,7 @@ tx_handler p ifn msgs =
 
         C.SComment "Send a notification if necessary",
         C.If (C.Variable "tx_notify")
-            (ump_notify p) []
+            (ump_notify_now p) []
     ]
     where
         inc_fragnum = C.Ex $ C.PostInc $ C.DerefField bindvar "tx_msg_fragment"
@@ -983,7 +1070,7 @@ tx_handler p ifn msgs =
             gen_epilog i
                 | i + 1 == length msgfrags =
                 [-- send a notification, now we've done a complete message
-                 C.StmtList $ ump_notify p,
+                 C.StmtList $ ump_notify_msg p ifn,
                  inc_fragnum,
                  -- if the last fragment succeeds, and we've sent all the caps, we're done
                 -- otherwise we'll need to wait to finish sending the caps
@@ -1074,8 +1161,7 @@ tx_fn p ifn typedefs msg@(Message _ n args _) (MsgSpec _ _ caps) =
         cont_param = C.Param (C.Struct "event_closure") intf_cont_var
         body = [
             C.SComment "check that we can accept an outgoing message",
-            C.If (C.Binary C.NotEquals tx_msgnum_field (C.NumConstant 0))
-                [C.Return $ C.Variable "FLOUNDER_ERR_TX_BUSY"] [],
+            tx_busy_check ifn n,
             C.SBlank,
             C.SComment "register send continuation",
             C.StmtList $ register_txcont (C.Variable intf_cont_var),
@@ -1159,7 +1245,7 @@ rx_handler p ifn typedefs msgdefs msgs =
               C.SComment "otherwise send a forced ack if the channel is now full",
               C.If (C.Call "flounder_stub_ump_needs_ack" [stateaddr])
                    [C.Ex $ C.Call "flounder_stub_ump_send_ack" [stateaddr],
-                    C.StmtList $ ump_notify p]
+                    C.StmtList $ ump_notify_now p]
                    []
              ]
         ]
@@ -1246,7 +1332,7 @@ rx_handler p ifn typedefs msgdefs msgs =
                   C.If tx_is_busy
                        [run_tx]
                        [C.Ex $ C.Call "flounder_stub_ump_send_ack" [stateaddr],
-                        C.StmtList $ ump_notify p]
+                        C.StmtList $ ump_notify_now p]
                  ] []
             ]
 
@@ -3,7 +3,7 @@
 
   Part of Flounder: a message passing IDL for Barrelfish
 
-  Copyright (c) 2007-2010, ETH Zurich.
+  Copyright (c) 2007-2010, 2016, ETH Zurich.
   All rights reserved.
 
   This file is distributed under the terms in the attached LICENSE file.
@@ -274,7 +274,7 @@ init_fn ifn =
         C.SBlank,
 
         C.Ex $ C.Assignment (common_field "change_waitset") (C.Variable $ change_waitset_fn_name uparams ifn),
-        C.Ex $ C.Assignment (common_field "control") (C.Variable $ generic_control_fn_name (ump_drv uparams) ifn),
+        C.Ex $ C.Assignment (common_field "control") (C.Variable $ control_fn_name uparams ifn),
 
         C.StmtList $ register_recv uparams ifn,
         C.SBlank,
@@ -19,7 +19,7 @@
 #include <vfs/vfs.h>
 
 #include "bcached.h"
-#include <hashtable/hashtable.h>
+#include <collections/hash_map.h>
 
 struct waitlist {
     struct waitlist *next;
@@ -42,7 +42,7 @@ struct lru_queue {
 struct capref cache_memory;
 size_t cache_size, block_size = BUFFER_CACHE_BLOCK_SIZE;
 void *cache_pool;
-static struct hashtable *cache_hash = NULL;
+static collections_hash_map *cache_hash = NULL;
 static struct lru_queue *lru_start, *lru_end, *lru;
 static size_t partial_hits = 0, hits = 0, misses = 0, allocations = 0, evictions = 0;
 
@@ -124,16 +124,13 @@ uint64_t cache_get_block_length(uintptr_t idx)
 key_state_t cache_lookup(char *key, size_t key_len,
                          uintptr_t *idx, uintptr_t *length)
 {
-    ENTRY_TYPE et;
     void *val;
     key_state_t ret = KEY_MISSING;
 
-    et = cache_hash->d.get(&cache_hash->d, key, key_len, &val);
-
-    if (et == 0)  {
+    if (!collections_hash_map_lookup_bytes(cache_hash, key, key_len, &val)) {
         misses++;
         ret = KEY_MISSING;
-    } else if (et == TYPE_WORD) {
+    } else {
         *idx = (uintptr_t)val;
         struct lru_queue *l = lru_use(*idx);
         *length = l->block_length;
@@ -145,15 +142,13 @@ key_state_t cache_lookup(char *key, size_t key_len,
             hits++;
             ret = KEY_EXISTS;
         }
-    } else {
-        assert(et == TYPE_WORD || et == 0);
     }
 
-    // Convert to byte offset from start of cache (XXX does this make sense when et == 0?)
+    // Convert to byte offset from start of cache (XXX does this make sense on a miss?)
     *idx *= BUFFER_CACHE_BLOCK_SIZE;
 
     /* printf("cache_lookup(\"%s\", %" PRIuPTR ") = %s\n", key, *idx, */
-    /*        et == TYPE_WORD ? "true" : "false"); */
+    /*        ret != KEY_MISSING ? "true" : "false"); */
     return ret;
 }
 
@@ -209,8 +204,9 @@ uintptr_t cache_allocate(char *key, size_t key_len)
 
     if(e->in_use) {
         // Cache is write-through, so we just have to delete the old entry
-        int r = cache_hash->d.remove(&cache_hash->d, e->key, e->key_len);
-        assert(r == 0);
+        assert(collections_hash_map_lookup_bytes(cache_hash, e->key,
+                                                 e->key_len, NULL));
+        collections_hash_map_delete_bytes(cache_hash, e->key, e->key_len);
         free(e->key);
 
 #ifdef WITH_WRITE_BACK_CACHE
@@ -229,7 +225,8 @@ uintptr_t cache_allocate(char *key, size_t key_len)
     e->block_length = 0;
     e->waiters.start = e->waiters.end = NULL;
 
-    int r = cache_hash->d.put_word(&cache_hash->d, key, key_len, e->index);
+    int r = collections_hash_map_insert_bytes(cache_hash, key, key_len,
+                                              (void *)e->index);
     assert(r == 0);
 
     // Convert to byte offset from start of cache
@@ -300,7 +297,8 @@ int main(int argc, char *argv[])
         USER_PANIC_ERR(err, "create_cache_mem");
     }
 
-    cache_hash = create_hashtable2(2 * NUM_BLOCKS, 75);
+    collections_hash_map_create(&cache_hash, COLLECTIONS_HASH_MAP_KEY_BYTES,
+                                NUM_BLOCKS, NULL, NULL);
     assert(cache_hash != NULL);
 
     lru_init();
@@ -15,7 +15,6 @@
 #include "bcached.h"
 
 #include <string.h>
-#include <hashtable/hashtable.h>
 
 #define SERVICE_BASENAME        "bcache"
 
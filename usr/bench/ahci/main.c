@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, 2011, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -21,9 +21,16 @@
 #include <trace/trace.h>
 #include <vfs/vfs.h>
 #include <vfs/vfs_path.h>
+#include <ahci/ahci.h>
+#include <ahci/ahci_dma_pool.h>
+#include <ahci/ahci_util.h>
+#include <dev/ata_identify_dev.h>
 
 #define ENTRIES(array)  (sizeof(array) / sizeof(array[0]))
 
+// Highest queue depth queuebench tries, the NCQ limit
+#define AHCI_BENCH_MAX_DEPTH 32
+
 static const char *cwd = "/";
 
 static int mount(const char *path, const char *uri)
@@ -866,6 +873,184 @@ out:
     return ret;
 }
 
+struct queue_bench {
+    struct ahci_binding *binding;
+    struct ahci_dma_region *bufs[AHCI_BENCH_MAX_DEPTH];
+    size_t idle[AHCI_BENCH_MAX_DEPTH];
+    size_t idle_count;
+    size_t completed;
+    errval_t status;
+    bool bound;
+};
+
+static void queue_bench_bind_cb(void *st, errval_t err,
+                                struct ahci_binding *binding)
+{
+    struct queue_bench *qb = st;
+
+    qb->status = err;
+    qb->binding = binding;
+    qb->bound = true;
+}
+
+static void queue_bench_done_cb(struct ahci_binding *binding, void *arg,
+                                errval_t err)
+{
+    struct queue_bench *qb = binding->st;
+
+    if (err_is_fail(err) && err_is_ok(qb->status)) {
+        qb->status = err;
+    }
+    qb->idle[qb->idle_count++] = (uintptr_t)arg;
+    qb->completed++;
+}
+
+/**
+ * \brief Reads count blocks with depth requests in flight.
+ *
+ * \returns The throughput in KB/s, or a negative value on error.
+ */
+static double queue_bench_run(struct queue_bench *qb, bool random,
+                              size_t blocksize, size_t count, size_t depth,
+                              uint64_t tscperms)
+{
+    size_t blocks = ata_identify_tnuas48_rd(&qb->binding->identify)
+                    / (blocksize / BLOCK_SIZE);
+    size_t issued = 0;
+    errval_t err;
+
+    qb->idle_count = 0;
+    for (size_t i = 0; i < depth; i++) {
+        qb->idle[qb->idle_count++] = i;
+    }
+    qb->completed = 0;
+    qb->status = SYS_ERR_OK;
+    srand(9147);
+
+    uint64_t start = rdtsc();
+    while (qb->completed < count) {
+        while (qb->idle_count > 0 && issued < count) {
+            size_t block = random ? (size_t)rand() % blocks : issued % blocks;
+            size_t i = qb->idle[--qb->idle_count];
+
+            err = ahci_queue_rw(qb->binding, false,
+                                (uint64_t)block * (blocksize / BLOCK_SIZE),
+                                qb->bufs[i], blocksize, queue_bench_done_cb,
+                                (void *)(uintptr_t)i);
+            if (err_is_fail(err)) {
+                DEBUG_ERR(err, "ahci_queue_rw");
+                return -1;
+            }
+            issued++;
+        }
+
+        err = event_dispatch(get_default_waitset());
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "event_dispatch");
+            return -1;
+        }
+    }
+    uint64_t stop = rdtsc();
+
+    if (err_is_fail(qb->status)) {
+        DEBUG_ERR(qb->status, "read request");
+        return -1;
+    }
+
+    uint64_t elapsed_msecs = (stop - start) / tscperms;
+    if (elapsed_msecs == 0) {
+        elapsed_msecs = 1;
+    }
+    return (double)(count * blocksize) / 1024 * 1000 / elapsed_msecs;
+}
+
+/**
+ * \brief Sequential and random reads at different queue depths, like fio.
+ *
+ * Talks to the port through ahci_queue_rw() and bypasses the VFS. Only reads,
+ * the contents of the disk are not touched.
+ */
+static int
+ahci_queuebench(int argc, char *argv[])
+{
+    if (argc != 4) {
+        printf("usage: %s <port> <blocksize> <count>\n"
+               "blocksize must be a multiple of %d\n", argv[0], BLOCK_SIZE);
+        return 1;
+    }
+
+    uint8_t port = atoi(argv[1]);
+    size_t blocksize = atoi(argv[2]);
+    size_t count = atoi(argv[3]);
+    if (blocksize == 0 || blocksize % BLOCK_SIZE != 0 || count == 0) {
+        printf("invalid blocksize or count\n");
+        return 1;
+    }
+
+    struct queue_bench qb;
+    memset(&qb, 0, sizeof(qb));
+
+    errval_t err = ahci_init(port, queue_bench_bind_cb, &qb,
+                             get_default_waitset());
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "ahci_init");
+        return 1;
+    }
+    while (!qb.bound) {
+        event_dispatch(get_default_waitset());
+    }
+    if (err_is_fail(qb.status)) {
+        DEBUG_ERR(qb.status, "ahci_init");
+        return 1;
+    }
+    qb.binding->st = &qb;
+
+    size_t max_depth = ahci_queue_depth(qb.binding);
+    if (max_depth > AHCI_BENCH_MAX_DEPTH) {
+        max_depth = AHCI_BENCH_MAX_DEPTH;
+    }
+
+    int ret = 0;
+    for (size_t i = 0; i < max_depth; i++) {
+        err = ahci_dma_region_alloc(blocksize, &qb.bufs[i]);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "ahci_dma_region_alloc");
+            ret = 1;
+            goto out;
+        }
+    }
+
+    uint64_t tscperms;
+    err = sys_debug_get_tsc_per_ms(&tscperms);
+    assert(err_is_ok(err));
+
+    printf("NCQ %s, max queue depth %zu, blocksize %zu\n",
+           ahci_ncq_supported(qb.binding) ? "on" : "off", max_depth, blocksize);
+    printf("qd\tseq KB/s\trand KB/s\trand IOPS\n");
+    for (size_t depth = 1; depth <= max_depth; depth *= 2) {
+        double seq = queue_bench_run(&qb, false, blocksize, count, depth,
+                                     tscperms);
+        double rnd = queue_bench_run(&qb, true, blocksize, count, depth,
+                                     tscperms);
+        if (seq < 0 || rnd < 0) {
+            ret = 1;
+            break;
+        }
+        printf("%zu\t%.3lf\t%.3lf\t%.0lf\n", depth, seq, rnd,
+               rnd * 1024 / blocksize);
+    }
+
+out:
+    for (size_t i = 0; i < max_depth; i++) {
+        if (qb.bufs[i] != NULL) {
+            ahci_dma_region_free(qb.bufs[i]);
+        }
+    }
+    ahci_close(qb.binding, NOP_CONT);
+
+    return ret;
+}
+
 typedef int (*Command)(int argc, char *argv[]);
 struct cmd {
     const char  *name;
@@ -880,6 +1065,7 @@ static struct cmd commands[] = {
     { "randbench_time", ahci_randbench_time, "benchmark ahci random (response time)" },
     { "read_write", ahci_read_write, "read from block device and write back" },
     { "shuffle_file", shuffle_file, "Shuffle a file around" },
+    { "queuebench", ahci_queuebench, "sequential and random reads at different queue depths" },
 };
 
 #define NUM_COMMANDS (sizeof(commands)/sizeof(commands[0]))
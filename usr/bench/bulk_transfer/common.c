@@ -212,16 +212,20 @@ static void net_transparent_connect(char *str, struct bulk_channel *channel,
             MK_BULK_CONT(bind_done_cb, done)));
 }
 
-// sml:name
+// sml:name, rml:name
 static void sm_listen(char *str, struct bulk_channel *channel,
         struct bulk_channel_callbacks *cb, struct waitset *ws,
         enum bulk_channel_direction dir,  size_t bufsz, size_t metasz,
-        bool *done)
+        bool *done, bool ring)
 {
     char *name = str;
 
     struct bulk_sm_endpoint_descriptor *epd = malloc(sizeof(*epd));
-    expect_success(bulk_sm_ep_create(epd));
+    if (ring) {
+        expect_success(bulk_sm_ring_ep_create(epd));
+    } else {
+        expect_success(bulk_sm_ep_create(epd));
+    }
     struct bulk_channel_setup setup = {
         .direction = dir,
         .role = (dir == BULK_DIRECTION_TX ? BULK_ROLE_MASTER : BULK_ROLE_SLAVE),
@@ -235,11 +239,11 @@ static void sm_listen(char *str, struct bulk_channel *channel,
     expect_success(nameservice_register(name, epd->iref));
 }
 
-// smc:name
+// smc:name, rmc:name
 static void sm_connect(char *str, struct bulk_channel *channel,
         struct bulk_channel_callbacks *cb, struct waitset *ws,
         enum bulk_channel_direction dir,  size_t bufsz, size_t metasz,
-        bool *done)
+        bool *done, bool ring)
 {
     char *name = str;
 
@@ -247,7 +251,11 @@ static void sm_connect(char *str, struct bulk_channel *channel,
     iref_t iref;
 
     expect_success(nameservice_blocking_lookup(name, &iref));
-    expect_success(bulk_sm_ep_create_remote(epd, iref));
+    if (ring) {
+        expect_success(bulk_sm_ring_ep_create_remote(epd, iref));
+    } else {
+        expect_success(bulk_sm_ep_create_remote(epd, iref));
+    }
 
     struct bulk_channel_bind_params setup = {
         .role = (dir == BULK_DIRECTION_TX ? BULK_ROLE_MASTER : BULK_ROLE_SLAVE),
@@ -287,9 +295,13 @@ void initialize_channel(const char *str, struct bulk_channel *channel,
         net_transparent_connect(s + 4, channel, cb, ws, dir, bufsz, metasz,
                 done, true);
     } else if (has_prefix(s, "sml:")) {
-        sm_listen(s + 4, channel, cb, ws, dir, bufsz, metasz, done);
+        sm_listen(s + 4, channel, cb, ws, dir, bufsz, metasz, done, false);
     } else if (has_prefix(s, "smc:")) {
-        sm_connect(s + 4, channel, cb, ws, dir, bufsz, metasz, done);
+        sm_connect(s + 4, channel, cb, ws, dir, bufsz, metasz, done, false);
+    } else if (has_prefix(s, "rml:")) {
+        sm_listen(s + 4, channel, cb, ws, dir, bufsz, metasz, done, true);
+    } else if (has_prefix(s, "rmc:")) {
+        sm_connect(s + 4, channel, cb, ws, dir, bufsz, metasz, done, true);
     } else {
         USER_PANIC("Invalid channel description prefix");
     }
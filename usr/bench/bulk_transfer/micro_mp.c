@@ -0,0 +1,246 @@
+/**
+ * \file
+ * \brief Multi-producer bulk transfer benchmark
+ *
+ * The sender runs one producer thread per core, which all allocate buffers
+ * from the same pool and move them over the same channel. The receiver
+ * passes every buffer straight back. Reports the cycles per move, so that
+ * the shared memory backend (sml/smc) can be compared with its descriptor
+ * ring variant (rml/rmc):
+ *
+ *   bulkbench_micro_mp rx <channel>
+ *   bulkbench_micro_mp tx <channel> [cores=N] [moves=N]
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <bench/bench.h>
+#include <bulk_transfer/bulk_sm.h>
+
+#include "common.h"
+
+#define BUFSZ 0x1000
+#define NUMBUFS 512
+#define DEFAULT_MOVES 100000
+#define MAX_CORES 32
+
+static void panic_handler(void *arg, errval_t err, struct bulk_channel *chan)
+{
+    expect_success(err);
+}
+
+static volatile uint8_t wait_flag = 0;
+
+static void wait_handler(void *arg, errval_t err, struct bulk_channel *chan)
+{
+    expect_success(err);
+    wait_flag = 1;
+}
+
+static struct bulk_continuation panic_cont = {
+    .handler = panic_handler,
+    .arg = NULL, };
+
+static struct bulk_continuation wait_cont = {
+    .handler = wait_handler,
+    .arg = NULL, };
+
+static struct bulk_channel chan;
+static struct bulk_allocator txalloc;
+
+static size_t moves_per_thread;
+static volatile size_t nstarted;
+static volatile bool go;
+static volatile size_t returned;
+
+/* ------------------------------ receiver -------------------------------- */
+
+static errval_t cb_pool_assigned(struct bulk_channel *channel,
+                                 struct bulk_pool *pool)
+{
+    return SYS_ERR_OK;
+}
+
+static void cb_move_received(struct bulk_channel *channel,
+                             struct bulk_buffer *buffer,
+                             void *meta)
+{
+    expect_success(bulk_channel_pass(channel, buffer, NULL, panic_cont));
+}
+
+/* ------------------------------- sender --------------------------------- */
+
+static void cb_buffer_received(struct bulk_channel *channel,
+                               struct bulk_buffer *buffer,
+                               void *meta)
+{
+    expect_success(bulk_alloc_return_buffer(&txalloc, buffer));
+    __atomic_fetch_add(&returned, 1, __ATOMIC_RELAXED);
+}
+
+static int producer(void *arg)
+{
+    uint32_t id = (uint32_t)(uintptr_t)arg;
+
+    __atomic_fetch_add(&nstarted, 1, __ATOMIC_SEQ_CST);
+    while (!go) {
+    }
+
+    for (size_t i = 0; i < moves_per_thread; i++) {
+        struct bulk_buffer *buf;
+        while ((buf = bulk_alloc_new_buffer(&txalloc)) == NULL) {
+            thread_yield();
+        }
+        *((uint32_t *) buf->address) = id;
+        expect_success(bulk_channel_move(&chan, buf, NULL, panic_cont));
+    }
+
+    return 0;
+}
+
+static void run(coreid_t ncores, size_t moves)
+{
+    struct thread *threads[MAX_CORES];
+    coreid_t my_core = disp_get_core_id();
+    errval_t err;
+
+    moves_per_thread = moves / ncores;
+    nstarted = 0;
+    returned = 0;
+    go = false;
+
+    for (coreid_t i = 0; i < ncores; i++) {
+        err = domain_thread_create_on(my_core + i, producer,
+                                      (void *)(uintptr_t)i, &threads[i]);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "domain_thread_create_on");
+        }
+    }
+    while (nstarted < ncores) {
+        thread_yield();
+    }
+
+    size_t total = moves_per_thread * ncores;
+    cycles_t start = bench_tsc();
+    go = true;
+
+    // this thread handles the returned buffers and the channel's messages
+    while (returned < total) {
+        event_dispatch_non_block(chan.waitset);
+        thread_yield();
+    }
+    cycles_t cycles = bench_tsc() - start;
+
+    for (coreid_t i = 0; i < ncores; i++) {
+        err = domain_thread_join(threads[i], NULL);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "domain_thread_join");
+        }
+    }
+
+    printf("%6u %10zu %12" PRIu64 "\n", ncores, total, cycles / total);
+}
+
+static void sender(coreid_t ncores, size_t moves)
+{
+    errval_t err;
+
+    struct bulk_pool_constraints pool_constraints = {
+        .range_min = 0,
+        .range_max = 0,
+        .alignment = 0,
+        .trust = chan.trust, };
+    expect_success(bulk_alloc_init(&txalloc, NUMBUFS, BUFSZ, &pool_constraints));
+
+    wait_flag = 0;
+    expect_success(bulk_channel_assign_pool(&chan, txalloc.pool, wait_cont));
+    while (!wait_flag) {
+        event_dispatch(chan.waitset);
+    }
+
+    coreid_t my_core = disp_get_core_id();
+    for (coreid_t i = 1; i < ncores; i++) {
+        err = domain_new_dispatcher(my_core + i, NULL, NULL);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "domain_new_dispatcher");
+        }
+    }
+
+    printf("%6s %10s %12s\n", "cores", "moves", "cycles/move");
+    for (coreid_t n = 1; n <= ncores; n *= 2) {
+        run(n, moves);
+    }
+
+    struct bulk_sm_ring_stats stats;
+    if (err_is_ok(bulk_sm_ring_get_stats(&chan, &stats))) {
+        printf("ring: %" PRIu64 " descriptors, %" PRIu64 " fallbacks, %"
+               PRIu64 " notifies\n", stats.enqueued, stats.fallbacks,
+               stats.notifies);
+    }
+    printf("Benchmark Finished!\n");
+}
+
+static struct bulk_channel_callbacks cb = {
+    .bind_received = cb_bind_received,
+    .pool_assigned = cb_pool_assigned,
+    .move_received = cb_move_received,
+    .buffer_received = cb_buffer_received, };
+
+int main(int argc, char *argv[])
+{
+    bool done = false;
+    coreid_t ncores = 1;
+    size_t moves = DEFAULT_MOVES;
+    struct waitset *ws = get_default_waitset();
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s rx|tx <channel> [cores=N] [moves=N]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    bool is_tx = !strcmp(argv[1], "tx");
+
+    for (int i = 3; i < argc; i++) {
+        if (strncmp(argv[i], "cores=", strlen("cores=")) == 0) {
+            ncores = atoi(argv[i] + strlen("cores="));
+        } else if (strncmp(argv[i], "moves=", strlen("moves=")) == 0) {
+            moves = atol(argv[i] + strlen("moves="));
+        } else {
+            fprintf(stderr, "unknown argument '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (ncores < 1 || ncores > MAX_CORES || moves < ncores) {
+        fprintf(stderr, "invalid arguments\n");
+        return EXIT_FAILURE;
+    }
+
+    bench_init();
+
+    initialize_channel(argv[2], &chan, &cb, ws,
+                       is_tx ? BULK_DIRECTION_TX : BULK_DIRECTION_RX,
+                       BUFSZ, 0, &done);
+    while (!done) {
+        event_dispatch(ws);
+    }
+
+    if (is_tx) {
+        sender(ncores, moves);
+    }
+
+    while (1) {
+        event_dispatch(ws);
+    }
+
+    return 0;
+}
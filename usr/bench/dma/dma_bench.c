@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014, ETH Zurich. All rights reserved.
+ * Copyright (c) 2014, 2016, ETH Zurich. All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
  * If you do not find this file, copies can be found by writing to:
@@ -21,6 +21,7 @@
 #include <dma/dma.h>
 #include <dma/dma_request.h>
 #include <dma/dma_bench.h>
+#include <dma/dma_copy.h>
 #include <dma/client/dma_client_device.h>
 #include <dma/dma_manager_client.h>
 
@@ -189,6 +190,30 @@ int main(int argc,
 #else
     err = dma_bench_run((struct dma_device *)dev, phys[0], phys[1]);
     EXPECT_SUCCESS(err, "dma_bench_run\n");
+
+    struct dma_copy_engine engine;
+    dma_copy_engine_init(&engine);
+    err = dma_bench_run_copy_engine(&engine, buffers[1], phys[1],
+                                    buffers[0], phys[0]);
+    EXPECT_SUCCESS(err, "dma_bench_run_copy_engine (cpu)\n");
+
+    // offload every size, to see where offloading starts to pay
+    dma_copy_engine_set_policy(&engine, 0, DMA_COPY_MAX_OUTSTANDING);
+    err = dma_copy_sw_backend_init(&engine, 1UL << DMA_BENCH_COPY_MAX_BITS);
+    EXPECT_SUCCESS(err, "dma_copy_sw_backend_init\n");
+    err = dma_bench_run_copy_engine(&engine, buffers[1], phys[1],
+                                    buffers[0], phys[0]);
+    EXPECT_SUCCESS(err, "dma_bench_run_copy_engine (software)\n");
+
+    dma_copy_engine_destroy(&engine);
+    dma_copy_engine_init(&engine);
+    dma_copy_engine_set_policy(&engine, 0, DMA_COPY_MAX_OUTSTANDING);
+    err = dma_copy_device_backend_init(&engine, (struct dma_device *)dev);
+    EXPECT_SUCCESS(err, "dma_copy_device_backend_init\n");
+    err = dma_bench_run_copy_engine(&engine, buffers[1], phys[1],
+                                    buffers[0], phys[0]);
+    EXPECT_SUCCESS(err, "dma_bench_run_copy_engine (device)\n");
+    dma_copy_engine_destroy(&engine);
 #ifndef __k1om__
     err = dma_register_memory((struct dma_device *)dev, frame2);
     EXPECT_SUCCESS(err, "registering memory\n");
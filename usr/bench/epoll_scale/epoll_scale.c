@@ -0,0 +1,335 @@
+/**
+ * \file
+ * \brief Connection-scaling benchmark for epoll
+ *
+ * The server accepts any number of connections and echoes whatever arrives
+ * on them, waiting for work with epoll_wait(). The client opens a growing
+ * number of idle connections and, at every step, measures the round-trip
+ * time of small messages on one extra active connection. With a ready list,
+ * the round-trip time should not depend on the number of idle connections.
+ *
+ * The code compiles on Barrelfish as well as on Linux, use the Makefile to
+ * build the client (and a reference server) on Linux.
+ *
+ *   server: epoll_scale [port=N] [et]
+ *   client: epoll_scale client=<server ip> [port=N] [rounds=N] [max=N]
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef BARRELFISH
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#ifdef BARRELFISH
+# include <barrelfish/barrelfish.h>
+# include <lwip/tcpip.h>
+#endif /* BARRELFISH */
+
+#define DEFAULT_PORT        4243
+#define DEFAULT_ROUNDS      10000
+#define DEFAULT_MAX_IDLE    10000
+#define MSG_SIZE            64
+#define MAX_EVENTS          64
+
+static uint16_t port = DEFAULT_PORT;
+
+#ifdef BARRELFISH
+extern void network_polling_loop(void);
+
+static int poll_loop(void *args)
+{
+    network_polling_loop();
+
+    // should never be reached
+    return EXIT_FAILURE;
+}
+#endif /* BARRELFISH */
+
+static uint64_t now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        perror("fcntl");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * Server
+ */
+
+static void epoll_add(int epfd, int fd, uint32_t events)
+{
+    struct epoll_event ev = {
+        .events = events,
+        .data.fd = fd,
+    };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/// Echo everything that is available, returns false once the peer is gone
+static bool echo(int fd)
+{
+    char buf[MSG_SIZE * 4];
+
+    for (;;) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n == 0) {
+            return false;
+        }
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        for (ssize_t off = 0; off < n; ) {
+            ssize_t w = send(fd, buf + off, n - off, 0);
+            if (w < 0) {
+                return false;
+            }
+            off += w;
+        }
+    }
+}
+
+static int run_server(bool edge)
+{
+    struct sockaddr_in addr;
+    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenfd < 0) {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port        = htons(port);
+    if (bind(listenfd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || listen(listenfd, 128) < 0) {
+        perror("bind/listen");
+        return EXIT_FAILURE;
+    }
+    set_nonblocking(listenfd);
+
+    int epfd = epoll_create1(0);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        return EXIT_FAILURE;
+    }
+    uint32_t mode = edge ? EPOLLET : 0;
+    epoll_add(epfd, listenfd, EPOLLIN | mode);
+
+    printf("epoll_scale: serving on port %" PRIu16 " (%s-triggered)\n", port,
+           edge ? "edge" : "level");
+
+    struct epoll_event events[MAX_EVENTS];
+    size_t nconns = 0;
+    uint64_t waits = 0, wait_us = 0;
+
+    for (;;) {
+        uint64_t t = now_us();
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        wait_us += now_us() - t;
+        waits++;
+        if (n < 0) {
+            perror("epoll_wait");
+            return EXIT_FAILURE;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == listenfd) {
+                int c;
+                while ((c = accept(listenfd, NULL, NULL)) >= 0) {
+                    set_nonblocking(c);
+                    epoll_add(epfd, c, EPOLLIN | mode);
+                    nconns++;
+                }
+                continue;
+            }
+
+            if ((events[i].events & EPOLLHUP) || !echo(fd)) {
+                close(fd);
+                nconns--;
+            }
+        }
+
+        if (waits % 100000 == 0) {
+            printf("epoll_scale: %zu connections, %" PRIu64 " us per wait\n",
+                   nconns, wait_us / waits);
+            waits = wait_us = 0;
+        }
+    }
+}
+
+/*
+ * Client
+ */
+
+static int connect_to(struct sockaddr_in *addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        exit(EXIT_FAILURE);
+    }
+    if (connect(fd, (struct sockaddr *)addr, sizeof(*addr)) < 0) {
+        perror("connect");
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void measure(int fd, size_t idle, int rounds, uint64_t *rtt)
+{
+    char msg[MSG_SIZE], buf[MSG_SIZE];
+    memset(msg, 'x', sizeof(msg));
+
+    for (int r = 0; r < rounds; r++) {
+        uint64_t t = now_us();
+        if (send(fd, msg, sizeof(msg), 0) != sizeof(msg)) {
+            perror("send");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t got = 0; got < sizeof(buf); ) {
+            ssize_t n = recv(fd, buf + got, sizeof(buf) - got, 0);
+            if (n <= 0) {
+                perror("recv");
+                exit(EXIT_FAILURE);
+            }
+            got += n;
+        }
+        rtt[r] = now_us() - t;
+    }
+
+    qsort(rtt, rounds, sizeof(rtt[0]), cmp_u64);
+    uint64_t sum = 0;
+    for (int r = 0; r < rounds; r++) {
+        sum += rtt[r];
+    }
+    printf("%8zu %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n", idle,
+           sum / rounds, rtt[rounds / 2], rtt[rounds * 99 / 100]);
+}
+
+static int run_client(const char *server, int rounds, size_t max_idle)
+{
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port);
+    if (inet_pton(AF_INET, server, &addr.sin_addr) != 1) {
+        fprintf(stderr, "invalid server address '%s'\n", server);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t *rtt = malloc(rounds * sizeof(uint64_t));
+    int *idle = malloc(max_idle * sizeof(int));
+    if (rtt == NULL || idle == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    int active = connect_to(&addr);
+
+    printf("%8s %10s %10s %10s\n", "idle", "mean_us", "median_us", "p99_us");
+    size_t nidle = 0;
+    measure(active, nidle, rounds, rtt);
+    for (size_t target = 10; target <= max_idle; target *= 10) {
+        while (nidle < target) {
+            idle[nidle++] = connect_to(&addr);
+        }
+        measure(active, nidle, rounds, rtt);
+    }
+
+    for (size_t i = 0; i < nidle; i++) {
+        close(idle[i]);
+    }
+    close(active);
+    free(idle);
+    free(rtt);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *server = NULL;
+    int rounds = DEFAULT_ROUNDS;
+    size_t max_idle = DEFAULT_MAX_IDLE;
+    bool edge = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "port=", strlen("port=")) == 0) {
+            port = atoi(argv[i] + strlen("port="));
+        } else if (strncmp(argv[i], "client=", strlen("client=")) == 0) {
+            server = argv[i] + strlen("client=");
+        } else if (strncmp(argv[i], "rounds=", strlen("rounds=")) == 0) {
+            rounds = atoi(argv[i] + strlen("rounds="));
+        } else if (strncmp(argv[i], "max=", strlen("max=")) == 0) {
+            max_idle = atoi(argv[i] + strlen("max="));
+        } else if (strcmp(argv[i], "et") == 0) {
+            edge = true;
+        } else {
+            fprintf(stderr, "unknown argument '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (server != NULL) {
+        return run_client(server, rounds, max_idle);
+    }
+
+#ifdef BARRELFISH
+    /*
+     * Start the main lwIP thread, see usr/tests/net_tests/posix-sockets.
+     * Note that tcpip_init() calls lwip_init_auto().
+     */
+    tcpip_init(NULL, NULL);
+    lwip_socket_init();
+
+    thread_create(poll_loop, NULL);
+#endif /* BARRELFISH */
+
+    return run_server(edge);
+}
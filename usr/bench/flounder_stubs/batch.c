@@ -0,0 +1,218 @@
+/**
+ * \file
+ * \brief Latency/throughput tradeoff of UMP notification batching
+ *
+ * The client sends bursts of fsb_payload1_request messages, the server
+ * answers the last message of every burst. For every burst size the client
+ * reports the average number of cycles per message with notifications
+ * sent for every message, with batching (IDC_CONTROL_SET_BATCH) relying on
+ * the deadline, and with batching and IDC_CONTROL_FLUSH after the burst.
+ *
+ *   flounder_stubs_batch_bench [core]
+ *
+ * The client runs on the given core (default 1). Batching only has an
+ * effect on bindings that send notifications, i.e. with the UMP_IPI
+ * backend.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/nameservice_client.h>
+#include <barrelfish/spawn_client.h>
+#include <bench/bench.h>
+#include <if/bench_defs.h>
+
+#define MESSAGES        10000
+#define MAX_BURST       256
+
+static coreid_t server_core;
+
+/*
+ * Server: answers the last message of a burst (word0 == 0)
+ */
+
+static void fsb_payload1_request(struct bench_binding *b, int32_t word0)
+{
+    if (word0 != 0) {
+        return;
+    }
+
+    errval_t err = b->tx_vtbl.fsb_payload1_reply(b, NOP_CONT, word0);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "sending reply");
+    }
+}
+
+static void export_cb(void *st, errval_t err, iref_t iref)
+{
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "export failed");
+    }
+
+    err = nameservice_register("fsb_batch_server", iref);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "nameservice_register failed");
+    }
+}
+
+static errval_t connect_cb(void *st, struct bench_binding *b)
+{
+    b->rx_vtbl.fsb_payload1_request = fsb_payload1_request;
+    return SYS_ERR_OK;
+}
+
+/*
+ * Client
+ */
+
+enum mode {
+    MODE_NOTIFY,        ///< Notification for every message
+    MODE_DEADLINE,      ///< Batching, partial batches wait for the deadline
+    MODE_FLUSH,         ///< Batching, flushed after every burst
+};
+
+static struct bench_binding *binding;
+static bool reply_received;
+
+static void fsb_payload1_reply(struct bench_binding *b, int32_t word0)
+{
+    reply_received = true;
+}
+
+static void send_burst(size_t burst, enum mode mode)
+{
+    errval_t err;
+
+    for (size_t i = burst; i > 0; i--) {
+        err = binding->tx_vtbl.fsb_payload1_request(binding, NOP_CONT, i - 1);
+        while (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            // channel is full, wait for the server to catch up
+            errval_t err2 = event_dispatch(binding->waitset);
+            if (err_is_fail(err2)) {
+                USER_PANIC_ERR(err2, "event_dispatch");
+            }
+            err = binding->tx_vtbl.fsb_payload1_request(binding, NOP_CONT,
+                                                        i - 1);
+        }
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "fsb_payload1_request");
+        }
+    }
+
+    if (mode == MODE_FLUSH) {
+        err = binding->control(binding, IDC_CONTROL_FLUSH);
+        assert(err_is_ok(err));
+    }
+}
+
+static cycles_t run(size_t burst, enum mode mode)
+{
+    size_t bursts = MESSAGES / burst;
+    errval_t err;
+
+    err = binding->control(binding, mode == MODE_NOTIFY ?
+                           IDC_CONTROL_CLEAR_BATCH : IDC_CONTROL_SET_BATCH);
+    assert(err_is_ok(err));
+
+    cycles_t start = bench_tsc();
+    for (size_t i = 0; i < bursts; i++) {
+        reply_received = false;
+        send_burst(burst, mode);
+        while (!reply_received) {
+            err = event_dispatch(binding->waitset);
+            if (err_is_fail(err)) {
+                USER_PANIC_ERR(err, "event_dispatch");
+            }
+        }
+    }
+
+    return bench_time_diff(start, bench_tsc()) / (bursts * burst);
+}
+
+static void bind_cb(void *st, errval_t err, struct bench_binding *b)
+{
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "bind failed");
+    }
+    b->rx_vtbl.fsb_payload1_reply = fsb_payload1_reply;
+    binding = b;
+}
+
+static void run_client(void)
+{
+    iref_t iref;
+
+    errval_t err = nameservice_blocking_lookup("fsb_batch_server", &iref);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "nameservice_blocking_lookup failed");
+    }
+
+    err = bench_bind(iref, bind_cb, NULL, get_default_waitset(),
+                     IDC_BIND_FLAGS_DEFAULT);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "bind failed");
+    }
+    while (binding == NULL) {
+        event_dispatch(get_default_waitset());
+    }
+
+    printf("Running flounder_stubs_batch between core %d and core %d\n",
+           server_core, disp_get_core_id());
+    printf("%8s %16s %16s %16s\n", "burst", "notify cycles",
+           "deadline cycles", "flush cycles");
+    for (size_t burst = 1; burst <= MAX_BURST; burst *= 4) {
+        cycles_t notify = run(burst, MODE_NOTIFY);
+        cycles_t deadline = run(burst, MODE_DEADLINE);
+        cycles_t flush = run(burst, MODE_FLUSH);
+        printf("%8zu %16"PRIuCYCLES" %16"PRIuCYCLES" %16"PRIuCYCLES"\n",
+               burst, notify, deadline, flush);
+    }
+    printf("client done\n");
+}
+
+int main(int argc, char *argv[])
+{
+    errval_t err;
+    coreid_t client_core = 1;
+
+    bench_init();
+
+    if (argc == 3 && strcmp(argv[1], "client") == 0) {
+        // Spawned by the server, argv[2] is the core of the server
+        server_core = atoi(argv[2]);
+        run_client();
+        return EXIT_SUCCESS;
+    }
+
+    if (argc == 2) {
+        client_core = atoi(argv[1]);
+    }
+
+    err = bench_export(NULL, export_cb, connect_cb, get_default_waitset(),
+                       IDC_EXPORT_FLAGS_DEFAULT);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "export failed");
+    }
+
+    char core[16];
+    snprintf(core, sizeof(core), "%d", disp_get_core_id());
+    char *xargv[] = { argv[0], "client", core, NULL };
+    err = spawn_program(client_core, argv[0], xargv, NULL,
+                        SPAWN_FLAGS_DEFAULT, NULL);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "spawning client on core %d", client_core);
+    }
+
+    messages_handler_loop();
+}
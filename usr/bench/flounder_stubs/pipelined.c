@@ -0,0 +1,309 @@
+/**
+ * \file
+ * \brief Throughput of pipelined flounder RPC calls
+ *
+ * The client issues fsb_pipelined calls with 1, 2, 4, ... calls outstanding
+ * and reports the average number of cycles per call. The first line is the
+ * non-pipelined RPC stub for comparison. Calls are issued with the
+ * asynchronous stub from the event loop and with the blocking stub from as
+ * many threads as calls are outstanding.
+ *
+ *   flounder_stubs_pipelined_bench [core]
+ *
+ * The client runs on the given core (default 1). Use the core of the server
+ * to measure the LMP backend, another one for UMP.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/nameservice_client.h>
+#include <barrelfish/spawn_client.h>
+#include <bench/bench.h>
+#include <if/bench_defs.h>
+#include <if/bench_rpcclient_defs.h>
+
+#define CALLS           10000
+
+static coreid_t server_core;
+
+/*
+ * Server: answers every call with word0 + 1. Replies are queued if the
+ * channel is busy, there are at most FLOUNDER_RPC_WINDOW calls in flight.
+ */
+
+struct pending_reply {
+    uint64_t seq;
+    uint64_t result;
+};
+
+static struct pending_reply pending[FLOUNDER_RPC_WINDOW];
+static size_t pending_head, pending_count;
+static bool send_registered;
+
+static void send_replies(void *arg)
+{
+    struct bench_binding *b = arg;
+    errval_t err;
+
+    send_registered = false;
+    while (pending_count > 0) {
+        struct pending_reply *r = &pending[pending_head];
+
+        err = b->tx_vtbl.fsb_pipelined_response(b, NOP_CONT, r->seq,
+                                                r->result);
+        if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            err = b->register_send(b, b->waitset, MKCONT(send_replies, b));
+            if (err_is_fail(err)) {
+                USER_PANIC_ERR(err, "register_send");
+            }
+            send_registered = true;
+            return;
+        } else if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "sending reply");
+        }
+
+        pending_head = (pending_head + 1) % FLOUNDER_RPC_WINDOW;
+        pending_count--;
+    }
+}
+
+static void fsb_pipelined_call(struct bench_binding *b, uint64_t seq_in,
+                               uint64_t word0)
+{
+    assert(pending_count < FLOUNDER_RPC_WINDOW);
+
+    size_t tail = (pending_head + pending_count) % FLOUNDER_RPC_WINDOW;
+    pending[tail].seq = seq_in;
+    pending[tail].result = word0 + 1;
+    pending_count++;
+
+    if (!send_registered) {
+        send_replies(b);
+    }
+}
+
+static void export_cb(void *st, errval_t err, iref_t iref)
+{
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "export failed");
+    }
+
+    err = nameservice_register("fsb_server", iref);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "nameservice_register failed");
+    }
+}
+
+static errval_t connect_cb(void *st, struct bench_binding *b)
+{
+    b->rx_vtbl.fsb_pipelined_call = fsb_pipelined_call;
+    return SYS_ERR_OK;
+}
+
+/*
+ * Client
+ */
+
+static struct bench_rpc_client rpc;
+static struct bench_binding *binding;
+
+static size_t issued, completed;
+static uint64_t results[FLOUNDER_RPC_WINDOW];
+static errval_t errors[FLOUNDER_RPC_WINDOW];
+
+// Slots of results[] that are not used by an outstanding call
+static size_t idle[FLOUNDER_RPC_WINDOW];
+static size_t idle_count;
+
+static void async_done(void *arg)
+{
+    size_t i = (uintptr_t)arg;
+
+    if (err_is_fail(errors[i])) {
+        USER_PANIC_ERR(errors[i], "pipelined call");
+    }
+    assert(results[i] == i + 1);
+
+    completed++;
+    idle[idle_count++] = i;
+}
+
+static cycles_t run_async(size_t window)
+{
+    struct waitset *ws = get_default_waitset();
+    errval_t err;
+
+    issued = completed = 0;
+    idle_count = 0;
+    for (size_t i = 0; i < window; i++) {
+        idle[idle_count++] = i;
+    }
+
+    cycles_t start = bench_tsc();
+    while (completed < CALLS) {
+        // Keep the window full
+        while (idle_count > 0 && issued < CALLS) {
+            size_t i = idle[idle_count - 1];
+            err = bench_fsb_pipelined__rpc_async(&rpc, ws,
+                                MKCLOSURE(async_done, (void *)(uintptr_t)i),
+                                &errors[i], i, &results[i]);
+            if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+                break;
+            } else if (err_is_fail(err)) {
+                USER_PANIC_ERR(err, "bench_fsb_pipelined__rpc_async");
+            }
+            idle_count--;
+            issued++;
+        }
+
+        // Replies and continuations of async calls arrive on our waitset
+        err = event_dispatch(ws);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "event_dispatch");
+        }
+    }
+
+    return bench_time_diff(start, bench_tsc()) / CALLS;
+}
+
+static int blocking_thread(void *arg)
+{
+    size_t calls = (uintptr_t)arg;
+
+    for (size_t i = 0; i < calls; i++) {
+        uint64_t result;
+
+        errval_t err = bench_fsb_pipelined__rpc_pipelined(&rpc, i, &result);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "bench_fsb_pipelined__rpc_pipelined");
+        }
+        assert(result == i + 1);
+    }
+
+    return 0;
+}
+
+static cycles_t run_blocking(size_t threads)
+{
+    struct thread *t[FLOUNDER_RPC_WINDOW];
+
+    cycles_t start = bench_tsc();
+    for (size_t i = 0; i < threads; i++) {
+        t[i] = thread_create(blocking_thread,
+                             (void *)(uintptr_t)(CALLS / threads));
+        assert(t[i] != NULL);
+    }
+    for (size_t i = 0; i < threads; i++) {
+        errval_t err = thread_join(t[i], NULL);
+        assert(err_is_ok(err));
+    }
+
+    return bench_time_diff(start, bench_tsc()) / CALLS;
+}
+
+static cycles_t run_legacy(void)
+{
+    cycles_t start = bench_tsc();
+    for (size_t i = 0; i < CALLS; i++) {
+        uint64_t seq_out, result;
+
+        errval_t err = rpc.vtbl.fsb_pipelined(&rpc, 0, &seq_out, i, &result);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "fsb_pipelined");
+        }
+        assert(result == i + 1);
+    }
+
+    return bench_time_diff(start, bench_tsc()) / CALLS;
+}
+
+static void bind_cb(void *st, errval_t err, struct bench_binding *b)
+{
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "bind failed");
+    }
+    binding = b;
+}
+
+static void run_client(void)
+{
+    iref_t iref;
+
+    errval_t err = nameservice_blocking_lookup("fsb_server", &iref);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "nameservice_blocking_lookup failed");
+    }
+
+    err = bench_bind(iref, bind_cb, NULL, get_default_waitset(),
+                     IDC_BIND_FLAGS_DEFAULT);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "bind failed");
+    }
+    while (binding == NULL) {
+        event_dispatch(get_default_waitset());
+    }
+
+    err = bench_rpc_client_init(&rpc, binding);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "bench_rpc_client_init");
+    }
+
+    printf("Running flounder_stubs_pipelined between core %d and core %d\n",
+           server_core, disp_get_core_id());
+    printf("%8s %16s %16s\n", "window", "async cycles", "thread cycles");
+    printf("%8s %16"PRIuCYCLES" %16s\n", "rpc", run_legacy(), "-");
+    for (size_t window = 1; window <= FLOUNDER_RPC_WINDOW; window *= 2) {
+        cycles_t async = run_async(window);
+        cycles_t blocking = run_blocking(window);
+        printf("%8zu %16"PRIuCYCLES" %16"PRIuCYCLES"\n", window, async,
+               blocking);
+    }
+    printf("client done\n");
+}
+
+int main(int argc, char *argv[])
+{
+    errval_t err;
+    coreid_t client_core = 1;
+
+    bench_init();
+
+    if (argc == 3 && strcmp(argv[1], "client") == 0) {
+        // Spawned by the server, argv[2] is the core of the server
+        server_core = atoi(argv[2]);
+        run_client();
+        return EXIT_SUCCESS;
+    }
+
+    if (argc == 2) {
+        client_core = atoi(argv[1]);
+    }
+
+    err = bench_export(NULL, export_cb, connect_cb, get_default_waitset(),
+                       IDC_BIND_FLAGS_DEFAULT);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "export failed");
+    }
+
+    char core[16];
+    snprintf(core, sizeof(core), "%d", disp_get_core_id());
+    char *xargv[] = { argv[0], "client", core, NULL };
+    err = spawn_program(client_core, argv[0], xargv, NULL,
+                        SPAWN_FLAGS_DEFAULT, NULL);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "spawning client on core %d", client_core);
+    }
+
+    messages_handler_loop();
+}
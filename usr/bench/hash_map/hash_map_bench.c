@@ -0,0 +1,406 @@
+/**
+ * \file
+ * \brief Host microbenchmark for the collections hash maps
+ *
+ * Compares the open-addressing collections_hash_map against the two older
+ * tables, lib/hashtable (string keys) and collections_hash_table (word
+ * keys), and measures read scaling of the concurrent collections_chash_map
+ * while a writer keeps changing it.
+ *
+ * Build with `make -f Makefile.linux`.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <collections/hash_map.h>
+#include <collections/chash_map.h>
+#include <collections/hash_table.h>
+#include <hashtable/hashtable.h>
+
+#define DEFAULT_ELEMENTS    (1 << 18)
+#define KEY_LEN             16
+#define MAX_READERS         8
+
+static size_t nelems;
+static uint64_t *words;     ///< keys present in the tables, in random order
+static uint64_t *misses;    ///< keys never inserted
+static char *strings;       ///< string form of words, KEY_LEN bytes each
+static char *miss_strings;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void check(int cond, const char *table, const char *what)
+{
+    if (!cond) {
+        fprintf(stderr, "%s: %s returned a wrong result\n", table, what);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void report(const char *table, const char *op, uint64_t ns, size_t ops)
+{
+    printf("%-14s %-12s %8.1f ns/op\n", table, op, (double)ns / ops);
+}
+
+static inline char *skey(char *base, size_t i)
+{
+    return base + i * KEY_LEN;
+}
+
+/*
+ * xorshift64*, keys are random but the run is reproducible
+ */
+static uint64_t rng_state = 88172645463325252ULL;
+static uint64_t rng(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+static void make_keys(void)
+{
+    words = malloc(nelems * sizeof(uint64_t));
+    misses = malloc(nelems * sizeof(uint64_t));
+    strings = malloc(nelems * KEY_LEN);
+    miss_strings = malloc(nelems * KEY_LEN);
+    assert(words && misses && strings && miss_strings);
+
+    // the low bits make keys unique, even keys are inserted, odd ones missed
+    for (size_t i = 0; i < nelems; i++) {
+        words[i] = (rng() & ~0xffffffffULL) | ((uint64_t)i << 1);
+    }
+    // shuffle, so that consecutive operations do not hit neighbouring buckets
+    for (size_t i = nelems - 1; i > 0; i--) {
+        size_t j = rng() % (i + 1);
+        uint64_t tmp = words[i];
+        words[i] = words[j];
+        words[j] = tmp;
+    }
+    for (size_t i = 0; i < nelems; i++) {
+        misses[i] = words[i] | 1;
+        snprintf(skey(strings, i), KEY_LEN, "k%014" PRIx64, words[i]);
+        snprintf(skey(miss_strings, i), KEY_LEN, "m%014" PRIx64, words[i]);
+    }
+}
+
+/*
+ * String keys: lib/hashtable vs. collections_hash_map
+ */
+
+static void bench_hashtable(void)
+{
+    const char *name = "hashtable";
+    // the table never grows, so give it the final size up front
+    struct hashtable *ht = create_hashtable2(nelems, 75);
+    struct dictionary *d = &ht->d;
+    void *val;
+    uint64_t t;
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        d->put_word(d, skey(strings, i), KEY_LEN, i);
+    }
+    report(name, "insert", now_ns() - t, nelems);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        ENTRY_TYPE et = d->get(d, skey(strings, i), KEY_LEN, &val);
+        check(et == TYPE_WORD && (uintptr_t)val == i, name, "find");
+    }
+    report(name, "find hit", now_ns() - t, nelems);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        ENTRY_TYPE et = d->get(d, skey(miss_strings, i), KEY_LEN, &val);
+        check(et == 0, name, "find miss");
+    }
+    report(name, "find miss", now_ns() - t, nelems);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        d->remove(d, skey(strings, i), KEY_LEN);
+    }
+    report(name, "remove", now_ns() - t, nelems);
+    // ht_remove does not update the element count, nor can the table be freed
+}
+
+static void bench_hash_map_bytes(size_t capacity)
+{
+    const char *name = capacity ? "hash_map" : "hash_map grow";
+    collections_hash_map *m;
+    void *val;
+    uint64_t t;
+
+    collections_hash_map_create(&m, COLLECTIONS_HASH_MAP_KEY_BYTES, capacity,
+                                NULL, NULL);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        collections_hash_map_insert_bytes(m, skey(strings, i), KEY_LEN,
+                                          (void *)i);
+    }
+    report(name, "insert", now_ns() - t, nelems);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        bool found = collections_hash_map_lookup_bytes(m, skey(strings, i),
+                                                       KEY_LEN, &val);
+        check(found && (uintptr_t)val == i, name, "find");
+    }
+    report(name, "find hit", now_ns() - t, nelems);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        bool found = collections_hash_map_lookup_bytes(m, skey(miss_strings, i),
+                                                       KEY_LEN, NULL);
+        check(!found, name, "find miss");
+    }
+    report(name, "find miss", now_ns() - t, nelems);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        collections_hash_map_delete_bytes(m, skey(strings, i), KEY_LEN);
+    }
+    report(name, "remove", now_ns() - t, nelems);
+    check(collections_hash_map_size(m) == 0, name, "size");
+
+    collections_hash_map_release(m);
+}
+
+/*
+ * Word keys: collections_hash_table vs. collections_hash_map
+ */
+
+static void bench_hash_table(int buckets)
+{
+    const char *name = buckets ? "hash_table" : "hash_table def";
+    collections_hash_table *ht;
+    uint64_t t;
+
+    // the table never grows, by default it has NUM_BUCKETS buckets
+    if (buckets) {
+        collections_hash_create_with_buckets(&ht, buckets, NULL);
+    } else {
+        collections_hash_create(&ht, NULL);
+    }
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        collections_hash_insert(ht, words[i], (void *)(i + 1));
+    }
+    report(name, "insert", now_ns() - t, nelems);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        void *val = collections_hash_find(ht, words[i]);
+        check((uintptr_t)val == i + 1, name, "find");
+    }
+    report(name, "find hit", now_ns() - t, nelems);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        check(collections_hash_find(ht, misses[i]) == NULL, name, "find miss");
+    }
+    report(name, "find miss", now_ns() - t, nelems);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        collections_hash_delete(ht, words[i]);
+    }
+    report(name, "remove", now_ns() - t, nelems);
+    check(collections_hash_size(ht) == 0, name, "size");
+
+    collections_hash_release(ht);
+}
+
+static void bench_hash_map_word(size_t capacity)
+{
+    const char *name = capacity ? "hash_map" : "hash_map grow";
+    collections_hash_map *m;
+    uint64_t t;
+
+    collections_hash_map_create(&m, COLLECTIONS_HASH_MAP_KEY_WORD, capacity,
+                                NULL, NULL);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        collections_hash_map_insert(m, words[i], (void *)(i + 1));
+    }
+    report(name, "insert", now_ns() - t, nelems);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        void *val = collections_hash_map_find(m, words[i]);
+        check((uintptr_t)val == i + 1, name, "find");
+    }
+    report(name, "find hit", now_ns() - t, nelems);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        check(collections_hash_map_find(m, misses[i]) == NULL, name,
+              "find miss");
+    }
+    report(name, "find miss", now_ns() - t, nelems);
+
+    // churn: remove and re-insert, exercising removed slots and rehashing
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        collections_hash_map_delete(m, words[i]);
+        collections_hash_map_insert(m, misses[i], (void *)(i + 1));
+    }
+    report(name, "churn", now_ns() - t, nelems);
+    for (size_t i = 0; i < nelems; i++) {
+        check(collections_hash_map_find(m, words[i]) == NULL, name, "churn");
+        check((uintptr_t)collections_hash_map_find(m, misses[i]) == i + 1,
+              name, "churn");
+    }
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        collections_hash_map_delete(m, misses[i]);
+    }
+    report(name, "remove", now_ns() - t, nelems);
+    check(collections_hash_map_size(m) == 0, name, "size");
+
+    collections_hash_map_release(m);
+}
+
+/*
+ * Concurrent map: read throughput with a writer changing a part of the map
+ */
+
+struct reader_arg {
+    collections_chash_map *m;
+    volatile int *stop;
+    size_t lookups;
+};
+
+static void *reader(void *arg)
+{
+    struct reader_arg *ra = arg;
+    size_t i = 0;
+
+    while (!*ra->stop) {
+        // the first half of the keys is never removed
+        for (size_t j = 0; j < 1024; j++, i++) {
+            collections_chash_map_reader r;
+            r = collections_chash_map_read_lock(ra->m);
+            size_t k = i % (nelems / 2);
+            void *val = collections_chash_map_find(ra->m, words[k]);
+            check((uintptr_t)val == k + 1, "chash_map", "concurrent find");
+            collections_chash_map_read_unlock(ra->m, r);
+        }
+    }
+    ra->lookups = i;
+    return NULL;
+}
+
+static void bench_chash_map(void)
+{
+    const char *name = "chash_map";
+    collections_chash_map *m;
+    uint64_t t;
+
+    collections_chash_map_create(&m, 0, NULL);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        collections_chash_map_insert(m, words[i], (void *)(i + 1));
+    }
+    report(name, "insert", now_ns() - t, nelems);
+
+    t = now_ns();
+    for (size_t i = 0; i < nelems; i++) {
+        collections_chash_map_reader r = collections_chash_map_read_lock(m);
+        void *val = collections_chash_map_find(m, words[i]);
+        collections_chash_map_read_unlock(m, r);
+        check((uintptr_t)val == i + 1, name, "find");
+    }
+    report(name, "find hit", now_ns() - t, nelems);
+
+    for (int readers = 1; readers <= MAX_READERS; readers *= 2) {
+        pthread_t threads[MAX_READERS];
+        struct reader_arg args[MAX_READERS];
+        volatile int stop = 0;
+        size_t updates = 0;
+
+        t = now_ns();
+        for (int i = 0; i < readers; i++) {
+            args[i] = (struct reader_arg) { .m = m, .stop = &stop };
+            pthread_create(&threads[i], NULL, reader, &args[i]);
+        }
+        // keep removing and re-inserting the second half of the keys
+        while (now_ns() - t < 200000000ULL) {
+            size_t k = nelems / 2 + updates % (nelems / 2);
+            collections_chash_map_delete(m, words[k]);
+            collections_chash_map_insert(m, words[k], (void *)(k + 1));
+            updates++;
+        }
+        stop = 1;
+        size_t lookups = 0;
+        for (int i = 0; i < readers; i++) {
+            pthread_join(threads[i], NULL);
+            lookups += args[i].lookups;
+        }
+        t = now_ns() - t;
+        printf("%-14s %d readers: %8.2f Mlookups/s, writer %8.2f Mupdates/s\n",
+               name, readers, lookups * 1e3 / t, updates * 1e3 / t);
+    }
+
+    collections_chash_map_release(m);
+}
+
+int main(int argc, char *argv[])
+{
+    nelems = DEFAULT_ELEMENTS;
+    if (argc > 1) {
+        nelems = strtoul(argv[1], NULL, 0);
+    }
+    if (nelems < 2) {
+        fprintf(stderr, "Usage: %s [elements]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    make_keys();
+    printf("%zu elements\n\n", nelems);
+
+    printf("string keys (%d bytes)\n", KEY_LEN);
+    bench_hashtable();
+    bench_hash_map_bytes(nelems);
+    bench_hash_map_bytes(0);
+
+    printf("\nword keys\n");
+    // an odd bucket count, so that the keys spread over all buckets
+    bench_hash_table(nelems | 1);
+    bench_hash_table(0);
+    bench_hash_map_word(nelems);
+    bench_hash_map_word(0);
+
+    printf("\nconcurrent\n");
+    bench_chash_map();
+
+    printf("\nhash_map_bench done.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,36 @@
+/**
+ * \file
+ * \brief Minimal stand-in for barrelfish.h to build the hash tables on Linux
+ */
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef LINUX_BARRELFISH_H
+#define LINUX_BARRELFISH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// lib/hashtable can store capabilities, which we never do here
+struct cnoderef {
+    uint32_t address;
+    uint8_t address_bits;
+    uint8_t size_bits;
+    uint8_t guard_size;
+};
+
+struct capref {
+    struct cnoderef cnode;
+    uint32_t slot;
+};
+
+#define NULL_CNODE (struct cnoderef){ 0, 0, 0, 0 }
+#define NULL_CAP   (struct capref){ .cnode = NULL_CNODE, .slot = 0 }
+
+#endif
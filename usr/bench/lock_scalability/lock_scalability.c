@@ -0,0 +1,211 @@
+/**
+ * \file
+ * \brief Lock scalability benchmark for the thread synchronisation primitives
+ *
+ * Spans the domain to a number of cores and runs one thread per core that
+ * repeatedly takes a shared lock around a short critical section. Reports
+ * the average number of cycles per lock/unlock pair for:
+ *
+ *   mutex:    thread_mutex
+ *   pthread:  pthread_mutex
+ *   rd:       thread_rwlock, readers only
+ *   rw10:     thread_rwlock, every tenth acquisition is a write
+ *   prd:      pthread_rwlock, readers only
+ *
+ *   lock_scalability [cores=N] [iterations=N] [work=N]
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <barrelfish/barrelfish.h>
+#include <bench/bench.h>
+
+#define DEFAULT_ITERATIONS  100000
+#define DEFAULT_WORK        50
+#define MAX_CORES           64
+
+enum lock_kind {
+    LOCK_MUTEX,
+    LOCK_PTHREAD_MUTEX,
+    LOCK_RWLOCK_READ,
+    LOCK_RWLOCK_MIXED,
+    LOCK_PTHREAD_RWLOCK_READ,
+    LOCK_KIND_COUNT,
+};
+
+static const char *kind_names[LOCK_KIND_COUNT] = {
+    "mutex", "pthread", "rd", "rw10", "prd",
+};
+
+static struct thread_mutex mutex = THREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pmutex = PTHREAD_MUTEX_INITIALIZER;
+static struct thread_rwlock rwlock = THREAD_RWLOCK_INITIALIZER;
+static pthread_rwlock_t prwlock = PTHREAD_RWLOCK_INITIALIZER;
+
+static enum lock_kind kind;
+static size_t iterations = DEFAULT_ITERATIONS;
+static size_t work = DEFAULT_WORK;
+
+static volatile size_t shared_counter;
+static volatile size_t nstarted;
+static volatile bool go;
+static cycles_t cycles[MAX_CORES];
+
+/// Spin for a few cycles to simulate a critical section
+static void critical_section(size_t n)
+{
+    for (volatile size_t i = 0; i < n; i++) {
+    }
+}
+
+static void lock_once(size_t iteration)
+{
+    switch (kind) {
+    case LOCK_MUTEX:
+        thread_mutex_lock(&mutex);
+        shared_counter++;
+        critical_section(work);
+        thread_mutex_unlock(&mutex);
+        break;
+
+    case LOCK_PTHREAD_MUTEX:
+        pthread_mutex_lock(&pmutex);
+        shared_counter++;
+        critical_section(work);
+        pthread_mutex_unlock(&pmutex);
+        break;
+
+    case LOCK_RWLOCK_MIXED:
+        if (iteration % 10 == 0) {
+            thread_rwlock_wrlock(&rwlock);
+            shared_counter++;
+            critical_section(work);
+            thread_rwlock_unlock(&rwlock);
+            break;
+        }
+        // fall through
+    case LOCK_RWLOCK_READ:
+        thread_rwlock_rdlock(&rwlock);
+        critical_section(work);
+        thread_rwlock_unlock(&rwlock);
+        break;
+
+    case LOCK_PTHREAD_RWLOCK_READ:
+        pthread_rwlock_rdlock(&prwlock);
+        critical_section(work);
+        pthread_rwlock_unlock(&prwlock);
+        break;
+
+    default:
+        USER_PANIC("unknown lock kind %d", kind);
+    }
+}
+
+static int worker(void *arg)
+{
+    coreid_t idx = (coreid_t)(uintptr_t)arg;
+
+    __atomic_fetch_add(&nstarted, 1, __ATOMIC_SEQ_CST);
+    while (!go) {
+    }
+
+    cycles_t start = bench_tsc();
+    for (size_t i = 0; i < iterations; i++) {
+        lock_once(i);
+    }
+    cycles[idx] = bench_tsc() - start;
+
+    return 0;
+}
+
+static void run(coreid_t ncores)
+{
+    struct thread *threads[MAX_CORES];
+    coreid_t my_core = disp_get_core_id();
+    errval_t err;
+
+    nstarted = 0;
+    go = false;
+    shared_counter = 0;
+
+    for (coreid_t i = 1; i < ncores; i++) {
+        err = domain_thread_create_on(my_core + i, worker,
+                                      (void *)(uintptr_t)i, &threads[i]);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "domain_thread_create_on");
+        }
+    }
+    while (nstarted < ncores - 1) {
+        thread_yield();
+    }
+
+    go = true;
+    worker((void *)(uintptr_t)0);
+
+    for (coreid_t i = 1; i < ncores; i++) {
+        err = domain_thread_join(threads[i], NULL);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "domain_thread_join");
+        }
+    }
+
+    cycles_t sum = 0;
+    for (coreid_t i = 0; i < ncores; i++) {
+        sum += cycles[i];
+    }
+    printf("%8s %6u %12" PRIu64 "\n", kind_names[kind], ncores,
+           sum / (ncores * iterations));
+}
+
+int main(int argc, char *argv[])
+{
+    coreid_t ncores = 4;
+    errval_t err;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "cores=", strlen("cores=")) == 0) {
+            ncores = atoi(argv[i] + strlen("cores="));
+        } else if (strncmp(argv[i], "iterations=", strlen("iterations=")) == 0) {
+            iterations = atol(argv[i] + strlen("iterations="));
+        } else if (strncmp(argv[i], "work=", strlen("work=")) == 0) {
+            work = atol(argv[i] + strlen("work="));
+        } else {
+            fprintf(stderr, "unknown argument '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (ncores < 1 || ncores > MAX_CORES || iterations == 0) {
+        fprintf(stderr, "invalid arguments\n");
+        return EXIT_FAILURE;
+    }
+
+    bench_init();
+
+    coreid_t my_core = disp_get_core_id();
+    for (coreid_t i = 1; i < ncores; i++) {
+        err = domain_new_dispatcher(my_core + i, NULL, NULL);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "domain_new_dispatcher");
+        }
+    }
+
+    printf("%8s %6s %12s\n", "lock", "cores", "cycles/op");
+    for (kind = 0; kind < LOCK_KIND_COUNT; kind++) {
+        for (coreid_t n = 1; n <= ncores; n *= 2) {
+            run(n);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -1,5 +1,21 @@
+/**
+ * \file
+ * \brief Same-core LRPC latency benchmark
+ *
+ *   lrpc_bench server [async]
+ *   lrpc_bench client [call] [cache]
+ *
+ * By default the client sends with LMP_FLAG_SYNC and the server replies
+ * through flounder, whose LMP sends are synchronous as well, so both
+ * directions switch directly to the receiver. With "call" the client uses
+ * LMP_FLAG_CALL instead, and the reply switches back to the client even
+ * when the server replies with "async", i.e. without LMP_FLAG_SYNC. A
+ * server started with "async" and a client without "call" measures the
+ * path through the scheduler.
+ */
+
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -21,6 +37,7 @@
 #include <arch/x86/barrelfish_kpi/perfmon_amd.h>
 
 static bool cache_benchmark;
+static lmp_send_flags_t call_flags = LMP_FLAG_SYNC;
 static bool start_benchmark_flag = false;
 static struct bench_binding *binding;
 static struct lmp_chan *chan;
@@ -144,7 +161,7 @@ static void lrpc_benchmark(uint64_t event, uint64_t umask)
             timestamps[currentiter].time0 = bench_tsc();
         }
 
-        err = lmp_ep_send0(chan->remote_cap, LMP_FLAG_SYNC, NULL_CAP);
+        err = lmp_ep_send0(chan->remote_cap, call_flags, NULL_CAP);
         if (err_is_fail(err)) {
             DEBUG_ERR(err, "LRPC %d failed", currentiter);
             printf("lmp_ep_send0 failed\n");
@@ -181,6 +198,7 @@ static errval_t connect_cb(void *st, struct bench_binding *b)
 int main(int argc, char *argv[])
 {
     enum {CLIENT, SERVER} mode = -1;
+    bool async_reply = false;
     errval_t err;
 
     for (int i = 1; i < argc; i++) {
@@ -190,6 +208,10 @@ int main(int argc, char *argv[])
             mode = SERVER;
         } else if (strcmp(argv[i], "cache") == 0) {
             cache_benchmark = true;
+        } else if (strcmp(argv[i], "call") == 0) {
+            call_flags = LMP_FLAG_CALL;
+        } else if (strcmp(argv[i], "async") == 0) {
+            async_reply = true;
         } else {
             fprintf(stderr, "%s: unknown argument '%s'\n", argv[0], argv[i]);
             return -1;
@@ -197,7 +219,7 @@ int main(int argc, char *argv[])
     }
 
     if (mode == -1) {
-        fprintf(stderr, "Usage: %s client|server [cache]\n", argv[0]);
+        fprintf(stderr, "Usage: %s client [call] [cache] | server [async]\n", argv[0]);
         return -1;
     }
 
@@ -222,6 +244,11 @@ int main(int argc, char *argv[])
         };
         lmp_chan_register_recv(chan, get_default_waitset(), ec);
 
+        if (async_reply) {
+            err = binding->control(binding, IDC_CONTROL_CLEAR_SYNC);
+            assert(err_is_ok(err));
+        }
+
         err = binding->tx_vtbl.lrpc_init_reply(binding, NOP_CONT);
         if (err_is_fail(err)) {
             DEBUG_ERR(err, "lrpc_init_reply failed");
@@ -256,7 +283,8 @@ int main(int argc, char *argv[])
         messages_wait_and_handle_next();
     }
 
-    printf("LRPC call benchmark:\n");
+    printf("LRPC call benchmark (%s):\n",
+           call_flags & LMP_FLAG_CALL ? "call" : "sync");
 
     if (cache_benchmark) {
         fprintf(stderr, "cache benchmark NYI, sorry");
@@ -0,0 +1,206 @@
+/**
+ * \file
+ * \brief Contention benchmark for the octopus barriers and locks.
+ *
+ * Runs one participant per core for 2, 4, ... participants. Every
+ * participant repeatedly enters and leaves a barrier with all others and
+ * takes one of a number of octopus locks. Reports the average number of
+ * cycles for a barrier enter/leave and for a lock/unlock pair. Run it with
+ * and without octopus shards (skb octopus_shards=N) to compare.
+ *
+ *   octopus_bench [cores=N] [iterations=N] [locks=N]
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/spawn_client.h>
+#include <bench/bench.h>
+#include <octopus/octopus.h>
+
+#define DEFAULT_ITERATIONS  100
+#define MAX_CORES           64
+
+static size_t iterations = DEFAULT_ITERATIONS;
+static size_t locks = 1;
+
+static void barrier(const char* name, size_t participants)
+{
+    char* record = NULL;
+
+    errval_t err = oct_barrier_enter(name, &record, participants);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "oct_barrier_enter %s", name);
+    }
+    err = oct_barrier_leave(record);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "oct_barrier_leave %s", name);
+    }
+
+    free(record);
+}
+
+/*
+ * One round with the given number of participants, the result is stored in
+ * a record for the coordinator.
+ */
+static void run_participant(size_t participants)
+{
+    char name[64];
+    cycles_t barrier_cycles = 0, lock_cycles = 0;
+
+    snprintf(name, sizeof(name), "octopus_bench.start%zu", participants);
+    barrier(name, participants);
+
+    for (size_t i = 0; i < iterations; i++) {
+        snprintf(name, sizeof(name), "octopus_bench.r%zu.barrier%zu",
+                 participants, i);
+        cycles_t start = bench_tsc();
+        barrier(name, participants);
+        barrier_cycles += bench_tsc() - start;
+    }
+
+    for (size_t i = 0; i < iterations; i++) {
+        char* record = NULL;
+
+        snprintf(name, sizeof(name), "octopus_bench.r%zu.lock%zu",
+                 participants, i % locks);
+        cycles_t start = bench_tsc();
+        errval_t err = oct_lock(name, &record);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "oct_lock %s", name);
+        }
+        err = oct_unlock(record);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "oct_unlock %s", name);
+        }
+        lock_cycles += bench_tsc() - start;
+
+        free(record);
+    }
+
+    errval_t err = oct_set("octopus_bench.result.%zu.%"PRIuCOREID" { round: %zu, "
+                           "barrier: %"PRIuCYCLES", lock: %"PRIuCYCLES" }",
+                           participants, disp_get_core_id(), participants,
+                           barrier_cycles / iterations,
+                           lock_cycles / iterations);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "storing result");
+    }
+
+    snprintf(name, sizeof(name), "octopus_bench.done%zu", participants);
+    barrier(name, participants);
+}
+
+static void run(char* path, size_t participants)
+{
+    char args[3][32];
+    coreid_t my_core = disp_get_core_id();
+
+    snprintf(args[0], sizeof(args[0]), "participants=%zu", participants);
+    snprintf(args[1], sizeof(args[1]), "iterations=%zu", iterations);
+    snprintf(args[2], sizeof(args[2]), "locks=%zu", locks);
+    char *xargv[] = { path, args[0], args[1], args[2], NULL };
+
+    for (size_t i = 1; i < participants; i++) {
+        errval_t err = spawn_program(my_core + i, path, xargv, NULL,
+                                     SPAWN_FLAGS_DEFAULT, NULL);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "spawning participant on core %zu",
+                           my_core + i);
+        }
+    }
+
+    run_participant(participants);
+
+    char** names = NULL;
+    size_t len = 0;
+    errval_t err = oct_get_names(&names, &len, "_ { round: %zu }",
+                                 participants);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "reading results");
+    }
+    assert(len == participants);
+
+    uint64_t barrier_sum = 0, lock_sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        char* record = NULL;
+        uint64_t barrier_cycles, lock_cycles;
+
+        err = oct_get(&record, names[i]);
+        if (err_is_ok(err)) {
+            err = oct_read(record, "_ { barrier: %d, lock: %d }",
+                           &barrier_cycles, &lock_cycles);
+        }
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "reading result %s", names[i]);
+        }
+        barrier_sum += barrier_cycles;
+        lock_sum += lock_cycles;
+
+        free(record);
+        oct_del(names[i]);
+    }
+    oct_free_names(names, len);
+
+    printf("%12zu %8zu %14"PRIu64" %14"PRIu64"\n", participants,
+           oct_shard_count(), barrier_sum / participants,
+           lock_sum / participants);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t cores = 2;
+    size_t participants = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "cores=", strlen("cores=")) == 0) {
+            cores = atol(argv[i] + strlen("cores="));
+        } else if (strncmp(argv[i], "iterations=", strlen("iterations=")) == 0) {
+            iterations = atol(argv[i] + strlen("iterations="));
+        } else if (strncmp(argv[i], "locks=", strlen("locks=")) == 0) {
+            locks = atol(argv[i] + strlen("locks="));
+        } else if (strncmp(argv[i], "participants=",
+                           strlen("participants=")) == 0) {
+            participants = atol(argv[i] + strlen("participants="));
+        } else {
+            fprintf(stderr, "unknown argument '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (cores < 2 || cores > MAX_CORES || iterations == 0 || locks == 0) {
+        fprintf(stderr, "invalid arguments\n");
+        return EXIT_FAILURE;
+    }
+
+    errval_t err = oct_init();
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "oct_init");
+    }
+    bench_init();
+
+    if (participants > 0) {
+        // Spawned by the coordinator
+        run_participant(participants);
+        return EXIT_SUCCESS;
+    }
+
+    printf("%12s %8s %14s %14s\n", "participants", "shards", "barrier/op",
+           "lock/op");
+    for (size_t n = 2; n <= cores; n *= 2) {
+        run(argv[0], n);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,25 @@
+/**
+ * \file
+ * \brief Minimal stand-in for barrelfish.h to build lib/pktcopy on Linux
+ */
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef LINUX_BARRELFISH_H
+#define LINUX_BARRELFISH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// cpuid.h declares functions of lib/cpuid, which we do not link
+typedef uint64_t errval_t;
+typedef uint8_t coreid_t;
+
+#endif
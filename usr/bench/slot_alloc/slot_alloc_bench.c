@@ -0,0 +1,204 @@
+/**
+ * \file
+ * \brief Multi-threaded slot allocation benchmark
+ *
+ * Spans the domain to a number of cores and runs a number of threads on
+ * every core, each allocating and freeing CSpace slots. Reports the average
+ * number of cycles per allocation and free for:
+ *
+ *   cache:  slot_alloc() and slot_free(), through the dispatcher's slot cache
+ *   direct: the default slot allocator, taking its mutex on every operation
+ *
+ * with slots freed right after allocating them (pair) or in bursts of
+ * allocations followed by as many frees (burst=N).
+ *
+ *   slot_alloc_bench [cores=N] [threads=N] [iterations=N] [burst=N]
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <bench/bench.h>
+
+#define DEFAULT_ITERATIONS  10000
+#define DEFAULT_BURST       64
+#define MAX_CORES           64
+#define MAX_THREADS         16
+#define MAX_BURST           1024
+
+enum mode {
+    MODE_CACHE,
+    MODE_DIRECT,
+    MODE_COUNT,
+};
+
+static const char *mode_names[MODE_COUNT] = {
+    "cache", "direct",
+};
+
+static enum mode mode;
+static size_t burst;
+static size_t iterations = DEFAULT_ITERATIONS;
+static size_t nthreads = 1;
+
+static volatile size_t nstarted;
+static volatile bool go;
+static cycles_t cycles[MAX_CORES * MAX_THREADS];
+
+static void alloc_slot(struct capref *slot)
+{
+    errval_t err;
+
+    if (mode == MODE_CACHE) {
+        err = slot_alloc(slot);
+    } else {
+        struct slot_allocator *ca = get_default_slot_allocator();
+        err = ca->alloc(ca, slot);
+    }
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "slot allocation");
+    }
+}
+
+static void free_slot(struct capref slot)
+{
+    errval_t err;
+
+    if (mode == MODE_CACHE) {
+        err = slot_free(slot);
+    } else {
+        struct slot_allocator *ca = get_default_slot_allocator();
+        err = ca->free(ca, slot);
+    }
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "slot free");
+    }
+}
+
+static int worker(void *arg)
+{
+    size_t idx = (uintptr_t)arg;
+    struct capref slots[MAX_BURST];
+    size_t n = burst == 0 ? 1 : burst;
+
+    __atomic_fetch_add(&nstarted, 1, __ATOMIC_SEQ_CST);
+    while (!go) {
+        thread_yield();
+    }
+
+    cycles_t start = bench_tsc();
+    for (size_t i = 0; i < iterations / n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            alloc_slot(&slots[j]);
+        }
+        for (size_t j = 0; j < n; j++) {
+            free_slot(slots[j]);
+        }
+    }
+    cycles[idx] = bench_tsc() - start;
+
+    return 0;
+}
+
+static void run(coreid_t ncores)
+{
+    struct thread *threads[MAX_CORES * MAX_THREADS];
+    coreid_t my_core = disp_get_core_id();
+    size_t total = ncores * nthreads;
+    errval_t err;
+
+    nstarted = 0;
+    go = false;
+
+    for (size_t i = 1; i < total; i++) {
+        err = domain_thread_create_on(my_core + i / nthreads, worker,
+                                      (void *)(uintptr_t)i, &threads[i]);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "domain_thread_create_on");
+        }
+    }
+    while (nstarted < total - 1) {
+        thread_yield();
+    }
+
+    go = true;
+    worker((void *)(uintptr_t)0);
+
+    for (size_t i = 1; i < total; i++) {
+        err = domain_thread_join(threads[i], NULL);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "domain_thread_join");
+        }
+    }
+
+    cycles_t sum = 0;
+    for (size_t i = 0; i < total; i++) {
+        sum += cycles[i];
+    }
+    size_t ops = (iterations / (burst == 0 ? 1 : burst))
+                 * (burst == 0 ? 1 : burst);
+    printf("%8s %6s %6u %8zu %12" PRIu64 "\n", mode_names[mode],
+           burst == 0 ? "pair" : "burst", ncores, nthreads,
+           sum / (total * ops));
+}
+
+int main(int argc, char *argv[])
+{
+    coreid_t ncores = 1;
+    size_t max_burst = DEFAULT_BURST;
+    errval_t err;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "cores=", strlen("cores=")) == 0) {
+            ncores = atoi(argv[i] + strlen("cores="));
+        } else if (strncmp(argv[i], "threads=", strlen("threads=")) == 0) {
+            nthreads = atol(argv[i] + strlen("threads="));
+        } else if (strncmp(argv[i], "iterations=", strlen("iterations=")) == 0) {
+            iterations = atol(argv[i] + strlen("iterations="));
+        } else if (strncmp(argv[i], "burst=", strlen("burst=")) == 0) {
+            max_burst = atol(argv[i] + strlen("burst="));
+        } else {
+            fprintf(stderr, "unknown argument '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (ncores < 1 || ncores > MAX_CORES || nthreads < 1
+        || nthreads > MAX_THREADS || max_burst < 1 || max_burst > MAX_BURST
+        || iterations < max_burst) {
+        fprintf(stderr, "invalid arguments\n");
+        return EXIT_FAILURE;
+    }
+
+    bench_init();
+
+    coreid_t my_core = disp_get_core_id();
+    for (coreid_t i = 1; i < ncores; i++) {
+        err = domain_new_dispatcher(my_core + i, NULL, NULL);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "domain_new_dispatcher");
+        }
+    }
+
+    printf("%8s %6s %6s %8s %12s\n", "mode", "kind", "cores", "threads",
+           "cycles/op");
+    for (mode = 0; mode < MODE_COUNT; mode++) {
+        for (coreid_t n = 1; n <= ncores; n *= 2) {
+            burst = 0;
+            run(n);
+            burst = max_burst;
+            run(n);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/**
+ * \file
+ * \brief Spawn latency and memory use for many instances of one binary
+ *
+ * Spawns N instances of a program on the local core, first bypassing
+ * spawnd's image cache and then using it, and reports the latency of the
+ * spawn requests and the RAM consumed by each batch.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/spawn_client.h>
+#include <bench/bench.h>
+
+#define DEFAULT_INSTANCES   64
+#define DEFAULT_PROGRAM     "hellotest"
+
+static void run(const char *label, char *path, size_t instances,
+                spawn_flags_t flags)
+{
+    errval_t err;
+    genpaddr_t before, after, total;
+
+    cycles_t *latency = calloc(instances, sizeof(cycles_t));
+    assert(latency != NULL);
+
+    char *argv[] = { path, NULL };
+
+    err = ram_available(&before, &total);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "ram_available");
+    }
+
+    for (size_t i = 0; i < instances; i++) {
+        cycles_t start = bench_tsc();
+        err = spawn_program(disp_get_core_id(), path, argv, NULL, flags, NULL);
+        cycles_t end = bench_tsc();
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "spawning %s", path);
+        }
+        latency[i] = bench_time_diff(start, end);
+    }
+
+    err = ram_available(&after, &total);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "ram_available");
+    }
+
+    printf("%s: %zu x %s: first %" PRIuCYCLES " avg %" PRIuCYCLES
+           " min %" PRIuCYCLES " max %" PRIuCYCLES " cycles\n", label,
+           instances, path, latency[0], bench_avg(latency, instances),
+           bench_min(latency, instances), bench_max(latency, instances));
+    printf("%s: RAM used %" PRIuGENPADDR " KB, %" PRIuGENPADDR
+           " KB per domain\n", label, (before - after) / 1024,
+           (before - after) / 1024 / instances);
+
+    free(latency);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t instances = DEFAULT_INSTANCES;
+    char *program = DEFAULT_PROGRAM;
+
+    if (argc > 1) {
+        instances = strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        program = argv[2];
+    }
+    if (instances == 0) {
+        printf("Usage: %s [instances] [program]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bench_init();
+
+    run("uncached", program, instances, SPAWN_FLAGS_NO_IMAGE_CACHE);
+    run("cached", program, instances, SPAWN_FLAGS_DEFAULT);
+
+    printf("spawn_image_bench done.\n");
+    return EXIT_SUCCESS;
+}
@@ -1,5 +1,22 @@
+/**
+ * \file
+ * \brief Append throughput of the tenaciousd log at different batch sizes
+ *
+ * Appends a fixed number of entries for every batch size, so that up to
+ * that many appends share one write and one flush, and reports appends per
+ * second. The log is trimmed between runs, which exercises compaction.
+ *
+ * The code compiles on Barrelfish as well as on Linux, use the Makefile to
+ * build it against the Linux build of libtenaciousd. On Barrelfish the log
+ * is on the first AHCI disk. On Linux it is in the memory of ram_vsic, which
+ * copies the data but adds a modelled latency to every read and write.
+ *
+ *   tenaciousd_bench [appends=N] [size=N]
+ */
+
 /*
  * Copyright (c) 2014, University of Washington.
+ * Copyright (c) 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -7,61 +24,112 @@
  * ETH Zurich D-INFK, Haldeneggsteig 4, CH-8092 Zurich. Attn: Systems Group.
  */
 
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <barrelfish/barrelfish.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#ifdef BARRELFISH
+# include <barrelfish/barrelfish.h>
+#else
+# include <alloca.h>
+# include <errors/errno.h>
+#endif /* BARRELFISH */
+
 #include <storage/storage.h>
 #include <tenaciousd/log.h>
 
-#define ITERATIONS      2
+#define DEFAULT_APPENDS 4096
+#define DEFAULT_SIZE    32
 #define VSA_SIZE        (10*1024*1024)          // 10MB
 
+static const size_t batch_sizes[] = { 1, 4, 16, 64, 256 };
+
 static struct storage_vsa vsa;
 static struct storage_vsic vsic;
-static uint64_t durations[ITERATIONS][2];
+
+static uint64_t now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void run(struct tenaciousd_log *log, struct tenaciousd_log_entry *entry,
+                size_t batch, int appends)
+{
+    errval_t err;
+
+    tenaciousd_log_set_batch(log, batch);
+
+    uint64_t start = now_us();
+    for(int i = 0; i < appends; i++) {
+        err = tenaciousd_log_append(log, entry);
+        assert(err_is_ok(err));
+    }
+    err = tenaciousd_log_commit(log);
+    assert(err_is_ok(err));
+    uint64_t elapsed = now_us() - start;
+
+    printf("%8zu %12" PRIu64 " %12" PRIu64 "\n", batch,
+           elapsed > 0 ? (uint64_t)appends * 1000000 / elapsed : 0,
+           elapsed * 1000 / appends);
+
+    // Keep the log from running off the end of the VSA
+    err = tenaciousd_log_trim(log, appends);
+    assert(err_is_ok(err));
+}
 
 int main(int argc, char *argv[])
 {
+    int appends = DEFAULT_APPENDS;
+    size_t size = DEFAULT_SIZE;
+
+    for(int i = 1; i < argc; i++) {
+        if(strncmp(argv[i], "appends=", strlen("appends=")) == 0) {
+            appends = atoi(argv[i] + strlen("appends="));
+        } else if(strncmp(argv[i], "size=", strlen("size=")) == 0) {
+            size = atol(argv[i] + strlen("size="));
+        }
+    }
+    if(appends <= 0 || size == 0) {
+        fprintf(stderr, "invalid arguments\n");
+        return EXIT_FAILURE;
+    }
+
     // XXX: Need to support multiple backend drivers eventually
     errval_t err = storage_vsic_driver_init(argc, (const char **)argv, &vsic);
     assert(err_is_ok(err));
 
+#ifdef BARRELFISH
     err = storage_vsa_alloc(&vsa, VSA_SIZE);
+#else
+    err = storage_vsa_acquire(&vsa, "tenaciousd_bench", VSA_SIZE);
+#endif
     assert(err_is_ok(err));
 
     struct tenaciousd_log *log = tenaciousd_log_new(&vsa, &vsic);
     assert(log != NULL);
 
-    size_t size = 32;
     struct tenaciousd_log_entry *entry = tenaciousd_log_entry_new(log, &size);
     assert(entry != NULL);
 
     char *str = (char *)entry->data;
-    strcpy(str, "This is a test...");
-
-    for(int i = 0; i < ITERATIONS; i++) {
-        uint64_t start = rdtsc();
+    memset(str, 0, size);
+    strncpy(str, "This is a test...", size);
 
-        err = tenaciousd_log_append(log, entry);
-        assert(err_is_ok(err));
-
-        uint64_t middle = rdtsc();
-        durations[i][0] = middle - start;
-
-        err = vsic.ops.wait(&vsic);
-        assert(err_is_ok(err));
-
-        uint64_t end = rdtsc();
-        durations[i][1] = end - middle;
+    printf("%8s %12s %12s\n", "batch", "appends/s", "ns/append");
+    for(size_t i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); i++) {
+        run(log, entry, batch_sizes[i], appends);
     }
 
+    tenaciousd_log_entry_delete(log, entry);
     err = tenaciousd_log_delete(log);
     assert(err_is_ok(err));
 
-    for(int i = 0; i < ITERATIONS; i++) {
-        printf("iteration %d = %" PRIu64 " %" PRIu64 "\n",
-               i, durations[i][0], durations[i][1]);
-    }
-
-    return 0;
+    return EXIT_SUCCESS;
 }
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+/*
+ * iperf-style UDP throughput client for udp_echo.
+ *
+ * Every stream is a thread with its own socket, so the flows differ in
+ * their source port and are spread over the queues of a multi-queue NIC.
+ * The streams send as fast as they can (or at a fixed rate) and count the
+ * echoed packets. Throughput is reported for every interval and in total.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <strings.h>
+#include <assert.h>
+#include <pthread.h>
+
+#define MAX_STREAMS     64
+#define MAX_PAYLOAD     1472
+
+struct stream {
+  pthread_t sender, receiver;
+  int sockfd;
+  volatile uint64_t tx_packets;
+  volatile uint64_t rx_packets;
+} __attribute__((aligned(64)));
+
+static struct stream streams[MAX_STREAMS];
+static struct sockaddr_in serveraddr;
+static size_t payload, nstreams;
+static long delay = 0;                  /* us between packets, per stream */
+static volatile int done = 0;
+
+/*
+ * error - wrapper for perror
+ */
+static void error(char *msg) {
+  perror(msg);
+  exit(1);
+}
+
+static uint64_t now_us(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static void *sender_func(void *arg)
+{
+  struct stream *s = arg;
+  char buf[MAX_PAYLOAD];
+  uint64_t next = now_us();
+
+  memset(buf, 0, sizeof(buf));
+
+  while (!done) {
+    if (delay > 0) {
+      while (now_us() < next) {
+      }
+      next += delay;
+    }
+
+    int n = sendto(s->sockfd, buf, payload, 0,
+                   (struct sockaddr *) &serveraddr, sizeof(serveraddr));
+    if (n < 0) {
+      /* the socket buffer is full, the packet is lost like on the wire */
+      continue;
+    }
+    s->tx_packets++;
+  }
+
+  return NULL;
+}
+
+static void *receiver_func(void *arg)
+{
+  struct stream *s = arg;
+  char buf[MAX_PAYLOAD];
+
+  while (!done) {
+    int n = recv(s->sockfd, buf, sizeof(buf), 0);
+    if (n < 0) {
+      /* timeout, check whether we are done */
+      continue;
+    }
+    s->rx_packets++;
+  }
+
+  return NULL;
+}
+
+static void report(const char *label, double secs, uint64_t tx, uint64_t rx)
+{
+  double bits = (double) payload * 8;
+
+  printf("%-12s tx %8.1f kpps %9.2f Mbit/s   rx %8.1f kpps %9.2f Mbit/s   "
+         "loss %5.2f%%\n", label,
+         tx / secs / 1000, tx * bits / secs / 1000000,
+         rx / secs / 1000, rx * bits / secs / 1000000,
+         tx ? 100.0 * (double)(tx - (rx < tx ? rx : tx)) / tx : 0.0);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 6) {
+    fprintf(stderr, "usage: %s <port> <server IP> <streams> <payload bytes> "
+            "<seconds> [delay us]\n", argv[0]);
+    exit(1);
+  }
+
+  int portno = atoi(argv[1]);
+  nstreams = atoi(argv[3]);
+  payload = atoi(argv[4]);
+  int seconds = atoi(argv[5]);
+  if (argc > 6) {
+    delay = atol(argv[6]);
+  }
+
+  if (nstreams == 0 || nstreams > MAX_STREAMS) {
+    fprintf(stderr, "streams must be between 1 and %d\n", MAX_STREAMS);
+    exit(1);
+  }
+  if (payload == 0 || payload > MAX_PAYLOAD) {
+    fprintf(stderr, "payload must be between 1 and %d\n", MAX_PAYLOAD);
+    exit(1);
+  }
+
+  bzero((char *) &serveraddr, sizeof(serveraddr));
+  serveraddr.sin_family = AF_INET;
+  serveraddr.sin_addr.s_addr = inet_addr(argv[2]);
+  if(serveraddr.sin_addr.s_addr == INADDR_NONE) {
+      printf("Error on inet_addr()\n");
+      exit(1);
+  }
+  serveraddr.sin_port = htons((unsigned short)portno);
+
+  for (size_t i = 0; i < nstreams; i++) {
+    struct stream *s = &streams[i];
+
+    s->sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s->sockfd < 0)
+      error("ERROR opening socket");
+
+    /* the receivers wake up periodically to see whether we are done */
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = 100000 };
+    setsockopt(s->sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    int ret = pthread_create(&s->receiver, NULL, receiver_func, s);
+    assert(ret == 0);
+    ret = pthread_create(&s->sender, NULL, sender_func, s);
+    assert(ret == 0);
+  }
+
+  uint64_t start = now_us(), last = start;
+  uint64_t last_tx = 0, last_rx = 0;
+
+  for (int t = 1; t <= seconds; t++) {
+    sleep(1);
+
+    uint64_t tx = 0, rx = 0;
+    for (size_t i = 0; i < nstreams; i++) {
+      tx += streams[i].tx_packets;
+      rx += streams[i].rx_packets;
+    }
+
+    uint64_t now = now_us();
+    char label[32];
+    snprintf(label, sizeof(label), "[%3d s]", t);
+    report(label, (now - last) / 1000000.0, tx - last_tx, rx - last_rx);
+
+    last = now;
+    last_tx = tx;
+    last_rx = rx;
+  }
+
+  done = 1;
+
+  for (size_t i = 0; i < nstreams; i++) {
+    pthread_join(streams[i].sender, NULL);
+    pthread_join(streams[i].receiver, NULL);
+  }
+
+  /* count the echoes that were still in flight */
+  uint64_t tx = 0, rx = 0;
+  for (size_t i = 0; i < nstreams; i++) {
+    printf("stream %2zu: tx %" PRIu64 " rx %" PRIu64 "\n", i,
+           streams[i].tx_packets, streams[i].rx_packets);
+    tx += streams[i].tx_packets;
+    rx += streams[i].rx_packets;
+  }
+
+  report("total", (now_us() - start) / 1000000.0, tx, rx);
+
+  return 0;
+}
@@ -0,0 +1,327 @@
+/**
+ * \file
+ * \brief Header+body response benchmark for writev()
+ *
+ * The server answers every request with a small header followed by a body,
+ * in the way an HTTP or memcached server would. The client measures the
+ * round-trip time per request. The server sends each response with one of:
+ *
+ *   copy:   gather header and body into a staging buffer, one send()
+ *   split:  one send() for the header and one for the body
+ *   writev: one writev() of both buffers
+ *
+ * With a vectored path down to the network stack, writev should match copy
+ * without paying for the extra copy, and beat split, which costs an extra
+ * segment per response.
+ *
+ * The code compiles on Barrelfish as well as on Linux, use the Makefile to
+ * build the client (and a reference server) on Linux.
+ *
+ *   server: writev_bench [port=N] [mode=copy|split|writev] [body=N]
+ *   client: writev_bench client=<server ip> [port=N] [rounds=N] [body=N]
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef BARRELFISH
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef BARRELFISH
+# include <barrelfish/barrelfish.h>
+# include <lwip/tcpip.h>
+#endif /* BARRELFISH */
+
+#define DEFAULT_PORT        4244
+#define DEFAULT_ROUNDS      10000
+#define DEFAULT_BODY        1024
+#define REQ_SIZE            32
+#define HDR_SIZE            64
+
+enum send_mode {
+    MODE_COPY,
+    MODE_SPLIT,
+    MODE_WRITEV,
+};
+
+static uint16_t port = DEFAULT_PORT;
+
+#ifdef BARRELFISH
+extern void network_polling_loop(void);
+
+static int poll_loop(void *args)
+{
+    network_polling_loop();
+
+    // should never be reached
+    return EXIT_FAILURE;
+}
+#endif /* BARRELFISH */
+
+static uint64_t now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static bool recv_all(int fd, void *buf, size_t len)
+{
+    for (size_t got = 0; got < len; ) {
+        ssize_t n = recv(fd, (char *)buf + got, len - got, 0);
+        if (n <= 0) {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+static bool send_all(int fd, const void *buf, size_t len)
+{
+    for (size_t off = 0; off < len; ) {
+        ssize_t n = send(fd, (const char *)buf + off, len - off, 0);
+        if (n <= 0) {
+            return false;
+        }
+        off += n;
+    }
+    return true;
+}
+
+/// Send the whole vector, coping with short writes
+static bool writev_all(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n <= 0) {
+            return false;
+        }
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+/*
+ * Server
+ */
+
+static bool respond(int fd, enum send_mode mode, const char *hdr,
+                    const char *body, size_t body_len, char *staging)
+{
+    switch (mode) {
+    case MODE_COPY:
+        memcpy(staging, hdr, HDR_SIZE);
+        memcpy(staging + HDR_SIZE, body, body_len);
+        return send_all(fd, staging, HDR_SIZE + body_len);
+
+    case MODE_SPLIT:
+        return send_all(fd, hdr, HDR_SIZE) && send_all(fd, body, body_len);
+
+    case MODE_WRITEV:
+        {
+            struct iovec iov[2] = {
+                { .iov_base = (void *)hdr, .iov_len = HDR_SIZE },
+                { .iov_base = (void *)body, .iov_len = body_len },
+            };
+            return writev_all(fd, iov, 2);
+        }
+    }
+
+    return false;
+}
+
+static int run_server(enum send_mode mode, size_t body_len)
+{
+    static const char *mode_names[] = { "copy", "split", "writev" };
+    struct sockaddr_in addr;
+    int one = 1;
+
+    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenfd < 0) {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port        = htons(port);
+    if (bind(listenfd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || listen(listenfd, 8) < 0) {
+        perror("bind/listen");
+        return EXIT_FAILURE;
+    }
+
+    char hdr[HDR_SIZE], req[REQ_SIZE];
+    char *body = malloc(body_len);
+    char *staging = malloc(HDR_SIZE + body_len);
+    if (body == NULL || staging == NULL) {
+        return EXIT_FAILURE;
+    }
+    memset(hdr, 'h', sizeof(hdr));
+    memset(body, 'b', body_len);
+
+    printf("writev_bench: serving on port %" PRIu16 " (%s, %zu byte body)\n",
+           port, mode_names[mode], body_len);
+
+    for (;;) {
+        int fd = accept(listenfd, NULL, NULL);
+        if (fd < 0) {
+            perror("accept");
+            return EXIT_FAILURE;
+        }
+        // every response is complete, don't let Nagle hide the split case
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        while (recv_all(fd, req, sizeof(req))
+               && respond(fd, mode, hdr, body, body_len, staging)) {
+        }
+        close(fd);
+    }
+}
+
+/*
+ * Client
+ */
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int run_client(const char *server, int rounds, size_t body_len)
+{
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port);
+    if (inet_pton(AF_INET, server, &addr.sin_addr) != 1) {
+        fprintf(stderr, "invalid server address '%s'\n", server);
+        return EXIT_FAILURE;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t *rtt = malloc(rounds * sizeof(uint64_t));
+    char *resp = malloc(HDR_SIZE + body_len);
+    if (rtt == NULL || resp == NULL) {
+        return EXIT_FAILURE;
+    }
+    char req[REQ_SIZE];
+    memset(req, 'r', sizeof(req));
+
+    uint64_t start = now_us();
+    for (int r = 0; r < rounds; r++) {
+        uint64_t t = now_us();
+        if (!send_all(fd, req, sizeof(req))
+            || !recv_all(fd, resp, HDR_SIZE + body_len)) {
+            perror("send/recv");
+            return EXIT_FAILURE;
+        }
+        rtt[r] = now_us() - t;
+    }
+    uint64_t elapsed = now_us() - start;
+
+    qsort(rtt, rounds, sizeof(rtt[0]), cmp_u64);
+    printf("%10s %10s %10s %10s\n", "body", "req_per_s", "median_us",
+           "p99_us");
+    printf("%10zu %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n", body_len,
+           elapsed > 0 ? (uint64_t)rounds * 1000000 / elapsed : 0,
+           rtt[rounds / 2], rtt[rounds * 99 / 100]);
+
+    close(fd);
+    free(resp);
+    free(rtt);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *server = NULL;
+    int rounds = DEFAULT_ROUNDS;
+    size_t body_len = DEFAULT_BODY;
+    enum send_mode mode = MODE_WRITEV;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "port=", strlen("port=")) == 0) {
+            port = atoi(argv[i] + strlen("port="));
+        } else if (strncmp(argv[i], "client=", strlen("client=")) == 0) {
+            server = argv[i] + strlen("client=");
+        } else if (strncmp(argv[i], "rounds=", strlen("rounds=")) == 0) {
+            rounds = atoi(argv[i] + strlen("rounds="));
+        } else if (strncmp(argv[i], "body=", strlen("body=")) == 0) {
+            body_len = atoi(argv[i] + strlen("body="));
+        } else if (strcmp(argv[i], "mode=copy") == 0) {
+            mode = MODE_COPY;
+        } else if (strcmp(argv[i], "mode=split") == 0) {
+            mode = MODE_SPLIT;
+        } else if (strcmp(argv[i], "mode=writev") == 0) {
+            mode = MODE_WRITEV;
+        } else {
+            fprintf(stderr, "unknown argument '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (rounds <= 0) {
+        fprintf(stderr, "rounds must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    if (server != NULL) {
+        return run_client(server, rounds, body_len);
+    }
+
+#ifdef BARRELFISH
+    /*
+     * Start the main lwIP thread, see usr/tests/net_tests/posix-sockets.
+     * Note that tcpip_init() calls lwip_init_auto().
+     */
+    tcpip_init(NULL, NULL);
+    lwip_socket_init();
+
+    thread_create(poll_loop, NULL);
+#endif /* BARRELFISH */
+
+    return run_server(mode, body_len);
+}
@@ -1,8 +1,12 @@
 /**
  * Tests cross core cap management
  *
+ * Every iteration, each core sends copies of its RAM caps to random other
+ * cores, retypes them and finally revokes them. The revoke has to find and
+ * delete the remote copies, so its latency is dominated by the monitors'
+ * capops broadcasts.
  *
- * Copyright (c) 2010, 2011, ETH Zurich.
+ * Copyright (c) 2010, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -30,6 +34,7 @@ static bool connected;
 static bool connect;
 static bool start_sending_caps;
 static bool start_retyping_caps;
+static bool start_revoking_caps;
 static struct xcorecapbench_binding *bindings[MAX_CPUS];
 static coreid_t my_coreid; 
 static coreid_t num_cores;
@@ -43,6 +48,7 @@ static cycles_t total_cycles;
 static void connect_handler(struct xcorecapbench_binding *b);
 static void start_retyping_handler(struct xcorecapbench_binding *b);
 static void start_sending_handler(struct xcorecapbench_binding *b);
+static void start_revoking_handler(struct xcorecapbench_binding *b);
 static void send_cap_handler(struct xcorecapbench_binding *b, 
                              struct capref ram_cap); 
 static void barrier_done_handler(struct xcorecapbench_binding *b, uint64_t cycles);
@@ -50,6 +56,7 @@ static void barrier_done_handler(struct xcorecapbench_binding *b, uint64_t cycle
 struct xcorecapbench_rx_vtbl rx_vtbl = {
     .start_retyping= start_retyping_handler,
     .start_sending = start_sending_handler,
+    .start_revoking= start_revoking_handler,
     .send_cap      = send_cap_handler,
     .barrier_done  = barrier_done_handler,
     .connect       = connect_handler,
@@ -134,16 +141,33 @@ static cycles_t retype_caps(void)
     return time_taken / (CAPS_PER_CORE - 40);
 }
 
-static void destroy_caps(void)
+static cycles_t revoke_caps(void)
 {
     errval_t err;
+    cycles_t time_taken = 0;
     for (int i=0; i<CAPS_PER_CORE; i++) {
         err = cap_destroy(retyped_caps[i]);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "xcorecap: destroying retyped cap failed\n");
+        }
+        err = slot_alloc(&retyped_caps[i]);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "slot alloc err\n");
+            abort();
+        }
+
+        // deletes the copies that were sent to the other cores
+        cycles_t start =  bench_tsc();
         err = cap_revoke(my_caps[i]);
+        if (i >= 20 && i <= (CAPS_PER_CORE - 20)) { // avoid warmup / cooldown
+            time_taken += (bench_tsc() - start);
+        }
         if (err_is_fail(err)) {
-            DEBUG_ERR(err, "xcorecap: Retype to frame failed\n");    
+            DEBUG_ERR(err, "xcorecap: revoke failed\n");
         }
     }
+
+    return time_taken / (CAPS_PER_CORE - 40);
 }
 
 static void start_sending_handler(struct xcorecapbench_binding *b)
@@ -156,6 +180,11 @@ static void start_retyping_handler(struct xcorecapbench_binding *b)
     start_retyping_caps = true;
 }
 
+static void start_revoking_handler(struct xcorecapbench_binding *b)
+{
+    start_revoking_caps = true;
+}
+
 static void connect_handler(struct xcorecapbench_binding *b)
 {
     connect = true;
@@ -280,52 +309,80 @@ static void bind_core(coreid_t core) {
 }
 
 /* ----- Experiment ------- */
-static void do_experiment_bsp(void)
+
+enum phase {
+    PHASE_SEND,
+    PHASE_RETYPE,
+    PHASE_REVOKE,
+};
+
+static cycles_t run_phase(enum phase phase)
+{
+    switch (phase) {
+    case PHASE_SEND:
+        return send_caps();
+    case PHASE_RETYPE:
+        return retype_caps();
+    case PHASE_REVOKE:
+        return revoke_caps();
+    default:
+        assert(!"unknown phase");
+        return 0;
+    }
+}
+
+static errval_t start_phase(struct xcorecapbench_binding *b, enum phase phase)
+{
+    switch (phase) {
+    case PHASE_SEND:
+        return b->tx_vtbl.start_sending(b, NOP_CONT);
+    case PHASE_RETYPE:
+        return b->tx_vtbl.start_retyping(b, NOP_CONT);
+    case PHASE_REVOKE:
+        return b->tx_vtbl.start_revoking(b, NOP_CONT);
+    default:
+        assert(!"unknown phase");
+        return SYS_ERR_OK;
+    }
+}
+
+/// Runs a phase on all cores and returns the average cycles per operation
+static cycles_t run_phase_bsp(enum phase phase)
 {
     errval_t err;
 
-    printf("Sending Caps\n");
     wait_for = num_cores;
     total_cycles = 0;
 
     for (int i=1; i<num_cores; i++) {
         do {
-            err = bindings[i]->tx_vtbl.start_sending(bindings[i], NOP_CONT);
+            err = start_phase(bindings[i], phase);
         } while (redo_message(err));
-        
+
         assert(err_is_ok(err));
     }
-    total_cycles += send_caps();
+    total_cycles += run_phase(phase);
     wait_for--;
-    
+
     // wait for other cores to finish
     while(wait_for) {
         messages_wait_and_handle_next();
     }
 
-    printf("Retyping Caps\n");
+    return total_cycles / num_cores;
+}
+
+static void do_experiment_bsp(void)
+{
+    printf("Sending, retyping and revoking caps\n");
+    printf("iter send retype revoke\n");
     for(int iter=0; iter<10; iter++) {
-        wait_for = num_cores;
-        total_cycles = 0;
-        
-        for (int i=1; i<num_cores; i++) {
-            do {
-                err = bindings[i]->tx_vtbl.start_retyping(bindings[i], NOP_CONT);
-            } while (redo_message(err));
-            
-            assert(err_is_ok(err));
-        }
-        total_cycles += retype_caps();
-        wait_for--;
-        
-        // wait for other cores to finish
-        while(wait_for) {
-            messages_wait_and_handle_next();
-        }
+        cycles_t send = run_phase_bsp(PHASE_SEND);
+        cycles_t retype = run_phase_bsp(PHASE_RETYPE);
+        cycles_t revoke = run_phase_bsp(PHASE_REVOKE);
 
-        destroy_caps();
-        
-        printf("%" PRIuCYCLES "\n", total_cycles / num_cores);
+        printf("%d %" PRIuCYCLES " %" PRIuCYCLES " %" PRIuCYCLES "\n", iter,
+               send, retype, revoke);
     }
     printf("Done\n");
 }
@@ -336,23 +393,26 @@ static void do_experiment_client(void)
     errval_t err;
     cycles_t cycles;
 
-    while(!start_sending_caps) {
-        messages_wait_and_handle_next();
-    }
-    cycles = send_caps();
-    do {
-        err = bindings[0]->tx_vtbl.barrier_done(bindings[0], NOP_CONT, cycles);
-    } while (redo_message(err));
-    assert(err_is_ok(err));
-
     while (true) {
+        enum phase phase;
+
+        start_sending_caps = false;
         start_retyping_caps = false;
-        while(!start_retyping_caps) {
+        start_revoking_caps = false;
+        while(!start_sending_caps && !start_retyping_caps &&
+              !start_revoking_caps) {
             messages_wait_and_handle_next();
         }
-        cycles = retype_caps();
-        
-        destroy_caps();
+
+        if (start_sending_caps) {
+            phase = PHASE_SEND;
+        } else if (start_retyping_caps) {
+            phase = PHASE_RETYPE;
+        } else {
+            phase = PHASE_REVOKE;
+        }
+
+        cycles = run_phase(phase);
         do {
             err = bindings[0]->tx_vtbl.barrier_done(bindings[0], NOP_CONT, cycles);
         } while (redo_message(err));
@@ -402,6 +462,7 @@ int main (int argc, char* argv[])
     connected = false;
     start_sending_caps  = false;
     start_retyping_caps = false;
+    start_revoking_caps = false;
 
     // munge up a bunch of caps
     create_caps();
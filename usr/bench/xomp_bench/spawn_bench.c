@@ -12,6 +12,7 @@
 
 #include <barrelfish/barrelfish.h>
 #include <barrelfish/nameservice_client.h>
+#include <barrelfish/coreset.h>
 
 #include <xeon_phi/xeon_phi.h>
 #include <xeon_phi/xeon_phi_domain.h>
@@ -50,6 +51,65 @@ static void prepare_bomp(void)
     timer_xompinit = bench_time_diff(tsc_start, tsc_end);
 }
 
+static cycles_t span_start;
+static cycles_t span_latency[MAX_COREID];
+
+static void span_done(void *arg, coreid_t core_id, errval_t err)
+{
+    EXPECT_SUCCESS(err, "spanning domain");
+    span_latency[core_id] = bench_time_diff(span_start, bench_tsc());
+}
+
+static void span_done_seq(void *arg, errval_t err)
+{
+    span_done(NULL, (coreid_t)(uintptr_t)arg, err);
+}
+
+/*
+ * Span the domain to the nthreads - 1 cores following ours, either one core
+ * after the other or all at once, and report the latency per core as seen
+ * from the start of the span.
+ */
+static void prepare_span(bool bulk)
+{
+    errval_t err;
+
+    coreid_t my_core = disp_get_core_id();
+    struct coreset *cores;
+    err = coreset_new(&cores);
+    EXPECT_SUCCESS(err, "coreset_new");
+    for (coreid_t i = 1; i < nthreads; i++) {
+        err = coreset_add(cores, my_core + i);
+        EXPECT_SUCCESS(err, "coreset_add");
+    }
+
+    debug_printf("spanning to %u cores (%s)\n", nthreads - 1,
+                 bulk ? "bulk" : "sequential");
+
+    cycles_t tsc_start = bench_tsc();
+    span_start = tsc_start;
+    if (bulk) {
+        err = domain_new_dispatchers(cores, span_done, NULL);
+        EXPECT_SUCCESS(err, "domain_new_dispatchers");
+    } else {
+        for (coreid_t i = 1; i < nthreads; i++) {
+            coreid_t core = my_core + i;
+            err = domain_new_dispatcher(core, span_done_seq,
+                                        (void *)(uintptr_t)core);
+            EXPECT_SUCCESS(err, "domain_new_dispatcher");
+        }
+    }
+    cycles_t tsc_end = bench_tsc();
+    timer_xompinit = bench_time_diff(tsc_start, tsc_end);
+
+    for (coreid_t i = 1; i < nthreads; i++) {
+        debug_printf("span core %u: %" PRIuCYCLES "\n", my_core + i,
+                     span_latency[my_core + i]);
+    }
+
+    coreset_destroy(cores);
+}
+
 static int prepare_xomp(int argc,
                         char *argv[])
 {
@@ -163,6 +223,10 @@ int main(int argc,
             is_shared = 1;
         } else if (!strcmp(argv[i], "xomp")) {
             is_shared = prepare_xomp(argc, argv);
+        } else if (!strcmp(argv[i], "span")) {
+            prepare_span(false);
+        } else if (!strcmp(argv[i], "span_bulk")) {
+            prepare_span(true);
         } else {
             debug_printf("ignoring argument {%s}\n", argv[i]);
         }
@@ -23,6 +23,7 @@
 #include "local_server.h"
 #include "network_server.h"
 #include "block_storage.h"
+#include "block_storage_cache.h"
 
 
 
@@ -46,6 +47,14 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    /* initialize the block cache in front of it */
+    err = block_cache_init(BLOCK_CACHE_SIZE, BLOCK_CACHE_WRITE_BACK);
+    if (err_is_fail(err)) {
+        block_storage_dealloc();
+        USER_PANIC_ERR(err, "could not initialize the block cache.\n");
+        exit(EXIT_FAILURE);
+    }
+
 
 #if BLOCK_ENABLE_NETWORKING
     /* initialize the network service */
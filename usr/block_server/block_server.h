@@ -39,6 +39,27 @@
 /// enables the network connector, disable for shared memory only benchmark
 #define BLOCK_ENABLE_NETWORKING 1
 
+/*
+ * BLOCK CACHE
+ */
+
+/// number of blocks in the block cache, 0 disables the cache. Cached blocks
+/// hold on to a buffer, so keep this well below BLOCK_NET_BUFFER_COUNT
+#define BLOCK_CACHE_SIZE 256
+
+/// keep writes to cached blocks in the cache and write them back in batches
+#define BLOCK_CACHE_WRITE_BACK 0
+
+/// number of dirty blocks that triggers a write back
+#define BLOCK_CACHE_FLUSH_BATCH 32
+
+/// period of the write back timer in milliseconds. Dirty blocks are written
+/// back on the first tick without writes, and after two ticks at the latest
+#define BLOCK_CACHE_FLUSH_INTERVAL_MS 100
+
+/// print the hit and miss rates after this many lookups, 0 to disable
+#define BLOCK_CACHE_STATS_INTERVAL 10000
+
 /*
  * BENCHMARK CONTROL
  */
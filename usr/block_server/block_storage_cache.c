@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -12,9 +12,14 @@
  * ETH Zurich D-INFK, Haldeneggsteig 4, CH-8092 Zurich. Attn: Systems Group.
  */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include <barrelfish/barrelfish.h>
+#include <barrelfish/deferred.h>
 
 #include "block_server.h"
+#include "block_storage.h"
 
 #include "block_storage_cache.h"
 
@@ -26,41 +31,523 @@
 
 struct buffer_list *bs_bulk_buffers = NULL;
 
+/*
+ * The block cache keeps the data of recently read blocks in bulk buffers of
+ * the channel the block was last read on. A hit is answered by moving the
+ * cached buffer itself, the entry is lent out until the client passes the
+ * buffer back. Entries are evicted with the CLOCK algorithm, lent entries
+ * are never evicted.
+ *
+ * Invariant: lent entries are clean, so block_storage is up to date for
+ * every block that is currently lent out. A miss on a dirty entry writes it
+ * back before the caller reads the block from block_storage.
+ *
+ * In write-back mode, dirty blocks are written back when
+ * BLOCK_CACHE_FLUSH_BATCH of them have accumulated, by the flush timer once
+ * the server is idle or the blocks have been dirty for two timer periods,
+ * and on shutdown.
+ */
+
+struct block_cache_entry
+{
+    size_t blockid;
+    struct bulk_buffer *buf;
+    struct bulk_channel *chan;
+    struct block_cache_entry *next_block;   ///< hash chain by block id
+    struct block_cache_entry *next_buf;     ///< hash chain by buffer
+    bool used;
+    bool referenced;                        ///< CLOCK reference bit
+    bool lent;                              ///< buffer is with the client
+    bool dirty;                             ///< not yet written to storage
+    bool stale;                             ///< drop once the buffer is back
+};
+
+static struct block_cache
+{
+    struct block_cache_entry *entries;
+    size_t capacity;
+    size_t hand;
+    size_t ndirty;
+    bool write_back;
+    bool written;                           ///< writes since the last tick
+    unsigned dirty_ticks;                   ///< ticks with dirty blocks
+    struct periodic_event flush_timer;
+    struct block_cache_entry **by_block;
+    struct block_cache_entry **by_buf;
+    struct block_cache_entry **flush_list;
+    size_t nbuckets;
+    struct block_cache_stats stats;
+} cache;
+
+static inline struct block_cache_entry **block_bucket(size_t blockid)
+{
+    return &cache.by_block[blockid & (cache.nbuckets - 1)];
+}
+
+static inline struct block_cache_entry **buf_bucket(struct bulk_buffer *buf)
+{
+    uintptr_t key = (uintptr_t) buf / sizeof(struct bulk_buffer);
+    return &cache.by_buf[key & (cache.nbuckets - 1)];
+}
+
+static struct block_cache_entry *find_block(size_t blockid)
+{
+    struct block_cache_entry *e = *block_bucket(blockid);
+    while (e && e->blockid != blockid) {
+        e = e->next_block;
+    }
+    return e;
+}
+
+static struct block_cache_entry *find_buf(struct bulk_buffer *buf)
+{
+    struct block_cache_entry *e = *buf_bucket(buf);
+    while (e && e->buf != buf) {
+        e = e->next_buf;
+    }
+    return e;
+}
+
+static void entry_link(struct block_cache_entry *e)
+{
+    struct block_cache_entry **b = block_bucket(e->blockid);
+    e->next_block = *b;
+    *b = e;
+
+    b = buf_bucket(e->buf);
+    e->next_buf = *b;
+    *b = e;
+}
+
+static void entry_unlink(struct block_cache_entry *e)
+{
+    struct block_cache_entry **p = block_bucket(e->blockid);
+    while (*p != e) {
+        p = &(*p)->next_block;
+    }
+    *p = e->next_block;
+
+    p = buf_bucket(e->buf);
+    while (*p != e) {
+        p = &(*p)->next_buf;
+    }
+    *p = e->next_buf;
+}
+
+/**
+ * \brief removes an entry and gives its buffer back to the buffer store
+ */
+static void entry_drop(struct block_cache_entry *e)
+{
+    assert(!e->lent);
+    if (e->dirty) {
+        e->dirty = false;
+        cache.ndirty--;
+    }
+    entry_unlink(e);
+    block_server_insert_buffer(&bs_bulk_buffers, e->buf, e->chan);
+    e->buf = NULL;
+    e->used = false;
+}
+
+static errval_t entry_write_back(struct block_cache_entry *e)
+{
+    assert(e->dirty && !e->lent);
+
+    errval_t err = block_storage_write(e->blockid, e->buf->address);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    e->dirty = false;
+    cache.ndirty--;
+    cache.stats.flushed_blocks++;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief finds a free entry, evicting one if necessary
+ *
+ * \returns NULL if all entries are lent out
+ */
+static struct block_cache_entry *entry_alloc(void)
+{
+    // two rounds: the first one may only clear reference bits
+    for (size_t i = 0; i < 2 * cache.capacity; i++) {
+        struct block_cache_entry *e = cache.entries + cache.hand;
+        cache.hand = (cache.hand + 1) % cache.capacity;
+
+        if (!e->used) {
+            return e;
+        }
+        if (e->lent) {
+            continue;
+        }
+        if (e->referenced) {
+            e->referenced = false;
+            continue;
+        }
+        if (e->dirty && err_is_fail(entry_write_back(e))) {
+            continue;
+        }
+        entry_drop(e);
+        cache.stats.evictions++;
+        return e;
+    }
+
+    return NULL;
+}
+
+static void flush_timer_fired(void *arg)
+{
+    if (cache.ndirty == 0) {
+        cache.dirty_ticks = 0;
+        return;
+    }
+
+    if (!cache.written || ++cache.dirty_ticks >= 2) {
+        errval_t err = block_cache_flush();
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "block cache: write back failed");
+        }
+        cache.dirty_ticks = 0;
+    }
+    cache.written = false;
+}
+
+/**
+ * \brief initializes the block cache
+ *
+ * \param capacity      the maximum number of blocks in the cache
+ * \param write_back    keep writes in the cache and flush them in batches
+ */
+errval_t block_cache_init(size_t capacity, bool write_back)
+{
+    if (capacity == 0) {
+        return SYS_ERR_OK;
+    }
+
+    size_t nbuckets = 1;
+    while (nbuckets < 2 * capacity) {
+        nbuckets <<= 1;
+    }
+
+    cache.entries = calloc(capacity, sizeof(struct block_cache_entry));
+    cache.by_block = calloc(nbuckets, sizeof(struct block_cache_entry *));
+    cache.by_buf = calloc(nbuckets, sizeof(struct block_cache_entry *));
+    cache.flush_list = calloc(capacity, sizeof(struct block_cache_entry *));
+    if (!cache.entries || !cache.by_block || !cache.by_buf
+                    || !cache.flush_list) {
+        free(cache.entries);
+        free(cache.by_block);
+        free(cache.by_buf);
+        free(cache.flush_list);
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    cache.capacity = capacity;
+    cache.nbuckets = nbuckets;
+    cache.write_back = write_back;
+
+    if (write_back) {
+        errval_t err = periodic_event_create(&cache.flush_timer,
+                                             get_default_waitset(),
+                                             BLOCK_CACHE_FLUSH_INTERVAL_MS * 1000,
+                                             MKCLOSURE(flush_timer_fired, NULL));
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    BS_BS_DEBUG("block cache: %i blocks, write-%s", (uint32_t) capacity,
+                write_back ? "back" : "through");
+
+    return SYS_ERR_OK;
+}
+
 /**
  * \brief inserts a new block into the cache
  *
+ * The cache takes over the buffer, which holds the data of the block and is
+ * about to be moved to the client. When the buffer comes back, it stays in
+ * the cache instead of going back to the buffer store.
+ *
  * \param blockid   the id of the block to insert
- * \param data      the data of the block XXX: This should be bulk_buf?
+ * \param chan      the channel the buffer is moved on
+ * \param buf       the buffer holding the data of the block
  */
-errval_t block_cache_insert(size_t blockid, void *data)
+errval_t block_cache_insert(size_t blockid, struct bulk_channel *chan,
+                            struct bulk_buffer *buf)
 {
-    assert(!"NYI: block_cache_insert");
+    if (cache.capacity == 0) {
+        return FS_CACHE_FULL;
+    }
+
+    if (find_block(blockid)) {
+        // the cached copy is lent out, this buffer stays uncached
+        return FS_CACHE_CONFLICT;
+    }
+
+    struct block_cache_entry *e = entry_alloc();
+    if (e == NULL) {
+        return FS_CACHE_FULL;
+    }
+
+    e->blockid = blockid;
+    e->buf = buf;
+    e->chan = chan;
+    e->used = true;
+    e->referenced = false;
+    e->lent = true;
+    e->dirty = false;
+    e->stale = false;
+    entry_link(e);
+
+    cache.stats.inserts++;
+
     return SYS_ERR_OK;
 }
 
 /**
  * \brief invalidates a block in the cache
  *
+ * The cached data is dropped without writing it back.
+ *
  * \param blockid   the id of the block to invalidate
  */
 errval_t block_cache_invalidate(size_t blockid)
 {
-    assert(!"NYI: block_cache_invalidate");
+    if (cache.capacity == 0) {
+        return SYS_ERR_OK;
+    }
+
+    struct block_cache_entry *e = find_block(blockid);
+    if (e == NULL) {
+        return SYS_ERR_OK;
+    }
+
+    if (e->lent) {
+        e->stale = true;
+    } else {
+        entry_drop(e);
+    }
+
     return SYS_ERR_OK;
 }
 
 /**
  * \brief looks up a block in the cache and returns it if present
  *
+ * On a hit, the returned buffer is lent out and must be moved to the client
+ * on \p chan. It is handed back with block_cache_buffer_returned().
+ *
  * \param blockid   the ID of the block to lookup
- * \param ret_data  pointer to the returned data XXX: bulk_buf?
+ * \param chan      the channel the buffer will be moved on
+ * \param ret_buf   returns the buffer holding the data of the block
  */
-errval_t block_cache_lookup(size_t blockid, void **ret_data)
+errval_t block_cache_lookup(size_t blockid, struct bulk_channel *chan,
+                            struct bulk_buffer **ret_buf)
 {
-    assert(!"NYI: block_cache_lookup");
+    if (cache.capacity == 0) {
+        return FS_CACHE_NOTPRESENT;
+    }
+
+    cache.stats.lookups++;
+    if (BLOCK_CACHE_STATS_INTERVAL
+                    && cache.stats.lookups % BLOCK_CACHE_STATS_INTERVAL == 0) {
+        block_cache_print_stats();
+    }
+
+    struct block_cache_entry *e = find_block(blockid);
+    if (e == NULL || e->chan != chan || e->stale) {
+        cache.stats.misses++;
+        // the caller reads the block from storage, which must be current
+        if (e != NULL && e->dirty) {
+            errval_t err = entry_write_back(e);
+            if (err_is_fail(err)) {
+                return err;
+            }
+        }
+        return FS_CACHE_NOTPRESENT;
+    }
+    if (e->lent) {
+        cache.stats.misses++;
+        cache.stats.lent_misses++;
+        return FS_CACHE_NOTPRESENT;
+    }
+
+    // lent entries must be clean
+    if (e->dirty) {
+        errval_t err = entry_write_back(e);
+        if (err_is_fail(err)) {
+            cache.stats.misses++;
+            return err;
+        }
+    }
+
+    e->lent = true;
+    e->referenced = true;
+    cache.stats.hits++;
+
+    *ret_buf = e->buf;
+
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief hands a buffer passed back by a client to the cache
+ *
+ * \returns true if the buffer belongs to the cache, false if it has to go
+ *          back to the buffer store
+ */
+bool block_cache_buffer_returned(struct bulk_buffer *buf)
+{
+    if (cache.capacity == 0) {
+        return false;
+    }
+
+    struct block_cache_entry *e = find_buf(buf);
+    if (e == NULL) {
+        return false;
+    }
+
+    assert(e->lent);
+    e->lent = false;
+    if (e->stale) {
+        entry_drop(e);
+    }
+
+    return true;
+}
+
+/**
+ * \brief writes a block through the cache
+ *
+ * Cached blocks are updated in the cache. In write-back mode, they are
+ * written to the block storage in batches of BLOCK_CACHE_FLUSH_BATCH blocks,
+ * or by the flush timer.
+ *
+ * \param blockid   the ID of the block to write
+ * \param src       the new data of the block
+ */
+errval_t block_cache_write(size_t blockid, void *src)
+{
+    if (cache.capacity == 0) {
+        return block_storage_write(blockid, src);
+    }
+
+    cache.stats.writes++;
+
+    struct block_cache_entry *e = find_block(blockid);
+    if (e == NULL || e->lent || e->stale) {
+        errval_t err = block_storage_write(blockid, src);
+        if (e && err_is_ok(err)) {
+            // the client holds the old data, drop it when it comes back
+            e->stale = true;
+        }
+        return err;
+    }
+
+    memcpy(e->buf->address, src, block_storage_get_block_size());
+    e->referenced = true;
+    cache.stats.write_hits++;
+
+    if (!cache.write_back) {
+        return block_storage_write(blockid, src);
+    }
+
+    if (!e->dirty) {
+        e->dirty = true;
+        cache.ndirty++;
+    }
+    cache.written = true;
+    if (cache.ndirty >= BLOCK_CACHE_FLUSH_BATCH) {
+        return block_cache_flush();
+    }
+
+    return SYS_ERR_OK;
+}
+
+static int entry_cmp_blockid(const void *a, const void *b)
+{
+    const struct block_cache_entry *x = *(struct block_cache_entry * const *) a;
+    const struct block_cache_entry *y = *(struct block_cache_entry * const *) b;
+    return (x->blockid > y->blockid) - (x->blockid < y->blockid);
+}
+
+/**
+ * \brief writes all dirty blocks to the block storage, in block order
+ */
+errval_t block_cache_flush(void)
+{
+    errval_t err = SYS_ERR_OK;
+    size_t n = 0;
+
+    if (cache.ndirty == 0) {
+        return SYS_ERR_OK;
+    }
+
+    for (size_t i = 0; i < cache.capacity; i++) {
+        struct block_cache_entry *e = cache.entries + i;
+        if (e->used && e->dirty) {
+            cache.flush_list[n++] = e;
+        }
+    }
+    qsort(cache.flush_list, n, sizeof(cache.flush_list[0]), entry_cmp_blockid);
+
+    for (size_t i = 0; i < n; i++) {
+        errval_t e_err = entry_write_back(cache.flush_list[i]);
+        if (err_is_fail(e_err)) {
+            err = e_err;
+        }
+    }
+    cache.stats.flushes++;
+
+    return err;
+}
+
+/**
+ * \brief stops the flush timer and writes back all dirty blocks
+ */
+errval_t block_cache_shutdown(void)
+{
+    if (cache.capacity == 0) {
+        return SYS_ERR_OK;
+    }
+
+    if (cache.write_back) {
+        periodic_event_cancel(&cache.flush_timer);
+    }
+
+    return block_cache_flush();
+}
+
+/**
+ * \brief returns the cache statistics
+ */
+void block_cache_get_stats(struct block_cache_stats *stats)
+{
+    *stats = cache.stats;
+}
+
+/**
+ * \brief prints the hit and miss rates of the cache
+ */
+void block_cache_print_stats(void)
+{
+    struct block_cache_stats *s = &cache.stats;
+    uint64_t permille = s->lookups ? (s->hits * 1000) / s->lookups : 0;
+
+    debug_printf("block cache: %" PRIu64 " lookups, %" PRIu64 " hits, %"
+                 PRIu64 " misses (%" PRIu64 " lent), hit rate %" PRIu64
+                 ".%" PRIu64 "%%\n", s->lookups, s->hits, s->misses,
+                 s->lent_misses, permille / 10, permille % 10);
+    debug_printf("block cache: %" PRIu64 " inserts, %" PRIu64 " evictions, %"
+                 PRIu64 " writes (%" PRIu64 " cached), %" PRIu64
+                 " blocks flushed in %" PRIu64 " flushes\n", s->inserts,
+                 s->evictions, s->writes, s->write_hits, s->flushed_blocks,
+                 s->flushes);
+}
 
 struct buffer_list *bl = NULL;
 
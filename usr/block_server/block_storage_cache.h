@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -15,10 +15,42 @@
 #ifndef BLOCK_STORAGE_CACHE_H
 #define BLOCK_STORAGE_CACHE_H
 
-errval_t block_cache_insert(size_t blockid, void *data);
+#include <bulk_transfer/bulk_transfer.h>
+
+struct block_cache_stats
+{
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t lent_misses;       ///< misses because the buffer was lent out
+    uint64_t inserts;
+    uint64_t evictions;
+    uint64_t writes;
+    uint64_t write_hits;
+    uint64_t flushes;
+    uint64_t flushed_blocks;
+};
+
+errval_t block_cache_init(size_t capacity, bool write_back);
+
+errval_t block_cache_insert(size_t blockid, struct bulk_channel *chan,
+                            struct bulk_buffer *buf);
 
 errval_t block_cache_invalidate(size_t blockid);
 
-errval_t block_cache_lookup(size_t blockid, void **ret_data);
+errval_t block_cache_lookup(size_t blockid, struct bulk_channel *chan,
+                            struct bulk_buffer **ret_buf);
+
+bool block_cache_buffer_returned(struct bulk_buffer *buf);
+
+errval_t block_cache_write(size_t blockid, void *src);
+
+errval_t block_cache_flush(void);
+
+errval_t block_cache_shutdown(void);
+
+void block_cache_get_stats(struct block_cache_stats *stats);
+
+void block_cache_print_stats(void);
 
 #endif /* BLOCK_STORAGE_CACHE_H */
@@ -22,6 +22,7 @@
 #include <if/block_service_defs.h>
 
 #include "block_storage.h"
+#include "block_storage_cache.h"
 #include "block_server.h"
 #include "network_client.h"
 #include "local_server.h"
@@ -147,7 +148,7 @@ static void bulk_move_received(struct bulk_channel *channel,
             debug_printf("ERROR: block net write. %s", err_getstring(err));
         }
     } else {
-        err = block_storage_write(bs->block_id, buffer->address);
+        err = block_cache_write(bs->block_id, buffer->address);
         if (err_is_fail(err)) {
             BS_LOCAL_DEBUG("%s", "ERROR: block could not be written");
         }
@@ -188,8 +189,10 @@ static void bulk_buffer_received(struct bulk_channel *channel,
         }
 
     } else {
-        /* put it into the buffer store */
-        block_server_insert_buffer(&bs_bulk_buffers, buffer, channel);
+        /* put it back into the cache or into the buffer store */
+        if (!block_cache_buffer_returned(buffer)) {
+            block_server_insert_buffer(&bs_bulk_buffers, buffer, channel);
+        }
     }
 }
 
@@ -322,9 +325,14 @@ static void rx_read_request(struct block_service_binding *binding,
     assert(meta_data);
 
     for (uint32_t i = 0; i < count; ++i) {
-        /* TODO: specify a pool */
-        struct bulk_buffer *buf = block_server_get_buffer(&bs_bulk_buffers,
-                                                          chan);
+        /* cache hits move the cached buffer without copying */
+        struct bulk_buffer *buf = NULL;
+        bool cached = err_is_ok(block_cache_lookup(start_block + i, chan,
+                                                   &buf));
+        if (!cached) {
+            /* TODO: specify a pool */
+            buf = block_server_get_buffer(&bs_bulk_buffers, chan);
+        }
         if (!buf) {
             debug_printf("ERROR: Has no buffers left...\n");
             send_status_reply(binding, BLOCK_NET_MSG_READ, seqn,
@@ -333,12 +341,16 @@ static void rx_read_request(struct block_service_binding *binding,
             return ;
         }
 
-        err = block_storage_read(start_block + i, buf->address);
-        if (err_is_fail(err)) {
-            debug_printf("ERROR: block id is out of range: %i",
-                         (uint32_t) (start_block + count));
-            send_status_reply(binding, BLOCK_NET_MSG_READ, seqn,
-                    BLOCK_NET_ERR_BLOCK_ID);
+        if (!cached) {
+            err = block_storage_read(start_block + i, buf->address);
+            if (err_is_fail(err)) {
+                debug_printf("ERROR: block id is out of range: %i",
+                             (uint32_t) (start_block + count));
+                send_status_reply(binding, BLOCK_NET_MSG_READ, seqn,
+                        BLOCK_NET_ERR_BLOCK_ID);
+            } else {
+                block_cache_insert(start_block + i, chan, buf);
+            }
         }
         meta_data[i].block_id = start_block + i;
         meta_data[i].req_id = 0; // XXX not available. not used by bs_user.
@@ -507,6 +519,12 @@ errval_t block_local_start(void)
  */
 errval_t block_local_stop(void)
 {
+    // write back the block cache
+    errval_t err = block_cache_shutdown();
+    if (err_is_fail(err)) {
+        return err;
+    }
+
     // set the stop flag.
 
     // tear down all bulk channels
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -304,10 +304,19 @@ void run_test(struct bulk_channel *txc, struct bulk_channel *rxc, void *block_se
     printf("\n\n");
     BS_TEST_CTRL("%s", "Start with Benchmarks (READING)");
 
+    /*
+     * Every run reads the same blocks. With the block cache of the server
+     * enabled (BLOCK_CACHE_SIZE), only the first run misses and the others
+     * are answered from cached buffers. Build the server with
+     * BLOCK_CACHE_SIZE 0 to get the uncached latency. The server prints its
+     * hit and miss rates every BLOCK_CACHE_STATS_INTERVAL lookups.
+     */
     ctl = bench_ctl_init(BENCH_MODE_FIXEDRUNS, 2, BLOCK_BENCH_NUMRUNS);
 
+    uint32_t num_requests;
     do {
         num_read = 0;
+        num_requests = 0;
         BS_TEST_DEBUG("%s", ">>  Starting run");
         wrapper_perform_lwip_work();
         tsc_start = rdtsc();
@@ -326,11 +335,13 @@ void run_test(struct bulk_channel *txc, struct bulk_channel *rxc, void *block_se
                 USER_PANIC_ERR(err, "Failed to move block");
             }
             meta.req_id++;
+            num_requests++;
+            /* the server has only enough buffers for one batch at a time */
             break;
         }
         results[0] = rdtsc() - tsc_start;
 
-        while (num_read < (BLOCK_BENCH_READ_BATCHSIZE * BLOCK_BENCH_NUMBATCH_REQUESTS)) {
+        while (num_read < (BLOCK_BENCH_READ_BATCHSIZE * num_requests)) {
             event_dispatch(rx_chan->waitset);
         }
         results[1] = rdtsc() - tsc_start;
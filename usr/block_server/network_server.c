@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -25,6 +25,7 @@
 #include "network_common.h"
 #include "network_server.h"
 #include "block_storage.h"
+#include "block_storage_cache.h"
 
 #if BULK_NET_BACKEND_PROXY
 #include <bulk_transfer/bulk_allocator.h>
@@ -163,7 +164,7 @@ static void bulk_move_received(struct bulk_channel *channel,
     errval_t err;
 
     struct bs_meta_data *bs_meta = (struct bs_meta_data*) meta;
-    err = block_storage_write(bs_meta->block_id, buffer->address);
+    err = block_cache_write(bs_meta->block_id, buffer->address);
     if (err_is_fail(err)) {
         block_send_status_msg(c, BLOCK_NET_MSG_WRITE, bs_meta->req_id, err);
         debug_printf("Failed to update the block!");
@@ -189,7 +190,9 @@ static void bulk_buffer_received(struct bulk_channel *channel,
         debug_printf("ERROR: failed to return buffer");
     }
 #else
-    block_server_insert_buffer(&bs_bulk_buffers, buffer, channel);
+    if (!block_cache_buffer_returned(buffer)) {
+        block_server_insert_buffer(&bs_bulk_buffers, buffer, channel);
+    }
 #endif
 }
 
@@ -206,7 +209,7 @@ static void bulk_copy_received(struct bulk_channel *channel,
     errval_t err;
 
     struct bs_meta_data *bs_meta = (struct bs_meta_data*) meta;
-    err = block_storage_write(bs_meta->block_id, buffer->address);
+    err = block_cache_write(bs_meta->block_id, buffer->address);
     if (err_is_fail(err)) {
         debug_printf("Failed to update the block!");
     }
@@ -245,12 +248,17 @@ static err_t handle_block_read(struct block_net_service*c,
     assert(meta_data);
 
     for (uint32_t i = 0; i < count; ++i) {
+        bool cached = false;
         /* TODO: specify a pool */
 #if BULK_NET_BACKEND_PROXY
         struct bulk_buffer *buf = bulk_alloc_new_buffer(&allocator_tx);
 #else
-        struct bulk_buffer *buf = block_server_get_buffer(&bs_bulk_buffers,
-                        &c->tx_chan);
+        /* cache hits move the cached buffer without copying */
+        struct bulk_buffer *buf = NULL;
+        cached = err_is_ok(block_cache_lookup(start_block + i, chan, &buf));
+        if (!cached) {
+            buf = block_server_get_buffer(&bs_bulk_buffers, &c->tx_chan);
+        }
 #endif
         if (!buf) {
             debug_printf("ERROR: Has no buffers left...(i=%i)\n", i);
@@ -260,12 +268,19 @@ static err_t handle_block_read(struct block_net_service*c,
             return ERR_BUF;
         }
 
-        err = block_storage_read(start_block + i, buf->address);
-        if (err_is_fail(err)) {
-            debug_printf("ERROR: block id is out of range: %i",
-                         (uint32_t) (start_block + count));
-            block_send_status_msg(c, BLOCK_NET_MSG_READ, reqid,
-                                  BLOCK_NET_ERR_BLOCK_ID);
+        if (!cached) {
+            err = block_storage_read(start_block + i, buf->address);
+            if (err_is_fail(err)) {
+                debug_printf("ERROR: block id is out of range: %i",
+                             (uint32_t) (start_block + count));
+                block_send_status_msg(c, BLOCK_NET_MSG_READ, reqid,
+                                      BLOCK_NET_ERR_BLOCK_ID);
+            }
+#if !BULK_NET_BACKEND_PROXY
+            else {
+                block_cache_insert(start_block + i, chan, buf);
+            }
+#endif
         }
         meta_data[i].block_id = start_block + i;
         meta_data[i].req_id = reqid;
@@ -709,7 +724,7 @@ errval_t block_net_start(void)
     server_running = true;
 
     struct waitset *ws = get_default_waitset();
-    while (true) {
+    while (server_running) {
         err = event_dispatch_non_block(ws);
         if (err != LIB_ERR_NO_EVENT) {
             if (err_is_fail(err)) {
@@ -726,7 +741,7 @@ errval_t block_net_start(void)
          }*/
     }
 
-    return SYS_ERR_OK;
+    return block_cache_shutdown();
 }
 
 /**
@@ -736,6 +751,7 @@ errval_t block_net_stop(void)
 {
     BS_NET_DEBUG_TRACE
 
+    // block_net_start() leaves its loop and writes back the cache
     server_running = false;
     return SYS_ERR_OK;
 }
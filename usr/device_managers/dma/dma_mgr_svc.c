@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014, ETH Zurich. All rights reserved.
+ * Copyright (c) 2014, 2016, ETH Zurich. All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
  * If you do not find this file, copies can be found by writing to:
@@ -222,6 +222,7 @@ static errval_t svc_connect_cb(void *st,
     txq_init(txq, binding, binding->waitset,
              (txq_register_fn_t) binding->register_send,
              sizeof(struct svc_reply_st));
+    txq_set_stats(txq, binding->stats);
 
     binding->st = txq;
 
@@ -0,0 +1,212 @@
+/**
+ * \file
+ * \brief virtio-net card driver: device setup and queue pair management
+ *
+ * The card driver negotiates the features, allocates the virtqueues of all
+ * queue pairs and tells the device how many pairs are in use. It serves the
+ * first pair itself and hands the vrings of the others to queue drivers
+ * (virtio_net_queue), one per core, which connect to <card>_vnetmng.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/nameservice_client.h>
+
+#include <virtio/virtio.h>
+#include <virtio/virtqueue.h>
+#include <virtio/virtio_device.h>
+#include <virtio/virtio_guest.h>
+#include <virtio/devices/virtio_net.h>
+
+#include <if/virtio_net_defs.h>
+
+#include "vnet.h"
+
+/**
+ * \brief initializes the device with the given number of queue pairs
+ *
+ * \param dev           the device structure to initialize
+ * \param service_name  name of the card
+ * \param pairs         number of queue pairs to use. The device may have less.
+ */
+errval_t vnet_device_init(struct vnet_device *dev,
+                          const char *service_name,
+                          uint16_t pairs)
+{
+    errval_t err;
+
+    memset(dev, 0, sizeof(*dev));
+    dev->service_name = service_name;
+
+    if (pairs == 0 || pairs > VIRTIO_NET_MAX_QUEUE_PAIRS) {
+        return VIRTIO_ERR_ARG_INVALID;
+    }
+
+    err = virtio_guest_init(VIRTIO_GUEST_CHAN_FLOUNDER,
+                            VIRTIO_NET_FLOUNDER_IFACE);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = virtio_guest_open_device(VNET_DRIVER_BACKEND, &dev->dev_frame);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct frame_identity id;
+    err = invoke_frame_identify(dev->dev_frame, &id);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    void *dev_regs;
+    err = vspace_map_one_frame_attr(&dev_regs, id.bytes, dev->dev_frame,
+                                    VIRTIO_VREGION_FLAGS_DEVICE, NULL, NULL);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct virtqueue_setup vq_setup[2 * VIRTIO_NET_MAX_QUEUE_PAIRS];
+    memset(vq_setup, 0, sizeof(vq_setup));
+
+    for (uint16_t i = 0; i < 2 * pairs; ++i) {
+        snprintf(vq_setup[i].name, sizeof(vq_setup[i].name), "%s Virtqueue %u",
+                 (i & 1) ? "TX" : "RX", i / 2);
+        vq_setup[i].vring_ndesc = VNET_NDESC;
+        vq_setup[i].vring_align = VIRTQUEUE_ALIGNMENT;
+        vq_setup[i].header_bits = VNET_HEADER_BITS;
+        vq_setup[i].auto_add = 1;
+    }
+
+    struct virtio_device_setup setup = {
+        .dev_name = "VirtIO Network Device",
+        .backend = {
+            .type = VNET_DRIVER_BACKEND,
+            .args.mmio = {
+                .dev_base = dev_regs,
+                .dev_size = id.bytes
+            }
+        },
+        .features = VNET_DRIVER_FEATURES,
+        .dev_type = VIRTIO_DEVICE_TYPE_NET,
+        .dev_cap = dev->dev_frame,
+        .vq_setup = vq_setup,
+        .vq_num = 2 * pairs
+    };
+
+    err = virtio_net_init_device(&dev->net, &setup);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    /* the device only steers packets to the first pair until we tell it */
+    err = virtio_net_set_queue_pairs(&dev->net, dev->net.num_pairs);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    /* the card driver serves the first pair */
+    dev->queue_taken[0] = true;
+
+    VNET_DEBUG("device ready with %u of %u queue pairs\n", dev->net.num_pairs,
+               dev->net.max_pairs);
+
+    return SYS_ERR_OK;
+}
+
+/******************************************************************************/
+/* Management interface implemetation */
+
+static void idc_request_queue(struct virtio_net_binding *b,
+                              uint16_t pair)
+{
+    errval_t err, msgerr = SYS_ERR_OK;
+    struct vnet_device *dev = b->st;
+    struct capref rx_vring = NULL_CAP, tx_vring = NULL_CAP;
+
+    VNET_DEBUG("queue driver requests pair %u\n", pair);
+
+    if (pair >= dev->net.num_pairs || dev->queue_taken[pair]) {
+        msgerr = VIRTIO_ERR_QUEUE_INVALID;
+    } else {
+        dev->queue_taken[pair] = true;
+        virtio_virtqueue_get_vring_cap(dev->net.rx_vq[pair], &rx_vring);
+        virtio_virtqueue_get_vring_cap(dev->net.tx_vq[pair], &tx_vring);
+    }
+
+    err = virtio_net_queue_init_data__tx(b, NOP_CONT, msgerr, dev->dev_frame,
+                                         rx_vring, tx_vring, VNET_NDESC,
+                                         dev->net.vdev->features,
+                                         virtio_net_get_mac(&dev->net));
+    // TODO: handle busy
+    assert(err_is_ok(err));
+}
+
+static void idc_terminate_queue(struct virtio_net_binding *b,
+                                uint16_t pair)
+{
+    errval_t err;
+    struct vnet_device *dev = b->st;
+
+    VNET_DEBUG("queue driver terminates pair %u\n", pair);
+
+    /*
+     * the device keeps steering packets to the pair, they are dropped once
+     * its receive ring is empty
+     */
+    if (pair < dev->net.num_pairs) {
+        dev->queue_taken[pair] = false;
+    }
+
+    err = virtio_net_queue_terminated__tx(b, NOP_CONT);
+    // TODO: handle busy
+    assert(err_is_ok(err));
+}
+
+static struct virtio_net_rx_vtbl rx_vtbl = {
+    .request_queue = idc_request_queue,
+    .terminate_queue = idc_terminate_queue,
+};
+
+static void export_cb(void *st, errval_t err, iref_t iref)
+{
+    struct vnet_device *dev = st;
+    char name[strlen(dev->service_name) + strlen(VNET_MNG_SUFFIX) + 1];
+
+    assert(err_is_ok(err));
+
+    // Build label for interal management service
+    sprintf(name, "%s%s", dev->service_name, VNET_MNG_SUFFIX);
+
+    err = nameservice_register(name, iref);
+    assert(err_is_ok(err));
+    VNET_DEBUG("Management interface exported as %s\n", name);
+}
+
+static errval_t connect_cb(void *st, struct virtio_net_binding *b)
+{
+    VNET_DEBUG("New connection on management interface\n");
+    b->rx_vtbl = rx_vtbl;
+    b->st = st;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief exports the management interface for the queue drivers
+ */
+errval_t vnet_device_export(struct vnet_device *dev)
+{
+    return virtio_net_export(dev, export_cb, connect_cb, get_default_waitset(),
+                             IDC_EXPORT_FLAGS_DEFAULT);
+}
@@ -1,10 +1,15 @@
 /**
  * \file
- * \brief Driver for booting the Xeon Phi Coprocessor card on a Barrelfish Host
+ * \brief virtio-net card driver
+ *
+ *   virtio_net [cardname=NAME] [queues=N]
+ *
+ * Serves the first queue pair. The others are served by virtio_net_queue
+ * domains started with the same cardname and queue=1..N-1.
  */
 
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -12,4 +17,77 @@
  * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
  */
 
+#include <stdio.h>
+#include <string.h>
+
+#include <barrelfish/barrelfish.h>
+#include <net_queue_manager/net_queue_manager.h>
+
+#include <virtio/virtio.h>
+#include <virtio/virtqueue.h>
+#include <virtio/virtio_device.h>
+#include <virtio/devices/virtio_net.h>
+
+#include "vnet.h"
+
+static struct vnet_device vnet_dev;
+
+static const char *service_name = "vnet";
+
+static uint16_t num_queues = 1;
+
+static void parse_cmdline(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "cardname=", strlen("cardname=")) == 0) {
+            service_name = argv[i] + strlen("cardname=");
+        } else if (strncmp(argv[i], "queues=", strlen("queues=")) == 0) {
+            num_queues = atoi(argv[i] + strlen("queues="));
+        } else {
+            ethersrv_argument(argv[i]);
+        }
+    }
+}
+
+static void terminate_queue(void)
+{
+    debug_printf("VirtIO network device driver terminated.\n");
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    errval_t err;
+
+    debug_printf("VirtIO network device driver started.\n");
+
+    parse_cmdline(argc, argv);
+
+    err = vnet_device_init(&vnet_dev, service_name, num_queues);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "initializing the device failed\n");
+    }
+
+    if (vnet_dev.net.num_pairs < num_queues) {
+        debug_printf("device has only %u queue pairs\n",
+                     vnet_dev.net.num_pairs);
+    }
+
+    err = vnet_device_export(&vnet_dev);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "exporting the management interface failed\n");
+    }
+
+    err = vnet_queue_init(0, vnet_dev.net.rx_vq[0], vnet_dev.net.tx_vq[0],
+                          vnet_dev.net.vdev->features,
+                          virtio_net_get_mac(&vnet_dev.net));
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "initializing the first queue pair failed\n");
+    }
+
+    vnet_queue_start(service_name, terminate_queue);
+
+    vnet_queue_eventloop();
 
+    return 0;
+}
@@ -0,0 +1,225 @@
+/**
+ * \file
+ * \brief virtio-net queue driver
+ *
+ *   virtio_net_queue cardname=NAME queue=N
+ *
+ * Serves queue pair N of a multi-queue virtio-net device. The virtqueues are
+ * allocated by the card driver (virtio_net), which hands out the vrings over
+ * the <card>_vnetmng interface.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/nameservice_client.h>
+#include <net_queue_manager/net_queue_manager.h>
+
+#include <virtio/virtio.h>
+#include <virtio/virtqueue.h>
+#include <virtio/virtio_device.h>
+#include <virtio/devices/virtio_net.h>
+
+#include <if/virtio_net_defs.h>
+
+#include "vnet.h"
+
+static const char *service_name = "vnet";
+
+static int32_t pair = -1;
+
+static struct virtio_net_binding *binding;
+
+static struct virtio_device_net vnet_dev;
+
+static void terminate_queue(void)
+{
+    errval_t err;
+
+    err = virtio_net_terminate_queue__tx(binding, NOP_CONT, pair);
+    // TODO: handle busy
+    assert(err_is_ok(err));
+}
+
+static void idc_queue_terminated(struct virtio_net_binding *b)
+{
+    debug_printf("VirtIO network queue %d terminated.\n", pair);
+    exit(0);
+}
+
+static errval_t queue_attach(struct capref registers,
+                             struct capref rx_vring,
+                             struct capref tx_vring,
+                             uint16_t ndesc,
+                             uint64_t features)
+{
+    errval_t err;
+
+    struct frame_identity id;
+    err = invoke_frame_identify(registers, &id);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    void *dev_regs;
+    err = vspace_map_one_frame_attr(&dev_regs, id.bytes, registers,
+                                    VIRTIO_VREGION_FLAGS_DEVICE, NULL, NULL);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct virtio_device_setup setup = {
+        .dev_name = "VirtIO Network Queue",
+        .backend = {
+            .type = VNET_DRIVER_BACKEND,
+            .args.mmio = {
+                .dev_base = dev_regs,
+                .dev_size = id.bytes
+            }
+        },
+        .dev_type = VIRTIO_DEVICE_TYPE_NET,
+        .dev_cap = registers,
+        .dev_t_st = &vnet_dev
+    };
+
+    /* the card driver has configured the device already */
+    err = virtio_device_attach(&vnet_dev.vdev, &setup, features);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct virtqueue_setup vq_setup = {
+        .device = vnet_dev.vdev,
+        .vring_ndesc = ndesc,
+        .vring_align = VIRTQUEUE_ALIGNMENT,
+        .header_bits = VNET_HEADER_BITS,
+        .auto_add = 0
+    };
+
+    snprintf(vq_setup.name, sizeof(vq_setup.name), "RX Virtqueue %u", pair);
+    vq_setup.queue_id = virtio_net_rx_queue_index(pair);
+    err = virtio_virtqueue_alloc_with_caps(&vq_setup, rx_vring,
+                                           &vnet_dev.rx_vq[pair]);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    snprintf(vq_setup.name, sizeof(vq_setup.name), "TX Virtqueue %u", pair);
+    vq_setup.queue_id = virtio_net_tx_queue_index(pair);
+    err = virtio_virtqueue_alloc_with_caps(&vq_setup, tx_vring,
+                                           &vnet_dev.tx_vq[pair]);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    vnet_dev.num_pairs = pair + 1;
+
+    return SYS_ERR_OK;
+}
+
+static void idc_queue_init_data(struct virtio_net_binding *b,
+                                errval_t msgerr,
+                                struct capref registers,
+                                struct capref rx_vring,
+                                struct capref tx_vring,
+                                uint16_t ndesc,
+                                uint64_t features,
+                                uint64_t macaddr)
+{
+    errval_t err;
+
+    if (err_is_fail(msgerr)) {
+        USER_PANIC_ERR(msgerr, "card driver refused queue pair %d\n", pair);
+    }
+
+    err = queue_attach(registers, rx_vring, tx_vring, ndesc, features);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "attaching to the virtqueues failed\n");
+    }
+
+    err = vnet_queue_init(pair, vnet_dev.rx_vq[pair], vnet_dev.tx_vq[pair],
+                          features, macaddr);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "initializing queue pair %d failed\n", pair);
+    }
+
+    vnet_queue_start(service_name, terminate_queue);
+}
+
+static struct virtio_net_rx_vtbl rx_vtbl = {
+    .queue_init_data = idc_queue_init_data,
+    .queue_terminated = idc_queue_terminated,
+};
+
+static void bind_cb(void *st, errval_t err, struct virtio_net_binding *b)
+{
+    assert(err_is_ok(err));
+
+    VNET_DEBUG("Bound to management interface\n");
+
+    b->rx_vtbl = rx_vtbl;
+    binding = b;
+
+    err = virtio_net_request_queue__tx(b, NOP_CONT, pair);
+    // TODO: handle busy
+    assert(err_is_ok(err));
+}
+
+static void connect_to_mngif(void)
+{
+    errval_t err;
+    iref_t iref;
+    char name[strlen(service_name) + strlen(VNET_MNG_SUFFIX) + 1];
+
+    sprintf(name, "%s%s", service_name, VNET_MNG_SUFFIX);
+
+    VNET_DEBUG("Looking up management interface (%s)\n", name);
+    err = nameservice_blocking_lookup(name, &iref);
+    assert(err_is_ok(err));
+
+    err = virtio_net_bind(iref, bind_cb, NULL, get_default_waitset(),
+                          IDC_BIND_FLAGS_DEFAULT);
+    assert(err_is_ok(err));
+}
+
+static void parse_cmdline(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "cardname=", strlen("cardname=")) == 0) {
+            service_name = argv[i] + strlen("cardname=");
+        } else if (strncmp(argv[i], "queue=", strlen("queue=")) == 0) {
+            pair = atoi(argv[i] + strlen("queue="));
+        } else {
+            ethersrv_argument(argv[i]);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    debug_printf("VirtIO network queue driver started.\n");
+
+    parse_cmdline(argc, argv);
+
+    /* the first pair belongs to the card driver */
+    if (pair < 1 || pair >= VIRTIO_NET_MAX_QUEUE_PAIRS) {
+        USER_PANIC("invalid queue pair, use queue=1..%u\n",
+                   VIRTIO_NET_MAX_QUEUE_PAIRS - 1);
+    }
+
+    connect_to_mngif();
+
+    vnet_queue_eventloop();
+
+    return 0;
+}
@@ -0,0 +1,431 @@
+/**
+ * \file
+ * \brief Data path of a virtio-net queue pair for the network queue manager
+ *
+ * The queue polls its virtqueues. The used rings are processed in batches,
+ * and the device is notified once per batch of posted receive buffers or
+ * queued packets instead of once per buffer. With VIRTIO_RING_F_EVENT_IDX
+ * the notification is skipped if the device is still processing the ring.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <barrelfish/barrelfish.h>
+#include <net_queue_manager/net_queue_manager.h>
+
+#include <virtio/virtio.h>
+#include <virtio/virtqueue.h>
+#include <virtio/devices/virtio_net.h>
+
+#include "vnet.h"
+
+/// a receive buffer posted to the device: virtio-net header and packet
+struct vnet_rx_slot
+{
+    struct virtio_buffer_list bl;
+    struct virtio_buffer hdr;
+    struct virtio_buffer data;
+    void *opaque;
+    struct vnet_rx_slot *next;
+};
+
+/// a packet handed to the device: virtio-net header and packet chunks
+struct vnet_tx_slot
+{
+    struct virtio_buffer_list bl;
+    struct virtio_buffer hdr;
+    struct virtio_buffer data[MAX_CHUNKS];
+    void *opaque[MAX_CHUNKS];
+    size_t count;
+    struct vnet_tx_slot *next;
+};
+
+static struct vnet_queue
+{
+    uint16_t pair;
+    uint64_t macaddr;
+    size_t hdr_size;            ///< virtio-net header for the features
+    bool initialized;
+
+    struct virtqueue *rxq;
+    struct vnet_rx_slot *rx_slots;
+    struct vnet_rx_slot *rx_free;
+    size_t rx_free_count;
+    uint16_t rx_posted;         ///< buffers posted since the last notify
+
+    struct virtqueue *txq;
+    struct vnet_tx_slot *tx_slots;
+    struct vnet_tx_slot *tx_free;
+    size_t tx_free_count;
+    uint16_t tx_queued;         ///< packets queued since the last notify
+
+    /* sent packets whose buffers are not yet returned to the queue manager */
+    struct vnet_tx_slot *tx_done_head;
+    struct vnet_tx_slot *tx_done_tail;
+
+    void (*terminate_fn)(void);
+} q;
+
+/******************************************************************************/
+/* Transmit path */
+
+/** Moves the sent packets from the used ring to the done list */
+static void tx_reap(void)
+{
+    struct virtqueue_used used[VNET_USED_BATCH];
+    uint16_t num;
+
+    do {
+        num = virtio_virtqueue_desc_dequeue_batch(q.txq, used, VNET_USED_BATCH);
+        for (uint16_t i = 0; i < num; ++i) {
+            struct vnet_tx_slot *slot = used[i].st;
+            slot->next = NULL;
+            if (q.tx_done_tail) {
+                q.tx_done_tail->next = slot;
+            } else {
+                q.tx_done_head = slot;
+            }
+            q.tx_done_tail = slot;
+        }
+    } while (num == VNET_USED_BATCH);
+}
+
+static void tx_flush(void)
+{
+    if (q.tx_queued) {
+        virtio_virtqueue_notify_host(q.txq);
+        q.tx_queued = 0;
+    }
+}
+
+static errval_t transmit_pbuf_list_fn(struct driver_buffer *buffers,
+                                      size_t count)
+{
+    errval_t err;
+
+    assert(count <= MAX_CHUNKS);
+
+    if (q.tx_free == NULL
+                    || virtio_virtqueue_get_num_free(q.txq) < count + 1) {
+        tx_reap();
+        if (q.tx_free == NULL
+                        || virtio_virtqueue_get_num_free(q.txq) < count + 1) {
+            return ETHERSRV_ERR_CANT_TRANSMIT;
+        }
+    }
+
+    struct vnet_tx_slot *slot = q.tx_free;
+    q.tx_free = slot->next;
+    q.tx_free_count--;
+
+    /* the chain of the previous packet of this slot */
+    while (virtio_blist_head(&slot->bl) != NULL) {
+    }
+
+    err = virtio_blist_append(&slot->bl, &slot->hdr);
+    assert(err_is_ok(err));
+
+    for (size_t i = 0; i < count; i++) {
+        slot->data[i].paddr = buffers[i].pa;
+        slot->data[i].buf = buffers[i].va;
+        slot->data[i].length = buffers[i].len;
+        slot->opaque[i] = buffers[i].opaque;
+        err = virtio_blist_append(&slot->bl, &slot->data[i]);
+        assert(err_is_ok(err));
+    }
+    slot->count = count;
+
+    err = virtio_virtqueue_desc_enqueue(q.txq, &slot->bl, slot, 0, count + 1);
+    if (err_is_fail(err)) {
+        slot->next = q.tx_free;
+        q.tx_free = slot;
+        q.tx_free_count++;
+        return err;
+    }
+
+    if (++q.tx_queued >= VNET_TX_KICK_BATCH) {
+        tx_flush();
+    }
+
+    return SYS_ERR_OK;
+}
+
+static uint64_t find_tx_free_slot_count_fn(void)
+{
+    return q.tx_free_count;
+}
+
+static bool handle_free_tx_slot_fn(void)
+{
+    if (q.tx_done_head == NULL) {
+        tx_reap();
+        if (q.tx_done_head == NULL) {
+            return false;
+        }
+    }
+
+    struct vnet_tx_slot *slot = q.tx_done_head;
+    q.tx_done_head = slot->next;
+    if (q.tx_done_head == NULL) {
+        q.tx_done_tail = NULL;
+    }
+
+    for (size_t i = 0; i < slot->count; i++) {
+        handle_tx_done(slot->opaque[i]);
+    }
+
+    slot->next = q.tx_free;
+    q.tx_free = slot;
+    q.tx_free_count++;
+
+    return true;
+}
+
+/******************************************************************************/
+/* Receive path */
+
+static void rx_flush(void)
+{
+    if (q.rx_posted) {
+        virtio_virtqueue_notify_host(q.rxq);
+        q.rx_posted = 0;
+    }
+}
+
+static errval_t register_rx_buffer_fn(uint64_t paddr, void *vaddr,
+                                      void *opaque)
+{
+    errval_t err;
+
+    struct vnet_rx_slot *slot = q.rx_free;
+    if (slot == NULL) {
+        return ETHERSRV_ERR_NOT_ENOUGH_MEM;
+    }
+
+    slot->data.paddr = paddr;
+    slot->data.buf = vaddr;
+    slot->opaque = opaque;
+
+    err = virtio_virtqueue_desc_enqueue(q.rxq, &slot->bl, slot, 2, 0);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    q.rx_free = slot->next;
+    q.rx_free_count--;
+
+    if (++q.rx_posted >= VNET_RX_REFILL_BATCH) {
+        rx_flush();
+    }
+
+    return SYS_ERR_OK;
+}
+
+static uint64_t find_rx_free_slot_count_fn(void)
+{
+    return q.rx_free_count;
+}
+
+static size_t check_for_new_packets(void)
+{
+    struct virtqueue_used used[VNET_USED_BATCH];
+    size_t count = 0;
+    uint16_t num;
+
+    do {
+        num = virtio_virtqueue_desc_dequeue_batch(q.rxq, used, VNET_USED_BATCH);
+        for (uint16_t i = 0; i < num; ++i) {
+            struct vnet_rx_slot *slot = used[i].st;
+            assert(used[i].length >= q.hdr_size);
+
+            struct driver_rx_buffer buf = {
+                .len = used[i].length - q.hdr_size,
+                .opaque = slot->opaque
+            };
+
+            slot->next = q.rx_free;
+            q.rx_free = slot;
+            q.rx_free_count++;
+
+            process_received_packet(&buf, 1, 0);
+        }
+        count += num;
+    } while (num == VNET_USED_BATCH);
+
+    return count;
+}
+
+/******************************************************************************/
+/* Initialization */
+
+/**
+ * Callback to pass MAC address to queue manager library.
+ */
+static void get_mac_addr_fn(uint8_t *mac)
+{
+    memcpy(mac, &q.macaddr, 6);
+}
+
+static void terminate_queue_fn(void)
+{
+    if (q.terminate_fn) {
+        q.terminate_fn();
+    }
+}
+
+/**
+ * \brief sets up the receive and transmit slots of the queue pair
+ *
+ * \param pair      index of the queue pair
+ * \param rxq       receive virtqueue, allocated with VNET_HEADER_BITS
+ * \param txq       transmit virtqueue, allocated with VNET_HEADER_BITS
+ * \param features  features negotiated with the device
+ * \param macaddr   MAC address of the device
+ */
+errval_t vnet_queue_init(uint16_t pair,
+                         struct virtqueue *rxq,
+                         struct virtqueue *txq,
+                         uint64_t features,
+                         uint64_t macaddr)
+{
+    errval_t err;
+
+    memset(&q, 0, sizeof(q));
+    q.pair = pair;
+    q.macaddr = macaddr;
+    q.hdr_size = vnet_hdr_size(features);
+    q.rxq = rxq;
+    q.txq = txq;
+
+    lvaddr_t rx_hdr, tx_hdr;
+    lpaddr_t rx_hdr_phys, tx_hdr_phys;
+
+    err = virtio_virtqueue_get_headers(rxq, &rx_hdr, &rx_hdr_phys);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    err = virtio_virtqueue_get_headers(txq, &tx_hdr, &tx_hdr_phys);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    /* every packet takes a header and at least one data descriptor */
+    size_t rx_slots = virtio_virtqueue_get_num_desc(rxq) / 2;
+    size_t tx_slots = virtio_virtqueue_get_num_desc(txq) / 2;
+
+    q.rx_slots = calloc(rx_slots, sizeof(struct vnet_rx_slot));
+    q.tx_slots = calloc(tx_slots, sizeof(struct vnet_tx_slot));
+    if (q.rx_slots == NULL || q.tx_slots == NULL) {
+        free(q.rx_slots);
+        free(q.tx_slots);
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    for (size_t i = 0; i < rx_slots; i++) {
+        struct vnet_rx_slot *slot = &q.rx_slots[i];
+        size_t offset = i << VNET_HEADER_BITS;
+
+        slot->hdr.state = VIRTIO_BUFFER_S_ALLOCED;
+        slot->hdr.paddr = rx_hdr_phys + offset;
+        slot->hdr.buf = (void *) (rx_hdr + offset);
+        slot->hdr.length = q.hdr_size;
+
+        slot->data.state = VIRTIO_BUFFER_S_ALLOCED;
+        slot->data.length = VNET_RXBUFSZ;
+
+        /* the chain stays the same, only the packet buffer changes */
+        virtio_blist_init(&slot->bl);
+        virtio_blist_append(&slot->bl, &slot->hdr);
+        virtio_blist_append(&slot->bl, &slot->data);
+
+        slot->next = q.rx_free;
+        q.rx_free = slot;
+    }
+    q.rx_free_count = rx_slots;
+
+    for (size_t i = 0; i < tx_slots; i++) {
+        struct vnet_tx_slot *slot = &q.tx_slots[i];
+        size_t offset = i << VNET_HEADER_BITS;
+
+        /* no offloads: the header stays zero */
+        memset((void *) (tx_hdr + offset), 0, sizeof(struct virtio_net_hdr));
+
+        slot->hdr.state = VIRTIO_BUFFER_S_ALLOCED;
+        slot->hdr.paddr = tx_hdr_phys + offset;
+        slot->hdr.buf = (void *) (tx_hdr + offset);
+        slot->hdr.length = q.hdr_size;
+
+        for (size_t j = 0; j < MAX_CHUNKS; j++) {
+            slot->data[j].state = VIRTIO_BUFFER_S_ALLOCED;
+        }
+        virtio_blist_init(&slot->bl);
+
+        slot->next = q.tx_free;
+        q.tx_free = slot;
+    }
+    q.tx_free_count = tx_slots;
+
+    /* we poll */
+    virtio_virtqueue_intr_disable(rxq);
+    virtio_virtqueue_intr_disable(txq);
+
+    VNET_DEBUG("queue pair %u: %zu rx slots, %zu tx slots\n", pair, rx_slots,
+               tx_slots);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief registers the queue pair with the queue manager library
+ */
+void vnet_queue_start(const char *service_name,
+                      void (*terminate_fn)(void))
+{
+    q.terminate_fn = terminate_fn;
+    q.initialized = true;
+
+    ethersrv_init((char *) service_name, q.pair, get_mac_addr_fn,
+                  terminate_queue_fn, transmit_pbuf_list_fn,
+                  find_tx_free_slot_count_fn, handle_free_tx_slot_fn,
+                  VNET_RXBUFSZ, register_rx_buffer_fn,
+                  find_rx_free_slot_count_fn);
+}
+
+/**
+ * \brief processes the used rings and notifies the device about the
+ *        buffers posted and packets queued since the last call
+ */
+void vnet_queue_poll(void)
+{
+    if (!q.initialized) {
+        return;
+    }
+
+    check_for_new_packets();
+    while (handle_free_tx_slot_fn()) {
+    }
+
+    rx_flush();
+    tx_flush();
+}
+
+void vnet_queue_eventloop(void)
+{
+    struct waitset *ws = get_default_waitset();
+
+    while (1) {
+        event_dispatch_non_block(ws);
+        do_pending_work_for_all();
+        vnet_queue_poll();
+    }
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef VNET_H_
+#define VNET_H_
+
+#include <stddef.h>
+
+#include <virtio/virtio.h>
+#include <virtio/virtqueue.h>
+#include <virtio/devices/virtio_net.h>
+
+#define VNET_DRIVER_BACKEND VIRTIO_DEVICE_BACKEND_MMIO
+
+#define VNET_DRIVER_FEATURES ((1UL << VIRTIO_NET_F_MAC)            \
+                              | (1UL << VIRTIO_NET_F_STATUS)       \
+                              | (1UL << VIRTIO_NET_F_CTRL_VQ)      \
+                              | (1UL << VIRTIO_NET_F_MQ)           \
+                              | (1UL << VIRTIO_RING_F_EVENT_IDX)   \
+                              | (1UL << VIRTIO_F_VERSION_1))
+
+/**
+ * \brief size of the virtio-net header for the negotiated features
+ *
+ * Legacy devices omit num_buffers unless VIRTIO_NET_F_MRG_RXBUF is used.
+ */
+static inline size_t vnet_hdr_size(uint64_t features)
+{
+    if (features & ((1UL << VIRTIO_F_VERSION_1)
+                    | (1UL << VIRTIO_NET_F_MRG_RXBUF))) {
+        return sizeof(struct virtio_net_hdr);
+    }
+    return offsetof(struct virtio_net_hdr, num_buffers);
+}
+
+/// suffix of the queue management service of the card
+#define VNET_MNG_SUFFIX "_vnetmng"
+
+/// number of descriptors of the receive and transmit vrings
+#define VNET_NDESC 256
+
+/// every packet uses one descriptor for the virtio-net header
+#define VNET_HEADER_BITS 4
+
+/// size of the receive buffers
+#define VNET_RXBUFSZ 2048
+
+/// maximum number of used ring elements processed at once
+#define VNET_USED_BATCH 32
+
+/// receive buffers posted before the device is notified
+#define VNET_RX_REFILL_BATCH 16
+
+/// packets queued before the device is notified
+#define VNET_TX_KICK_BATCH 16
+
+#define VNET_DEBUG_ENABLED 0
+
+#if VNET_DEBUG_ENABLED
+#define VNET_DEBUG(x...) debug_printf("[vnet] " x)
+#else
+#define VNET_DEBUG(x...)
+#endif
+
+/**
+ * the device as owned by the card driver
+ */
+struct vnet_device
+{
+    struct virtio_device_net net;
+    struct capref dev_frame;            ///< device registers
+    const char *service_name;           ///< name of the card
+    bool queue_taken[VIRTIO_NET_MAX_QUEUE_PAIRS];
+};
+
+/*
+ * Card driver (device.c)
+ */
+
+errval_t vnet_device_init(struct vnet_device *dev,
+                          const char *service_name,
+                          uint16_t pairs);
+
+errval_t vnet_device_export(struct vnet_device *dev);
+
+/*
+ * Queue pair data path (queue.c), one pair per domain
+ */
+
+errval_t vnet_queue_init(uint16_t pair,
+                         struct virtqueue *rxq,
+                         struct virtqueue *txq,
+                         uint64_t features,
+                         uint64_t macaddr);
+
+void vnet_queue_start(const char *service_name,
+                      void (*terminate_fn)(void));
+
+void vnet_queue_poll(void);
+
+void vnet_queue_eventloop(void);
+
+#endif /* VNET_H_ */
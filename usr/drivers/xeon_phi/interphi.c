@@ -6,7 +6,7 @@
  */
 
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -900,6 +900,7 @@ static void interphi_bind_cb(void *st,
     txq_init(&node->msg->queue, _binding, _binding->waitset,
              (txq_register_fn_t) _binding->register_send,
              sizeof(struct interphi_msg_st));
+    txq_set_stats(&node->msg->queue, _binding->stats);
 
     node->state = XNODE_STATE_READY;
 }
@@ -920,6 +921,7 @@ static void interphi_connect_cb(void *st,
     txq_init(&node->msg->queue, _binding, _binding->waitset,
              (txq_register_fn_t) _binding->register_send,
              sizeof(struct interphi_msg_st));
+    txq_set_stats(&node->msg->queue, _binding->stats);
 
     node->state = XNODE_STATE_READY;
 }
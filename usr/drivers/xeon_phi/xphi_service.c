@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 ETH Zurich.
+ * Copyright (c) 2014, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -492,6 +492,7 @@ static errval_t xphi_svc_connect_cb(void *st,
     txq_init(&svc_st->queue, binding, binding->waitset,
              (txq_register_fn_t) binding->register_send,
              sizeof(struct xphi_svc_msg_st));
+    txq_set_stats(&svc_st->queue, binding->stats);
 
     binding->st = svc_st;
     binding->rx_vtbl = xphi_svc_rx_vtbl;
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, 2011, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -278,9 +278,18 @@ static void mem_allocate_handler(struct mem_binding *b, uint8_t bits,
     } else {
         // DEBUG_ERR(ret, "allocation of %d bits in % " PRIxGENPADDR "-%" PRIxGENPADDR " failed",
         //          bits, minbase, maxlimit);
+        trace_event(TRACE_SUBSYS_MEMSERV, TRACE_EVENT_MEMSERV_ALLOC_FAIL, bits);
         *cap = NULL_CAP;
     }
 
+    /* memory still available for large and huge pages, in MB */
+    trace_event(TRACE_SUBSYS_MEMSERV, TRACE_EVENT_MEMSERV_FREE_LARGE,
+                mm_free_bytes_at_least(&mm_ram, LARGE_PAGE_BITS) >> 20);
+#ifdef HUGE_PAGE_BITS
+    trace_event(TRACE_SUBSYS_MEMSERV, TRACE_EVENT_MEMSERV_FREE_HUGE,
+                mm_free_bytes_at_least(&mm_ram, HUGE_PAGE_BITS) >> 20);
+#endif
+
     /* Reply */
     err = b->tx_vtbl.allocate_response(b, MKCONT(allocate_response_done, cap),
                                        ret, *cap);
@@ -416,6 +425,10 @@ initialize_ram_alloc(void)
                 slot_alloc_prealloc, &ram_slot_alloc, true);
     assert(err_is_ok(err));
 
+    /* serve small requests from already split regions, keeping large aligned
+     * regions for large and huge pages */
+    mm_set_placement(&mm_ram, MM_PLACEMENT_BEST_FIT);
+
     /* give MM allocator static storage to get it started */
     static char nodebuf[SLAB_STATIC_SIZE(MINSPARENODES, MM_NODE_SIZE(MAXCHILDBITS))];
     slab_grow(&mm_ram.slabs, nodebuf, sizeof(nodebuf));
@@ -476,6 +489,7 @@ initialize_ram_alloc(void)
 
     printf("RAM allocator initialised, %zd MB (of %zd MB) available\n",
            mem_avail / 1024 / 1024, mem_total / 1024 / 1024);
+    mm_print_stats(&mm_ram);
 
     return SYS_ERR_OK;
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012 ETH Zurich.
+ * Copyright (c) 2012, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -7,6 +7,7 @@
  * ETH Zurich D-INFK, Haldeneggsteig 4, CH-8092 Zurich. Attn: Systems Group.
  */
 
+#include <string.h>
 #include <barrelfish/barrelfish.h>
 #include "capsend.h"
 #include "monitor.h"
@@ -60,15 +61,76 @@ capsend_owner(struct domcapref capref, struct msg_queue_elem *queue_elem)
  * Multicast helpers {{{2
  */
 
+/*
+ * Multicasts are relayed along a tree. The children of a node are the first
+ * hops towards the destinations in its subtree, as given by the multihop
+ * routing table (see multihop_support.c), so the tree follows the topology
+ * that the routing table set-up dispatcher derived from the SKB. Without a
+ * routing table every destination is a first hop, and the destinations are
+ * grouped into CAPSEND_MC_FANOUT subtrees by core id. Every node performs the
+ * operation, collects the results of its children and sends one combined
+ * result to its parent. Define CAPSEND_MC_FANOUT as 0 for a flat multicast.
+ */
+#ifndef CAPSEND_MC_FANOUT
+#define CAPSEND_MC_FANOUT 4
+#endif
+
 struct capsend_mc_msg_st;
 struct capsend_mc_st;
 
-typedef errval_t (*capsend_mc_send_cont_t)(struct intermon_binding*, struct capsend_mc_st*);
-
 struct capsend_mc_msg_st {
     struct intermon_msg_queue_elem queue_elem;
     struct capsend_mc_st *mc_st;
     coreid_t dest;
+    coreid_t *dests;        ///< the subtree of dest, freed once sent
+    size_t count;
+};
+
+struct capsend_mc_relay_st {
+    struct capsend_mc_st mc_st;
+    bool any;               ///< result is ok if any core reports ok
+    errval_t status;        ///< combined result of the subtree
+    coreid_t core;          ///< core that reported the result
+    coreid_t parent;
+    genvaddr_t parent_st;
+};
+
+static void find_cap__rx(coreid_t from, intermon_caprep_t *caprep,
+                         genvaddr_t st, struct capsend_mc_st *relay);
+static void find_cap_result__rx(struct capsend_mc_st *mc_st, errval_t result,
+                                coreid_t core);
+static void find_descendants__rx(coreid_t from, intermon_caprep_t *caprep,
+                                 genvaddr_t st, struct capsend_mc_st *relay);
+static void find_descendants_result__rx(struct capsend_mc_st *mc_st,
+                                        errval_t status, coreid_t core);
+static void update_owner__rx(coreid_t from, intermon_caprep_t *caprep,
+                             genvaddr_t st, struct capsend_mc_st *relay);
+static void owner_updated__rx(struct capsend_mc_st *mc_st, errval_t status,
+                              coreid_t core);
+
+static const struct {
+    capsend_mc_deliver_fn deliver;  ///< performs the operation on a core
+    capsend_mc_result_fn result;    ///< handles replies on the origin
+    bool any;                       ///< how results are combined
+} capsend_mc_ops[CAPSEND_MC_OP_COUNT] = {
+    [CAPSEND_MC_FIND_CAP] = {
+        find_cap__rx, find_cap_result__rx, true
+    },
+    [CAPSEND_MC_FIND_DESCENDANTS] = {
+        find_descendants__rx, find_descendants_result__rx, true
+    },
+    [CAPSEND_MC_UPDATE_OWNER] = {
+        update_owner__rx, owner_updated__rx, false
+    },
+    [CAPSEND_MC_DELETE_REMOTE] = {
+        delete_remote__rx, delete_remote_result__rx, false
+    },
+    [CAPSEND_MC_REVOKE_MARK] = {
+        revoke_mark__rx, revoke_ready__rx, false
+    },
+    [CAPSEND_MC_REVOKE_COMMIT] = {
+        revoke_commit__rx, revoke_done__rx, false
+    },
 };
 
 static void
@@ -81,11 +143,24 @@ capsend_mc_send_cont(struct intermon_binding *b, struct intermon_msg_queue_elem
     // if do_send is false, an error occured in the multicast setup, so do not
     // send anything
     if (mc_st->do_send) {
-        err = mc_st->send_fn(b, &mc_st->caprep, mc_st);
+        err = intermon_capops_mc_relay__tx(b, MKCONT(free, msg_st->dests),
+                                           mc_st->op, mc_st->origin,
+                                           mc_st->caprep, mc_st->st,
+                                           (lvaddr_t)mc_st, msg_st->dests,
+                                           msg_st->count);
+    } else {
+        free(msg_st->dests);
     }
 
     if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
-        err = capsend_target(msg_st->dest, (struct msg_queue_elem*)msg_st);
+        DEBUG_CAPOPS("%s: got FLOUNDER_ERR_TX_BUSY; requeueing msg.\n", __FUNCTION__);
+        struct intermon_state *inter_st = (struct intermon_state *)b->st;
+        // requeue send request at front and return
+        err = intermon_enqueue_send_at_front(b, &inter_st->queue, b->waitset,
+                                             (struct msg_queue_elem *)e);
+        if (err_is_ok(err)) {
+            return;
+        }
     }
 
     if (err_is_fail(err)) {
@@ -105,7 +180,8 @@ capsend_mc_send_cont(struct intermon_binding *b, struct intermon_msg_queue_elem
 }
 
 static errval_t
-capsend_mc_enqueue(struct capsend_mc_st *mc_st, coreid_t dest)
+capsend_mc_enqueue(struct capsend_mc_st *mc_st, coreid_t dest,
+                   coreid_t *dests, size_t count)
 {
     errval_t err;
 
@@ -114,6 +190,8 @@ capsend_mc_enqueue(struct capsend_mc_st *mc_st, coreid_t dest)
     msg_st->queue_elem.cont = capsend_mc_send_cont;
     msg_st->mc_st = mc_st;
     msg_st->dest = dest;
+    msg_st->dests = dests;
+    msg_st->count = count;
 
     err = capsend_target(dest, (struct msg_queue_elem*)msg_st);
     if (err_is_ok(err)) {
@@ -129,20 +207,146 @@ capsend_mc_enqueue(struct capsend_mc_st *mc_st, coreid_t dest)
 
 static errval_t
 capsend_mc_init(struct capsend_mc_st *mc_st, struct capability *cap,
-                capsend_send_fn send_fn,
-                size_t num_dests, bool track_pending)
+                enum capsend_mc_op op, size_t num_dests, bool track_pending)
 {
+    assert(op < CAPSEND_MC_OP_COUNT);
+
     mc_st->num_queued = 0;
     mc_st->num_pending = track_pending ? 0 : -1;
     mc_st->do_send = true;
-    mc_st->send_fn = send_fn;
+    mc_st->op = op;
+    mc_st->origin = my_core_id;
+    mc_st->st = (lvaddr_t)mc_st;
+    mc_st->result_fn = capsend_mc_ops[op].result;
     if (cap) {
         capability_to_caprep(cap, &mc_st->caprep);
     }
-    mc_st->msg_st_arr = calloc(num_dests, sizeof(*mc_st->msg_st_arr));
-    if (!mc_st->msg_st_arr) {
-        return LIB_ERR_MALLOC_FAIL;
+    // every destination receives at most one message from us
+    mc_st->msg_st_arr = NULL;
+    if (num_dests) {
+        mc_st->msg_st_arr = calloc(num_dests, sizeof(*mc_st->msg_st_arr));
+        if (!mc_st->msg_st_arr) {
+            return LIB_ERR_MALLOC_FAIL;
+        }
+    }
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Sends the multicast to the children responsible for dests
+ */
+static errval_t
+capsend_mc_forward(struct capsend_mc_st *mc_st, coreid_t *dests, size_t count)
+{
+    errval_t err;
+
+    if (!count) {
+        return SYS_ERR_OK;
+    }
+
+    bool member[MAX_COREID + 1];
+    bool leader[MAX_COREID + 1];
+    memset(member, 0, sizeof(member));
+    memset(leader, 0, sizeof(leader));
+
+    for (size_t i = 0; i < count; i++) {
+        assert(dests[i] != my_core_id);
+        member[dests[i]] = true;
+    }
+
+    // group the destinations by their first hop, as long as it is part of
+    // this subtree
+    coreid_t hop[count];
+    size_t num_groups = 0;
+    for (size_t i = 0; i < count; i++) {
+        coreid_t next = multihop_get_next_hop(dests[i]);
+        if (next > MAX_COREID || !member[next]) {
+            next = dests[i];
+        }
+        hop[i] = next;
+        if (!leader[next]) {
+            leader[next] = true;
+            num_groups++;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (leader[dests[i]]) {
+            // a first hop is always the root of its own group
+            hop[i] = dests[i];
+        }
+    }
+
+    // merge groups of neighbouring cores if there are too many
+    size_t num_children = num_groups;
+    if (CAPSEND_MC_FANOUT && num_children > CAPSEND_MC_FANOUT) {
+        num_children = CAPSEND_MC_FANOUT;
+    }
+
+    uint8_t child_of[MAX_COREID + 1];
+    coreid_t children[num_children];
+    bool assigned[num_children];
+    size_t sizes[num_children];
+    memset(assigned, 0, sizeof(assigned));
+    memset(sizes, 0, sizeof(sizes));
+
+    size_t rank = 0;
+    for (unsigned c = 0; c <= MAX_COREID; c++) {
+        if (!leader[c]) {
+            continue;
+        }
+        size_t child = rank++ * num_children / num_groups;
+        if (!assigned[child]) {
+            // the first group of a child is rooted at the child
+            assigned[child] = true;
+            children[child] = c;
+        }
+        child_of[c] = child;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        size_t child = child_of[hop[i]];
+        if (dests[i] != children[child]) {
+            sizes[child]++;
+        }
+    }
+
+    for (size_t child = 0; child < num_children; child++) {
+        coreid_t *subtree = NULL;
+        size_t n = 0;
+
+        if (sizes[child]) {
+            subtree = malloc(sizes[child] * sizeof(coreid_t));
+            if (!subtree) {
+                return LIB_ERR_MALLOC_FAIL;
+            }
+            for (size_t i = 0; i < count; i++) {
+                if (child_of[hop[i]] == child && dests[i] != children[child]) {
+                    subtree[n++] = dests[i];
+                }
+            }
+        }
+
+        err = capsend_mc_enqueue(mc_st, children[child], subtree, n);
+        if (err_is_ok(err)) {
+            continue;
+        }
+
+        if (err_no(err) == MON_ERR_CAPOPS_BUSY) {
+            debug_printf("monitor.%d not ready to participate in distops, skipping\n",
+                    children[child]);
+        } else if (err_no(err) != MON_ERR_NO_MONITOR_FOR_CORE) {
+            free(subtree);
+            return err;
+        }
+
+        // skip the child and reach its subtree without it
+        err = capsend_mc_forward(mc_st, subtree, n);
+        free(subtree);
+        if (err_is_fail(err)) {
+            return err;
+        }
     }
+
     return SYS_ERR_OK;
 }
 
@@ -152,13 +356,168 @@ bool capsend_handle_mc_reply(struct capsend_mc_st *st)
     return --st->num_pending == 0;
 }
 
+/*
+ * Multicast relay {{{2
+ */
+
+struct capsend_mc_result_msg_st {
+    struct intermon_msg_queue_elem queue_elem;
+    errval_t status;
+    coreid_t core;
+    genvaddr_t st;
+};
+
+static void
+capsend_mc_result_send_cont(struct intermon_binding *b, struct intermon_msg_queue_elem *e)
+{
+    errval_t err;
+    struct capsend_mc_result_msg_st *msg_st = (struct capsend_mc_result_msg_st*)e;
+
+    err = intermon_capops_mc_result__tx(b, NOP_CONT, msg_st->status,
+                                        msg_st->core, msg_st->st);
+
+    if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+        DEBUG_CAPOPS("%s: got FLOUNDER_ERR_TX_BUSY; requeueing msg.\n", __FUNCTION__);
+        struct intermon_state *inter_st = (struct intermon_state *)b->st;
+        // requeue send request at front and return
+        err = intermon_enqueue_send_at_front(b, &inter_st->queue, b->waitset,
+                                             (struct msg_queue_elem *)e);
+        GOTO_IF_ERR(err, handle_err);
+        return;
+    }
+
+handle_err:
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "failed to send mc_result message");
+    }
+    free(msg_st);
+}
+
+static errval_t
+capsend_mc_result(coreid_t dest, errval_t status, coreid_t core, genvaddr_t st)
+{
+    errval_t err;
+    struct capsend_mc_result_msg_st *msg_st = calloc(1, sizeof(*msg_st));
+    if (!msg_st) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    msg_st->queue_elem.cont = capsend_mc_result_send_cont;
+    msg_st->status = status;
+    msg_st->core = core;
+    msg_st->st = st;
+
+    err = capsend_target(dest, (struct msg_queue_elem*)msg_st);
+    if (err_is_fail(err)) {
+        free(msg_st);
+    }
+
+    return err;
+}
+
+static void
+capsend_mc_relay_result(struct capsend_mc_st *mc_st, errval_t status,
+                        coreid_t core)
+{
+    errval_t err;
+    struct capsend_mc_relay_st *relay = (struct capsend_mc_relay_st*)mc_st;
+
+    if (relay->any) {
+        // the first core that has the cap wins, other errors are passed up
+        if (err_is_ok(status)) {
+            if (err_is_fail(relay->status)) {
+                relay->status = status;
+                relay->core = core;
+            }
+        } else if (err_no(relay->status) == SYS_ERR_CAP_NOT_FOUND) {
+            relay->status = status;
+            relay->core = core;
+        }
+    } else if (err_is_fail(status) && err_is_ok(relay->status)) {
+        // the first failure wins
+        relay->status = status;
+        relay->core = core;
+    }
+
+    if (!capsend_handle_mc_reply(mc_st)) {
+        // subtree is not complete
+        return;
+    }
+
+    err = capsend_mc_result(relay->parent, relay->status, relay->core,
+                            relay->parent_st);
+    PANIC_IF_ERR(err, "sending combined multicast result");
+
+    free(mc_st->msg_st_arr);
+    free(relay);
+}
+
+/**
+ * \brief Reports the result of the local part of a multicast operation
+ */
+void
+capsend_mc_deliver_done(struct capsend_mc_st *relay, errval_t status)
+{
+    relay->result_fn(relay, status, my_core_id);
+}
+
+void
+capsend_mc_relay__rx(struct intermon_binding *b, uint8_t op, coreid_t origin,
+                     intermon_caprep_t caprep, genvaddr_t st,
+                     genvaddr_t relay_st, coreid_t *dests, size_t count)
+{
+    errval_t err;
+    struct intermon_state *inter_st = (struct intermon_state*)b->st;
+
+    DEBUG_CAPOPS("%s: op %u from %d, %zu cores below us\n", __FUNCTION__, op,
+                 inter_st->core_id, count);
+
+    if (op >= CAPSEND_MC_OP_COUNT) {
+        USER_PANIC("unknown capops multicast operation %u", op);
+    }
+
+    struct capsend_mc_relay_st *relay;
+    err = calloce(1, sizeof(*relay), &relay);
+    PANIC_IF_ERR(err, "allocating multicast relay state");
+
+    relay->any = capsend_mc_ops[op].any;
+    relay->status = relay->any ? SYS_ERR_CAP_NOT_FOUND : SYS_ERR_OK;
+    relay->core = my_core_id;
+    relay->parent = inter_st->core_id;
+    relay->parent_st = relay_st;
+
+    struct capsend_mc_st *mc_st = &relay->mc_st;
+    err = capsend_mc_init(mc_st, NULL, op, count, true);
+    PANIC_IF_ERR(err, "initializing multicast relay");
+    mc_st->caprep = caprep;
+    mc_st->origin = origin;
+    mc_st->st = st;
+    mc_st->result_fn = capsend_mc_relay_result;
+
+    // pass the operation on to our subtree...
+    err = capsend_mc_forward(mc_st, dests, count);
+    PANIC_IF_ERR(err, "relaying capops multicast");
+    free(dests);
+
+    // ...and perform it locally
+    mc_st->num_pending++;
+    capsend_mc_ops[op].deliver(origin, &caprep, st, mc_st);
+}
+
+void
+capsend_mc_result__rx(struct intermon_binding *b, errval_t status,
+                      coreid_t core, genvaddr_t relay_st)
+{
+    struct capsend_mc_st *mc_st = (struct capsend_mc_st*)(lvaddr_t)relay_st;
+    mc_st->result_fn(mc_st, status, core);
+}
+
 /*
  * Broadcast helpers {{{2
  */
 
 static errval_t
 capsend_broadcast(struct capsend_mc_st *bc_st, struct capsend_destset *dests,
-        struct capability *cap, capsend_send_fn send_cont)
+        struct capability *cap, enum capsend_mc_op op)
 {
     errval_t err;
     size_t dest_count;
@@ -167,8 +526,6 @@ capsend_broadcast(struct capsend_mc_st *bc_st, struct capsend_destset *dests,
     // do not count self when calculating #dest cores
     dest_count = online_monitors - 1;
     DEBUG_CAPOPS("%s: dest_count = %zu\n", __FUNCTION__, dest_count);
-    DEBUG_CAPOPS("%s: num_queued = %d\n", __FUNCTION__, bc_st->num_queued);
-    DEBUG_CAPOPS("%s: num_pending = %d\n", __FUNCTION__, bc_st->num_pending);
     if (dests && dests->set == NULL) {
         dests->set = calloc(dest_count, sizeof(coreid_t));
         dests->capacity = dest_count;
@@ -177,63 +534,62 @@ capsend_broadcast(struct capsend_mc_st *bc_st, struct capsend_destset *dests,
     } else if (dests) {
         dest_count = dests->count;
     }
-    err = capsend_mc_init(bc_st, cap, send_cont, dest_count, true);
-    if (err_is_fail(err)) {
-        free(bc_st);
-    }
 
+    coreid_t *set;
     if (init_destset || !dests) {
-        for (coreid_t dest = 0; dest < MAX_COREID && bc_st->num_queued < dest_count; dest++)
+        // collect the cores we have a monitor connection for, the
+        // destination set records them for later multicasts.
+        set = dests ? dests->set : calloc(dest_count, sizeof(coreid_t));
+        if (dest_count && !set) {
+            free(bc_st);
+            return LIB_ERR_MALLOC_FAIL;
+        }
+        size_t count = 0;
+        for (coreid_t dest = 0; dest < MAX_COREID && count < dest_count; dest++)
         {
+            struct intermon_binding *b;
             if (dest == my_core_id) {
                 // do not send to self
                 continue;
             }
-            err = capsend_mc_enqueue(bc_st, dest);
-            if (err_is_ok(err) && dests) {
-                // if we're initializing destination set, add destination
-                // cores that we were able to enqueue msg for to set.
-                dests->set[dests->count++] = dest;
-            }
-            if (err_no(err) == MON_ERR_NO_MONITOR_FOR_CORE) {
+            if (err_is_fail(intermon_binding_get(dest, &b))) {
                 // no connection for this core, skip
                 continue;
-            } else if (err_no(err) == MON_ERR_CAPOPS_BUSY) {
-                debug_printf("monitor.%d not ready to participate in distops, skipping\n",
-                        dest);
-            } else if (err_is_fail(err)) {
-                // failure, disable broadcast
-                bc_st->do_send = false;
-                if (!bc_st->num_queued) {
-                    // only cleanup of no messages have been enqueued
-                    free(bc_st->msg_st_arr);
-                    free(bc_st);
-                }
-                return err;
             }
+            set[count++] = dest;
+        }
+        dest_count = count;
+        if (dests) {
+            dests->count = count;
         }
     } else {
-        for (int i = 0; i < dest_count; i++) {
-            coreid_t dest = dests->set[i];
+        set = dests->set;
+    }
 
-            err = capsend_mc_enqueue(bc_st, dest);
-            if (err_no(err) == MON_ERR_NO_MONITOR_FOR_CORE) {
-                // no connection for this core, skip
-                continue;
-            } else if (err_no(err) == MON_ERR_CAPOPS_BUSY) {
-                debug_printf("monitor.%d not ready to participate in distops, skipping\n",
-                        dest);
-            } else if (err_is_fail(err)) {
-                // failure, disable broadcast
-                bc_st->do_send = false;
-                if (!bc_st->num_queued) {
-                    // only cleanup of no messages have been enqueued
-                    free(bc_st->msg_st_arr);
-                    free(bc_st);
-                }
-                return err;
-            }
+    err = capsend_mc_init(bc_st, cap, op, dest_count, true);
+    if (err_is_fail(err)) {
+        if (!dests) {
+            free(set);
+        }
+        free(bc_st);
+        return err;
+    }
+
+    err = capsend_mc_forward(bc_st, set, dest_count);
+    if (!dests) {
+        free(set);
+    }
+    DEBUG_CAPOPS("%s: num_queued = %d\n", __FUNCTION__, bc_st->num_queued);
+    DEBUG_CAPOPS("%s: num_pending = %d\n", __FUNCTION__, bc_st->num_pending);
+    if (err_is_fail(err)) {
+        // failure, disable broadcast
+        bc_st->do_send = false;
+        if (!bc_st->num_queued) {
+            // only cleanup of no messages have been enqueued
+            free(bc_st->msg_st_arr);
+            free(bc_st);
         }
+        return err;
     }
 
     if (!bc_st->num_pending && dest_count > 1) {
@@ -252,8 +608,6 @@ capsend_broadcast(struct capsend_mc_st *bc_st, struct capsend_destset *dests,
  * Find copies broadcast {{{2
  */
 
-struct find_cap_broadcast_msg_st;
-
 struct find_cap_broadcast_st {
     struct capsend_mc_st bc;
     capsend_find_cap_result_fn result_handler;
@@ -261,12 +615,6 @@ struct find_cap_broadcast_st {
     void *st;
 };
 
-static errval_t
-find_cap_broadcast_send_cont(struct intermon_binding *b, intermon_caprep_t *caprep, struct capsend_mc_st *st)
-{
-    return intermon_capops_find_cap__tx(b, NOP_CONT, *caprep, (uintptr_t)st);
-}
-
 errval_t
 capsend_find_cap(struct capability *cap, capsend_find_cap_result_fn result_handler, void *st)
 {
@@ -278,76 +626,20 @@ capsend_find_cap(struct capability *cap, capsend_find_cap_result_fn result_handl
     bc_st->found = false;
     bc_st->st = st;
 
-    return capsend_broadcast((struct capsend_mc_st*)bc_st, NULL, cap, find_cap_broadcast_send_cont);
-}
-
-/*
- * Find copies result {{{2
- */
-
-struct find_cap_result_msg_st {
-    struct intermon_msg_queue_elem queue_elem;
-    errval_t result;
-    genvaddr_t st;
-};
-
-static void
-find_cap_result_send_cont(struct intermon_binding *b, struct intermon_msg_queue_elem *e)
-{
-    errval_t err;
-    struct find_cap_result_msg_st *msg_st = (struct find_cap_result_msg_st*)e;
-
-    err = intermon_capops_find_cap_result__tx(b, NOP_CONT, msg_st->result, msg_st->st);
-
-    if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
-        DEBUG_CAPOPS("%s: got FLOUNDER_ERR_TX_BUSY; requeueing msg.\n", __FUNCTION__);
-        struct intermon_state *inter_st = (struct intermon_state *)b->st;
-        // requeue send request at front and return
-        err = intermon_enqueue_send_at_front(b, &inter_st->queue, b->waitset,
-                                             (struct msg_queue_elem *)e);
-        GOTO_IF_ERR(err, handle_err);
-        return;
-    }
-
-handle_err:
-    if (err_is_fail(err)) {
-        USER_PANIC_ERR(err, "failed to send find_cap_result message");
-    }
-    free(msg_st);
-}
-
-static errval_t
-find_cap_result(coreid_t dest, errval_t result, genvaddr_t st)
-{
-    errval_t err;
-    struct find_cap_result_msg_st *msg_st = calloc(1, sizeof(struct find_cap_result_msg_st));
-    if (!msg_st) {
-        return LIB_ERR_MALLOC_FAIL;
-    }
-    msg_st->queue_elem.cont = find_cap_result_send_cont;
-    msg_st->result = result;
-    msg_st->st = st;
-
-    err = capsend_target(dest, (struct msg_queue_elem*)msg_st);
-    if (err_is_fail(err)) {
-        free(msg_st);
-    }
-
-    return err;
+    return capsend_broadcast((struct capsend_mc_st*)bc_st, NULL, cap, CAPSEND_MC_FIND_CAP);
 }
 
 /*
  * Find copies receive handlers {{{2
  */
 
-void
-find_cap__rx_handler(struct intermon_binding *b, intermon_caprep_t caprep, genvaddr_t st)
+static void
+find_cap__rx(coreid_t from, intermon_caprep_t *caprep, genvaddr_t st,
+             struct capsend_mc_st *relay)
 {
     errval_t err, cleanup_err;
-    struct intermon_state *inter_st = (struct intermon_state*)b->st;
-    coreid_t from = inter_st->core_id;
     struct capability cap;
-    caprep_to_capability(&caprep, &cap);
+    caprep_to_capability(caprep, &cap);
     struct capref capref;
 
     err = slot_alloc(&capref);
@@ -372,24 +664,18 @@ free_slot:
     }
 
 send_err:
-    cleanup_err = find_cap_result(from, err, st);
-    if (err_is_fail(cleanup_err)) {
-        USER_PANIC_ERR(err, "failed to send find_cap result");
-    }
+    capsend_mc_deliver_done(relay, err);
 }
 
-void
-find_cap_result__rx_handler(struct intermon_binding *b, errval_t result, genvaddr_t st)
+static void
+find_cap_result__rx(struct capsend_mc_st *mc_st, errval_t result, coreid_t core)
 {
     // if we receive a positive result, immediately forward to caller
-    lvaddr_t lst = (lvaddr_t)st;
-    struct find_cap_broadcast_st *fc_bc_st = (struct find_cap_broadcast_st*)lst;
+    struct find_cap_broadcast_st *fc_bc_st = (struct find_cap_broadcast_st*)mc_st;
     if (err_is_ok(result)) {
         if (!fc_bc_st->found) {
             fc_bc_st->found = true;
-            struct intermon_state *inter_st = (struct intermon_state*)b->st;
-            coreid_t from = inter_st->core_id;
-            fc_bc_st->result_handler(SYS_ERR_OK, from, fc_bc_st->st);
+            fc_bc_st->result_handler(SYS_ERR_OK, core, fc_bc_st->st);
         }
     }
     else if (err_no(result) != SYS_ERR_CAP_NOT_FOUND) {
@@ -417,13 +703,6 @@ struct find_descendants_mc_st {
     bool have_result;
 };
 
-static errval_t
-find_descendants_send_cont(struct intermon_binding *b, intermon_caprep_t *caprep, struct capsend_mc_st *mc_st)
-{
-    lvaddr_t lst = (lvaddr_t)mc_st;
-    return intermon_capops_find_descendants__tx(b, NOP_CONT, *caprep, (genvaddr_t)lst);
-}
-
 errval_t
 capsend_find_descendants(struct domcapref src, capsend_result_fn result_fn, void *st)
 {
@@ -444,82 +723,35 @@ capsend_find_descendants(struct domcapref src, capsend_result_fn result_fn, void
     mc_st->result_fn = result_fn;
     mc_st->st = st;
     mc_st->have_result = false;
-    return capsend_relations(&cap, find_descendants_send_cont,
+    return capsend_relations(&cap, CAPSEND_MC_FIND_DESCENDANTS,
             (struct capsend_mc_st*)mc_st, NULL);
 }
 
-
-struct find_descendants_result_msg_st {
-    struct intermon_msg_queue_elem queue_elem;
-    errval_t status;
-    genvaddr_t st;
-};
-
 static void
-find_descendants_result_send_cont(struct intermon_binding *b, struct intermon_msg_queue_elem *e)
+find_descendants__rx(coreid_t from, intermon_caprep_t *caprep, genvaddr_t st,
+                     struct capsend_mc_st *relay)
 {
     errval_t err;
-    struct find_descendants_result_msg_st *msg_st;
-    msg_st = (struct find_descendants_result_msg_st*)e;
-    err = intermon_capops_find_descendants_result__tx(b, NOP_CONT, msg_st->status, msg_st->st);
-
-    if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
-        DEBUG_CAPOPS("%s: got FLOUNDER_ERR_TX_BUSY; requeueing msg.\n", __FUNCTION__);
-        struct intermon_state *inter_st = (struct intermon_state *)b->st;
-        // requeue send request at front and return
-        err = intermon_enqueue_send_at_front(b, &inter_st->queue, b->waitset,
-                                             (struct msg_queue_elem *)e);
-        GOTO_IF_ERR(err, handle_err);
-        return;
-    }
-
-handle_err:
-    free(msg_st);
-    if (err_is_fail(err)) {
-        USER_PANIC_ERR(err, "could not send find_descendants_result");
-    }
-}
-
-void
-find_descendants__rx_handler(struct intermon_binding *b, intermon_caprep_t caprep, genvaddr_t st)
-{
-    errval_t err;
-
-    struct intermon_state *inter_st = (struct intermon_state*)b->st;
-    coreid_t from = inter_st->core_id;
 
     struct capability cap;
-    caprep_to_capability(&caprep, &cap);
+    caprep_to_capability(caprep, &cap);
 
     bool has_descendants;
     err = monitor_has_descendants(&cap, &has_descendants);
     assert(err_is_ok(err));
 
-    struct find_descendants_result_msg_st *msg_st;
-    msg_st = malloc(sizeof(*msg_st));
-    if (!msg_st) {
-        err = LIB_ERR_MALLOC_FAIL;
-        USER_PANIC_ERR(err, "could not alloc find_descendants_result_msg_st");
-    }
-    msg_st->queue_elem.cont = find_descendants_result_send_cont;
-    msg_st->st = st;
-
     if (err_is_ok(err)) {
         err = has_descendants ? SYS_ERR_OK : SYS_ERR_CAP_NOT_FOUND;
     }
-    msg_st->status = err;
 
-    err = capsend_target(from, (struct msg_queue_elem*)msg_st);
-    if (err_is_fail(err)) {
-        USER_PANIC_ERR(err, "could not enqueue find_descendants_result msg");
-    }
+    capsend_mc_deliver_done(relay, err);
 }
 
-void
-find_descendants_result__rx_handler(struct intermon_binding *b, errval_t status, genvaddr_t st)
+static void
+find_descendants_result__rx(struct capsend_mc_st *st, errval_t status,
+                            coreid_t core)
 {
-    lvaddr_t lst = (lvaddr_t) st;
-    struct find_descendants_mc_st *mc_st = (struct find_descendants_mc_st*)lst;
+    struct find_descendants_mc_st *mc_st = (struct find_descendants_mc_st*)st;
 
     if (err_is_ok(status)) {
         // found result
@@ -554,13 +786,6 @@ struct update_owner_broadcast_st {
     struct event_closure completion_continuation;
 };
 
-static errval_t
-update_owner_broadcast_send_cont(struct intermon_binding *b, intermon_caprep_t *caprep, struct capsend_mc_st *bc_st)
-{
-    lvaddr_t lst = (lvaddr_t)bc_st;
-    return intermon_capops_update_owner__tx(b, NOP_CONT, *caprep, (genvaddr_t)lst);
-}
-
 errval_t
 capsend_update_owner(struct domcapref capref, struct event_closure completion_continuation)
 {
@@ -578,71 +803,17 @@ capsend_update_owner(struct domcapref capref, struct event_closure completion_co
     }
     bc_st->completion_continuation = completion_continuation;
 
-    return capsend_broadcast((struct capsend_mc_st*)bc_st, NULL, &cap, update_owner_broadcast_send_cont);
-}
-
-/*
- * Owner updated response {{{2
- */
-
-struct owner_updated_msg_st {
-    struct intermon_msg_queue_elem queue_elem;
-    genvaddr_t st;
-};
-
-static void
-owner_updated_send_cont(struct intermon_binding *b, struct intermon_msg_queue_elem *e)
-{
-    errval_t err;
-    struct owner_updated_msg_st *msg_st = (struct owner_updated_msg_st*)e;
-
-    err = intermon_capops_owner_updated__tx(b, NOP_CONT, msg_st->st);
-
-    if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
-        DEBUG_CAPOPS("%s: got FLOUNDER_ERR_TX_BUSY; requeueing msg.\n", __FUNCTION__);
-        struct intermon_state *inter_st = (struct intermon_state *)b->st;
-        // requeue send request at front and return
-        err = intermon_enqueue_send_at_front(b, &inter_st->queue, b->waitset,
-                                             (struct msg_queue_elem *)e);
-        GOTO_IF_ERR(err, handle_err);
-        return;
-    }
-
-handle_err:
-    if (err_is_fail(err)) {
-        USER_PANIC_ERR(err, "failed to send owner_updated message");
-    }
-    free(msg_st);
-}
-
-static errval_t
-owner_updated(coreid_t owner, genvaddr_t st)
-{
-    errval_t err;
-    struct owner_updated_msg_st *msg_st = calloc(1, sizeof(struct owner_updated_msg_st));
-    if (!msg_st) {
-        return LIB_ERR_MALLOC_FAIL;
-    }
-    msg_st->queue_elem.cont = owner_updated_send_cont;
-    msg_st->st = st;
-
-    err = capsend_target(owner, (struct msg_queue_elem*)msg_st);
-    if (err_is_fail(err)) {
-        free(msg_st);
-    }
-
-    return err;
+    return capsend_broadcast((struct capsend_mc_st*)bc_st, NULL, &cap, CAPSEND_MC_UPDATE_OWNER);
 }
 
 /*
  * Receive handlers {{{2
  */
 
-void
-owner_updated__rx_handler(struct intermon_binding *b, genvaddr_t st)
+static void
+owner_updated__rx(struct capsend_mc_st *mc_st, errval_t status, coreid_t core)
 {
-    lvaddr_t lst = (lvaddr_t)st;
-    struct update_owner_broadcast_st *uo_bc_st = (struct update_owner_broadcast_st*)lst;
+    struct update_owner_broadcast_st *uo_bc_st = (struct update_owner_broadcast_st*)mc_st;
     if (!capsend_handle_mc_reply(&uo_bc_st->bc)) {
         // broadcast is not complete
         return;
@@ -652,15 +823,14 @@ owner_updated__rx_handler(struct intermon_binding *b, genvaddr_t st)
     free(uo_bc_st);
 }
 
-void
-update_owner__rx_handler(struct intermon_binding *b, intermon_caprep_t caprep, genvaddr_t st)
+static void
+update_owner__rx(coreid_t from, intermon_caprep_t *caprep, genvaddr_t st,
+                 struct capsend_mc_st *relay)
 {
     errval_t err;
-    struct intermon_state *inter_st = (struct intermon_state*)b->st;
-    coreid_t from = inter_st->core_id;
     struct capref capref;
     struct capability cap;
-    caprep_to_capability(&caprep, &cap);
+    caprep_to_capability(caprep, &cap);
 
     err = slot_alloc(&capref);
     if (err_is_fail(err)) {
@@ -682,10 +852,7 @@ update_owner__rx_handler(struct intermon_binding *b, intermon_caprep_t caprep, g
 
     cap_destroy(capref);
 
-    err = owner_updated(from, st);
-    if (err_is_fail(err)) {
-        USER_PANIC_ERR(err, "failed to send ownership update response");
-    }
+    capsend_mc_deliver_done(relay, SYS_ERR_OK);
 }
 
 /*
@@ -694,19 +861,19 @@ update_owner__rx_handler(struct intermon_binding *b, intermon_caprep_t caprep, g
 
 errval_t
 capsend_copies(struct capability *cap,
-            capsend_send_fn send_fn,
+            enum capsend_mc_op op,
             struct capsend_mc_st *mc_st)
 {
     // this is currently just a broadcast
-    return capsend_broadcast(mc_st, NULL, cap, send_fn);
+    return capsend_broadcast(mc_st, NULL, cap, op);
 }
 
 errval_t
 capsend_relations(struct capability *cap,
-                  capsend_send_fn send_fn,
+                  enum capsend_mc_op op,
                   struct capsend_mc_st *mc_st,
                   struct capsend_destset *dests)
 {
     // this is currently just a broadcast
-    return capsend_broadcast(mc_st, dests, cap, send_fn);
+    return capsend_broadcast(mc_st, dests, cap, op);
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012 ETH Zurich.
+ * Copyright (c) 2012, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -27,12 +27,6 @@ struct delete_remote_mc_st {
     errval_t status;
 };
 
-struct delete_remote_result_msg_st {
-    struct intermon_msg_queue_elem queue_elem;
-    errval_t status;
-    genvaddr_t st;
-};
-
 static void delete_trylock_cont(void *st);
 
 static void
@@ -144,14 +138,6 @@ report_error:
  * cap is deleted
  */
 
-static errval_t
-delete_remote__send(struct intermon_binding *b, intermon_caprep_t *caprep,
-                    struct capsend_mc_st *st)
-{
-    return intermon_capops_delete_remote__tx(b, NOP_CONT, *caprep,
-                                             (lvaddr_t)st);
-}
-
 static void
 delete_remote__enq(struct capability *cap, struct delete_st *st)
 {
@@ -163,7 +149,7 @@ delete_remote__enq(struct capability *cap, struct delete_st *st)
     mc_st->del_st = st;
     mc_st->status = SYS_ERR_OK;
 
-    err = capsend_copies(cap, delete_remote__send,
+    err = capsend_copies(cap, CAPSEND_MC_DELETE_REMOTE,
                          (struct capsend_mc_st*)mc_st);
     GOTO_IF_ERR(err, report_error);
 
@@ -173,54 +159,13 @@ report_error:
     delete_result__rx(err, st, true);
 }
 
-static void
-delete_remote_result__send(struct intermon_binding *b, struct intermon_msg_queue_elem *e)
-{
-    errval_t err;
-    struct delete_remote_result_msg_st *msg_st = (struct delete_remote_result_msg_st*)e;
-    err = intermon_capops_delete_remote_result__tx(b, NOP_CONT, msg_st->status, msg_st->st);
-
-    if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
-        DEBUG_CAPOPS("%s: got FLOUNDER_ERR_TX_BUSY; requeueing msg.\n", __FUNCTION__);
-        struct intermon_state *inter_st = (struct intermon_state *)b->st;
-        // requeue send request at front and return
-        err = intermon_enqueue_send_at_front(b, &inter_st->queue, b->waitset,
-                                             (struct msg_queue_elem *)e);
-        GOTO_IF_ERR(err, handle_err);
-        return;
-    }
-
-handle_err:
-    PANIC_IF_ERR(err, "failed to send delete_remote_result msg");
-    free(msg_st);
-}
-
-static void
-delete_remote_result__enq(coreid_t dest, errval_t status, genvaddr_t st)
-{
-    errval_t err;
-
-    struct delete_remote_result_msg_st *msg_st;
-    err = calloce(1, sizeof(*msg_st), &msg_st);
-    PANIC_IF_ERR(err, "allocating delete_remote_result st");
-
-    msg_st->queue_elem.cont = delete_remote_result__send;
-    msg_st->status = status;
-    msg_st->st = st;
-
-    err = capsend_target(dest, (struct msg_queue_elem*)msg_st);
-    PANIC_IF_ERR(err, "failed to send delete_remote result");
-}
-
 void
-delete_remote__rx(struct intermon_binding *b, intermon_caprep_t caprep,
-                  genvaddr_t st)
+delete_remote__rx(coreid_t from, intermon_caprep_t *caprep, genvaddr_t st,
+                  struct capsend_mc_st *relay)
 {
     errval_t err, err2;
     struct capability cap;
-    struct intermon_state *inter_st = (struct intermon_state*)b->st;
-    coreid_t from = inter_st->core_id;
-    caprep_to_capability(&caprep, &cap);
+    caprep_to_capability(caprep, &cap);
     struct capref capref;
 
     err = slot_alloc(&capref);
@@ -248,15 +193,15 @@ free_slot:
     DEBUG_IF_ERR(err2, "freeing temp delete_remote cap, will leak");
 
 send_err:
-    delete_remote_result__enq(from, err, st);
+    capsend_mc_deliver_done(relay, err);
 }
 
 void
-delete_remote_result__rx(struct intermon_binding *b, errval_t status,
-                         genvaddr_t st)
+delete_remote_result__rx(struct capsend_mc_st *st, errval_t status,
+                         coreid_t core)
 {
     errval_t err;
-    struct delete_remote_mc_st *mc_st = (struct delete_remote_mc_st*)(lvaddr_t)st;
+    struct delete_remote_mc_st *mc_st = (struct delete_remote_mc_st*)st;
     struct delete_st *del_st = mc_st->del_st;
 
     // XXX: do something with received errors?
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012 ETH Zurich.
+ * Copyright (c) 2012, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -64,17 +64,14 @@ struct result_closure {
     } \
 } while (0)
 
-void find_cap__rx_handler(struct intermon_binding *b, intermon_caprep_t caprep,
-                          genvaddr_t st);
-void find_cap_result__rx_handler(struct intermon_binding *b, errval_t result,
-                                 genvaddr_t st);
-void find_descendants__rx_handler(struct intermon_binding *b,
-                                  intermon_caprep_t caprep, genvaddr_t st);
-void find_descendants_result__rx_handler(struct intermon_binding *b,
-                                         errval_t status, genvaddr_t st);
-void owner_updated__rx_handler(struct intermon_binding *b, genvaddr_t st);
-void update_owner__rx_handler(struct intermon_binding *b,
-                              intermon_caprep_t caprep, genvaddr_t st);
+struct capsend_mc_st;
+
+void capsend_mc_relay__rx(struct intermon_binding *b, uint8_t op,
+                          coreid_t origin, intermon_caprep_t caprep,
+                          genvaddr_t st, genvaddr_t relay_st,
+                          coreid_t *dests, size_t count);
+void capsend_mc_result__rx(struct intermon_binding *b, errval_t status,
+                           coreid_t core, genvaddr_t relay_st);
 void recv_copy_result__rx(struct intermon_binding *b, errval_t status,
                           capaddr_t capaddr, uint8_t vbits, cslot_t slot,
                           genvaddr_t st);
@@ -82,10 +79,10 @@ void recv_copy__rx(struct intermon_binding *b, intermon_caprep_t caprep,
                    uint8_t owner_relations, genvaddr_t st);
 void request_copy__rx(struct intermon_binding *b, coreid_t dest,
                       intermon_caprep_t caprep, genvaddr_t st);
-void delete_remote__rx(struct intermon_binding *b,
-                               intermon_caprep_t caprep, genvaddr_t st);
-void delete_remote_result__rx(struct intermon_binding *b,
-                                      errval_t status, genvaddr_t st);
+void delete_remote__rx(coreid_t from, intermon_caprep_t *caprep,
+                       genvaddr_t st, struct capsend_mc_st *relay);
+void delete_remote_result__rx(struct capsend_mc_st *mc_st, errval_t status,
+                              coreid_t core);
 void move_request__rx_handler(struct intermon_binding *b,
                               intermon_caprep_t caprep, uint8_t relations,
                               genvaddr_t st);
@@ -102,12 +99,14 @@ void retype_request__rx(struct intermon_binding *b, intermon_caprep_t srcrep,
                         uint64_t count, genvaddr_t st);
 void retype_response__rx(struct intermon_binding *b, errval_t status,
                                  genvaddr_t st);
-void revoke_mark__rx(struct intermon_binding *b,
-                     intermon_caprep_t caprep,
-                     genvaddr_t st);
-void revoke_ready__rx(struct intermon_binding *b, genvaddr_t st);
-void revoke_commit__rx(struct intermon_binding *b, genvaddr_t st);
-void revoke_done__rx(struct intermon_binding *b, genvaddr_t st);
+void revoke_mark__rx(coreid_t from, intermon_caprep_t *caprep,
+                     genvaddr_t st, struct capsend_mc_st *relay);
+void revoke_ready__rx(struct capsend_mc_st *mc_st, errval_t status,
+                      coreid_t core);
+void revoke_commit__rx(coreid_t from, intermon_caprep_t *caprep,
+                       genvaddr_t st, struct capsend_mc_st *relay);
+void revoke_done__rx(struct capsend_mc_st *mc_st, errval_t status,
+                     coreid_t core);
 
 size_t num_monitors_online(void);
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012 ETH Zurich.
+ * Copyright (c) 2012, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -31,13 +31,13 @@ struct revoke_master_st {
 };
 
 struct revoke_slave_st {
-    struct intermon_msg_queue_elem im_qn;
     struct delete_queue_node del_qn;
     struct capability rawcap;
     struct capref cap;
     coreid_t from;
     genvaddr_t st;
     errval_t status;
+    struct capsend_mc_st *relay;
     struct revoke_slave_st *next;
 };
 
@@ -47,17 +47,7 @@ static void revoke_result__rx(errval_t result,
 static void revoke_retrieve__rx(errval_t result, void *st_);
 static void revoke_local(struct revoke_master_st *st);
 static void revoke_no_remote(struct revoke_master_st *st);
-static errval_t revoke_mark__send(struct intermon_binding *b,
-                                  intermon_caprep_t *caprep,
-                                  struct capsend_mc_st *mc_st);
-static void revoke_ready__send(struct intermon_binding *b,
-                               struct intermon_msg_queue_elem *e);
-static errval_t revoke_commit__send(struct intermon_binding *b,
-                                    intermon_caprep_t *caprep,
-                                    struct capsend_mc_st *mc_st);
 static void revoke_slave_steps__fin(void *st);
-static void revoke_done__send(struct intermon_binding *b,
-                              struct intermon_msg_queue_elem *e);
 static void revoke_master_steps__fin(void *st);
 
 void
@@ -180,7 +170,7 @@ revoke_local(struct revoke_master_st *st)
 
     DEBUG_CAPOPS("%s ## revocation: mark phase\n", __FUNCTION__);
     // XXX: could check whether remote copies exist here(?), -SG, 2014-11-05
-    err = capsend_relations(&st->rawcap, revoke_mark__send,
+    err = capsend_relations(&st->rawcap, CAPSEND_MC_REVOKE_MARK,
             &st->revoke_mc_st, &st->dests);
     PANIC_IF_ERR(err, "initiating revoke mark multicast");
 }
@@ -221,33 +211,27 @@ revoke_no_remote(struct revoke_master_st *st)
     delete_queue_wait(&st->del_qn, steps_fin_cont);
 }
 
-static errval_t
-revoke_mark__send(struct intermon_binding *b,
-                  intermon_caprep_t *caprep,
-                  struct capsend_mc_st *mc_st)
+static inline struct revoke_master_st *
+revoke_master_from_mc(struct capsend_mc_st *mc_st)
 {
-    struct revoke_master_st *st;
     ptrdiff_t off = offsetof(struct revoke_master_st, revoke_mc_st);
-    st = (struct revoke_master_st*)((uintptr_t)mc_st - off);
-    return intermon_capops_revoke_mark__tx(b, NOP_CONT, *caprep, (lvaddr_t)st);
+    return (struct revoke_master_st*)((char*)mc_st - off);
 }
 
 void
-revoke_mark__rx(struct intermon_binding *b,
-                intermon_caprep_t caprep,
-                genvaddr_t st)
+revoke_mark__rx(coreid_t from, intermon_caprep_t *caprep, genvaddr_t st,
+                struct capsend_mc_st *relay)
 {
     DEBUG_CAPOPS("%s\n", __FUNCTION__);
     errval_t err;
-    struct intermon_state *inter_st = (struct intermon_state*)b->st;
 
     struct revoke_slave_st *rvk_st;
     err = calloce(1, sizeof(*rvk_st), &rvk_st);
     PANIC_IF_ERR(err, "allocating revoke slave state");
 
-    rvk_st->from = inter_st->core_id;
+    rvk_st->from = from;
     rvk_st->st = st;
-    caprep_to_capability(&caprep, &rvk_st->rawcap);
+    caprep_to_capability(caprep, &rvk_st->rawcap);
 
     if (!slaves_head) {
         assert(!slaves_tail);
@@ -275,40 +259,16 @@ revoke_mark__rx(struct intermon_binding *b,
         USER_PANIC_ERR(err, "marking revoke");
     }
 
-    rvk_st->im_qn.cont = revoke_ready__send;
-    err = capsend_target(rvk_st->from, (struct msg_queue_elem*)rvk_st);
-    PANIC_IF_ERR(err, "enqueing revoke_ready");
-}
-
-static void
-revoke_ready__send(struct intermon_binding *b,
-                   struct intermon_msg_queue_elem *e)
-{
-    errval_t err;
-    struct revoke_slave_st *rvk_st = (struct revoke_slave_st*)e;
-    err = intermon_capops_revoke_ready__tx(b, NOP_CONT, rvk_st->st);
-
-    if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
-        DEBUG_CAPOPS("%s: got FLOUNDER_ERR_TX_BUSY; requeueing msg.\n", __FUNCTION__);
-        struct intermon_state *inter_st = (struct intermon_state *)b->st;
-        // requeue send request at front and return
-        err = intermon_enqueue_send_at_front(b, &inter_st->queue, b->waitset,
-                                             (struct msg_queue_elem *)e);
-        GOTO_IF_ERR(err, handle_err);
-        return;
-    }
-
-handle_err:
-    PANIC_IF_ERR(err, "sending revoke_ready");
+    capsend_mc_deliver_done(relay, SYS_ERR_OK);
 }
 
 void
-revoke_ready__rx(struct intermon_binding *b, genvaddr_t st)
+revoke_ready__rx(struct capsend_mc_st *mc_st, errval_t status, coreid_t core)
 {
     DEBUG_CAPOPS("%s\n", __FUNCTION__);
     errval_t err;
 
-    struct revoke_master_st *rvk_st = (struct revoke_master_st*)(lvaddr_t)st;
+    struct revoke_master_st *rvk_st = revoke_master_from_mc(mc_st);
     if (!capsend_handle_mc_reply(&rvk_st->revoke_mc_st)) {
         DEBUG_CAPOPS("%s: waiting for remote cores\n", __FUNCTION__);
         // multicast not complete
@@ -316,7 +276,7 @@ revoke_ready__rx(struct intermon_binding *b, genvaddr_t st)
     }
 
     DEBUG_CAPOPS("%s ## revocation: commit phase\n", __FUNCTION__);
-    err = capsend_relations(&rvk_st->rawcap, revoke_commit__send,
+    err = capsend_relations(&rvk_st->rawcap, CAPSEND_MC_REVOKE_COMMIT,
             &rvk_st->revoke_mc_st, &rvk_st->dests);
     PANIC_IF_ERR(err, "enqueing revoke_commit multicast");
 
@@ -327,28 +287,23 @@ revoke_ready__rx(struct intermon_binding *b, genvaddr_t st)
     delete_queue_wait(&rvk_st->del_qn, steps_fin_cont);
 }
 
-static errval_t
-revoke_commit__send(struct intermon_binding *b,
-                    intermon_caprep_t *caprep,
-                    struct capsend_mc_st *mc_st)
-{
-    struct revoke_master_st *st;
-    ptrdiff_t off = offsetof(struct revoke_master_st, revoke_mc_st);
-    st = (struct revoke_master_st*)((char*)mc_st - off);
-    return intermon_capops_revoke_commit__tx(b, NOP_CONT, (lvaddr_t)st);
-}
-
 void
-revoke_commit__rx(struct intermon_binding *b,
-                  genvaddr_t st)
+revoke_commit__rx(coreid_t from, intermon_caprep_t *caprep, genvaddr_t st,
+                  struct capsend_mc_st *relay)
 {
-    assert(slaves_head);
-    assert(slaves_tail);
-    assert(!slaves_tail->next);
-
     struct revoke_slave_st *rvk_st = slaves_head;
-    while (rvk_st && rvk_st->st != st) { rvk_st = rvk_st->next; }
-    assert(rvk_st);
+    while (rvk_st && (rvk_st->st != st || rvk_st->from != from)) {
+        rvk_st = rvk_st->next;
+    }
+    if (!rvk_st) {
+        // we did not take part in the mark phase (e.g. our monitor was not
+        // ready yet when it was multicast), so there is nothing to commit
+        DEBUG_CAPOPS("%s: no mark phase on core %d\n", __FUNCTION__,
+                     disp_get_core_id());
+        capsend_mc_deliver_done(relay, SYS_ERR_OK);
+        return;
+    }
+    rvk_st->relay = relay;
 
     delete_steps_resume();
 
@@ -357,17 +312,6 @@ revoke_commit__rx(struct intermon_binding *b,
     delete_queue_wait(&rvk_st->del_qn, steps_fin_cont);
 }
 
-static void
-revoke_slave_steps__fin(void *st)
-{
-    errval_t err;
-    struct revoke_slave_st *rvk_st = (struct revoke_slave_st*)st;
-
-    rvk_st->im_qn.cont = revoke_done__send;
-    err = capsend_target(rvk_st->from, (struct msg_queue_elem*)rvk_st);
-    PANIC_IF_ERR(err, "enqueueing revoke_done");
-}
-
 inline static void
 remove_slave_from_list(struct revoke_slave_st *rvk_st)
 {
@@ -404,36 +348,23 @@ remove_slave_from_list(struct revoke_slave_st *rvk_st)
 }
 
 static void
-revoke_done__send(struct intermon_binding *b,
-                  struct intermon_msg_queue_elem *e)
+revoke_slave_steps__fin(void *st)
 {
-    errval_t err;
-    struct revoke_slave_st *rvk_st = (struct revoke_slave_st*)e;
-    err = intermon_capops_revoke_done__tx(b, NOP_CONT, rvk_st->st);
-
-    if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
-        DEBUG_CAPOPS("%s: got FLOUNDER_ERR_TX_BUSY; requeueing msg.\n", __FUNCTION__);
-        struct intermon_state *inter_st = (struct intermon_state *)b->st;
-        // requeue send request at front and return
-        err = intermon_enqueue_send_at_front(b, &inter_st->queue, b->waitset,
-                                             (struct msg_queue_elem *)e);
-        GOTO_IF_ERR(err, handle_err);
-        return;
-    }
+    struct revoke_slave_st *rvk_st = (struct revoke_slave_st*)st;
+    struct capsend_mc_st *relay = rvk_st->relay;
 
-handle_err:
-    PANIC_IF_ERR(err, "sending revoke_done");
     remove_slave_from_list(rvk_st);
     free(rvk_st);
+
+    capsend_mc_deliver_done(relay, SYS_ERR_OK);
 }
 
 void
-revoke_done__rx(struct intermon_binding *b,
-                genvaddr_t st)
+revoke_done__rx(struct capsend_mc_st *mc_st, errval_t status, coreid_t core)
 {
     DEBUG_CAPOPS("%s\n", __FUNCTION__);
 
-    struct revoke_master_st *rvk_st = (struct revoke_master_st*)(lvaddr_t)st;
+    struct revoke_master_st *rvk_st = revoke_master_from_mc(mc_st);
 
     if (!capsend_handle_mc_reply(&rvk_st->revoke_mc_st)) {
         // multicast not complete
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012 ETH Zurich.
+ * Copyright (c) 2012, 2016 ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -19,11 +19,33 @@
 struct capsend_mc_msg_st;
 struct capsend_mc_st;
 
-typedef errval_t (*capsend_send_fn)(struct intermon_binding* /*binding*/,
-                                    intermon_caprep_t* /*caprep*/,
-                                    struct capsend_mc_st* /*user_st*/);
+/**
+ * Operations that are multicast to other monitors. The multicast is relayed
+ * along a tree and every inner node combines the results of its subtree.
+ */
+enum capsend_mc_op {
+    CAPSEND_MC_FIND_CAP,
+    CAPSEND_MC_FIND_DESCENDANTS,
+    CAPSEND_MC_UPDATE_OWNER,
+    CAPSEND_MC_DELETE_REMOTE,
+    CAPSEND_MC_REVOKE_MARK,
+    CAPSEND_MC_REVOKE_COMMIT,
+    CAPSEND_MC_OP_COUNT
+};
+
+/* called for every (combined) reply, core is the core that found the cap */
+typedef void (*capsend_mc_result_fn)(struct capsend_mc_st* /*mc_st*/,
+                                     errval_t /*status*/,
+                                     coreid_t /*core*/);
+
+/* performs the operation on the local core, see capsend_mc_deliver_done() */
+typedef void (*capsend_mc_deliver_fn)(coreid_t /*origin*/,
+                                      intermon_caprep_t* /*caprep*/,
+                                      genvaddr_t /*st*/,
+                                      struct capsend_mc_st* /*relay*/);
 
 bool capsend_handle_mc_reply(struct capsend_mc_st *mc_st); /* returns true if was last reply */
+void capsend_mc_deliver_done(struct capsend_mc_st *relay, errval_t status);
 
 struct capsend_destset {
     coreid_t *set;
@@ -36,8 +58,11 @@ struct capsend_mc_st {
     int num_pending;
     int num_queued;
     bool do_send;
+    uint8_t op;
+    coreid_t origin;
     intermon_caprep_t caprep;
-    capsend_send_fn send_fn;
+    genvaddr_t st;
+    capsend_mc_result_fn result_fn;
 };
 
 errval_t capsend_target(coreid_t dest,
@@ -50,11 +75,11 @@ errval_t capsend_update_owner(struct domcapref capref,
                               struct event_closure continuation);
 
 errval_t capsend_copies(struct capability *cap,
-                        capsend_send_fn send_fn,
+                        enum capsend_mc_op op,
                         struct capsend_mc_st *mc_st);
 
 errval_t capsend_relations(struct capability *cap,
-                           capsend_send_fn send_fn,
+                           enum capsend_mc_op op,
                            struct capsend_mc_st *mc_st,
                            struct capsend_destset *dests);
 
@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2007, 2008, 2009, 2010, 2011, ETH Zurich.
+ * Copyright (c) 2007, 2008, 2009, 2010, 2011, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -151,6 +151,7 @@ errval_t ump_monitor_init(struct monitor_binding *mb);
 errval_t multihop_intermon_init(struct intermon_binding *ib);
 errval_t multihop_monitor_init(struct monitor_binding *mb);
 errval_t multihop_request_routing_table(struct intermon_binding *b);
+coreid_t multihop_get_next_hop(coreid_t dest);
 
 /* trace_support.c */
 errval_t trace_intermon_init(struct intermon_binding *ib);
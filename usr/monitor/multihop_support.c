@@ -4,7 +4,7 @@
  */
 
 /*
- * Copyright (c) 2009, 2010, ETH Zurich.
+ * Copyright (c) 2009, 2010, 2016, ETH Zurich.
  * All rights reserved.
  *
  * This file is distributed under the terms in the attached LICENSE file.
@@ -13,7 +13,7 @@
  */
 
 #include "monitor.h"
-#include <collections/hash_table.h>
+#include <collections/hash_map.h>
 #include <bench/bench.h>
 #include <barrelfish/multihop_chan.h>
 
@@ -292,6 +292,17 @@ static inline coreid_t get_next_hop(coreid_t dest)
     }
 }
 
+/**
+ * \brief Returns the next hop on the route to a core
+ *
+ * Without a routing table (or for cores outside of it) this is the
+ * destination itself.
+ */
+coreid_t multihop_get_next_hop(coreid_t dest)
+{
+    return get_next_hop(dest);
+}
+
 ///////////////////////////////////////////////////////
 
 // FORWARDING (HASH) TABLE
@@ -303,7 +314,7 @@ static inline coreid_t get_next_hop(coreid_t dest)
  * We use a hash table to map virtual circuit identifiers (VCIs)
  * to a pointer to the channel state.
  */
-static collections_hash_table *forwarding_table;
+static collections_hash_map *forwarding_table;
 
 // is forwarding table initialized?
 static bool is_forwarding_table_initialized = false;
@@ -316,8 +327,9 @@ static inline void init_forwarding_table(void)
 
     if (!is_forwarding_table_initialized) {
         is_forwarding_table_initialized = true;
-        collections_hash_create_with_buckets(&forwarding_table,
-                MULTIHOP_FORWARDING_TABLE_BUCKETS, free);
+        collections_hash_map_create(&forwarding_table,
+                COLLECTIONS_HASH_MAP_KEY_WORD,
+                MULTIHOP_FORWARDING_TABLE_BUCKETS, NULL, free);
 
         /**
          * We initialize the random function with the current time stamp
@@ -344,10 +356,9 @@ static inline multihop_vci_t forwarding_table_insert(
         // we assign VCIs randomly, but need to
         // make sure, that it is not yet taken
         vci = (multihop_vci_t) rand();
-    } while (collections_hash_find(forwarding_table, vci) != NULL);
+    } while (collections_hash_map_insert(forwarding_table, vci,
+                                         chan_state) != 0);
 
-    // insert into forwarding table
-    collections_hash_insert(forwarding_table, vci, chan_state);
     return vci;
 }
 
@@ -355,7 +366,7 @@ static inline multihop_vci_t forwarding_table_insert(
 static inline void forwarding_table_delete(multihop_vci_t vci)
 {
     assert(is_forwarding_table_initialized);
-    collections_hash_delete(forwarding_table, vci);
+    collections_hash_map_delete(forwarding_table, vci);
 }
 
 // get entry from the forwarding table
@@ -364,7 +375,7 @@ static inline struct monitor_multihop_chan_state* forwarding_table_lookup(
 {
 
     assert(is_forwarding_table_initialized);
-    struct monitor_multihop_chan_state *chan_state = collections_hash_find(forwarding_table,
+    struct monitor_multihop_chan_state *chan_state = collections_hash_map_find(forwarding_table,
             vci);
 
     if (chan_state == NULL) {
@@ -0,0 +1,690 @@
+/**
+ * \file
+ * \brief Trace replay benchmark
+ *
+ * Replays a trace (see trace.c) directly against a directory, without the
+ * master/slave split, so that the same trace can be run on Linux and on the
+ * Barrelfish VFS backends (nfs://, ramfs://, fat16://, fat32://):
+ *
+ *   Linux:      replay-bench <tracefile> <dir> [options]
+ *   Barrelfish: replay-bench <tracefile> <mountdir> <mount-URL> [options]
+ *
+ * Options:
+ *   workers=N  number of workers replaying pids concurrently (default 1)
+ *   think=F    scale the think time between the operations of a pid by F,
+ *              0 replays back to back (default 1, needs a timestamped trace)
+ *   hist       print the latency histograms, not only their percentiles
+ *
+ * Every pid of the trace is a task, tasks are handed to the workers in the
+ * order of their first operation. Files the trace opens without creating
+ * them are created in <dir>/data before the replay starts, large enough for
+ * the reads and seeks of the trace. Latencies are kept in log2 histograms
+ * per operation type and worker, and merged at the end.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#ifndef __linux__
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/deferred.h>
+#include <vfs/vfs.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "defs.h"
+#include "hash.h"
+#include "trace.h"
+
+#define MAX_WORKERS     64
+#define MAX_FD_CONV     256
+#define MAX_DATA        (2*1024*1024)
+#define MAX_FILE_SIZE   (64*1024*1024)
+#define HIST_BUCKETS    48      /* bucket i: [2^i, 2^(i+1)) ns */
+
+/* a pid of the trace */
+struct task {
+    int pid;
+    struct trace_list trace_l;
+    size_t tentries_nr;
+};
+
+/* a file that has to exist before the replay */
+struct data_file {
+    size_t fnum;
+    size_t size;
+};
+
+struct histogram {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t buckets[HIST_BUCKETS];
+};
+
+struct worker {
+    int id;
+    char *buf;
+    struct histogram hist[TOPs_Total];
+    uint64_t fails[TOPs_Total];
+    uint64_t think_ns;
+    size_t tasks;
+#ifndef __linux__
+    struct thread *thread;
+#else
+    pthread_t thread;
+#endif
+};
+
+static struct {
+    const char *dir;
+    struct task *tasks;
+    int tasks_nr;
+    volatile int next_task;
+    double think_scale;
+    int nworkers;
+    struct worker workers[MAX_WORKERS];
+} Bench;
+
+/*
+ * Platform glue
+ */
+
+#ifndef __linux__
+static const char platform_str[] = "barrelfish";
+static uint64_t tscperms;
+
+/* The VFS backends are not safe for concurrent calls from the threads of a
+ * domain, operations are serialized. Think times still overlap. */
+static struct thread_mutex fs_lock;
+
+static inline uint64_t now_ns(void)
+{
+    uint64_t ticks = rdtsc();
+    return (ticks / tscperms) * 1000000 + ((ticks % tscperms) * 1000000) / tscperms;
+}
+
+static inline void think(uint64_t us)
+{
+    errval_t err = barrelfish_usleep(us);
+    assert(err_is_ok(err));
+}
+
+static inline void fs_enter(void)
+{
+    thread_mutex_lock(&fs_lock);
+}
+
+static inline void fs_leave(void)
+{
+    thread_mutex_unlock(&fs_lock);
+}
+#else
+static const char platform_str[] = "linux";
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void think(uint64_t us)
+{
+    usleep(us);
+}
+
+static inline void fs_enter(void)
+{
+}
+
+static inline void fs_leave(void)
+{
+}
+#endif
+
+/*
+ * Histograms
+ */
+
+static inline void
+hist_add(struct histogram *h, uint64_t ns)
+{
+    int b = 63 - __builtin_clzll(ns | 1);
+    if (b >= HIST_BUCKETS) {
+        b = HIST_BUCKETS - 1;
+    }
+    h->buckets[b]++;
+    h->count++;
+    h->sum_ns += ns;
+    if (ns > h->max_ns) {
+        h->max_ns = ns;
+    }
+}
+
+static void
+hist_merge(struct histogram *dst, const struct histogram *src)
+{
+    for (int i=0; i < HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum_ns += src->sum_ns;
+    if (src->max_ns > dst->max_ns) {
+        dst->max_ns = src->max_ns;
+    }
+}
+
+/* upper bound of the bucket holding the given percentile (nearest rank) */
+static uint64_t
+hist_percentile(const struct histogram *h, double pct)
+{
+    uint64_t rank = (uint64_t)ceil(pct / 100.0 * h->count);
+    uint64_t seen = 0;
+
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > h->count) {
+        rank = h->count;
+    }
+    for (int i=0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t bound = 2ULL << i;
+            return bound < h->max_ns ? bound : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
+
+static void
+hist_print(const struct histogram *h)
+{
+    for (int i=0; i < HIST_BUCKETS; i++) {
+        if (h->buckets[i] == 0) {
+            continue;
+        }
+        printf("    [%12.3lf, %12.3lf) us %10" PRIu64 "\n",
+               (double)(1ULL << i) / 1000.0, (double)(2ULL << i) / 1000.0,
+               h->buckets[i]);
+    }
+}
+
+/*
+ * Tasks and data files
+ */
+
+static void
+build_tasks(struct trace_list *tl)
+{
+    hash_t *pids_h = hash_init(TOTAL_PIDS); /* pid -> task index */
+    struct trace_entry *te, *te_next;
+    int tasks_size = TOTAL_PIDS;
+
+    Bench.tasks = calloc(tasks_size, sizeof(struct task));
+    assert(Bench.tasks != NULL);
+
+    for (te = tl->head; te != NULL; te = te_next) {
+        te_next = te->next;
+
+        struct task *t;
+        unsigned long idx = hash_lookup(pids_h, te->pid);
+        if (idx == HASH_ENTRY_NOTFOUND) {
+            if (Bench.tasks_nr == tasks_size) {
+                tasks_size *= 2;
+                Bench.tasks = realloc(Bench.tasks, tasks_size*sizeof(struct task));
+                assert(Bench.tasks != NULL);
+            }
+            idx = Bench.tasks_nr++;
+            t = Bench.tasks + idx;
+            memset(t, 0, sizeof(*t));
+            t->pid = te->pid;
+            hash_insert(pids_h, te->pid, idx);
+        } else {
+            t = Bench.tasks + idx;
+        }
+
+        trace_add_tail(&t->trace_l, te);
+        t->tentries_nr++;
+    }
+
+    tl->head = tl->tail = NULL;
+    hash_destroy(pids_h);
+}
+
+/* Follow the file positions of every task to find out which files have to
+ * exist and how large they have to be. */
+static struct data_file *
+find_data_files(int *nfiles)
+{
+    hash_t *files_h = hash_init(TOTAL_PIDS); /* fnum -> data_file index */
+    int files_size = 1024, files_nr = 0;
+    struct data_file *files = malloc(files_size * sizeof(struct data_file));
+    assert(files != NULL);
+
+    for (int i=0; i < Bench.tasks_nr; i++) {
+        struct data_file *fd2file[MAX_FD_CONV] = { NULL };
+        size_t pos[MAX_FD_CONV] = { 0 };
+
+        for (struct trace_entry *te = Bench.tasks[i].trace_l.head; te != NULL;
+             te = te->next) {
+            if (te->fd < 0 || te->fd >= MAX_FD_CONV) {
+                continue;
+            }
+
+            switch (te->op) {
+            case TOP_Open: {
+                unsigned long idx = hash_lookup(files_h, te->u.fnum);
+                if (idx == HASH_ENTRY_NOTFOUND) {
+                    if (files_nr == files_size) {
+                        files_size *= 2;
+                        files = realloc(files, files_size*sizeof(struct data_file));
+                        assert(files != NULL);
+                    }
+                    idx = files_nr++;
+                    files[idx].fnum = te->u.fnum;
+                    files[idx].size = 0;
+                    hash_insert(files_h, te->u.fnum, idx);
+                }
+                fd2file[te->fd] = files + idx;
+                pos[te->fd] = 0;
+                break;
+            }
+
+            case TOP_Create:
+                fd2file[te->fd] = NULL;
+                break;
+
+            case TOP_Seek:
+                pos[te->fd] = te->u.size;
+                break;
+
+            case TOP_Read:
+            case TOP_Write:
+                pos[te->fd] += te->u.size;
+                if (te->op == TOP_Read && fd2file[te->fd] != NULL &&
+                    fd2file[te->fd]->size < pos[te->fd]) {
+                    fd2file[te->fd]->size = pos[te->fd];
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    hash_destroy(files_h);
+    *nfiles = files_nr;
+    return files;
+}
+
+static void
+create_data_files(char *buf)
+{
+    char fname[256];
+    int nfiles;
+    struct data_file *files = find_data_files(&nfiles);
+
+    snprintf(fname, sizeof(fname), "%s/data", Bench.dir);
+    if (mkdir(fname, S_IRWXU) != 0 && errno != EEXIST) {
+        perror(fname);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("creating %d data files...\n", nfiles);
+    memset(buf, 'x', MAX_DATA);
+    for (int i=0; i < nfiles; i++) {
+        size_t size = files[i].size;
+        if (size > MAX_FILE_SIZE) {
+            size = MAX_FILE_SIZE;
+        }
+
+        snprintf(fname, sizeof(fname), "%s/data/%zu", Bench.dir, files[i].fnum);
+        int fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+        if (fd < 0) {
+            perror(fname);
+            exit(EXIT_FAILURE);
+        }
+        while (size > 0) {
+            size_t n = size < MAX_DATA ? size : MAX_DATA;
+            ssize_t ret = write(fd, buf, n);
+            if (ret <= 0) {
+                perror(fname);
+                exit(EXIT_FAILURE);
+            }
+            size -= ret;
+        }
+        close(fd);
+    }
+    free(files);
+}
+
+/*
+ * Replay
+ */
+
+static bool
+do_op(struct worker *w, struct trace_entry *te, int *fds)
+{
+    const int open_mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+    char fname[256];
+    int open_flags = 0;
+    ssize_t ret;
+
+    if (te->op != TOP_Unlink && te->op != TOP_Exit &&
+        (te->fd < 0 || te->fd >= MAX_FD_CONV)) {
+        return false;
+    }
+
+    switch (te->op) {
+    case TOP_Create:
+        open_flags = O_CREAT;
+    /* fallthrough */
+    case TOP_Open:
+        switch (te->mode) {
+        case FLAGS_RdOnly:
+            open_flags |= O_RDONLY;
+            break;
+
+        case FLAGS_WrOnly:
+            open_flags |= O_WRONLY;
+            break;
+
+        case FLAGS_RdWr:
+            open_flags |= O_RDWR;
+            break;
+        }
+        snprintf(fname, sizeof(fname), "%s/data/%zu", Bench.dir, te->u.fnum);
+        fds[te->fd] = open(fname, open_flags, open_mode);
+        return fds[te->fd] >= 0;
+
+    case TOP_Unlink:
+        snprintf(fname, sizeof(fname), "%s/data/%zu", Bench.dir, te->u.fnum);
+        return unlink(fname) == 0;
+
+    case TOP_Read:
+    case TOP_Write: {
+        size_t rem = te->u.size;
+        while (rem > 0) {
+            size_t n = rem < MAX_DATA ? rem : MAX_DATA;
+            if (te->op == TOP_Read) {
+                ret = read(fds[te->fd], w->buf, n);
+            } else {
+                ret = write(fds[te->fd], w->buf, n);
+            }
+            if (ret < 0) {
+                return false;
+            } else if (ret == 0) {
+                break; /* end of file */
+            }
+            rem -= ret;
+        }
+        return true;
+    }
+
+    case TOP_Seek:
+        return lseek(fds[te->fd], te->u.size, SEEK_SET) == te->u.size;
+
+    case TOP_Close:
+        ret = close(fds[te->fd]);
+        fds[te->fd] = -1;
+        return ret == 0;
+
+    case TOP_Exit:
+        /* the process exits, close what the trace left open */
+        for (int fd=0; fd < MAX_FD_CONV; fd++) {
+            if (fds[fd] >= 0) {
+                close(fds[fd]);
+                fds[fd] = -1;
+            }
+        }
+        return true;
+
+    default:
+        assert(0);
+        return false;
+    }
+}
+
+static void
+replay_task(struct worker *w, struct task *t)
+{
+    int fds[MAX_FD_CONV];
+    uint64_t prev_ts = 0;
+    bool have_prev = false;
+
+    for (int fd=0; fd < MAX_FD_CONV; fd++) {
+        fds[fd] = -1;
+    }
+
+    for (struct trace_entry *te = t->trace_l.head; te != NULL; te = te->next) {
+        if (Bench.think_scale > 0 && have_prev && te->ts > prev_ts) {
+            uint64_t us = (uint64_t)((te->ts - prev_ts) * Bench.think_scale);
+            if (us > 0) {
+                think(us);
+                w->think_ns += us * 1000;
+            }
+        }
+        prev_ts = te->ts;
+        have_prev = true;
+
+        /* some traces miss the close of a reused fd */
+        if ((te->op == TOP_Open || te->op == TOP_Create) &&
+            te->fd >= 0 && te->fd < MAX_FD_CONV && fds[te->fd] >= 0) {
+            close(fds[te->fd]);
+            fds[te->fd] = -1;
+        }
+
+        fs_enter();
+        uint64_t start = now_ns();
+        bool ok = do_op(w, te, fds);
+        uint64_t ns = now_ns() - start;
+        fs_leave();
+
+        hist_add(&w->hist[te->op], ns);
+        if (!ok) {
+            w->fails[te->op]++;
+            dmsg("worker %d: pid:%d op:%s line:%d failed\n", w->id, t->pid,
+                 top2str[te->op], te->fline);
+        }
+    }
+
+    /* trace ended without exit */
+    for (int fd=0; fd < MAX_FD_CONV; fd++) {
+        if (fds[fd] >= 0) {
+            close(fds[fd]);
+        }
+    }
+}
+
+static int
+worker_run(void *arg)
+{
+    struct worker *w = arg;
+
+    for (;;) {
+        int idx = __sync_fetch_and_add(&Bench.next_task, 1);
+        if (idx >= Bench.tasks_nr) {
+            break;
+        }
+        replay_task(w, Bench.tasks + idx);
+        w->tasks++;
+    }
+    return 0;
+}
+
+#ifdef __linux__
+static void *
+worker_pthread(void *arg)
+{
+    worker_run(arg);
+    return NULL;
+}
+#endif
+
+static void
+workers_run(void)
+{
+    for (int i=0; i < Bench.nworkers; i++) {
+        struct worker *w = Bench.workers + i;
+#ifndef __linux__
+        w->thread = thread_create(worker_run, w);
+        assert(w->thread != NULL);
+#else
+        int ret = pthread_create(&w->thread, NULL, worker_pthread, w);
+        assert(ret == 0);
+#endif
+    }
+
+    for (int i=0; i < Bench.nworkers; i++) {
+#ifndef __linux__
+        errval_t err = thread_join(Bench.workers[i].thread, NULL);
+        assert(err_is_ok(err));
+#else
+        pthread_join(Bench.workers[i].thread, NULL);
+#endif
+    }
+}
+
+static void
+print_results(uint64_t wall_ns, bool print_hist)
+{
+    struct histogram total[TOPs_Total];
+    uint64_t fails[TOPs_Total] = { 0 };
+    uint64_t ops = 0, think_ns = 0;
+
+    memset(total, 0, sizeof(total));
+    for (int i=0; i < Bench.nworkers; i++) {
+        struct worker *w = Bench.workers + i;
+        for (int op=0; op < TOPs_Total; op++) {
+            hist_merge(&total[op], &w->hist[op]);
+            fails[op] += w->fails[op];
+        }
+        think_ns += w->think_ns;
+        printf("worker %2d: %6zu tasks\n", i, w->tasks);
+    }
+
+    printf("%-8s %10s %8s %11s %11s %11s %11s %11s\n", "op", "count",
+           "fails", "avg[us]", "p50[us]", "p90[us]", "p99[us]", "max[us]");
+    for (int op=0; op < TOPs_Total; op++) {
+        struct histogram *h = &total[op];
+        if (h->count == 0) {
+            continue;
+        }
+        ops += h->count;
+        printf("%-8s %10" PRIu64 " %8" PRIu64 " %11.3lf %11.3lf %11.3lf "
+               "%11.3lf %11.3lf\n", top2str[op], h->count, fails[op],
+               (double)h->sum_ns / h->count / 1000.0,
+               hist_percentile(h, 50) / 1000.0,
+               hist_percentile(h, 90) / 1000.0,
+               hist_percentile(h, 99) / 1000.0,
+               h->max_ns / 1000.0);
+        if (print_hist) {
+            hist_print(h);
+        }
+    }
+
+    printf("[REPLAY] %s dir:%s workers:%d think:%.2lf tasks:%d ops:%" PRIu64
+           " time:%.3lf ms (%.0lf ops/s, think %.3lf ms)\n", platform_str,
+           Bench.dir, Bench.nworkers, Bench.think_scale, Bench.tasks_nr, ops,
+           wall_ns / 1e6, ops / (wall_ns / 1e9), think_ns / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+    bool print_hist = false;
+    int argi;
+
+#ifndef __linux__
+    if (argc < 4) {
+        printf("Usage: %s tracefile mountdir mount-URL [workers=N] [think=F]"
+               " [hist]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    errval_t err = sys_debug_get_tsc_per_ms(&tscperms);
+    assert(err_is_ok(err));
+    thread_mutex_init(&fs_lock);
+
+    err = vfs_mkdir(argv[2]);
+    if (err_is_fail(err) && err_no(err) != FS_ERR_EXISTS) {
+        USER_PANIC_ERR(err, "vfs_mkdir");
+    }
+    err = vfs_mount(argv[2], argv[3]);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "vfs_mount");
+    }
+    argi = 4;
+#else
+    if (argc < 3) {
+        printf("Usage: %s tracefile dir [workers=N] [think=F] [hist]\n",
+               argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    argi = 3;
+#endif
+
+    memset(&Bench, 0, sizeof(Bench));
+    Bench.dir = argv[2];
+    Bench.nworkers = 1;
+    Bench.think_scale = 1.0;
+
+    for (; argi < argc; argi++) {
+        if (strncmp(argv[argi], "workers=", strlen("workers=")) == 0) {
+            Bench.nworkers = atoi(argv[argi] + strlen("workers="));
+        } else if (strncmp(argv[argi], "think=", strlen("think=")) == 0) {
+            Bench.think_scale = atof(argv[argi] + strlen("think="));
+        } else if (strcmp(argv[argi], "hist") == 0) {
+            print_hist = true;
+        } else {
+            printf("unknown argument '%s'\n", argv[argi]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (Bench.nworkers < 1 || Bench.nworkers > MAX_WORKERS ||
+        Bench.think_scale < 0) {
+        printf("invalid arguments\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct trace_list tlist = {.head = NULL, .tail = NULL};
+    parse_tracefile(argv[1], &tlist);
+    build_tasks(&tlist);
+
+    for (int i=0; i < Bench.nworkers; i++) {
+        Bench.workers[i].id = i;
+        Bench.workers[i].buf = malloc(MAX_DATA);
+        assert(Bench.workers[i].buf != NULL);
+    }
+    create_data_files(Bench.workers[0].buf);
+
+    printf("replaying %d tasks with %d workers...\n", Bench.tasks_nr,
+           Bench.nworkers);
+    uint64_t start = now_ns();
+    workers_run();
+    uint64_t wall_ns = now_ns() - start;
+
+    print_results(wall_ns, print_hist);
+    return 0;
+}
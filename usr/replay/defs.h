@@ -53,6 +53,7 @@ struct trace_entry {
     enum flags mode;
     int pid;
     int fline;
+    uint64_t ts; /* usecs since the start of the trace, 0 if not traced */
 
     struct trace_entry *next;
 };
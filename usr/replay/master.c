@@ -27,33 +27,14 @@ static const char vfs_cache_str[] = "linux (TCP/IP)";
 
 #include "defs.h"
 #include "hash.h"
+#include "trace.h"
 
-#define MAX_LINE        1024
 #define MAX_SLAVES      64
 #define MAX_DEPS        60
 #define BULK_BLOCK_SIZE (4096*256) // 1MiB
 #define BULK_BLOCKS_NR  1
 #define BULK_TOTAL_SIZE (BULK_BLOCK_SIZE*BULK_BLOCKS_NR)
 
-/* TRACE LIST */
-
-struct trace_list {
-    struct trace_entry *head, *tail;
-};
-
-static inline void trace_add_tail(struct trace_list *tl, struct trace_entry *te)
-{
-    te->next = NULL;
-
-    if (tl->head == NULL) {
-        tl->head = te;
-    } else {
-        tl->tail->next = te;
-    }
-
-    tl->tail = te;
-}
-
 /* PID ENTRIES (TASKS) */
 
 struct slave; /* forward reference */
@@ -331,103 +312,6 @@ pentry_add_dependency(struct pid_entry *parent, struct pid_entry *child)
     child->parents_nr++;
 }
 
-//static struct pid_entry *allpids[nOTAL_PIDS];
-
-static void
-parse_tracefile_line(char *line, int linen, struct trace_entry *te)
-{
-        size_t fnum, size;
-        char flags[1024];
-        int fd;
-        unsigned int pid;
-
-        if(sscanf(line, "open %zu %s %d %u", &fnum, flags, &fd, &pid) >= 4) {
-            te->op = TOP_Open;
-            te->fd = fd;
-            te->u.fnum = fnum;
-        } else if(sscanf(line, "close %d %u", &fd, &pid) >= 2) {
-            te->op = TOP_Close;
-            te->fd = fd;
-        } else if(sscanf(line, "read %d %zu %u", &fd, &size, &pid) >= 3) {
-            te->op = TOP_Read;
-            te->fd = fd;
-            te->u.size = size;
-        } else if(sscanf(line, "write %d %zu %u", &fd, &size, &pid) >= 3) {
-            te->op = TOP_Write;
-            te->fd = fd;
-            te->u.size = size;
-        } else if(sscanf(line, "seek %d %zu %u", &fd, &size, &pid) >= 3) {
-            te->op = TOP_Seek;
-            te->fd = fd;
-            te->u.size = size;
-        } else if(sscanf(line, "creat %zu %s %d %u", &fnum, flags, &fd, &pid) >= 4) {
-            te->op = TOP_Create;
-            te->fd = fd;
-            te->u.fnum = fnum;
-        } else if(sscanf(line, "unlink %zu %s %u", &fnum, flags, &pid) >= 3) {
-            te->op = TOP_Unlink;
-            te->u.fnum = fnum;
-        } else if(sscanf(line, "exit %u", &pid) >= 1) {
-            te->op = TOP_Exit;
-        } else {
-            printf("Invalid line %d: %s\n", linen, line);
-            exit(EXIT_FAILURE);
-        }
-
-        // There's always a PID
-        te->pid = pid;
-        assert(pid != 0);
-        te->fline = linen;
-
-        // If we have flags, set them now
-        if(te->op == TOP_Open || te->op == TOP_Create) {
-            if(!strcmp(flags, "rdonly")) {
-                te->mode = FLAGS_RdOnly;
-            } else if(!strcmp(flags, "wronly")) {
-                te->mode = FLAGS_WrOnly;
-            } else if(!strcmp(flags, "rdwr")) {
-                te->mode = FLAGS_RdWr;
-            } else {
-                printf("Invalid open flags: %s\n", flags);
-                exit(EXIT_FAILURE);
-            }
-        }
-}
-
-static void
-parse_tracefile(const char *tracefile, struct trace_list *tlist)
-{
-    printf("reading tracefile...\n");
-
-    FILE *f = fopen(tracefile, "r");
-    assert(f != NULL);
-    int linen = 0;
-
-    while(!feof(f)) {
-        char line[MAX_LINE];
-
-        if (fgets(line, MAX_LINE, f) == NULL) {
-            break;
-        }
-
-        linen++;
-        if (linen % 1000 == 0) {
-            printf("---- %s:%s() parsing line = %d\n", __FILE__, __FUNCTION__, linen);
-        }
-
-        struct trace_entry *tentry = malloc(sizeof(struct trace_entry));
-        assert(tentry != NULL);
-
-        // parse current line to tentry
-        parse_tracefile_line(line, linen, tentry);
-
-        // Link it in with the rest of the list (forward order)
-        trace_add_tail(tlist, tentry);
-    }
-    fclose(f);
-    printf("tracefile read [number of lines:%d]\n", linen);
-}
-
 static void
 build_taskgraph(struct trace_list *tl, struct task_graph *tg)
 {
@@ -0,0 +1,134 @@
+/**
+ * \file
+ * \brief Trace file parsing
+ *
+ * One operation per line:
+ *
+ *   open <fnum> rdonly|wronly|rdwr <fd> <pid>
+ *   creat <fnum> rdonly|wronly|rdwr <fd> <pid>
+ *   unlink <fnum> <flags> <pid>
+ *   read|write|seek <fd> <size/offset> <pid>
+ *   close <fd> <pid>
+ *   exit <pid>
+ *
+ * A line may end with "@<usecs>", the time of the operation since the start
+ * of the trace. The benchmark derives the think time between the operations
+ * of a pid from it, traces without timestamps are replayed back to back.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "trace.h"
+
+void
+parse_tracefile_line(char *line, int linen, struct trace_entry *te)
+{
+        size_t fnum, size;
+        char flags[1024];
+        int fd;
+        unsigned int pid;
+
+        if(sscanf(line, "open %zu %s %d %u", &fnum, flags, &fd, &pid) >= 4) {
+            te->op = TOP_Open;
+            te->fd = fd;
+            te->u.fnum = fnum;
+        } else if(sscanf(line, "close %d %u", &fd, &pid) >= 2) {
+            te->op = TOP_Close;
+            te->fd = fd;
+        } else if(sscanf(line, "read %d %zu %u", &fd, &size, &pid) >= 3) {
+            te->op = TOP_Read;
+            te->fd = fd;
+            te->u.size = size;
+        } else if(sscanf(line, "write %d %zu %u", &fd, &size, &pid) >= 3) {
+            te->op = TOP_Write;
+            te->fd = fd;
+            te->u.size = size;
+        } else if(sscanf(line, "seek %d %zu %u", &fd, &size, &pid) >= 3) {
+            te->op = TOP_Seek;
+            te->fd = fd;
+            te->u.size = size;
+        } else if(sscanf(line, "creat %zu %s %d %u", &fnum, flags, &fd, &pid) >= 4) {
+            te->op = TOP_Create;
+            te->fd = fd;
+            te->u.fnum = fnum;
+        } else if(sscanf(line, "unlink %zu %s %u", &fnum, flags, &pid) >= 3) {
+            te->op = TOP_Unlink;
+            te->u.fnum = fnum;
+        } else if(sscanf(line, "exit %u", &pid) >= 1) {
+            te->op = TOP_Exit;
+        } else {
+            printf("Invalid line %d: %s\n", linen, line);
+            exit(EXIT_FAILURE);
+        }
+
+        // There's always a PID
+        te->pid = pid;
+        assert(pid != 0);
+        te->fline = linen;
+
+        // Optional timestamp at the end of the line
+        char *ts = strchr(line, '@');
+        te->ts = (ts != NULL) ? strtoull(ts + 1, NULL, 10) : 0;
+
+        // If we have flags, set them now
+        if(te->op == TOP_Open || te->op == TOP_Create) {
+            if(!strcmp(flags, "rdonly")) {
+                te->mode = FLAGS_RdOnly;
+            } else if(!strcmp(flags, "wronly")) {
+                te->mode = FLAGS_WrOnly;
+            } else if(!strcmp(flags, "rdwr")) {
+                te->mode = FLAGS_RdWr;
+            } else {
+                printf("Invalid open flags: %s\n", flags);
+                exit(EXIT_FAILURE);
+            }
+        }
+}
+
+void
+parse_tracefile(const char *tracefile, struct trace_list *tlist)
+{
+    printf("reading tracefile...\n");
+
+    FILE *f = fopen(tracefile, "r");
+    assert(f != NULL);
+    int linen = 0;
+
+    while(!feof(f)) {
+        char line[MAX_LINE];
+
+        if (fgets(line, MAX_LINE, f) == NULL) {
+            break;
+        }
+
+        linen++;
+        if (linen % 1000 == 0) {
+            printf("---- %s:%s() parsing line = %d\n", __FILE__, __FUNCTION__, linen);
+        }
+
+        struct trace_entry *tentry = malloc(sizeof(struct trace_entry));
+        assert(tentry != NULL);
+
+        // parse current line to tentry
+        parse_tracefile_line(line, linen, tentry);
+
+        // Link it in with the rest of the list (forward order)
+        trace_add_tail(tlist, tentry);
+    }
+    fclose(f);
+    printf("tracefile read [number of lines:%d]\n", linen);
+}
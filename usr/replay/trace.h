@@ -0,0 +1,44 @@
+/**
+ * \file
+ * \brief Trace file parsing, shared by the replay master and benchmark
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "defs.h"
+
+#define MAX_LINE        1024
+
+/* TRACE LIST */
+
+struct trace_list {
+    struct trace_entry *head, *tail;
+};
+
+static inline void trace_add_tail(struct trace_list *tl, struct trace_entry *te)
+{
+    te->next = NULL;
+
+    if (tl->head == NULL) {
+        tl->head = te;
+    } else {
+        tl->tail->next = te;
+    }
+
+    tl->tail = te;
+}
+
+void parse_tracefile_line(char *line, int linen, struct trace_entry *te);
+void parse_tracefile(const char *tracefile, struct trace_list *tlist);
+
+#endif
@@ -9,6 +9,8 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <barrelfish/barrelfish.h>
@@ -48,9 +50,53 @@ static void init_dmalloc(void)
     alt_realloc = &dlrealloc;
 }
 
+/*
+ * Loads the octopus rules and the predicates implemented in C.
+ */
+static void load_octopus(struct skb_query_state* sqs)
+{
+    errval_t err;
+
+    err = execute_query("[objects3].", sqs);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "skb failed.");
+    }
+    err = execute_query("[pubsub3].", sqs);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "skb failed.");
+    }
+    err = execute_query("[bindings].", sqs);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "skb failed.");
+    }
+    dident e = ec_did("eclipse", 0);
+    //ec_external(ec_did("notify_client", 2), p_notify_client, e);
+    ec_external(ec_did("trigger_watch", 6), p_trigger_watch, e);
+    ec_external(ec_did("save_index", 3), p_save_index, e);
+    ec_external(ec_did("remove_index", 3), p_remove_index, e);
+    ec_external(ec_did("index_intersect", 4), p_index_intersect, e);
+    ec_external(ec_did("bitfield_add", 3), p_bitfield_add, e);
+    ec_external(ec_did("bitfield_remove", 3), p_bitfield_remove, e);
+    ec_external(ec_did("bitfield_union", 4), p_bitfield_union, e);
+    ec_external(ec_did("match", 3), (int (*)()) ec_regmatch, e);
+    ec_external(ec_did("split", 4), (int (*)()) ec_regsplit, e);
+}
+
 int main(int argc, char**argv)
 {
     errval_t err;
+    // Partitioned octopus: number of shards (on core 0) or our shard number
+    size_t octopus_shards = 1;
+    size_t octopus_shard = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "octopus_shards=", 15) == 0) {
+            octopus_shards = strtoul(argv[i] + 15, NULL, 10);
+        } else if (strncmp(argv[i], "octopus_shard=", 14) == 0) {
+            octopus_shard = strtoul(argv[i] + 14, NULL, 10);
+        }
+    }
+
     vfs_init();
     init_dmalloc();
     // we'll be needing this...
@@ -95,34 +141,27 @@ int main(int argc, char**argv)
         //bench_init();
 
         // octopus related stuff
-        err = execute_query("[objects3].", sqs);
-        if (err_is_fail(err)) {
-            USER_PANIC_ERR(err, "skb failed.");
-        }
-        err = execute_query("[pubsub3].", sqs);
-        if (err_is_fail(err)) {
-            USER_PANIC_ERR(err, "skb failed.");
-        }
-        err = execute_query("[bindings].", sqs);
-        if (err_is_fail(err)) {
-            USER_PANIC_ERR(err, "skb failed.");
+        load_octopus(sqs);
+
+        if (octopus_shards > 1) {
+            err = oct_server_set_shard_count(octopus_shards);
+            if (err_is_fail(err)) {
+                USER_PANIC_ERR(err, "setting number of octopus shards");
+            }
         }
-        dident e = ec_did("eclipse", 0);
-        //ec_external(ec_did("notify_client", 2), p_notify_client, e);
-        ec_external(ec_did("trigger_watch", 6), p_trigger_watch, e);
-        ec_external(ec_did("save_index", 3), p_save_index, e);
-        ec_external(ec_did("remove_index", 3), p_remove_index, e);
-        ec_external(ec_did("index_intersect", 4), p_index_intersect, e);
-        ec_external(ec_did("bitfield_add", 3), p_bitfield_add, e);
-        ec_external(ec_did("bitfield_remove", 3), p_bitfield_remove, e);
-        ec_external(ec_did("bitfield_union", 4), p_bitfield_union, e);
-        ec_external(ec_did("match", 3), (int (*)()) ec_regmatch, e);
-        ec_external(ec_did("split", 4), (int (*)()) ec_regsplit, e);
-        // end
 
         errval_t err = oct_server_init();
         assert(err_is_ok(err));
     }
+    else if (octopus_shard > 0) {
+        // Additional octopus server, started on the first core of a socket
+        load_octopus(sqs);
+
+        err = oct_shard_server_init(octopus_shard);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "starting octopus shard %zu", octopus_shard);
+        }
+    }
     if (disp_get_core_id() == 0) {
         skb_server_init();
         SKB_DEBUG("skb initialized\n");
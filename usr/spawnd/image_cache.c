@@ -0,0 +1,115 @@
+/**
+ * \file
+ * \brief Cache of pre-loaded images in spawnd
+ *
+ * Images are keyed by path, size and modification time as reported by
+ * vfs_stat(). Backends that do not track modification times report 0, so
+ * for them a file that is replaced by one of the same size is not detected.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+
+#include "image_cache.h"
+
+struct image_cache_entry {
+    struct image_cache_entry *next;     ///< Next entry in LRU order
+    char *path;
+    size_t size;
+    uint64_t mtime;
+    struct spawn_image *img;
+};
+
+/// Cached images, most recently used first
+static struct image_cache_entry *cache;
+static size_t cache_entries;
+
+static void entry_free(struct image_cache_entry *e)
+{
+    errval_t err = spawn_image_destroy(e->img);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "spawn_image_destroy");
+    }
+    free(e->path);
+    free(e);
+}
+
+/**
+ * \brief Find the image of a file
+ *
+ * Stale entries for \p path are dropped.
+ *
+ * \return The image, or NULL if there is no up-to-date image of the file
+ */
+struct spawn_image *image_cache_lookup(const char *path,
+                                       struct vfs_fileinfo *info)
+{
+    for (struct image_cache_entry **prev = &cache; *prev != NULL;
+         prev = &(*prev)->next) {
+        struct image_cache_entry *e = *prev;
+        if (strcmp(e->path, path) != 0) {
+            continue;
+        }
+
+        *prev = e->next;
+        if (e->size != info->size || e->mtime != info->mtime) {
+            // file has changed
+            entry_free(e);
+            cache_entries--;
+            break;
+        }
+
+        // move to front
+        e->next = cache;
+        cache = e;
+        return e->img;
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Add the image of a file, evicting the least recently used image
+ *        if the cache is full
+ */
+errval_t image_cache_insert(const char *path, struct vfs_fileinfo *info,
+                            struct spawn_image *img)
+{
+    struct image_cache_entry *e = malloc(sizeof(struct image_cache_entry));
+    if (e == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    e->path = strdup(path);
+    if (e->path == NULL) {
+        free(e);
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    e->size = info->size;
+    e->mtime = info->mtime;
+    e->img = img;
+
+    if (cache_entries == IMAGE_CACHE_ENTRIES) {
+        struct image_cache_entry **prev = &cache;
+        while ((*prev)->next != NULL) {
+            prev = &(*prev)->next;
+        }
+        entry_free(*prev);
+        *prev = NULL;
+        cache_entries--;
+    }
+
+    e->next = cache;
+    cache = e;
+    cache_entries++;
+
+    return SYS_ERR_OK;
+}
@@ -0,0 +1,30 @@
+/**
+ * \file
+ * \brief Cache of pre-loaded images in spawnd
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <barrelfish/barrelfish.h>
+#include <spawndomain/spawndomain.h>
+#include <vfs/vfs.h>
+
+/// Maximum number of images kept in the cache
+#define IMAGE_CACHE_ENTRIES 16
+
+struct spawn_image *image_cache_lookup(const char *path,
+                                       struct vfs_fileinfo *info);
+errval_t image_cache_insert(const char *path, struct vfs_fileinfo *info,
+                            struct spawn_image *img);
+
+#endif
@@ -14,6 +14,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 #include <barrelfish/barrelfish.h>
 #include <spawndomain/spawndomain.h>
 #include <barrelfish/nameservice_client.h>
@@ -28,6 +29,7 @@
 
 #include "internal.h"
 #include "ps.h"
+#include "image_cache.h"
 
 
 static errval_t spawn(char *path, char *const argv[], char *argbuf,
@@ -37,7 +39,7 @@ static errval_t spawn(char *path, char *const argv[], char *argbuf,
 {
     errval_t err, msgerr;
 
-    /* read file into memory */
+    /* open file and check if we have it cached */
     vfs_handle_t fh;
     err = vfs_open(path, &fh);
     if (err_is_fail(err)) {
@@ -52,32 +54,6 @@ static errval_t spawn(char *path, char *const argv[], char *argbuf,
     }
 
     assert(info.type == VFS_FILE);
-    uint8_t *image = malloc(info.size);
-    if (image == NULL) {
-        vfs_close(fh);
-        return err_push(err, SPAWN_ERR_LOAD);
-    }
-
-    size_t pos = 0, readlen;
-    do {
-        err = vfs_read(fh, &image[pos], info.size - pos, &readlen);
-        if (err_is_fail(err)) {
-            vfs_close(fh);
-            free(image);
-            return err_push(err, SPAWN_ERR_LOAD);
-        } else if (readlen == 0) {
-            vfs_close(fh);
-            free(image);
-            return SPAWN_ERR_LOAD; // XXX
-        } else {
-            pos += readlen;
-        }
-    } while (err_is_ok(err) && readlen > 0 && pos < info.size);
-
-    err = vfs_close(fh);
-    if (err_is_fail(err)) {
-        DEBUG_ERR(err, "failed to close file %s", path);
-    }
 
     // find short name (last part of path)
     char *name = strrchr(path, VFS_PATH_SEP);
@@ -87,19 +63,89 @@ static errval_t spawn(char *path, char *const argv[], char *argbuf,
         name++;
     }
 
-    /* spawn the image */
+    /* OpenMP programs need the symbols of the binary, so bypass the cache */
+    bool cacheable = !(flags & (SPAWN_FLAGS_OMP | SPAWN_FLAGS_NO_IMAGE_CACHE));
+    struct spawn_image *img = NULL;
+    if (cacheable) {
+        img = image_cache_lookup(path, &info);
+    }
+
     struct spawninfo si;
     si.flags = flags;
-    err = spawn_load_image(&si, (lvaddr_t)image, info.size, CURRENT_CPU_TYPE,
-                           name, my_core_id, argv, envp, inheritcn_cap,
-                           argcn_cap);
-    if (err_is_fail(err)) {
+
+    if (img != NULL) {
+        err = vfs_close(fh);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "failed to close file %s", path);
+        }
+
+        /* spawn from the cached image */
+        err = spawn_load_shared_image(&si, img, name, my_core_id, argv, envp,
+                                      inheritcn_cap, argcn_cap);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    } else {
+        /* read file into memory */
+        uint8_t *image = malloc(info.size);
+        if (image == NULL) {
+            vfs_close(fh);
+            return err_push(err, SPAWN_ERR_LOAD);
+        }
+
+        size_t pos = 0, readlen;
+        do {
+            err = vfs_read(fh, &image[pos], info.size - pos, &readlen);
+            if (err_is_fail(err)) {
+                vfs_close(fh);
+                free(image);
+                return err_push(err, SPAWN_ERR_LOAD);
+            } else if (readlen == 0) {
+                vfs_close(fh);
+                free(image);
+                return SPAWN_ERR_LOAD; // XXX
+            } else {
+                pos += readlen;
+            }
+        } while (err_is_ok(err) && readlen > 0 && pos < info.size);
+
+        err = vfs_close(fh);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "failed to close file %s", path);
+        }
+
+        if (cacheable) {
+            err = spawn_image_create(&img, (lvaddr_t)image, info.size,
+                                     CURRENT_CPU_TYPE);
+            if (err_is_ok(err)) {
+                err = image_cache_insert(path, &info, img);
+                if (err_is_fail(err)) {
+                    spawn_image_destroy(img);
+                    img = NULL;
+                }
+            }
+            if (err_is_fail(err)) {
+                // fall back to loading the binary directly
+                DEBUG_ERR(err, "failed to cache image of %s", path);
+                img = NULL;
+            }
+        }
+
+        /* spawn the image */
+        if (img != NULL) {
+            err = spawn_load_shared_image(&si, img, name, my_core_id, argv,
+                                          envp, inheritcn_cap, argcn_cap);
+        } else {
+            err = spawn_load_image(&si, (lvaddr_t)image, info.size,
+                                   CURRENT_CPU_TYPE, name, my_core_id, argv,
+                                   envp, inheritcn_cap, argcn_cap);
+        }
         free(image);
-        return err;
+        if (err_is_fail(err)) {
+            return err;
+        }
     }
 
-    free(image);
-
     /* request connection from monitor */
     struct monitor_blocking_rpc_client *mrpc = get_monitor_blocking_rpc_client();
     struct capref monep;
@@ -128,6 +174,13 @@ static errval_t spawn(char *path, char *const argv[], char *argbuf,
     }
 
     debug_printf("spawning %s on core %u\n", path, my_core_id);
+    // build with -DSPAWND_PHASE_TIMING to print the time of each phase
+#ifdef SPAWND_PHASE_TIMING
+    for (int i = 0; i < SPAWN_PHASE_COUNT; i++) {
+        debug_printf("  %-10s %" PRIu64 " cycles\n", spawn_phase_name(i),
+                     si.phase_cycles[i]);
+    }
+#endif
 
     /* give the perfmon capability */
     struct capref dest, src;
@@ -0,0 +1,178 @@
+/**
+ * \file
+ * \brief Round trip of capability batches over an LMP channel
+ *
+ * Sets up an LMP channel from the domain to itself, sends batches of frames
+ * on it and checks that the receiver can identify and map every frame in the
+ * received batches and sees the data the sender wrote. The receiver takes
+ * its receive slots from a reserve filled with lmp_chan_reserve_recv_slots().
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/lmp_chan.h>
+#include <barrelfish/lmp_cap_batch.h>
+
+#define BATCHES         4
+#define BATCH_CAPS      20
+#define RECV_RESERVE    2
+
+static struct lmp_chan rx, tx;
+
+static uint32_t pattern(int batch, cslot_t i)
+{
+    return 0xb47c0000 | (batch << 8) | i;
+}
+
+static void map_frame(struct capref frame, uint32_t **buf)
+{
+    errval_t err = vspace_map_one_frame((void **)buf, BASE_PAGE_SIZE, frame,
+                                        NULL, NULL);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "vspace_map_one_frame");
+    }
+}
+
+static void send_batch(int batch)
+{
+    struct lmp_cap_batch b;
+    errval_t err;
+
+    err = lmp_cap_batch_create(&b, BATCH_CAPS);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "lmp_cap_batch_create");
+    }
+
+    for (cslot_t i = 0; i < BATCH_CAPS; i++) {
+        struct capref frame;
+        uint32_t *buf;
+
+        err = frame_alloc(&frame, BASE_PAGE_SIZE, NULL);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "frame_alloc");
+        }
+        map_frame(frame, &buf);
+        *buf = pattern(batch, i);
+        err = vspace_unmap(buf);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "vspace_unmap");
+        }
+
+        err = lmp_cap_batch_add(&b, frame, true);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "lmp_cap_batch_add");
+        }
+    }
+
+    // sender and receiver are the same dispatcher, there is no one to yield to
+    err = lmp_chan_send_cap_batch(&tx, 0, &b);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "lmp_chan_send_cap_batch");
+    }
+    assert(capref_is_null(b.cnode_cap));
+}
+
+static int recv_batch(int batch)
+{
+    struct lmp_cap_batch b;
+    errval_t err;
+    int result = 0;
+
+    do {
+        err = lmp_chan_recv_cap_batch(&rx, &b);
+        if (err_no(err) == LIB_ERR_NO_LMP_MSG) {
+            thread_yield();
+        }
+    } while (err_no(err) == LIB_ERR_NO_LMP_MSG);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "lmp_chan_recv_cap_batch");
+    }
+
+    if (b.count != BATCH_CAPS || b.slots < BATCH_CAPS) {
+        printf("batch %d: got %" PRIuCSLOT " caps in %" PRIuCSLOT " slots, "
+               "expected %d\n", batch, b.count, b.slots, BATCH_CAPS);
+        return 1;
+    }
+
+    for (cslot_t i = 0; i < b.count; i++) {
+        struct capref frame = lmp_cap_batch_get(&b, i);
+        struct frame_identity id;
+        uint32_t *buf;
+
+        err = invoke_frame_identify(frame, &id);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "batch %d: identifying cap %" PRIuCSLOT, batch, i);
+            result = 1;
+            continue;
+        }
+        if (id.bytes != BASE_PAGE_SIZE) {
+            printf("batch %d: cap %" PRIuCSLOT " has %zu bytes\n", batch, i,
+                   (size_t)id.bytes);
+            result = 1;
+            continue;
+        }
+
+        map_frame(frame, &buf);
+        if (*buf != pattern(batch, i)) {
+            printf("batch %d: cap %" PRIuCSLOT " contains %#" PRIx32
+                   ", expected %#" PRIx32 "\n", batch, i, *buf,
+                   pattern(batch, i));
+            result = 1;
+        }
+        vspace_unmap(buf);
+    }
+
+    err = lmp_cap_batch_destroy(&b);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "lmp_cap_batch_destroy");
+    }
+
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    errval_t err;
+    int result = 0;
+
+    err = lmp_chan_accept(&rx, DEFAULT_LMP_BUF_WORDS, NULL_CAP);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "lmp_chan_accept");
+    }
+    err = lmp_chan_accept(&tx, DEFAULT_LMP_BUF_WORDS, rx.local_cap);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "lmp_chan_accept");
+    }
+
+    err = lmp_chan_reserve_recv_slots(&rx, RECV_RESERVE);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "lmp_chan_reserve_recv_slots");
+    }
+    err = lmp_chan_alloc_recv_slot(&rx);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "lmp_chan_alloc_recv_slot");
+    }
+
+    for (int i = 0; i < BATCHES; i++) {
+        send_batch(i);
+        if (recv_batch(i) != 0) {
+            result = 1;
+        }
+    }
+
+    lmp_chan_destroy(&tx);
+    lmp_chan_destroy(&rx);
+
+    printf("lmp_cap_batch_test %s\n", result == 0 ? "passed" : "FAILED");
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,231 @@
+/**
+ * \file
+ * \brief Tests the client-side record cache and measures lookup latency.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/deferred.h>
+#include <barrelfish/nameservice_client.h>
+#include <barrelfish/spawn_client.h>
+#include <bench/bench.h>
+#include <skb/skb.h>
+#include <octopus/octopus.h>
+
+#include "common.h"
+
+#define STALENESS_US    (1000 * 1000)
+#define SERVICES        16
+#define ROUNDS          100
+
+static char* program;
+
+/*
+ * Sets a record from another domain, so that the cache of this domain only
+ * hears about the change through the server.
+ */
+static void remote_set(char* record)
+{
+    char* argv[] = { program, "set", record, NULL };
+    domainid_t domain;
+    uint8_t code;
+
+    errval_t err = spawn_program(disp_get_core_id(), program, argv, NULL,
+                                 SPAWN_FLAGS_DEFAULT, &domain);
+    ASSERT_ERR_OK(err);
+    err = spawn_wait(domain, &code, false);
+    ASSERT_ERR_OK(err);
+    assert(code == EXIT_SUCCESS);
+}
+
+static void cache_invalidation(void)
+{
+    errval_t err = SYS_ERR_OK;
+    char* data = NULL;
+    struct oct_cache_stats st, before;
+
+    err = oct_set("d2cache { attr: 1 }");
+    ASSERT_ERR_OK(err);
+
+    oct_cache_get_stats(&before);
+    err = oct_get(&data, "d2cache");
+    ASSERT_ERR_OK(err);
+    ASSERT_STRING(data, "d2cache { attr: 1 }");
+    free(data);
+
+    err = oct_get(&data, "d2cache");
+    ASSERT_ERR_OK(err);
+    ASSERT_STRING(data, "d2cache { attr: 1 }");
+    free(data);
+
+    oct_cache_get_stats(&st);
+    assert(st.misses == before.misses + 1);
+    assert(st.hits == before.hits + 1);
+
+    // Changing the record drops it from the cache right away, without
+    // waiting for the trigger event
+    err = oct_set("d2cache { attr: 2 }");
+    ASSERT_ERR_OK(err);
+    oct_cache_get_stats(&before);
+    assert(before.invalidations > st.invalidations);
+
+    err = oct_get(&data, "d2cache");
+    ASSERT_ERR_OK(err);
+    ASSERT_STRING(data, "d2cache { attr: 2 }");
+    free(data);
+
+    // So does deleting it
+    oct_cache_get_stats(&st);
+    err = oct_del("d2cache");
+    ASSERT_ERR_OK(err);
+    oct_cache_get_stats(&before);
+    assert(before.invalidations > st.invalidations);
+
+    err = oct_get(&data, "d2cache");
+    ASSERT_ERR(err, OCT_ERR_NO_RECORD);
+
+    // Failed lookups are not cached. Another domain creates the record, a
+    // local oct_set would invalidate the name here and hide a cached miss.
+    oct_cache_get_stats(&before);
+    remote_set("d2cache { attr: 3 }");
+    err = oct_get(&data, "d2cache");
+    ASSERT_ERR_OK(err);
+    ASSERT_STRING(data, "d2cache { attr: 3 }");
+    free(data);
+    oct_cache_get_stats(&st);
+    assert(st.hits == before.hits);
+
+    printf("cache_invalidation() done!\n");
+}
+
+static void cache_staleness(void)
+{
+    errval_t err = SYS_ERR_OK;
+    char* data = NULL;
+    struct oct_cache_stats st, before;
+
+    err = oct_set("d2cache_stale { attr: 1 }");
+    ASSERT_ERR_OK(err);
+    err = oct_get(&data, "d2cache_stale");
+    ASSERT_ERR_OK(err);
+    free(data);
+
+    oct_cache_get_stats(&before);
+    barrelfish_usleep(2 * STALENESS_US);
+
+    err = oct_get(&data, "d2cache_stale");
+    ASSERT_ERR_OK(err);
+    ASSERT_STRING(data, "d2cache_stale { attr: 1 }");
+    free(data);
+
+    oct_cache_get_stats(&st);
+    assert(st.expired == before.expired + 1);
+
+    printf("cache_staleness() done!\n");
+}
+
+static void register_services(void)
+{
+    char name[32];
+
+    for (int i = 0; i < SERVICES; i++) {
+        snprintf(name, sizeof(name), "d2cache_service%d", i);
+        errval_t err = nameservice_register(name, 1000 + i);
+        ASSERT_ERR_OK(err);
+    }
+}
+
+/*
+ * Looks up all services like a starting domain would, returns the average
+ * latency of a lookup in cycles.
+ */
+static cycles_t lookup_services(void)
+{
+    char name[32];
+    cycles_t total = 0;
+
+    for (int i = 0; i < SERVICES; i++) {
+        snprintf(name, sizeof(name), "d2cache_service%d", i);
+
+        iref_t iref;
+        cycles_t start = bench_tsc();
+        errval_t err = nameservice_lookup(name, &iref);
+        total += bench_tsc() - start;
+
+        ASSERT_ERR_OK(err);
+        assert(iref == 1000 + i);
+    }
+
+    return total / SERVICES;
+}
+
+static void lookup_latency(void)
+{
+    cycles_t uncached = 0, cold = 0, warm = 0;
+    struct oct_cache_stats st;
+
+    register_services();
+
+    oct_cache_disable();
+    for (int r = 0; r < ROUNDS; r++) {
+        uncached += lookup_services();
+    }
+
+    oct_cache_enable(STALENESS_US);
+    for (int r = 0; r < ROUNDS; r++) {
+        oct_cache_flush();
+        cold += lookup_services();
+        warm += lookup_services();
+    }
+
+    printf("nameservice_lookup cycles: uncached %"PRIuCYCLES", "
+           "cold %"PRIuCYCLES", warm %"PRIuCYCLES"\n",
+           uncached / ROUNDS, cold / ROUNDS, warm / ROUNDS);
+
+    oct_cache_get_stats(&st);
+    printf("cache: %"PRIu64" hits, %"PRIu64" misses, %"PRIu64" expired, "
+           "%"PRIu64" invalidations, %"PRIu64" evictions, hit rate %"PRIu64
+           "%%\n", st.hits, st.misses, st.expired, st.invalidations,
+           st.evictions, 100 * st.hits / (st.hits + st.misses + st.expired));
+}
+
+int main(int argc, char *argv[])
+{
+    errval_t err = oct_init();
+    ASSERT_ERR_OK(err);
+
+    // Started by remote_set()
+    if (argc == 3 && strcmp(argv[1], "set") == 0) {
+        err = oct_set("%s", argv[2]);
+        ASSERT_ERR_OK(err);
+        return EXIT_SUCCESS;
+    }
+
+    program = argv[0];
+    bench_init();
+
+    err = oct_cache_enable(STALENESS_US);
+    ASSERT_ERR_OK(err);
+
+    cache_invalidation();
+    cache_staleness();
+    lookup_latency();
+
+    oct_cache_disable();
+
+    printf("d2cache SUCCESS!\n");
+    return EXIT_SUCCESS;
+}